@@ -0,0 +1,325 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * alloc.c - Memory allocation for the library, with a replaceable
+ *           allocator, and optional arenas.
+ *
+ * Written by Steve Underwood <steveu@coppice.org>
+ *
+ * Copyright (C) 2010 Steve Underwood
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
+
+#include "spandsp/private/alloc.h"
+
+#if defined(_MSC_VER)
+#define SPAN_THREAD_LOCAL __declspec(thread)
+#else
+#define SPAN_THREAD_LOCAL __thread
+#endif
+
+/* Every allocation, from an arena or from the allocator, is preceded by a header saying
+   where it came from. Memory can then be freed, or resized, whichever arena the calling
+   thread has selected, or if none is selected. The header is a whole alignment unit, so
+   the allocations stay as well aligned as malloc()'s. */
+#define ARENA_ALIGNMENT     16
+#define ARENA_HEADER_SIZE   ARENA_ALIGNMENT
+
+#define HEAP_BLOCK_MAGIC    0x5350484DU
+#define ARENA_BLOCK_MAGIC   0x53504152U
+
+#define arena_round_up(x)   (((x) + ARENA_ALIGNMENT - 1) & ~((size_t) ARENA_ALIGNMENT - 1))
+
+typedef struct
+{
+    /*! HEAP_BLOCK_MAGIC or ARENA_BLOCK_MAGIC */
+    uint32_t magic;
+    /*! The size requested for an arena block */
+    uint32_t size;
+    /*! The arena which owns the block, or NULL */
+    span_arena_t *arena;
+} block_header_t;
+
+static span_alloc_t custom_alloc_func = malloc;
+static span_realloc_t custom_realloc_func = realloc;
+static span_free_t custom_free_func = free;
+
+static SPAN_THREAD_LOCAL span_arena_t *current_arena = NULL;
+
+static __inline__ block_header_t *block_header(void *ptr)
+{
+    return (block_header_t *) ((uint8_t *) ptr - ARENA_HEADER_SIZE);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void *arena_alloc(span_arena_t *s, size_t size)
+{
+    size_t need;
+    block_header_t *header;
+
+    need = ARENA_HEADER_SIZE + arena_round_up(size);
+    if (size > UINT32_MAX  ||  need > s->len - s->used)
+        return NULL;
+    header = (block_header_t *) (s->buf + s->used);
+    header->magic = ARENA_BLOCK_MAGIC;
+    header->size = (uint32_t) size;
+    header->arena = s;
+    s->last = s->used;
+    s->used += need;
+    if (s->used > s->peak)
+        s->peak = s->used;
+    return (uint8_t *) header + ARENA_HEADER_SIZE;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void *arena_realloc(span_arena_t *s, void *ptr, size_t size)
+{
+    size_t need;
+    block_header_t *header;
+    void *new_ptr;
+
+    header = block_header(ptr);
+    if (size > UINT32_MAX)
+        return NULL;
+    if (s->last == (size_t) ((uint8_t *) header - s->buf))
+    {
+        /* This is the most recent allocation, so it can change size where it is. */
+        need = ARENA_HEADER_SIZE + arena_round_up(size);
+        if (need > s->len - s->last)
+            return NULL;
+        header->size = (uint32_t) size;
+        s->used = s->last + need;
+        if (s->used > s->peak)
+            s->peak = s->used;
+        return ptr;
+    }
+    if (size <= header->size)
+    {
+        header->size = (uint32_t) size;
+        return ptr;
+    }
+    if ((new_ptr = arena_alloc(s, size)) == NULL)
+        return NULL;
+    memcpy(new_ptr, ptr, header->size);
+    return new_ptr;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void arena_free(span_arena_t *s, void *ptr)
+{
+    /* Only the most recent allocation can be given back. Everything else waits for
+       the arena to be reset. */
+    if (s->last == (size_t) ((uint8_t *) block_header(ptr) - s->buf))
+    {
+        s->used = s->last;
+        s->last = (size_t) -1;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static void *heap_alloc(size_t size)
+{
+    block_header_t *header;
+
+    if (size > SIZE_MAX - ARENA_HEADER_SIZE)
+        return NULL;
+    if ((header = (block_header_t *) custom_alloc_func(ARENA_HEADER_SIZE + size)) == NULL)
+        return NULL;
+    header->magic = HEAP_BLOCK_MAGIC;
+    header->size = 0;
+    header->arena = NULL;
+    return (uint8_t *) header + ARENA_HEADER_SIZE;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) span_set_allocator(span_alloc_t custom_alloc,
+                                     span_realloc_t custom_realloc,
+                                     span_free_t custom_free)
+{
+    custom_alloc_func = (custom_alloc)  ?  custom_alloc  :  malloc;
+    custom_realloc_func = (custom_realloc)  ?  custom_realloc  :  realloc;
+    custom_free_func = (custom_free)  ?  custom_free  :  free;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void *) span_alloc(size_t size)
+{
+    if (current_arena)
+        return arena_alloc(current_arena, size);
+    return heap_alloc(size);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void *) span_realloc(void *ptr, size_t size)
+{
+    block_header_t *header;
+
+    if (ptr == NULL)
+        return span_alloc(size);
+    header = block_header(ptr);
+    if (header->magic == ARENA_BLOCK_MAGIC)
+        return arena_realloc(header->arena, ptr, size);
+    if (size > SIZE_MAX - ARENA_HEADER_SIZE)
+        return NULL;
+    if ((header = (block_header_t *) custom_realloc_func(header, ARENA_HEADER_SIZE + size)) == NULL)
+        return NULL;
+    return (uint8_t *) header + ARENA_HEADER_SIZE;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void) span_free(void *ptr)
+{
+    block_header_t *header;
+
+    if (ptr == NULL)
+        return;
+    header = block_header(ptr);
+    if (header->magic == ARENA_BLOCK_MAGIC)
+    {
+        arena_free(header->arena, ptr);
+    }
+    else
+    {
+        header->magic = 0;
+        custom_free_func(header);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(char *) span_strdup(const char *s)
+{
+    char *t;
+    size_t len;
+
+    len = strlen(s) + 1;
+    if ((t = (char *) span_alloc(len)))
+        memcpy(t, s, len);
+    return t;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(span_arena_t *) span_arena_select(span_arena_t *s)
+{
+    span_arena_t *prev;
+
+    prev = current_arena;
+    current_arena = s;
+    return prev;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void) span_arena_reset(span_arena_t *s)
+{
+    s->used = 0;
+    s->last = (size_t) -1;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(size_t) span_arena_get_used(span_arena_t *s)
+{
+    return s->used;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(size_t) span_arena_get_peak(span_arena_t *s)
+{
+    return s->peak;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(span_arena_t *) span_arena_init(span_arena_t *s, void *buf, size_t len)
+{
+    uint8_t *aligned;
+    int alloced;
+
+    /* The arena's own context and memory always come from the library's allocator,
+       never from another arena. */
+    alloced = FALSE;
+    if (s == NULL)
+    {
+        if ((s = (span_arena_t *) custom_alloc_func(sizeof(*s))) == NULL)
+            return NULL;
+        alloced = TRUE;
+    }
+    memset(s, 0, sizeof(*s));
+    if (buf == NULL)
+    {
+        if ((buf = custom_alloc_func(len)) == NULL)
+        {
+            if (alloced)
+                custom_free_func(s);
+            return NULL;
+        }
+        s->buf_allocated = TRUE;
+        s->buf = (uint8_t *) buf;
+        s->len = len;
+    }
+    else
+    {
+        /* Line up the start of a caller's buffer, so every allocation is aligned. */
+        aligned = (uint8_t *) arena_round_up((uintptr_t) buf);
+        if ((size_t) (aligned - (uint8_t *) buf) > len)
+            len = 0;
+        else
+            len -= (aligned - (uint8_t *) buf);
+        s->buf = aligned;
+        s->len = len;
+    }
+    s->used = 0;
+    s->peak = 0;
+    s->last = (size_t) -1;
+    return s;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) span_arena_release(span_arena_t *s)
+{
+    if (current_arena == s)
+        current_arena = NULL;
+    if (s->buf_allocated)
+    {
+        custom_free_func(s->buf);
+        s->buf_allocated = FALSE;
+    }
+    s->buf = NULL;
+    s->len = 0;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) span_arena_free(span_arena_t *s)
+{
+    span_arena_release(s);
+    custom_free_func(s);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
@@ -35,6 +35,7 @@
 #include <assert.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/async.h"
 
 #include "spandsp/private/async.h"
@@ -84,7 +85,7 @@ SPAN_DECLARE(async_rx_state_t *) async_rx_init(async_rx_state_t *s,
 {
     if (s == NULL)
     {
-        if ((s = (async_rx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (async_rx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     s->data_bits = data_bits;
@@ -113,37 +114,13 @@ SPAN_DECLARE(int) async_rx_release(async_rx_state_t *s)
 
 SPAN_DECLARE(int) async_rx_free(async_rx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
 
-SPAN_DECLARE_NONSTD(void) async_rx_put_bit(void *user_data, int bit)
+static __inline__ void put_data_bit(async_rx_state_t *s, int bit)
 {
-    async_rx_state_t *s;
-
-    s = (async_rx_state_t *) user_data;
-    if (bit < 0)
-    {
-        /* Special conditions */
-        switch (bit)
-        {
-        case SIG_STATUS_CARRIER_UP:
-        case SIG_STATUS_CARRIER_DOWN:
-        case SIG_STATUS_TRAINING_IN_PROGRESS:
-        case SIG_STATUS_TRAINING_SUCCEEDED:
-        case SIG_STATUS_TRAINING_FAILED:
-        case SIG_STATUS_END_OF_DATA:
-            s->put_byte(s->user_data, bit);
-            s->bitpos = 0;
-            s->byte_in_progress = 0;
-            break;
-        default:
-            //printf("Eh!\n");
-            break;
-        }
-        return;
-    }
     if (s->bitpos == 0)
     {
         /* Search for the start bit */
@@ -199,6 +176,47 @@ SPAN_DECLARE_NONSTD(void) async_rx_put_bit(void *user_data, int bit)
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE_NONSTD(void) async_rx_put_bit(void *user_data, int bit)
+{
+    async_rx_state_t *s;
+
+    s = (async_rx_state_t *) user_data;
+    if (bit < 0)
+    {
+        /* Special conditions */
+        switch (bit)
+        {
+        case SIG_STATUS_CARRIER_UP:
+        case SIG_STATUS_CARRIER_DOWN:
+        case SIG_STATUS_TRAINING_IN_PROGRESS:
+        case SIG_STATUS_TRAINING_SUCCEEDED:
+        case SIG_STATUS_TRAINING_FAILED:
+        case SIG_STATUS_END_OF_DATA:
+            s->put_byte(s->user_data, bit);
+            s->bitpos = 0;
+            s->byte_in_progress = 0;
+            break;
+        default:
+            //printf("Eh!\n");
+            break;
+        }
+        return;
+    }
+    put_data_bit(s, bit);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE_NONSTD(void) async_rx_put_bits(void *user_data, unsigned int bits, int nbits)
+{
+    async_rx_state_t *s;
+    int i;
+
+    s = (async_rx_state_t *) user_data;
+    for (i = nbits - 1;  i >= 0;  i--)
+        put_data_bit(s, (bits >> i) & 1);
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(async_tx_state_t *) async_tx_init(async_tx_state_t *s,
                                                int data_bits,
                                                int parity,
@@ -209,7 +227,7 @@ SPAN_DECLARE(async_tx_state_t *) async_tx_init(async_tx_state_t *s,
 {
     if (s == NULL)
     {
-        if ((s = (async_tx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (async_tx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     /* We have a use_v14 parameter for completeness, but right now V.14 only
@@ -239,7 +257,7 @@ SPAN_DECLARE(int) async_tx_release(async_tx_state_t *s)
 
 SPAN_DECLARE(int) async_tx_free(async_tx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -289,4 +307,50 @@ SPAN_DECLARE_NONSTD(int) async_tx_get_bit(void *user_data)
     return bit;
 }
 /*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE_NONSTD(int) async_tx_get_bits(void *user_data, unsigned int *bits)
+{
+    async_tx_state_t *s;
+    int nbits;
+    int bit;
+    int i;
+
+    s = (async_tx_state_t *) user_data;
+    if (s->bitpos)
+    {
+        /* Finish off a character which async_tx_get_bit() started */
+        nbits = 0;
+        *bits = 0;
+        while (s->bitpos)
+        {
+            *bits = (*bits << 1) | async_tx_get_bit(s);
+            nbits++;
+        }
+        return nbits;
+    }
+    if ((s->byte_in_progress = s->get_byte(s->user_data)) < 0)
+        return SIG_STATUS_END_OF_DATA;
+    /* Build a whole character - start bit, data bits, parity and stop bits - in one go */
+    *bits = 0;
+    s->parity_bit = 0;
+    for (i = 0;  i < s->data_bits;  i++)
+    {
+        bit = s->byte_in_progress & 1;
+        s->byte_in_progress >>= 1;
+        s->parity_bit ^= bit;
+        *bits = (*bits << 1) | bit;
+    }
+    /* When there is a parity bit, it is counted in stop_bits */
+    i = s->stop_bits;
+    if (s->parity)
+    {
+        if (s->parity == ASYNC_PARITY_ODD)
+            s->parity_bit ^= 1;
+        *bits = (*bits << 1) | s->parity_bit;
+        i--;
+    }
+    *bits = (*bits << i) | ((1 << i) - 1);
+    return 1 + s->data_bits + s->stop_bits;
+}
+/*- End of function --------------------------------------------------------*/
 /*- End of file ------------------------------------------------------------*/
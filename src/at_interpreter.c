@@ -46,6 +46,7 @@
 #include <assert.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
 #include "spandsp/queue.h"
 #include "spandsp/power_meter.h"
@@ -317,7 +318,7 @@ SPAN_DECLARE(void) at_reset_call_info(at_state_t *s)
     for (call_id = s->call_id;  call_id;  call_id = next)
     {
         next = call_id->next;
-        free(call_id);
+        span_free(call_id);
     }
     s->call_id = NULL;
     s->rings_indicated = 0;
@@ -331,13 +332,13 @@ SPAN_DECLARE(void) at_set_call_info(at_state_t *s, char const *id, char const *v
     at_call_id_t *call_id;
 
     /* TODO: We should really not merely ignore a failure to malloc */
-    if ((new_call_id = (at_call_id_t *) malloc(sizeof(*new_call_id))) == NULL)
+    if ((new_call_id = (at_call_id_t *) span_alloc(sizeof(*new_call_id))) == NULL)
         return;
     call_id = s->call_id;
     /* If these strdups fail its pretty harmless. We just appear to not
        have the relevant field. */
-    new_call_id->id = (id)  ?  strdup(id)  :  NULL;
-    new_call_id->value = (value)  ?  strdup(value)  :  NULL;
+    new_call_id->id = (id)  ?  span_strdup(id)  :  NULL;
+    new_call_id->value = (value)  ?  span_strdup(value)  :  NULL;
     new_call_id->next = NULL;
 
     if (call_id)
@@ -687,9 +688,9 @@ static int parse_string_out(at_state_t *s, const char **t, char **target, const
         default:
             /* Set value */
             if (*target)
-                free(*target);
+                span_free(*target);
             /* If this strdup fails, it should be harmless */
-            *target = strdup(*t);
+            *target = span_strdup(*t);
             break;
         }
         break;
@@ -5493,6 +5494,26 @@ SPAN_DECLARE(void) at_set_class1_handler(at_state_t *s, at_class1_handler_t hand
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) at_get_memory_usage(at_state_t *s)
+{
+    at_call_id_t *call_id;
+    int size;
+
+    size = sizeof(*s);
+    for (call_id = s->call_id;  call_id;  call_id = call_id->next)
+    {
+        size += sizeof(*call_id);
+        if (call_id->id)
+            size += strlen(call_id->id) + 1;
+        if (call_id->value)
+            size += strlen(call_id->value) + 1;
+    }
+    if (s->local_id)
+        size += strlen(s->local_id) + 1;
+    return size;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(at_state_t *) at_init(at_state_t *s,
                                    at_tx_handler_t *at_tx_handler,
                                    void *at_tx_user_data,
@@ -5501,7 +5522,7 @@ SPAN_DECLARE(at_state_t *) at_init(at_state_t *s,
 {
     if (s == NULL)
     {
-        if ((s = (at_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (at_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, '\0', sizeof(*s));
@@ -5524,7 +5545,7 @@ SPAN_DECLARE(int) at_release(at_state_t *s)
 {
     at_reset_call_info(s);
     if (s->local_id)
-        free(s->local_id);
+        span_free(s->local_id);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -5534,7 +5555,7 @@ SPAN_DECLARE(int) at_free(at_state_t *s)
     int ret;
 
     ret = at_release(s);
-    free(s);
+    span_free(s);
     return ret;
 }
 /*- End of function --------------------------------------------------------*/
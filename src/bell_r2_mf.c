@@ -43,6 +43,7 @@
 #include "floating_fudge.h"
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/fast_convert.h"
 #include "spandsp/queue.h"
 #include "spandsp/dc_restore.h"
@@ -76,17 +77,6 @@ typedef struct
     uint8_t     off_time;   /* Minimum post tone silence (ms) */
 } mf_digit_tones_t;
 
-int bell_mf_gen_inited = FALSE;
-tone_gen_descriptor_t bell_mf_digit_tones[15];
-
-int r2_mf_gen_inited = FALSE;
-tone_gen_descriptor_t r2_mf_fwd_digit_tones[15];
-tone_gen_descriptor_t r2_mf_back_digit_tones[15];
-
-#if 0
-tone_gen_descriptor_t socotel_mf_digit_tones[18];
-#endif
-
 /* Bell R1 tone generation specs.
  *  Power: -7dBm +- 1dB
  *  Frequency: within +-1.5%
@@ -216,14 +206,64 @@ static char socotel_mf_tone_codes[] = "1234567890ABCDEFG";
 #define R2_MF_SAMPLES_PER_BLOCK     133
 #endif
 
-static goertzel_descriptor_t bell_mf_detect_desc[6];
+/* The Goertzel descriptors for the MF frequencies are constant, so they are precomputed
+   [fac = 2.0*cos(2.0*pi*f/SAMPLE_RATE), scaled by 16383 for fixed point] rather than built
+   on first use. They are shared by every receiver, in any thread. */
+static const goertzel_descriptor_t bell_mf_detect_desc[6] =
+{
+#if defined(SPANDSP_USE_FIXED_POINT)
+    {27937, BELL_MF_SAMPLES_PER_BLOCK},         /* 700Hz */
+    {24915, BELL_MF_SAMPLES_PER_BLOCK},         /* 900Hz */
+    {21279, BELL_MF_SAMPLES_PER_BLOCK},         /* 1100Hz */
+    {17120, BELL_MF_SAMPLES_PER_BLOCK},         /* 1300Hz */
+    {12539, BELL_MF_SAMPLES_PER_BLOCK},         /* 1500Hz */
+    { 7649, BELL_MF_SAMPLES_PER_BLOCK}          /* 1700Hz */
+#else
+    {1.7052803f, BELL_MF_SAMPLES_PER_BLOCK},    /* 700Hz */
+    {1.5208119f, BELL_MF_SAMPLES_PER_BLOCK},    /* 900Hz */
+    {1.2988961f, BELL_MF_SAMPLES_PER_BLOCK},    /* 1100Hz */
+    {1.0449971f, BELL_MF_SAMPLES_PER_BLOCK},    /* 1300Hz */
+    {0.76536685f, BELL_MF_SAMPLES_PER_BLOCK},   /* 1500Hz */
+    {0.46689072f, BELL_MF_SAMPLES_PER_BLOCK}    /* 1700Hz */
+#endif
+};
 
-static goertzel_descriptor_t mf_fwd_detect_desc[6];
-static goertzel_descriptor_t mf_back_detect_desc[6];
+static const goertzel_descriptor_t mf_fwd_detect_desc[6] =
+{
+#if defined(SPANDSP_USE_FIXED_POINT)
+    {15332, R2_MF_SAMPLES_PER_BLOCK},           /* 1380Hz */
+    {12539, R2_MF_SAMPLES_PER_BLOCK},           /* 1500Hz */
+    { 9634, R2_MF_SAMPLES_PER_BLOCK},           /* 1620Hz */
+    { 6644, R2_MF_SAMPLES_PER_BLOCK},           /* 1740Hz */
+    { 3595, R2_MF_SAMPLES_PER_BLOCK},           /* 1860Hz */
+    {  514, R2_MF_SAMPLES_PER_BLOCK}            /* 1980Hz */
+#else
+    {0.9358596f, R2_MF_SAMPLES_PER_BLOCK},      /* 1380Hz */
+    {0.76536685f, R2_MF_SAMPLES_PER_BLOCK},     /* 1500Hz */
+    {0.58808064f, R2_MF_SAMPLES_PER_BLOCK},     /* 1620Hz */
+    {0.4055746f, R2_MF_SAMPLES_PER_BLOCK},      /* 1740Hz */
+    {0.21946862f, R2_MF_SAMPLES_PER_BLOCK},     /* 1860Hz */
+    {0.031414635f, R2_MF_SAMPLES_PER_BLOCK}     /* 1980Hz */
+#endif
+};
 
-static const int bell_mf_frequencies[] =
+static const goertzel_descriptor_t mf_back_detect_desc[6] =
 {
-     700,  900, 1100, 1300, 1500, 1700
+#if defined(SPANDSP_USE_FIXED_POINT)
+    {20486, R2_MF_SAMPLES_PER_BLOCK},           /* 1140Hz */
+    {22802, R2_MF_SAMPLES_PER_BLOCK},           /* 1020Hz */
+    {24915, R2_MF_SAMPLES_PER_BLOCK},           /* 900Hz */
+    {26807, R2_MF_SAMPLES_PER_BLOCK},           /* 780Hz */
+    {28461, R2_MF_SAMPLES_PER_BLOCK},           /* 660Hz */
+    {29863, R2_MF_SAMPLES_PER_BLOCK}            /* 540Hz */
+#else
+    {1.2504853f, R2_MF_SAMPLES_PER_BLOCK},      /* 1140Hz */
+    {1.3918256f, R2_MF_SAMPLES_PER_BLOCK},      /* 1020Hz */
+    {1.5208119f, R2_MF_SAMPLES_PER_BLOCK},      /* 900Hz */
+    {1.6362995f, R2_MF_SAMPLES_PER_BLOCK},      /* 780Hz */
+    {1.7372631f, R2_MF_SAMPLES_PER_BLOCK},      /* 660Hz */
+    {1.8228066f, R2_MF_SAMPLES_PER_BLOCK}       /* 540Hz */
+#endif
 };
 
 /* Use the follow characters for the Bell MF special signals:
@@ -234,45 +274,27 @@ static const int bell_mf_frequencies[] =
     ST''' - use 'C' */
 static const char bell_mf_positions[] = "1247C-358A--69*---0B----#";
 
-static const int r2_mf_fwd_frequencies[] =
-{
-    1380, 1500, 1620, 1740, 1860, 1980
-};
-
-static const int r2_mf_back_frequencies[] =
-{
-    1140, 1020,  900,  780,  660,  540
-};
-
 /* Use codes '1' to 'F' for the R2 signals 1 to 15, except for signal 'A'.
    Use '0' for this, so the codes match the digits 0-9. */
 static const char r2_mf_positions[] = "1247B-358C--69D---0E----F";
 
-static void bell_mf_gen_init(void)
+static void mf_tone_gen_init(tone_gen_state_t *s, const mf_digit_tones_t *tones, int repeat)
 {
-    int i;
-    const mf_digit_tones_t *tones;
-
-    if (bell_mf_gen_inited)
-        return;
-    i = 0;
-    tones = bell_mf_tones;
-    while (tones->on_time)
-    {
-        /* Note: The duration of KP is longer than the other signals. */
-        tone_gen_descriptor_init(&bell_mf_digit_tones[i++],
-                                 tones->f1,
-                                 tones->level1,
-                                 tones->f2,
-                                 tones->level2,
-                                 tones->on_time,
-                                 tones->off_time,
-                                 0,
-                                 0,
-                                 FALSE);
-        tones++;
-    }
-    bell_mf_gen_inited = TRUE;
+    tone_gen_descriptor_t desc;
+
+    /* The descriptor is built as each signal starts, rather than kept in a table shared
+       by all transmitters. This happens at most once per signal, so it costs little. */
+    tone_gen_descriptor_init(&desc,
+                             tones->f1,
+                             tones->level1,
+                             tones->f2,
+                             tones->level2,
+                             tones->on_time,
+                             tones->off_time,
+                             0,
+                             0,
+                             repeat);
+    tone_gen_init(s, &desc);
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -293,7 +315,8 @@ SPAN_DECLARE(int) bell_mf_tx(bell_mf_tx_state_t *s, int16_t amp[], int max_sampl
         /* Step to the next digit */
         if ((cp = strchr(bell_mf_tone_codes, digit)) == NULL)
             continue;
-        tone_gen_init(&(s->tones), &bell_mf_digit_tones[cp - bell_mf_tone_codes]);
+        /* Note: The duration of KP is longer than the other signals. */
+        mf_tone_gen_init(&(s->tones), &bell_mf_tones[cp - bell_mf_tone_codes], FALSE);
         len += tone_gen(&(s->tones), amp + len, max_samples - len);
     }
     return len;
@@ -324,14 +347,12 @@ SPAN_DECLARE(bell_mf_tx_state_t *) bell_mf_tx_init(bell_mf_tx_state_t *s)
 {
     if (s == NULL)
     {
-        if ((s = (bell_mf_tx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (bell_mf_tx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
 
-    if (!bell_mf_gen_inited)
-        bell_mf_gen_init();
-    tone_gen_init(&(s->tones), &bell_mf_digit_tones[0]);
+    mf_tone_gen_init(&(s->tones), &bell_mf_tones[0], FALSE);
     s->current_sample = 0;
     queue_init(&s->queue.queue, MAX_BELL_MF_DIGITS, QUEUE_READ_ATOMIC | QUEUE_WRITE_ATOMIC);
     s->tones.current_section = -1;
@@ -347,7 +368,7 @@ SPAN_DECLARE(int) bell_mf_tx_release(bell_mf_tx_state_t *s)
 
 SPAN_DECLARE(int) bell_mf_tx_free(bell_mf_tx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -372,13 +393,13 @@ SPAN_DECLARE(int) r2_mf_tx(r2_mf_tx_state_t *s, int16_t amp[], int samples)
 SPAN_DECLARE(int) r2_mf_tx_put(r2_mf_tx_state_t *s, char digit)
 {
     char *cp;
+    const mf_digit_tones_t *tones;
 
     if (digit  &&  (cp = strchr(r2_mf_tone_codes, digit)))
     {
-        if (s->fwd)
-            tone_gen_init(&s->tone, &r2_mf_fwd_digit_tones[cp - r2_mf_tone_codes]);
-        else
-            tone_gen_init(&s->tone, &r2_mf_back_digit_tones[cp - r2_mf_tone_codes]);
+        tones = (s->fwd)  ?  r2_mf_fwd_tones  :  r2_mf_back_tones;
+        tones += (cp - r2_mf_tone_codes);
+        mf_tone_gen_init(&s->tone, tones, (tones->off_time == 0));
         s->digit = digit;
     }
     else
@@ -391,52 +412,13 @@ SPAN_DECLARE(int) r2_mf_tx_put(r2_mf_tx_state_t *s, char digit)
 
 SPAN_DECLARE(r2_mf_tx_state_t *) r2_mf_tx_init(r2_mf_tx_state_t *s, int fwd)
 {
-    int i;
-    const mf_digit_tones_t *tones;
-
     if (s == NULL)
     {
-        if ((s = (r2_mf_tx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (r2_mf_tx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
 
-    if (!r2_mf_gen_inited)
-    {
-        i = 0;
-        tones = r2_mf_fwd_tones;
-        while (tones->on_time)
-        {
-            tone_gen_descriptor_init(&r2_mf_fwd_digit_tones[i++],
-                                     tones->f1,
-                                     tones->level1,
-                                     tones->f2,
-                                     tones->level2,
-                                     tones->on_time,
-                                     tones->off_time,
-                                     0,
-                                     0,
-                                     (tones->off_time == 0));
-            tones++;
-        }
-        i = 0;
-        tones = r2_mf_back_tones;
-        while (tones->on_time)
-        {
-            tone_gen_descriptor_init(&r2_mf_back_digit_tones[i++],
-                                     tones->f1,
-                                     tones->level1,
-                                     tones->f2,
-                                     tones->level2,
-                                     tones->on_time,
-                                     tones->off_time,
-                                     0,
-                                     0,
-                                     (tones->off_time == 0));
-            tones++;
-        }
-        r2_mf_gen_inited = TRUE;
-    }
     s->fwd = fwd;
     return s;
 }
@@ -450,7 +432,7 @@ SPAN_DECLARE(int) r2_mf_tx_release(r2_mf_tx_state_t *s)
 
 SPAN_DECLARE(int) r2_mf_tx_free(r2_mf_tx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -628,21 +610,14 @@ SPAN_DECLARE(bell_mf_rx_state_t *) bell_mf_rx_init(bell_mf_rx_state_t *s,
                                                    void *user_data)
 {
     int i;
-    static int initialised = FALSE;
 
     if (s == NULL)
     {
-        if ((s = (bell_mf_rx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (bell_mf_rx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
 
-    if (!initialised)
-    {
-        for (i = 0;  i < 6;  i++)
-            make_goertzel_descriptor(&bell_mf_detect_desc[i], (float) bell_mf_frequencies[i], BELL_MF_SAMPLES_PER_BLOCK);
-        initialised = TRUE;
-    }
     s->digits_callback = callback;
     s->digits_callback_data = user_data;
 
@@ -670,7 +645,7 @@ SPAN_DECLARE(int) bell_mf_rx_release(bell_mf_rx_state_t *s)
 
 SPAN_DECLARE(int) bell_mf_rx_free(bell_mf_rx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -808,26 +783,16 @@ SPAN_DECLARE(r2_mf_rx_state_t *) r2_mf_rx_init(r2_mf_rx_state_t *s,
                                                void *user_data)
 {
     int i;
-    static int initialised = FALSE;
 
     if (s == NULL)
     {
-        if ((s = (r2_mf_rx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (r2_mf_rx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
 
     s->fwd = fwd;
 
-    if (!initialised)
-    {
-        for (i = 0;  i < 6;  i++)
-        {
-            make_goertzel_descriptor(&mf_fwd_detect_desc[i], (float) r2_mf_fwd_frequencies[i], R2_MF_SAMPLES_PER_BLOCK);
-            make_goertzel_descriptor(&mf_back_detect_desc[i], (float) r2_mf_back_frequencies[i], R2_MF_SAMPLES_PER_BLOCK);
-        }
-        initialised = TRUE;
-    }
     if (fwd)
     {
         for (i = 0;  i < 6;  i++)
@@ -854,7 +819,7 @@ SPAN_DECLARE(int) r2_mf_rx_release(r2_mf_rx_state_t *s)
 
 SPAN_DECLARE(int) r2_mf_rx_free(r2_mf_rx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
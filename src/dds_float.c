@@ -38,6 +38,7 @@
 #include <math.h>
 #endif
 #include "floating_fudge.h"
+#include "mmx_sse_decs.h"
 
 #include "spandsp/telephony.h"
 #include "spandsp/complex.h"
@@ -2146,16 +2147,112 @@ SPAN_DECLARE(float) dds_lookupf(uint32_t phase)
 }
 /*- End of function --------------------------------------------------------*/
 
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+static __inline__ __m128 lookup4(__m128i phase)
+{
+    int32_t steps[4];
+
+    /* Only the table lookups themselves need to be done one at a time. */
+    _mm_storeu_si128((__m128i *) steps, _mm_srli_epi32(phase, 32 - SLENK));
+    return _mm_setr_ps(sine_table[steps[0]], sine_table[steps[1]], sine_table[steps[2]], sine_table[steps[3]]);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void) ddsf_block(uint32_t *phase_acc, int32_t phase_rate, float amp[], int len)
+{
+    int i;
+    uint32_t phase;
+    __m128i n1;
+    __m128i n2;
+
+    phase = *phase_acc;
+    n1 = _mm_setr_epi32(phase, phase + phase_rate, phase + 2*phase_rate, phase + 3*phase_rate);
+    n2 = _mm_set1_epi32(4*phase_rate);
+    for (i = 0;  i + 4 <= len;  i += 4)
+    {
+        _mm_storeu_ps(&amp[i], lookup4(n1));
+        n1 = _mm_add_epi32(n1, n2);
+    }
+    phase += i*phase_rate;
+    /* Now deal with the last 1 to 3 samples */
+    for (  ;  i < len;  i++)
+    {
+        amp[i] = sine_table[phase >> (32 - SLENK)];
+        phase += phase_rate;
+    }
+    *phase_acc = phase;
+}
+#else
+SPAN_DECLARE(void) ddsf_block(uint32_t *phase_acc, int32_t phase_rate, float amp[], int len)
+{
+    int i;
+    uint32_t phase;
+
+    phase = *phase_acc;
+    for (i = 0;  i < len;  i++)
+    {
+        amp[i] = sine_table[phase >> (32 - SLENK)];
+        phase += phase_rate;
+    }
+    *phase_acc = phase;
+}
+#endif
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(float) dds_modf(uint32_t *phase_acc, int32_t phase_rate, float scale, int32_t phase)
 {
     float amp;
 
-    amp = sine_table[*(phase_acc + phase) >> (32 - SLENK)]*scale;
+    amp = sine_table[(*phase_acc + phase) >> (32 - SLENK)]*scale;
     *phase_acc += phase_rate;
     return amp;
 }
 /*- End of function --------------------------------------------------------*/
 
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+SPAN_DECLARE(void) dds_modf_block(uint32_t *phase_acc, int32_t phase_rate, float scale, int32_t phase, float amp[], int len)
+{
+    int i;
+    uint32_t phasex;
+    __m128i n1;
+    __m128i n2;
+    __m128 n3;
+
+    phasex = *phase_acc + phase;
+    n1 = _mm_setr_epi32(phasex, phasex + phase_rate, phasex + 2*phase_rate, phasex + 3*phase_rate);
+    n2 = _mm_set1_epi32(4*phase_rate);
+    n3 = _mm_set1_ps(scale);
+    for (i = 0;  i + 4 <= len;  i += 4)
+    {
+        _mm_storeu_ps(&amp[i], _mm_mul_ps(lookup4(n1), n3));
+        n1 = _mm_add_epi32(n1, n2);
+    }
+    phasex += i*phase_rate;
+    /* Now deal with the last 1 to 3 samples */
+    for (  ;  i < len;  i++)
+    {
+        amp[i] = sine_table[phasex >> (32 - SLENK)]*scale;
+        phasex += phase_rate;
+    }
+    *phase_acc = phasex - phase;
+}
+#else
+SPAN_DECLARE(void) dds_modf_block(uint32_t *phase_acc, int32_t phase_rate, float scale, int32_t phase, float amp[], int len)
+{
+    int i;
+    uint32_t phasex;
+
+    phasex = *phase_acc + phase;
+    for (i = 0;  i < len;  i++)
+    {
+        amp[i] = sine_table[phasex >> (32 - SLENK)]*scale;
+        phasex += phase_rate;
+    }
+    *phase_acc = phasex - phase;
+}
+#endif
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(complexf_t) dds_complexf(uint32_t *phase_acc, int32_t phase_rate)
 {
     complexf_t amp;
@@ -2167,6 +2264,57 @@ SPAN_DECLARE(complexf_t) dds_complexf(uint32_t *phase_acc, int32_t phase_rate)
 }
 /*- End of function --------------------------------------------------------*/
 
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+SPAN_DECLARE(void) dds_complexf_block(uint32_t *phase_acc, int32_t phase_rate, complexf_t amp[], int len)
+{
+    int i;
+    uint32_t phase;
+    __m128i n1;
+    __m128i n2;
+    __m128i n3;
+    __m128 re;
+    __m128 im;
+
+    phase = *phase_acc;
+    n1 = _mm_setr_epi32(phase, phase + phase_rate, phase + 2*phase_rate, phase + 3*phase_rate);
+    n2 = _mm_set1_epi32(4*phase_rate);
+    n3 = _mm_set1_epi32(1 << 30);
+    for (i = 0;  i + 4 <= len;  i += 4)
+    {
+        re = lookup4(_mm_add_epi32(n1, n3));
+        im = lookup4(n1);
+        _mm_storeu_ps((float *) &amp[i], _mm_unpacklo_ps(re, im));
+        _mm_storeu_ps((float *) &amp[i + 2], _mm_unpackhi_ps(re, im));
+        n1 = _mm_add_epi32(n1, n2);
+    }
+    phase += i*phase_rate;
+    /* Now deal with the last 1 to 3 samples */
+    for (  ;  i < len;  i++)
+    {
+        amp[i] = complex_setf(sine_table[(phase + (1 << 30)) >> (32 - SLENK)],
+                              sine_table[phase >> (32 - SLENK)]);
+        phase += phase_rate;
+    }
+    *phase_acc = phase;
+}
+#else
+SPAN_DECLARE(void) dds_complexf_block(uint32_t *phase_acc, int32_t phase_rate, complexf_t amp[], int len)
+{
+    int i;
+    uint32_t phase;
+
+    phase = *phase_acc;
+    for (i = 0;  i < len;  i++)
+    {
+        amp[i] = complex_setf(sine_table[(phase + (1 << 30)) >> (32 - SLENK)],
+                              sine_table[phase >> (32 - SLENK)]);
+        phase += phase_rate;
+    }
+    *phase_acc = phase;
+}
+#endif
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(complexf_t) dds_lookup_complexf(uint32_t phase)
 {
     return complex_setf(sine_table[(phase + (1 << 30)) >> (32 - SLENK)],
@@ -37,6 +37,7 @@
 #include <math.h>
 #endif
 #include "floating_fudge.h"
+#include "mmx_sse_decs.h"
 
 #include "spandsp/telephony.h"
 #include "spandsp/complex.h"
@@ -212,7 +213,7 @@ SPAN_DECLARE(int16_t) dds_scaling_dbov(float level)
 }
 /*- End of function --------------------------------------------------------*/
 
-SPAN_DECLARE(int16_t) dds_lookup(uint32_t phase)
+static __inline__ int16_t lookup(uint32_t phase)
 {
     uint32_t step;
     int16_t amp;
@@ -228,9 +229,50 @@ SPAN_DECLARE(int16_t) dds_lookup(uint32_t phase)
 }
 /*- End of function --------------------------------------------------------*/
 
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+static __inline__ __m128i lookup4(__m128i phase)
+{
+    __m128i step;
+    __m128i fold;
+    __m128i sign;
+    __m128i amp;
+    int32_t steps[4];
+
+    /* Work out the table positions, and the signs, for 4 phases at once. Only the table
+       lookups themselves need to be done one at a time. */
+    step = _mm_srli_epi32(phase, DDS_SHIFT);
+    fold = _mm_srai_epi32(_mm_slli_epi32(step, 31 - SLENK), 31);
+    sign = _mm_srai_epi32(_mm_slli_epi32(step, 30 - SLENK), 31);
+    step = _mm_and_si128(_mm_xor_si128(step, fold), _mm_set1_epi32(DDS_STEPS - 1));
+    _mm_storeu_si128((__m128i *) steps, step);
+    amp = _mm_setr_epi32(sine_table[steps[0]], sine_table[steps[1]], sine_table[steps[2]], sine_table[steps[3]]);
+    return _mm_sub_epi32(_mm_xor_si128(amp, sign), sign);
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ __m128i scale4(__m128i amp, __m128i scale)
+{
+    __m128i lo;
+    __m128i hi;
+
+    /* amp and scale are both 16 bit values, in the low half of each 32 bit lane */
+    amp = _mm_packs_epi32(amp, amp);
+    lo = _mm_mullo_epi16(amp, scale);
+    hi = _mm_mulhi_epi16(amp, scale);
+    return _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 15);
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+SPAN_DECLARE(int16_t) dds_lookup(uint32_t phase)
+{
+    return lookup(phase);
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(int16_t) dds_offset(uint32_t phase_acc, int32_t phase_offset)
 {
-    return dds_lookup(phase_acc + phase_offset);
+    return lookup(phase_acc + phase_offset);
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -244,25 +286,115 @@ SPAN_DECLARE(int16_t) dds(uint32_t *phase_acc, int32_t phase_rate)
 {
     int16_t amp;
 
-    amp = dds_lookup(*phase_acc);
+    amp = lookup(*phase_acc);
     *phase_acc += phase_rate;
     return amp;
 }
 /*- End of function --------------------------------------------------------*/
 
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+SPAN_DECLARE(void) dds_block(uint32_t *phase_acc, int32_t phase_rate, int16_t amp[], int len)
+{
+    int i;
+    uint32_t phase;
+    __m128i n1;
+    __m128i n2;
+    __m128i n3;
+
+    phase = *phase_acc;
+    n1 = _mm_setr_epi32(phase, phase + phase_rate, phase + 2*phase_rate, phase + 3*phase_rate);
+    n2 = _mm_set1_epi32(4*phase_rate);
+    for (i = 0;  i + 4 <= len;  i += 4)
+    {
+        n3 = lookup4(n1);
+        _mm_storel_epi64((__m128i *) &amp[i], _mm_packs_epi32(n3, n3));
+        n1 = _mm_add_epi32(n1, n2);
+    }
+    phase += i*phase_rate;
+    /* Now deal with the last 1 to 3 samples */
+    for (  ;  i < len;  i++)
+    {
+        amp[i] = lookup(phase);
+        phase += phase_rate;
+    }
+    *phase_acc = phase;
+}
+#else
+SPAN_DECLARE(void) dds_block(uint32_t *phase_acc, int32_t phase_rate, int16_t amp[], int len)
+{
+    int i;
+    uint32_t phase;
+
+    phase = *phase_acc;
+    for (i = 0;  i < len;  i++)
+    {
+        amp[i] = lookup(phase);
+        phase += phase_rate;
+    }
+    *phase_acc = phase;
+}
+#endif
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(int16_t) dds_mod(uint32_t *phase_acc, int32_t phase_rate, int16_t scale, int32_t phase)
 {
     int16_t amp;
 
-    amp = (int16_t) (((int32_t) dds_lookup(*phase_acc + phase)*(int32_t) scale) >> 15);
+    amp = (int16_t) (((int32_t) lookup(*phase_acc + phase)*(int32_t) scale) >> 15);
     *phase_acc += phase_rate;
     return amp;
 }
 /*- End of function --------------------------------------------------------*/
 
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+SPAN_DECLARE(void) dds_mod_block(uint32_t *phase_acc, int32_t phase_rate, int16_t scale, int32_t phase, int16_t amp[], int len)
+{
+    int i;
+    uint32_t phasex;
+    __m128i n1;
+    __m128i n2;
+    __m128i n3;
+    __m128i n4;
+
+    phasex = *phase_acc + phase;
+    n1 = _mm_setr_epi32(phasex, phasex + phase_rate, phasex + 2*phase_rate, phasex + 3*phase_rate);
+    n2 = _mm_set1_epi32(4*phase_rate);
+    n4 = _mm_set1_epi16(scale);
+    for (i = 0;  i + 4 <= len;  i += 4)
+    {
+        n3 = scale4(lookup4(n1), n4);
+        _mm_storel_epi64((__m128i *) &amp[i], _mm_packs_epi32(n3, n3));
+        n1 = _mm_add_epi32(n1, n2);
+    }
+    phasex += i*phase_rate;
+    /* Now deal with the last 1 to 3 samples */
+    for (  ;  i < len;  i++)
+    {
+        amp[i] = (int16_t) (((int32_t) lookup(phasex)*(int32_t) scale) >> 15);
+        phasex += phase_rate;
+    }
+    *phase_acc = phasex - phase;
+}
+#else
+SPAN_DECLARE(void) dds_mod_block(uint32_t *phase_acc, int32_t phase_rate, int16_t scale, int32_t phase, int16_t amp[], int len)
+{
+    int i;
+    uint32_t phasex;
+
+    phasex = *phase_acc + phase;
+    for (i = 0;  i < len;  i++)
+    {
+        amp[i] = (int16_t) (((int32_t) lookup(phasex)*(int32_t) scale) >> 15);
+        phasex += phase_rate;
+    }
+    *phase_acc = phasex - phase;
+}
+#endif
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(complexi_t) dds_lookup_complexi(uint32_t phase)
 {
-    return complex_seti(dds_lookup(phase + (1 << 30)), dds_lookup(phase));
+    return complex_seti(lookup(phase + (1 << 30)), lookup(phase));
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -270,18 +402,67 @@ SPAN_DECLARE(complexi_t) dds_complexi(uint32_t *phase_acc, int32_t phase_rate)
 {
     complexi_t amp;
 
-    amp = complex_seti(dds_lookup(*phase_acc + (1 << 30)), dds_lookup(*phase_acc));
+    amp = complex_seti(lookup(*phase_acc + (1 << 30)), lookup(*phase_acc));
     *phase_acc += phase_rate;
     return amp;
 }
 /*- End of function --------------------------------------------------------*/
 
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+SPAN_DECLARE(void) dds_complexi_block(uint32_t *phase_acc, int32_t phase_rate, complexi_t amp[], int len)
+{
+    int i;
+    uint32_t phase;
+    __m128i n1;
+    __m128i n2;
+    __m128i n3;
+    __m128i n4;
+    __m128i n5;
+
+    phase = *phase_acc;
+    n1 = _mm_setr_epi32(phase, phase + phase_rate, phase + 2*phase_rate, phase + 3*phase_rate);
+    n2 = _mm_set1_epi32(4*phase_rate);
+    n5 = _mm_set1_epi32(1 << 30);
+    for (i = 0;  i + 4 <= len;  i += 4)
+    {
+        n3 = lookup4(_mm_add_epi32(n1, n5));
+        n4 = lookup4(n1);
+        _mm_storeu_si128((__m128i *) &amp[i], _mm_unpacklo_epi32(n3, n4));
+        _mm_storeu_si128((__m128i *) &amp[i + 2], _mm_unpackhi_epi32(n3, n4));
+        n1 = _mm_add_epi32(n1, n2);
+    }
+    phase += i*phase_rate;
+    /* Now deal with the last 1 to 3 samples */
+    for (  ;  i < len;  i++)
+    {
+        amp[i] = complex_seti(lookup(phase + (1 << 30)), lookup(phase));
+        phase += phase_rate;
+    }
+    *phase_acc = phase;
+}
+#else
+SPAN_DECLARE(void) dds_complexi_block(uint32_t *phase_acc, int32_t phase_rate, complexi_t amp[], int len)
+{
+    int i;
+    uint32_t phase;
+
+    phase = *phase_acc;
+    for (i = 0;  i < len;  i++)
+    {
+        amp[i] = complex_seti(lookup(phase + (1 << 30)), lookup(phase));
+        phase += phase_rate;
+    }
+    *phase_acc = phase;
+}
+#endif
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(complexi_t) dds_complexi_mod(uint32_t *phase_acc, int32_t phase_rate, int16_t scale, int32_t phase)
 {
     complexi_t amp;
 
-    amp = complex_seti(((int32_t) dds_lookup(*phase_acc + phase + (1 << 30))*(int32_t) scale) >> 15,
-                       ((int32_t) dds_lookup(*phase_acc + phase)*(int32_t) scale) >> 15);
+    amp = complex_seti(((int32_t) lookup(*phase_acc + phase + (1 << 30))*(int32_t) scale) >> 15,
+                       ((int32_t) lookup(*phase_acc + phase)*(int32_t) scale) >> 15);
     *phase_acc += phase_rate;
     return amp;
 }
@@ -289,7 +470,7 @@ SPAN_DECLARE(complexi_t) dds_complexi_mod(uint32_t *phase_acc, int32_t phase_rat
 
 SPAN_DECLARE(complexi16_t) dds_lookup_complexi16(uint32_t phase)
 {
-    return complex_seti16(dds_lookup(phase + (1 << 30)), dds_lookup(phase));
+    return complex_seti16(lookup(phase + (1 << 30)), lookup(phase));
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -297,7 +478,7 @@ SPAN_DECLARE(complexi16_t) dds_complexi16(uint32_t *phase_acc, int32_t phase_rat
 {
     complexi16_t amp;
 
-    amp = complex_seti16(dds_lookup(*phase_acc + (1 << 30)), dds_lookup(*phase_acc));
+    amp = complex_seti16(lookup(*phase_acc + (1 << 30)), lookup(*phase_acc));
     *phase_acc += phase_rate;
     return amp;
 }
@@ -307,8 +488,8 @@ SPAN_DECLARE(complexi16_t) dds_complexi16_mod(uint32_t *phase_acc, int32_t phase
 {
     complexi16_t amp;
 
-    amp = complex_seti16((int16_t) (((int32_t) dds_lookup(*phase_acc + phase + (1 << 30))*(int32_t) scale) >> 15),
-                         (int16_t) (((int32_t) dds_lookup(*phase_acc + phase)*(int32_t) scale) >> 15));
+    amp = complex_seti16((int16_t) (((int32_t) lookup(*phase_acc + phase + (1 << 30))*(int32_t) scale) >> 15),
+                         (int16_t) (((int32_t) lookup(*phase_acc + phase)*(int32_t) scale) >> 15));
     *phase_acc += phase_rate;
     return amp;
 }
@@ -316,7 +497,7 @@ SPAN_DECLARE(complexi16_t) dds_complexi16_mod(uint32_t *phase_acc, int32_t phase
 
 SPAN_DECLARE(complexi32_t) dds_lookup_complexi32(uint32_t phase)
 {
-    return complex_seti32(dds_lookup(phase + (1 << 30)), dds_lookup(phase));
+    return complex_seti32(lookup(phase + (1 << 30)), lookup(phase));
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -324,7 +505,7 @@ SPAN_DECLARE(complexi32_t) dds_complexi32(uint32_t *phase_acc, int32_t phase_rat
 {
     complexi32_t amp;
 
-    amp = complex_seti32(dds_lookup(*phase_acc + (1 << 30)), dds_lookup(*phase_acc));
+    amp = complex_seti32(lookup(*phase_acc + (1 << 30)), lookup(*phase_acc));
     *phase_acc += phase_rate;
     return amp;
 }
@@ -334,8 +515,8 @@ SPAN_DECLARE(complexi32_t) dds_complexi32_mod(uint32_t *phase_acc, int32_t phase
 {
     complexi32_t amp;
 
-    amp = complex_seti32(((int32_t) dds_lookup(*phase_acc + phase + (1 << 30))*(int32_t) scale) >> 15,
-                         ((int32_t) dds_lookup(*phase_acc + phase)*(int32_t) scale) >> 15);
+    amp = complex_seti32(((int32_t) lookup(*phase_acc + phase + (1 << 30))*(int32_t) scale) >> 15,
+                         ((int32_t) lookup(*phase_acc + phase)*(int32_t) scale) >> 15);
     *phase_acc += phase_rate;
     return amp;
 }
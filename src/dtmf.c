@@ -44,6 +44,7 @@
 #include <fcntl.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/fast_convert.h"
 #include "spandsp/queue.h"
 #include "spandsp/complex.h"
@@ -92,11 +93,37 @@ static const float dtmf_col[] =
 
 static const char dtmf_positions[] = "123A" "456B" "789C" "*0#D";
 
-static goertzel_descriptor_t dtmf_detect_row[4];
-static goertzel_descriptor_t dtmf_detect_col[4];
-
-static int dtmf_tx_inited = FALSE;
-static tone_gen_descriptor_t dtmf_digit_tones[16];
+/* The Goertzel descriptors for the row and column frequencies are constant, so they are
+   precomputed [fac = 2.0*cos(2.0*pi*f/SAMPLE_RATE), scaled by 16383 for fixed point] rather
+   than built on first use. They are shared by every receiver, in any thread. */
+static const goertzel_descriptor_t dtmf_detect_row[4] =
+{
+#if defined(SPANDSP_USE_FIXED_POINT)
+    {27977, DTMF_SAMPLES_PER_BLOCK},        /* 697Hz */
+    {26954, DTMF_SAMPLES_PER_BLOCK},        /* 770Hz */
+    {25699, DTMF_SAMPLES_PER_BLOCK},        /* 852Hz */
+    {24217, DTMF_SAMPLES_PER_BLOCK}         /* 941Hz */
+#else
+    {1.7077378f, DTMF_SAMPLES_PER_BLOCK},   /* 697Hz */
+    {1.6452811f, DTMF_SAMPLES_PER_BLOCK},   /* 770Hz */
+    {1.568687f, DTMF_SAMPLES_PER_BLOCK},    /* 852Hz */
+    {1.4782046f, DTMF_SAMPLES_PER_BLOCK}    /* 941Hz */
+#endif
+};
+static const goertzel_descriptor_t dtmf_detect_col[4] =
+{
+#if defined(SPANDSP_USE_FIXED_POINT)
+    {19071, DTMF_SAMPLES_PER_BLOCK},        /* 1209Hz */
+    {16323, DTMF_SAMPLES_PER_BLOCK},        /* 1336Hz */
+    {13083, DTMF_SAMPLES_PER_BLOCK},        /* 1477Hz */
+    { 9314, DTMF_SAMPLES_PER_BLOCK}         /* 1633Hz */
+#else
+    {1.164104f, DTMF_SAMPLES_PER_BLOCK},    /* 1209Hz */
+    {0.9963702f, DTMF_SAMPLES_PER_BLOCK},   /* 1336Hz */
+    {0.7986184f, DTMF_SAMPLES_PER_BLOCK},   /* 1477Hz */
+    {0.5685327f, DTMF_SAMPLES_PER_BLOCK}    /* 1633Hz */
+#endif
+};
 
 SPAN_DECLARE(int) dtmf_rx(dtmf_rx_state_t *s, const int16_t amp[], int samples)
 {
@@ -362,11 +389,10 @@ SPAN_DECLARE(dtmf_rx_state_t *) dtmf_rx_init(dtmf_rx_state_t *s,
                                              void *user_data)
 {
     int i;
-    static int initialised = FALSE;
 
     if (s == NULL)
     {
-        if ((s = (dtmf_rx_state_t *) malloc(sizeof (*s))) == NULL)
+        if ((s = (dtmf_rx_state_t *) span_alloc(sizeof (*s))) == NULL)
             return  NULL;
     }
     s->digits_callback = callback;
@@ -381,15 +407,6 @@ SPAN_DECLARE(dtmf_rx_state_t *) dtmf_rx_init(dtmf_rx_state_t *s,
     s->in_digit = 0;
     s->last_hit = 0;
 
-    if (!initialised)
-    {
-        for (i = 0;  i < 4;  i++)
-        {
-            make_goertzel_descriptor(&dtmf_detect_row[i], dtmf_row[i], DTMF_SAMPLES_PER_BLOCK);
-            make_goertzel_descriptor(&dtmf_detect_col[i], dtmf_col[i], DTMF_SAMPLES_PER_BLOCK);
-        }
-        initialised = TRUE;
-    }
     for (i = 0;  i < 4;  i++)
     {
         goertzel_init(&s->row_out[i], &dtmf_detect_row[i]);
@@ -416,35 +433,33 @@ SPAN_DECLARE(int) dtmf_rx_release(dtmf_rx_state_t *s)
 
 SPAN_DECLARE(int) dtmf_rx_free(dtmf_rx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
 
-static void dtmf_tx_initialise(void)
+static void dtmf_tx_start_digit(dtmf_tx_state_t *s, int pos)
 {
-    int row;
-    int col;
-
-    if (dtmf_tx_inited)
-        return;
-    for (row = 0;  row < 4;  row++)
-    {
-        for (col = 0;  col < 4;  col++)
-        {
-            tone_gen_descriptor_init(&dtmf_digit_tones[row*4 + col],
-                                     (int) dtmf_row[row],
-                                     DEFAULT_DTMF_TX_LEVEL,
-                                     (int) dtmf_col[col],
-                                     DEFAULT_DTMF_TX_LEVEL,
-                                     DEFAULT_DTMF_TX_ON_TIME,
-                                     DEFAULT_DTMF_TX_OFF_TIME,
-                                     0,
-                                     0,
-                                     FALSE);
-        }
-    }
-    dtmf_tx_inited = TRUE;
+    tone_gen_descriptor_t tone;
+
+    /* Only the frequencies are taken from the descriptor. The levels and timing are
+       this transmitter's own. Building the descriptor here, rather than in a table
+       shared by all transmitters, costs little, as it happens once per digit. */
+    tone_gen_descriptor_init(&tone,
+                             (int) dtmf_row[pos >> 2],
+                             DEFAULT_DTMF_TX_LEVEL,
+                             (int) dtmf_col[pos & 3],
+                             DEFAULT_DTMF_TX_LEVEL,
+                             DEFAULT_DTMF_TX_ON_TIME,
+                             DEFAULT_DTMF_TX_OFF_TIME,
+                             0,
+                             0,
+                             FALSE);
+    tone_gen_init(&(s->tones), &tone);
+    s->tones.tone[0].gain = s->low_level;
+    s->tones.tone[1].gain = s->high_level;
+    s->tones.duration[0] = s->on_time;
+    s->tones.duration[1] = s->off_time;
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -467,11 +482,7 @@ SPAN_DECLARE(int) dtmf_tx(dtmf_tx_state_t *s, int16_t amp[], int max_samples)
             continue;
         if ((cp = strchr(dtmf_positions, digit)) == NULL)
             continue;
-        tone_gen_init(&(s->tones), &dtmf_digit_tones[cp - dtmf_positions]);
-        s->tones.tone[0].gain = s->low_level;
-        s->tones.tone[1].gain = s->high_level;
-        s->tones.duration[0] = s->on_time;
-        s->tones.duration[1] = s->off_time;
+        dtmf_tx_start_digit(s, cp - dtmf_positions);
         len += tone_gen(&(s->tones), amp + len, max_samples - len);
     }
     return len;
@@ -516,14 +527,12 @@ SPAN_DECLARE(dtmf_tx_state_t *) dtmf_tx_init(dtmf_tx_state_t *s)
 {
     if (s == NULL)
     {
-        if ((s = (dtmf_tx_state_t *) malloc(sizeof (*s))) == NULL)
+        if ((s = (dtmf_tx_state_t *) span_alloc(sizeof (*s))) == NULL)
             return  NULL;
     }
-    if (!dtmf_tx_inited)
-        dtmf_tx_initialise();
-    tone_gen_init(&(s->tones), &dtmf_digit_tones[0]);
     dtmf_tx_set_level(s, DEFAULT_DTMF_TX_LEVEL, 0);
     dtmf_tx_set_timing(s, -1, -1);
+    dtmf_tx_start_digit(s, 0);
     queue_init(&s->queue.queue, MAX_DTMF_DIGITS, QUEUE_READ_ATOMIC | QUEUE_WRITE_ATOMIC);
     s->tones.current_section = -1;
     return s;
@@ -538,7 +547,7 @@ SPAN_DECLARE(int) dtmf_tx_release(dtmf_tx_state_t *s)
 
 SPAN_DECLARE(int) dtmf_tx_free(dtmf_tx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -50,6 +50,7 @@
 #include <tiffio.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
 #include "spandsp/queue.h"
 #include "spandsp/dc_restore.h"
@@ -425,6 +426,7 @@ static void fax_set_rx_type(void *user_data, int type, int bit_rate, int short_t
 {
     fax_state_t *s;
     put_bit_func_t put_bit_func;
+    put_bits_func_t put_bits_func;
     void *put_bit_user_data;
     fax_modems_state_t *t;
 
@@ -438,34 +440,40 @@ static void fax_set_rx_type(void *user_data, int type, int bit_rate, int short_t
     if (use_hdlc)
     {
         put_bit_func = (put_bit_func_t) hdlc_rx_put_bit;
+        put_bits_func = (put_bits_func_t) hdlc_rx_put_bits;
         put_bit_user_data = (void *) &t->hdlc_rx;
         hdlc_rx_init(&t->hdlc_rx, FALSE, TRUE, HDLC_FRAMING_OK_THRESHOLD, t30_hdlc_accept, &s->t30);
     }
     else
     {
         put_bit_func = t30_non_ecm_put_bit;
+        put_bits_func = NULL;
         put_bit_user_data = (void *) &s->t30;
     }
     switch (type)
     {
     case T30_MODEM_V21:
         fsk_rx_init(&t->v21_rx, &preset_fsk_specs[FSK_V21CH2], FSK_FRAME_MODE_SYNC, (put_bit_func_t) hdlc_rx_put_bit, put_bit_user_data);
+        fsk_rx_set_put_bits(&t->v21_rx, (put_bits_func_t) hdlc_rx_put_bits);
         fsk_rx_signal_cutoff(&t->v21_rx, -45.5f);
         set_rx_handler(s, (span_rx_handler_t *) &fsk_rx, (span_rx_fillin_handler_t *) &fsk_rx_fillin, &t->v21_rx);
         break;
     case T30_MODEM_V27TER:
         v27ter_rx_restart(&t->v27ter_rx, bit_rate, FALSE);
         v27ter_rx_set_put_bit(&t->v27ter_rx, put_bit_func, put_bit_user_data);
+        v27ter_rx_set_put_bits(&t->v27ter_rx, put_bits_func);
         set_rx_handler(s, &v27ter_v21_rx, &v27ter_v21_rx_fillin, s);
         break;
     case T30_MODEM_V29:
         v29_rx_restart(&t->v29_rx, bit_rate, FALSE);
         v29_rx_set_put_bit(&t->v29_rx, put_bit_func, put_bit_user_data);
+        v29_rx_set_put_bits(&t->v29_rx, put_bits_func);
         set_rx_handler(s, &v29_v21_rx, &v29_v21_rx_fillin, s);
         break;
     case T30_MODEM_V17:
         v17_rx_restart(&t->v17_rx, bit_rate, short_train);
         v17_rx_set_put_bit(&t->v17_rx, put_bit_func, put_bit_user_data);
+        v17_rx_set_put_bits(&t->v17_rx, put_bits_func);
         set_rx_handler(s, &v17_v21_rx, &v17_v21_rx_fillin, s);
         break;
     case T30_MODEM_DONE:
@@ -481,6 +489,7 @@ static void fax_set_tx_type(void *user_data, int type, int bit_rate, int short_t
 {
     fax_state_t *s;
     get_bit_func_t get_bit_func;
+    get_bits_func_t get_bits_func;
     void *get_bit_user_data;
     fax_modems_state_t *t;
     int tone;
@@ -493,11 +502,13 @@ static void fax_set_tx_type(void *user_data, int type, int bit_rate, int short_t
     if (use_hdlc)
     {
         get_bit_func = (get_bit_func_t) hdlc_tx_get_bit;
+        get_bits_func = (get_bits_func_t) hdlc_tx_get_bits;
         get_bit_user_data = (void *) &t->hdlc_tx;
     }
     else
     {
         get_bit_func = t30_non_ecm_get_bit;
+        get_bits_func = NULL;
         get_bit_user_data = (void *) &s->t30;
     }
     switch (type)
@@ -521,6 +532,7 @@ static void fax_set_tx_type(void *user_data, int type, int bit_rate, int short_t
         break;
     case T30_MODEM_V21:
         fsk_tx_init(&t->v21_tx, &preset_fsk_specs[FSK_V21CH2], get_bit_func, get_bit_user_data);
+        fsk_tx_set_get_bits(&t->v21_tx, get_bits_func);
         /* The spec says 1s +-15% of preamble. So, the minimum is 32 octets. */
         hdlc_tx_flags(&t->hdlc_tx, 32);
         /* Pause before switching from phase C, as per T.30 5.3.2.2. If we omit this, the receiver
@@ -538,6 +550,7 @@ static void fax_set_tx_type(void *user_data, int type, int bit_rate, int short_t
         hdlc_tx_flags(&t->hdlc_tx, bit_rate/(8*5));
         v27ter_tx_restart(&t->v27ter_tx, bit_rate, t->use_tep);
         v27ter_tx_set_get_bit(&t->v27ter_tx, get_bit_func, get_bit_user_data);
+        v27ter_tx_set_get_bits(&t->v27ter_tx, get_bits_func);
         set_tx_handler(s, (span_tx_handler_t *) &silence_gen, &t->silence_gen);
         set_next_tx_handler(s, (span_tx_handler_t *) &v27ter_tx, &t->v27ter_tx);
         t->transmit = TRUE;
@@ -548,6 +561,7 @@ static void fax_set_tx_type(void *user_data, int type, int bit_rate, int short_t
         hdlc_tx_flags(&t->hdlc_tx, bit_rate/(8*5));
         v29_tx_restart(&t->v29_tx, bit_rate, t->use_tep);
         v29_tx_set_get_bit(&t->v29_tx, get_bit_func, get_bit_user_data);
+        v29_tx_set_get_bits(&t->v29_tx, get_bits_func);
         set_tx_handler(s, (span_tx_handler_t *) &silence_gen, &t->silence_gen);
         set_next_tx_handler(s, (span_tx_handler_t *) &v29_tx, &t->v29_tx);
         t->transmit = TRUE;
@@ -558,6 +572,7 @@ static void fax_set_tx_type(void *user_data, int type, int bit_rate, int short_t
         hdlc_tx_flags(&t->hdlc_tx, bit_rate/(8*5));
         v17_tx_restart(&t->v17_tx, bit_rate, t->use_tep, short_train);
         v17_tx_set_get_bit(&t->v17_tx, get_bit_func, get_bit_user_data);
+        v17_tx_set_get_bits(&t->v17_tx, get_bits_func);
         set_tx_handler(s, (span_tx_handler_t *) &silence_gen, &t->silence_gen);
         set_next_tx_handler(s, (span_tx_handler_t *) &v17_tx, &t->v17_tx);
         t->transmit = TRUE;
@@ -601,6 +616,13 @@ SPAN_DECLARE(logging_state_t *) fax_get_logging_state(fax_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) fax_get_memory_usage(fax_state_t *s)
+{
+    /* The T.30 context is part of the FAX context, so only its buffers are added. */
+    return sizeof(*s) + t30_get_memory_usage(&s->t30) - sizeof(s->t30);
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(int) fax_restart(fax_state_t *s, int calling_party)
 {
 #if 0
@@ -670,7 +692,7 @@ SPAN_DECLARE(fax_state_t *) fax_init(fax_state_t *s, int calling_party)
 
     if (s == NULL)
     {
-        if ((s = (fax_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (fax_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -727,7 +749,7 @@ SPAN_DECLARE(int) fax_release(fax_state_t *s)
 SPAN_DECLARE(int) fax_free(fax_state_t *s)
 {
     t30_release(&s->t30);
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -48,6 +48,7 @@
 #endif
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
 #include "spandsp/bit_operations.h"
 #include "spandsp/dc_restore.h"
@@ -86,6 +87,13 @@
 
 #define HDLC_FRAMING_OK_THRESHOLD               5
 
+/*! The level below which fax_modems_multi_rx() does not bother running the fast
+    receivers. This is a little below the lowest default cutoff of those receivers. */
+#define MULTI_RX_CARRIER_ON_DBM0                -48.0f
+/*! The time the fast receivers continue to be run after the signal has dropped
+    below the threshold, so they see their carrier fall. */
+#define MULTI_RX_HANGOVER                       ms_to_samples(100)
+
 SPAN_DECLARE_NONSTD(int) fax_modems_v17_v21_rx(void *user_data, const int16_t amp[], int len)
 {
     fax_modems_state_t *s;
@@ -256,6 +264,203 @@ SPAN_DECLARE(void) fax_modems_start_rx_modem(fax_modems_state_t *s, int which)
 }
 /*- End of function --------------------------------------------------------*/
 
+static int multi_rx_status(fax_modems_state_t *s, int which, int status)
+{
+    /* Once a receiver has won, everything it reports goes to its user. Until then,
+       the user hears nothing from the candidates, as most of them will fail. */
+    if (s->multi_rx_trained)
+        return (s->multi_rx_trained == which);
+    switch (status)
+    {
+    case SIG_STATUS_TRAINING_SUCCEEDED:
+        s->multi_rx_trained = which;
+        s->multi_rx_candidates = which;
+        return TRUE;
+    case SIG_STATUS_TRAINING_FAILED:
+        s->multi_rx_candidates &= ~which;
+        break;
+    }
+    return FALSE;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void v17_multi_rx_status_handler(void *user_data, int status)
+{
+    fax_modems_state_t *s;
+
+    s = (fax_modems_state_t *) user_data;
+    if (!multi_rx_status(s, FAX_MODEMS_MULTI_RX_V17, status))
+        return;
+    if (status == SIG_STATUS_TRAINING_SUCCEEDED)
+    {
+        span_log(&s->logging, SPAN_LOG_FLOW, "Switching from multiple modems + V.21 to V.17 (%.2fdBm0)\n", v17_rx_signal_power(&s->v17_rx));
+        s->rx_handler = (span_rx_handler_t *) &v17_rx;
+        s->rx_fillin_handler = (span_rx_fillin_handler_t *) &v17_rx_fillin;
+        s->rx_user_data = &s->v17_rx;
+        /* The training was kept from the user while it was not known to be real. */
+        s->v17_rx.put_bit(s->v17_rx.put_bit_user_data, SIG_STATUS_TRAINING_IN_PROGRESS);
+    }
+    s->v17_rx.put_bit(s->v17_rx.put_bit_user_data, status);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void v27ter_multi_rx_status_handler(void *user_data, int status)
+{
+    fax_modems_state_t *s;
+
+    s = (fax_modems_state_t *) user_data;
+    if (!multi_rx_status(s, FAX_MODEMS_MULTI_RX_V27TER, status))
+        return;
+    if (status == SIG_STATUS_TRAINING_SUCCEEDED)
+    {
+        span_log(&s->logging, SPAN_LOG_FLOW, "Switching from multiple modems + V.21 to V.27ter (%.2fdBm0)\n", v27ter_rx_signal_power(&s->v27ter_rx));
+        s->rx_handler = (span_rx_handler_t *) &v27ter_rx;
+        s->rx_fillin_handler = (span_rx_fillin_handler_t *) &v27ter_rx_fillin;
+        s->rx_user_data = &s->v27ter_rx;
+        s->v27ter_rx.put_bit(s->v27ter_rx.put_bit_user_data, SIG_STATUS_TRAINING_IN_PROGRESS);
+    }
+    s->v27ter_rx.put_bit(s->v27ter_rx.put_bit_user_data, status);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void v29_multi_rx_status_handler(void *user_data, int status)
+{
+    fax_modems_state_t *s;
+
+    s = (fax_modems_state_t *) user_data;
+    if (!multi_rx_status(s, FAX_MODEMS_MULTI_RX_V29, status))
+        return;
+    if (status == SIG_STATUS_TRAINING_SUCCEEDED)
+    {
+        span_log(&s->logging, SPAN_LOG_FLOW, "Switching from multiple modems + V.21 to V.29 (%.2fdBm0)\n", v29_rx_signal_power(&s->v29_rx));
+        s->rx_handler = (span_rx_handler_t *) &v29_rx;
+        s->rx_fillin_handler = (span_rx_fillin_handler_t *) &v29_rx_fillin;
+        s->rx_user_data = &s->v29_rx;
+        s->v29_rx.put_bit(s->v29_rx.put_bit_user_data, SIG_STATUS_TRAINING_IN_PROGRESS);
+    }
+    s->v29_rx.put_bit(s->v29_rx.put_bit_user_data, status);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void multi_rx_restart(fax_modems_state_t *s)
+{
+    s->multi_rx_candidates = 0;
+    s->multi_rx_trained = 0;
+    if (s->multi_rx_bit_rate[0])
+    {
+        v17_rx_restart(&s->v17_rx, s->multi_rx_bit_rate[0], s->multi_rx_short_train);
+        s->multi_rx_candidates |= FAX_MODEMS_MULTI_RX_V17;
+    }
+    if (s->multi_rx_bit_rate[1])
+    {
+        v27ter_rx_restart(&s->v27ter_rx, s->multi_rx_bit_rate[1], FALSE);
+        s->multi_rx_candidates |= FAX_MODEMS_MULTI_RX_V27TER;
+    }
+    if (s->multi_rx_bit_rate[2])
+    {
+        v29_rx_restart(&s->v29_rx, s->multi_rx_bit_rate[2], FALSE);
+        s->multi_rx_candidates |= FAX_MODEMS_MULTI_RX_V29;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE_NONSTD(int) fax_modems_multi_rx(void *user_data, const int16_t amp[], int len)
+{
+    fax_modems_state_t *s;
+    int32_t power;
+    int active;
+    int i;
+
+    s = (fax_modems_state_t *) user_data;
+    /* A single carrier detector is shared by all the fast receivers. While there is
+       nothing which might be a modem signal, only the V.21 receiver is run. Once there
+       is, every candidate runs its full demodulator on every sample, until one trains. */
+    active = FALSE;
+    for (i = 0;  i < len;  i++)
+    {
+        power = power_meter_update(&s->multi_rx_power, amp[i]);
+        if (power >= s->multi_rx_carrier_on_power)
+            s->multi_rx_hangover = MULTI_RX_HANGOVER;
+        else if (s->multi_rx_hangover > 0)
+            s->multi_rx_hangover--;
+        if (s->multi_rx_hangover > 0)
+            active = TRUE;
+    }
+    if (active)
+    {
+        s->multi_rx_active = TRUE;
+        /* Whichever receiver trains first takes over the receive path, through its
+           status handler, and the others are dropped at that point. */
+        if ((s->multi_rx_candidates & FAX_MODEMS_MULTI_RX_V17))
+            v17_rx(&s->v17_rx, amp, len);
+        if ((s->multi_rx_candidates & FAX_MODEMS_MULTI_RX_V27TER)  &&  !s->multi_rx_trained)
+            v27ter_rx(&s->v27ter_rx, amp, len);
+        if ((s->multi_rx_candidates & FAX_MODEMS_MULTI_RX_V29)  &&  !s->multi_rx_trained)
+            v29_rx(&s->v29_rx, amp, len);
+    }
+    else if (s->multi_rx_active)
+    {
+        /* The burst of signal has ended without any fast receiver training. Have
+           all the candidates ready to try again on the next burst. */
+        s->multi_rx_active = FALSE;
+        multi_rx_restart(s);
+    }
+    fsk_rx(&s->v21_rx, amp, len);
+    if (s->rx_frame_received  &&  !s->multi_rx_trained)
+    {
+        /* We have received something, and no fast modem has trained. We must
+           be receiving valid V.21 */
+        span_log(&s->logging, SPAN_LOG_FLOW, "Switching from multiple modems + V.21 to V.21 (%.2fdBm0)\n", fsk_rx_signal_power(&s->v21_rx));
+        s->rx_handler = (span_rx_handler_t *) &fsk_rx;
+        s->rx_fillin_handler = (span_rx_fillin_handler_t *) &fsk_rx_fillin;
+        s->rx_user_data = &s->v21_rx;
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE_NONSTD(int) fax_modems_multi_rx_fillin(void *user_data, int len)
+{
+    fax_modems_state_t *s;
+
+    s = (fax_modems_state_t *) user_data;
+    if (s->multi_rx_active)
+    {
+        if ((s->multi_rx_candidates & FAX_MODEMS_MULTI_RX_V17))
+            v17_rx_fillin(&s->v17_rx, len);
+        if ((s->multi_rx_candidates & FAX_MODEMS_MULTI_RX_V27TER))
+            v27ter_rx_fillin(&s->v27ter_rx, len);
+        if ((s->multi_rx_candidates & FAX_MODEMS_MULTI_RX_V29))
+            v29_rx_fillin(&s->v29_rx, len);
+    }
+    fsk_rx_fillin(&s->v21_rx, len);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void) fax_modems_start_multi_rx_modem(fax_modems_state_t *s,
+                                                   int v17_bit_rate,
+                                                   int v27ter_bit_rate,
+                                                   int v29_bit_rate,
+                                                   int short_train)
+{
+    s->multi_rx_bit_rate[0] = v17_bit_rate;
+    s->multi_rx_bit_rate[1] = v27ter_bit_rate;
+    s->multi_rx_bit_rate[2] = v29_bit_rate;
+    s->multi_rx_short_train = short_train;
+    multi_rx_restart(s);
+    v17_rx_set_modem_status_handler(&s->v17_rx, v17_multi_rx_status_handler, s);
+    v27ter_rx_set_modem_status_handler(&s->v27ter_rx, v27ter_multi_rx_status_handler, s);
+    v29_rx_set_modem_status_handler(&s->v29_rx, v29_multi_rx_status_handler, s);
+
+    power_meter_init(&s->multi_rx_power, 4);
+    s->multi_rx_carrier_on_power = power_meter_level_dbm0(MULTI_RX_CARRIER_ON_DBM0);
+    s->multi_rx_hangover = 0;
+    s->multi_rx_active = FALSE;
+    s->rx_frame_received = FALSE;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) fax_modems_set_tep_mode(fax_modems_state_t *s, int use_tep)
 {
     s->use_tep = use_tep;
@@ -279,7 +484,7 @@ SPAN_DECLARE(fax_modems_state_t *) fax_modems_init(fax_modems_state_t *s,
 {
     if (s == NULL)
     {
-        if ((s = (fax_modems_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (fax_modems_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -288,8 +493,10 @@ SPAN_DECLARE(fax_modems_state_t *) fax_modems_init(fax_modems_state_t *s,
     hdlc_rx_init(&s->hdlc_rx, FALSE, FALSE, HDLC_FRAMING_OK_THRESHOLD, hdlc_accept, user_data);
     hdlc_tx_init(&s->hdlc_tx, FALSE, 2, FALSE, hdlc_tx_underflow, user_data);
     fsk_rx_init(&s->v21_rx, &preset_fsk_specs[FSK_V21CH2], FSK_FRAME_MODE_SYNC, (put_bit_func_t) hdlc_rx_put_bit, &s->hdlc_rx);
+    fsk_rx_set_put_bits(&s->v21_rx, (put_bits_func_t) hdlc_rx_put_bits);
     fsk_rx_signal_cutoff(&s->v21_rx, -39.09f);
     fsk_tx_init(&s->v21_tx, &preset_fsk_specs[FSK_V21CH2], (get_bit_func_t) hdlc_tx_get_bit, &s->hdlc_tx);
+    fsk_tx_set_get_bits(&s->v21_tx, (get_bits_func_t) hdlc_tx_get_bits);
     v17_rx_init(&s->v17_rx, 14400, non_ecm_put_bit, user_data);
     v17_tx_init(&s->v17_tx, 14400, s->use_tep, non_ecm_get_bit, user_data);
     v29_rx_init(&s->v29_rx, 9600, non_ecm_put_bit, user_data);
@@ -327,7 +534,7 @@ SPAN_DECLARE(int) fax_modems_release(fax_modems_state_t *s)
 SPAN_DECLARE(int) fax_modems_free(fax_modems_state_t *s)
 {
     if (s)
-        free(s);
+        span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
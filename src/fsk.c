@@ -41,7 +41,10 @@
 #include "floating_fudge.h"
 #include <assert.h>
 
+#include "mmx_sse_decs.h"
+
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/complex.h"
 #include "spandsp/dds.h"
 #include "spandsp/power_meter.h"
@@ -50,6 +53,10 @@
 
 #include "spandsp/private/fsk.h"
 
+/*! The number of samples for which the receiver's correlations are calculated
+    in one pass. */
+#define FSK_RX_BLOCK_LEN    64
+
 const fsk_spec_t preset_fsk_specs[] =
 {
     {
@@ -138,10 +145,27 @@ SPAN_DECLARE(int) fsk_tx_restart(fsk_tx_state_t *s, const fsk_spec_t *spec)
     s->current_phase_rate = s->phase_rates[1];
     
     s->shutdown = FALSE;
+    s->bit_chunk_len = 0;
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
 
+static __inline__ int get_data_bit(fsk_tx_state_t *s)
+{
+    int n;
+
+    if (s->get_bits == NULL)
+        return s->get_bit(s->get_bit_user_data);
+    if (s->bit_chunk_len <= 0)
+    {
+        if ((n = s->get_bits(s->get_bit_user_data, &s->bit_chunk)) <= 0)
+            return (n < 0)  ?  n  :  SIG_STATUS_END_OF_DATA;
+        s->bit_chunk_len = n;
+    }
+    return (s->bit_chunk >> --s->bit_chunk_len) & 1;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(fsk_tx_state_t *) fsk_tx_init(fsk_tx_state_t *s,
                                            const fsk_spec_t *spec,
                                            get_bit_func_t get_bit,
@@ -149,7 +173,7 @@ SPAN_DECLARE(fsk_tx_state_t *) fsk_tx_init(fsk_tx_state_t *s,
 {
     if (s == NULL)
     {
-        if ((s = (fsk_tx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (fsk_tx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -169,7 +193,7 @@ SPAN_DECLARE(int) fsk_tx_release(fsk_tx_state_t *s)
 
 SPAN_DECLARE(int) fsk_tx_free(fsk_tx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -178,6 +202,7 @@ SPAN_DECLARE_NONSTD(int) fsk_tx(fsk_tx_state_t *s, int16_t amp[], int len)
 {
     int sample;
     int bit;
+    int run;
 
     if (s->shutdown)
         return 0;
@@ -185,12 +210,12 @@ SPAN_DECLARE_NONSTD(int) fsk_tx(fsk_tx_state_t *s, int16_t amp[], int len)
        jumps. There is currently no interpolation for bauds that end mid-sample.
        Mainstream users will not care. Some specialist users might have a problem
        with them, if they care about accurate transition timing. */
-    for (sample = 0;  sample < len;  sample++)
+    for (sample = 0;  sample < len;  sample += run)
     {
         if ((s->baud_frac += s->baud_rate) >= SAMPLE_RATE*100)
         {
             s->baud_frac -= SAMPLE_RATE*100;
-            if ((bit = s->get_bit(s->get_bit_user_data)) == SIG_STATUS_END_OF_DATA)
+            if ((bit = get_data_bit(s)) == SIG_STATUS_END_OF_DATA)
             {
                 if (s->status_handler)
                     s->status_handler(s->status_user_data, SIG_STATUS_END_OF_DATA);
@@ -201,7 +226,12 @@ SPAN_DECLARE_NONSTD(int) fsk_tx(fsk_tx_state_t *s, int16_t amp[], int len)
             }
             s->current_phase_rate = s->phase_rates[bit & 1];
         }
-        amp[sample] = dds_mod(&(s->phase_acc), s->current_phase_rate, s->scaling, 0);
+        /* Generate the tone in one go up to the next baud boundary */
+        run = (SAMPLE_RATE*100 - 1 - s->baud_frac)/s->baud_rate + 1;
+        if (run > len - sample)
+            run = len - sample;
+        s->baud_frac += (run - 1)*s->baud_rate;
+        dds_mod_block(&(s->phase_acc), s->current_phase_rate, s->scaling, 0, &amp[sample], run);
     }
     return sample;
 }
@@ -215,11 +245,20 @@ SPAN_DECLARE(void) fsk_tx_power(fsk_tx_state_t *s, float power)
 
 SPAN_DECLARE(void) fsk_tx_set_get_bit(fsk_tx_state_t *s, get_bit_func_t get_bit, void *user_data)
 {
+    s->get_bits = NULL;
+    s->bit_chunk_len = 0;
     s->get_bit = get_bit;
     s->get_bit_user_data = user_data;
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(void) fsk_tx_set_get_bits(fsk_tx_state_t *s, get_bits_func_t get_bits)
+{
+    s->get_bits = get_bits;
+    s->bit_chunk_len = 0;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) fsk_tx_set_modem_status_handler(fsk_tx_state_t *s, modem_tx_status_func_t handler, void *user_data)
 {
     s->status_handler = handler;
@@ -241,13 +280,47 @@ SPAN_DECLARE(float) fsk_rx_signal_power(fsk_rx_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
+static __inline__ void flush_bit_chunk(fsk_rx_state_t *s)
+{
+    if (s->bit_chunk_len)
+    {
+        s->put_bits(s->put_bit_user_data, s->bit_chunk & ((1 << s->bit_chunk_len) - 1), s->bit_chunk_len);
+        s->bit_chunk_len = 0;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ void put_bit(fsk_rx_state_t *s, int bit)
+{
+    if (s->put_bits)
+    {
+        s->bit_chunk = (s->bit_chunk << 1) | bit;
+        if (++s->bit_chunk_len >= 16)
+            flush_bit_chunk(s);
+    }
+    else
+    {
+        s->put_bit(s->put_bit_user_data, bit);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) fsk_rx_set_put_bit(fsk_rx_state_t *s, put_bit_func_t put_bit, void *user_data)
 {
+    flush_bit_chunk(s);
+    s->put_bits = NULL;
     s->put_bit = put_bit;
     s->put_bit_user_data = user_data;
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(void) fsk_rx_set_put_bits(fsk_rx_state_t *s, put_bits_func_t put_bits)
+{
+    flush_bit_chunk(s);
+    s->put_bits = put_bits;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) fsk_rx_set_modem_status_handler(fsk_rx_state_t *s, modem_tx_status_func_t handler, void *user_data)
 {
     s->status_handler = handler;
@@ -311,7 +384,7 @@ SPAN_DECLARE(fsk_rx_state_t *) fsk_rx_init(fsk_rx_state_t *s,
 {
     if (s == NULL)
     {
-        if ((s = (fsk_rx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (fsk_rx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -331,13 +404,14 @@ SPAN_DECLARE(int) fsk_rx_release(fsk_rx_state_t *s)
 
 SPAN_DECLARE(int) fsk_rx_free(fsk_rx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
 
 static void report_status_change(fsk_rx_state_t *s, int status)
 {
+    flush_bit_chunk(s);
     if (s->status_handler)
         s->status_handler(s->status_user_data, status);
     else if (s->put_bit)
@@ -345,221 +419,299 @@ static void report_status_change(fsk_rx_state_t *s, int status)
 }
 /*- End of function --------------------------------------------------------*/
 
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+static void correlate_block(int32_t re[], int32_t im[], const int16_t ref_re[], const int16_t ref_im[], const int16_t amp[], int len, int shift)
+{
+    int i;
+    __m128i a;
+    __m128i n0;
+    __m128i n1;
+    __m128i lo;
+    __m128i hi;
+    __m128i sh;
+
+    sh = _mm_cvtsi32_si128(shift);
+    if ((i = len & ~7))
+    {
+        for (i -= 8;  i >= 0;  i -= 8)
+        {
+            /* Build the 32 bit products from the low and high halves of 16x16
+               bit multiplies, and scale them exactly as the plain C code does. */
+            a = _mm_loadu_si128((const __m128i *) (amp + i));
+            n0 = _mm_loadu_si128((const __m128i *) (ref_re + i));
+            lo = _mm_mullo_epi16(n0, a);
+            hi = _mm_mulhi_epi16(n0, a);
+            n0 = _mm_sra_epi32(_mm_unpacklo_epi16(lo, hi), sh);
+            n1 = _mm_sra_epi32(_mm_unpackhi_epi16(lo, hi), sh);
+            _mm_storeu_si128((__m128i *) (re + i), n0);
+            _mm_storeu_si128((__m128i *) (re + i + 4), n1);
+            n0 = _mm_loadu_si128((const __m128i *) (ref_im + i));
+            lo = _mm_mullo_epi16(n0, a);
+            hi = _mm_mulhi_epi16(n0, a);
+            n0 = _mm_sra_epi32(_mm_unpacklo_epi16(lo, hi), sh);
+            n1 = _mm_sra_epi32(_mm_unpackhi_epi16(lo, hi), sh);
+            _mm_storeu_si128((__m128i *) (im + i), n0);
+            _mm_storeu_si128((__m128i *) (im + i + 4), n1);
+        }
+    }
+    /* Now deal with the last 1 to 7 elements, which don't fill an SSE2 register */
+    for (i = len & ~7;  i < len;  i++)
+    {
+        re[i] = (ref_re[i]*amp[i]) >> shift;
+        im[i] = (ref_im[i]*amp[i]) >> shift;
+    }
+}
+#else
+static void correlate_block(int32_t re[], int32_t im[], const int16_t ref_re[], const int16_t ref_im[], const int16_t amp[], int len, int shift)
+{
+    int i;
+
+    for (i = 0;  i < len;  i++)
+    {
+        re[i] = (ref_re[i]*amp[i]) >> shift;
+        im[i] = (ref_im[i]*amp[i]) >> shift;
+    }
+}
+#endif
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE_NONSTD(int) fsk_rx(fsk_rx_state_t *s, const int16_t *amp, int len)
 {
     int buf_ptr;
     int baudstate;
     int i;
     int j;
+    int k;
+    int chunk;
+    uint32_t phase;
     int16_t x;
     int32_t dot;
     int32_t sum[2];
     int32_t power;
-    complexi_t ph;
+    int16_t ref_re[FSK_RX_BLOCK_LEN];
+    int16_t ref_im[FSK_RX_BLOCK_LEN];
+    int32_t corr_re[2][FSK_RX_BLOCK_LEN];
+    int32_t corr_im[2][FSK_RX_BLOCK_LEN];
 
     buf_ptr = s->buf_ptr;
 
-    for (i = 0;  i < len;  i++)
+    for (k = 0;  k < len;  k += chunk)
     {
-        /* The *totally* asynchronous character to character behaviour of these
-           modems, when carrying async. data, seems to force a sample by sample
-           approach. */
+        /* The reference tones, and their products with the signal, do not depend
+           on anything the receiver decides. They are calculated for a block of
+           samples in one pass. Only the sliding window sums and the symbol timing
+           need to be worked through sample by sample. */
+        if ((chunk = len - k) > FSK_RX_BLOCK_LEN)
+            chunk = FSK_RX_BLOCK_LEN;
         for (j = 0;  j < 2;  j++)
         {
-            s->dot[j].re -= s->window[j][buf_ptr].re;
-            s->dot[j].im -= s->window[j][buf_ptr].im;
+            phase = s->phase_acc[j] + (1 << 30);
+            dds_block(&phase, s->phase_rate[j], ref_re, chunk);
+            dds_block(&s->phase_acc[j], s->phase_rate[j], ref_im, chunk);
+            correlate_block(corr_re[j], corr_im[j], ref_re, ref_im, &amp[k], chunk, s->scaling_shift);
+        }
+        for (i = 0;  i < chunk;  i++)
+        {
+            /* The *totally* asynchronous character to character behaviour of these
+               modems, when carrying async. data, seems to force a sample by sample
+               approach. */
+            for (j = 0;  j < 2;  j++)
+            {
+                s->dot[j].re -= s->window[j][buf_ptr].re;
+                s->dot[j].im -= s->window[j][buf_ptr].im;
 
-            ph = dds_complexi(&(s->phase_acc[j]), s->phase_rate[j]);
-            s->window[j][buf_ptr].re = (ph.re*amp[i]) >> s->scaling_shift;
-            s->window[j][buf_ptr].im = (ph.im*amp[i]) >> s->scaling_shift;
+                s->window[j][buf_ptr].re = corr_re[j][i];
+                s->window[j][buf_ptr].im = corr_im[j][i];
 
-            s->dot[j].re += s->window[j][buf_ptr].re;
-            s->dot[j].im += s->window[j][buf_ptr].im;
+                s->dot[j].re += s->window[j][buf_ptr].re;
+                s->dot[j].im += s->window[j][buf_ptr].im;
 
-            dot = s->dot[j].re >> 15;
-            sum[j] = dot*dot;
-            dot = s->dot[j].im >> 15;
-            sum[j] += dot*dot;
-        }
-        /* If there isn't much signal, don't demodulate - it will only produce
-           useless junk results. */
-        /* There should be no DC in the signal, but sometimes there is.
-           We need to measure the power with the DC blocked, but not using
-           a slow to respond DC blocker. Use the most elementary HPF. */
-        x = amp[i] >> 1;
-        power = power_meter_update(&(s->power), x - s->last_sample);
-        s->last_sample = x;
-        if (s->signal_present)
-        {
-            /* Look for power below turn-off threshold to turn the carrier off */
-            if (power < s->carrier_off_power)
+                dot = s->dot[j].re >> 15;
+                sum[j] = dot*dot;
+                dot = s->dot[j].im >> 15;
+                sum[j] += dot*dot;
+            }
+            /* If there isn't much signal, don't demodulate - it will only produce
+               useless junk results. */
+            /* There should be no DC in the signal, but sometimes there is.
+               We need to measure the power with the DC blocked, but not using
+               a slow to respond DC blocker. Use the most elementary HPF. */
+            x = amp[k + i] >> 1;
+            power = power_meter_update(&(s->power), x - s->last_sample);
+            s->last_sample = x;
+            if (s->signal_present)
             {
-                if (--s->signal_present <= 0)
+                /* Look for power below turn-off threshold to turn the carrier off */
+                if (power < s->carrier_off_power)
                 {
-                    /* Count down a short delay, to ensure we push the last
-                       few bits through the filters before stopping. */
-                    report_status_change(s, SIG_STATUS_CARRIER_DOWN);
-                    s->baud_phase = 0;
-                    continue;
+                    if (--s->signal_present <= 0)
+                    {
+                        /* Count down a short delay, to ensure we push the last
+                           few bits through the filters before stopping. */
+                        report_status_change(s, SIG_STATUS_CARRIER_DOWN);
+                        s->baud_phase = 0;
+                        continue;
+                    }
                 }
             }
-        }
-        else
-        {
-            /* Look for power exceeding turn-on threshold to turn the carrier on */
-            if (power < s->carrier_on_power)
+            else
             {
+                /* Look for power exceeding turn-on threshold to turn the carrier on */
+                if (power < s->carrier_on_power)
+                {
+                    s->baud_phase = 0;
+                    continue;
+                }
+                if (s->baud_phase < (s->correlation_span >> 1) - 30)
+                {
+                    s->baud_phase++;
+                    continue;
+                }
+                s->signal_present = 1;
+                /* Initialise the baud/bit rate tracking. */
                 s->baud_phase = 0;
-                continue;
-            }
-            if (s->baud_phase < (s->correlation_span >> 1) - 30)
-            {
-                s->baud_phase++;
-                continue;
+                s->frame_state = 0;
+                s->frame_bits = 0;
+                s->last_bit = 0;
+                report_status_change(s, SIG_STATUS_CARRIER_UP);
             }
-            s->signal_present = 1;
-            /* Initialise the baud/bit rate tracking. */
-            s->baud_phase = 0;
-            s->frame_state = 0;
-            s->frame_bits = 0;
-            s->last_bit = 0;
-            report_status_change(s, SIG_STATUS_CARRIER_UP);
-        }
-        /* Non-coherent FSK demodulation by correlation with the target tones
-           over a one baud interval. The slow V.xx specs. are too open ended
-           to allow anything fancier to be used. The dot products are calculated
-           using a sliding window approach, so the compute load is not that great. */
+            /* Non-coherent FSK demodulation by correlation with the target tones
+               over a one baud interval. The slow V.xx specs. are too open ended
+               to allow anything fancier to be used. The dot products are calculated
+               using a sliding window approach, so the compute load is not that great. */
 
-        baudstate = (sum[0] < sum[1]);
-        switch (s->framing_mode)
-        {
-        case FSK_FRAME_MODE_SYNC:
-            /* Synchronous serial operation - e.g. for HDLC */
-            if (s->last_bit != baudstate)
-            {
-                /* On a transition we check our timing */
-                s->last_bit = baudstate;
-                /* For synchronous use (e.g. HDLC channels in FAX modems), nudge
-                   the baud phase gently, trying to keep it centred on the bauds. */
-                if (s->baud_phase < (SAMPLE_RATE*50))
-                    s->baud_phase += (s->baud_rate >> 3);
-                else
-                    s->baud_phase -= (s->baud_rate >> 3);
-            }
-            if ((s->baud_phase += s->baud_rate) >= (SAMPLE_RATE*100))
-            {
-                /* We should be in the middle of a baud now, so report the current
-                   state as the next bit */
-                s->baud_phase -= (SAMPLE_RATE*100);
-                s->put_bit(s->put_bit_user_data, baudstate);
-            }
-            break;
-        case FSK_FRAME_MODE_ASYNC:
-            /* Fully asynchronous mode */
-            if (s->last_bit != baudstate)
+            baudstate = (sum[0] < sum[1]);
+            switch (s->framing_mode)
             {
-                /* On a transition we check our timing */
-                s->last_bit = baudstate;
-                /* For async. operation, believe transitions completely, and
-                   sample appropriately. This allows instant start on the first
-                   transition. */
-                /* We must now be about half way to a sampling point. We do not do
-                   any fractional sample estimation of the transitions, so this is
-                   the most accurate baud alignment we can do. */
-                s->baud_phase = SAMPLE_RATE*50;
-            }
-            if ((s->baud_phase += s->baud_rate) >= (SAMPLE_RATE*100))
-            {
-                /* We should be in the middle of a baud now, so report the current
-                   state as the next bit */
-                s->baud_phase -= (SAMPLE_RATE*100);
-                s->put_bit(s->put_bit_user_data, baudstate);
-            }
-            break;
-        default:
-            /* Gather the specified number of bits, with robust checking to ensure reasonable voice immunity.
-               The first bit should be a start bit (0), and the last bit should be a stop bit (1) */
-            if (s->frame_state == 0)
-            {
-                /* Looking for the start of a zero bit, which hopefully the start of a start bit */
-                if (baudstate == 0)
+            case FSK_FRAME_MODE_SYNC:
+                /* Synchronous serial operation - e.g. for HDLC */
+                if (s->last_bit != baudstate)
                 {
-                    s->baud_phase = SAMPLE_RATE*(100 - 40)/2;
-                    s->frame_state = -1;
-                    s->frame_bits = 0;
-                    s->last_bit = -1;
+                    /* On a transition we check our timing */
+                    s->last_bit = baudstate;
+                    /* For synchronous use (e.g. HDLC channels in FAX modems), nudge
+                       the baud phase gently, trying to keep it centred on the bauds. */
+                    if (s->baud_phase < (SAMPLE_RATE*50))
+                        s->baud_phase += (s->baud_rate >> 3);
+                    else
+                        s->baud_phase -= (s->baud_rate >> 3);
                 }
-            }
-            else if (s->frame_state == -1)
-            {
-                /* Look for a continuous zero from the start of the start bit until
-                   beyond the middle */
-                if (baudstate != 0)
+                if ((s->baud_phase += s->baud_rate) >= (SAMPLE_RATE*100))
                 {
-                    /* If we aren't looking at a stable start bit, restart */
-                    s->frame_state = 0;
+                    /* We should be in the middle of a baud now, so report the current
+                       state as the next bit */
+                    s->baud_phase -= (SAMPLE_RATE*100);
+                    put_bit(s, baudstate);
                 }
-                else
+                break;
+            case FSK_FRAME_MODE_ASYNC:
+                /* Fully asynchronous mode */
+                if (s->last_bit != baudstate)
                 {
-                    s->baud_phase += s->baud_rate;
-                    if (s->baud_phase >= SAMPLE_RATE*100)
+                    /* On a transition we check our timing */
+                    s->last_bit = baudstate;
+                    /* For async. operation, believe transitions completely, and
+                       sample appropriately. This allows instant start on the first
+                       transition. */
+                    /* We must now be about half way to a sampling point. We do not do
+                       any fractional sample estimation of the transitions, so this is
+                       the most accurate baud alignment we can do. */
+                    s->baud_phase = SAMPLE_RATE*50;
+                }
+                if ((s->baud_phase += s->baud_rate) >= (SAMPLE_RATE*100))
+                {
+                    /* We should be in the middle of a baud now, so report the current
+                       state as the next bit */
+                    s->baud_phase -= (SAMPLE_RATE*100);
+                    put_bit(s, baudstate);
+                }
+                break;
+            default:
+                /* Gather the specified number of bits, with robust checking to ensure reasonable voice immunity.
+                   The first bit should be a start bit (0), and the last bit should be a stop bit (1) */
+                if (s->frame_state == 0)
+                {
+                    /* Looking for the start of a zero bit, which hopefully the start of a start bit */
+                    if (baudstate == 0)
                     {
-                        s->frame_state = 1;
-                        s->last_bit = baudstate;
+                        s->baud_phase = SAMPLE_RATE*(100 - 40)/2;
+                        s->frame_state = -1;
+                        s->frame_bits = 0;
+                        s->last_bit = -1;
                     }
                 }
-            }
-            else
-            {
-                s->baud_phase += s->baud_rate;
-                if (s->baud_phase >= SAMPLE_RATE*(100 - 40))
+                else if (s->frame_state == -1)
                 {
-                    if (s->last_bit < 0)
-                        s->last_bit = baudstate;
-                    /* Look for the bit being consistent over the central 20% of the bit time. */
-                    if (s->last_bit != baudstate)
+                    /* Look for a continuous zero from the start of the start bit until
+                       beyond the middle */
+                    if (baudstate != 0)
                     {
+                        /* If we aren't looking at a stable start bit, restart */
                         s->frame_state = 0;
                     }
-                    else if (s->baud_phase >= SAMPLE_RATE*100)
+                    else
                     {
-                        /* We should be in the middle of a baud now, so report the current
-                           state as the next bit */
-                        if (s->last_bit == baudstate)
+                        s->baud_phase += s->baud_rate;
+                        if (s->baud_phase >= SAMPLE_RATE*100)
                         {
-                            s->frame_bits |= (baudstate << s->framing_mode);
-                            s->frame_bits >>= 1;
-                            s->baud_phase -= (SAMPLE_RATE*100);
-                            if (++s->frame_state > s->framing_mode)
+                            s->frame_state = 1;
+                            s->last_bit = baudstate;
+                        }
+                    }
+                }
+                else
+                {
+                    s->baud_phase += s->baud_rate;
+                    if (s->baud_phase >= SAMPLE_RATE*(100 - 40))
+                    {
+                        if (s->last_bit < 0)
+                            s->last_bit = baudstate;
+                        /* Look for the bit being consistent over the central 20% of the bit time. */
+                        if (s->last_bit != baudstate)
+                        {
+                            s->frame_state = 0;
+                        }
+                        else if (s->baud_phase >= SAMPLE_RATE*100)
+                        {
+                            /* We should be in the middle of a baud now, so report the current
+                               state as the next bit */
+                            if (s->last_bit == baudstate)
                             {
-                                /* Check we have a stop bit */
-                                if (baudstate == 1)
+                                s->frame_bits |= (baudstate << s->framing_mode);
+                                s->frame_bits >>= 1;
+                                s->baud_phase -= (SAMPLE_RATE*100);
+                                if (++s->frame_state > s->framing_mode)
                                 {
-                                    /* Check we have a start bit */
-                                    if ((s->frame_bits & 1) == 0)
+                                    /* Check we have a stop bit */
+                                    if (baudstate == 1)
                                     {
-                                        /* Drop the start bit, and pass the rest back */
-                                        s->frame_bits >>= 1;
-                                        s->put_bit(s->put_bit_user_data, s->frame_bits);
+                                        /* Check we have a start bit */
+                                        if ((s->frame_bits & 1) == 0)
+                                        {
+                                            /* Drop the start bit, and pass the rest back */
+                                            s->frame_bits >>= 1;
+                                            s->put_bit(s->put_bit_user_data, s->frame_bits);
+                                        }
                                     }
+                                    s->frame_state = 0;
                                 }
+                            }
+                            else
+                            {
                                 s->frame_state = 0;
                             }
+                            s->last_bit = -1;
                         }
-                        else
-                        {
-                            s->frame_state = 0;
-                        }
-                        s->last_bit = -1;
                     }
                 }
+                break;
             }
-            break;
+            if (++buf_ptr >= s->correlation_span)
+                buf_ptr = 0;
         }
-        if (++buf_ptr >= s->correlation_span)
-            buf_ptr = 0;
     }
     s->buf_ptr = buf_ptr;
+    flush_bit_chunk(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -45,15 +45,19 @@
 #include <math.h>
 #endif
 #include "floating_fudge.h"
+#include "mmx_sse_decs.h"
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/fast_convert.h"
 #include "spandsp/saturated.h"
-#include "spandsp/vector_int.h"
 #include "spandsp/g722.h"
 
 #include "spandsp/private/g722.h"
 
+/*! The number of samples, or codes, processed in one pass */
+#define G722_BLOCK_LEN          160
+
 static const int16_t qmf_coeffs_fwd[12] =
 {
       3,  -11,   12,   32, -210,  951, 3876, -805,  362, -156,   53,  -11,
@@ -109,6 +113,20 @@ static const int16_t qm6[64] =
        432,    136,   -432,   -136
 };
 
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+/* q6[1] to q6[29], each zero extended to 32 bits, plus 3 zero entries of padding */
+static const int32_t q6_pairs[32] __attribute__((aligned(16))) =
+{
+        35,     72,    110,    150,
+       190,    233,    276,    323,
+       370,    422,    473,    530,
+       587,    650,    714,    786,
+       858,    940,   1023,   1121,
+      1219,   1339,   1458,   1612,
+      1765,   1980,   2195,   2557,
+      2919,      0,      0,      0
+};
+#else
 static const int16_t q6[32] =
 {
          0,     35,     72,    110,
@@ -120,6 +138,7 @@ static const int16_t q6[32] =
       1612,   1765,   1980,   2195,
       2557,   2919,      0,      0
 };
+#endif
 
 static const int16_t ilb[32] =
 {
@@ -257,7 +276,7 @@ SPAN_DECLARE(g722_decode_state_t *) g722_decode_init(g722_decode_state_t *s, int
 {
     if (s == NULL)
     {
-        if ((s = (g722_decode_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (g722_decode_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -287,28 +306,83 @@ SPAN_DECLARE(int) g722_decode_release(g722_decode_state_t *s)
 
 SPAN_DECLARE(int) g722_decode_free(g722_decode_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
 
-SPAN_DECLARE(int) g722_decode(g722_decode_state_t *s, int16_t amp[], const uint8_t g722_data[], int len)
+static __inline__ void qmf_dot_pair(const int16_t x[], const int16_t y[], int32_t *xsum, int32_t *ysum)
+{
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+    __m128i a;
+    __m128i b;
+
+    /* x against the forward coefficients, and y against the reverse ones, with the two
+       sums finished together. The 12 taps are done as 8 + 4. */
+    a = _mm_madd_epi16(_mm_loadu_si128((const __m128i *) x), _mm_loadu_si128((const __m128i *) qmf_coeffs_fwd));
+    a = _mm_add_epi32(a, _mm_madd_epi16(_mm_loadl_epi64((const __m128i *) &x[8]), _mm_loadl_epi64((const __m128i *) &qmf_coeffs_fwd[8])));
+    b = _mm_madd_epi16(_mm_loadu_si128((const __m128i *) y), _mm_loadu_si128((const __m128i *) qmf_coeffs_rev));
+    b = _mm_add_epi32(b, _mm_madd_epi16(_mm_loadl_epi64((const __m128i *) &y[8]), _mm_loadl_epi64((const __m128i *) &qmf_coeffs_rev[8])));
+    a = _mm_add_epi32(_mm_unpacklo_epi32(a, b), _mm_unpackhi_epi32(a, b));
+    a = _mm_add_epi32(a, _mm_srli_si128(a, 8));
+    *xsum = _mm_cvtsi128_si32(a);
+    *ysum = _mm_cvtsi128_si32(_mm_srli_si128(a, 4));
+#else
+    int32_t xs;
+    int32_t ys;
+    int i;
+
+    xs = 0;
+    ys = 0;
+    for (i = 0;  i < 12;  i++)
+    {
+        xs += (int32_t) x[i]*(int32_t) qmf_coeffs_fwd[i];
+        ys += (int32_t) y[i]*(int32_t) qmf_coeffs_rev[i];
+    }
+    *xsum = xs;
+    *ysum = ys;
+#endif
+}
+/*- End of function --------------------------------------------------------*/
+
+static void rx_qmf_block(g722_decode_state_t *s, int16_t amp[], const int16_t rlow[], const int16_t rhigh[], int n)
+{
+    int16_t x[12 + G722_BLOCK_LEN];
+    int16_t y[12 + G722_BLOCK_LEN];
+    int32_t sumodd;
+    int32_t sumeven;
+    int i;
+
+    /* Work on a linear copy of the history plus the new block, so every output
+       sees its 12 taps contiguously. */
+    memcpy(x, s->x, sizeof(s->x));
+    memcpy(y, s->y, sizeof(s->y));
+    for (i = 0;  i < n;  i++)
+    {
+        x[12 + i] = (int16_t) (rlow[i] + rhigh[i]);
+        y[12 + i] = (int16_t) (rlow[i] - rhigh[i]);
+    }
+    for (i = 0;  i < n;  i++)
+    {
+        qmf_dot_pair(&x[i + 1], &y[i + 1], &sumodd, &sumeven);
+        /* We shift by 12 to allow for the QMF filters (DC gain = 4096), less 1
+           to allow for the 15 bit input to the G.722 algorithm. */
+        amp[2*i] = (int16_t) (sumeven >> 11);
+        amp[2*i + 1] = (int16_t) (sumodd >> 11);
+    }
+    memcpy(s->x, &x[n], sizeof(s->x));
+    memcpy(s->y, &y[n], sizeof(s->y));
+}
+/*- End of function --------------------------------------------------------*/
+
+static int get_codes(g722_decode_state_t *s, uint8_t codes[], const uint8_t g722_data[], int len, int *n)
 {
-    int rlow;
-    int ihigh;
-    int16_t dlow;
-    int16_t dhigh;
-    int rhigh;
-    int wd1;
-    int wd2;
-    int wd3;
-    int code;
-    int outlen;
     int j;
+    int k;
 
-    outlen = 0;
-    rhigh = 0;
-    for (j = 0;  j < len;  )
+    /* Collect up to G722_BLOCK_LEN codes, and return the number of bytes used */
+    k = 0;
+    for (j = 0;  j < len  &&  k < G722_BLOCK_LEN;  )
     {
         if (s->packed)
         {
@@ -318,127 +392,176 @@ SPAN_DECLARE(int) g722_decode(g722_decode_state_t *s, int16_t amp[], const uint8
                 s->in_buffer |= (g722_data[j++] << s->in_bits);
                 s->in_bits += 8;
             }
-            code = s->in_buffer & ((1 << s->bits_per_sample) - 1);
+            codes[k++] = (uint8_t) (s->in_buffer & ((1 << s->bits_per_sample) - 1));
             s->in_buffer >>= s->bits_per_sample;
             s->in_bits -= s->bits_per_sample;
         }
         else
         {
-            code = g722_data[j++];
+            codes[k++] = g722_data[j++];
         }
+    }
+    *n = k;
+    return j;
+}
+/*- End of function --------------------------------------------------------*/
 
-        switch (s->bits_per_sample)
-        {
-        default:
-        case 8:
-            wd1 = code & 0x3F;
-            ihigh = (code >> 6) & 0x03;
-            wd2 = qm6[wd1];
-            wd1 >>= 2;
-            break;
-        case 7:
-            wd1 = code & 0x1F;
-            ihigh = (code >> 5) & 0x03;
-            wd2 = qm5[wd1];
-            wd1 >>= 1;
-            break;
-        case 6:
-            wd1 = code & 0x0F;
-            ihigh = (code >> 4) & 0x03;
-            wd2 = qm4[wd1];
-            break;
-        }
-        /* Block 5L, LOW BAND INVQBL */
-        wd2 = ((int32_t) s->band[0].det*(int32_t) wd2) >> 15;
-        /* Block 5L, RECONS */
-        /* Block 6L, LIMIT */
-        rlow = saturate15(s->band[0].s + wd2);
+static __inline__ void decode_code(g722_decode_state_t *s, int code, int16_t *xrlow, int16_t *xrhigh)
+{
+    int rlow;
+    int ihigh;
+    int16_t dlow;
+    int16_t dhigh;
+    int rhigh;
+    int wd1;
+    int wd2;
+    int wd3;
 
-        /* Block 2L, INVQAL */
+    rhigh = 0;
+    switch (s->bits_per_sample)
+    {
+    default:
+    case 8:
+        wd1 = code & 0x3F;
+        ihigh = (code >> 6) & 0x03;
+        wd2 = qm6[wd1];
+        wd1 >>= 2;
+        break;
+    case 7:
+        wd1 = code & 0x1F;
+        ihigh = (code >> 5) & 0x03;
+        wd2 = qm5[wd1];
+        wd1 >>= 1;
+        break;
+    case 6:
+        wd1 = code & 0x0F;
+        ihigh = (code >> 4) & 0x03;
         wd2 = qm4[wd1];
-        dlow = (int16_t) (((int32_t) s->band[0].det*(int32_t) wd2) >> 15);
-
-        /* Block 3L, LOGSCL */
-        wd2 = rl42[wd1];
-        wd1 = ((int32_t) s->band[0].nb*(int32_t) 127) >> 7;
-        wd1 += wl[wd2];
+        break;
+    }
+    /* Block 5L, LOW BAND INVQBL */
+    wd2 = ((int32_t) s->band[0].det*(int32_t) wd2) >> 15;
+    /* Block 5L, RECONS */
+    /* Block 6L, LIMIT */
+    rlow = saturate15(s->band[0].s + wd2);
+
+    /* Block 2L, INVQAL */
+    wd2 = qm4[wd1];
+    dlow = (int16_t) (((int32_t) s->band[0].det*(int32_t) wd2) >> 15);
+
+    /* Block 3L, LOGSCL */
+    wd2 = rl42[wd1];
+    wd1 = ((int32_t) s->band[0].nb*(int32_t) 127) >> 7;
+    wd1 += wl[wd2];
+    if (wd1 < 0)
+        wd1 = 0;
+    else if (wd1 > 18432)
+        wd1 = 18432;
+    s->band[0].nb = (int16_t) wd1;
+        
+    /* Block 3L, SCALEL */
+    wd1 = (s->band[0].nb >> 6) & 31;
+    wd2 = 8 - (s->band[0].nb >> 11);
+    wd3 = (wd2 < 0)  ?  (ilb[wd1] << -wd2)  :  (ilb[wd1] >> wd2);
+    s->band[0].det = (int16_t) (wd3 << 2);
+
+    block4(&s->band[0], dlow);
+    
+    if (!s->eight_k)
+    {
+        /* Block 2H, INVQAH */
+        wd2 = qm2[ihigh];
+        dhigh = (int16_t) (((int32_t) s->band[1].det*(int32_t) wd2) >> 15);
+        /* Block 5H, RECONS */
+        /* Block 6H, LIMIT */
+        rhigh = saturate15(dhigh + s->band[1].s);
+
+        /* Block 2H, INVQAH */
+        wd2 = rh2[ihigh];
+        wd1 = ((int32_t) s->band[1].nb*(int32_t) 127) >> 7;
+        wd1 += wh[wd2];
         if (wd1 < 0)
             wd1 = 0;
-        else if (wd1 > 18432)
-            wd1 = 18432;
-        s->band[0].nb = (int16_t) wd1;
-            
-        /* Block 3L, SCALEL */
-        wd1 = (s->band[0].nb >> 6) & 31;
-        wd2 = 8 - (s->band[0].nb >> 11);
+        else if (wd1 > 22528)
+            wd1 = 22528;
+        s->band[1].nb = (int16_t) wd1;
+        
+        /* Block 3H, SCALEH */
+        wd1 = (s->band[1].nb >> 6) & 31;
+        wd2 = 10 - (s->band[1].nb >> 11);
         wd3 = (wd2 < 0)  ?  (ilb[wd1] << -wd2)  :  (ilb[wd1] >> wd2);
-        s->band[0].det = (int16_t) (wd3 << 2);
+        s->band[1].det = (int16_t) (wd3 << 2);
 
-        block4(&s->band[0], dlow);
-        
-        if (!s->eight_k)
-        {
-            /* Block 2H, INVQAH */
-            wd2 = qm2[ihigh];
-            dhigh = (int16_t) (((int32_t) s->band[1].det*(int32_t) wd2) >> 15);
-            /* Block 5H, RECONS */
-            /* Block 6H, LIMIT */
-            rhigh = saturate15(dhigh + s->band[1].s);
-
-            /* Block 2H, INVQAH */
-            wd2 = rh2[ihigh];
-            wd1 = ((int32_t) s->band[1].nb*(int32_t) 127) >> 7;
-            wd1 += wh[wd2];
-            if (wd1 < 0)
-                wd1 = 0;
-            else if (wd1 > 22528)
-                wd1 = 22528;
-            s->band[1].nb = (int16_t) wd1;
-            
-            /* Block 3H, SCALEH */
-            wd1 = (s->band[1].nb >> 6) & 31;
-            wd2 = 10 - (s->band[1].nb >> 11);
-            wd3 = (wd2 < 0)  ?  (ilb[wd1] << -wd2)  :  (ilb[wd1] >> wd2);
-            s->band[1].det = (int16_t) (wd3 << 2);
-
-            block4(&s->band[1], dhigh);
-        }
+        block4(&s->band[1], dhigh);
+    }
+    *xrlow = (int16_t) rlow;
+    *xrhigh = (int16_t) rhigh;
+}
+/*- End of function --------------------------------------------------------*/
 
-        if (s->itu_test_mode)
-        {
-            amp[outlen++] = (int16_t) (rlow << 1);
-            amp[outlen++] = (int16_t) (rhigh << 1);
-        }
-        else
+static int put_samples(g722_decode_state_t *s, int16_t amp[], const int16_t rlow[], const int16_t rhigh[], int n)
+{
+    int i;
+
+    if (s->itu_test_mode)
+    {
+        for (i = 0;  i < n;  i++)
         {
-            if (s->eight_k)
-            {
-                /* We shift by 1 to allow for the 15 bit input to the G.722 algorithm. */
-                amp[outlen++] = (int16_t) (rlow << 1);
-            }
-            else
-            {
-                /* Apply the QMF to build the final signal */
-                s->x[s->ptr] = (int16_t) (rlow + rhigh);
-                s->y[s->ptr] = (int16_t) (rlow - rhigh);
-                if (++s->ptr >= 12)
-                    s->ptr = 0;
-                /* We shift by 12 to allow for the QMF filters (DC gain = 4096), less 1
-                   to allow for the 15 bit input to the G.722 algorithm. */
-                amp[outlen++] = (int16_t) (vec_circular_dot_prodi16(s->y, qmf_coeffs_rev, 12, s->ptr) >> 11);
-                amp[outlen++] = (int16_t) (vec_circular_dot_prodi16(s->x, qmf_coeffs_fwd, 12, s->ptr) >> 11);
-            }
+            amp[2*i] = (int16_t) (rlow[i] << 1);
+            amp[2*i + 1] = (int16_t) (rhigh[i] << 1);
         }
+        return 2*n;
+    }
+    if (s->eight_k)
+    {
+        /* We shift by 1 to allow for the 15 bit input to the G.722 algorithm. */
+        for (i = 0;  i < n;  i++)
+            amp[i] = (int16_t) (rlow[i] << 1);
+        return n;
+    }
+    /* Apply the QMF to build the final signal */
+    rx_qmf_block(s, amp, rlow, rhigh, n);
+    return 2*n;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) g722_decode(g722_decode_state_t *s, int16_t amp[], const uint8_t g722_data[], int len)
+{
+    uint8_t codes[G722_BLOCK_LEN];
+    int16_t rlow[G722_BLOCK_LEN];
+    int16_t rhigh[G722_BLOCK_LEN];
+    int outlen;
+    int i;
+    int j;
+    int n;
+
+    outlen = 0;
+    for (j = 0;  j < len;  )
+    {
+        j += get_codes(s, codes, &g722_data[j], len - j, &n);
+        for (i = 0;  i < n;  i++)
+            decode_code(s, codes[i], &rlow[i], &rhigh[i]);
+        outlen += put_samples(s, &amp[outlen], rlow, rhigh, n);
     }
     return outlen;
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) g722_decode_batch(g722_decode_state_t *s[], int16_t *amp[], const uint8_t *g722_data[], int len, int outlen[], int channels)
+{
+    int k;
+
+    for (k = 0;  k < channels;  k++)
+        outlen[k] = g722_decode(s[k], amp[k], g722_data[k], len);
+    return channels;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(g722_encode_state_t *) g722_encode_init(g722_encode_state_t *s, int rate, int options)
 {
     if (s == NULL)
     {
-        if ((s = (g722_encode_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (g722_encode_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -468,12 +591,111 @@ SPAN_DECLARE(int) g722_encode_release(g722_encode_state_t *s)
 
 SPAN_DECLARE(int) g722_encode_free(g722_encode_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
 
-SPAN_DECLARE(int) g722_encode(g722_encode_state_t *s, uint8_t g722_data[], const int16_t amp[], int len)
+static void tx_qmf_block(g722_encode_state_t *s, int16_t xlow[], int16_t xhigh[], const int16_t amp[], int n)
+{
+    int16_t x[12 + G722_BLOCK_LEN];
+    int16_t y[12 + G722_BLOCK_LEN];
+    int32_t sumodd;
+    int32_t sumeven;
+    int i;
+
+    /* Work on a linear copy of the history plus the new block, so every output
+       sees its 12 taps contiguously. */
+    memcpy(x, s->x, sizeof(s->x));
+    memcpy(y, s->y, sizeof(s->y));
+    for (i = 0;  i < n;  i++)
+    {
+        x[12 + i] = amp[2*i];
+        y[12 + i] = amp[2*i + 1];
+    }
+    for (i = 0;  i < n;  i++)
+    {
+        qmf_dot_pair(&x[i + 1], &y[i + 1], &sumodd, &sumeven);
+        /* We shift by 12 to allow for the QMF filters (DC gain = 4096), plus 1
+           to allow for us summing two filters, plus 1 to allow for the 15 bit
+           input to the G.722 algorithm. */
+        xlow[i] = (int16_t) ((sumeven + sumodd) >> 14);
+        xhigh[i] = (int16_t) ((sumeven - sumodd) >> 14);
+    }
+    memcpy(s->x, &x[n], sizeof(s->x));
+    memcpy(s->y, &y[n], sizeof(s->y));
+}
+/*- End of function --------------------------------------------------------*/
+
+static int get_bands(g722_encode_state_t *s, int16_t xlow[], int16_t xhigh[], const int16_t amp[], int len)
+{
+    int i;
+
+    /* Split up to G722_BLOCK_LEN samples into bands, and return the number of codes
+       they will produce */
+    if (s->itu_test_mode)
+    {
+        for (i = 0;  i < len;  i++)
+            xlow[i] =
+            xhigh[i] = amp[i] >> 1;
+        return len;
+    }
+    if (s->eight_k)
+    {
+        /* We shift by 1 to allow for the 15 bit input to the G.722 algorithm. */
+        for (i = 0;  i < len;  i++)
+            xlow[i] = amp[i] >> 1;
+        return len;
+    }
+    /* Apply the transmit QMF */
+    tx_qmf_block(s, xlow, xhigh, amp, len >> 1);
+    return len >> 1;
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ int quantl_index(int wd, int16_t det)
+{
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+    __m128i vdet;
+    __m128i vwd;
+    __m128i count;
+    __m128i thresh;
+    int i;
+
+    /* The thresholds rise with the index, so the index the scalar search stops at is
+       one more than the number of thresholds <= wd. That count can be done without
+       any branches. Each 32 bit lane of q6_pairs holds q6[i] in its low half and zero
+       in its high half, so _mm_madd_epi16() gives q6[i]*det exactly. The 3 padding
+       entries have thresholds of zero, which always count, and are allowed for at
+       the end. */
+    vdet = _mm_set1_epi32(det);
+    vwd = _mm_set1_epi32(wd);
+    count = _mm_setzero_si128();
+    for (i = 0;  i < 32;  i += 4)
+    {
+        thresh = _mm_srai_epi32(_mm_madd_epi16(_mm_load_si128((const __m128i *) &q6_pairs[i]), vdet), 12);
+        count = _mm_sub_epi32(count, _mm_cmpgt_epi32(thresh, vwd));
+    }
+    count = _mm_add_epi32(count, _mm_srli_si128(count, 8));
+    count = _mm_add_epi32(count, _mm_srli_si128(count, 4));
+    /* count is the number of thresholds > wd, of the 29 real ones */
+    return 30 - _mm_cvtsi128_si32(count);
+#else
+    int wd1;
+    int i;
+
+    for (i = 1;  i < 30;  i++)
+    {
+        wd1 = ((int32_t) q6[i]*(int32_t) det) >> 12;
+        if (wd < wd1)
+            break;
+    }
+    return i;
+#endif
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ int encode_bands(g722_encode_state_t *s, int16_t xlow, int16_t xhigh)
 {
     int16_t dlow;
     int16_t dhigh;
@@ -486,144 +708,137 @@ SPAN_DECLARE(int) g722_encode(g722_encode_state_t *s, uint8_t g722_data[], const
     int ih2;
     int wd3;
     int eh;
-    int g722_bytes;
     int ihigh;
     int ilow;
-    int code;
-    /* Low and high band PCM from the QMF */
-    int16_t xlow;
-    int16_t xhigh;
-    int32_t sumeven;
-    int32_t sumodd;
     int mih;
     int i;
-    int j;
 
-    g722_bytes = 0;
-    xhigh = 0;
-    for (j = 0;  j < len;  )
+    /* Block 1L, SUBTRA */
+    el = saturated_sub16(xlow, s->band[0].s);
+
+    /* Block 1L, QUANTL */
+    wd = (el >= 0)  ?  el  :  ~el;
+
+    i = quantl_index(wd, s->band[0].det);
+    ilow = (el < 0)  ?  iln[i]  :  ilp[i];
+
+    /* Block 2L, INVQAL */
+    ril = ilow >> 2;
+    wd2 = qm4[ril];
+    dlow = (int16_t) (((int32_t) s->band[0].det*(int32_t) wd2) >> 15);
+
+    /* Block 3L, LOGSCL */
+    il4 = rl42[ril];
+    wd = ((int32_t) s->band[0].nb*(int32_t) 127) >> 7;
+    s->band[0].nb = (int16_t) (wd + wl[il4]);
+    if (s->band[0].nb < 0)
+        s->band[0].nb = 0;
+    else if (s->band[0].nb > 18432)
+        s->band[0].nb = 18432;
+
+    /* Block 3L, SCALEL */
+    wd1 = (s->band[0].nb >> 6) & 31;
+    wd2 = 8 - (s->band[0].nb >> 11);
+    wd3 = (wd2 < 0)  ?  (ilb[wd1] << -wd2)  :  (ilb[wd1] >> wd2);
+    s->band[0].det = (int16_t) (wd3 << 2);
+
+    block4(&s->band[0], dlow);
+    
+    if (s->eight_k)
     {
-        if (s->itu_test_mode)
-        {
-            xlow =
-            xhigh = amp[j++] >> 1;
-        }
-        else
-        {
-            if (s->eight_k)
-            {
-                /* We shift by 1 to allow for the 15 bit input to the G.722 algorithm. */
-                xlow = amp[j++] >> 1;
-            }
-            else
-            {
-                /* Apply the transmit QMF */
-                s->x[s->ptr] = amp[j++];
-                s->y[s->ptr] = amp[j++];
-                if (++s->ptr >= 12)
-                    s->ptr = 0;
-                sumodd = vec_circular_dot_prodi16(s->x, qmf_coeffs_fwd, 12, s->ptr);
-                sumeven = vec_circular_dot_prodi16(s->y, qmf_coeffs_rev, 12, s->ptr);
-                /* We shift by 12 to allow for the QMF filters (DC gain = 4096), plus 1
-                   to allow for us summing two filters, plus 1 to allow for the 15 bit
-                   input to the G.722 algorithm. */
-                xlow = (int16_t) ((sumeven + sumodd) >> 14);
-                xhigh = (int16_t) ((sumeven - sumodd) >> 14);
-            }
-        }
-        /* Block 1L, SUBTRA */
-        el = saturated_sub16(xlow, s->band[0].s);
+        /* Just leave the high bits as zero */
+        return (0xC0 | ilow) >> (8 - s->bits_per_sample);
+    }
 
-        /* Block 1L, QUANTL */
-        wd = (el >= 0)  ?  el  :  ~el;
+    /* Block 1H, SUBTRA */
+    eh = saturated_sub16(xhigh, s->band[1].s);
+
+    /* Block 1H, QUANTH */
+    wd = (eh >= 0)  ?  eh  :  ~eh;
+    wd1 = (564*s->band[1].det) >> 12;
+    mih = (wd >= wd1)  ?  2  :  1;
+    ihigh = (eh < 0)  ?  ihn[mih]  :  ihp[mih];
+
+    /* Block 2H, INVQAH */
+    wd2 = qm2[ihigh];
+    dhigh = (int16_t) (((int32_t) s->band[1].det*(int32_t) wd2) >> 15);
+
+    /* Block 3H, LOGSCH */
+    ih2 = rh2[ihigh];
+    wd = ((int32_t) s->band[1].nb*(int32_t) 127) >> 7;
+    s->band[1].nb = (int16_t) (wd + wh[ih2]);
+    if (s->band[1].nb < 0)
+        s->band[1].nb = 0;
+    else if (s->band[1].nb > 22528)
+        s->band[1].nb = 22528;
+
+    /* Block 3H, SCALEH */
+    wd1 = (s->band[1].nb >> 6) & 31;
+    wd2 = 10 - (s->band[1].nb >> 11);
+    wd3 = (wd2 < 0)  ?  (ilb[wd1] << -wd2)  :  (ilb[wd1] >> wd2);
+    s->band[1].det = (int16_t) (wd3 << 2);
+
+    block4(&s->band[1], dhigh);
+    return ((ihigh << 6) | ilow) >> (8 - s->bits_per_sample);
+}
+/*- End of function --------------------------------------------------------*/
 
-        for (i = 1;  i < 30;  i++)
+static __inline__ int put_code(g722_encode_state_t *s, uint8_t g722_data[], int g722_bytes, int code)
+{
+    if (s->packed)
+    {
+        /* Pack the code bits */
+        s->out_buffer |= (code << s->out_bits);
+        s->out_bits += s->bits_per_sample;
+        if (s->out_bits >= 8)
         {
-            wd1 = ((int32_t) q6[i]*(int32_t) s->band[0].det) >> 12;
-            if (wd < wd1)
-                break;
+            g722_data[g722_bytes++] = (uint8_t) (s->out_buffer & 0xFF);
+            s->out_bits -= 8;
+            s->out_buffer >>= 8;
         }
-        ilow = (el < 0)  ?  iln[i]  :  ilp[i];
-
-        /* Block 2L, INVQAL */
-        ril = ilow >> 2;
-        wd2 = qm4[ril];
-        dlow = (int16_t) (((int32_t) s->band[0].det*(int32_t) wd2) >> 15);
-
-        /* Block 3L, LOGSCL */
-        il4 = rl42[ril];
-        wd = ((int32_t) s->band[0].nb*(int32_t) 127) >> 7;
-        s->band[0].nb = (int16_t) (wd + wl[il4]);
-        if (s->band[0].nb < 0)
-            s->band[0].nb = 0;
-        else if (s->band[0].nb > 18432)
-            s->band[0].nb = 18432;
-
-        /* Block 3L, SCALEL */
-        wd1 = (s->band[0].nb >> 6) & 31;
-        wd2 = 8 - (s->band[0].nb >> 11);
-        wd3 = (wd2 < 0)  ?  (ilb[wd1] << -wd2)  :  (ilb[wd1] >> wd2);
-        s->band[0].det = (int16_t) (wd3 << 2);
+    }
+    else
+    {
+        g722_data[g722_bytes++] = (uint8_t) code;
+    }
+    return g722_bytes;
+}
+/*- End of function --------------------------------------------------------*/
 
-        block4(&s->band[0], dlow);
-        
-        if (s->eight_k)
-        {
-            /* Just leave the high bits as zero */
-            code = (0xC0 | ilow) >> (8 - s->bits_per_sample);
-        }
-        else
-        {
-            /* Block 1H, SUBTRA */
-            eh = saturated_sub16(xhigh, s->band[1].s);
-
-            /* Block 1H, QUANTH */
-            wd = (eh >= 0)  ?  eh  :  ~eh;
-            wd1 = (564*s->band[1].det) >> 12;
-            mih = (wd >= wd1)  ?  2  :  1;
-            ihigh = (eh < 0)  ?  ihn[mih]  :  ihp[mih];
-
-            /* Block 2H, INVQAH */
-            wd2 = qm2[ihigh];
-            dhigh = (int16_t) (((int32_t) s->band[1].det*(int32_t) wd2) >> 15);
-
-            /* Block 3H, LOGSCH */
-            ih2 = rh2[ihigh];
-            wd = ((int32_t) s->band[1].nb*(int32_t) 127) >> 7;
-            s->band[1].nb = (int16_t) (wd + wh[ih2]);
-            if (s->band[1].nb < 0)
-                s->band[1].nb = 0;
-            else if (s->band[1].nb > 22528)
-                s->band[1].nb = 22528;
-
-            /* Block 3H, SCALEH */
-            wd1 = (s->band[1].nb >> 6) & 31;
-            wd2 = 10 - (s->band[1].nb >> 11);
-            wd3 = (wd2 < 0)  ?  (ilb[wd1] << -wd2)  :  (ilb[wd1] >> wd2);
-            s->band[1].det = (int16_t) (wd3 << 2);
-
-            block4(&s->band[1], dhigh);
-            code = ((ihigh << 6) | ilow) >> (8 - s->bits_per_sample);
-        }
+SPAN_DECLARE(int) g722_encode(g722_encode_state_t *s, uint8_t g722_data[], const int16_t amp[], int len)
+{
+    /* Low and high band PCM from the QMF */
+    int16_t xlow[G722_BLOCK_LEN];
+    int16_t xhigh[G722_BLOCK_LEN];
+    int g722_bytes;
+    int chunk;
+    int i;
+    int j;
+    int n;
 
-        if (s->packed)
-        {
-            /* Pack the code bits */
-            s->out_buffer |= (code << s->out_bits);
-            s->out_bits += s->bits_per_sample;
-            if (s->out_bits >= 8)
-            {
-                g722_data[g722_bytes++] = (uint8_t) (s->out_buffer & 0xFF);
-                s->out_bits -= 8;
-                s->out_buffer >>= 8;
-            }
-        }
-        else
-        {
-            g722_data[g722_bytes++] = (uint8_t) code;
-        }
+    g722_bytes = 0;
+    for (j = 0;  j < len;  j += chunk)
+    {
+        if ((chunk = len - j) > G722_BLOCK_LEN)
+            chunk = G722_BLOCK_LEN;
+        n = get_bands(s, xlow, xhigh, &amp[j], chunk);
+        for (i = 0;  i < n;  i++)
+            g722_bytes = put_code(s, g722_data, g722_bytes, encode_bands(s, xlow[i], xhigh[i]));
     }
     return g722_bytes;
 }
 /*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) g722_encode_batch(g722_encode_state_t *s[], uint8_t *g722_data[], const int16_t *amp[], int len, int g722_bytes[], int channels)
+{
+    int k;
+
+    /* Stepping several channels together, code by code, was tried. It was a little
+       slower than taking each channel's block in turn, which keeps one channel's state
+       and tables hot while its block is processed. */
+    for (k = 0;  k < channels;  k++)
+        g722_bytes[k] = g722_encode(s[k], g722_data[k], amp[k], len);
+    return channels;
+}
+/*- End of function --------------------------------------------------------*/
 /*- End of file ------------------------------------------------------------*/
@@ -65,8 +65,10 @@
 #include <math.h>
 #endif
 #include "floating_fudge.h"
+#include "mmx_sse_decs.h"
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/dc_restore.h"
 #include "spandsp/bitstream.h"
 #include "spandsp/bit_operations.h"
@@ -1003,7 +1005,7 @@ SPAN_DECLARE(g726_state_t *) g726_init(g726_state_t *s, int bit_rate, int ext_co
         return NULL;
     if (s == NULL)
     {
-        if ((s = (g726_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (g726_state_t *) span_alloc(sizeof(*s))) == NULL)
             return  NULL;
     }
     s->yl = 34816;
@@ -1063,58 +1065,115 @@ SPAN_DECLARE(int) g726_release(g726_state_t *s)
 
 SPAN_DECLARE(int) g726_free(g726_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
 
-SPAN_DECLARE(int) g726_decode(g726_state_t *s,
-                              int16_t amp[],
-                              const uint8_t g726_data[],
-                              int g726_bytes)
+static __inline__ int get_code(g726_state_t *s, const uint8_t g726_data[], int *i, int g726_bytes)
 {
-    int i;
-    int samples;
-    uint8_t code;
-    int sl;
+    int code;
 
-    for (samples = i = 0;  ;  )
+    /* Return the next code, or -1 if the data has run out */
+    if (s->packing != G726_PACKING_NONE)
     {
-        if (s->packing != G726_PACKING_NONE)
+        /* Unpack the code bits */
+        if (s->packing != G726_PACKING_LEFT)
         {
-            /* Unpack the code bits */
-            if (s->packing != G726_PACKING_LEFT)
+            if (s->bs.residue < s->bits_per_sample)
             {
-                if (s->bs.residue < s->bits_per_sample)
-                {
-                    if (i >= g726_bytes)
-                        break;
-                    s->bs.bitstream |= (g726_data[i++] << s->bs.residue);
-                    s->bs.residue += 8;
-                }
-                code = (uint8_t) (s->bs.bitstream & ((1 << s->bits_per_sample) - 1));
-                s->bs.bitstream >>= s->bits_per_sample;
+                if (*i >= g726_bytes)
+                    return -1;
+                s->bs.bitstream |= (g726_data[(*i)++] << s->bs.residue);
+                s->bs.residue += 8;
             }
-            else
+            code = (uint8_t) (s->bs.bitstream & ((1 << s->bits_per_sample) - 1));
+            s->bs.bitstream >>= s->bits_per_sample;
+        }
+        else
+        {
+            if (s->bs.residue < s->bits_per_sample)
             {
-                if (s->bs.residue < s->bits_per_sample)
-                {
-                    if (i >= g726_bytes)
-                        break;
-                    s->bs.bitstream = (s->bs.bitstream << 8) | g726_data[i++];
-                    s->bs.residue += 8;
-                }
-                code = (uint8_t) ((s->bs.bitstream >> (s->bs.residue - s->bits_per_sample)) & ((1 << s->bits_per_sample) - 1));
+                if (*i >= g726_bytes)
+                    return -1;
+                s->bs.bitstream = (s->bs.bitstream << 8) | g726_data[(*i)++];
+                s->bs.residue += 8;
+            }
+            code = (uint8_t) ((s->bs.bitstream >> (s->bs.residue - s->bits_per_sample)) & ((1 << s->bits_per_sample) - 1));
+        }
+        s->bs.residue -= s->bits_per_sample;
+        return code;
+    }
+    if (*i >= g726_bytes)
+        return -1;
+    return g726_data[(*i)++];
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ int put_code(g726_state_t *s, uint8_t g726_data[], int g726_bytes, uint8_t code)
+{
+    if (s->packing != G726_PACKING_NONE)
+    {
+        /* Pack the code bits */
+        if (s->packing != G726_PACKING_LEFT)
+        {
+            s->bs.bitstream |= (code << s->bs.residue);
+            s->bs.residue += s->bits_per_sample;
+            if (s->bs.residue >= 8)
+            {
+                g726_data[g726_bytes++] = (uint8_t) (s->bs.bitstream & 0xFF);
+                s->bs.bitstream >>= 8;
+                s->bs.residue -= 8;
             }
-            s->bs.residue -= s->bits_per_sample;
         }
         else
         {
-            if (i >= g726_bytes)
-                break;
-            code = g726_data[i++];
+            s->bs.bitstream = (s->bs.bitstream << s->bits_per_sample) | code;
+            s->bs.residue += s->bits_per_sample;
+            if (s->bs.residue >= 8)
+            {
+                g726_data[g726_bytes++] = (uint8_t) ((s->bs.bitstream >> (s->bs.residue - 8)) & 0xFF);
+                s->bs.residue -= 8;
+            }
         }
-        sl = s->dec_func(s, code);
+    }
+    else
+    {
+        g726_data[g726_bytes++] = (uint8_t) code;
+    }
+    return g726_bytes;
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ int16_t get_linear(g726_state_t *s, const int16_t amp[], int i)
+{
+    /* Linearize the input sample to 14-bit PCM */
+    switch (s->ext_coding)
+    {
+    case G726_ENCODING_ALAW:
+        return alaw_to_linear(((const uint8_t *) amp)[i]) >> 2;
+    case G726_ENCODING_ULAW:
+        return ulaw_to_linear(((const uint8_t *) amp)[i]) >> 2;
+    }
+    return amp[i] >> 2;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) g726_decode(g726_state_t *s,
+                              int16_t amp[],
+                              const uint8_t g726_data[],
+                              int g726_bytes)
+{
+    int i;
+    int samples;
+    int code;
+    int sl;
+
+    for (samples = i = 0;  ;  )
+    {
+        if ((code = get_code(s, g726_data, &i, g726_bytes)) < 0)
+            break;
+        sl = s->dec_func(s, (uint8_t) code);
         if (s->ext_coding != G726_ENCODING_LINEAR)
             ((uint8_t *) amp)[samples++] = (uint8_t) sl;
         else
@@ -1131,56 +1190,731 @@ SPAN_DECLARE(int) g726_encode(g726_state_t *s,
 {
     int i;
     int g726_bytes;
-    int16_t sl;
-    uint8_t code;
 
     for (g726_bytes = i = 0;  i < len;  i++)
+        g726_bytes = put_code(s, g726_data, g726_bytes, s->enc_func(s, get_linear(s, amp, i)));
+    return g726_bytes;
+}
+/*- End of function --------------------------------------------------------*/
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+/* The multi-channel engine. G.726 is sequential in time, but the channels are
+   independent, so G726_LANES channels at the same rate are coded together, one
+   per 32 bit lane of an SSE2 register. Every step reproduces the integer
+   behaviour of the single channel code exactly, including the wrap around where
+   a result is stored in an int16_t. Variable shifts, which SSE2 does not have,
+   are done by multiplying by a power of two in single precision floating point.
+   The values involved are small enough for this to be exact. top_bit() is found
+   from the exponent of a conversion to floating point. */
+
+/*! The number of channels coded together */
+#define G726_LANES                  4
+/*! The number of samples processed in one pass over a group of channels */
+#define G726_BANK_BLOCK_LEN         64
+
+/* The state of a group of channels, with one lane per channel */
+typedef struct
+{
+    __m128i yl;
+    __m128i yu;
+    __m128i dms;
+    __m128i dml;
+    __m128i ap;
+    __m128i a[2];
+    __m128i b[6];
+    __m128i pk[2];
+    __m128i dq[6];
+    __m128i sr[2];
+    /*! All ones in a lane where td is TRUE */
+    __m128i td;
+} g726_lanes_t;
+
+/* The things which differ between the bit rates */
+typedef struct
+{
+    const int *qtab;
+    int quantizer_states;
+    int sign_bit;
+    int dq_mask;
+    int b_shift;
+    const int *dqlntab;
+    const int *witab;
+    const int *fitab;
+} g726_rate_params_t;
+
+static const g726_rate_params_t rate_params[4] =
+{
+    {qtab_726_16, 4, 0x02, 0x3FFF, 8, g726_16_dqlntab, g726_16_witab, g726_16_fitab},
+    {qtab_726_24, 7, 0x04, 0x3FFF, 8, g726_24_dqlntab, g726_24_witab, g726_24_fitab},
+    {qtab_726_32, 15, 0x08, 0x3FFF, 8, g726_32_dqlntab, g726_32_witab, g726_32_fitab},
+    {qtab_726_40, 31, 0x10, 0x7FFF, 9, g726_40_dqlntab, g726_40_witab, g726_40_fitab}
+};
+
+static __inline__ __m128i v_sext16(__m128i x)
+{
+    /* What storing in an int16_t does */
+    return _mm_srai_epi32(_mm_slli_epi32(x, 16), 16);
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ __m128i v_select(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ __m128i v_mul16(__m128i a, __m128i b)
+{
+    /* a must be in the int16_t range, and b in the range 0 to 32767 */
+    return _mm_madd_epi16(a, b);
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ __m128i v_float_bits(__m128i x)
+{
+    /* The IEEE single precision bits of x, for 0 <= x < 2^24 */
+    return _mm_castps_si128(_mm_cvtepi32_ps(x));
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ __m128i v_scale(__m128i x, __m128i e)
+{
+    __m128 p;
+
+    /* x*2^e, truncated, for 0 <= x < 2^24. This is x << e or x >> -e */
+    p = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(e, _mm_set1_epi32(127)), 23));
+    return _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(x), p));
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ __m128i v_float_format(__m128i mag)
+{
+    __m128i bits;
+    __m128i x;
+
+    /* (exp << 6) + ((mag << 6) >> exp), where exp = top_bit(mag) + 1, or 0x20 for zero */
+    bits = v_float_bits(mag);
+    x = _mm_slli_epi32(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(126)), 6);
+    x = _mm_add_epi32(x, _mm_add_epi32(_mm_and_si128(_mm_srli_epi32(bits, 18), _mm_set1_epi32(0x1F)), _mm_set1_epi32(32)));
+    return v_select(_mm_cmpeq_epi32(mag, _mm_setzero_si128()), _mm_set1_epi32(0x20), x);
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ __m128i v_fmult(__m128i an, __m128i srn)
+{
+    __m128i anmag;
+    __m128i anexp;
+    __m128i anmant;
+    __m128i wanexp;
+    __m128i wanmant;
+    __m128i retval;
+    __m128i bits;
+    __m128i neg;
+
+    anmag = v_select(_mm_cmpgt_epi32(an, _mm_setzero_si128()),
+                     an,
+                     _mm_and_si128(_mm_sub_epi32(_mm_setzero_si128(), an), _mm_set1_epi32(0x1FFF)));
+    bits = v_float_bits(anmag);
+    anexp = v_select(_mm_cmpeq_epi32(anmag, _mm_setzero_si128()),
+                     _mm_set1_epi32(-6),
+                     _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127 + 5)));
+    anmant = _mm_add_epi32(_mm_and_si128(_mm_srli_epi32(bits, 18), _mm_set1_epi32(0x1F)), _mm_set1_epi32(32));
+    wanexp = _mm_add_epi32(anexp, _mm_sub_epi32(_mm_and_si128(_mm_srai_epi32(srn, 6), _mm_set1_epi32(0xF)), _mm_set1_epi32(13)));
+    wanmant = _mm_srai_epi32(_mm_add_epi32(v_mul16(anmant, _mm_and_si128(srn, _mm_set1_epi32(0x3F))), _mm_set1_epi32(0x30)), 4);
+    retval = _mm_and_si128(v_scale(wanmant, wanexp), _mm_set1_epi32(0x7FFF));
+    neg = _mm_srai_epi32(_mm_xor_si128(an, srn), 31);
+    return _mm_sub_epi32(_mm_xor_si128(retval, neg), neg);
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ void v_predict(g726_lanes_t *s, __m128i *sezi, __m128i *se)
+{
+    __m128i z;
+    __m128i p;
+    int i;
+
+    z = v_fmult(_mm_srai_epi32(s->b[0], 2), s->dq[0]);
+    for (i = 1;  i < 6;  i++)
+        z = _mm_add_epi32(z, v_fmult(_mm_srai_epi32(s->b[i], 2), s->dq[i]));
+    z = v_sext16(z);
+    p = v_sext16(_mm_add_epi32(v_fmult(_mm_srai_epi32(s->a[1], 2), s->sr[1]), v_fmult(_mm_srai_epi32(s->a[0], 2), s->sr[0])));
+    *sezi = z;
+    *se = _mm_srai_epi32(v_sext16(_mm_add_epi32(z, p)), 1);
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ __m128i v_step_size(g726_lanes_t *s)
+{
+    __m128i y;
+    __m128i dif;
+    __m128i prod;
+
+    y = _mm_srai_epi32(s->yl, 6);
+    dif = _mm_sub_epi32(s->yu, y);
+    prod = v_mul16(dif, _mm_srai_epi32(s->ap, 2));
+    prod = _mm_add_epi32(prod, _mm_and_si128(_mm_cmplt_epi32(dif, _mm_setzero_si128()), _mm_set1_epi32(0x3F)));
+    y = _mm_add_epi32(y, _mm_srai_epi32(prod, 6));
+    return v_select(_mm_cmpgt_epi32(s->ap, _mm_set1_epi32(255)), s->yu, y);
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ __m128i v_quantize(__m128i d, __m128i y, const g726_rate_params_t *p)
+{
+    __m128i dqm;
+    __m128i dl;
+    __m128i dln;
+    __m128i i;
+    __m128i nonneg;
+    __m128i sign;
+    int size;
+    int k;
+
+    sign = _mm_srai_epi32(d, 31);
+    dqm = _mm_sub_epi32(_mm_xor_si128(d, sign), sign);
+    /* LOG. This is (exp << 7) + mant, straight from the floating point bits. */
+    dl = _mm_sub_epi32(_mm_srli_epi32(v_float_bits(dqm), 16), _mm_set1_epi32(127 << 7));
+    dl = _mm_andnot_si128(_mm_srai_epi32(dl, 31), dl);
+    /* SUBTB */
+    dln = v_sext16(_mm_sub_epi32(dl, v_sext16(_mm_srai_epi32(y, 2))));
+    /* QUAN. The table rises, so the search result is a count. */
+    size = (p->quantizer_states - 1) >> 1;
+    i = _mm_setzero_si128();
+    for (k = 0;  k < size;  k++)
+        i = _mm_sub_epi32(i, _mm_cmpgt_epi32(dln, _mm_set1_epi32(p->qtab[k] - 1)));
+    /* Zero is only valid if there are an even number of states */
+    nonneg = i;
+    if ((p->quantizer_states & 1))
+        nonneg = v_select(_mm_cmpeq_epi32(i, _mm_setzero_si128()), _mm_set1_epi32(p->quantizer_states), i);
+    return v_select(sign, _mm_sub_epi32(_mm_set1_epi32((size << 1) + 1), i), nonneg);
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ __m128i v_reconstruct(__m128i code, __m128i dqln, __m128i y, const g726_rate_params_t *p)
+{
+    __m128i dql;
+    __m128i dq;
+    __m128i dex;
+    __m128i dqt;
+    __m128i sign;
+
+    dql = v_sext16(_mm_add_epi32(dqln, _mm_srai_epi32(y, 2)));
+    /* ANTILOG */
+    dex = _mm_and_si128(_mm_srai_epi32(dql, 7), _mm_set1_epi32(15));
+    dqt = _mm_add_epi32(_mm_set1_epi32(128), _mm_and_si128(dql, _mm_set1_epi32(127)));
+    dq = v_scale(dqt, _mm_sub_epi32(dex, _mm_set1_epi32(7)));
+    dq = _mm_andnot_si128(_mm_srai_epi32(dql, 31), dq);
+    sign = _mm_cmpeq_epi32(_mm_and_si128(code, _mm_set1_epi32(p->sign_bit)), _mm_set1_epi32(p->sign_bit));
+    return _mm_sub_epi32(dq, _mm_and_si128(sign, _mm_set1_epi32(0x8000)));
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ void v_update(g726_lanes_t *s,
+                                __m128i y,
+                                __m128i wi,
+                                __m128i fi,
+                                __m128i dq,
+                                __m128i sr,
+                                __m128i dqsez,
+                                const g726_rate_params_t *p)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i mag;
+    __m128i a2p;
+    __m128i a2p_new;
+    __m128i a0;
+    __m128i a1ul;
+    __m128i pk0;
+    __m128i pks1;
+    __m128i fa1;
+    __m128i nz;
+    __m128i tr;
+    __m128i thr;
+    __m128i dqthr;
+    __m128i ylint;
+    __m128i x;
+    __m128i b;
+    int i;
+
+    pk0 = _mm_srli_epi32(dqsez, 31);
+    mag = _mm_and_si128(dq, _mm_set1_epi32(0x7FFF));
+    /* TRANS */
+    ylint = _mm_srai_epi32(s->yl, 15);
+    x = _mm_add_epi32(_mm_set1_epi32(32), _mm_and_si128(_mm_srai_epi32(s->yl, 10), _mm_set1_epi32(0x1F)));
+    thr = v_mul16(x, v_scale(_mm_set1_epi32(1), ylint));
+    thr = v_select(_mm_cmpgt_epi32(ylint, _mm_set1_epi32(9)), _mm_set1_epi32(31 << 10), thr);
+    dqthr = _mm_srai_epi32(_mm_add_epi32(thr, _mm_srai_epi32(thr, 1)), 1);
+    tr = _mm_and_si128(s->td, _mm_cmpgt_epi32(mag, dqthr));
+
+    /* FUNCTW & FILTD & DELAY */
+    x = v_sext16(_mm_add_epi32(y, _mm_srai_epi32(_mm_sub_epi32(wi, y), 5)));
+    /* LIMB */
+    x = v_select(_mm_cmplt_epi32(x, _mm_set1_epi32(544)), _mm_set1_epi32(544), x);
+    x = v_select(_mm_cmpgt_epi32(x, _mm_set1_epi32(5120)), _mm_set1_epi32(5120), x);
+    s->yu = x;
+    /* FILTE & DELAY */
+    s->yl = _mm_add_epi32(s->yl, _mm_add_epi32(x, _mm_srai_epi32(_mm_sub_epi32(zero, s->yl), 6)));
+
+    /* UPA2 */
+    pks1 = _mm_xor_si128(pk0, s->pk[0]);
+    nz = _mm_xor_si128(_mm_cmpeq_epi32(dqsez, zero), _mm_set1_epi32(-1));
+    a2p = v_sext16(_mm_sub_epi32(s->a[1], _mm_srai_epi32(s->a[1], 7)));
+    fa1 = v_select(_mm_cmpeq_epi32(pks1, zero), _mm_sub_epi32(zero, s->a[0]), s->a[0]);
+    x = v_select(_mm_cmplt_epi32(fa1, _mm_set1_epi32(-8191)),
+                 _mm_set1_epi32(-0x100),
+                 v_select(_mm_cmpgt_epi32(fa1, _mm_set1_epi32(8191)), _mm_set1_epi32(0xFF), _mm_srai_epi32(fa1, 5)));
+    a2p_new = v_sext16(_mm_add_epi32(a2p, x));
+    /* LIMC */
+    x = v_select(_mm_cmpeq_epi32(_mm_xor_si128(pk0, s->pk[1]), zero),
+                 v_select(_mm_cmplt_epi32(a2p_new, _mm_set1_epi32(-12415)),
+                          _mm_set1_epi32(-12288),
+                          v_select(_mm_cmpgt_epi32(a2p_new, _mm_set1_epi32(12159)),
+                                   _mm_set1_epi32(12288),
+                                   _mm_add_epi32(a2p_new, _mm_set1_epi32(0x80)))),
+                 v_select(_mm_cmplt_epi32(a2p_new, _mm_set1_epi32(-12159)),
+                          _mm_set1_epi32(-12288),
+                          v_select(_mm_cmpgt_epi32(a2p_new, _mm_set1_epi32(12415)),
+                                   _mm_set1_epi32(12288),
+                                   _mm_sub_epi32(a2p_new, _mm_set1_epi32(0x80)))));
+    a2p = v_select(nz, v_sext16(x), a2p);
+
+    /* UPA1 */
+    a0 = _mm_sub_epi32(s->a[0], _mm_srai_epi32(s->a[0], 8));
+    x = v_select(_mm_cmpeq_epi32(pks1, zero), _mm_set1_epi32(192), _mm_set1_epi32(-192));
+    a0 = v_sext16(_mm_add_epi32(a0, _mm_and_si128(nz, x)));
+    /* LIMD */
+    a1ul = v_sext16(_mm_sub_epi32(_mm_set1_epi32(15360), a2p));
+    x = _mm_sub_epi32(zero, a1ul);
+    a0 = v_select(_mm_cmplt_epi32(a0, x), x, a0);
+    a0 = v_select(_mm_cmpgt_epi32(a0, a1ul), a1ul, a0);
+    /* Reset the a's and b's for a modem signal */
+    s->a[1] = _mm_andnot_si128(tr, a2p);
+    s->a[0] = _mm_andnot_si128(tr, a0);
+
+    /* UPB */
+    nz = _mm_xor_si128(_mm_cmpeq_epi32(mag, zero), _mm_set1_epi32(-1));
+    for (i = 0;  i < 6;  i++)
+    {
+        b = _mm_sub_epi32(s->b[i], _mm_sra_epi32(s->b[i], _mm_cvtsi32_si128(p->b_shift)));
+        /* XOR */
+        x = v_select(_mm_srai_epi32(_mm_xor_si128(dq, s->dq[i]), 31), _mm_set1_epi32(-128), _mm_set1_epi32(128));
+        b = v_sext16(_mm_add_epi32(b, _mm_and_si128(nz, x)));
+        s->b[i] = _mm_andnot_si128(tr, b);
+    }
+
+    for (i = 5;  i > 0;  i--)
+        s->dq[i] = s->dq[i - 1];
+    /* FLOAT A */
+    x = v_float_format(mag);
+    s->dq[0] = _mm_sub_epi32(x, _mm_and_si128(_mm_srai_epi32(dq, 31), _mm_set1_epi32(0x400)));
+
+    s->sr[1] = s->sr[0];
+    /* FLOAT B */
+    b = _mm_srai_epi32(sr, 31);
+    x = v_float_format(_mm_sub_epi32(_mm_xor_si128(sr, b), b));
+    x = _mm_sub_epi32(x, _mm_and_si128(b, _mm_set1_epi32(0x400)));
+    s->sr[0] = v_select(_mm_cmpeq_epi32(sr, _mm_set1_epi32(-32768)), _mm_set1_epi32(-992), x);
+
+    /* DELAY A */
+    s->pk[1] = s->pk[0];
+    s->pk[0] = pk0;
+
+    /* TONE */
+    s->td = _mm_andnot_si128(tr, _mm_cmplt_epi32(_mm_andnot_si128(tr, a2p), _mm_set1_epi32(-11776)));
+
+    /* FILTA */
+    s->dms = v_sext16(_mm_add_epi32(s->dms, _mm_srai_epi32(_mm_sub_epi32(fi, s->dms), 5)));
+    /* FILTB */
+    s->dml = v_sext16(_mm_add_epi32(s->dml, _mm_srai_epi32(_mm_sub_epi32(v_sext16(_mm_slli_epi32(fi, 2)), s->dml), 7)));
+
+    /* SUBTC */
+    x = _mm_sub_epi32(_mm_slli_epi32(s->dms, 2), s->dml);
+    b = _mm_srai_epi32(x, 31);
+    x = _mm_sub_epi32(_mm_xor_si128(x, b), b);
+    nz = _mm_or_si128(_mm_cmplt_epi32(y, _mm_set1_epi32(1536)), s->td);
+    nz = _mm_or_si128(nz, _mm_xor_si128(_mm_cmplt_epi32(x, _mm_srai_epi32(s->dml, 3)), _mm_set1_epi32(-1)));
+    x = v_select(nz,
+                 _mm_add_epi32(s->ap, _mm_srai_epi32(_mm_sub_epi32(_mm_set1_epi32(0x200), s->ap), 4)),
+                 _mm_add_epi32(s->ap, _mm_srai_epi32(_mm_sub_epi32(zero, s->ap), 4)));
+    s->ap = v_sext16(v_select(tr, _mm_set1_epi32(256), x));
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ void v_lookup(__m128i code, const int table[], __m128i *x)
+{
+    int32_t c[G726_LANES] __attribute__((aligned(16)));
+
+    _mm_store_si128((__m128i *) c, code);
+    *x = _mm_set_epi32(table[c[3]], table[c[2]], table[c[1]], table[c[0]]);
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ __m128i v_code(g726_lanes_t *s, __m128i code, __m128i y, __m128i sezi, __m128i se, const g726_rate_params_t *p)
+{
+    __m128i dq;
+    __m128i sr;
+    __m128i dqsez;
+    __m128i dqln;
+    __m128i wi;
+    __m128i fi;
+
+    /* Everything after quantisation, shared by the encoder and decoder. This returns sr. */
+    v_lookup(code, p->dqlntab, &dqln);
+    v_lookup(code, p->witab, &wi);
+    v_lookup(code, p->fitab, &fi);
+    dq = v_reconstruct(code, dqln, y, p);
+    /* Reconstruct the signal */
+    sr = v_select(_mm_cmplt_epi32(dq, _mm_setzero_si128()),
+                  _mm_sub_epi32(se, _mm_and_si128(dq, _mm_set1_epi32(p->dq_mask))),
+                  _mm_add_epi32(se, dq));
+    sr = v_sext16(sr);
+    /* Pole prediction difference */
+    dqsez = v_sext16(_mm_sub_epi32(_mm_add_epi32(sr, _mm_srai_epi32(sezi, 1)), se));
+    v_update(s, y, wi, fi, dq, sr, dqsez, p);
+    return sr;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void lanes_load(g726_lanes_t *v, g726_state_t *s[])
+{
+    int i;
+
+#define LANES_GET(field) _mm_set_epi32(s[3]->field, s[2]->field, s[1]->field, s[0]->field)
+    v->yl = LANES_GET(yl);
+    v->yu = LANES_GET(yu);
+    v->dms = LANES_GET(dms);
+    v->dml = LANES_GET(dml);
+    v->ap = LANES_GET(ap);
+    for (i = 0;  i < 2;  i++)
     {
-        /* Linearize the input sample to 14-bit PCM */
-        switch (s->ext_coding)
+        v->a[i] = LANES_GET(a[i]);
+        v->pk[i] = LANES_GET(pk[i]);
+        v->sr[i] = LANES_GET(sr[i]);
+    }
+    for (i = 0;  i < 6;  i++)
+    {
+        v->b[i] = LANES_GET(b[i]);
+        v->dq[i] = LANES_GET(dq[i]);
+    }
+    v->td = _mm_sub_epi32(_mm_setzero_si128(), LANES_GET(td));
+#undef LANES_GET
+}
+/*- End of function --------------------------------------------------------*/
+
+static void lanes_save(g726_lanes_t *v, g726_state_t *s[], int lanes)
+{
+    int32_t x[G726_LANES] __attribute__((aligned(16)));
+    int i;
+    int j;
+
+#define LANES_PUT(field, val, type) \
+    _mm_store_si128((__m128i *) x, val); \
+    for (j = 0;  j < lanes;  j++) \
+        s[j]->field = (type) x[j]
+    LANES_PUT(yl, v->yl, int32_t);
+    LANES_PUT(yu, v->yu, int16_t);
+    LANES_PUT(dms, v->dms, int16_t);
+    LANES_PUT(dml, v->dml, int16_t);
+    LANES_PUT(ap, v->ap, int16_t);
+    for (i = 0;  i < 2;  i++)
+    {
+        LANES_PUT(a[i], v->a[i], int16_t);
+        LANES_PUT(pk[i], v->pk[i], int16_t);
+        LANES_PUT(sr[i], v->sr[i], int16_t);
+    }
+    for (i = 0;  i < 6;  i++)
+    {
+        LANES_PUT(b[i], v->b[i], int16_t);
+        LANES_PUT(dq[i], v->dq[i], int16_t);
+    }
+    LANES_PUT(td, _mm_sub_epi32(_mm_setzero_si128(), v->td), int);
+#undef LANES_PUT
+}
+/*- End of function --------------------------------------------------------*/
+
+static void encode_lanes(g726_state_t *s[], uint8_t *g726_data[], const int16_t *amp[], int len, int g726_bytes[], int lanes)
+{
+    g726_lanes_t v;
+    g726_state_t *ls[G726_LANES];
+    int32_t in[G726_BANK_BLOCK_LEN][G726_LANES] __attribute__((aligned(16)));
+    int32_t out[G726_BANK_BLOCK_LEN][G726_LANES] __attribute__((aligned(16)));
+    const g726_rate_params_t *p;
+    __m128i y;
+    __m128i sezi;
+    __m128i se;
+    __m128i d;
+    __m128i code;
+    int i;
+    int j;
+    int k;
+    int n;
+
+    p = &rate_params[s[0]->bits_per_sample - 2];
+    /* Unused lanes just shadow the first channel. They are never saved. */
+    for (j = 0;  j < G726_LANES;  j++)
+        ls[j] = s[(j < lanes)  ?  j  :  0];
+    lanes_load(&v, ls);
+    for (i = 0;  i < len;  i += n)
+    {
+        n = (len - i < G726_BANK_BLOCK_LEN)  ?  (len - i)  :  G726_BANK_BLOCK_LEN;
+        for (j = 0;  j < lanes;  j++)
         {
-        case G726_ENCODING_ALAW:
-            sl = alaw_to_linear(((const uint8_t *) amp)[i]) >> 2;
-            break;
-        case G726_ENCODING_ULAW:
-            sl = ulaw_to_linear(((const uint8_t *) amp)[i]) >> 2;
-            break;
-        default:
-            sl = amp[i] >> 2;
+            for (k = 0;  k < n;  k++)
+                in[k][j] = get_linear(s[j], amp[j], i + k);
+        }
+        for (  ;  j < G726_LANES;  j++)
+        {
+            for (k = 0;  k < n;  k++)
+                in[k][j] = in[k][0];
+        }
+        for (k = 0;  k < n;  k++)
+        {
+            v_predict(&v, &sezi, &se);
+            y = v_step_size(&v);
+            d = v_sext16(_mm_sub_epi32(_mm_load_si128((__m128i *) in[k]), se));
+            code = v_quantize(d, y, p);
+            v_code(&v, code, y, sezi, se, p);
+            _mm_store_si128((__m128i *) out[k], code);
+        }
+        for (j = 0;  j < lanes;  j++)
+        {
+            for (k = 0;  k < n;  k++)
+                g726_bytes[j] = put_code(s[j], g726_data[j], g726_bytes[j], (uint8_t) out[k][j]);
+        }
+    }
+    lanes_save(&v, s, lanes);
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ void put_sample(g726_state_t *s, int16_t amp[], int i, int sr, int se, int y, int code)
+{
+    const g726_rate_params_t *p;
+
+    switch (s->ext_coding)
+    {
+    case G726_ENCODING_ALAW:
+        p = &rate_params[s->bits_per_sample - 2];
+        ((uint8_t *) amp)[i] = (uint8_t) tandem_adjust_alaw((int16_t) sr, se, y, code, p->sign_bit, p->qtab, p->quantizer_states);
+        break;
+    case G726_ENCODING_ULAW:
+        p = &rate_params[s->bits_per_sample - 2];
+        ((uint8_t *) amp)[i] = (uint8_t) tandem_adjust_ulaw((int16_t) sr, se, y, code, p->sign_bit, p->qtab, p->quantizer_states);
+        break;
+    default:
+        amp[i] = (int16_t) (sr << 2);
+        break;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static void decode_lanes(g726_state_t *s[], int16_t *amp[], const uint8_t *g726_data[], int g726_bytes, int samples[], int lanes)
+{
+    g726_lanes_t v;
+    g726_state_t *ls[G726_LANES];
+    int32_t codes[G726_BANK_BLOCK_LEN][G726_LANES] __attribute__((aligned(16)));
+    int32_t srs[G726_BANK_BLOCK_LEN][G726_LANES] __attribute__((aligned(16)));
+    int32_t ses[G726_BANK_BLOCK_LEN][G726_LANES] __attribute__((aligned(16)));
+    int32_t ys[G726_BANK_BLOCK_LEN][G726_LANES] __attribute__((aligned(16)));
+    int pos[G726_LANES];
+    int n[G726_LANES];
+    const g726_rate_params_t *p;
+    __m128i y;
+    __m128i sezi;
+    __m128i se;
+    __m128i code;
+    int code_mask;
+    int min_n;
+    int max_n;
+    int sl;
+    int c;
+    int j;
+    int k;
+
+    p = &rate_params[s[0]->bits_per_sample - 2];
+    code_mask = (1 << s[0]->bits_per_sample) - 1;
+    for (j = 0;  j < G726_LANES;  j++)
+        ls[j] = s[(j < lanes)  ?  j  :  0];
+    for (j = 0;  j < lanes;  j++)
+    {
+        pos[j] = 0;
+        samples[j] = 0;
+    }
+    lanes_load(&v, ls);
+    for (;;)
+    {
+        /* The channels may not all yield the same number of codes from the same number
+           of bytes, as their packing and bit alignment can differ. Step them together
+           as far as they all go, and finish off any stragglers one at a time. */
+        min_n = G726_BANK_BLOCK_LEN;
+        max_n = 0;
+        for (j = 0;  j < lanes;  j++)
+        {
+            for (n[j] = 0;  n[j] < G726_BANK_BLOCK_LEN;  n[j]++)
+            {
+                if ((c = get_code(s[j], g726_data[j], &pos[j], g726_bytes)) < 0)
+                    break;
+                codes[n[j]][j] = c & code_mask;
+            }
+            if (n[j] < min_n)
+                min_n = n[j];
+            if (n[j] > max_n)
+                max_n = n[j];
+        }
+        if (max_n == 0)
             break;
+        for (  ;  j < G726_LANES;  j++)
+        {
+            for (k = 0;  k < min_n;  k++)
+                codes[k][j] = codes[k][0];
+        }
+        for (k = 0;  k < min_n;  k++)
+        {
+            v_predict(&v, &sezi, &se);
+            y = v_step_size(&v);
+            code = _mm_load_si128((__m128i *) codes[k]);
+            _mm_store_si128((__m128i *) srs[k], v_code(&v, code, y, sezi, se, p));
+            _mm_store_si128((__m128i *) ses[k], se);
+            _mm_store_si128((__m128i *) ys[k], y);
+        }
+        for (j = 0;  j < lanes;  j++)
+        {
+            for (k = 0;  k < min_n;  k++)
+                put_sample(s[j], amp[j], samples[j] + k, srs[k][j], ses[k][j], ys[k][j], codes[k][j]);
+            samples[j] += min_n;
         }
-        code = s->enc_func(s, sl);
-        if (s->packing != G726_PACKING_NONE)
+        if (max_n > min_n)
         {
-            /* Pack the code bits */
-            if (s->packing != G726_PACKING_LEFT)
+            lanes_save(&v, s, lanes);
+            for (j = 0;  j < lanes;  j++)
             {
-                s->bs.bitstream |= (code << s->bs.residue);
-                s->bs.residue += s->bits_per_sample;
-                if (s->bs.residue >= 8)
+                for (k = min_n;  k < n[j];  k++)
                 {
-                    g726_data[g726_bytes++] = (uint8_t) (s->bs.bitstream & 0xFF);
-                    s->bs.bitstream >>= 8;
-                    s->bs.residue -= 8;
+                    sl = s[j]->dec_func(s[j], (uint8_t) codes[k][j]);
+                    if (s[j]->ext_coding != G726_ENCODING_LINEAR)
+                        ((uint8_t *) amp[j])[samples[j]++] = (uint8_t) sl;
+                    else
+                        amp[j][samples[j]++] = (int16_t) sl;
                 }
             }
-            else
+            lanes_load(&v, ls);
+        }
+    }
+    lanes_save(&v, s, lanes);
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+SPAN_DECLARE(int) g726_decode_batch(g726_state_t *s[],
+                                    int16_t *amp[],
+                                    const uint8_t *g726_data[],
+                                    int g726_bytes,
+                                    int samples[],
+                                    int channels)
+{
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+    g726_state_t *ls[G726_LANES];
+    int16_t *lamp[G726_LANES];
+    const uint8_t *ldata[G726_LANES];
+    int *lsamples[G726_LANES];
+    int lsamp[G726_LANES];
+    int bits;
+    int lanes;
+    int j;
+    int k;
+
+    /* Gather the channels which use the same bit rate into groups, which are coded
+       in parallel. */
+    for (bits = 2;  bits <= 5;  bits++)
+    {
+        for (k = 0, lanes = 0;  k < channels;  k++)
+        {
+            if (s[k]->bits_per_sample == bits)
+            {
+                ls[lanes] = s[k];
+                lamp[lanes] = amp[k];
+                ldata[lanes] = g726_data[k];
+                lsamples[lanes] = &samples[k];
+                lanes++;
+            }
+            if (lanes == G726_LANES  ||  (lanes > 0  &&  k == channels - 1))
             {
-                s->bs.bitstream = (s->bs.bitstream << s->bits_per_sample) | code;
-                s->bs.residue += s->bits_per_sample;
-                if (s->bs.residue >= 8)
+                if (lanes == 1)
+                {
+                    lsamp[0] = g726_decode(ls[0], lamp[0], ldata[0], g726_bytes);
+                }
+                else
                 {
-                    g726_data[g726_bytes++] = (uint8_t) ((s->bs.bitstream >> (s->bs.residue - 8)) & 0xFF);
-                    s->bs.residue -= 8;
+                    decode_lanes(ls, lamp, ldata, g726_bytes, lsamp, lanes);
                 }
+                for (j = 0;  j < lanes;  j++)
+                    *lsamples[j] = lsamp[j];
+                lanes = 0;
             }
         }
-        else
+    }
+#else
+    int k;
+
+    for (k = 0;  k < channels;  k++)
+        samples[k] = g726_decode(s[k], amp[k], g726_data[k], g726_bytes);
+#endif
+    return channels;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) g726_encode_batch(g726_state_t *s[],
+                                    uint8_t *g726_data[],
+                                    const int16_t *amp[],
+                                    int len,
+                                    int g726_bytes[],
+                                    int channels)
+{
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+    g726_state_t *ls[G726_LANES];
+    uint8_t *ldata[G726_LANES];
+    const int16_t *lamp[G726_LANES];
+    int *lbytes[G726_LANES];
+    int lb[G726_LANES];
+    int bits;
+    int lanes;
+    int j;
+    int k;
+
+    for (bits = 2;  bits <= 5;  bits++)
+    {
+        for (k = 0, lanes = 0;  k < channels;  k++)
         {
-            g726_data[g726_bytes++] = (uint8_t) code;
+            if (s[k]->bits_per_sample == bits)
+            {
+                ls[lanes] = s[k];
+                ldata[lanes] = g726_data[k];
+                lamp[lanes] = amp[k];
+                lbytes[lanes] = &g726_bytes[k];
+                lanes++;
+            }
+            if (lanes == G726_LANES  ||  (lanes > 0  &&  k == channels - 1))
+            {
+                if (lanes == 1)
+                {
+                    lb[0] = g726_encode(ls[0], ldata[0], lamp[0], len);
+                }
+                else
+                {
+                    for (j = 0;  j < lanes;  j++)
+                        lb[j] = 0;
+                    encode_lanes(ls, ldata, lamp, len, lb, lanes);
+                }
+                for (j = 0;  j < lanes;  j++)
+                    *lbytes[j] = lb[j];
+                lanes = 0;
+            }
         }
     }
-    return g726_bytes;
+#else
+    int k;
+
+    for (k = 0;  k < channels;  k++)
+        g726_bytes[k] = g726_encode(s[k], g726_data[k], amp[k], len);
+#endif
+    return channels;
 }
 /*- End of function --------------------------------------------------------*/
 /*- End of file ------------------------------------------------------------*/
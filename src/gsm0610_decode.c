@@ -349,4 +349,14 @@ SPAN_DECLARE(int) gsm0610_decode(gsm0610_state_t *s, int16_t amp[], const uint8_
     return samples;
 }
 /*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) gsm0610_decode_batch(gsm0610_state_t *s[], int16_t *amp[], const uint8_t *code[], int len, int samples[], int channels)
+{
+    int k;
+
+    for (k = 0;  k < channels;  k++)
+        samples[k] = gsm0610_decode(s[k], amp[k], code[k], len);
+    return channels;
+}
+/*- End of function --------------------------------------------------------*/
 /*- End of file ------------------------------------------------------------*/
@@ -45,6 +45,7 @@
 #include <memory.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/fast_convert.h"
 #include "spandsp/bitstream.h"
 #include "spandsp/saturated.h"
@@ -115,7 +116,7 @@ SPAN_DECLARE(gsm0610_state_t *) gsm0610_init(gsm0610_state_t *s, int packing)
 {
     if (s == NULL)
     {
-        if ((s = (gsm0610_state_t *) malloc(sizeof (*s))) == NULL)
+        if ((s = (gsm0610_state_t *) span_alloc(sizeof (*s))) == NULL)
             return  NULL;
         /*endif*/
     }
@@ -136,7 +137,7 @@ SPAN_DECLARE(int) gsm0610_release(gsm0610_state_t *s)
 SPAN_DECLARE(int) gsm0610_free(gsm0610_state_t *s)
 {
     if (s)
-        free(s);
+        span_free(s);
     /*endif*/
     return 0;
 }
@@ -337,4 +338,17 @@ SPAN_DECLARE(int) gsm0610_encode(gsm0610_state_t *s, uint8_t code[], const int16
     return bytes;
 }
 /*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) gsm0610_encode_batch(gsm0610_state_t *s[], uint8_t *code[], const int16_t *amp[], int len, int bytes[], int channels)
+{
+    int k;
+
+    /* Each frame is packed straight into the caller's buffer as it is encoded, so
+       there is nothing to gain from staging frames. Taking each channel's block in
+       turn keeps that channel's state hot while its frames are processed. */
+    for (k = 0;  k < channels;  k++)
+        bytes[k] = gsm0610_encode(s[k], code[k], amp[k], len);
+    return channels;
+}
+/*- End of function --------------------------------------------------------*/
 /*- End of file ------------------------------------------------------------*/
@@ -167,6 +167,52 @@ static __inline__ int16_t gsm_asl(int16_t a, int n)
 }
 /*- End of function --------------------------------------------------------*/
 
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+#include "mmx_sse_decs.h"
+
+/* Lanes 0 to 3 of the result are the sums of the lanes of a, b, c and d */
+static __inline__ __m128i gsm0610_sum_4x4(__m128i a, __m128i b, __m128i c, __m128i d)
+{
+    __m128i ab;
+    __m128i cd;
+
+    ab = _mm_add_epi32(_mm_unpacklo_epi32(a, b), _mm_unpackhi_epi32(a, b));
+    cd = _mm_add_epi32(_mm_unpacklo_epi32(c, d), _mm_unpackhi_epi32(c, d));
+    return _mm_add_epi32(_mm_unpacklo_epi64(ab, cd), _mm_unpackhi_epi64(ab, cd));
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ int32_t gsm0610_sum_4(__m128i a)
+{
+    a = _mm_add_epi32(a, _mm_shuffle_epi32(a, _MM_SHUFFLE(1, 0, 3, 2)));
+    a = _mm_add_epi32(a, _mm_shuffle_epi32(a, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(a);
+}
+/*- End of function --------------------------------------------------------*/
+
+/* The largest saturated_abs16() of n samples, where n is a multiple of 8 */
+static __inline__ int16_t gsm0610_max_abs(const int16_t x[], int n)
+{
+    __m128i y;
+    __m128i z;
+    int i;
+
+    z = _mm_setzero_si128();
+    for (i = 0;  i < n;  i += 8)
+    {
+        y = _mm_loadu_si128((const __m128i *) &x[i]);
+        /* The saturating subtraction turns -32768 into 32767 */
+        z = _mm_max_epi16(z, _mm_max_epi16(y, _mm_subs_epi16(_mm_setzero_si128(), y)));
+    }
+    /*endfor*/
+    z = _mm_max_epi16(z, _mm_shuffle_epi32(z, _MM_SHUFFLE(1, 0, 3, 2)));
+    z = _mm_max_epi16(z, _mm_shuffle_epi32(z, _MM_SHUFFLE(2, 3, 0, 1)));
+    z = _mm_max_epi16(z, _mm_srli_epi32(z, 16));
+    return (int16_t) _mm_cvtsi128_si32(z);
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
 extern void gsm0610_long_term_predictor(gsm0610_state_t *s,
                                         int16_t d[40],
                                         int16_t *dp,        /* [-120..-1] d'        IN  */
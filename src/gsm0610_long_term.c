@@ -43,6 +43,8 @@
 #include "floating_fudge.h"
 #include <stdlib.h>
 
+#include "mmx_sse_decs.h"
+
 #include "spandsp/telephony.h"
 #include "spandsp/fast_convert.h"
 #include "spandsp/bitstream.h"
@@ -65,6 +67,62 @@ static const int16_t gsm_QLB[4] =
 
 /* 4.2.11 .. 4.2.12 LONG TERM PREDICTOR (LTP) SECTION */
 
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+static __inline__ __m128i cross_corr(const __m128i wt[5], const int16_t *dp)
+{
+    __m128i sum;
+
+    /* The 40 products in 4 partial sums. Integer addition wraps in the same way
+       whatever the order, so this matches the plain C sum exactly. */
+    sum = _mm_madd_epi16(wt[0], _mm_loadu_si128((const __m128i *) &dp[0]));
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(wt[1], _mm_loadu_si128((const __m128i *) &dp[8])));
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(wt[2], _mm_loadu_si128((const __m128i *) &dp[16])));
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(wt[3], _mm_loadu_si128((const __m128i *) &dp[24])));
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(wt[4], _mm_loadu_si128((const __m128i *) &dp[32])));
+    return sum;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int32_t gsm0610_max_cross_corr(const int16_t *wt, const int16_t *dp, int16_t *index_out)
+{
+    int32_t res[81] __attribute__((aligned(16)));
+    __m128i w[5];
+    int32_t max;
+    int32_t index;
+    int i;
+
+    for (i = 0;  i < 5;  i++)
+        w[i] = _mm_loadu_si128((const __m128i *) &wt[8*i]);
+    /*endfor*/
+    /* Four lags at a time, for lags 40 to 119 */
+    for (i = 0;  i < 80;  i += 4)
+    {
+        _mm_store_si128((__m128i *) &res[i],
+                        gsm0610_sum_4x4(cross_corr(w, &dp[-40 - i]),
+                                        cross_corr(w, &dp[-41 - i]),
+                                        cross_corr(w, &dp[-42 - i]),
+                                        cross_corr(w, &dp[-43 - i])));
+    }
+    /*endfor*/
+    res[80] = gsm0610_sum_4(cross_corr(w, &dp[-120]));
+
+    max = 0;
+    index = 40; /* index for the maximum cross-correlation */
+    for (i = 0;  i <= 80;  i++)
+    {
+        if (res[i] > max)
+        {
+            max = res[i];
+            index = i + 40;
+        }
+        /*endif*/
+    }
+    /*endfor*/
+    *index_out = index;
+    return max;
+}
+/*- End of function --------------------------------------------------------*/
+#else
 static int32_t gsm0610_max_cross_corr(const int16_t *wt, const int16_t *dp, int16_t *index_out)
 {
     int32_t max;
@@ -233,6 +291,7 @@ static int32_t gsm0610_max_cross_corr(const int16_t *wt, const int16_t *dp, int1
     return max;
 }
 /*- End of function --------------------------------------------------------*/
+#endif
 
 /* This procedure computes the LTP gain (bc) and the LTP lag (Nc)
    for the long term analysis filter.   This is done by calculating a
@@ -262,9 +321,18 @@ static int16_t evaluate_ltp_parameters(int16_t d[40],
     int16_t dmax;
     int16_t scale;
     int16_t temp;
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+    __m128i x;
+    __m128i y;
+    __m128i shift;
+#else
     int32_t L_temp;
+#endif
 
     /* Search of the optimum scaling of d[0..39]. */
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+    dmax = gsm0610_max_abs(d, 40);
+#else
     dmax = 0;
     for (k = 0;  k < 40;  k++)
     {
@@ -275,6 +343,7 @@ static int16_t evaluate_ltp_parameters(int16_t d[40],
         /*endif*/
     }
     /*endfor*/
+#endif
 
     if (dmax == 0)
     {
@@ -295,9 +364,16 @@ static int16_t evaluate_ltp_parameters(int16_t d[40],
     assert(scale >= 0);
 
     /* Initialization of a working array wt */
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+    shift = _mm_cvtsi32_si128(scale);
+    for (k = 0;  k < 40;  k += 8)
+        _mm_storeu_si128((__m128i *) &wt[k], _mm_sra_epi16(_mm_loadu_si128((const __m128i *) &d[k]), shift));
+    /*endfor*/
+#else
     for (k = 0;  k < 40;  k++)
         wt[k] = d[k] >> scale;
     /*endfor*/
+#endif
 
     /* Search for the maximum cross-correlation and coding of the LTP lag */
     L_max = gsm0610_max_cross_corr(wt, dp, Nc_out);
@@ -310,6 +386,16 @@ static int16_t evaluate_ltp_parameters(int16_t d[40],
     assert(*Nc_out <= 120  &&  *Nc_out >= 40);
 
     /* Compute the power of the reconstructed short term residual signal dp[..] */
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+    y = _mm_setzero_si128();
+    for (k = 0;  k < 40;  k += 8)
+    {
+        x = _mm_srai_epi16(_mm_loadu_si128((const __m128i *) &dp[k - *Nc_out]), 3);
+        y = _mm_add_epi32(y, _mm_madd_epi16(x, x));
+    }
+    /*endfor*/
+    L_power = gsm0610_sum_4(y);
+#else
     L_power = 0;
     for (k = 0;  k < 40;  k++)
     {
@@ -317,6 +403,7 @@ static int16_t evaluate_ltp_parameters(int16_t d[40],
         L_power += L_temp*L_temp;
     }
     /*endfor*/
+#endif
     L_power <<= 1;  /* from L_MULT */
 
     /* Normalization of L_max and L_power */
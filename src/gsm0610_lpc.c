@@ -44,6 +44,8 @@
 #include <stdlib.h>
 #include <memory.h>
 
+#include "mmx_sse_decs.h"
+
 #include "spandsp/telephony.h"
 #include "spandsp/fast_convert.h"
 #include "spandsp/bitstream.h"
@@ -132,7 +134,7 @@ static int16_t gsm_div(int16_t num, int16_t denom)
 }
 /*- End of function --------------------------------------------------------*/
 
-#if defined(__GNUC__)  &&  defined(SPANDSP_USE_MMX)
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_MMX)  &&  !defined(SPANDSP_USE_SSE2)
 static void gsm0610_vec_vsraw(const int16_t *p, int n, int bits)
 {
     static const int64_t ones = 0x0001000100010001LL;
@@ -272,6 +274,87 @@ static void gsm0610_vec_vsraw(const int16_t *p, int n, int bits)
 #endif
 
 /* 4.2.4 */
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+static void autocorrelation(int16_t amp[GSM0610_FRAME_LEN], int32_t L_ACF[9])
+{
+    /* The scaled signal, followed by zeros, so every lag can be summed over the
+       whole frame in steps of 8 samples */
+    int16_t s[GSM0610_FRAME_LEN + 16] __attribute__((aligned(16)));
+    __m128i acf[9];
+    __m128i x;
+    __m128i y;
+    __m128i shift;
+    __m128i shift_less_1;
+    __m128i one;
+    int16_t smax;
+    int16_t scalauto;
+    int i;
+    int k;
+
+    /* The goal is to compute the array L_ACF[k].  The signal s[i] must
+       be scaled in order to avoid an overflow situation. */
+
+    /* Dynamic scaling of the array  s[0..159] */
+    /* Search for the maximum. */
+    smax = gsm0610_max_abs(amp, GSM0610_FRAME_LEN);
+
+    /* Computation of the scaling factor. */
+    if (smax == 0)
+    {
+        scalauto = 0;
+    }
+    else
+    {
+        assert(smax > 0);
+        scalauto = (int16_t) (4 - gsm0610_norm((int32_t) smax << 16));
+    }
+    /*endif*/
+
+    /* Scaling of the array s[0...159] */
+    if (scalauto > 0)
+    {
+        assert(scalauto <= 4);
+        /* gsm_mult_r(amp[k], 16384 >> (scalauto - 1)) is amp[k] >> scalauto, rounded,
+           which is also (amp[k] >> scalauto) + the bit just below the point. Unlike
+           adding the rounding constant this cannot overflow. The array is then rescaled
+           in place, which loses the low bits, as the reference code does. */
+        shift = _mm_cvtsi32_si128(scalauto);
+        shift_less_1 = _mm_cvtsi32_si128(scalauto - 1);
+        one = _mm_set1_epi16(1);
+        for (i = 0;  i < GSM0610_FRAME_LEN;  i += 8)
+        {
+            x = _mm_loadu_si128((const __m128i *) &amp[i]);
+            y = _mm_add_epi16(_mm_sra_epi16(x, shift), _mm_and_si128(_mm_sra_epi16(x, shift_less_1), one));
+            _mm_store_si128((__m128i *) &s[i], y);
+            _mm_storeu_si128((__m128i *) &amp[i], _mm_sll_epi16(y, shift));
+        }
+        /*endfor*/
+    }
+    else
+    {
+        memcpy(s, amp, GSM0610_FRAME_LEN*sizeof(amp[0]));
+    }
+    /*endif*/
+    memset(&s[GSM0610_FRAME_LEN], 0, 16*sizeof(s[0]));
+
+    /* Compute the L_ACF[..]. */
+    for (k = 0;  k < 9;  k++)
+        acf[k] = _mm_setzero_si128();
+    /*endfor*/
+    for (i = 0;  i < GSM0610_FRAME_LEN;  i += 8)
+    {
+        x = _mm_load_si128((const __m128i *) &s[i]);
+        for (k = 0;  k < 9;  k++)
+            acf[k] = _mm_add_epi32(acf[k], _mm_madd_epi16(x, _mm_loadu_si128((const __m128i *) &s[i + k])));
+        /*endfor*/
+    }
+    /*endfor*/
+    _mm_storeu_si128((__m128i *) &L_ACF[0], _mm_slli_epi32(gsm0610_sum_4x4(acf[0], acf[1], acf[2], acf[3]), 1));
+    _mm_storeu_si128((__m128i *) &L_ACF[4], _mm_slli_epi32(gsm0610_sum_4x4(acf[4], acf[5], acf[6], acf[7]), 1));
+    L_ACF[8] = gsm0610_sum_4(acf[8]) << 1;
+}
+/*- End of function --------------------------------------------------------*/
+#else
 static void autocorrelation(int16_t amp[GSM0610_FRAME_LEN], int32_t L_ACF[9])
 {
     int k;
@@ -411,7 +494,7 @@ static void autocorrelation(int16_t amp[GSM0610_FRAME_LEN], int32_t L_ACF[9])
     /* Rescaling of the array s[0..159] */
     if (scalauto > 0)
     {
-        assert(scalauto <= 4); 
+        assert(scalauto <= 4);
         for (k = 0;  k < GSM0610_FRAME_LEN;  k++)
             amp[k] <<= scalauto;
         /*endfor*/
@@ -419,6 +502,7 @@ static void autocorrelation(int16_t amp[GSM0610_FRAME_LEN], int32_t L_ACF[9])
     /*endif*/
 }
 /*- End of function --------------------------------------------------------*/
+#endif
 
 /* 4.2.5 */
 static void reflection_coefficients(int32_t L_ACF[9], int16_t r[8])
@@ -59,7 +59,52 @@
 static void weighting_filter(int16_t x[40],
                              const int16_t *e)      // signal [-5..0.39.44] IN)
 {
-#if defined(__GNUC__)  &&  defined(SPANDSP_USE_MMX)  &&  defined(__x86_64__)
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+    /* Table 4.4   Coefficients of the weighting filter, paired up for pmaddwd,
+       with the zero coefficients left out. Each pair is the offsets of two taps,
+       and the coefficients for those taps. */
+    static const struct
+    {
+        int i0;
+        int i1;
+        int32_t h;
+    } gsm_H_pairs[5] =
+    {
+        {0, 1, (-374 << 16) | (-134 & 0xFFFF)},
+        {3, 4, (5741 << 16) | 2054},
+        {5, 6, (5741 << 16) | 8192},
+        {7, 9, (-374 << 16) | 2054},
+        {10, 10, -134 & 0xFFFF}
+    };
+    __m128i a;
+    __m128i b;
+    __m128i h;
+    __m128i lo;
+    __m128i hi;
+    int i;
+    int k;
+
+    /* Eight outputs at a time. The last pair has a zero second coefficient, so
+       what is paired with its tap does not matter. e[-5..-1] and e[40..44] are
+       zero, as for the plain C code below. */
+    e -= 5;
+    for (k = 0;  k < 40;  k += 8)
+    {
+        lo =
+        hi = _mm_set1_epi32(8192 >> 1);
+        for (i = 0;  i < 5;  i++)
+        {
+            a = _mm_loadu_si128((const __m128i *) &e[k + gsm_H_pairs[i].i0]);
+            b = _mm_loadu_si128((const __m128i *) &e[k + gsm_H_pairs[i].i1]);
+            h = _mm_set1_epi32(gsm_H_pairs[i].h);
+            lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), h));
+            hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), h));
+        }
+        /*endfor*/
+        _mm_storeu_si128((__m128i *) &x[k], _mm_packs_epi32(_mm_srai_epi32(lo, 13), _mm_srai_epi32(hi, 13)));
+    }
+    /*endfor*/
+#elif defined(__GNUC__)  &&  defined(SPANDSP_USE_MMX)  &&  defined(__x86_64__)
     /* Table 4.4   Coefficients of the weighting filter */
     /* This must be padded to a multiple of 4 for MMX to work */
     static const union
@@ -231,6 +276,84 @@ static void weighting_filter(int16_t x[40],
 /*- End of function --------------------------------------------------------*/
 
 /* 4.2.14 */
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+static void rpe_grid_selection(int16_t x[40], int16_t xM[13], int16_t *Mc_out)
+{
+    /* Masks picking out grids 0, 1 and 2. Grid 3 is grid 0 moved along by one
+       sample. */
+    static const int16_t grid_mask[3][40] __attribute__((aligned(16))) =
+    {
+        {
+            -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0,
+            0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, 0
+        },
+        {
+            0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1,
+            0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0
+        },
+        {
+            0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0,
+            -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0
+        }
+    };
+    __m128i y;
+    __m128i L_grid[3];
+    int32_t L_result;
+    int32_t EM;
+    int32_t L_temp;
+    int16_t Mc;
+    int i;
+    int m;
+
+    /* The signal x[0..39] is used to select the RPE grid which is
+       represented by Mc. */
+    for (m = 0;  m < 3;  m++)
+        L_grid[m] = _mm_setzero_si128();
+    /*endfor*/
+    for (i = 0;  i < 40;  i += 8)
+    {
+        y = _mm_srai_epi16(_mm_loadu_si128((const __m128i *) &x[i]), 2);
+        for (m = 0;  m < 3;  m++)
+            L_grid[m] = _mm_add_epi32(L_grid[m], _mm_madd_epi16(_mm_and_si128(y, *((const __m128i *) grid_mask[m] + (i >> 3))), y));
+        /*endfor*/
+    }
+    /*endfor*/
+
+    /* i = 0 */
+    L_result = gsm0610_sum_4(L_grid[0]);
+    EM = L_result << 1;
+    Mc = 0;
+    for (m = 1;  m < 3;  m++)
+    {
+        L_temp = gsm0610_sum_4(L_grid[m]) << 1;
+        if (L_temp > EM)
+        {
+            Mc = m;
+            EM = L_temp;
+        }
+        /*endif*/
+    }
+    /*endfor*/
+
+    /* i = 3 */
+    L_temp = x[0] >> 2;
+    L_result -= L_temp*L_temp;
+    L_temp = x[39] >> 2;
+    L_result += L_temp*L_temp;
+    L_result <<= 1;
+    if (L_result > EM)
+        Mc = 3;
+    /*endif*/
+
+    /* Down-sampling by a factor 3 to get the selected xM[0..12]
+       RPE sequence. */
+    for (i = 0;  i < 13;  i++)
+        xM[i] = x[Mc + 3*i];
+    /*endfor*/
+    *Mc_out = Mc;
+}
+/*- End of function --------------------------------------------------------*/
+#else
 static void rpe_grid_selection(int16_t x[40], int16_t xM[13], int16_t *Mc_out)
 {
     int i;
@@ -341,6 +464,7 @@ static void rpe_grid_selection(int16_t x[40], int16_t xM[13], int16_t *Mc_out)
     *Mc_out = Mc;
 }
 /*- End of function --------------------------------------------------------*/
+#endif
 
 /* 4.12.15 */
 static void apcm_quantization_xmaxc_to_exp_mant(int16_t xmaxc,
@@ -35,6 +35,7 @@
 #include <stdio.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/async.h"
 #include "spandsp/crc.h"
 #include "spandsp/bit_operations.h"
@@ -262,6 +263,18 @@ SPAN_DECLARE_NONSTD(void) hdlc_rx_put_bit(hdlc_rx_state_t *s, int new_bit)
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE_NONSTD(void) hdlc_rx_put_bits(hdlc_rx_state_t *s, unsigned int bits, int nbits)
+{
+    int i;
+
+    for (i = nbits - 1;  i >= 0;  i--)
+    {
+        s->raw_bit_stream = (s->raw_bit_stream << 1) | (((bits >> i) << 8) & 0x100);
+        hdlc_rx_put_bit_core(s);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE_NONSTD(void) hdlc_rx_put_byte(hdlc_rx_state_t *s, int new_byte)
 {
     int i;
@@ -311,7 +324,7 @@ SPAN_DECLARE(hdlc_rx_state_t *) hdlc_rx_init(hdlc_rx_state_t *s,
 {
     if (s == NULL)
     {
-        if ((s = (hdlc_rx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (hdlc_rx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -347,7 +360,7 @@ SPAN_DECLARE(int) hdlc_rx_release(hdlc_rx_state_t *s)
 
 SPAN_DECLARE(int) hdlc_rx_free(hdlc_rx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -559,6 +572,24 @@ SPAN_DECLARE_NONSTD(int) hdlc_tx_get_bit(hdlc_tx_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE_NONSTD(int) hdlc_tx_get_bits(hdlc_tx_state_t *s, unsigned int *bits)
+{
+    int nbits;
+
+    if (s->bits == 0)
+    {
+        if ((s->byte = hdlc_tx_get_byte(s)) < 0)
+            return s->byte;
+        s->bits = 8;
+    }
+    /* Return whatever is left of the current byte, which is normally all of it */
+    nbits = s->bits;
+    *bits = s->byte & ((1 << nbits) - 1);
+    s->bits = 0;
+    return nbits;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE_NONSTD(int) hdlc_tx_get(hdlc_tx_state_t *s, uint8_t buf[], size_t max_len)
 {
     size_t i;
@@ -589,7 +620,7 @@ SPAN_DECLARE(hdlc_tx_state_t *) hdlc_tx_init(hdlc_tx_state_t *s,
 {
     if (s == NULL)
     {
-        if ((s = (hdlc_tx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (hdlc_tx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -621,7 +652,7 @@ SPAN_DECLARE(int) hdlc_tx_release(hdlc_tx_state_t *s)
 
 SPAN_DECLARE(int) hdlc_tx_free(hdlc_tx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -42,6 +42,7 @@
 #include "floating_fudge.h"
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/fast_convert.h"
 #include "spandsp/saturated.h"
 #include "spandsp/ima_adpcm.h"
@@ -116,6 +117,9 @@
 /*! The number of ADPCM step sizes */
 #define STEP_MAX 88
 
+/*! The number of channels the batch functions step through together */
+#define IMA_ADPCM_LANES 4
+
 /* Intel ADPCM step variation table */
 static const int step_size[STEP_MAX + 1] =
 {
@@ -133,9 +137,75 @@ static const int step_size[STEP_MAX + 1] =
     32767
 };
 
-static const int step_adjustment[8] =
+/* The magnitude of the change to the prediction for each step size and 3 bit code
+   magnitude - (code + 0.5)*step/4, summed from the truncated parts exactly as the
+   reference algorithm does it. */
+#define IMA_DELTA(ss, c) \
+    (((ss) >> 3) + (((c) & 1)  ?  ((ss) >> 2)  :  0) + (((c) & 2)  ?  ((ss) >> 1)  :  0) + (((c) & 4)  ?  (ss)  :  0))
+#define IMA_DELTAS(ss) \
+    {IMA_DELTA(ss, 0), IMA_DELTA(ss, 1), IMA_DELTA(ss, 2), IMA_DELTA(ss, 3), \
+     IMA_DELTA(ss, 4), IMA_DELTA(ss, 5), IMA_DELTA(ss, 6), IMA_DELTA(ss, 7)}
+
+static const uint16_t step_delta[STEP_MAX + 1][8] =
 {
-    -1, -1, -1, -1, 2, 4, 6, 8
+    IMA_DELTAS(    7), IMA_DELTAS(    8), IMA_DELTAS(    9), IMA_DELTAS(   10),
+    IMA_DELTAS(   11), IMA_DELTAS(   12), IMA_DELTAS(   13), IMA_DELTAS(   14),
+    IMA_DELTAS(   16), IMA_DELTAS(   17), IMA_DELTAS(   19), IMA_DELTAS(   21),
+    IMA_DELTAS(   23), IMA_DELTAS(   25), IMA_DELTAS(   28), IMA_DELTAS(   31),
+    IMA_DELTAS(   34), IMA_DELTAS(   37), IMA_DELTAS(   41), IMA_DELTAS(   45),
+    IMA_DELTAS(   50), IMA_DELTAS(   55), IMA_DELTAS(   60), IMA_DELTAS(   66),
+    IMA_DELTAS(   73), IMA_DELTAS(   80), IMA_DELTAS(   88), IMA_DELTAS(   97),
+    IMA_DELTAS(  107), IMA_DELTAS(  118), IMA_DELTAS(  130), IMA_DELTAS(  143),
+    IMA_DELTAS(  157), IMA_DELTAS(  173), IMA_DELTAS(  190), IMA_DELTAS(  209),
+    IMA_DELTAS(  230), IMA_DELTAS(  253), IMA_DELTAS(  279), IMA_DELTAS(  307),
+    IMA_DELTAS(  337), IMA_DELTAS(  371), IMA_DELTAS(  408), IMA_DELTAS(  449),
+    IMA_DELTAS(  494), IMA_DELTAS(  544), IMA_DELTAS(  598), IMA_DELTAS(  658),
+    IMA_DELTAS(  724), IMA_DELTAS(  796), IMA_DELTAS(  876), IMA_DELTAS(  963),
+    IMA_DELTAS( 1060), IMA_DELTAS( 1166), IMA_DELTAS( 1282), IMA_DELTAS( 1411),
+    IMA_DELTAS( 1552), IMA_DELTAS( 1707), IMA_DELTAS( 1878), IMA_DELTAS( 2066),
+    IMA_DELTAS( 2272), IMA_DELTAS( 2499), IMA_DELTAS( 2749), IMA_DELTAS( 3024),
+    IMA_DELTAS( 3327), IMA_DELTAS( 3660), IMA_DELTAS( 4026), IMA_DELTAS( 4428),
+    IMA_DELTAS( 4871), IMA_DELTAS( 5358), IMA_DELTAS( 5894), IMA_DELTAS( 6484),
+    IMA_DELTAS( 7132), IMA_DELTAS( 7845), IMA_DELTAS( 8630), IMA_DELTAS( 9493),
+    IMA_DELTAS(10442), IMA_DELTAS(11487), IMA_DELTAS(12635), IMA_DELTAS(13899),
+    IMA_DELTAS(15289), IMA_DELTAS(16818), IMA_DELTAS(18500), IMA_DELTAS(20350),
+    IMA_DELTAS(22385), IMA_DELTAS(24623), IMA_DELTAS(27086), IMA_DELTAS(29794),
+    IMA_DELTAS(32767)
+};
+
+/* The next step index for each step index and 3 bit code magnitude. The step
+   adjustments are -1, -1, -1, -1, 2, 4, 6, 8, limited to the table. */
+#define IMA_STEP_LIMIT(i) \
+    (((i) < 0)  ?  0  :  (((i) > STEP_MAX)  ?  STEP_MAX  :  (i)))
+#define IMA_NEXT_STEPS(i) \
+    {IMA_STEP_LIMIT((i) - 1), IMA_STEP_LIMIT((i) - 1), IMA_STEP_LIMIT((i) - 1), IMA_STEP_LIMIT((i) - 1), \
+     IMA_STEP_LIMIT((i) + 2), IMA_STEP_LIMIT((i) + 4), IMA_STEP_LIMIT((i) + 6), IMA_STEP_LIMIT((i) + 8)}
+
+static const uint8_t next_step[STEP_MAX + 1][8] =
+{
+    IMA_NEXT_STEPS( 0), IMA_NEXT_STEPS( 1), IMA_NEXT_STEPS( 2), IMA_NEXT_STEPS( 3),
+    IMA_NEXT_STEPS( 4), IMA_NEXT_STEPS( 5), IMA_NEXT_STEPS( 6), IMA_NEXT_STEPS( 7),
+    IMA_NEXT_STEPS( 8), IMA_NEXT_STEPS( 9), IMA_NEXT_STEPS(10), IMA_NEXT_STEPS(11),
+    IMA_NEXT_STEPS(12), IMA_NEXT_STEPS(13), IMA_NEXT_STEPS(14), IMA_NEXT_STEPS(15),
+    IMA_NEXT_STEPS(16), IMA_NEXT_STEPS(17), IMA_NEXT_STEPS(18), IMA_NEXT_STEPS(19),
+    IMA_NEXT_STEPS(20), IMA_NEXT_STEPS(21), IMA_NEXT_STEPS(22), IMA_NEXT_STEPS(23),
+    IMA_NEXT_STEPS(24), IMA_NEXT_STEPS(25), IMA_NEXT_STEPS(26), IMA_NEXT_STEPS(27),
+    IMA_NEXT_STEPS(28), IMA_NEXT_STEPS(29), IMA_NEXT_STEPS(30), IMA_NEXT_STEPS(31),
+    IMA_NEXT_STEPS(32), IMA_NEXT_STEPS(33), IMA_NEXT_STEPS(34), IMA_NEXT_STEPS(35),
+    IMA_NEXT_STEPS(36), IMA_NEXT_STEPS(37), IMA_NEXT_STEPS(38), IMA_NEXT_STEPS(39),
+    IMA_NEXT_STEPS(40), IMA_NEXT_STEPS(41), IMA_NEXT_STEPS(42), IMA_NEXT_STEPS(43),
+    IMA_NEXT_STEPS(44), IMA_NEXT_STEPS(45), IMA_NEXT_STEPS(46), IMA_NEXT_STEPS(47),
+    IMA_NEXT_STEPS(48), IMA_NEXT_STEPS(49), IMA_NEXT_STEPS(50), IMA_NEXT_STEPS(51),
+    IMA_NEXT_STEPS(52), IMA_NEXT_STEPS(53), IMA_NEXT_STEPS(54), IMA_NEXT_STEPS(55),
+    IMA_NEXT_STEPS(56), IMA_NEXT_STEPS(57), IMA_NEXT_STEPS(58), IMA_NEXT_STEPS(59),
+    IMA_NEXT_STEPS(60), IMA_NEXT_STEPS(61), IMA_NEXT_STEPS(62), IMA_NEXT_STEPS(63),
+    IMA_NEXT_STEPS(64), IMA_NEXT_STEPS(65), IMA_NEXT_STEPS(66), IMA_NEXT_STEPS(67),
+    IMA_NEXT_STEPS(68), IMA_NEXT_STEPS(69), IMA_NEXT_STEPS(70), IMA_NEXT_STEPS(71),
+    IMA_NEXT_STEPS(72), IMA_NEXT_STEPS(73), IMA_NEXT_STEPS(74), IMA_NEXT_STEPS(75),
+    IMA_NEXT_STEPS(76), IMA_NEXT_STEPS(77), IMA_NEXT_STEPS(78), IMA_NEXT_STEPS(79),
+    IMA_NEXT_STEPS(80), IMA_NEXT_STEPS(81), IMA_NEXT_STEPS(82), IMA_NEXT_STEPS(83),
+    IMA_NEXT_STEPS(84), IMA_NEXT_STEPS(85), IMA_NEXT_STEPS(86), IMA_NEXT_STEPS(87),
+    IMA_NEXT_STEPS(88)
 };
 
 static const struct
@@ -187,92 +257,109 @@ static const struct
     {0xFF00,    0xFF00,     8}
 };
 
-static int16_t decode(ima_adpcm_state_t *s, uint8_t adpcm)
+static __inline__ int16_t decode_step(int *last, int *step_index, int adpcm)
 {
     int e;
-    int ss;
-    int16_t linear;
+    int sign;
 
-    /* e = (adpcm+0.5)*step/4 */
-    ss = step_size[s->step_index];
-    e = ss >> 3;
-    if (adpcm & 0x01)
-        e += (ss >> 2);
-    /*endif*/
-    if (adpcm & 0x02)
-        e += (ss >> 1);
-    /*endif*/
-    if (adpcm & 0x04)
-        e += ss;
-    /*endif*/
-    if (adpcm & 0x08)
-        e = -e;
-    /*endif*/
-    linear = saturate(s->last + e);
-    s->last = linear;
-    s->step_index += step_adjustment[adpcm & 0x07];
-    if (s->step_index < 0)
-        s->step_index = 0;
-    else if (s->step_index > STEP_MAX)
-        s->step_index = STEP_MAX;
-    /*endif*/
-    return linear;
+    /* e = (adpcm+0.5)*step/4, from the fused step and code table, with the
+       sign applied as a mask rather than a branch. */
+    e = step_delta[*step_index][adpcm & 0x07];
+    sign = -((adpcm >> 3) & 1);
+    *last = saturate(*last + ((e ^ sign) - sign));
+    *step_index = next_step[*step_index][adpcm & 0x07];
+    return (int16_t) *last;
 }
 /*- End of function --------------------------------------------------------*/
 
-static uint8_t encode(ima_adpcm_state_t *s, int16_t linear)
+static __inline__ int encode_step(int *last, int *step_index, int16_t linear)
 {
     int e;
     int ss;
+    int sign;
+    int bit;
     int adpcm;
-    int diff;
-    int initial_e;
-
-    ss = step_size[s->step_index];
-    initial_e =
-    e = linear - s->last;
-    diff = ss >> 3;
-    adpcm = (uint8_t) 0x00;
-    if (e < 0)
+
+    ss = step_size[*step_index];
+    e = linear - *last;
+    /* Quantise the magnitude, with each bit decided by a comparison rather than
+       a branch */
+    sign = (e < 0)  ?  -1  :  0;
+    e = (e ^ sign) - sign;
+    bit = (e >= ss);
+    adpcm = bit << 2;
+    e -= ss & -bit;
+    bit = (e >= (ss >> 1));
+    adpcm |= bit << 1;
+    e -= (ss >> 1) & -bit;
+    adpcm |= (e >= (ss >> 2));
+    /* Track the decoder. The table gives exactly the change the step by step
+       subtractions above would produce. */
+    e = step_delta[*step_index][adpcm];
+    *last = saturate(*last + ((e ^ sign) - sign));
+    *step_index = next_step[*step_index][adpcm];
+    return adpcm | (sign & 0x08);
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ int16_t decode(ima_adpcm_state_t *s, uint8_t adpcm)
+{
+    return decode_step(&s->last, &s->step_index, adpcm);
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ uint8_t encode(ima_adpcm_state_t *s, int16_t linear)
+{
+    return (uint8_t) encode_step(&s->last, &s->step_index, linear);
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Unpack the header at the start of a chunk. For IMA4 this holds the first sample. For
+   DVI4 and VDVI it holds the prediction for the first sample. Returns the number of
+   samples produced. */
+static int decode_header(ima_adpcm_state_t *s, int16_t amp[], const uint8_t ima_data[])
+{
+    int samples;
+
+    samples = 0;
+    if (s->variant == IMA_ADPCM_IMA4)
     {
-        adpcm = (uint8_t) 0x08;
-        e = -e;
+        amp[samples++] = (ima_data[1] << 8) | ima_data[0];
+        s->last = amp[0];
     }
-    /*endif*/
-    if (e >= ss)
+    else
     {
-        adpcm |= (uint8_t) 0x04;
-        e -= ss;
+        s->last = (int16_t) ((ima_data[0] << 8) | ima_data[1]);
     }
     /*endif*/
-    ss >>= 1;
-    if (e >= ss)
-    {
-        adpcm |= (uint8_t) 0x02;
-        e -= ss;
-    }
+    s->step_index = ima_data[2];
+    if (s->step_index > STEP_MAX)
+        s->step_index = STEP_MAX;
     /*endif*/
-    ss >>= 1;
-    if (e >= ss)
+    return samples;
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Build the header at the start of a chunk. For IMA4 this uses up the first
+   sample. Returns the number of samples used. */
+static int encode_header(ima_adpcm_state_t *s, uint8_t ima_data[], const int16_t amp[])
+{
+    if (s->variant == IMA_ADPCM_IMA4)
     {
-        adpcm |= (uint8_t) 0x01;
-        e -= ss;
+        ima_data[0] = (uint8_t) amp[0];
+        ima_data[1] = (uint8_t) (amp[0] >> 8);
+        ima_data[2] = (uint8_t) s->step_index;
+        ima_data[3] = 0;
+        s->last = amp[0];
+        s->bits = 0;
+        return 1;
     }
     /*endif*/
-
-    if (initial_e < 0)
-        diff = -(diff - initial_e - e);
-    else
-        diff = diff + initial_e - e;
-    /*endif*/
-    s->last = saturate(diff + s->last);
-    s->step_index += step_adjustment[adpcm & 0x07];
-    if (s->step_index < 0)
-        s->step_index = 0;
-    else if (s->step_index > STEP_MAX)
-        s->step_index = STEP_MAX;
-    /*endif*/
-    return (uint8_t) adpcm;
+    ima_data[0] = (uint8_t) (s->last >> 8);
+    ima_data[1] = (uint8_t) s->last;
+    ima_data[2] = (uint8_t) s->step_index;
+    ima_data[3] = 0;
+    return 0;
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -282,7 +369,7 @@ SPAN_DECLARE(ima_adpcm_state_t *) ima_adpcm_init(ima_adpcm_state_t *s,
 {
     if (s == NULL)
     {
-        if ((s = (ima_adpcm_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (ima_adpcm_state_t *) span_alloc(sizeof(*s))) == NULL)
             return  NULL;
     }
     /*endif*/
@@ -301,7 +388,7 @@ SPAN_DECLARE(int) ima_adpcm_release(ima_adpcm_state_t *s)
 
 SPAN_DECLARE(int) ima_adpcm_free(ima_adpcm_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -323,9 +410,7 @@ SPAN_DECLARE(int) ima_adpcm_decode(ima_adpcm_state_t *s,
         i = 0;
         if (s->chunk_size == 0)
         {
-            amp[samples++] = (ima_data[1] << 8) | ima_data[0];
-            s->step_index = ima_data[2];
-            s->last = amp[0];
+            samples = decode_header(s, amp, ima_data);
             i = 4;
         }
         /*endif*/
@@ -340,8 +425,7 @@ SPAN_DECLARE(int) ima_adpcm_decode(ima_adpcm_state_t *s,
         i = 0;
         if (s->chunk_size == 0)
         {
-            s->last = (int16_t) ((ima_data[0] << 8) | ima_data[1]);
-            s->step_index = ima_data[2];
+            samples = decode_header(s, amp, ima_data);
             i = 4;
         }
         /*endif*/
@@ -356,8 +440,7 @@ SPAN_DECLARE(int) ima_adpcm_decode(ima_adpcm_state_t *s,
         i = 0;
         if (s->chunk_size == 0)
         {
-            s->last = (int16_t) ((ima_data[0] << 8) | ima_data[1]);
-            s->step_index = ima_data[2];
+            samples = decode_header(s, amp, ima_data);
             i = 4;
         }
         /*endif*/
@@ -438,13 +521,8 @@ SPAN_DECLARE(int) ima_adpcm_encode(ima_adpcm_state_t *s,
         i = 0;
         if (s->chunk_size == 0)
         {
-            ima_data[bytes++] = (uint8_t) amp[0];
-            ima_data[bytes++] = (uint8_t) (amp[0] >> 8);
-            ima_data[bytes++] = (uint8_t) s->step_index;
-            ima_data[bytes++] = 0;
-            s->last = amp[0];
-            s->bits = 0;
-            i = 1;
+            i = encode_header(s, ima_data, amp);
+            bytes = 4;
         }
         /*endif*/
         for (  ;  i < len;  i++)
@@ -459,10 +537,8 @@ SPAN_DECLARE(int) ima_adpcm_encode(ima_adpcm_state_t *s,
     case IMA_ADPCM_DVI4:
         if (s->chunk_size == 0)
         {
-            ima_data[bytes++] = (uint8_t) (s->last >> 8);
-            ima_data[bytes++] = (uint8_t) s->last;
-            ima_data[bytes++] = (uint8_t) s->step_index;
-            ima_data[bytes++] = 0;
+            encode_header(s, ima_data, amp);
+            bytes = 4;
         }
         /*endif*/
         for (i = 0;  i < len;  i++)
@@ -477,10 +553,8 @@ SPAN_DECLARE(int) ima_adpcm_encode(ima_adpcm_state_t *s,
     case IMA_ADPCM_VDVI:
         if (s->chunk_size == 0)
         {
-            ima_data[bytes++] = (uint8_t) (s->last >> 8);
-            ima_data[bytes++] = (uint8_t) s->last;
-            ima_data[bytes++] = (uint8_t) s->step_index;
-            ima_data[bytes++] = 0;
+            encode_header(s, ima_data, amp);
+            bytes = 4;
         }
         /*endif*/
         s->bits = 0;
@@ -506,4 +580,351 @@ SPAN_DECLARE(int) ima_adpcm_encode(ima_adpcm_state_t *s,
     return  bytes;
 }
 /*- End of function --------------------------------------------------------*/
+/* Decode the same number of bytes for IMA_ADPCM_LANES channels which use the same
+   variant (IMA4 or DVI4) and chunking. The channels are stepped through together,
+   so the long chain of dependent operations in each channel overlaps with the
+   others. */
+static void decode_lanes(ima_adpcm_state_t *s[], int16_t *amp[], const uint8_t *ima_data[], int ima_bytes, int samples[])
+{
+    const uint8_t *d0;
+    const uint8_t *d1;
+    const uint8_t *d2;
+    const uint8_t *d3;
+    int16_t *a0;
+    int16_t *a1;
+    int16_t *a2;
+    int16_t *a3;
+    int last0;
+    int last1;
+    int last2;
+    int last3;
+    int step0;
+    int step1;
+    int step2;
+    int step3;
+    int i;
+    int k;
+    int n;
+
+    n = 0;
+    i = 0;
+    if (s[0]->chunk_size == 0)
+    {
+        for (k = 0;  k < IMA_ADPCM_LANES;  k++)
+            n = decode_header(s[k], amp[k], ima_data[k]);
+        /*endfor*/
+        i = 4;
+    }
+    /*endif*/
+    d0 = ima_data[0];
+    d1 = ima_data[1];
+    d2 = ima_data[2];
+    d3 = ima_data[3];
+    a0 = amp[0];
+    a1 = amp[1];
+    a2 = amp[2];
+    a3 = amp[3];
+    last0 = s[0]->last;
+    last1 = s[1]->last;
+    last2 = s[2]->last;
+    last3 = s[3]->last;
+    step0 = s[0]->step_index;
+    step1 = s[1]->step_index;
+    step2 = s[2]->step_index;
+    step3 = s[3]->step_index;
+    if (s[0]->variant == IMA_ADPCM_IMA4)
+    {
+        /* The first sample is in the low nibble */
+        for (  ;  i < ima_bytes;  i++, n += 2)
+        {
+            a0[n] = decode_step(&last0, &step0, d0[i] & 0xF);
+            a1[n] = decode_step(&last1, &step1, d1[i] & 0xF);
+            a2[n] = decode_step(&last2, &step2, d2[i] & 0xF);
+            a3[n] = decode_step(&last3, &step3, d3[i] & 0xF);
+            a0[n + 1] = decode_step(&last0, &step0, d0[i] >> 4);
+            a1[n + 1] = decode_step(&last1, &step1, d1[i] >> 4);
+            a2[n + 1] = decode_step(&last2, &step2, d2[i] >> 4);
+            a3[n + 1] = decode_step(&last3, &step3, d3[i] >> 4);
+        }
+        /*endfor*/
+    }
+    else
+    {
+        /* The first sample is in the high nibble */
+        for (  ;  i < ima_bytes;  i++, n += 2)
+        {
+            a0[n] = decode_step(&last0, &step0, d0[i] >> 4);
+            a1[n] = decode_step(&last1, &step1, d1[i] >> 4);
+            a2[n] = decode_step(&last2, &step2, d2[i] >> 4);
+            a3[n] = decode_step(&last3, &step3, d3[i] >> 4);
+            a0[n + 1] = decode_step(&last0, &step0, d0[i] & 0xF);
+            a1[n + 1] = decode_step(&last1, &step1, d1[i] & 0xF);
+            a2[n + 1] = decode_step(&last2, &step2, d2[i] & 0xF);
+            a3[n + 1] = decode_step(&last3, &step3, d3[i] & 0xF);
+        }
+        /*endfor*/
+    }
+    /*endif*/
+    s[0]->last = last0;
+    s[1]->last = last1;
+    s[2]->last = last2;
+    s[3]->last = last3;
+    s[0]->step_index = step0;
+    s[1]->step_index = step1;
+    s[2]->step_index = step2;
+    s[3]->step_index = step3;
+    for (k = 0;  k < IMA_ADPCM_LANES;  k++)
+        samples[k] = n;
+    /*endfor*/
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Encode the same number of samples for IMA_ADPCM_LANES channels which use the
+   same variant (IMA4 or DVI4) and chunking, and which are all on a byte boundary.
+   Returns FALSE, having done nothing, if the channels are not all on a byte boundary. */
+static int encode_lanes(ima_adpcm_state_t *s[], uint8_t *ima_data[], const int16_t *amp[], int len, int ima_bytes[])
+{
+    const int16_t *a0;
+    const int16_t *a1;
+    const int16_t *a2;
+    const int16_t *a3;
+    uint8_t *d0;
+    uint8_t *d1;
+    uint8_t *d2;
+    uint8_t *d3;
+    int last0;
+    int last1;
+    int last2;
+    int last3;
+    int step0;
+    int step1;
+    int step2;
+    int step3;
+    int c0;
+    int c1;
+    int c2;
+    int c3;
+    int bytes;
+    int first;
+    int i;
+    int k;
+
+    /* A DVI4 header does not reset the nibble packing, so check after any header */
+    for (k = 0;  k < IMA_ADPCM_LANES;  k++)
+    {
+        if ((s[k]->bits & 1)  &&  !(s[k]->chunk_size == 0  &&  s[k]->variant == IMA_ADPCM_IMA4))
+            return FALSE;
+        /*endif*/
+    }
+    /*endfor*/
+    bytes = 0;
+    first = 0;
+    if (s[0]->chunk_size == 0)
+    {
+        for (k = 0;  k < IMA_ADPCM_LANES;  k++)
+            first = encode_header(s[k], ima_data[k], amp[k]);
+        /*endfor*/
+        bytes = 4;
+    }
+    /*endif*/
+    a0 = amp[0] + first;
+    a1 = amp[1] + first;
+    a2 = amp[2] + first;
+    a3 = amp[3] + first;
+    d0 = ima_data[0];
+    d1 = ima_data[1];
+    d2 = ima_data[2];
+    d3 = ima_data[3];
+    last0 = s[0]->last;
+    last1 = s[1]->last;
+    last2 = s[2]->last;
+    last3 = s[3]->last;
+    step0 = s[0]->step_index;
+    step1 = s[1]->step_index;
+    step2 = s[2]->step_index;
+    step3 = s[3]->step_index;
+    len -= first;
+    /* Whole bytes are built directly. This gives exactly the same bytes, and the
+       same final packing state, as packing one nibble at a time. */
+    for (i = 0;  i < (len & ~1);  i += 2, bytes++)
+    {
+        c0 = encode_step(&last0, &step0, a0[i]);
+        c1 = encode_step(&last1, &step1, a1[i]);
+        c2 = encode_step(&last2, &step2, a2[i]);
+        c3 = encode_step(&last3, &step3, a3[i]);
+        if (s[0]->variant == IMA_ADPCM_IMA4)
+        {
+            d0[bytes] = (uint8_t) (c0 | (encode_step(&last0, &step0, a0[i + 1]) << 4));
+            d1[bytes] = (uint8_t) (c1 | (encode_step(&last1, &step1, a1[i + 1]) << 4));
+            d2[bytes] = (uint8_t) (c2 | (encode_step(&last2, &step2, a2[i + 1]) << 4));
+            d3[bytes] = (uint8_t) (c3 | (encode_step(&last3, &step3, a3[i + 1]) << 4));
+        }
+        else
+        {
+            d0[bytes] = (uint8_t) ((c0 << 4) | encode_step(&last0, &step0, a0[i + 1]));
+            d1[bytes] = (uint8_t) ((c1 << 4) | encode_step(&last1, &step1, a1[i + 1]));
+            d2[bytes] = (uint8_t) ((c2 << 4) | encode_step(&last2, &step2, a2[i + 1]));
+            d3[bytes] = (uint8_t) ((c3 << 4) | encode_step(&last3, &step3, a3[i + 1]));
+        }
+        /*endif*/
+    }
+    /*endfor*/
+    s[0]->last = last0;
+    s[1]->last = last1;
+    s[2]->last = last2;
+    s[3]->last = last3;
+    s[0]->step_index = step0;
+    s[1]->step_index = step1;
+    s[2]->step_index = step2;
+    s[3]->step_index = step3;
+    for (k = 0;  k < IMA_ADPCM_LANES;  k++)
+    {
+        if (i > 0)
+        {
+            s[k]->ima_byte = ima_data[k][bytes - 1];
+            s[k]->bits += i;
+        }
+        /*endif*/
+        ima_bytes[k] = bytes;
+        /* Any odd sample at the end is left waiting for its partner */
+        if (i < len)
+        {
+            if (s[k]->variant == IMA_ADPCM_IMA4)
+                s[k]->ima_byte = (uint8_t) ((s[k]->ima_byte >> 4) | (encode(s[k], amp[k][first + i]) << 4));
+            else
+                s[k]->ima_byte = (uint8_t) ((s[k]->ima_byte << 4) | encode(s[k], amp[k][first + i]));
+            /*endif*/
+            s[k]->bits++;
+        }
+        /*endif*/
+    }
+    /*endfor*/
+    return TRUE;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) ima_adpcm_decode_batch(ima_adpcm_state_t *s[],
+                                         int16_t *amp[],
+                                         const uint8_t *ima_data[],
+                                         int ima_bytes,
+                                         int samples[],
+                                         int channels)
+{
+    ima_adpcm_state_t *ls[IMA_ADPCM_LANES];
+    int16_t *lamp[IMA_ADPCM_LANES];
+    const uint8_t *ldata[IMA_ADPCM_LANES];
+    int *lsamples[IMA_ADPCM_LANES];
+    int lsamp[IMA_ADPCM_LANES];
+    int kind;
+    int lanes;
+    int j;
+    int k;
+
+    /* Gather the channels which use the same variant and chunking into groups, which
+       are decoded together. VDVI is variable length, so it is always decoded one
+       channel at a time. */
+    for (k = 0;  k < channels;  k++)
+    {
+        if (s[k]->variant == IMA_ADPCM_VDVI)
+            samples[k] = ima_adpcm_decode(s[k], amp[k], ima_data[k], ima_bytes);
+        /*endif*/
+    }
+    /*endfor*/
+    for (kind = 0;  kind < 4;  kind++)
+    {
+        for (k = 0, lanes = 0;  k < channels;  k++)
+        {
+            if (s[k]->variant == (kind >> 1)  &&  (s[k]->chunk_size == 0) == (kind & 1))
+            {
+                ls[lanes] = s[k];
+                lamp[lanes] = amp[k];
+                ldata[lanes] = ima_data[k];
+                lsamples[lanes] = &samples[k];
+                lanes++;
+            }
+            /*endif*/
+            if (lanes == IMA_ADPCM_LANES)
+            {
+                decode_lanes(ls, lamp, ldata, ima_bytes, lsamp);
+                for (j = 0;  j < lanes;  j++)
+                    *lsamples[j] = lsamp[j];
+                /*endfor*/
+                lanes = 0;
+            }
+            /*endif*/
+        }
+        /*endfor*/
+        for (j = 0;  j < lanes;  j++)
+            *lsamples[j] = ima_adpcm_decode(ls[j], lamp[j], ldata[j], ima_bytes);
+        /*endfor*/
+    }
+    /*endfor*/
+    return channels;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) ima_adpcm_encode_batch(ima_adpcm_state_t *s[],
+                                         uint8_t *ima_data[],
+                                         const int16_t *amp[],
+                                         int len,
+                                         int ima_bytes[],
+                                         int channels)
+{
+    ima_adpcm_state_t *ls[IMA_ADPCM_LANES];
+    uint8_t *ldata[IMA_ADPCM_LANES];
+    const int16_t *lamp[IMA_ADPCM_LANES];
+    int *lbytes[IMA_ADPCM_LANES];
+    int lb[IMA_ADPCM_LANES];
+    int kind;
+    int lanes;
+    int j;
+    int k;
+
+    for (k = 0;  k < channels;  k++)
+    {
+        if (s[k]->variant == IMA_ADPCM_VDVI)
+            ima_bytes[k] = ima_adpcm_encode(s[k], ima_data[k], amp[k], len);
+        /*endif*/
+    }
+    /*endfor*/
+    for (kind = 0;  kind < 4;  kind++)
+    {
+        for (k = 0, lanes = 0;  k < channels;  k++)
+        {
+            if (s[k]->variant == (kind >> 1)  &&  (s[k]->chunk_size == 0) == (kind & 1))
+            {
+                ls[lanes] = s[k];
+                ldata[lanes] = ima_data[k];
+                lamp[lanes] = amp[k];
+                lbytes[lanes] = &ima_bytes[k];
+                lanes++;
+            }
+            /*endif*/
+            if (lanes == IMA_ADPCM_LANES  &&  encode_lanes(ls, ldata, lamp, len, lb))
+            {
+                for (j = 0;  j < lanes;  j++)
+                    *lbytes[j] = lb[j];
+                /*endfor*/
+                lanes = 0;
+            }
+            /*endif*/
+            if (lanes == IMA_ADPCM_LANES)
+            {
+                /* These could not be encoded together */
+                for (j = 0;  j < lanes;  j++)
+                    *lbytes[j] = ima_adpcm_encode(ls[j], ldata[j], lamp[j], len);
+                /*endfor*/
+                lanes = 0;
+            }
+            /*endif*/
+        }
+        /*endfor*/
+        for (j = 0;  j < lanes;  j++)
+            *lbytes[j] = ima_adpcm_encode(ls[j], ldata[j], lamp[j], len);
+        /*endfor*/
+    }
+    /*endfor*/
+    return channels;
+}
+/*- End of function --------------------------------------------------------*/
 /*- End of file ------------------------------------------------------------*/
@@ -42,6 +42,9 @@
 #include <math.h>
 #endif
 #include "floating_fudge.h"
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+#include "mmx_sse_decs.h"
+#endif
 
 #include "spandsp/telephony.h"
 #include "spandsp/dc_restore.h"
@@ -77,6 +80,83 @@ static void remove_dc_bias(float speech[], int len, float sigout[])
 }
 /*- End of function --------------------------------------------------------*/
 
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+/* The longest lag, plus the pitch analysis window, rounded up to a multiple of 4 */
+#define AMDF_SPAN           (156 + 156 + 4)
+
+/* The AMDF only uses every 4th sample, so split the speech into its 4 phases,
+   each stored contiguously, so the sums can use vector loads. */
+static void split_phases(float split[4][AMDF_SPAN/4], const float speech[], int len)
+{
+    int i;
+
+    for (i = 0;  i < len;  i++)
+        split[i & 3][i >> 2] = speech[i];
+    for (  ;  i < AMDF_SPAN;  i++)
+        split[i & 3][i >> 2] = 0.0f;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void eval_amdf(float split[4][AMDF_SPAN/4],
+                      int32_t lpita,
+                      const int32_t tau[], 
+                      int32_t ltau,
+                      int32_t maxlag,
+                      float amdf[],
+                      int32_t *minptr,
+                      int32_t *maxptr)
+{
+    const float *p;
+    const float *q;
+    __m128 abs_mask;
+    __m128 tail_mask;
+    __m128 sum0;
+    __m128 sum1;
+    int i;
+    int j;
+    int n1;
+    int n2;
+    int terms;
+
+    /* Each lane sums every 4th term of a lag, so the sums are not formed in quite the
+       same order as the non-SSE code, and may differ from it in the last bit or so. */
+    abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    terms = (lpita + 3) >> 2;
+    /* Also mask off the lanes of the last vector which are beyond the end of the sum */
+    tail_mask = _mm_and_ps(abs_mask, _mm_castsi128_ps(_mm_cmpgt_epi32(_mm_set1_epi32(terms & 3), _mm_setr_epi32(0, 1, 2, 3))));
+    *minptr = 0;
+    *maxptr = 0;
+    for (i = 0;  i < ltau;  i++)
+    {
+        n1 = (maxlag - tau[i])/2;
+        n2 = n1 + tau[i];
+        p = &split[n1 & 3][n1 >> 2];
+        q = &split[n2 & 3][n2 >> 2];
+        sum0 = _mm_setzero_ps();
+        sum1 = _mm_setzero_ps();
+        for (j = 0;  j <= terms - 8;  j += 8)
+        {
+            sum0 = _mm_add_ps(sum0, _mm_and_ps(_mm_sub_ps(_mm_loadu_ps(&p[j]), _mm_loadu_ps(&q[j])), abs_mask));
+            sum1 = _mm_add_ps(sum1, _mm_and_ps(_mm_sub_ps(_mm_loadu_ps(&p[j + 4]), _mm_loadu_ps(&q[j + 4])), abs_mask));
+        }
+        if (j <= terms - 4)
+        {
+            sum0 = _mm_add_ps(sum0, _mm_and_ps(_mm_sub_ps(_mm_loadu_ps(&p[j]), _mm_loadu_ps(&q[j])), abs_mask));
+            j += 4;
+        }
+        if (j < terms)
+            sum1 = _mm_add_ps(sum1, _mm_and_ps(_mm_sub_ps(_mm_loadu_ps(&p[j]), _mm_loadu_ps(&q[j])), tail_mask));
+        sum0 = _mm_add_ps(sum0, sum1);
+        sum0 = _mm_add_ps(sum0, _mm_movehl_ps(sum0, sum0));
+        sum0 = _mm_add_ss(sum0, _mm_shuffle_ps(sum0, sum0, 1));
+        amdf[i] = _mm_cvtss_f32(sum0);
+        if (amdf[i] < amdf[*minptr])
+            *minptr = i;
+        if (amdf[i] > amdf[*maxptr])
+            *maxptr = i;
+    }
+}
+#else
 static void eval_amdf(float speech[],
                       int32_t lpita,
                       const int32_t tau[], 
@@ -108,6 +188,7 @@ static void eval_amdf(float speech[],
             *maxptr = i;
     }
 }
+#endif
 /*- End of function --------------------------------------------------------*/
 
 static void eval_highres_amdf(float speech[],
@@ -128,9 +209,18 @@ static void eval_highres_amdf(float speech[],
     int i;
     int i2;
     int ptr;
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+    float split[4][AMDF_SPAN/4];
+
+    split_phases(split, speech, tau[ltau - 1] + lpita);
+#else
+    float *split;
+
+    split = speech;
+#endif
 
     /* Compute full AMDF using log spaced lags, find coarse minimum */
-    eval_amdf(speech, lpita, tau, ltau, tau[ltau - 1], amdf, minptr, maxptr);
+    eval_amdf(split, lpita, tau, ltau, tau[ltau - 1], amdf, minptr, maxptr);
     *mintau = tau[*minptr];
     minamd = (int32_t) amdf[*minptr];
 
@@ -150,7 +240,7 @@ static void eval_highres_amdf(float speech[],
        if it is better than the coarse minimum */
     if (ltau2 > 0)
     {
-        eval_amdf(speech, lpita, tau2, ltau2, tau[ltau - 1], amdf2, &minp2, &maxp2);
+        eval_amdf(split, lpita, tau2, ltau2, tau[ltau - 1], amdf2, &minp2, &maxp2);
         if (amdf2[minp2] < (float) minamd)
         {
             *mintau = tau2[minp2];
@@ -172,7 +262,7 @@ static void eval_highres_amdf(float speech[],
             ltau2 = 1;
             tau2[0] = i;
         }
-        eval_amdf(speech, lpita, tau2, ltau2, tau[ltau - 1], amdf2, &minp2, &maxp2);
+        eval_amdf(split, lpita, tau2, ltau2, tau[ltau - 1], amdf2, &minp2, &maxp2);
         if (amdf2[minp2] < (float) minamd)
         {
             *mintau = tau2[minp2];
@@ -374,15 +464,48 @@ static void mload(int32_t order, int32_t awins, int32_t awinf, float speech[], f
     int32_t start;
     int i;
     int r;
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+    __m128 x;
+    __m128 y;
+    __m128 n0;
+    __m128 n1;
+    __m128 n2;
+#endif
 
     start = awins + order;
-    for (r = 1;  r <= order;  r++)
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+    if (order == LPC10_ORDER)
     {
-        phi[r - 1] = 0.0f;
+        /* Each lane accumulates one element of the first column of phi, in the same
+           order as the non-SSE code. The third register covers elements 7 to 10, so
+           7 and 8 are computed twice, giving identical values. */
+        n0 = _mm_setzero_ps();
+        n1 = _mm_setzero_ps();
+        n2 = _mm_setzero_ps();
         for (i = start;  i <= awinf;  i++)
-            phi[r - 1] += speech[i - 2]*speech[i - r - 1];
+        {
+            x = _mm_set1_ps(speech[i - 2]);
+            y = _mm_loadu_ps(&speech[i - 5]);
+            n0 = _mm_add_ps(n0, _mm_mul_ps(x, _mm_shuffle_ps(y, y, _MM_SHUFFLE(0, 1, 2, 3))));
+            y = _mm_loadu_ps(&speech[i - 9]);
+            n1 = _mm_add_ps(n1, _mm_mul_ps(x, _mm_shuffle_ps(y, y, _MM_SHUFFLE(0, 1, 2, 3))));
+            y = _mm_loadu_ps(&speech[i - 11]);
+            n2 = _mm_add_ps(n2, _mm_mul_ps(x, _mm_shuffle_ps(y, y, _MM_SHUFFLE(0, 1, 2, 3))));
+        }
+        _mm_storeu_ps(&phi[0], n0);
+        _mm_storeu_ps(&phi[4], n1);
+        _mm_storeu_ps(&phi[6], n2);
+    }
+    else
+#endif
+    {
+        for (r = 1;  r <= order;  r++)
+        {
+            phi[r - 1] = 0.0f;
+            for (i = start;  i <= awinf;  i++)
+                phi[r - 1] += speech[i - 2]*speech[i - r - 1];
+        }
     }
-
     /* Load last element of vector PSI */
     psi[order - 1] = 0.0f;
     for (i = start - 1;  i < awinf;  i++)
@@ -479,6 +602,48 @@ static int rcchk(int order, float rc1f[], float rc2f[])
 }
 /*- End of function --------------------------------------------------------*/
 
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+static __inline__ __m128 lpfilt_tap(__m128 t, const float x[], int k, float coeff)
+{
+    return _mm_add_ps(t, _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(x - k), _mm_loadu_ps(x - 30 + k)), _mm_set1_ps(coeff)));
+}
+/*- End of function --------------------------------------------------------*/
+
+static void lpfilt(float inbuf[], float lpbuf[], int32_t len, int32_t nsamp)
+{
+    int32_t j;
+    __m128 t;
+
+    /* 31 point equiripple FIR LPF */
+    /* Linear phase, delay = 15 samples */
+    /* Passband:  ripple = 0.25 dB, cutoff =  800 Hz */
+    /* Stopband:  atten. =  40. dB, cutoff = 1240 Hz */
+
+    /* Each lane works on a different output sample, with the terms summed in the
+       same order as the non-SSE code. nsamp is always a whole frame, which is a
+       multiple of 4 samples. */
+    for (j = len - nsamp;  j < len;  j += 4)
+    {
+        t = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(&inbuf[j]), _mm_loadu_ps(&inbuf[j - 30])), _mm_set1_ps(-0.0097201988f));
+        t = lpfilt_tap(t, &inbuf[j], 1, -0.0105179986f);
+        t = lpfilt_tap(t, &inbuf[j], 2, -0.0083479648f);
+        t = lpfilt_tap(t, &inbuf[j], 3, 5.860774e-4f);
+        t = lpfilt_tap(t, &inbuf[j], 4, 0.0130892089f);
+        t = lpfilt_tap(t, &inbuf[j], 5, 0.0217052232f);
+        t = lpfilt_tap(t, &inbuf[j], 6, 0.0184161253f);
+        t = lpfilt_tap(t, &inbuf[j], 7, 3.39723e-4f);
+        t = lpfilt_tap(t, &inbuf[j], 8, -0.0260797087f);
+        t = lpfilt_tap(t, &inbuf[j], 9, -0.0455563702f);
+        t = lpfilt_tap(t, &inbuf[j], 10, -0.040306855f);
+        t = lpfilt_tap(t, &inbuf[j], 11, 5.029835e-4f);
+        t = lpfilt_tap(t, &inbuf[j], 12, 0.0729262903f);
+        t = lpfilt_tap(t, &inbuf[j], 13, 0.1572008878f);
+        t = lpfilt_tap(t, &inbuf[j], 14, 0.2247288674f);
+        t = _mm_add_ps(t, _mm_mul_ps(_mm_loadu_ps(&inbuf[j - 15]), _mm_set1_ps(0.250535965f)));
+        _mm_storeu_ps(&lpbuf[j], t);
+    }
+}
+#else
 static void lpfilt(float inbuf[], float lpbuf[], int32_t len, int32_t nsamp)
 {
     int32_t j;
@@ -510,6 +675,7 @@ static void lpfilt(float inbuf[], float lpbuf[], int32_t len, int32_t nsamp)
         lpbuf[j] = t;
     }
 }
+#endif
 /*- End of function --------------------------------------------------------*/
 
 /* 2nd order inverse filter, speech is decimated 4:1 */
@@ -517,12 +683,44 @@ static void ivfilt(float lpbuf[], float ivbuf[], int32_t len, int32_t nsamp, flo
 {
     int32_t i;
     int32_t j;
-    int32_t k;
     float r[3];
     float pc1;
     float pc2;
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+    __m128 n;
+    __m128 x;
+    __m128 y;
+    __m128 z;
+    __m128 c1;
+    __m128 c2;
+    float rr[4];
+#else
+    int32_t k;
+#endif
 
     /* Calculate autocorrelations */
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+    /* Each lane accumulates one lag, in the same order as the non-SSE code. The
+       shorter lags start 2 and 4 terms sooner, so those terms are summed first. */
+    j = 4 + len - nsamp;
+    r[0] = lpbuf[j - 1]*lpbuf[j - 1];
+    r[0] += lpbuf[j + 1]*lpbuf[j + 1];
+    r[0] += lpbuf[j + 3]*lpbuf[j + 3];
+    r[0] += lpbuf[j + 5]*lpbuf[j + 5];
+    r[1] = lpbuf[j + 3]*lpbuf[j - 1];
+    r[1] += lpbuf[j + 5]*lpbuf[j + 1];
+    n = _mm_setr_ps(r[0], r[1], 0.0f, 0.0f);
+    for (j += 8;  j <= len;  j += 2)
+    {
+        x = _mm_set1_ps(lpbuf[j - 1]);
+        y = _mm_setr_ps(lpbuf[j - 1], lpbuf[j - 5], lpbuf[j - 9], 0.0f);
+        n = _mm_add_ps(n, _mm_mul_ps(x, y));
+    }
+    _mm_storeu_ps(rr, n);
+    r[0] = rr[0];
+    r[1] = rr[1];
+    r[2] = rr[2];
+#else
     for (i = 1;  i <= 3;  i++)
     {
         r[i - 1] = 0.0f;
@@ -530,6 +728,7 @@ static void ivfilt(float lpbuf[], float ivbuf[], int32_t len, int32_t nsamp, flo
         for (j = (i << 2) + len - nsamp;  j <= len;  j += 2)
             r[i - 1] += lpbuf[j - 1]*lpbuf[j - k - 1];
     }
+#endif
     /* Calculate predictor coefficients */
     pc1 = 0.0f;
     pc2 = 0.0f;
@@ -543,8 +742,19 @@ static void ivfilt(float lpbuf[], float ivbuf[], int32_t len, int32_t nsamp, flo
         pc2 = ivrc[1];
     }
     /* Inverse filter LPBUF into IVBUF */
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+    c1 = _mm_set1_ps(pc1);
+    c2 = _mm_set1_ps(pc2);
+    for (i = len - nsamp;  i < len;  i += 4)
+    {
+        z = _mm_sub_ps(_mm_loadu_ps(&lpbuf[i]), _mm_mul_ps(c1, _mm_loadu_ps(&lpbuf[i - 4])));
+        z = _mm_sub_ps(z, _mm_mul_ps(c2, _mm_loadu_ps(&lpbuf[i - 8])));
+        _mm_storeu_ps(&ivbuf[i], z);
+    }
+#else
     for (i = len - nsamp;  i < len;  i++)
         ivbuf[i] = lpbuf[i] - pc1*lpbuf[i - 4] - pc2*lpbuf[i - 8];
+#endif
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -44,6 +44,7 @@
 #include "floating_fudge.h"
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/dc_restore.h"
 #include "spandsp/lpc10.h"
 #include "spandsp/private/lpc10.h"
@@ -271,7 +272,7 @@ SPAN_DECLARE(lpc10_encode_state_t *) lpc10_encode_init(lpc10_encode_state_t *s,
 
     if (s == NULL)
     {
-        if ((s = (lpc10_encode_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (lpc10_encode_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
 
@@ -369,7 +370,7 @@ SPAN_DECLARE(int) lpc10_encode_release(lpc10_encode_state_t *s)
 
 SPAN_DECLARE(int) lpc10_encode_free(lpc10_encode_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -398,4 +399,14 @@ SPAN_DECLARE(int) lpc10_encode(lpc10_encode_state_t *s, uint8_t code[], const in
     return len*7;
 }
 /*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) lpc10_encode_batch(lpc10_encode_state_t *s[], uint8_t *code[], const int16_t *amp[], int len, int bytes[], int channels)
+{
+    int k;
+
+    for (k = 0;  k < channels;  k++)
+        bytes[k] = lpc10_encode(s[k], code[k], amp[k], len);
+    return channels;
+}
+/*- End of function --------------------------------------------------------*/
 /*- End of file ------------------------------------------------------------*/
@@ -55,6 +55,7 @@
 #include <stdio.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/fast_convert.h"
 #include "spandsp/logging.h"
 #include "spandsp/complex.h"
@@ -72,6 +73,9 @@
 
 #define HDLC_FRAMING_OK_THRESHOLD       5
 
+/* The number of samples of an amplitude modulated tone which are generated in one pass */
+#define AM_TONE_BLOCK_LEN               64
+
 SPAN_DECLARE(const char *) modem_connect_tone_to_str(int tone)
 {
     switch (tone)
@@ -97,11 +101,49 @@ SPAN_DECLARE(const char *) modem_connect_tone_to_str(int tone)
 }
 /*- End of function --------------------------------------------------------*/
 
+static void am_tone_block(modem_connect_tones_tx_state_t *s, int16_t amp[], int len)
+{
+    int i;
+    int j;
+    int chunk;
+    int16_t mod[AM_TONE_BLOCK_LEN];
+
+    /* Generate the carrier straight into the output buffer, and then apply
+       the modulation to it. */
+    dds_block(&s->tone_phase, s->tone_phase_rate, amp, len);
+    for (i = 0;  i < len;  i += chunk)
+    {
+        if ((chunk = len - i) > AM_TONE_BLOCK_LEN)
+            chunk = AM_TONE_BLOCK_LEN;
+        dds_mod_block(&s->mod_phase, s->mod_phase_rate, s->mod_level, 0, mod, chunk);
+        for (j = 0;  j < chunk;  j++)
+            amp[i + j] = (int16_t) (((int32_t) amp[i + j]*(int32_t) (int16_t) (s->level + mod[j])) >> 15);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static int phase_hop(modem_connect_tones_tx_state_t *s, int len)
+{
+    int xlen;
+
+    /* Apply any phase reversal due at this sample, and find how many samples
+       can be generated before the next one. */
+    if (--s->hop_timer <= 0)
+    {
+        s->hop_timer = ms_to_samples(450);
+        s->tone_phase += 0x80000000;
+    }
+    if ((xlen = s->hop_timer) > len)
+        xlen = len;
+    s->hop_timer -= (xlen - 1);
+    return xlen;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE_NONSTD(int) modem_connect_tones_tx(modem_connect_tones_tx_state_t *s,
                                                 int16_t amp[],
                                                 int len)
 {
-    int16_t mod;
     int i;
     int xlen;
 
@@ -116,8 +158,8 @@ SPAN_DECLARE_NONSTD(int) modem_connect_tones_tx(modem_connect_tones_tx_state_t *
                 if ((xlen = i + s->duration_timer - ms_to_samples(3000)) > len)
                     xlen = len;
                 s->duration_timer -= (xlen - i);
-                for (  ;  i < xlen;  i++)
-                    amp[i] = dds_mod(&s->tone_phase, s->tone_phase_rate, s->level, 0);
+                dds_mod_block(&s->tone_phase, s->tone_phase_rate, s->level, 0, &amp[i], xlen - i);
+                i = xlen;
             }
             if (s->duration_timer > 0)
             {
@@ -141,8 +183,7 @@ SPAN_DECLARE_NONSTD(int) modem_connect_tones_tx(modem_connect_tones_tx_state_t *
                 i = len;
             memset(amp, 0, sizeof(int16_t)*i);
         }
-        for (  ;  i < len;  i++)
-            amp[i] = dds_mod(&s->tone_phase, s->tone_phase_rate, s->level, 0);
+        dds_mod_block(&s->tone_phase, s->tone_phase_rate, s->level, 0, &amp[i], len - i);
         s->duration_timer -= len;
         break;
     case MODEM_CONNECT_TONES_ANS_PR:
@@ -154,14 +195,10 @@ SPAN_DECLARE_NONSTD(int) modem_connect_tones_tx(modem_connect_tones_tx_state_t *
                 i = len;
             memset(amp, 0, sizeof(int16_t)*i);
         }
-        for (  ;  i < len;  i++)
+        for (  ;  i < len;  i += xlen)
         {
-            if (--s->hop_timer <= 0)
-            {
-                s->hop_timer = ms_to_samples(450);
-                s->tone_phase += 0x80000000;
-            }
-            amp[i] = dds_mod(&s->tone_phase, s->tone_phase_rate, s->level, 0);
+            xlen = phase_hop(s, len - i);
+            dds_mod_block(&s->tone_phase, s->tone_phase_rate, s->level, 0, &amp[i], xlen);
         }
         s->duration_timer -= len;
         break;
@@ -174,11 +211,7 @@ SPAN_DECLARE_NONSTD(int) modem_connect_tones_tx(modem_connect_tones_tx_state_t *
                 i = len;
             memset(amp, 0, sizeof(int16_t)*i);
         }
-        for (  ;  i < len;  i++)
-        {
-            mod = (int16_t) (s->level + dds_mod(&s->mod_phase, s->mod_phase_rate, s->mod_level, 0));
-            amp[i] = dds_mod(&s->tone_phase, s->tone_phase_rate, mod, 0);
-        }
+        am_tone_block(s, &amp[i], len - i);
         s->duration_timer -= len;
         break;
     case MODEM_CONNECT_TONES_ANSAM_PR:
@@ -190,15 +223,10 @@ SPAN_DECLARE_NONSTD(int) modem_connect_tones_tx(modem_connect_tones_tx_state_t *
                 i = len;
             memset(amp, 0, sizeof(int16_t)*i);
         }
-        for (  ;  i < len;  i++)
+        for (  ;  i < len;  i += xlen)
         {
-            if (--s->hop_timer <= 0)
-            {
-                s->hop_timer = ms_to_samples(450);
-                s->tone_phase += 0x80000000;
-            }
-            mod = (int16_t) (s->level + dds_mod(&s->mod_phase, s->mod_phase_rate, s->mod_level, 0));
-            amp[i] = dds_mod(&s->tone_phase, s->tone_phase_rate, mod, 0);
+            xlen = phase_hop(s, len - i);
+            am_tone_block(s, &amp[i], xlen);
         }
         s->duration_timer -= len;
         break;
@@ -215,7 +243,7 @@ SPAN_DECLARE(modem_connect_tones_tx_state_t *) modem_connect_tones_tx_init(modem
     alloced = FALSE;
     if (s == NULL)
     {
-        if ((s = (modem_connect_tones_tx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (modem_connect_tones_tx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
         alloced = TRUE;
     }
@@ -276,7 +304,7 @@ SPAN_DECLARE(modem_connect_tones_tx_state_t *) modem_connect_tones_tx_init(modem
         break;
     default:
         if (alloced)
-            free(s);
+            span_free(s);
         return NULL;
     }
     return s;
@@ -291,7 +319,7 @@ SPAN_DECLARE(int) modem_connect_tones_tx_release(modem_connect_tones_tx_state_t
 
 SPAN_DECLARE(int) modem_connect_tones_tx_free(modem_connect_tones_tx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -565,7 +593,7 @@ SPAN_DECLARE(modem_connect_tones_rx_state_t *) modem_connect_tones_rx_init(modem
 {
     if (s == NULL)
     {
-        if ((s = (modem_connect_tones_rx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (modem_connect_tones_rx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
 
@@ -614,7 +642,7 @@ SPAN_DECLARE(int) modem_connect_tones_rx_release(modem_connect_tones_rx_state_t
 
 SPAN_DECLARE(int) modem_connect_tones_rx_free(modem_connect_tones_rx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
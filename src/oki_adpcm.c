@@ -39,12 +39,16 @@
 #include <string.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/oki_adpcm.h"
 #include "spandsp/private/oki_adpcm.h"
 
 /* Routines to convert 12 bit linear samples to the Oki ADPCM coding format,
    widely used in CTI, because Dialogic use it. */
 
+/*! The number of channels the batch functions step through together */
+#define OKI_ADPCM_LANES 4
+
 /* OKI ADPCM step variation table */
 static const int16_t step_size[49] =
 {
@@ -57,9 +61,55 @@ static const int16_t step_size[49] =
      1552
 };
 
-static const int16_t step_adjustment[8] =
+/* The magnitude of the change to the prediction for each step size and 3 bit code
+   magnitude, summed from the truncated parts exactly as the reference algorithm
+   does it. */
+#define OKI_DELTA(ss, c) \
+    (((ss) >> 3) + (((c) & 1)  ?  ((ss) >> 2)  :  0) + (((c) & 2)  ?  ((ss) >> 1)  :  0) + (((c) & 4)  ?  (ss)  :  0))
+#define OKI_DELTAS(ss) \
+    {OKI_DELTA(ss, 0), OKI_DELTA(ss, 1), OKI_DELTA(ss, 2), OKI_DELTA(ss, 3), \
+     OKI_DELTA(ss, 4), OKI_DELTA(ss, 5), OKI_DELTA(ss, 6), OKI_DELTA(ss, 7)}
+
+static const int16_t step_delta[49][8] =
+{
+    OKI_DELTAS(  16), OKI_DELTAS(  17), OKI_DELTAS(  19), OKI_DELTAS(  21),
+    OKI_DELTAS(  23), OKI_DELTAS(  25), OKI_DELTAS(  28), OKI_DELTAS(  31),
+    OKI_DELTAS(  34), OKI_DELTAS(  37), OKI_DELTAS(  41), OKI_DELTAS(  45),
+    OKI_DELTAS(  50), OKI_DELTAS(  55), OKI_DELTAS(  60), OKI_DELTAS(  66),
+    OKI_DELTAS(  73), OKI_DELTAS(  80), OKI_DELTAS(  88), OKI_DELTAS(  97),
+    OKI_DELTAS( 107), OKI_DELTAS( 118), OKI_DELTAS( 130), OKI_DELTAS( 143),
+    OKI_DELTAS( 157), OKI_DELTAS( 173), OKI_DELTAS( 190), OKI_DELTAS( 209),
+    OKI_DELTAS( 230), OKI_DELTAS( 253), OKI_DELTAS( 279), OKI_DELTAS( 307),
+    OKI_DELTAS( 337), OKI_DELTAS( 371), OKI_DELTAS( 408), OKI_DELTAS( 449),
+    OKI_DELTAS( 494), OKI_DELTAS( 544), OKI_DELTAS( 598), OKI_DELTAS( 658),
+    OKI_DELTAS( 724), OKI_DELTAS( 796), OKI_DELTAS( 876), OKI_DELTAS( 963),
+    OKI_DELTAS(1060), OKI_DELTAS(1166), OKI_DELTAS(1282), OKI_DELTAS(1411),
+    OKI_DELTAS(1552)
+};
+
+/* The next step index for each step index and 3 bit code magnitude. The step
+   adjustments are -1, -1, -1, -1, 2, 4, 6, 8, limited to the table. */
+#define OKI_STEP_LIMIT(i) \
+    (((i) < 0)  ?  0  :  (((i) > 48)  ?  48  :  (i)))
+#define OKI_NEXT_STEPS(i) \
+    {OKI_STEP_LIMIT((i) - 1), OKI_STEP_LIMIT((i) - 1), OKI_STEP_LIMIT((i) - 1), OKI_STEP_LIMIT((i) - 1), \
+     OKI_STEP_LIMIT((i) + 2), OKI_STEP_LIMIT((i) + 4), OKI_STEP_LIMIT((i) + 6), OKI_STEP_LIMIT((i) + 8)}
+
+static const uint8_t next_step[49][8] =
 {
-    -1, -1, -1, -1, 2, 4, 6, 8
+    OKI_NEXT_STEPS( 0), OKI_NEXT_STEPS( 1), OKI_NEXT_STEPS( 2), OKI_NEXT_STEPS( 3),
+    OKI_NEXT_STEPS( 4), OKI_NEXT_STEPS( 5), OKI_NEXT_STEPS( 6), OKI_NEXT_STEPS( 7),
+    OKI_NEXT_STEPS( 8), OKI_NEXT_STEPS( 9), OKI_NEXT_STEPS(10), OKI_NEXT_STEPS(11),
+    OKI_NEXT_STEPS(12), OKI_NEXT_STEPS(13), OKI_NEXT_STEPS(14), OKI_NEXT_STEPS(15),
+    OKI_NEXT_STEPS(16), OKI_NEXT_STEPS(17), OKI_NEXT_STEPS(18), OKI_NEXT_STEPS(19),
+    OKI_NEXT_STEPS(20), OKI_NEXT_STEPS(21), OKI_NEXT_STEPS(22), OKI_NEXT_STEPS(23),
+    OKI_NEXT_STEPS(24), OKI_NEXT_STEPS(25), OKI_NEXT_STEPS(26), OKI_NEXT_STEPS(27),
+    OKI_NEXT_STEPS(28), OKI_NEXT_STEPS(29), OKI_NEXT_STEPS(30), OKI_NEXT_STEPS(31),
+    OKI_NEXT_STEPS(32), OKI_NEXT_STEPS(33), OKI_NEXT_STEPS(34), OKI_NEXT_STEPS(35),
+    OKI_NEXT_STEPS(36), OKI_NEXT_STEPS(37), OKI_NEXT_STEPS(38), OKI_NEXT_STEPS(39),
+    OKI_NEXT_STEPS(40), OKI_NEXT_STEPS(41), OKI_NEXT_STEPS(42), OKI_NEXT_STEPS(43),
+    OKI_NEXT_STEPS(44), OKI_NEXT_STEPS(45), OKI_NEXT_STEPS(46), OKI_NEXT_STEPS(47),
+    OKI_NEXT_STEPS(48)
 };
 
 /* Band limiting filter, to allow sample rate conversion to and
@@ -149,39 +199,19 @@ static const float cutoff_coeffs[] =
     -3.648392e-4f
 };
 
-static int16_t decode(oki_adpcm_state_t *s, uint8_t adpcm)
+static __inline__ int16_t decode_step(int *last, int *step_index, int adpcm)
 {
-    int16_t d;
-    int16_t ss;
-    int16_t linear;
+    int d;
+    int sign;
+    int linear;
 
-    /* Doing the next part as follows:
-     *
-     * x = adpcm & 0x07;
-     * e = (step_size[s->step_index]*(x + x + 1)) >> 3;
-     * 
-     * Seems an obvious improvement on a modern machine, but remember
-     * the truncation errors do not come out the same. It would
-     * not, therefore, be an exact match for what this code is doing.
-     *
-     * Just what a Dialogic card does, I do not know!
-     */
-
-    ss = step_size[s->step_index];
-    d = ss >> 3;
-    if (adpcm & 0x01)
-        d += (ss >> 2);
-    /*endif*/
-    if (adpcm & 0x02)
-        d += (ss >> 1);
-    /*endif*/
-    if (adpcm & 0x04)
-        d += ss;
-    /*endif*/
-    if (adpcm & 0x08)
-        d = -d;
-    /*endif*/
-    linear = s->last + d;
+    /* The change is taken from the fused step and code table. This keeps the
+       truncation of the reference algorithm - a neater calculation, like
+       ((2*(adpcm & 0x07) + 1)*step) >> 3 does not give the same answers. Just
+       what a Dialogic card does, I do not know! */
+    d = step_delta[*step_index][adpcm & 0x07];
+    sign = -((adpcm >> 3) & 1);
+    linear = *last + ((d ^ sign) - sign);
 
     /* Saturate the values to +/- 2^11 (supposed to be 12 bits) */
     if (linear > 2047)
@@ -190,63 +220,80 @@ static int16_t decode(oki_adpcm_state_t *s, uint8_t adpcm)
         linear = -2048;
     /*endif*/
 
-    s->last = linear;
-    s->step_index += step_adjustment[adpcm & 0x07];
-    if (s->step_index < 0)
-        s->step_index = 0;
-    else if (s->step_index > 48)
-        s->step_index = 48;
-    /*endif*/
+    *last = linear;
+    *step_index = next_step[*step_index][adpcm & 0x07];
     /* Note: the result here is a 12 bit value */
-    return linear;
+    return (int16_t) linear;
 }
 /*- End of function --------------------------------------------------------*/
 
-static uint8_t encode(oki_adpcm_state_t *s, int16_t linear)
+static __inline__ int encode_step(int *last, int *step_index, int16_t linear)
 {
-    int16_t d;
-    int16_t ss;
-    uint8_t adpcm;
-
-    ss = step_size[s->step_index];
-    d = (linear >> 4) - s->last;
-    adpcm = (uint8_t) 0x00;
-    if (d < 0)
-    {
-        adpcm = (uint8_t) 0x08;
-        d = -d;
-    }
-    /*endif*/
-    if (d >= ss)
-    {
-        adpcm |= (uint8_t) 0x04;
-        d -= ss;
-    }
-    /*endif*/
-    if (d >= (ss >> 1))
-    {
-        adpcm |= (uint8_t) 0x02;
-        d -= (ss >> 1);
-    }
-    /*endif*/
-    if (d >= (ss >> 2))
-        adpcm |= (uint8_t) 0x01;
-    /*endif*/
+    int d;
+    int ss;
+    int sign;
+    int bit;
+    int adpcm;
+
+    ss = step_size[*step_index];
+    d = (linear >> 4) - *last;
+    /* Quantise the magnitude, with each bit decided by a comparison rather than
+       a branch */
+    sign = (d < 0)  ?  -1  :  0;
+    d = (d ^ sign) - sign;
+    bit = (d >= ss);
+    adpcm = bit << 2;
+    d -= ss & -bit;
+    bit = (d >= (ss >> 1));
+    adpcm |= bit << 1;
+    d -= (ss >> 1) & -bit;
+    adpcm |= (d >= (ss >> 2));
+    adpcm |= (sign & 0x08);
 
     /* Use the decoder to set the estimate of the last sample. */
     /* It also will adjust the step_index for us. */
-    s->last = decode(s, adpcm);
+    decode_step(last, step_index, adpcm);
     return adpcm;
 }
 /*- End of function --------------------------------------------------------*/
 
+static __inline__ int16_t decode(oki_adpcm_state_t *s, uint8_t adpcm)
+{
+    int last;
+    int step_index;
+    int16_t linear;
+
+    last = s->last;
+    step_index = s->step_index;
+    linear = decode_step(&last, &step_index, adpcm);
+    s->last = (int16_t) last;
+    s->step_index = (int16_t) step_index;
+    return linear;
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ uint8_t encode(oki_adpcm_state_t *s, int16_t linear)
+{
+    int last;
+    int step_index;
+    int adpcm;
+
+    last = s->last;
+    step_index = s->step_index;
+    adpcm = encode_step(&last, &step_index, linear);
+    s->last = (int16_t) last;
+    s->step_index = (int16_t) step_index;
+    return (uint8_t) adpcm;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(oki_adpcm_state_t *) oki_adpcm_init(oki_adpcm_state_t *s, int bit_rate)
 {
     if (bit_rate != 32000  &&  bit_rate != 24000)
         return NULL;
     if (s == NULL)
     {
-        if ((s = (oki_adpcm_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (oki_adpcm_state_t *) span_alloc(sizeof(*s))) == NULL)
             return  NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -264,7 +311,7 @@ SPAN_DECLARE(int) oki_adpcm_release(oki_adpcm_state_t *s)
 
 SPAN_DECLARE(int) oki_adpcm_free(oki_adpcm_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -382,4 +429,248 @@ SPAN_DECLARE(int) oki_adpcm_encode(oki_adpcm_state_t *s,
     return  bytes;
 }
 /*- End of function --------------------------------------------------------*/
+/* Decode the same number of bytes of 32kbps data for OKI_ADPCM_LANES channels. The
+   channels are stepped through together, so the long chain of dependent operations
+   in each channel overlaps with the others. */
+static void decode_lanes(oki_adpcm_state_t *s[], int16_t *amp[], const uint8_t *oki_data[], int oki_bytes)
+{
+    const uint8_t *d0;
+    const uint8_t *d1;
+    const uint8_t *d2;
+    const uint8_t *d3;
+    int16_t *a0;
+    int16_t *a1;
+    int16_t *a2;
+    int16_t *a3;
+    int last0;
+    int last1;
+    int last2;
+    int last3;
+    int step0;
+    int step1;
+    int step2;
+    int step3;
+    int i;
+
+    d0 = oki_data[0];
+    d1 = oki_data[1];
+    d2 = oki_data[2];
+    d3 = oki_data[3];
+    a0 = amp[0];
+    a1 = amp[1];
+    a2 = amp[2];
+    a3 = amp[3];
+    last0 = s[0]->last;
+    last1 = s[1]->last;
+    last2 = s[2]->last;
+    last3 = s[3]->last;
+    step0 = s[0]->step_index;
+    step1 = s[1]->step_index;
+    step2 = s[2]->step_index;
+    step3 = s[3]->step_index;
+    for (i = 0;  i < oki_bytes;  i++)
+    {
+        a0[2*i] = decode_step(&last0, &step0, d0[i] >> 4) << 4;
+        a1[2*i] = decode_step(&last1, &step1, d1[i] >> 4) << 4;
+        a2[2*i] = decode_step(&last2, &step2, d2[i] >> 4) << 4;
+        a3[2*i] = decode_step(&last3, &step3, d3[i] >> 4) << 4;
+        a0[2*i + 1] = decode_step(&last0, &step0, d0[i] & 0xF) << 4;
+        a1[2*i + 1] = decode_step(&last1, &step1, d1[i] & 0xF) << 4;
+        a2[2*i + 1] = decode_step(&last2, &step2, d2[i] & 0xF) << 4;
+        a3[2*i + 1] = decode_step(&last3, &step3, d3[i] & 0xF) << 4;
+    }
+    /*endfor*/
+    s[0]->last = (int16_t) last0;
+    s[1]->last = (int16_t) last1;
+    s[2]->last = (int16_t) last2;
+    s[3]->last = (int16_t) last3;
+    s[0]->step_index = (int16_t) step0;
+    s[1]->step_index = (int16_t) step1;
+    s[2]->step_index = (int16_t) step2;
+    s[3]->step_index = (int16_t) step3;
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Encode the same number of samples to 32kbps data for OKI_ADPCM_LANES channels,
+   which must all be on a byte boundary. Returns the number of bytes produced for
+   each channel. */
+static int encode_lanes(oki_adpcm_state_t *s[], uint8_t *oki_data[], const int16_t *amp[], int len)
+{
+    const int16_t *a0;
+    const int16_t *a1;
+    const int16_t *a2;
+    const int16_t *a3;
+    uint8_t *d0;
+    uint8_t *d1;
+    uint8_t *d2;
+    uint8_t *d3;
+    int last0;
+    int last1;
+    int last2;
+    int last3;
+    int step0;
+    int step1;
+    int step2;
+    int step3;
+    int c0;
+    int c1;
+    int c2;
+    int c3;
+    int bytes;
+    int i;
+    int k;
+
+    a0 = amp[0];
+    a1 = amp[1];
+    a2 = amp[2];
+    a3 = amp[3];
+    d0 = oki_data[0];
+    d1 = oki_data[1];
+    d2 = oki_data[2];
+    d3 = oki_data[3];
+    last0 = s[0]->last;
+    last1 = s[1]->last;
+    last2 = s[2]->last;
+    last3 = s[3]->last;
+    step0 = s[0]->step_index;
+    step1 = s[1]->step_index;
+    step2 = s[2]->step_index;
+    step3 = s[3]->step_index;
+    /* Whole bytes are built directly. This gives exactly the same bytes, and the
+       same final packing state, as packing one nibble at a time. */
+    for (i = 0, bytes = 0;  i < (len & ~1);  i += 2, bytes++)
+    {
+        c0 = encode_step(&last0, &step0, a0[i]);
+        c1 = encode_step(&last1, &step1, a1[i]);
+        c2 = encode_step(&last2, &step2, a2[i]);
+        c3 = encode_step(&last3, &step3, a3[i]);
+        d0[bytes] = (uint8_t) ((c0 << 4) | encode_step(&last0, &step0, a0[i + 1]));
+        d1[bytes] = (uint8_t) ((c1 << 4) | encode_step(&last1, &step1, a1[i + 1]));
+        d2[bytes] = (uint8_t) ((c2 << 4) | encode_step(&last2, &step2, a2[i + 1]));
+        d3[bytes] = (uint8_t) ((c3 << 4) | encode_step(&last3, &step3, a3[i + 1]));
+    }
+    /*endfor*/
+    s[0]->last = (int16_t) last0;
+    s[1]->last = (int16_t) last1;
+    s[2]->last = (int16_t) last2;
+    s[3]->last = (int16_t) last3;
+    s[0]->step_index = (int16_t) step0;
+    s[1]->step_index = (int16_t) step1;
+    s[2]->step_index = (int16_t) step2;
+    s[3]->step_index = (int16_t) step3;
+    for (k = 0;  k < OKI_ADPCM_LANES;  k++)
+    {
+        if (i > 0)
+        {
+            s[k]->oki_byte = oki_data[k][bytes - 1];
+            s[k]->mark += i;
+        }
+        /*endif*/
+        /* Any odd sample at the end is left waiting for its partner */
+        if (i < len)
+        {
+            s[k]->oki_byte = (s[k]->oki_byte << 4) | encode(s[k], amp[k][i]);
+            s[k]->mark++;
+        }
+        /*endif*/
+    }
+    /*endfor*/
+    return bytes;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) oki_adpcm_decode_batch(oki_adpcm_state_t *s[],
+                                         int16_t *amp[],
+                                         const uint8_t *oki_data[],
+                                         int oki_bytes,
+                                         int samples[],
+                                         int channels)
+{
+    oki_adpcm_state_t *ls[OKI_ADPCM_LANES];
+    int16_t *lamp[OKI_ADPCM_LANES];
+    const uint8_t *ldata[OKI_ADPCM_LANES];
+    int *lsamples[OKI_ADPCM_LANES];
+    int lanes;
+    int j;
+    int k;
+
+    /* Gather the 32kbps channels into groups, which are decoded together. The
+       24kbps channels are dominated by their sample rate conversion, and are
+       decoded one at a time. */
+    for (k = 0, lanes = 0;  k < channels;  k++)
+    {
+        if (s[k]->bit_rate != 32000)
+        {
+            samples[k] = oki_adpcm_decode(s[k], amp[k], oki_data[k], oki_bytes);
+            continue;
+        }
+        /*endif*/
+        ls[lanes] = s[k];
+        lamp[lanes] = amp[k];
+        ldata[lanes] = oki_data[k];
+        lsamples[lanes] = &samples[k];
+        if (++lanes == OKI_ADPCM_LANES)
+        {
+            decode_lanes(ls, lamp, ldata, oki_bytes);
+            for (j = 0;  j < lanes;  j++)
+                *lsamples[j] = 2*oki_bytes;
+            /*endfor*/
+            lanes = 0;
+        }
+        /*endif*/
+    }
+    /*endfor*/
+    for (j = 0;  j < lanes;  j++)
+        *lsamples[j] = oki_adpcm_decode(ls[j], lamp[j], ldata[j], oki_bytes);
+    /*endfor*/
+    return channels;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) oki_adpcm_encode_batch(oki_adpcm_state_t *s[],
+                                         uint8_t *oki_data[],
+                                         const int16_t *amp[],
+                                         int len,
+                                         int oki_bytes[],
+                                         int channels)
+{
+    oki_adpcm_state_t *ls[OKI_ADPCM_LANES];
+    uint8_t *ldata[OKI_ADPCM_LANES];
+    const int16_t *lamp[OKI_ADPCM_LANES];
+    int *lbytes[OKI_ADPCM_LANES];
+    int bytes;
+    int lanes;
+    int j;
+    int k;
+
+    /* Only 32kbps channels on a byte boundary can be encoded together */
+    for (k = 0, lanes = 0;  k < channels;  k++)
+    {
+        if (s[k]->bit_rate != 32000  ||  (s[k]->mark & 1))
+        {
+            oki_bytes[k] = oki_adpcm_encode(s[k], oki_data[k], amp[k], len);
+            continue;
+        }
+        /*endif*/
+        ls[lanes] = s[k];
+        ldata[lanes] = oki_data[k];
+        lamp[lanes] = amp[k];
+        lbytes[lanes] = &oki_bytes[k];
+        if (++lanes == OKI_ADPCM_LANES)
+        {
+            bytes = encode_lanes(ls, ldata, lamp, len);
+            for (j = 0;  j < lanes;  j++)
+                *lbytes[j] = bytes;
+            /*endfor*/
+            lanes = 0;
+        }
+        /*endif*/
+    }
+    /*endfor*/
+    for (j = 0;  j < lanes;  j++)
+        *lbytes[j] = oki_adpcm_encode(ls[j], ldata[j], lamp[j], len);
+    /*endfor*/
+    return channels;
+}
+/*- End of function --------------------------------------------------------*/
 /*- End of file ------------------------------------------------------------*/
@@ -41,8 +41,23 @@
 #include <limits.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
+#include "spandsp/plc.h"
+#include "spandsp/time_scale.h"
 #include "spandsp/playout.h"
 
+#include "spandsp/private/time_scale.h"
+#include "spandsp/private/playout.h"
+
+/* The number of bins in the histogram of transit times, used to find the target
+   length of an adaptive audio buffer */
+#define PLAYOUT_AUDIO_JITTER_BINS       128
+/* The play-out rates used to shrink and grow an adaptive audio buffer. A buffer far
+   longer than its target is shrunk more quickly. */
+#define PLAYOUT_AUDIO_SHRINK_RATE       0.9f
+#define PLAYOUT_AUDIO_FAST_SHRINK_RATE  0.8f
+#define PLAYOUT_AUDIO_GROW_RATE         1.1f
+
 static playout_frame_t *queue_get(playout_state_t *s, timestamp_t sender_stamp)
 {
     playout_frame_t *frame;
@@ -236,7 +251,7 @@ SPAN_DECLARE(int) playout_put(playout_state_t *s, void *data, int type, timestam
     }
     else
     {
-        if ((frame = (playout_frame_t *) malloc(sizeof(*frame))) == NULL)
+        if ((frame = (playout_frame_t *) span_alloc(sizeof(*frame))) == NULL)
             return PLAYOUT_ERROR;
     }
 
@@ -312,7 +327,7 @@ SPAN_DECLARE(void) playout_restart(playout_state_t *s, int min_length, int max_l
     for (frame = s->free_frames;  frame;  frame = next)
     {
         next = frame->later;
-        free(frame);
+        span_free(frame);
     }
 
     memset(s, 0, sizeof(*s));
@@ -332,7 +347,7 @@ SPAN_DECLARE(playout_state_t *) playout_init(int min_length, int max_length)
 {
     playout_state_t *s;
 
-    if ((s = (playout_state_t *) malloc(sizeof(playout_state_t))) == NULL)
+    if ((s = (playout_state_t *) span_alloc(sizeof(playout_state_t))) == NULL)
         return NULL;
     memset(s, 0, sizeof(*s));
     playout_restart(s, min_length, max_length);
@@ -350,13 +365,13 @@ SPAN_DECLARE(int) playout_release(playout_state_t *s)
     for (frame = s->first_frame;  frame;  frame = next)
     {
         next = frame->later;
-        free(frame);
+        span_free(frame);
     }
     /* Free all the frames on the free list */
     for (frame = s->free_frames;  frame;  frame = next)
     {
         next = frame->later;
-        free(frame);
+        span_free(frame);
     }
     return 0;
 }
@@ -368,7 +383,377 @@ SPAN_DECLARE(int) playout_free(playout_state_t *s)
     {
         playout_release(s);
         /* Finally, free ourselves! */ 
-        free(s);
+        span_free(s);
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+static void ring_read(playout_audio_state_t *s, int16_t amp[], timestamp_t stamp, int len)
+{
+    int pos;
+    int n;
+
+    pos = stamp & (s->ring_len - 1);
+    if ((n = s->ring_len - pos) > len)
+        n = len;
+    memcpy(amp, s->ring + pos, sizeof(int16_t)*n);
+    memset(s->valid + pos, 0, n);
+    if (n < len)
+    {
+        memcpy(amp + n, s->ring, sizeof(int16_t)*(len - n));
+        memset(s->valid, 0, len - n);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static void ring_write(playout_audio_state_t *s, const int16_t amp[], timestamp_t stamp, int len)
+{
+    int pos;
+    int n;
+
+    pos = stamp & (s->ring_len - 1);
+    if ((n = s->ring_len - pos) > len)
+        n = len;
+    memcpy(s->ring + pos, amp, sizeof(int16_t)*n);
+    memset(s->valid + pos, TRUE, n);
+    if (n < len)
+    {
+        memcpy(s->ring, amp + n, sizeof(int16_t)*(len - n));
+        memset(s->valid, TRUE, len - n);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static int ring_run(playout_audio_state_t *s, timestamp_t stamp, int valid, int max_len)
+{
+    int n;
+
+    /* Find how many samples, starting at stamp, are all received or all missing */
+    for (n = 1;  n < max_len;  n++)
+    {
+        if (s->valid[(stamp + n) & (s->ring_len - 1)] != valid)
+            break;
+    }
+    return n;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void ring_take(playout_audio_state_t *s, int16_t amp[], int len, int grow)
+{
+    int valid;
+    int i;
+    int n;
+
+    for (i = 0;  i < len;  i += n)
+    {
+        valid = s->valid[s->play_stamp & (s->ring_len - 1)];
+        n = ring_run(s, s->play_stamp, valid, len - i);
+        if (valid)
+        {
+            ring_read(s, amp + i, s->play_stamp, n);
+            plc_rx(&s->plc, amp + i, n);
+            s->play_stamp += n;
+        }
+        else
+        {
+            plc_fillin(&s->plc, amp + i, n);
+            if (grow  &&  s->latest_stamp - s->play_stamp <= 0)
+            {
+                /* Nothing from here on has arrived yet, and the buffer needs to grow, so
+                   wait for it, rather than treating it as lost. */
+                s->samples_inserted += n;
+            }
+            else
+            {
+                s->samples_concealed += n;
+                s->play_stamp += n;
+            }
+        }
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static void restart_stream(playout_audio_state_t *s, timestamp_t sender_stamp)
+{
+    memset(s->valid, 0, s->ring_len);
+    s->transit_ptr = 0;
+    s->transit_entries = 0;
+    s->play_stamp = sender_stamp - s->target_length;
+    s->latest_stamp = sender_stamp;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void update_target(playout_audio_state_t *s, timestamp_t transit)
+{
+    int hist[PLAYOUT_AUDIO_JITTER_BINS];
+    timestamp_t min_transit;
+    timestamp_t target;
+    int limit;
+    int count;
+    int bin;
+    int i;
+
+    s->transit[s->transit_ptr] = transit;
+    if (++s->transit_ptr >= PLAYOUT_AUDIO_JITTER_WINDOW)
+        s->transit_ptr = 0;
+    if (s->transit_entries < PLAYOUT_AUDIO_JITTER_WINDOW)
+        s->transit_entries++;
+    min_transit = s->transit[0];
+    for (i = 1;  i < s->transit_entries;  i++)
+    {
+        if (s->transit[i] < min_transit)
+            min_transit = s->transit[i];
+    }
+    s->min_transit = min_transit;
+    /* Keep the starting target until there are enough frames to judge the jitter */
+    if (s->transit_entries < PLAYOUT_AUDIO_JITTER_WINDOW/8)
+        return;
+    memset(hist, 0, sizeof(hist));
+    for (i = 0;  i < s->transit_entries;  i++)
+    {
+        bin = (s->transit[i] - min_transit)/s->bin_width;
+        if (bin >= PLAYOUT_AUDIO_JITTER_BINS)
+            bin = PLAYOUT_AUDIO_JITTER_BINS - 1;
+        hist[bin]++;
+    }
+    limit = (s->transit_entries*PLAYOUT_AUDIO_JITTER_PERCENTILE + 99)/100;
+    count = 0;
+    for (bin = 0;  bin < PLAYOUT_AUDIO_JITTER_BINS - 1;  bin++)
+    {
+        if ((count += hist[bin]) >= limit)
+            break;
+    }
+    target = (bin + 1)*s->bin_width;
+    if (target < s->min_length)
+        target = s->min_length;
+    else if (target > s->max_length)
+        target = s->max_length;
+    s->target_length = target;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void set_scaling(playout_audio_state_t *s, int scaling, float rate)
+{
+    if (scaling)
+    {
+        time_scale_rate(&s->time_scale, rate);
+    }
+    else
+    {
+        /* Pass the audio straight through again, without the buffering delay of time scaling */
+        s->fifo_fill += time_scale_flush(&s->time_scale, s->fifo + s->fifo_fill);
+    }
+    s->scaling = scaling;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) playout_audio_put(playout_audio_state_t *s, const int16_t amp[], int len, timestamp_t sender_stamp, timestamp_t receiver_stamp)
+{
+    timestamp_t late;
+
+    if (len <= 0  ||  len > s->ring_len/2)
+        return PLAYOUT_ERROR;
+    s->frames_in++;
+    if (!s->started)
+    {
+        restart_stream(s, sender_stamp);
+        s->started = TRUE;
+    }
+    else if (sender_stamp + len - s->play_stamp > s->ring_len
+             ||
+             s->play_stamp - sender_stamp > s->ring_len)
+    {
+        /* The sender's time stamps have jumped, so start again from this frame */
+        restart_stream(s, sender_stamp);
+        s->restarts++;
+    }
+    update_target(s, receiver_stamp - sender_stamp);
+    if ((late = s->play_stamp - sender_stamp) > 0)
+    {
+        if (late >= len)
+        {
+            s->frames_late++;
+            return PLAYOUT_DROP;
+        }
+        /* Keep the part of the frame which is not too late */
+        amp += late;
+        sender_stamp += late;
+        len -= late;
+    }
+    ring_write(s, amp, sender_stamp, len);
+    if (sender_stamp + len - s->latest_stamp > 0)
+        s->latest_stamp = sender_stamp + len;
+    return PLAYOUT_OK;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) playout_audio_get(playout_audio_state_t *s, int16_t amp[], int len, timestamp_t now)
+{
+    timestamp_t error;
+    int n;
+
+    if (len <= 0  ||  len > s->max_block)
+        return -1;
+    if (!s->started)
+    {
+        memset(amp, 0, sizeof(int16_t)*len);
+        return len;
+    }
+    /* Judge the buffer by the last sample of this block, which is the one taken from
+       the ring with least time to spare. */
+    error = playout_audio_current_length(s, now) - len - s->target_length;
+    switch (s->scaling)
+    {
+    case 0:
+        if (error > s->threshold)
+        {
+            set_scaling(s, -1, (error > 4*s->threshold)  ?  PLAYOUT_AUDIO_FAST_SHRINK_RATE  :  PLAYOUT_AUDIO_SHRINK_RATE);
+        }
+        else if (error < -s->threshold
+                 &&
+                 ring_run(s, s->play_stamp, TRUE, s->time_scale.buf_len) >= s->time_scale.buf_len)
+        {
+            /* Only grow by time scaling when enough audio is waiting to fill the time
+               scaling buffer. Otherwise it will grow when the ring runs dry. */
+            set_scaling(s, 1, PLAYOUT_AUDIO_GROW_RATE);
+        }
+        break;
+    case -1:
+        if (error <= 0)
+            set_scaling(s, 0, 1.0f);
+        else
+            time_scale_rate(&s->time_scale, (error > 4*s->threshold)  ?  PLAYOUT_AUDIO_FAST_SHRINK_RATE  :  PLAYOUT_AUDIO_SHRINK_RATE);
+        break;
+    case 1:
+        if (error >= 0)
+            set_scaling(s, 0, 1.0f);
+        break;
+    }
+    while (s->fifo_fill < len)
+    {
+        n = len - s->fifo_fill;
+        if (s->scaling)
+        {
+            ring_take(s, s->scratch, n, error < 0);
+            s->fifo_fill += time_scale(&s->time_scale, s->fifo + s->fifo_fill, s->scratch, n);
+        }
+        else
+        {
+            ring_take(s, s->fifo + s->fifo_fill, n, error < 0);
+            s->fifo_fill += n;
+        }
+    }
+    memcpy(amp, s->fifo, sizeof(int16_t)*len);
+    s->fifo_fill -= len;
+    memmove(s->fifo, s->fifo + len, sizeof(int16_t)*s->fifo_fill);
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(timestamp_t) playout_audio_current_length(playout_audio_state_t *s, timestamp_t now)
+{
+    int pending;
+
+    if (!s->started)
+        return 0;
+    /* Audio taken from the ring, but not yet output, is still part of the buffer */
+    pending = s->fifo_fill;
+    if (s->scaling)
+        pending += s->time_scale.fill;
+    return now - s->min_transit - (s->play_stamp - pending);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(timestamp_t) playout_audio_target_length(playout_audio_state_t *s)
+{
+    return s->target_length;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(playout_audio_state_t *) playout_audio_init(playout_audio_state_t *s, int sample_rate, int min_length, int max_length)
+{
+    int alloced;
+
+    if (sample_rate <= 0  ||  min_length < 0  ||  max_length < min_length)
+        return NULL;
+    alloced = FALSE;
+    if (s == NULL)
+    {
+        if ((s = (playout_audio_state_t *) span_alloc(sizeof(*s))) == NULL)
+            return NULL;
+        alloced = TRUE;
+    }
+    memset(s, 0, sizeof(*s));
+    if (time_scale_init(&s->time_scale, sample_rate, 1.0f) == NULL)
+    {
+        if (alloced)
+            span_free(s);
+        return NULL;
+    }
+    plc_init(&s->plc);
+    s->sample_rate = sample_rate;
+    s->min_length = min_length;
+    s->max_length = max_length;
+    s->max_block = sample_rate/10;
+    /* The ring must hold everything from the play-out point to the latest audio, however
+       long the buffer becomes. */
+    for (s->ring_len = 1024;  s->ring_len < 2*(max_length + s->max_block);  s->ring_len <<= 1)
+        ;
+    s->ring = (int16_t *) span_alloc(sizeof(int16_t)*s->ring_len);
+    s->valid = (uint8_t *) span_alloc(s->ring_len);
+    /* The FIFO must hold up to a block, plus the output from time scaling a block, plus
+       the contents of the time scaling buffer. */
+    s->fifo = (int16_t *) span_alloc(sizeof(int16_t)*sample_rate/2);
+    s->scratch = (int16_t *) span_alloc(sizeof(int16_t)*s->max_block);
+    if (s->ring == NULL  ||  s->valid == NULL  ||  s->fifo == NULL  ||  s->scratch == NULL)
+    {
+        playout_audio_release(s);
+        if (alloced)
+            span_free(s);
+        return NULL;
+    }
+    memset(s->valid, 0, s->ring_len);
+    s->bin_width = max_length/PLAYOUT_AUDIO_JITTER_BINS + 1;
+    s->threshold = sample_rate/100;
+    s->target_length = min_length + (max_length - min_length)/4;
+    return s;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) playout_audio_release(playout_audio_state_t *s)
+{
+    if (s->ring)
+    {
+        span_free(s->ring);
+        s->ring = NULL;
+    }
+    if (s->valid)
+    {
+        span_free(s->valid);
+        s->valid = NULL;
+    }
+    if (s->fifo)
+    {
+        span_free(s->fifo);
+        s->fifo = NULL;
+    }
+    if (s->scratch)
+    {
+        span_free(s->scratch);
+        s->scratch = NULL;
+    }
+    time_scale_release(&s->time_scale);
+    plc_release(&s->plc);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) playout_audio_free(playout_audio_state_t *s)
+{
+    if (s)
+    {
+        playout_audio_release(s);
+        span_free(s);
     }
     return 0;
 }
@@ -41,8 +41,12 @@
 #endif
 #include "floating_fudge.h"
 #include <limits.h>
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+#include "mmx_sse_decs.h"
+#endif
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/fast_convert.h"
 #include "spandsp/saturated.h"
 #include "spandsp/plc.h"
@@ -50,6 +54,14 @@
 /* We do a straight line fade to zero volume in 50ms when we are filling in for missing data. */
 #define ATTENUATION_INCREMENT       0.0025f     /* Attenuation per sample */
 
+/* Each good block, the pitch is looked for closely within this many lags either side
+   of the last pitch. */
+#define PITCH_TRACK_SPAN(pitch)     (((pitch) >> 4) + 1)
+/* The lag step of the coarse sweep of the whole pitch range, and the number of its
+   lags checked each good block. The whole range is swept every 7 blocks. */
+#define PITCH_SWEEP_STEP            4
+#define PITCH_SWEEP_LAGS            3
+
 static void save_history(plc_state_t *s, int16_t *buf, int len)
 {
     if (len >= PLC_HISTORY_LEN)
@@ -87,7 +99,53 @@ static __inline__ void normalise_history(plc_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
-static __inline__ int amdf_pitch(int min_pitch, int max_pitch, int16_t amp[], int len)
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+static __inline__ int amdf_pitch(int min_pitch, int max_pitch, int step, int16_t amp[], int len, int *best_acc)
+{
+    __m128i zero;
+    __m128i x;
+    __m128i y;
+    __m128i d;
+    __m128i sum;
+    int32_t part[4];
+    int i;
+    int j;
+    int acc;
+    int min_acc;
+    int pitch;
+
+    /* |x - y| is found as max(x, y) - min(x, y), which fits in an unsigned 16 bit
+       lane. It is widened to 32 bits before it is summed. The sums are exact, so
+       the same pitch is chosen as by the simple code. The length must be a
+       multiple of 8. */
+    zero = _mm_setzero_si128();
+    pitch = min_pitch;
+    min_acc = INT_MAX;
+    for (i = max_pitch;  i <= min_pitch;  i += step)
+    {
+        sum = _mm_setzero_si128();
+        for (j = 0;  j + 8 <= len;  j += 8)
+        {
+            x = _mm_loadu_si128((const __m128i *) &amp[i + j]);
+            y = _mm_loadu_si128((const __m128i *) &amp[j]);
+            d = _mm_sub_epi16(_mm_max_epi16(x, y), _mm_min_epi16(x, y));
+            sum = _mm_add_epi32(sum, _mm_unpacklo_epi16(d, zero));
+            sum = _mm_add_epi32(sum, _mm_unpackhi_epi16(d, zero));
+        }
+        _mm_storeu_si128((__m128i *) part, sum);
+        acc = part[0] + part[1] + part[2] + part[3];
+        if (acc < min_acc)
+        {
+            min_acc = acc;
+            pitch = i;
+        }
+    }
+    *best_acc = min_acc;
+    return pitch;
+}
+/*- End of function --------------------------------------------------------*/
+#else
+static __inline__ int amdf_pitch(int min_pitch, int max_pitch, int step, int16_t amp[], int len, int *best_acc)
 {
     int i;
     int j;
@@ -97,7 +155,7 @@ static __inline__ int amdf_pitch(int min_pitch, int max_pitch, int16_t amp[], in
 
     pitch = min_pitch;
     min_acc = INT_MAX;
-    for (i = max_pitch;  i <= min_pitch;  i++)
+    for (i = max_pitch;  i <= min_pitch;  i += step)
     {
         acc = 0;
         for (j = 0;  j < len;  j++)
@@ -108,9 +166,60 @@ static __inline__ int amdf_pitch(int min_pitch, int max_pitch, int16_t amp[], in
             pitch = i;
         }
     }
+    *best_acc = min_acc;
     return pitch;
 }
 /*- End of function --------------------------------------------------------*/
+#endif
+
+static __inline__ void track_pitch(plc_state_t *s)
+{
+    int16_t *amp;
+    int lo;
+    int hi;
+    int pitch;
+    int acc;
+    int sweep_pitch;
+    int sweep_acc;
+
+    /* Keep the pitch of the real signal up to date as each block of it arrives, so
+       the first block of a gap needs no search. Pitch usually changes slowly, so look
+       closely around the last pitch. A few lags of a coarse sweep of the whole range
+       are also checked each block, and if one of them matches better, look closely
+       around that instead. This catches the pitch jumping, within a few blocks. */
+    normalise_history(s);
+    amp = s->history + PLC_HISTORY_LEN - CORRELATION_SPAN - PLC_PITCH_MIN;
+    lo = s->pitch - PITCH_TRACK_SPAN(s->pitch);
+    if (lo < PLC_PITCH_MAX)
+        lo = PLC_PITCH_MAX;
+    hi = s->pitch + PITCH_TRACK_SPAN(s->pitch);
+    if (hi > PLC_PITCH_MIN)
+        hi = PLC_PITCH_MIN;
+    pitch = amdf_pitch(hi, lo, 1, amp, CORRELATION_SPAN, &acc);
+
+    lo = PLC_PITCH_MAX + s->pitch_sweep;
+    hi = lo + PITCH_SWEEP_STEP*(PITCH_SWEEP_LAGS - 1);
+    if (hi > PLC_PITCH_MIN)
+        hi = PLC_PITCH_MIN;
+    s->pitch_sweep += PITCH_SWEEP_STEP*PITCH_SWEEP_LAGS;
+    if (s->pitch_sweep > PLC_PITCH_MIN - PLC_PITCH_MAX)
+        s->pitch_sweep = 0;
+    sweep_pitch = amdf_pitch(hi, lo, PITCH_SWEEP_STEP, amp, CORRELATION_SPAN, &sweep_acc);
+    if (sweep_acc < acc)
+    {
+        lo = sweep_pitch - (PITCH_SWEEP_STEP - 1);
+        if (lo < PLC_PITCH_MAX)
+            lo = PLC_PITCH_MAX;
+        hi = sweep_pitch + (PITCH_SWEEP_STEP - 1);
+        if (hi > PLC_PITCH_MIN)
+            hi = PLC_PITCH_MIN;
+        sweep_pitch = amdf_pitch(hi, lo, 1, amp, CORRELATION_SPAN, &sweep_acc);
+        if (sweep_acc < acc)
+            pitch = sweep_pitch;
+    }
+    s->pitch = pitch;
+}
+/*- End of function --------------------------------------------------------*/
 
 SPAN_DECLARE(int) plc_rx(plc_state_t *s, int16_t amp[], int len)
 {
@@ -152,6 +261,7 @@ SPAN_DECLARE(int) plc_rx(plc_state_t *s, int16_t amp[], int len)
         s->missing_samples = 0;
     }
     save_history(s, amp, len);
+    track_pitch(s);
     return len;
 }
 /*- End of function --------------------------------------------------------*/
@@ -172,10 +282,10 @@ SPAN_DECLARE(int) plc_fillin(plc_state_t *s, int16_t amp[], int len)
     orig_len = len;
     if (s->missing_samples == 0)
     {
-        /* As the gap in real speech starts we need to assess the last known pitch,
-           and prepare the synthetic data we will use for fill-in */
+        /* As the gap in real speech starts we need the last known pitch, which
+           plc_rx() has been tracking, and must prepare the synthetic data we will
+           use for fill-in */
         normalise_history(s);
-        s->pitch = amdf_pitch(PLC_PITCH_MIN, PLC_PITCH_MAX, s->history + PLC_HISTORY_LEN - CORRELATION_SPAN - PLC_PITCH_MIN, CORRELATION_SPAN);
         /* We overlap a 1/4 wavelength */
         pitch_overlap = s->pitch >> 2;
         /* Cook up a single cycle of pitch, using a single of the real signal with 1/4
@@ -232,14 +342,36 @@ SPAN_DECLARE(int) plc_fillin(plc_state_t *s, int16_t amp[], int len)
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) plc_rx_batch(plc_state_t *s[], int16_t *amp[], int len, int channels)
+{
+    int k;
+
+    for (k = 0;  k < channels;  k++)
+        plc_rx(s[k], amp[k], len);
+    return channels;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) plc_fillin_batch(plc_state_t *s[], int16_t *amp[], int len, int channels)
+{
+    int k;
+
+    for (k = 0;  k < channels;  k++)
+        plc_fillin(s[k], amp[k], len);
+    return channels;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(plc_state_t *) plc_init(plc_state_t *s)
 {
     if (s == NULL)
     {
-        if ((s = (plc_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (plc_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
+    /* This is the pitch an AMDF search finds in the silent history */
+    s->pitch = PLC_PITCH_MAX;
     return s;
 }
 /*- End of function --------------------------------------------------------*/
@@ -253,7 +385,7 @@ SPAN_DECLARE(int) plc_release(plc_state_t *s)
 SPAN_DECLARE(int) plc_free(plc_state_t *s)
 {
     if (s)
-        free(s);
+        span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -0,0 +1,154 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * alloc.h - Memory allocation for the library, with a replaceable
+ *           allocator, and optional arenas.
+ *
+ * Written by Steve Underwood <steveu@coppice.org>
+ *
+ * Copyright (C) 2010 Steve Underwood
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+#if !defined(_SPANDSP_ALLOC_H_)
+#define _SPANDSP_ALLOC_H_
+
+/*! \page alloc_page Memory allocation
+\section alloc_page_sec_1 What does it do?
+All the memory the library allocates, for the contexts created by the init functions
+when they are passed NULL, and for the buffers those contexts use, is obtained through
+span_alloc(), span_realloc() and span_free(). By default these use malloc(), realloc()
+and free(). span_set_allocator() replaces these with an application's own allocator,
+for the whole library.
+
+An arena is a single block of memory, from which allocations are carved in turn. When
+an arena is selected for a thread, all the memory the library allocates in that thread
+comes from the arena. Freeing memory in an arena does nothing, except that the most
+recent allocation is given back. The whole arena is emptied at once, by
+span_arena_reset(). An application handling many calls can create the objects for a
+call, such as a FAX or T.38 gateway context, from an arena sized for a call, and empty
+the arena when the call ends. This avoids many separate allocations at call set up,
+and contention between threads for the allocator.
+
+\section alloc_page_sec_2 How does it work?
+The selected arena is kept per thread, and only affects where new memory comes from.
+Each block records whether it came from an arena, and which one, so memory is freed
+correctly whatever arena, if any, is selected at the time. An object can be created
+in one thread and freed in another. Buffers which an object allocates while it runs
+come from whatever is selected then, so an arena should normally stay selected while
+a call's objects are used. An arena must only be used by one thread at a time.
+Objects which hold other resources, such as the TIFF files used by T.4, should still
+be released before the arena is reset. When an arena is full, allocation fails, as it
+would if the heap were exhausted.
+
+span_set_allocator() should be called before any objects are created, as memory must
+be freed by the allocator which provided it.
+*/
+
+/*! Allocation function, like malloc(). */
+typedef void *(*span_alloc_t)(size_t size);
+
+/*! Reallocation function, like realloc(). */
+typedef void *(*span_realloc_t)(void *ptr, size_t size);
+
+/*! Free function, like free(). */
+typedef void (*span_free_t)(void *ptr);
+
+/*! Memory arena context. */
+typedef struct span_arena_s span_arena_t;
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+/*! \brief Replace the allocator used throughout the library.
+    \param custom_alloc The allocation function, or NULL for malloc().
+    \param custom_realloc The reallocation function, or NULL for realloc().
+    \param custom_free The free function, or NULL for free().
+    \return 0 for OK. */
+SPAN_DECLARE(int) span_set_allocator(span_alloc_t custom_alloc,
+                                     span_realloc_t custom_realloc,
+                                     span_free_t custom_free);
+
+/*! \brief Allocate memory, from the calling thread's selected arena, if there is one,
+           or else from the library's allocator.
+    \param size The number of bytes.
+    \return A pointer to the memory, or NULL. */
+SPAN_DECLARE(void *) span_alloc(size_t size);
+
+/*! \brief Change the size of memory obtained from span_alloc().
+    \param ptr The memory, or NULL.
+    \param size The new number of bytes.
+    \return A pointer to the memory, or NULL. */
+SPAN_DECLARE(void *) span_realloc(void *ptr, size_t size);
+
+/*! \brief Free memory obtained from span_alloc().
+    \param ptr The memory, or NULL. */
+SPAN_DECLARE(void) span_free(void *ptr);
+
+/*! \brief Duplicate a string, in memory obtained from span_alloc().
+    \param s The string.
+    \return A pointer to the copy, or NULL. */
+SPAN_DECLARE(char *) span_strdup(const char *s);
+
+/*! \brief Select the arena from which the calling thread's allocations are made.
+    \param s The arena context, or NULL to use the library's allocator.
+    \return The arena which was selected before, or NULL. */
+SPAN_DECLARE(span_arena_t *) span_arena_select(span_arena_t *s);
+
+/*! \brief Empty an arena, freeing everything allocated from it.
+    \param s The arena context. */
+SPAN_DECLARE(void) span_arena_reset(span_arena_t *s);
+
+/*! \brief Get the number of bytes in use in an arena.
+    \param s The arena context.
+    \return The number of bytes. */
+SPAN_DECLARE(size_t) span_arena_get_used(span_arena_t *s);
+
+/*! \brief Get the largest number of bytes in use in an arena, since it was
+           initialised.
+    \param s The arena context.
+    \return The number of bytes. */
+SPAN_DECLARE(size_t) span_arena_get_peak(span_arena_t *s);
+
+/*! \brief Initialise an arena.
+    \param s The arena context. If NULL, a context is allocated.
+    \param buf The memory for the arena, or NULL to allocate len bytes from the
+           library's allocator.
+    \param len The size of the arena, in bytes.
+    \return A pointer to the arena context, or NULL if there was a problem. */
+SPAN_DECLARE(span_arena_t *) span_arena_init(span_arena_t *s, void *buf, size_t len);
+
+/*! \brief Release an arena. Nothing allocated from it may be used afterwards.
+    \param s The arena context.
+    \return 0 for OK. */
+SPAN_DECLARE(int) span_arena_release(span_arena_t *s);
+
+/*! \brief Free an arena. Nothing allocated from it may be used afterwards.
+    \param s The arena context.
+    \return 0 for OK. */
+SPAN_DECLARE(int) span_arena_free(span_arena_t *s);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
+/*- End of file ------------------------------------------------------------*/
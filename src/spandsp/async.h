@@ -101,6 +101,18 @@ typedef void (*put_bit_func_t)(void *user_data, int bit);
 /*! Bit get function for data pumps */
 typedef int (*get_bit_func_t)(void *user_data);
 
+/*! Bit chunk put function for data pumps. This passes several bits in one call. The
+    nbits bits (1 to 16) are right aligned in bits, with the earliest bit in the most
+    significant position. A data pump which has one of these uses it for data, and
+    still reports status changes through its put_bit function. */
+typedef void (*put_bits_func_t)(void *user_data, unsigned int bits, int nbits);
+
+/*! Bit chunk get function for data pumps. This supplies several bits in one call. The
+    bits are right aligned in *bits, with the earliest to be sent in the most significant
+    position. The return value is the number of bits (1 to 16), or a status code, such
+    as SIG_STATUS_END_OF_DATA, if there are no more bits. */
+typedef int (*get_bits_func_t)(void *user_data, unsigned int *bits);
+
 /*! Completion callback function for tx data pumps */
 typedef void (*modem_tx_status_func_t)(void *user_data, int status);
 
@@ -170,6 +182,14 @@ SPAN_DECLARE(int) async_tx_free(async_tx_state_t *s);
     \return the next bit, or PUTBIT_END_OF_DATA to indicate the data stream has ended. */
 SPAN_DECLARE_NONSTD(int) async_tx_get_bit(void *user_data);
 
+/*! Get the next character of a transmitted serial bit stream, with its start, parity and
+    stop bits, as a chunk of bits. This is a get_bits_func_t.
+    \brief Get the next character of a transmitted serial bit stream, as a chunk of bits.
+    \param user_data An opaque point which must point to a transmitter context.
+    \param bits The bits, right aligned, earliest in the most significant position.
+    \return The number of bits, or SIG_STATUS_END_OF_DATA to indicate the data stream has ended. */
+SPAN_DECLARE_NONSTD(int) async_tx_get_bits(void *user_data, unsigned int *bits);
+
 /*! Initialise an asynchronous data receiver context.
     \brief Initialise an asynchronous data receiver context.
     \param s The receiver context.
@@ -203,6 +223,13 @@ SPAN_DECLARE(int) async_rx_free(async_rx_state_t *s);
         - SIG_STATUS_END_OF_DATA */
 SPAN_DECLARE_NONSTD(void) async_rx_put_bit(void *user_data, int bit);
 
+/*! Accept a chunk of bits from a received serial bit stream. This is a put_bits_func_t.
+    \brief Accept a chunk of bits from a received serial bit stream.
+    \param user_data An opaque point which must point to a receiver context.
+    \param bits The bits, right aligned, earliest in the most significant position.
+    \param nbits The number of bits. */
+SPAN_DECLARE_NONSTD(void) async_rx_put_bits(void *user_data, unsigned int bits, int nbits);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -163,6 +163,13 @@ SPAN_DECLARE(void) at_interpreter(at_state_t *s, const char *cmd, int len);
 
 SPAN_DECLARE(void) at_set_class1_handler(at_state_t *s, at_class1_handler_t handler, void *user_data);
 
+/*! Get the amount of memory an AT interpreter context is using. This includes the
+    caller ID information and the local ID.
+    \brief Get the amount of memory an AT interpreter context is using.
+    \param s The AT context.
+    \return The number of bytes in use. */
+SPAN_DECLARE(int) at_get_memory_usage(at_state_t *s);
+
 /*! Initialise an AT interpreter context.
     \brief Initialise an AT interpreter context.
     \param s The AT context.
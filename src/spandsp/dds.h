@@ -89,6 +89,15 @@ SPAN_DECLARE(int16_t) dds(uint32_t *phase_acc, int32_t phase_rate);
 */
 SPAN_DECLARE(int16_t) dds_lookup(uint32_t phase);
 
+/*! \brief Generate a block of integer tone samples. This gives exactly the same
+           samples as calling dds() for each one, but is much cheaper.
+    \param phase_acc A pointer to a phase accumulator value.
+    \param phase_rate The phase increment to be applied.
+    \param amp The buffer for the generated samples, between -32767 and 32767.
+    \param len The number of samples to generate.
+*/
+SPAN_DECLARE(void) dds_block(uint32_t *phase_acc, int32_t phase_rate, int16_t amp[], int len);
+
 /*! \brief Generate an integer tone sample, with modulation.
     \param phase_acc A pointer to a phase accumulator value.
     \param phase_rate The phase increment to be applied.
@@ -98,6 +107,17 @@ SPAN_DECLARE(int16_t) dds_lookup(uint32_t phase);
 */
 SPAN_DECLARE(int16_t) dds_mod(uint32_t *phase_acc, int32_t phase_rate, int16_t scale, int32_t phase);
 
+/*! \brief Generate a block of integer tone samples, with modulation. This gives exactly
+           the same samples as calling dds_mod() for each one, but is much cheaper.
+    \param phase_acc A pointer to a phase accumulator value.
+    \param phase_rate The phase increment to be applied.
+    \param scale The scaling factor.
+    \param phase The phase offset.
+    \param amp The buffer for the generated samples, between -32767 and 32767.
+    \param len The number of samples to generate.
+*/
+SPAN_DECLARE(void) dds_mod_block(uint32_t *phase_acc, int32_t phase_rate, int16_t scale, int32_t phase, int16_t amp[], int len);
+
 /*! \brief Lookup the complex integer value of a specified phase.
     \param phase The phase accumulator value to be looked up.
     \return The complex signal amplitude, between (-32767, -32767) and (32767, 32767).
@@ -111,6 +131,15 @@ SPAN_DECLARE(complexi_t) dds_lookup_complexi(uint32_t phase);
 */
 SPAN_DECLARE(complexi_t) dds_complexi(uint32_t *phase_acc, int32_t phase_rate);
 
+/*! \brief Generate a block of complex integer tone samples. This gives exactly the same
+           samples as calling dds_complexi() for each one, but is much cheaper.
+    \param phase_acc A pointer to a phase accumulator value.
+    \param phase_rate The phase increment to be applied.
+    \param amp The buffer for the generated samples, between (-32767, -32767) and (32767, 32767).
+    \param len The number of samples to generate.
+*/
+SPAN_DECLARE(void) dds_complexi_block(uint32_t *phase_acc, int32_t phase_rate, complexi_t amp[], int len);
+
 /*! \brief Generate a complex integer tone sample, with modulation.
     \param phase_acc A pointer to a phase accumulator value.
     \param phase_rate The phase increment to be applied.
@@ -212,6 +241,15 @@ SPAN_DECLARE(void) dds_advancef(uint32_t *phase_acc, int32_t phase_rate);
 */
 SPAN_DECLARE(float) ddsf(uint32_t *phase_acc, int32_t phase_rate);
 
+/*! \brief Generate a block of floating point tone samples. This gives exactly the same
+           samples as calling ddsf() for each one, but is much cheaper.
+    \param phase_acc A pointer to a phase accumulator value.
+    \param phase_rate The phase increment to be applied.
+    \param amp The buffer for the generated samples, between -1.0 and 1.0.
+    \param len The number of samples to generate.
+*/
+SPAN_DECLARE(void) ddsf_block(uint32_t *phase_acc, int32_t phase_rate, float amp[], int len);
+
 /*! \brief Lookup the floating point value of a specified phase.
     \param phase The phase accumulator value to be looked up.
     \return The signal amplitude, between -1.0 and 1.0.
@@ -227,6 +265,17 @@ SPAN_DECLARE(float) dds_lookupf(uint32_t phase);
 */
 SPAN_DECLARE(float) dds_modf(uint32_t *phase_acc, int32_t phase_rate, float scale, int32_t phase);
 
+/*! \brief Generate a block of floating point tone samples, with modulation. This gives
+           exactly the same samples as calling dds_modf() for each one, but is much cheaper.
+    \param phase_acc A pointer to a phase accumulator value.
+    \param phase_rate The phase increment to be applied.
+    \param scale The scaling factor.
+    \param phase The phase offset.
+    \param amp The buffer for the generated samples.
+    \param len The number of samples to generate.
+*/
+SPAN_DECLARE(void) dds_modf_block(uint32_t *phase_acc, int32_t phase_rate, float scale, int32_t phase, float amp[], int len);
+
 /*! \brief Generate a complex floating point tone sample.
     \param phase_acc A pointer to a phase accumulator value.
     \param phase_rate The phase increment to be applied.
@@ -234,6 +283,15 @@ SPAN_DECLARE(float) dds_modf(uint32_t *phase_acc, int32_t phase_rate, float scal
 */
 SPAN_DECLARE(complexf_t) dds_complexf(uint32_t *phase_acc, int32_t phase_rate);
 
+/*! \brief Generate a block of complex floating point tone samples. This gives exactly the
+           same samples as calling dds_complexf() for each one, but is much cheaper.
+    \param phase_acc A pointer to a phase accumulator value.
+    \param phase_rate The phase increment to be applied.
+    \param amp The buffer for the generated samples, between (-1.0, -1.0) and (1.0, 1.0).
+    \param len The number of samples to generate.
+*/
+SPAN_DECLARE(void) dds_complexf_block(uint32_t *phase_acc, int32_t phase_rate, complexf_t amp[], int len);
+
 /*! \brief Lookup the complex value of a specified phase.
     \param phase The phase accumulator value to be looked up.
     \return The complex signal amplitude, between (-1.0, -1.0) and (1.0, 1.0).
@@ -31,6 +31,7 @@
 #if !defined(_SPANDSP_EXPOSE_H_)
 #define _SPANDSP_EXPOSE_H_
 
+#include <spandsp/private/alloc.h>
 #include <spandsp/private/logging.h>
 #include <spandsp/private/schedule.h>
 #include <spandsp/private/bitstream.h>
@@ -49,8 +50,10 @@
 #include <spandsp/private/gsm0610.h>
 #include <spandsp/private/oki_adpcm.h>
 #include <spandsp/private/ima_adpcm.h>
+#include <spandsp/private/transcode.h>
 #include <spandsp/private/hdlc.h>
 #include <spandsp/private/time_scale.h>
+#include <spandsp/private/playout.h>
 #include <spandsp/private/super_tone_tx.h>
 #include <spandsp/private/super_tone_rx.h>
 #include <spandsp/private/silence_gen.h>
@@ -82,8 +85,10 @@
 #include <spandsp/private/t30.h>
 #include <spandsp/private/fax.h>
 #include <spandsp/private/t38_core.h>
+#include <spandsp/private/udptl.h>
 #include <spandsp/private/t38_non_ecm_buffer.h>
 #include <spandsp/private/t38_gateway.h>
+#include <spandsp/private/t38_gateway_group.h>
 #include <spandsp/private/t38_terminal.h>
 #include <spandsp/private/t31.h>
 #include <spandsp/private/timezone.h>
@@ -102,6 +102,13 @@ SPAN_DECLARE(t30_state_t *) fax_get_t30_state(fax_state_t *s);
 */
 SPAN_DECLARE(logging_state_t *) fax_get_logging_state(fax_state_t *s);
 
+/*! Get the amount of memory a FAX context is using. This includes the memory counted by
+    t30_get_memory_usage() for the FAX context's T.30 context.
+    \brief Get the amount of memory a FAX context is using.
+    \param s The FAX context.
+    \return The number of bytes in use. */
+SPAN_DECLARE(int) fax_get_memory_usage(fax_state_t *s);
+
 /*! Restart a FAX context.
     \brief Restart a FAX context.
     \param s The FAX context.
@@ -47,6 +47,14 @@ enum
     FAX_MODEM_V29_RX
 };
 
+/*! The fast receivers which fax_modems_multi_rx() may run in parallel */
+enum
+{
+    FAX_MODEMS_MULTI_RX_V17 = 0x01,
+    FAX_MODEMS_MULTI_RX_V27TER = 0x02,
+    FAX_MODEMS_MULTI_RX_V29 = 0x04
+};
+
 /*!
     The set of modems needed for FAX, plus the auxilliary stuff, like tone generation.
 */
@@ -66,6 +74,49 @@ SPAN_DECLARE_NONSTD(int) fax_modems_v27ter_v21_rx_fillin(void *user_data, int le
 SPAN_DECLARE_NONSTD(int) fax_modems_v29_v21_rx_fillin(void *user_data, int len);
 SPAN_DECLARE(void) fax_modems_start_rx_modem(fax_modems_state_t *s, int which);
 
+/*! Receive audio with V.21 and any combination of the V.17, V.27ter and V.29
+    receivers in parallel. This is used when it is not known in advance which
+    fast modem the far end will use. A single carrier detector is shared by the
+    fast receivers, so they are only run when there is a signal which might be
+    a fast modem. Nothing else is shared. Each receiver has its own AGC, filters
+    and equalizer, so while there is signal the cost is the sum of running each
+    of the receivers alone. Whichever receiver trains first takes over the receive
+    path, and the others stop. Until then, the status reports of the fast receivers are not passed on. The
+    winner then reports training in progress, and training succeeded, through its
+    put_bit routine, followed by everything else it reports. If a burst of signal
+    ends with no receiver trained, they are all restarted ready for the next attempt.
+    \brief Receive audio with multiple fast modems in parallel.
+    \param user_data The FAX modems context.
+    \param amp The audio sample buffer.
+    \param len The number of samples in the buffer.
+    \return The number of samples unprocessed. */
+SPAN_DECLARE_NONSTD(int) fax_modems_multi_rx(void *user_data, const int16_t amp[], int len);
+
+/*! Fake processing of a missing block of received audio, while several fast
+    receivers are being run in parallel.
+    \brief Fake processing of a missing block of received audio.
+    \param user_data The FAX modems context.
+    \param len The number of samples to fake.
+    \return The number of samples unprocessed. */
+SPAN_DECLARE_NONSTD(int) fax_modems_multi_rx_fillin(void *user_data, int len);
+
+/*! Restart the V.17, V.27ter and V.29 receivers, ready for fax_modems_multi_rx(). The
+    put_bit routines of the receivers should be set first. The caller then makes
+    fax_modems_multi_rx(), with the FAX modems context as its user data, its receive
+    handler. When a receiver trains, the current receive handler of the FAX modems
+    context is switched to that receiver.
+    \brief Start receiving with multiple fast modems in parallel.
+    \param s The FAX modems context.
+    \param v17_bit_rate The bit rate for the V.17 receiver, or zero to not use V.17.
+    \param v27ter_bit_rate The bit rate for the V.27ter receiver, or zero to not use V.27ter.
+    \param v29_bit_rate The bit rate for the V.29 receiver, or zero to not use V.29.
+    \param short_train TRUE if the V.17 receiver should expect a short training sequence. */
+SPAN_DECLARE(void) fax_modems_start_multi_rx_modem(fax_modems_state_t *s,
+                                                   int v17_bit_rate,
+                                                   int v27ter_bit_rate,
+                                                   int v29_bit_rate,
+                                                   int short_train);
+
 SPAN_DECLARE(void) fax_modems_set_tep_mode(fax_modems_state_t *s, int use_tep);
 
 SPAN_DECLARE(int) fax_modems_restart(fax_modems_state_t *s);
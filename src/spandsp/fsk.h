@@ -60,7 +60,11 @@ one that matches the frequency being transmitted during the correlation
 interval. Because the transmission is totally asynchronous, the demodulation
 process must run sample by sample to find the symbol transitions. The
 correlation is performed on a sliding window basis, so the computational load of
-demodulating sample by sample is not great. 
+demodulating sample by sample is not great. The products of the signal and the
+oscillator outputs are calculated for a block of samples at a time, using SIMD
+instructions where they are available, and only the sliding window sums and the
+symbol timing are processed sample by sample. The bits produced do not depend on
+the size of the blocks of audio passed to the receiver.
 
 Two modes of symbol synchronisation are provided:
 
@@ -170,6 +174,16 @@ SPAN_DECLARE(void) fsk_tx_power(fsk_tx_state_t *s, float power);
 
 SPAN_DECLARE(void) fsk_tx_set_get_bit(fsk_tx_state_t *s, get_bit_func_t get_bit, void *user_data);
 
+/*! Set a get_bits function for an FSK modem transmit context. The data to be sent is then
+    taken from this function up to 16 bits at a time, using the user data given for the
+    get_bit function, instead of one bit at a time from the get_bit function. Setting a
+    new get_bit function cancels this.
+    \brief Set a get_bits function for an FSK modem transmit context.
+    \param s The modem context.
+    \param get_bits The callback routine used to get the data to be transmitted, or NULL
+           to go back to using the get_bit function. */
+SPAN_DECLARE(void) fsk_tx_set_get_bits(fsk_tx_state_t *s, get_bits_func_t get_bits);
+
 /*! Change the modem status report function associated with an FSK modem transmit context.
     \brief Change the modem status report function associated with an FSK modem transmit context.
     \param s The modem context.
@@ -238,6 +252,20 @@ SPAN_DECLARE_NONSTD(int) fsk_rx_fillin(fsk_rx_state_t *s, int len);
 
 SPAN_DECLARE(void) fsk_rx_set_put_bit(fsk_rx_state_t *s, put_bit_func_t put_bit, void *user_data);
 
+/*! Set a put_bits function for an FSK modem receive context. In the synchronous and
+    asynchronous modes, received data bits are then passed to this function up to 16 at
+    a time, using the user data given for the put_bit function, instead of one at a time
+    to the put_bit function. Framed mode still passes whole characters to the put_bit
+    function. Status changes are still reported through the put_bit function, or the
+    status handler, after any bits received before them have been passed on. Any bits
+    still waiting are passed on at the end of each call to fsk_rx(). Setting a new
+    put_bit function cancels this.
+    \brief Set a put_bits function for an FSK modem receive context.
+    \param s The modem context.
+    \param put_bits The callback routine used to handle received bits, or NULL to go
+           back to using the put_bit function. */
+SPAN_DECLARE(void) fsk_rx_set_put_bits(fsk_rx_state_t *s, put_bits_func_t put_bits);
+
 /*! Change the modem status report function associated with an FSK modem receive context.
     \brief Change the modem status report function associated with an FSK modem receive context.
     \param s The modem context.
@@ -95,6 +95,19 @@ SPAN_DECLARE(int) g722_encode_free(g722_encode_state_t *s);
     \return The number of bytes of G.722 data produced. */
 SPAN_DECLARE(int) g722_encode(g722_encode_state_t *s, uint8_t g722_data[], const int16_t amp[], int len);
 
+/*! Encode a buffer of linear PCM data to G.722 for each of a number of channels.
+    This is exactly the same as calling g722_encode() for each channel, and is a
+    convenience for applications which handle many channels in lock-step. The
+    channels may use different bit rates and options.
+    \param s The G.722 context for each channel.
+    \param g722_data The G.722 data produced for each channel.
+    \param amp The audio sample buffer for each channel.
+    \param len The number of samples in each channel's buffer.
+    \param g722_bytes The number of bytes of G.722 data produced for each channel.
+    \param channels The number of channels.
+    \return The number of channels processed. */
+SPAN_DECLARE(int) g722_encode_batch(g722_encode_state_t *s[], uint8_t *g722_data[], const int16_t *amp[], int len, int g722_bytes[], int channels);
+
 /*! Initialise an G.722 decode context.
     \param s The G.722 decode context.
     \param rate The bit rate of the G.722 data.
@@ -121,6 +134,19 @@ SPAN_DECLARE(int) g722_decode_free(g722_decode_state_t *s);
     \return The number of samples returned. */
 SPAN_DECLARE(int) g722_decode(g722_decode_state_t *s, int16_t amp[], const uint8_t g722_data[], int len);
 
+/*! Decode a buffer of G.722 data to linear PCM for each of a number of channels.
+    This is exactly the same as calling g722_decode() for each channel, and is a
+    convenience for applications which handle many channels in lock-step. The
+    channels may use different bit rates and options.
+    \param s The G.722 context for each channel.
+    \param amp The audio sample buffer for each channel.
+    \param g722_data The G.722 data for each channel.
+    \param len The number of bytes of G.722 data for each channel.
+    \param outlen The number of samples produced for each channel.
+    \param channels The number of channels.
+    \return The number of channels processed. */
+SPAN_DECLARE(int) g722_decode_batch(g722_decode_state_t *s[], int16_t *amp[], const uint8_t *g722_data[], int len, int outlen[], int channels);
+
 #if defined(__cplusplus)
 }
 #endif
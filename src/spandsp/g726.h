@@ -112,6 +112,42 @@ SPAN_DECLARE(int) g726_encode(g726_state_t *s,
                               const int16_t amp[],
                               int len);
 
+/*! Decode a buffer of G.726 ADPCM data for each of a number of channels. The
+    results are exactly the same as calling g726_decode() for each channel. Channels
+    using the same bit rate are decoded in parallel, so this is much faster when an
+    application handles many channels in lock-step. The channels may use different
+    bit rates, external codings and packings.
+    \param s The G.726 context for each channel.
+    \param amp The audio sample buffer for each channel.
+    \param g726_data The G.726 data for each channel.
+    \param g726_bytes The number of bytes of G.726 data for each channel.
+    \param samples The number of samples produced for each channel.
+    \param channels The number of channels.
+    \return The number of channels processed. */
+SPAN_DECLARE(int) g726_decode_batch(g726_state_t *s[],
+                                    int16_t *amp[],
+                                    const uint8_t *g726_data[],
+                                    int g726_bytes,
+                                    int samples[],
+                                    int channels);
+
+/*! Encode a buffer of linear PCM data to G.726 ADPCM for each of a number of
+    channels. The results are exactly the same as calling g726_encode() for each
+    channel. Channels using the same bit rate are encoded in parallel.
+    \param s The G.726 context for each channel.
+    \param g726_data The G.726 data produced for each channel.
+    \param amp The audio sample buffer for each channel.
+    \param len The number of samples in the buffer for each channel.
+    \param g726_bytes The number of bytes of G.726 data produced for each channel.
+    \param channels The number of channels.
+    \return The number of channels processed. */
+SPAN_DECLARE(int) g726_encode_batch(g726_state_t *s[],
+                                    uint8_t *g726_data[],
+                                    const int16_t *amp[],
+                                    int len,
+                                    int g726_bytes[],
+                                    int channels);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -107,6 +107,18 @@ SPAN_DECLARE(int) gsm0610_set_packing(gsm0610_state_t *s, int packing);
     \return The number of bytes of GSM 06.10 data produced. */
 SPAN_DECLARE(int) gsm0610_encode(gsm0610_state_t *s, uint8_t code[], const int16_t amp[], int len);
 
+/*! Encode a buffer of linear PCM data to GSM 06.10 for each of a number of channels.
+    Each channel is packed in its own context's packing mode, so the number of bytes
+    produced may differ from channel to channel.
+    \param s The GSM 06.10 context for each channel.
+    \param code The GSM 06.10 data produced for each channel.
+    \param amp The audio sample buffer for each channel.
+    \param len The number of samples in each channel's buffer.
+    \param bytes The number of bytes of GSM 06.10 data produced for each channel.
+    \param channels The number of channels.
+    \return The number of channels processed. */
+SPAN_DECLARE(int) gsm0610_encode_batch(gsm0610_state_t *s[], uint8_t *code[], const int16_t *amp[], int len, int bytes[], int channels);
+
 /*! Decode a buffer of GSM 06.10 data to linear PCM.
     \param s The GSM 06.10 context.
     \param amp The audio sample buffer.
@@ -115,6 +127,18 @@ SPAN_DECLARE(int) gsm0610_encode(gsm0610_state_t *s, uint8_t code[], const int16
     \return The number of samples returned. */
 SPAN_DECLARE(int) gsm0610_decode(gsm0610_state_t *s, int16_t amp[], const uint8_t code[], int len);
 
+/*! Decode a buffer of GSM 06.10 data to linear PCM for each of a number of channels.
+    The same number of bytes is decoded for every channel, so channels with different
+    packing modes must each be given a whole number of frames in their own format.
+    \param s The GSM 06.10 context for each channel.
+    \param amp The audio sample buffer for each channel.
+    \param code The GSM 06.10 data for each channel.
+    \param len The number of bytes of GSM 06.10 data for each channel.
+    \param samples The number of samples produced for each channel.
+    \param channels The number of channels.
+    \return The number of channels processed. */
+SPAN_DECLARE(int) gsm0610_decode_batch(gsm0610_state_t *s[], int16_t *amp[], const uint8_t *code[], int len, int samples[], int channels);
+
 SPAN_DECLARE(int) gsm0610_pack_none(uint8_t c[], const gsm0610_frame_t *s);
 
 /*! Pack a pair of GSM 06.10 frames in the format used for wave files (wave type 49).
@@ -154,6 +154,13 @@ SPAN_DECLARE(int) hdlc_rx_get_stats(hdlc_rx_state_t *s,
 */
 SPAN_DECLARE_NONSTD(void) hdlc_rx_put_bit(hdlc_rx_state_t *s, int new_bit);
 
+/*! \brief Put a chunk of bits to an HDLC receiver. This is a put_bits_func_t.
+    \param s A pointer to an HDLC receiver context.
+    \param bits The bits, right aligned, earliest in the most significant position.
+    \param nbits The number of bits.
+*/
+SPAN_DECLARE_NONSTD(void) hdlc_rx_put_bits(hdlc_rx_state_t *s, unsigned int bits, int nbits);
+
 /*! \brief Put a byte of data to an HDLC receiver.
     \param s A pointer to an HDLC receiver context.
     \param new_byte The byte of data.
@@ -234,6 +241,13 @@ SPAN_DECLARE_NONSTD(int) hdlc_tx_get_bit(hdlc_tx_state_t *s);
 */
 SPAN_DECLARE_NONSTD(int) hdlc_tx_get_byte(hdlc_tx_state_t *s);
 
+/*! \brief Get a chunk of bits for transmission. This is a get_bits_func_t.
+    \param s A pointer to an HDLC transmitter context.
+    \param bits The bits, right aligned, earliest in the most significant position.
+    \return The number of bits, or SIG_STATUS_END_OF_DATA.
+*/
+SPAN_DECLARE_NONSTD(int) hdlc_tx_get_bits(hdlc_tx_state_t *s, unsigned int *bits);
+
 /*! \brief Get the next sequence of bytes for transmission.
     \param s A pointer to an HDLC transmitter context.
     \param buf The buffer for the data.
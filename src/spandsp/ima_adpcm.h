@@ -107,6 +107,41 @@ SPAN_DECLARE(int) ima_adpcm_decode(ima_adpcm_state_t *s,
                                    const uint8_t ima_data[],
                                    int ima_bytes);
 
+/*! Encode a buffer of linear PCM data to IMA ADPCM for each of a number of channels.
+    The results are exactly the same as calling ima_adpcm_encode() for each channel.
+    Channels using the same variant and chunking are stepped through together, which
+    is much faster when an application handles many channels in lock-step.
+    \param s The IMA ADPCM context for each channel.
+    \param ima_data The IMA ADPCM data produced for each channel.
+    \param amp The audio sample buffer for each channel.
+    \param len The number of samples in the buffer for each channel.
+    \param ima_bytes The number of bytes of IMA ADPCM data produced for each channel.
+    \param channels The number of channels.
+    \return The number of channels processed. */
+SPAN_DECLARE(int) ima_adpcm_encode_batch(ima_adpcm_state_t *s[],
+                                         uint8_t *ima_data[],
+                                         const int16_t *amp[],
+                                         int len,
+                                         int ima_bytes[],
+                                         int channels);
+
+/*! Decode a buffer of IMA ADPCM data to linear PCM for each of a number of channels.
+    The results are exactly the same as calling ima_adpcm_decode() for each channel.
+    Channels using the same variant and chunking are stepped through together.
+    \param s The IMA ADPCM context for each channel.
+    \param amp The audio sample buffer for each channel.
+    \param ima_data The IMA ADPCM data for each channel.
+    \param ima_bytes The number of bytes of IMA ADPCM data for each channel.
+    \param samples The number of samples produced for each channel.
+    \param channels The number of channels.
+    \return The number of channels processed. */
+SPAN_DECLARE(int) ima_adpcm_decode_batch(ima_adpcm_state_t *s[],
+                                         int16_t *amp[],
+                                         const uint8_t *ima_data[],
+                                         int ima_bytes,
+                                         int samples[],
+                                         int channels);
+
 #if defined(__cplusplus)
 }
 #endif
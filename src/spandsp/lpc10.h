@@ -90,6 +90,19 @@ SPAN_DECLARE(int) lpc10_encode_free(lpc10_encode_state_t *s);
     \return The number of bytes of LPC10e data produced. */
 SPAN_DECLARE(int) lpc10_encode(lpc10_encode_state_t *s, uint8_t code[], const int16_t amp[], int len);
 
+/*! Encode a buffer of linear PCM data to LPC10e for each of a number of channels.
+    Every channel is given the same number of samples, and each 180 sample frame
+    produces 7 bytes.
+    \param s The LPC10e context for each channel.
+    \param code The LPC10e data produced for each channel.
+    \param amp The audio sample buffer for each channel.
+    \param len The number of samples in each channel's buffer. This must be a multiple
+           of 180, as this is the number of samples on a frame.
+    \param bytes The number of bytes of LPC10e data produced for each channel.
+    \param channels The number of channels.
+    \return The number of channels processed. */
+SPAN_DECLARE(int) lpc10_encode_batch(lpc10_encode_state_t *s[], uint8_t *code[], const int16_t *amp[], int len, int bytes[], int channels);
+
 /*! Initialise an LPC10e decode context.
     \param s The LPC10e context
     \param error_correction ???
@@ -109,6 +122,19 @@ SPAN_DECLARE(int) lpc10_decode_free(lpc10_decode_state_t *s);
     \return The number of samples returned. */
 SPAN_DECLARE(int) lpc10_decode(lpc10_decode_state_t *s, int16_t amp[], const uint8_t code[], int len);
 
+/*! Decode a buffer of LPC10e data to linear PCM for each of a number of channels.
+    Every channel is given the same number of bytes, and each 7 byte frame produces
+    180 samples.
+    \param s The LPC10e context for each channel.
+    \param amp The audio sample buffer for each channel.
+    \param code The LPC10e data for each channel.
+    \param len The number of bytes of LPC10e data for each channel. This must be a
+           multiple of 7, as each frame is packed into 7 bytes.
+    \param samples The number of samples produced for each channel.
+    \param channels The number of channels.
+    \return The number of channels processed. */
+SPAN_DECLARE(int) lpc10_decode_batch(lpc10_decode_state_t *s[], int16_t *amp[], const uint8_t *code[], int len, int samples[], int channels);
+
 
 #if defined(__cplusplus)
 }
@@ -94,6 +94,41 @@ SPAN_DECLARE(int) oki_adpcm_encode(oki_adpcm_state_t *s,
                                    const int16_t amp[],
                                    int len);
 
+/*! Encode a buffer of linear PCM data to Oki ADPCM for each of a number of channels.
+    The results are exactly the same as calling oki_adpcm_encode() for each channel.
+    32kbps channels are stepped through together, which is much faster when an
+    application handles many channels in lock-step.
+    \param s The Oki ADPCM context for each channel.
+    \param oki_data The Oki ADPCM data produced for each channel.
+    \param amp The audio sample buffer for each channel.
+    \param len The number of samples in the buffer for each channel.
+    \param oki_bytes The number of bytes of Oki ADPCM data produced for each channel.
+    \param channels The number of channels.
+    \return The number of channels processed. */
+SPAN_DECLARE(int) oki_adpcm_encode_batch(oki_adpcm_state_t *s[],
+                                         uint8_t *oki_data[],
+                                         const int16_t *amp[],
+                                         int len,
+                                         int oki_bytes[],
+                                         int channels);
+
+/*! Decode a buffer of Oki ADPCM data to linear PCM for each of a number of channels.
+    The results are exactly the same as calling oki_adpcm_decode() for each channel.
+    32kbps channels are stepped through together.
+    \param s The Oki ADPCM context for each channel.
+    \param amp The audio sample buffer for each channel.
+    \param oki_data The Oki ADPCM data for each channel.
+    \param oki_bytes The number of bytes of Oki ADPCM data for each channel.
+    \param samples The number of samples produced for each channel.
+    \param channels The number of channels.
+    \return The number of channels processed. */
+SPAN_DECLARE(int) oki_adpcm_decode_batch(oki_adpcm_state_t *s[],
+                                         int16_t *amp[],
+                                         const uint8_t *oki_data[],
+                                         int oki_bytes,
+                                         int samples[],
+                                         int channels);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -36,6 +36,23 @@ Dynamic buffers are generally good for speech, since they adapt to provide the s
 consistent with a low rate of packets arriving too late to be used. For things like FoIP and
 MoIP, a static length of buffer is normally necessary. Any attempt to elastically change the
 buffer length would wreck a modem's data flow.
+
+\section playout_page_sec_2 Adaptive audio play-out
+For speech which has already been decoded to linear audio, the adaptive audio play-out
+functions provide a complete jitter buffer. Rather than inserting or dropping whole
+frames, they change the length of the buffer smoothly, by passing the audio through
+time scaling only while its length needs to change. Gaps due to lost or late frames
+are filled by packet loss concealment.
+
+The length of the buffer is steered towards a target, which is the delay needed for
+a high percentile of recent frames to arrive in time. The time each frame spends in
+transit is noted, and the target is the spread of those transit times, above the
+quickest one, which covers PLAYOUT_AUDIO_JITTER_PERCENTILE percent of the last
+PLAYOUT_AUDIO_JITTER_WINDOW frames. When the buffer is well above this target it is
+played out a little faster, and when it is well below it is played out a little slower,
+until the target is reached. If the buffer runs dry while it is shorter than the target,
+the output is filled, without moving on through the stream, so the buffer grows right
+away.
 */
 
 /* Return codes */
@@ -131,6 +148,19 @@ typedef struct
     int actual_buffer_length;
 } playout_state_t;
 
+/*! The number of recent frames whose transit times set the target length of an
+    adaptive audio play-out buffer. */
+#define PLAYOUT_AUDIO_JITTER_WINDOW     256
+/*! The percentage of recent frames an adaptive audio play-out buffer aims to have
+    arrive in time. */
+#define PLAYOUT_AUDIO_JITTER_PERCENTILE 98
+
+/*!
+    Adaptive audio play-out descriptor. This defines the working state for a
+    single instance of adaptive play-out buffering of linear audio.
+*/
+typedef struct playout_audio_state_s playout_audio_state_t;
+
 #if defined(__cplusplus)
 extern "C"
 {
@@ -206,6 +236,60 @@ SPAN_DECLARE(int) playout_release(playout_state_t *s);
     \return 0 if OK, else -1 */
 SPAN_DECLARE(int) playout_free(playout_state_t *s);
 
+/*! Queue a frame of audio for adaptive play-out.
+    \param s The adaptive audio play-out context.
+    \param amp The audio samples of the frame.
+    \param len The number of samples in the frame.
+    \param sender_stamp Sending end's time stamp, in samples.
+    \param receiver_stamp Local time at which the frame was received, in samples.
+    \return One of
+        PLAYOUT_OK:  Frame queued OK.
+        PLAYOUT_DROP: The frame arrived too late to be used.
+        PLAYOUT_ERROR: The frame is not a usable length. */
+SPAN_DECLARE(int) playout_audio_put(playout_audio_state_t *s, const int16_t amp[], int len, timestamp_t sender_stamp, timestamp_t receiver_stamp);
+
+/*! Get the next block of audio from an adaptive play-out buffer. Before the first frame
+    has been queued the output is silence.
+    \param s The adaptive audio play-out context.
+    \param amp The buffer for the audio samples.
+    \param len The number of samples required. This may be up to 1/10th of a second
+           of audio.
+    \param now Local time at which the audio is to be played, in samples.
+    \return The number of samples returned, which is len, or -1 for a bad length. */
+SPAN_DECLARE(int) playout_audio_get(playout_audio_state_t *s, int16_t amp[], int len, timestamp_t now);
+
+/*! Find the current length of an adaptive audio play-out buffer. This is the time the
+    quickest recent frames spend in the buffer, including audio already taken from
+    the buffer but not yet returned by playout_audio_get().
+    \param s The adaptive audio play-out context.
+    \param now Local time, in samples.
+    \return The length of the buffer, in samples. */
+SPAN_DECLARE(timestamp_t) playout_audio_current_length(playout_audio_state_t *s, timestamp_t now);
+
+/*! Find the length an adaptive audio play-out buffer is aiming for.
+    \param s The adaptive audio play-out context.
+    \return The target length of the buffer, in samples. */
+SPAN_DECLARE(timestamp_t) playout_audio_target_length(playout_audio_state_t *s);
+
+/*! Initialise an instance of adaptive audio play-out buffering.
+    \param s The adaptive audio play-out context. If this is NULL, a context is allocated.
+    \param sample_rate The sample rate of the audio. Packet loss concealment is designed
+           for 8000 samples/second.
+    \param min_length Minimum length of the buffer, in samples.
+    \param max_length Maximum length of the buffer, in samples.
+    \return A pointer to the context, or NULL if there was a problem. */
+SPAN_DECLARE(playout_audio_state_t *) playout_audio_init(playout_audio_state_t *s, int sample_rate, int min_length, int max_length);
+
+/*! Release an instance of adaptive audio play-out buffering.
+    \param s The adaptive audio play-out context.
+    \return 0 if OK, else -1 */
+SPAN_DECLARE(int) playout_audio_release(playout_audio_state_t *s);
+
+/*! Free an instance of adaptive audio play-out buffering.
+    \param s The adaptive audio play-out context.
+    \return 0 if OK, else -1 */
+SPAN_DECLARE(int) playout_audio_free(playout_audio_state_t *s);
+
 #if defined(__cplusplus)
 }
 #endif
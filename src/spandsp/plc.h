@@ -52,10 +52,14 @@ of music a much slower decay on bursts of lost packets give better results.
 
 \section plc_page_sec_2 How does it work?
 While good packets are being received, the plc_rx() routine keeps a record of the trailing
-section of the known speech signal. If a packet is missed, plc_fillin() is called to produce
-a synthetic replacement for the real speech signal. The average mean difference function
-(AMDF) is applied to the last known good signal, to determine its effective pitch.
-Based on this, the last pitch period of signal is saved. Essentially, this cycle of speech
+section of the known speech signal. The average mean difference function (AMDF) is applied
+to this after each packet, to track its effective pitch. Each packet, the AMDF is only
+evaluated for a few lags close to the last pitch, and a few lags of a coarse sweep of the
+whole pitch range, which catches the pitch jumping to a new value. Doing this as the packets arrive,
+rather than when one is lost, keeps the cost of the first packet of a gap close to the cost
+of any other. If a packet is missed, plc_fillin() is called to produce a synthetic
+replacement for the real speech signal. Based on the last known pitch, the last pitch period
+of signal is saved. Essentially, this cycle of speech
 will be repeated over and over until the real speech resumes. However, several refinements
 are needed to obtain smooth pleasant sounding results.
 
@@ -90,7 +94,9 @@ concealer. For each received audio packet that is acceptable (i.e. not including
 dropped for being too late) call plc_rx() to record the content of the packet. Note this may
 modify the packet a little after a period of packet loss, to blend real synthetic data smoothly.
 When a real packet is not available in time, call plc_fillin() to create a sythetic substitute.
-That's it!
+That's it! An application handling many channels in step, such as a conference mixer, may
+use plc_rx_batch() and plc_fillin_batch() to process a block for each of a group of channels
+in one call.
 */
 
 /*! Minimum allowed pitch (66 Hz) */
@@ -107,7 +113,8 @@ That's it!
 #define PLC_HISTORY_LEN         (CORRELATION_SPAN + PLC_PITCH_MIN)
 
 /*!
-    The generic packet loss concealer context.
+    The generic packet loss concealer context. Applications may allocate this
+    themselves, so any change to its layout changes the library's ABI.
 */
 typedef struct
 {
@@ -117,6 +124,8 @@ typedef struct
     int pitch_offset;
     /*! Pitch estimate */
     int pitch;
+    /*! The offset, from PLC_PITCH_MAX, of the next lags of the coarse pitch sweep */
+    int pitch_sweep;
     /*! Buffer for a cycle of speech */
     float pitchbuf[PLC_PITCH_MIN];
     /*! History buffer */
@@ -147,6 +156,24 @@ SPAN_DECLARE(int) plc_rx(plc_state_t *s, int16_t amp[], int len);
     \return The number of samples synthesized. */
 SPAN_DECLARE(int) plc_fillin(plc_state_t *s, int16_t amp[], int len);
 
+/*! Process a block of received audio samples for PLC, for each of a number of channels.
+    \brief Process a block of received audio samples for PLC, for many channels.
+    \param s The packet loss concealer context for each channel.
+    \param amp The audio sample buffer for each channel.
+    \param len The number of samples in each buffer.
+    \param channels The number of channels.
+    \return The number of channels processed. */
+SPAN_DECLARE(int) plc_rx_batch(plc_state_t *s[], int16_t *amp[], int len, int channels);
+
+/*! Fill-in a block of missing audio samples, for each of a number of channels.
+    \brief Fill-in a block of missing audio samples, for many channels.
+    \param s The packet loss concealer context for each channel.
+    \param amp The audio sample buffer for each channel.
+    \param len The number of samples to be synthesised for each channel.
+    \param channels The number of channels.
+    \return The number of channels processed. */
+SPAN_DECLARE(int) plc_fillin_batch(plc_state_t *s[], int16_t *amp[], int len, int channels);
+
 /*! Initialise a packet loss concealer context.
     \brief Initialise a PLC context.
     \param s The packet loss concealer context.
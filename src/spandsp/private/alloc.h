@@ -0,0 +1,51 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * private/alloc.h - Memory allocation for the library, with a replaceable
+ *                   allocator, and optional arenas.
+ *
+ * Written by Steve Underwood <steveu@coppice.org>
+ *
+ * Copyright (C) 2010 Steve Underwood
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#if !defined(_SPANDSP_PRIVATE_ALLOC_H_)
+#define _SPANDSP_PRIVATE_ALLOC_H_
+
+/*!
+    Memory arena context.
+*/
+struct span_arena_s
+{
+    /*! The memory of the arena */
+    uint8_t *buf;
+    /*! The size of the arena */
+    size_t len;
+    /*! The number of bytes in use, from the start of buf */
+    size_t used;
+    /*! The largest number of bytes which have been in use */
+    size_t peak;
+    /*! The offset of the header of the most recent allocation, or (size_t) -1 if it
+        has been freed */
+    size_t last;
+    /*! TRUE if buf was allocated by span_arena_init() */
+    int buf_allocated;
+};
+
+#endif
+/*- End of file ------------------------------------------------------------*/
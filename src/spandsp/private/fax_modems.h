@@ -91,6 +91,26 @@ struct fax_modems_state_s
     /*! \brief TRUE if an HDLC frame has been received correctly. */
     int rx_frame_received;
 
+    /*! \brief The bit rates at which the V.17, V.27ter and V.29 receivers are tried
+               by fax_modems_multi_rx(). Zero if a receiver is not to be tried. */
+    int multi_rx_bit_rate[3];
+    /*! \brief TRUE if the V.17 receiver should expect a short training sequence. */
+    int multi_rx_short_train;
+    /*! \brief The fast receivers still in the running, as FAX_MODEMS_MULTI_RX_xxx bits. */
+    int multi_rx_candidates;
+    /*! \brief The fast receiver which has trained, as a FAX_MODEMS_MULTI_RX_xxx bit, or
+               zero if none has trained yet. */
+    int multi_rx_trained;
+    /*! \brief The carrier detector shared by the fast receivers. */
+    power_meter_t multi_rx_power;
+    /*! \brief The power above which the shared carrier detector sees a signal. */
+    int32_t multi_rx_carrier_on_power;
+    /*! \brief Samples remaining before the fast receivers stop being run, after the
+               signal falls. */
+    int multi_rx_hangover;
+    /*! \brief TRUE if the fast receivers are currently being run. */
+    int multi_rx_active;
+
     /*! The current receive signal handler */
     span_rx_handler_t *rx_handler;
     /*! The current receive missing signal fill-in handler */
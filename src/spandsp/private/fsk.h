@@ -37,6 +37,13 @@ struct fsk_tx_state_s
     get_bit_func_t get_bit;
     /*! \brief A user specified opaque pointer passed to the get_bit function. */
     void *get_bit_user_data;
+    /*! \brief An optional callback function used to get the bits to be transmitted in
+               chunks, in place of get_bit. */
+    get_bits_func_t get_bits;
+    /*! \brief The bits from get_bits still to be sent. */
+    unsigned int bit_chunk;
+    /*! \brief The number of bits in bit_chunk. */
+    int bit_chunk_len;
 
     /*! \brief The callback function used to report modem status changes. */
     modem_tx_status_func_t status_handler;
@@ -64,6 +71,13 @@ struct fsk_rx_state_s
     put_bit_func_t put_bit;
     /*! \brief A user specified opaque pointer passed to the put_bit routine. */
     void *put_bit_user_data;
+    /*! \brief An optional callback function used to put the received bits in chunks,
+               in place of put_bit. This is not used in framed mode. */
+    put_bits_func_t put_bits;
+    /*! \brief The received bits waiting to be passed to put_bits. */
+    unsigned int bit_chunk;
+    /*! \brief The number of bits in bit_chunk. */
+    int bit_chunk_len;
 
     /*! \brief The callback function used to report modem status changes. */
     modem_tx_status_func_t status_handler;
@@ -64,10 +64,9 @@ struct g722_encode_state_s
     /*! 6 for 48000kbps, 7 for 56000kbps, or 8 for 64000kbps. */
     int bits_per_sample;
 
-    /*! Signal history for the QMF */
+    /*! Signal history for the QMF, oldest first */
     int16_t x[12];
     int16_t y[12];
-    int ptr;
 
     g722_band_t band[2];
 
@@ -92,10 +91,9 @@ struct g722_decode_state_s
     /*! 6 for 48000kbps, 7 for 56000kbps, or 8 for 64000kbps. */
     int bits_per_sample;
 
-    /*! Signal history for the QMF */
+    /*! Signal history for the QMF, oldest first */
     int16_t x[12];
     int16_t y[12];
-    int ptr;
 
     g722_band_t band[2];
     
@@ -0,0 +1,101 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * private/playout.h
+ *
+ * Written by Steve Underwood <steveu@coppice.org>
+ *
+ * Copyright (C) 2005 Steve Underwood
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#if !defined(_SPANDSP_PRIVATE_PLAYOUT_H_)
+#define _SPANDSP_PRIVATE_PLAYOUT_H_
+
+/*!
+    Adaptive audio play-out descriptor.
+*/
+struct playout_audio_state_s
+{
+    /*! The sample rate of the audio */
+    int sample_rate;
+    /*! The minimum length of the buffer, in samples */
+    int min_length;
+    /*! The maximum length of the buffer, in samples */
+    int max_length;
+    /*! The largest block which may be requested from the buffer, in samples */
+    int max_block;
+
+    /*! The received audio, indexed by the sender's time stamp */
+    int16_t *ring;
+    /*! TRUE for each sample of the ring which holds received audio not yet played */
+    uint8_t *valid;
+    /*! The length of the ring, which is a power of 2 */
+    int ring_len;
+
+    /*! Audio taken from the ring, waiting to be output */
+    int16_t *fifo;
+    /*! The number of samples in the output FIFO */
+    int fifo_fill;
+    /*! A block of audio taken from the ring, on its way to time scaling */
+    int16_t *scratch;
+
+    /*! TRUE once the first frame has been received */
+    int started;
+    /*! The sender's time stamp of the next sample to be taken from the ring */
+    timestamp_t play_stamp;
+    /*! The sender's time stamp just after the latest audio received */
+    timestamp_t latest_stamp;
+
+    /*! The transit times of recent frames */
+    timestamp_t transit[PLAYOUT_AUDIO_JITTER_WINDOW];
+    /*! The next entry in the transit times to be replaced */
+    int transit_ptr;
+    /*! The number of valid entries in the transit times */
+    int transit_entries;
+    /*! The quickest recent transit time */
+    timestamp_t min_transit;
+    /*! The width of each bin of the transit time histogram, in samples */
+    int bin_width;
+    /*! The current target length of the buffer */
+    timestamp_t target_length;
+    /*! The amount the buffer must stray from its target before its length is changed */
+    int threshold;
+
+    /*! Zero while the audio is passed straight through. Otherwise -1 while it is being
+        played out faster, to shrink the buffer, or 1 while it is being played out slower,
+        to grow it. */
+    int scaling;
+    /*! The time scaling context */
+    time_scale_state_t time_scale;
+    /*! The packet loss concealment context */
+    plc_state_t plc;
+
+    /*! The total frames input to the buffer, to date. */
+    int frames_in;
+    /*! The number of frames which were discarded, due to late arrival. */
+    int frames_late;
+    /*! The number of times the stream jumped, and the buffer started again. */
+    int restarts;
+    /*! The number of samples concealed, for audio which never arrived in time. */
+    int samples_concealed;
+    /*! The number of samples of concealment inserted to grow the buffer. */
+    int samples_inserted;
+};
+
+#endif
+/*- End of file ------------------------------------------------------------*/
@@ -234,8 +234,11 @@ struct t30_state_s
     int receiver_not_ready_count;
     /*! \brief The number of octets to be used per ECM frame. */
     int octets_per_ecm_frame;
-    /*! \brief The ECM partial page buffer. */
-    uint8_t ecm_data[256][260];
+    /*! \brief The ECM partial page buffer, of 256 frames. This is only held while ECM is in
+               use, and comes from a pool shared by all T.30 contexts. */
+    uint8_t *ecm_data;
+    /*! \brief The spacing of the frames in the ECM partial page buffer, in octets. */
+    int ecm_frame_stride;
     /*! \brief The lengths of the frames in the ECM partial page buffer. */
     int16_t ecm_len[256];
     /*! \brief A bit map of the OK ECM frames, constructed as a PPR frame. */
@@ -261,12 +264,12 @@ struct t30_state_s
     int next_tx_step;
     /*! \brief The FCF for the next receive step. */
     uint8_t next_rx_step;
-    /*! \brief Image file name for image reception. */
-    char rx_file[256];
+    /*! \brief Image file name for image reception, or NULL. */
+    char *rx_file;
     /*! \brief The last page we are prepared accept for a received image file. -1 means no restriction. */
     int rx_stop_page;
-    /*! \brief Image file name to be sent. */
-    char tx_file[256];
+    /*! \brief Image file name to be sent, or NULL. */
+    char *tx_file;
     /*! \brief The first page to be sent from the image file. -1 means no restriction. */
     int tx_start_page;
     /*! \brief The last page to be sent from the image file. -1 means no restriction. */
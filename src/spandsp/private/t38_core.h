@@ -121,6 +121,19 @@ struct t38_core_state_s
     /*! \brief The bit rate for V.34 operation */
     int v34_rate;
 
+    /*! \brief The buffer transmitted packets are built in, while batching */
+    uint8_t *tx_batch_buf;
+    /*! \brief The length of the batch buffer */
+    int tx_batch_buf_len;
+    /*! \brief The number of bytes of the batch buffer used */
+    int tx_batch_buf_ptr;
+    /*! \brief The list of batched packets, or NULL when not batching */
+    t38_ifp_packet_t *tx_batch_pkt;
+    /*! \brief The maximum number of packets in the batch */
+    int tx_batch_max_packets;
+    /*! \brief The number of packets in the batch */
+    int tx_batch_packets;
+
     /*! A count of missing receive packets. This count might not be accurate if the
         received packet numbers jump wildly. */
     int missing_packets;
@@ -57,8 +57,32 @@ typedef struct
 */
 typedef struct
 {
-    /*! \brief The FAX modem set for the audio side fo the gateway. */
-    fax_modems_state_t modems;
+    /*! \brief The FAX modem set for the audio side of the gateway. In lazy mode this is
+               NULL until a FAX signal is seen, on either side of the gateway. */
+    fax_modems_state_t *modems;
+    /*! \brief TRUE until a FAX signal has been seen on either side of the gateway. */
+    int voice_phase;
+    /*! \brief A CNG detector, used in the voice phase while there are no modems. */
+    modem_connect_tones_rx_state_t cng_rx;
+    /*! \brief A CED or V.21 preamble detector, used in the voice phase while there are
+               no modems. */
+    modem_connect_tones_rx_state_t ced_rx;
+    /*! \brief The mean power per sample below which the voice phase detectors are not run. */
+    int32_t voice_phase_min_power;
+    /*! \brief Goertzel filters at 1100Hz, 2100Hz, 1650Hz and 1850Hz, which screen the
+               voice phase audio for CNG, CED and V.21 channel 2 signals. */
+    goertzel_state_t screen[4];
+    /*! \brief The energy of the voice phase audio screened so far in the current block. */
+    int64_t screen_energy;
+    /*! \brief The number of samples screened so far in the current block. */
+    int screen_samples;
+    /*! \brief TRUE if the last block screened might hold a FAX signal, so the voice
+               phase detectors are running. */
+    int screen_passed;
+    /*! \brief TRUE if talker echo protection should be sent for the image modems. */
+    int use_tep;
+    /*! \brief TRUE if silence should be sent when there is nothing else to send. */
+    int transmit_on_idle;
     /*! \brief The current receive signal handler. Actual receiving hops between this
                and a dummy receive routine. */
     span_rx_handler_t *base_rx_handler;
@@ -82,6 +106,11 @@ typedef struct
     int bits_absorbed;
     /*! \brief The current bit number in the current non-ECM octet. */
     int bit_no;
+    /*! \brief The bits from the modem not yet checked for fill, when fill bits are being
+               removed. These are checked an octet at a time. */
+    unsigned int raw_bit_stream;
+    /*! \brief The number of bits in raw_bit_stream. */
+    int raw_bit_no;
     /*! \brief Progressively calculated CRC for HDLC messages received from a modem. */
     uint16_t crc;
     /*! \brief TRUE if non-ECM fill bits are to be stripped when sending image data. */
@@ -116,8 +145,9 @@ typedef struct
 */
 typedef struct
 {
-    /*! \brief HDLC message buffers. */
-    t38_gateway_hdlc_buf_t buf[T38_TX_HDLC_BUFS];
+    /*! \brief HDLC message buffers. There are T38_TX_HDLC_BUFS of them, allocated along
+               with the FAX modems. */
+    t38_gateway_hdlc_buf_t *buf;
 #if 0
     /*! \brief HDLC message buffers. */
     uint8_t buf[T38_TX_HDLC_BUFS][T38_MAX_HDLC_LEN];
@@ -178,8 +208,9 @@ typedef struct
     t38_gateway_to_t38_state_t to_t38;
     /*! Buffer for data going to an HDLC modem. */
     t38_gateway_hdlc_state_t hdlc_to_modem;
-    /*! Buffer for data going to a non-ECM mode modem. */
-    t38_non_ecm_buffer_state_t non_ecm_to_modem;
+    /*! Buffer for data going to a non-ECM mode modem. This is allocated along with the
+        FAX modems. */
+    t38_non_ecm_buffer_state_t *non_ecm_to_modem;
 
     /*! \brief A pointer to a callback routine to be called when frames are
         exchanged. */
@@ -0,0 +1,100 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * private/t38_gateway_group.h - A driver for a group of T.38 gateway sessions,
+ *                               processed together each audio tick.
+ *
+ * Written by Steve Underwood <steveu@coppice.org>
+ *
+ * Copyright (C) 2010 Steve Underwood
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#if !defined(_SPANDSP_PRIVATE_T38_GATEWAY_GROUP_H_)
+#define _SPANDSP_PRIVATE_T38_GATEWAY_GROUP_H_
+
+/*!
+    A session of a T.38 gateway session group.
+*/
+typedef struct
+{
+    /*! The session's gateway */
+    t38_gateway_state_t gateway;
+    /*! The group the session belongs to */
+    t38_gateway_group_state_t *group;
+    /*! The session number */
+    int session;
+    /*! The destination for the session's T.38 packets, or -1 if the slot is not in use */
+    int dest;
+} t38_gateway_group_session_t;
+
+/*!
+    T.38 gateway session group context.
+*/
+struct t38_gateway_group_state_s
+{
+    /*! The number of session slots */
+    int max_sessions;
+    /*! The number of destinations */
+    int max_destinations;
+    /*! The session slots */
+    t38_gateway_group_session_t *sessions;
+    /*! The number of sessions in use */
+    int active_sessions;
+    /*! The free session slots, as a stack */
+    int *free_slots;
+    /*! The number of free session slots */
+    int free_count;
+
+    /*! The handler for the T.38 packets for each destination */
+    t38_gateway_group_tx_handler_t *tx_handler;
+    /*! An opaque pointer passed to tx_handler */
+    void *tx_user_data;
+
+    /*! Storage for the contents of the waiting T.38 packets */
+    uint8_t *tx_buf;
+    /*! The size of tx_buf */
+    int tx_buf_size;
+    /*! The amount of tx_buf in use */
+    int tx_buf_used;
+    /*! The waiting T.38 packets, in the order they were produced */
+    t38_gateway_group_packet_t *tx_queue;
+    /*! The destination of each waiting T.38 packet */
+    int *tx_queue_dest;
+    /*! The most T.38 packets which can wait */
+    int tx_queue_size;
+    /*! The number of T.38 packets waiting */
+    int tx_queue_len;
+    /*! The waiting T.38 packets, sorted by destination */
+    t38_gateway_group_packet_t *tx_sorted;
+    /*! The number of waiting packets for each destination, and then the place in
+        tx_sorted of the next one */
+    int *dest_count;
+    /*! The destinations which have packets waiting */
+    int *dest_list;
+    /*! The number of destinations which have packets waiting */
+    int dest_list_len;
+
+    /*! The CPU core the driving thread was pinned to, or -1 */
+    int cpu;
+
+    /*! \brief Error and flow logging control */
+    logging_state_t logging;
+};
+
+#endif
+/*- End of file ------------------------------------------------------------*/
@@ -83,6 +83,8 @@ struct t4_state_s
     uint32_t *cur_runs;
     /*! \brief Black and white run-lengths for the reference row. */
     uint32_t *ref_runs;
+    /*! \brief The size of each of the run-length buffers, in bytes. */
+    int run_space;
     /*! \brief Pointer to the buffer for the current pixel row. */
     uint8_t *row_buf;
 
@@ -43,6 +43,7 @@ struct time_scale_state_s
     double rate_nudge;
     int fill;
     int lcp;
+    int pitch;
     int16_t buf[TIME_SCALE_BUF_LEN];
 };
 
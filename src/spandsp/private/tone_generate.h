@@ -62,5 +62,23 @@ struct tone_gen_state_s
     int current_position;
 };
 
+/*!
+    Shared cadenced tone source. One generator renders a frame at a time, and
+    any number of channels read the same frame.
+*/
+struct tone_gen_shared_s
+{
+    /*! The generator which renders the frames */
+    tone_gen_state_t gen;
+    /*! The most recently rendered frame */
+    int16_t *frame;
+    /*! The length of a frame, in samples */
+    int frame_len;
+    /*! The number of samples of tone in the most recently rendered frame */
+    int len;
+    /*! The number of channels currently subscribed */
+    int subscribers;
+};
+
 #endif
 /*- End of file ------------------------------------------------------------*/
@@ -0,0 +1,58 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * private/transcode.h - Offline transcoding of recorded audio between the
+ *                       speech codecs, using a pool of worker threads.
+ *
+ * Written by Steve Underwood <steveu@coppice.org>
+ *
+ * Copyright (C) 2010 Steve Underwood
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#if !defined(_SPANDSP_PRIVATE_TRANSCODE_H_)
+#define _SPANDSP_PRIVATE_TRANSCODE_H_
+
+/*!
+    Transcoding job descriptor.
+*/
+struct transcode_job_s
+{
+    /*! The format of the input data */
+    transcode_format_t in_format;
+    /*! The format of the output data */
+    transcode_format_t out_format;
+    /*! The input data */
+    const uint8_t *in;
+    /*! The length of the input data, in bytes */
+    int in_len;
+    /*! The output buffer */
+    uint8_t *out;
+    /*! The size of the output buffer, in bytes */
+    int out_max;
+    /*! The number of bytes of output produced */
+    int out_len;
+    /*! The duration of the audio converted, in 1/8000ths of a second */
+    int duration;
+    /*! The status of the job */
+    int status;
+    /*! The number of segments of the job which the worker pool has yet to finish */
+    int segments_pending;
+};
+
+#endif
+/*- End of file ------------------------------------------------------------*/
@@ -0,0 +1,107 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * private/udptl.h - An implementation of the UDPTL protocol defined in T.38,
+ *                   less the packet exchange part
+ *
+ * Written by Steve Underwood <steveu@coppice.org>
+ *
+ * Copyright (C) 2009 Steve Underwood
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#if !defined(_SPANDSP_PRIVATE_UDPTL_H_)
+#define _SPANDSP_PRIVATE_UDPTL_H_
+
+/*! A transmitted IFP packet, kept for building the error recovery information of later packets */
+typedef struct
+{
+    /*! The length of the packet, or -1 for an empty slot */
+    int buf_len;
+    /*! The packet */
+    uint8_t buf[UDPTL_MAX_DATAGRAM];
+} udptl_fec_tx_buffer_t;
+
+/*! A received IFP packet, and the FEC information which came with it */
+typedef struct
+{
+    /*! The length of the packet, or -1 where the packet is missing */
+    int buf_len;
+    /*! The packet */
+    uint8_t buf[UDPTL_MAX_DATAGRAM];
+    /*! The lengths of the FEC entries */
+    int fec_len[UDPTL_MAX_FEC_ENTRIES];
+    /*! The FEC entries */
+    uint8_t fec[UDPTL_MAX_FEC_ENTRIES][UDPTL_MAX_DATAGRAM];
+    /*! The span of the FEC entries */
+    int fec_span;
+    /*! The number of FEC entries */
+    int fec_entries;
+} udptl_fec_rx_buffer_t;
+
+/*!
+    UDPTL context.
+*/
+struct udptl_state_s
+{
+    /*! \brief Handler routine for received IFP packets */
+    udptl_rx_packet_handler_t *rx_packet_handler;
+    /*! \brief An opaque pointer passed to rx_packet_handler */
+    void *user_data;
+    /*! \brief Handler routine for UDPTL packets ready for transmission */
+    udptl_tx_packet_handler_t *tx_packet_handler;
+    /*! \brief An opaque pointer passed to tx_packet_handler */
+    void *tx_user_data;
+
+    /*! This option indicates the error correction scheme used in transmitted UDPTL
+        packets. */
+    int error_correction_scheme;
+
+    /*! This option indicates the number of error correction entries transmitted in
+        UDPTL packets. */
+    int error_correction_entries;
+
+    /*! This option indicates the span of the error correction entries in transmitted
+        UDPTL packets (FEC only). */
+    int error_correction_span;
+
+    /*! This option indicates the maximum size of a datagram that can be accepted by
+        the remote device. */
+    int far_max_datagram_size;
+
+    /*! This option indicates the maximum size of a datagram that we are prepared to
+        accept. */
+    int local_max_datagram_size;
+
+    /*! The sequence number of the next packet to be transmitted */
+    int tx_seq_no;
+    /*! The number of packets transmitted, up to UDPTL_BUF_LEN */
+    int tx_history;
+    /*! The sequence number of the next packet expected, or -1 before the first packet */
+    int rx_seq_no;
+
+    /*! The recently transmitted IFP packets */
+    udptl_fec_tx_buffer_t tx[UDPTL_BUF_LEN];
+    /*! The recently received IFP packets */
+    udptl_fec_rx_buffer_t rx[UDPTL_BUF_LEN];
+
+    /*! \brief Error and flow logging control */
+    logging_state_t logging;
+};
+
+#endif
+/*- End of file ------------------------------------------------------------*/
@@ -59,6 +59,13 @@ struct v17_rx_state_s
     put_bit_func_t put_bit;
     /*! \brief A user specified opaque pointer passed to the put_but routine. */
     void *put_bit_user_data;
+    /*! \brief An optional callback function used to put the received bits in chunks,
+               in place of put_bit. */
+    put_bits_func_t put_bits;
+    /*! \brief The received bits waiting to be passed to put_bits. */
+    unsigned int bit_chunk;
+    /*! \brief The number of bits in bit_chunk. */
+    int bit_chunk_len;
 
     /*! \brief The callback function used to report modem status changes. */
     modem_rx_status_func_t status_handler;
@@ -43,6 +43,13 @@ struct v17_tx_state_s
     get_bit_func_t get_bit;
     /*! \brief A user specified opaque pointer passed to the get_bit function. */
     void *get_bit_user_data;
+    /*! \brief An optional callback function used to get the bits to be transmitted in
+               chunks, in place of get_bit. */
+    get_bits_func_t get_bits;
+    /*! \brief The bits from get_bits still to be sent. */
+    unsigned int bit_chunk;
+    /*! \brief The number of bits in bit_chunk. */
+    int bit_chunk_len;
 
     /*! \brief The callback function used to report modem status changes. */
     modem_tx_status_func_t status_handler;
@@ -79,10 +79,16 @@ struct v22bis_state_s
     get_bit_func_t get_bit;
     /*! \brief A user specified opaque pointer passed to the get_bit callback routine. */
     void *get_bit_user_data;
+    /*! \brief An optional callback function used to get the bits to be transmitted in
+               chunks, in place of get_bit. */
+    get_bits_func_t get_bits;
     /*! \brief The callback function used to put each bit received. */
     put_bit_func_t put_bit;
     /*! \brief A user specified opaque pointer passed to the put_bit callback routine. */
     void *put_bit_user_data;
+    /*! \brief An optional callback function used to put the received bits in chunks,
+               in place of put_bit. */
+    put_bits_func_t put_bits;
     /*! \brief The callback function used to report modem status changes. */
     modem_rx_status_func_t status_handler;
     /*! \brief A user specified opaque pointer passed to the status function. */
@@ -93,13 +99,16 @@ struct v22bis_state_s
     /* Receive section */
     struct
     {
-        /*! \brief The route raised cosine (RRC) pulse shaping filter buffer. */
+        /*! \brief The route raised cosine (RRC) pulse shaping filter buffer. This holds
+                   the most recent samples, oldest first. */
 #if defined(SPANDSP_USE_FIXED_POINTx)
         int16_t rrc_filter[V22BIS_RX_FILTER_STEPS];
 #else
         float rrc_filter[V22BIS_RX_FILTER_STEPS];
 #endif
-        /*! \brief Current offset into the RRC pulse shaping filter buffer. */
+        /*! \brief -1 while a block of samples is being processed, so a restart of the
+                   receiver part way through the block, which sets this to 0, can be
+                   spotted. */
         int rrc_filter_step;
 
         /*! \brief The register for the data scrambler. */
@@ -177,6 +186,11 @@ struct v22bis_state_s
 
         int pattern_repeats;
         int last_raw_bits;
+
+        /*! \brief The received bits waiting to be passed to put_bits. */
+        unsigned int bit_chunk;
+        /*! \brief The number of bits in bit_chunk. */
+        int bit_chunk_len;
     } rx;
 
     /* Transmit section */
@@ -217,6 +231,10 @@ struct v22bis_state_s
         int shutdown;
         /*! \brief The get_bit function in use at any instant. */
         get_bit_func_t current_get_bit;
+        /*! \brief The bits from get_bits still to be sent. */
+        unsigned int bit_chunk;
+        /*! \brief The number of bits in bit_chunk. */
+        int bit_chunk_len;
     } tx;
 
     /*! \brief Error and flow logging control */
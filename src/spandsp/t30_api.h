@@ -545,6 +545,28 @@ SPAN_DECLARE(void) t30_set_real_time_frame_handler(t30_state_t *s, t30_real_time
 */
 SPAN_DECLARE(logging_state_t *) t30_get_logging_state(t30_state_t *s);
 
+/*! Get the amount of memory a T.30 context is using. This includes the ECM partial
+    page buffer, which a context only holds while a page is being sent or received
+    in ECM mode, the T.4 image buffers, which it only holds while a document is being
+    sent or received, and the memory for file names and non-standard facilities
+    messages. It does not include the memory used by the TIFF library for the image
+    file.
+    \brief Get the amount of memory a T.30 context is using.
+    \param s The T.30 context.
+    \return The number of bytes in use. */
+SPAN_DECLARE(int) t30_get_memory_usage(t30_state_t *s);
+
+/*! Free the ECM partial page buffers kept for reuse. The buffers are shared by all the
+    T.30 contexts in the process. Those handed back at the end of a page are kept, up
+    to a total of 512k bytes, so later pages and calls need not allocate them again.
+    They are not counted by t30_get_memory_usage(), and are never freed unless this is
+    called. Buffers held by active contexts are not affected, and are kept for reuse
+    again when handed back. Call this before unloading the library, or to keep memory
+    checkers from reporting the free buffers as leaks.
+    \brief Free the ECM partial page buffers kept for reuse.
+    \return The number of bytes freed. */
+SPAN_DECLARE(int) t30_ecm_pool_drain(void);
+
 #if defined(__cplusplus)
 }
 #endif
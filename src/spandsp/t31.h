@@ -119,6 +119,15 @@ SPAN_DECLARE(void) t31_set_mode(t31_state_t *s, int t38_mode);
 */
 SPAN_DECLARE(logging_state_t *) t31_get_logging_state(t31_state_t *s);
 
+/*! Get the amount of memory a T.31 context is using. This includes the queue of
+    received data for the computer, and the memory counted by at_get_memory_usage()
+    for the T.31 context's AT interpreter. It does not include any buffer supplied for
+    batching the transmitted T.38 packets.
+    \brief Get the amount of memory a T.31 context is using.
+    \param s The T.31 context.
+    \return The number of bytes in use. */
+SPAN_DECLARE(int) t31_get_memory_usage(t31_state_t *s);
+
 SPAN_DECLARE(t38_core_state_t *) t31_get_t38_core_state(t31_state_t *s);
 
 /*! Initialise a T.31 context. This must be called before the first
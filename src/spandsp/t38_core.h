@@ -195,6 +195,50 @@ typedef struct
     int field_len;
 } t38_data_field_t;
 
+/*! A T.38 IFP packet, for the batched receive and transmit calls. The packet contents
+    are not copied, so they must remain valid for as long as the packet is in use. */
+typedef struct
+{
+    /*! Packet contents */
+    const uint8_t *buf;
+    /*! Packet length */
+    int len;
+    /*! Packet sequence number */
+    int seq_no;
+    /*! For a transmitted packet, the number of times it should be sent. This is the
+        same as the count passed to a t38_tx_packet_handler_t. */
+    int count;
+} t38_ifp_packet_t;
+
+/*! The type of a received field which marks a gap in the received packet sequence */
+#define T38_RX_FIELD_MISSING    -1
+
+/*! A field of a received T.38 IFP packet, as found by t38_core_rx_ifp_packets(). An
+    indicator packet gives a single field. */
+typedef struct
+{
+    /*! The position, in the batch, of the packet this field came from */
+    int packet;
+    /*! The sequence number of the packet this field came from */
+    int seq_no;
+    /*! T38_TYPE_OF_MSG_T30_INDICATOR, T38_TYPE_OF_MSG_T30_DATA, or T38_RX_FIELD_MISSING
+        where some packets before this one were lost. */
+    int type;
+    /*! The indicator, for an indicator packet */
+    int indicator;
+    /*! The data type, for a data packet */
+    int data_type;
+    /*! The field type, for a data packet */
+    int field_type;
+    /*! The field contents, pointing into the received packet, or NULL */
+    const uint8_t *field;
+    /*! The field length */
+    int field_len;
+    /*! For T38_RX_FIELD_MISSING, the first missing sequence number, or -1 if the
+        sequence jumped too far to tell how many packets were lost. */
+    int missing_from;
+} t38_rx_field_t;
+
 /*!
     Core T.38 state, common to all modes of T.38.
 */
@@ -288,6 +332,48 @@ SPAN_DECLARE(int) t38_core_send_data_multi_field(t38_core_state_t *s, int data_t
     \return 0 for OK, else -1. */
 SPAN_DECLARE(int) t38_core_rx_ifp_packet(t38_core_state_t *s, const uint8_t *buf, int len, uint16_t seq_no);
 
+/*! \brief Process a batch of received T.38 IFP packets, such as those from a single
+           recvmmsg() call. Rather than calling the receive handlers, this lists the
+           fields of the packets, pointing into the packets themselves. The sequence
+           numbers are checked, and the context updated, exactly as for
+           t38_core_rx_ifp_packet(). Repeated and late packets give no fields, and lost
+           packets give a T38_RX_FIELD_MISSING entry. A packet is only taken if all its
+           fields fit.
+    \param s The T.38 context.
+    \param pkt The packets.
+    \param packets The number of packets.
+    \param field The list to be filled with the fields.
+    \param max_fields The maximum number of fields the list can hold.
+    \param fields The number of fields found.
+    \return The number of packets taken. This is less than packets when the field list
+            fills. */
+SPAN_DECLARE(int) t38_core_rx_ifp_packets(t38_core_state_t *s,
+                                          const t38_ifp_packet_t pkt[],
+                                          int packets,
+                                          t38_rx_field_t field[],
+                                          int max_fields,
+                                          int *fields);
+
+/*! \brief Start collecting transmitted IFP packets in a caller owned buffer. Until
+           t38_core_end_tx_batch() is called, the packets built by the send functions
+           are encoded straight into the buffer and listed, instead of being passed to
+           the transmit packet handler. Each packet is listed once, with the number of
+           times it should be sent, so repeats can be sent by reference, such as through
+           sendmmsg(). The send functions return -1 once the buffer or the list is full.
+    \param s The T.38 context.
+    \param buf The buffer for the packet contents.
+    \param len The length of the buffer.
+    \param pkt The list to be filled with the packets.
+    \param max_packets The maximum number of packets the list can hold.
+    \return 0 for OK, else -1. */
+SPAN_DECLARE(int) t38_core_start_tx_batch(t38_core_state_t *s, uint8_t buf[], int len, t38_ifp_packet_t pkt[], int max_packets);
+
+/*! \brief Stop collecting transmitted IFP packets in a caller owned buffer, and go
+           back to passing them to the transmit packet handler.
+    \param s The T.38 context.
+    \return The number of packets listed since t38_core_start_tx_batch(). */
+SPAN_DECLARE(int) t38_core_end_tx_batch(t38_core_state_t *s);
+
 /*! Set the method to be used for data rate management, as per the T.38 spec.
     \param s The T.38 context.
     \param method 1 for pass TCF across the T.38 link, 2 for handle TCF locally.
@@ -36,6 +36,13 @@ and 8k samples/second audio streams. It provides the buffering and flow control
 to maximum the tolerance of jitter and packet loss on the IP network.
 
 \section t38_gateway_page_sec_2 How does it work?
+
+\section t38_gateway_page_sec_3 Lazy modem start
+A gateway can be attached to every call, before it is known which calls are FAX calls.
+In lazy mode, the FAX modems are not allocated until a FAX signal is seen. Until then,
+the gateway is in the voice phase. The audio side only runs a CNG detector, and a CED
+or V.21 preamble detector, and produces no audio. The modems start the moment either
+detector fires, or any T.38 indicator other than no-signal, or any T.38 data, arrives.
 */
 
 /*! The receive buffer length */
@@ -176,6 +183,23 @@ SPAN_DECLARE(void) t38_gateway_set_nsx_suppression(t38_gateway_state_t *s,
 */
 SPAN_DECLARE(void) t38_gateway_set_tep_mode(t38_gateway_state_t *s, int use_tep);
 
+/*! Select whether the FAX modems are only started when a FAX signal is seen on either side
+    of the gateway. This should be set before any audio or T.38 packets are processed. The
+    default is FALSE, where the modems are started by t38_gateway_init().
+    \brief Select whether the FAX modems are only started when a FAX signal is seen.
+    \param s The T.38 context.
+    \param lazy TRUE if the modems should only be started when they are needed.
+    \return 0 for OK, else -1.
+*/
+SPAN_DECLARE(int) t38_gateway_set_lazy_modems(t38_gateway_state_t *s, int lazy);
+
+/*! Check whether the FAX modems of a T.38 gateway are currently allocated.
+    \brief Check whether the FAX modems are currently allocated.
+    \param s The T.38 context.
+    \return TRUE if the modems are allocated.
+*/
+SPAN_DECLARE(int) t38_gateway_get_modems_active(t38_gateway_state_t *s);
+
 /*! Select whether non-ECM fill bits are to be removed during transmission.
     \brief Select whether non-ECM fill bits are to be removed during transmission.
     \param s The T.38 context.
@@ -205,6 +229,15 @@ SPAN_DECLARE(t38_core_state_t *) t38_gateway_get_t38_core_state(t38_gateway_stat
 */
 SPAN_DECLARE(logging_state_t *) t38_gateway_get_logging_state(t38_gateway_state_t *s);
 
+/*! Get the amount of memory a T.38 gateway context is using. This includes the FAX
+    modems, and the buffers which feed them, which a context in lazy modem mode only
+    holds while the call is in FAX mode. It does not include any buffer supplied for
+    batching the transmitted T.38 packets.
+    \brief Get the amount of memory a T.38 gateway context is using.
+    \param s The T.38 context.
+    \return The number of bytes in use. */
+SPAN_DECLARE(int) t38_gateway_get_memory_usage(t38_gateway_state_t *s);
+
 /*! Set a callback function for T.30 frame exchange monitoring. This is called from the heart
     of the signal processing, so don't take too long in the handler routine.
     \brief Set a callback function for T.30 frame exchange monitoring.
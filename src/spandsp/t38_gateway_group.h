@@ -0,0 +1,194 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * t38_gateway_group.h - A driver for a group of T.38 gateway sessions,
+ *                       processed together each audio tick.
+ *
+ * Written by Steve Underwood <steveu@coppice.org>
+ *
+ * Copyright (C) 2010 Steve Underwood
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+#if !defined(_SPANDSP_T38_GATEWAY_GROUP_H_)
+#define _SPANDSP_T38_GATEWAY_GROUP_H_
+
+/*! \page t38_gateway_group_page T.38 gateway session groups
+\section t38_gateway_group_page_sec_1 What does it do?
+A box acting as a T.38 gateway for many calls would normally drive each gateway
+session separately, waking up for each one every audio tick, and sending each T.38
+packet as it is produced. A session group owns many T.38 gateway sessions, and
+processes the audio of all of them for a tick in one pass. The T.38 packets the
+sessions produce are collected, and handed over once per tick for each destination,
+so the packets for one destination can be sent together.
+
+\section t38_gateway_group_page_sec_2 How does it work?
+The audio for a tick is passed to the group as one block, with the same number of
+samples for every session slot, one slot after another. Each session in use is
+given its audio, and asked for its output audio, in turn. The packets from each
+session are queued with the destination given when the session was added. At the
+end of the tick the queue is sorted by destination, keeping the order of the packets
+for each destination, and the transmit handler is called once for each destination
+with packets waiting.
+
+A group is not locked, and should be driven by a single thread. To use several
+cores, use one group per core. t38_gateway_group_bind_to_cpu() pins the calling
+thread to a core. If it is called before the sessions are added, the memory for
+the sessions will usually be local to that core.
+*/
+
+/*! A T.38 packet produced by a session in a group. */
+typedef struct
+{
+    /*! The session which produced the packet */
+    int session;
+    /*! The IFP packet */
+    const uint8_t *buf;
+    /*! The length of the IFP packet */
+    int len;
+    /*! The transmission count and redundancy control for the packet's category, as
+        passed to a T.38 core transmit packet handler. */
+    int count;
+} t38_gateway_group_packet_t;
+
+/*! T.38 gateway session group context. */
+typedef struct t38_gateway_group_state_s t38_gateway_group_state_t;
+
+/*! Handler for the T.38 packets waiting for one destination, at the end of a tick.
+    \param user_data An opaque pointer.
+    \param dest The destination.
+    \param pkt The packets, in the order they were produced. These are only valid for
+           the duration of the call.
+    \param packets The number of packets.
+    \return 0 for OK.
+    The handler must not pass packets back into the same group. */
+typedef int (t38_gateway_group_tx_handler_t)(void *user_data, int dest, const t38_gateway_group_packet_t pkt[], int packets);
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+/*! \brief Add a session to a T.38 gateway session group. The session's gateway is
+           initialised by t38_gateway_init(), and may be configured through
+           t38_gateway_group_get_gateway().
+    \param s The session group context.
+    \param dest The destination for the session's T.38 packets.
+    \return The session number, or -1 if the group is full or dest is not valid. */
+SPAN_DECLARE(int) t38_gateway_group_add_session(t38_gateway_group_state_t *s, int dest);
+
+/*! \brief Remove a session from a T.38 gateway session group. Any T.38 packets still
+           waiting are handed over first.
+    \param s The session group context.
+    \param session The session number.
+    \return 0 for OK, or -1 if there is no such session. */
+SPAN_DECLARE(int) t38_gateway_group_remove_session(t38_gateway_group_state_t *s, int session);
+
+/*! \brief Change the destination of a session's T.38 packets.
+    \param s The session group context.
+    \param session The session number.
+    \param dest The destination.
+    \return 0 for OK, or -1 for a bad session or destination. */
+SPAN_DECLARE(int) t38_gateway_group_set_destination(t38_gateway_group_state_t *s, int session, int dest);
+
+/*! \brief Get the T.38 gateway context of a session.
+    \param s The session group context.
+    \param session The session number.
+    \return A pointer to the gateway context, or NULL if there is no such session. */
+SPAN_DECLARE(t38_gateway_state_t *) t38_gateway_group_get_gateway(t38_gateway_group_state_t *s, int session);
+
+/*! \brief Get the number of sessions in use in a T.38 gateway session group.
+    \param s The session group context.
+    \return The number of sessions. */
+SPAN_DECLARE(int) t38_gateway_group_get_sessions(t38_gateway_group_state_t *s);
+
+/*! \brief Process an arriving T.38 IFP packet for one session of a group. Any T.38
+           packets this causes the session to send wait until the end of the next tick,
+           or the next call to t38_gateway_group_flush().
+    \param s The session group context.
+    \param session The session number.
+    \param buf The packet buffer.
+    \param len The length of the packet.
+    \param seq_no The packet sequence number.
+    \return 0 for OK, else -1. */
+SPAN_DECLARE(int) t38_gateway_group_rx_ifp_packet(t38_gateway_group_state_t *s, int session, const uint8_t buf[], int len, uint16_t seq_no);
+
+/*! \brief Process one tick of audio for every session in a T.38 gateway session group,
+           and hand over the T.38 packets produced.
+    \param s The session group context.
+    \param rx_amp The received audio, len samples for each session slot in turn, for all
+           the slots the group was created with. The audio is altered in place, as it is
+           by t38_gateway_rx(). If this is NULL, the audio is treated as missing, and
+           t38_gateway_rx_fillin() is used.
+    \param tx_amp A buffer for the audio to be sent, len samples for each session slot
+           in turn. Any part of a slot for which a session has nothing to send, and the
+           slots not in use, are filled with silence.
+    \param len The number of samples per session slot.
+    \return The number of sessions processed. */
+SPAN_DECLARE(int) t38_gateway_group_tick(t38_gateway_group_state_t *s, int16_t rx_amp[], int16_t tx_amp[], int len);
+
+/*! \brief Hand over any T.38 packets waiting in a T.38 gateway session group now,
+           rather than at the end of the next tick.
+    \param s The session group context.
+    \return The number of packets handed over. */
+SPAN_DECLARE(int) t38_gateway_group_flush(t38_gateway_group_state_t *s);
+
+/*! \brief Pin the calling thread to a CPU core, for driving a T.38 gateway session group.
+    \param s The session group context.
+    \param cpu The CPU core number.
+    \return 0 for OK, or -1 if this is not possible. */
+SPAN_DECLARE(int) t38_gateway_group_bind_to_cpu(t38_gateway_group_state_t *s, int cpu);
+
+/*! Get a pointer to the logging context associated with a T.38 gateway session group.
+    \brief Get a pointer to the logging context associated with a T.38 gateway session group.
+    \param s The session group context.
+    \return A pointer to the logging context, or NULL.
+*/
+SPAN_DECLARE(logging_state_t *) t38_gateway_group_get_logging_state(t38_gateway_group_state_t *s);
+
+/*! \brief Initialise a T.38 gateway session group.
+    \param s The session group context.
+    \param max_sessions The number of session slots.
+    \param max_destinations The number of destinations. Destinations are numbered from
+           zero.
+    \param tx_handler The handler for the T.38 packets for each destination.
+    \param user_data An opaque pointer passed to tx_handler.
+    \return A pointer to the session group context, or NULL if there was a problem. */
+SPAN_DECLARE(t38_gateway_group_state_t *) t38_gateway_group_init(t38_gateway_group_state_t *s,
+                                                                 int max_sessions,
+                                                                 int max_destinations,
+                                                                 t38_gateway_group_tx_handler_t *tx_handler,
+                                                                 void *user_data);
+
+/*! \brief Release a T.38 gateway session group. All its sessions are released.
+    \param s The session group context.
+    \return 0 for OK. */
+SPAN_DECLARE(int) t38_gateway_group_release(t38_gateway_group_state_t *s);
+
+/*! \brief Free a T.38 gateway session group. All its sessions are released.
+    \param s The session group context.
+    \return 0 for OK. */
+SPAN_DECLARE(int) t38_gateway_group_free(t38_gateway_group_state_t *s);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
+/*- End of file ------------------------------------------------------------*/
@@ -126,6 +126,25 @@ SPAN_DECLARE(void) t38_non_ecm_buffer_report_output_status(t38_non_ecm_buffer_st
     \return The next bit, or one of the values indicating a change of modem status. */
 SPAN_DECLARE_NONSTD(int) t38_non_ecm_buffer_get_bit(void *user_data);
 
+/*! \brief Get the next few bits of data from a T.38 rate adapting non-ECM buffer context, in
+           the form of a get_bits_func_t. Up to two octets are returned per call.
+    \param user_data The buffer context, cast to a void pointer.
+    \param bits The bits, right aligned, with the first to be sent in the most significant position.
+    \return The number of bits, or one of the values indicating a change of modem status. */
+SPAN_DECLARE_NONSTD(int) t38_non_ecm_buffer_get_bits(void *user_data, unsigned int *bits);
+
+/*! \brief Get the next chunk of data from a T.38 rate adapting non-ECM buffer context. The
+           octets are in the order held in the buffer, with the first bit to be sent in the
+           most significant bit, as t38_non_ecm_buffer_get_bit() sends them. Flow control
+           fill is added in whole octets, as it is for t38_non_ecm_buffer_get_bit(). A
+           transmission should use one of the two calls, and not switch between them.
+    \param user_data The buffer context, cast to a void pointer.
+    \param buf The buffer for the data.
+    \param max_len The number of octets wanted.
+    \return The number of octets put in buf. Less than max_len means the end of the data
+            has been reached. */
+SPAN_DECLARE(int) t38_non_ecm_buffer_get_chunk(void *user_data, uint8_t buf[], int max_len);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -240,6 +240,14 @@ SPAN_DECLARE(int) t4_rx_start_page(t4_state_t *s);
     \return TRUE when the bit ends the document page, otherwise FALSE. */
 SPAN_DECLARE(int) t4_rx_put_bit(t4_state_t *s, int bit);
 
+/*! \brief Put a few bits of the current document page, in the form of a
+           put_bits_func_t.
+    \param s The T.4 context.
+    \param bits The data bits, right aligned, with the earliest in the most significant position.
+    \param nbits The number of bits (1 to 16).
+    \return TRUE when the bits end the document page, otherwise FALSE. */
+SPAN_DECLARE(int) t4_rx_put_bits(t4_state_t *s, unsigned int bits, int nbits);
+
 /*! \brief Put a byte of the current document page.
     \param s The T.4 context.
     \param byte The data byte.
@@ -330,6 +338,14 @@ SPAN_DECLARE(void) t4_rx_set_model(t4_state_t *s, const char *model);
     \param t A pointer to a statistics structure. */
 SPAN_DECLARE(void) t4_rx_get_transfer_statistics(t4_state_t *s, t4_stats_t *t);
 
+/*! Get the amount of memory a T.4 context is using. This includes the image buffer,
+    the run length and row buffers, and the file name. It does not include the memory
+    used by the TIFF library for the image file.
+    \brief Get the amount of memory a T.4 context is using.
+    \param s The T.4 context.
+    \return The number of bytes in use. */
+SPAN_DECLARE(int) t4_rx_get_memory_usage(t4_state_t *s);
+
 /*! Get the short text name of an encoding format. 
     \brief Get the short text name of an encoding format.
     \param encoding The encoding type.
@@ -81,6 +81,14 @@ SPAN_DECLARE(int) t4_tx_check_bit(t4_state_t *s);
             set (i.e. the returned value is 2 or 3). */
 SPAN_DECLARE(int) t4_tx_get_bit(t4_state_t *s);
 
+/*! \brief Get the next few bits of the current document page, in the form of a
+           get_bits_func_t.
+    \param s The T.4 context.
+    \param bits The bits, right aligned, with the earliest in the most significant position.
+    \return The number of bits (up to 16), or SIG_STATUS_END_OF_DATA when the
+            document page has all been sent. */
+SPAN_DECLARE(int) t4_tx_get_bits(t4_state_t *s, unsigned int *bits);
+
 /*! \brief Get the next byte of the current document page. The document will
            be padded for the current minimum scan line time.
     \param s The T.4 context.
@@ -182,6 +190,14 @@ SPAN_DECLARE(int) t4_tx_get_current_page_in_file(t4_state_t *s);
     \param t A pointer to a statistics structure. */
 SPAN_DECLARE(void) t4_tx_get_transfer_statistics(t4_state_t *s, t4_stats_t *t);
 
+/*! Get the amount of memory a T.4 context is using. This includes the image buffer,
+    the run length and row buffers, and the file name. It does not include the memory
+    used by the TIFF library for the image file.
+    \brief Get the amount of memory a T.4 context is using.
+    \param s The T.4 context.
+    \return The number of bytes in use. */
+SPAN_DECLARE(int) t4_tx_get_memory_usage(t4_state_t *s);
+
 #if defined(__cplusplus)
 }
 #endif
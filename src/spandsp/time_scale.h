@@ -47,6 +47,10 @@ exactly the same algorithms, but the code is a complete rewrite.
 Mikio's code batch processes files. This version works incrementally
 on streams, and allows multiple streams to be processed concurrently.
 
+After the first pitch search, each search looks closely only at lags near the
+last pitch found, as pitch usually changes slowly. The rest of the pitch range
+is looked at coarsely, so the search can follow a sudden change of pitch.
+
 \section time_scale_page_sec_3 How do I used it?
 The output buffer must be big enough to hold the maximum number of samples which
 could result from the data in the input buffer, which is:
@@ -108,6 +112,36 @@ SPAN_DECLARE(int) time_scale_max_output_len(time_scale_state_t *s, int input_len
 */
 SPAN_DECLARE(int) time_scale(time_scale_state_t *s, int16_t out[], int16_t in[], int len);
 
+/*! Flush out the samples held in a time scale context. The output continues
+    seamlessly from the last output of time_scale(), so a stream may be passed
+    through time scaling only while its speed needs to change, without the
+    buffering delay of the time scale context at other times.
+    \brief Flush out the samples held in a time scale context.
+    \param s The time scale context.
+    \param out The output audio sample buffer. This must be able to hold
+           2*sample_rate/TIME_SCALE_MIN_PITCH samples.
+    \return The number of output samples.
+*/
+SPAN_DECLARE(int) time_scale_flush(time_scale_state_t *s, int16_t out[]);
+
+/*! Time scale a chunk of audio samples for each of a number of channels.
+    \brief Time scale a chunk of audio samples for many channels.
+    \param s The time scale context for each channel.
+    \param out The output audio sample buffer for each channel. Each must be large
+           enough to accept the longest possible result for its channel.
+    \param in The input audio sample buffer for each channel.
+    \param len The number of input samples for each channel.
+    \param out_len The number of output samples for each channel.
+    \param channels The number of channels.
+    \return The number of channels processed.
+*/
+SPAN_DECLARE(int) time_scale_batch(time_scale_state_t *s[],
+                                   int16_t *out[],
+                                   int16_t *in[],
+                                   int len,
+                                   int out_len[],
+                                   int channels);
+
 #if defined(__cplusplus)
 }
 #endif
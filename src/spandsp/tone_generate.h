@@ -41,6 +41,18 @@ we are only concerned with telephony applications. It is possible to generate
 the tones we need with a very simple efficient scheme. It is also practical to
 use an exhaustive test to prove the oscillator is stable under all the
 conditions in which we will use it. 
+
+Each section of the cadence is generated in blocks. All the oscillators are run
+for a whole block, and the results are combined afterwards, using SIMD
+instructions where they are available. The samples are exactly the same as
+generating and combining the oscillators one sample at a time.
+
+\section tone_generation_page_sec_3 Shared tone sources
+A switch may be playing the same call progress tone to thousands of channels.
+Those channels do not need to be in step with the start of the cadence, any more
+than they are when listening to the tone plant of a real exchange. A shared tone
+source renders one frame of a tone per tick, and all the channels subscribed to
+it use that frame directly, with no copying and no further tone generation.
 */
 
 typedef struct tone_gen_tone_descriptor_s tone_gen_tone_descriptor_t;
@@ -56,6 +68,11 @@ typedef struct tone_gen_descriptor_s tone_gen_descriptor_t;
 */
 typedef struct tone_gen_state_s tone_gen_state_t;
 
+/*!
+    Shared cadenced tone source descriptor.
+*/
+typedef struct tone_gen_shared_s tone_gen_shared_t;
+
 #if defined(__cplusplus)
 extern "C"
 {
@@ -93,12 +110,54 @@ SPAN_DECLARE(void) tone_gen_descriptor_free(tone_gen_descriptor_t *s);
 
 SPAN_DECLARE_NONSTD(int) tone_gen(tone_gen_state_t *s, int16_t amp[], int max_samples);
 
-SPAN_DECLARE(tone_gen_state_t *) tone_gen_init(tone_gen_state_t *s, tone_gen_descriptor_t *t);
+SPAN_DECLARE(tone_gen_state_t *) tone_gen_init(tone_gen_state_t *s, const tone_gen_descriptor_t *t);
 
 SPAN_DECLARE(int) tone_gen_release(tone_gen_state_t *s);
 
 SPAN_DECLARE(int) tone_gen_free(tone_gen_state_t *s);
 
+/*! Render the next frame of a shared tone source. This should be called once per
+    frame period, whether or not any channels are subscribed. If none are, the
+    cadence is advanced without generating any samples.
+    \brief Render the next frame of a shared tone source.
+    \param s The shared tone source.
+    \return The number of samples of tone in the frame. This is only less than the frame
+            length when a non-repeating tone has finished. The rest of the frame is
+            then silence. */
+SPAN_DECLARE(int) tone_gen_shared_tick(tone_gen_shared_t *s);
+
+/*! Get the current frame of a shared tone source. The frame remains valid until the
+    next call to tone_gen_shared_tick().
+    \brief Get the current frame of a shared tone source.
+    \param s The shared tone source.
+    \param len The number of samples of tone in the frame is returned here, if this is not NULL.
+    \return A pointer to the frame. */
+SPAN_DECLARE(const int16_t *) tone_gen_shared_frame(tone_gen_shared_t *s, int *len);
+
+/*! Subscribe a channel to a shared tone source.
+    \brief Subscribe a channel to a shared tone source.
+    \param s The shared tone source.
+    \return The number of subscribed channels. */
+SPAN_DECLARE(int) tone_gen_shared_subscribe(tone_gen_shared_t *s);
+
+/*! Unsubscribe a channel from a shared tone source.
+    \brief Unsubscribe a channel from a shared tone source.
+    \param s The shared tone source.
+    \return The number of subscribed channels. */
+SPAN_DECLARE(int) tone_gen_shared_unsubscribe(tone_gen_shared_t *s);
+
+/*! Initialise a shared tone source.
+    \brief Initialise a shared tone source.
+    \param s The shared tone source.
+    \param t The descriptor of the tone.
+    \param frame_len The number of samples rendered per tick.
+    \return A pointer to the shared tone source, or NULL for an error. */
+SPAN_DECLARE(tone_gen_shared_t *) tone_gen_shared_init(tone_gen_shared_t *s, const tone_gen_descriptor_t *t, int frame_len);
+
+SPAN_DECLARE(int) tone_gen_shared_release(tone_gen_shared_t *s);
+
+SPAN_DECLARE(int) tone_gen_shared_free(tone_gen_shared_t *s);
+
 #if defined(__cplusplus)
 }
 #endif
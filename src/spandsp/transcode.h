@@ -0,0 +1,212 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * transcode.h - Offline transcoding of recorded audio between the
+ *               speech codecs, using a pool of worker threads.
+ *
+ * Written by Steve Underwood <steveu@coppice.org>
+ *
+ * Copyright (C) 2010 Steve Underwood
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+#if !defined(_SPANDSP_TRANSCODE_H_)
+#define _SPANDSP_TRANSCODE_H_
+
+/*! \page transcode_page Offline transcoding of recorded audio
+\section transcode_page_sec_1 What does it do?
+The transcoding module converts complete recordings, held in memory, between
+16 bit linear, A-law, u-law, G.722, G.726, GSM 06.10, IMA ADPCM, OKI ADPCM and
+LPC-10. It is intended for converting large archives of stored audio, such as
+voicemail, rather than for real time streams.
+
+\section transcode_page_sec_2 How does it work?
+Each recording is described by a transcoding job, giving the input data and its
+format, and an output buffer and its format. A job is converted by decoding large
+blocks of the input to linear audio, and encoding that straight into the output
+buffer.
+
+A pool of worker threads can run many jobs at the same time. A job whose input can
+be decoded from any of a number of resync points, and whose output does not depend
+on what came before, is also split into independent segments, so a single long
+recording can use all the workers. This applies where the input is linear, A-law,
+u-law or IMA ADPCM in chunks with headers, and the output is linear, A-law or u-law.
+The output is exactly the same as when the job is converted in one piece. Other
+jobs are each run as a whole by one worker.
+
+The audio passes through the module at 8000 samples/second, except when G.722
+is converted to G.722, when the full 16000 samples/second is kept. Where an encoder
+works in whole frames, any final part frame is padded with silence.
+*/
+
+/*! The formats the transcoding module can convert between */
+enum
+{
+    /*! 16 bit signed linear, at 8000 samples/second, in host byte order */
+    TRANSCODE_FORMAT_LINEAR = 0,
+    /*! A-law */
+    TRANSCODE_FORMAT_ALAW = 1,
+    /*! u-law */
+    TRANSCODE_FORMAT_ULAW = 2,
+    /*! G.722. The bit rate may be 64000, 56000 or 48000. The variant may be
+        G722_PACKED. */
+    TRANSCODE_FORMAT_G722 = 3,
+    /*! G.726. The bit rate may be 16000, 24000, 32000 or 40000. The variant
+        is one of the G726_PACKING_xxx options. */
+    TRANSCODE_FORMAT_G726 = 4,
+    /*! GSM 06.10. The variant is one of the GSM0610_PACKING_xxx options. */
+    TRANSCODE_FORMAT_GSM0610 = 5,
+    /*! IMA ADPCM. The variant may be IMA_ADPCM_IMA4 or IMA_ADPCM_DVI4. */
+    TRANSCODE_FORMAT_IMA_ADPCM = 6,
+    /*! OKI ADPCM. The bit rate may be 32000 or 24000. */
+    TRANSCODE_FORMAT_OKI_ADPCM = 7,
+    /*! LPC-10 */
+    TRANSCODE_FORMAT_LPC10 = 8
+};
+
+/*! The completion status of a transcoding job */
+enum
+{
+    /*! The job completed successfully */
+    TRANSCODE_OK = 0,
+    /*! The job has not yet been run */
+    TRANSCODE_PENDING = 1,
+    /*! The input or output format is not valid */
+    TRANSCODE_ERROR_FORMAT = -1,
+    /*! The output buffer is too small */
+    TRANSCODE_ERROR_OUTPUT_FULL = -2,
+    /*! Memory for the codecs could not be allocated */
+    TRANSCODE_ERROR_RESOURCES = -3
+};
+
+/*!
+    The description of an audio format for the transcoding module.
+*/
+typedef struct
+{
+    /*! One of the TRANSCODE_FORMAT_xxx values */
+    int format;
+    /*! The bit rate, for G.722, G.726 and OKI ADPCM. */
+    int bit_rate;
+    /*! The G.722 options, G.726 or GSM 06.10 packing, or IMA ADPCM variant. */
+    int variant;
+    /*! For IMA ADPCM, the number of samples in each chunk, where the data is a series
+        of chunks which each start with a header, as in wave files. Zero for a
+        continuous stream with no headers. IMA4 chunks must contain an odd number of
+        samples, and DVI4 chunks an even number. */
+    int chunk_size;
+} transcode_format_t;
+
+/*!
+    Transcoding job descriptor. This describes the conversion of a single
+    recording from one format to another.
+*/
+typedef struct transcode_job_s transcode_job_t;
+
+/*!
+    Transcoding worker pool descriptor.
+*/
+typedef struct transcode_pool_s transcode_pool_t;
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+/*! Find the largest number of bytes a conversion could produce.
+    \param in_format The format of the input data.
+    \param in_len The length of the input data, in bytes.
+    \param out_format The format of the output data.
+    \return The maximum number of bytes which could be produced, or -1 if the formats
+            are not valid. */
+SPAN_DECLARE(int) transcode_max_output_len(const transcode_format_t *in_format,
+                                           int in_len,
+                                           const transcode_format_t *out_format);
+
+/*! Initialise a transcoding job.
+    \param s The transcoding job context.
+    \param in_format The format of the input data.
+    \param in The input data. This must remain valid until the job has been run.
+    \param in_len The length of the input data, in bytes.
+    \param out_format The format of the output data.
+    \param out The buffer for the output data.
+    \param out_max The size of the output buffer, in bytes.
+    \return A pointer to the transcoding job context, or NULL for error. */
+SPAN_DECLARE(transcode_job_t *) transcode_job_init(transcode_job_t *s,
+                                                  const transcode_format_t *in_format,
+                                                  const uint8_t in[],
+                                                  int in_len,
+                                                  const transcode_format_t *out_format,
+                                                  uint8_t out[],
+                                                  int out_max);
+
+/*! Release a transcoding job context.
+    \param s The transcoding job context.
+    \return 0 for OK. */
+SPAN_DECLARE(int) transcode_job_release(transcode_job_t *s);
+
+/*! Free a transcoding job context.
+    \param s The transcoding job context.
+    \return 0 for OK. */
+SPAN_DECLARE(int) transcode_job_free(transcode_job_t *s);
+
+/*! Run a transcoding job to completion, in the calling thread.
+    \param s The transcoding job context.
+    \return The status of the job - TRANSCODE_OK, or one of the TRANSCODE_ERROR_xxx values. */
+SPAN_DECLARE(int) transcode_job_run(transcode_job_t *s);
+
+/*! Get the status of a transcoding job.
+    \param s The transcoding job context.
+    \return TRANSCODE_PENDING, TRANSCODE_OK, or one of the TRANSCODE_ERROR_xxx values. */
+SPAN_DECLARE(int) transcode_job_get_status(transcode_job_t *s);
+
+/*! Get the number of bytes of output a completed transcoding job produced.
+    \param s The transcoding job context.
+    \return The number of bytes. */
+SPAN_DECLARE(int) transcode_job_get_output_len(transcode_job_t *s);
+
+/*! Get the duration of the audio a completed transcoding job converted.
+    \param s The transcoding job context.
+    \return The duration, in 1/8000ths of a second. */
+SPAN_DECLARE(int) transcode_job_get_duration(transcode_job_t *s);
+
+/*! Initialise a pool of transcoding worker threads.
+    \param threads The number of worker threads. If this is zero, or threads are not
+           available, jobs are run in the thread which calls transcode_pool_run().
+    \return A pointer to the pool, or NULL for error. */
+SPAN_DECLARE(transcode_pool_t *) transcode_pool_init(int threads);
+
+/*! Run a number of transcoding jobs to completion, using a pool of worker threads.
+    \param s The worker pool.
+    \param jobs The jobs.
+    \param njobs The number of jobs.
+    \return The number of jobs which completed successfully. */
+SPAN_DECLARE(int) transcode_pool_run(transcode_pool_t *s, transcode_job_t *jobs[], int njobs);
+
+/*! Stop the worker threads, and free a pool of transcoding worker threads.
+    \param s The worker pool.
+    \return 0 for OK. */
+SPAN_DECLARE(int) transcode_pool_free(transcode_pool_t *s);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
+/*- End of file ------------------------------------------------------------*/
@@ -0,0 +1,212 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * udptl.h - An implementation of the UDPTL protocol defined in T.38,
+ *           less the packet exchange part
+ *
+ * Written by Steve Underwood <steveu@coppice.org>
+ *
+ * Copyright (C) 2009 Steve Underwood
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+#if !defined(_SPANDSP_UDPTL_H_)
+#define _SPANDSP_UDPTL_H_
+
+/*! \page udptl_page UDPTL packet handling
+\section udptl_page_sec_1 What does it do?
+UDPTL is the packet format T.38 defines for carrying IFP packets over UDP. Each UDPTL
+packet carries one IFP packet, with a sequence number, and some error recovery
+information, so lost packets can be recovered at the far end. The error recovery
+information may be:
+
+    - nothing.
+    - redundancy - copies of some of the IFP packets which went before.
+    - FEC - parity packets, each the exclusive OR of a number of the IFP packets which
+      went before.
+
+This module builds UDPTL packets for transmission, and takes apart received ones,
+recovering any lost IFP packets it can. It can be connected directly to a T.38 core
+context, so the IFP packets it sends and receives pass straight to and from T.38.
+
+\section udptl_page_sec_2 How does it work?
+The recent IFP packets sent and received are kept in fixed size rings, indexed by
+sequence number, so the redundancy and FEC information can be built, and lost packets
+recovered, without allocating memory or searching through the history.
+*/
+
+/*! The largest IFP packet which can be sent or received */
+#define UDPTL_MAX_DATAGRAM          400
+/*! The largest number of FEC entries which can be sent or received in a packet */
+#define UDPTL_MAX_FEC_ENTRIES       5
+/*! The number of recent packets kept, to build and use the error recovery information.
+    This must be a power of 2. */
+#define UDPTL_BUF_LEN               16
+/*! The largest number of redundant IFP packets which can be sent in a packet */
+#define UDPTL_MAX_REDUNDANCY_DEPTH  (UDPTL_BUF_LEN - 1)
+/*! The length of buffer needed by udptl_build_packet() for the longest possible UDPTL packet */
+#define UDPTL_MAX_PACKET_LEN        (2 + (UDPTL_MAX_REDUNDANCY_DEPTH + 1)*(UDPTL_MAX_DATAGRAM + 2) + 4)
+
+/*! The error recovery schemes for UDPTL */
+enum
+{
+    UDPTL_ERROR_CORRECTION_NONE,
+    UDPTL_ERROR_CORRECTION_FEC,
+    UDPTL_ERROR_CORRECTION_REDUNDANCY
+};
+
+/*! UDPTL context. */
+typedef struct udptl_state_s udptl_state_t;
+
+/*! Handler for IFP packets received through UDPTL, including those recovered from the
+    error recovery information. */
+typedef int (udptl_rx_packet_handler_t)(void *user_data, const uint8_t msg[], int len, int seq_no);
+
+/*! Handler for UDPTL packets ready for transmission. */
+typedef int (udptl_tx_packet_handler_t)(void *user_data, const uint8_t buf[], int len);
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+/*! \brief Process an arriving UDPTL packet. The IFP packets it contains, and any which
+           can be recovered from it, are passed to the receive packet handler.
+    \param s The UDPTL context.
+    \param buf The UDPTL packet buffer.
+    \param len The length of the packet.
+    \return 0 for OK, or -1 for a bad packet. */
+SPAN_DECLARE(int) udptl_rx_packet(udptl_state_t *s, const uint8_t buf[], int len);
+
+/*! \brief Construct a UDPTL packet, ready for transmission.
+    \param s The UDPTL context.
+    \param buf The UDPTL packet buffer. This must be at least UDPTL_MAX_PACKET_LEN bytes long.
+    \param msg The primary IFP packet.
+    \param msg_len The length of the primary IFP packet.
+    \return The length of the constructed UDPTL packet, or -1 for error. */
+SPAN_DECLARE(int) udptl_build_packet(udptl_state_t *s, uint8_t buf[], const uint8_t msg[], int msg_len);
+
+/*! \brief Change the error correction settings of a UDPTL context.
+    \param s The UDPTL context.
+    \param ec_scheme One of the optional error correction schemes, or -1 for no change.
+    \param span The packet span over which error correction should be applied, or -1
+           for no change.
+    \param entries The number of error correction entries to include in packets, or -1
+           for no change. For redundancy, this is the redundancy depth.
+    \return 0 for OK. */
+SPAN_DECLARE(int) udptl_set_error_correction(udptl_state_t *s, int ec_scheme, int span, int entries);
+
+/*! \brief Check the error correction settings of a UDPTL context.
+    \param s The UDPTL context.
+    \param ec_scheme One of the optional error correction schemes.
+    \param span The packet span over which error correction is being applied.
+    \param entries The number of error correction being included in packets.
+    \return 0 for OK. */
+SPAN_DECLARE(int) udptl_get_error_correction(udptl_state_t *s, int *ec_scheme, int *span, int *entries);
+
+/*! \brief Set the largest IFP packet we will accept.
+    \param s The UDPTL context.
+    \param max_datagram The maximum length.
+    \return 0 for OK. */
+SPAN_DECLARE(int) udptl_set_local_max_datagram(udptl_state_t *s, int max_datagram);
+
+/*! \brief Get the largest IFP packet we will accept.
+    \param s The UDPTL context.
+    \return The maximum length. */
+SPAN_DECLARE(int) udptl_get_local_max_datagram(udptl_state_t *s);
+
+/*! \brief Set the largest UDPTL packet the far end will accept. The redundancy depth of
+           transmitted packets is reduced, where necessary, to keep within this.
+    \param s The UDPTL context.
+    \param max_datagram The maximum length.
+    \return 0 for OK. */
+SPAN_DECLARE(int) udptl_set_far_max_datagram(udptl_state_t *s, int max_datagram);
+
+/*! \brief Get the largest UDPTL packet the far end will accept.
+    \param s The UDPTL context.
+    \return The maximum length. */
+SPAN_DECLARE(int) udptl_get_far_max_datagram(udptl_state_t *s);
+
+/*! \brief Set the handler for UDPTL packets ready for transmission. This is used when
+           the UDPTL context is connected to a T.38 core context.
+    \param s The UDPTL context.
+    \param tx_packet_handler The handler.
+    \param user_data An opaque pointer supplied to tx_packet_handler. */
+SPAN_DECLARE(void) udptl_set_tx_packet_handler(udptl_state_t *s, udptl_tx_packet_handler_t *tx_packet_handler, void *user_data);
+
+/*! \brief A T.38 core transmit packet handler, which sends each IFP packet through UDPTL.
+           Pass this, with the UDPTL context as its user data, to t38_core_init(). The
+           number of transmissions for the packet's category is honoured, and a
+           redundancy depth for the category overrides the depth set for the UDPTL
+           context.
+    \param t The T.38 core context.
+    \param user_data The UDPTL context.
+    \param buf The IFP packet.
+    \param len The length of the IFP packet.
+    \param count The packet's category control setting.
+    \return 0 for OK, or -1 for error. */
+SPAN_DECLARE(int) udptl_t38_tx_packet_handler(t38_core_state_t *t, void *user_data, const uint8_t buf[], int len, int count);
+
+/*! \brief A UDPTL receive packet handler, which passes each IFP packet to T.38. Pass this,
+           with the T.38 core context as its user data, to udptl_init().
+    \param user_data The T.38 core context.
+    \param msg The IFP packet.
+    \param len The length of the IFP packet.
+    \param seq_no The sequence number of the IFP packet.
+    \return 0 for OK, or -1 for a bad IFP packet. */
+SPAN_DECLARE(int) udptl_t38_rx_packet_handler(void *user_data, const uint8_t msg[], int len, int seq_no);
+
+/*! Get a pointer to the logging context associated with a UDPTL context.
+    \brief Get a pointer to the logging context associated with a UDPTL context.
+    \param s The UDPTL context.
+    \return A pointer to the logging context, or NULL.
+*/
+SPAN_DECLARE(logging_state_t *) udptl_get_logging_state(udptl_state_t *s);
+
+/*! \brief Initialise a UDPTL context.
+    \param s The UDPTL context.
+    \param ec_scheme One of the optional error correction schemes.
+    \param span The packet span over which error correction should be applied.
+    \param entries The number of error correction entries to include in packets.
+    \param rx_packet_handler The callback function, used to report arriving IFP packets.
+    \param user_data An opaque pointer supplied to rx_packet_handler.
+    \return A pointer to the UDPTL context, or NULL if there was a problem. */
+SPAN_DECLARE(udptl_state_t *) udptl_init(udptl_state_t *s,
+                                         int ec_scheme,
+                                         int span,
+                                         int entries,
+                                         udptl_rx_packet_handler_t *rx_packet_handler,
+                                         void *user_data);
+
+/*! \brief Release a UDPTL context.
+    \param s The UDPTL context.
+    \return 0 for OK. */
+SPAN_DECLARE(int) udptl_release(udptl_state_t *s);
+
+/*! \brief Free a UDPTL context.
+    \param s The UDPTL context.
+    \return 0 for OK. */
+SPAN_DECLARE(int) udptl_free(udptl_state_t *s);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
+/*- End of file ------------------------------------------------------------*/
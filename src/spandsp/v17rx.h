@@ -262,6 +262,18 @@ SPAN_DECLARE(logging_state_t *) v17_rx_get_logging_state(v17_rx_state_t *s);
     \param user_data An opaque pointer. */
 SPAN_DECLARE(void) v17_rx_set_put_bit(v17_rx_state_t *s, put_bit_func_t put_bit, void *user_data);
 
+/*! Set a put_bits function for a V.17 modem receive context. Received data bits are
+    then passed to this function up to 16 at a time, using the user data given for the
+    put_bit function, instead of one at a time to the put_bit function. Status changes
+    are still reported through the put_bit function, or the status handler, after any
+    bits received before them have been passed on. Any bits still waiting are passed
+    on at the end of each call to v17_rx(). Setting a new put_bit function cancels this.
+    \brief Set a put_bits function for a V.17 modem receive context.
+    \param s The modem context.
+    \param put_bits The callback routine used to handle received bits, or NULL to go
+           back to using the put_bit function. */
+SPAN_DECLARE(void) v17_rx_set_put_bits(v17_rx_state_t *s, put_bits_func_t put_bits);
+
 /*! Change the modem status report function associated with a V.17 modem receive context.
     \brief Change the modem status report function associated with a V.17 modem receive context.
     \param s The modem context.
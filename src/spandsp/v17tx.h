@@ -141,6 +141,16 @@ SPAN_DECLARE(logging_state_t *) v17_tx_get_logging_state(v17_tx_state_t *s);
     \param user_data An opaque pointer. */
 SPAN_DECLARE(void) v17_tx_set_get_bit(v17_tx_state_t *s, get_bit_func_t get_bit, void *user_data);
 
+/*! Set a get_bits function for a V.17 modem transmit context. The data to be sent is then
+    taken from this function up to 16 bits at a time, using the user data given for the
+    get_bit function, instead of one bit at a time from the get_bit function. Setting a
+    new get_bit function cancels this.
+    \brief Set a get_bits function for a V.17 modem transmit context.
+    \param s The modem context.
+    \param get_bits The callback routine used to get the data to be transmitted, or NULL
+           to go back to using the get_bit function. */
+SPAN_DECLARE(void) v17_tx_set_get_bits(v17_tx_state_t *s, get_bits_func_t get_bits);
+
 /*! Change the modem status report function associated with a V.17 modem transmit context.
     \brief Change the modem status report function associated with a V.17 modem transmit context.
     \param s The modem context.
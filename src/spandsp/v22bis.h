@@ -201,6 +201,16 @@ SPAN_DECLARE(logging_state_t *) v22bis_get_logging_state(v22bis_state_t *s);
     \param user_data An opaque pointer. */
 SPAN_DECLARE(void) v22bis_set_get_bit(v22bis_state_t *s, get_bit_func_t get_bit, void *user_data);
 
+/*! Set a get_bits function for a V.22bis modem context. The data to be sent is then
+    taken from this function up to 16 bits at a time, using the user data given for the
+    get_bit function, instead of one bit at a time from the get_bit function. Setting a
+    new get_bit function cancels this.
+    \brief Set a get_bits function for a V.22bis modem context.
+    \param s The modem context.
+    \param get_bits The callback routine used to get the data to be transmitted, or NULL
+           to go back to using the get_bit function. */
+SPAN_DECLARE(void) v22bis_set_get_bits(v22bis_state_t *s, get_bits_func_t get_bits);
+
 /*! Change the get_bit function associated with a V.22bis modem context.
     \brief Change the put_bit function associated with a V.22bis modem context.
     \param s The modem context.
@@ -208,6 +218,18 @@ SPAN_DECLARE(void) v22bis_set_get_bit(v22bis_state_t *s, get_bit_func_t get_bit,
     \param user_data An opaque pointer. */
 SPAN_DECLARE(void) v22bis_set_put_bit(v22bis_state_t *s, put_bit_func_t put_bit, void *user_data);
 
+/*! Set a put_bits function for a V.22bis modem context. Received data bits are then
+    passed to this function up to 16 at a time, using the user data given for the
+    put_bit function, instead of one at a time to the put_bit function. Status changes
+    are still reported through the put_bit function, or the status handler, after any
+    bits received before them have been passed on. Any bits still waiting are passed
+    on at the end of each call to v22bis_rx(). Setting a new put_bit function cancels this.
+    \brief Set a put_bits function for a V.22bis modem context.
+    \param s The modem context.
+    \param put_bits The callback routine used to handle received bits, or NULL to go
+           back to using the put_bit function. */
+SPAN_DECLARE(void) v22bis_set_put_bits(v22bis_state_t *s, put_bits_func_t put_bits);
+
 /*! Change the modem status report function associated with a V.22bis modem receive context.
     \brief Change the modem status report function associated with a V.22bis modem receive context.
     \param s The modem context.
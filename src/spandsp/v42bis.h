@@ -102,6 +102,13 @@ SPAN_DECLARE(int) v42bis_decompress_flush(v42bis_state_t *s);
             V42BIS_COMPRESSION_MODE_NEVER */
 SPAN_DECLARE(void) v42bis_compression_control(v42bis_state_t *s, int mode);
 
+/*! Get the amount of memory a V.42bis context is using. The dictionaries are part of
+    the context, and are always sized for the largest codeword count, whatever was
+    negotiated.
+    \param s The V.42bis context.
+    \return The number of bytes in use. */
+SPAN_DECLARE(int) v42bis_get_memory_usage(v42bis_state_t *s);
+
 /*! Initialise a V.42bis context.
     \param s The V.42bis context.
     \param negotiated_p0 The negotiated P0 parameter, from the V.42bis spec.
@@ -45,6 +45,7 @@
 #include "floating_fudge.h"
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/fast_convert.h"
 #include "spandsp/complex.h"
 #include "spandsp/dds.h"
@@ -54,6 +55,9 @@
 #include "spandsp/private/tone_generate.h"
 #include "spandsp/private/super_tone_tx.h"
 
+/*! The number of samples of tone generated in one pass */
+#define SUPER_TONE_TX_BLOCK_LEN     64
+
 /*
     The tone played to wake folk up when they have left the phone off hook is an
     oddity amongst supervisory tones. It is designed to sound loud and nasty. Most
@@ -78,7 +82,7 @@ SPAN_DECLARE(super_tone_tx_step_t *) super_tone_tx_make_step(super_tone_tx_step_
 {
     if (s == NULL)
     {
-        if ((s = (super_tone_tx_step_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (super_tone_tx_step_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     if (f1 >= 1.0f)
@@ -121,7 +125,7 @@ SPAN_DECLARE(int) super_tone_tx_free_tone(super_tone_tx_step_t *s)
             super_tone_tx_free_tone(s->nest);
         t = s;
         s = s->next;
-        free(t);
+        span_free(t);
     }
     return 0;
 }
@@ -133,7 +137,7 @@ SPAN_DECLARE(super_tone_tx_state_t *) super_tone_tx_init(super_tone_tx_state_t *
         return NULL;
     if (s == NULL)
     {
-        if ((s = (super_tone_tx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (super_tone_tx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -155,18 +159,54 @@ SPAN_DECLARE(int) super_tone_tx_release(super_tone_tx_state_t *s)
 SPAN_DECLARE(int) super_tone_tx_free(super_tone_tx_state_t *s)
 {
     if (s)
-        free(s);
+        span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
 
+static void tone_block(super_tone_tx_state_t *s, int16_t amp[], int len)
+{
+    int i;
+    int j;
+    float xamp[SUPER_TONE_TX_BLOCK_LEN];
+    float tone[SUPER_TONE_TX_BLOCK_LEN];
+
+    /* Each tone is generated for the whole block, and then the tones are combined.
+       This gives exactly the same result as combining them sample by sample. */
+    if (s->tone[0].phase_rate < 0)
+    {
+        /* There must be two, and only two tones */
+        dds_modf_block(&s->phase[0], -s->tone[0].phase_rate, s->tone[0].gain, 0, xamp, len);
+        dds_modf_block(&s->phase[1], s->tone[1].phase_rate, s->tone[1].gain, 0, tone, len);
+        for (j = 0;  j < len;  j++)
+            amp[j] = (int16_t) lfastrintf(xamp[j]*(1.0f + tone[j]));
+        return;
+    }
+    if (s->tone[0].phase_rate == 0)
+    {
+        memset(amp, 0, sizeof(int16_t)*len);
+        return;
+    }
+    dds_modf_block(&s->phase[0], s->tone[0].phase_rate, s->tone[0].gain, 0, xamp, len);
+    for (i = 1;  i < 4;  i++)
+    {
+        if (s->tone[i].phase_rate == 0)
+            break;
+        dds_modf_block(&s->phase[i], s->tone[i].phase_rate, s->tone[i].gain, 0, tone, len);
+        for (j = 0;  j < len;  j++)
+            xamp[j] += tone[j];
+    }
+    for (j = 0;  j < len;  j++)
+        amp[j] = (int16_t) lfastrintf(xamp[j]);
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(int) super_tone_tx(super_tone_tx_state_t *s, int16_t amp[], int max_samples)
 {
     int samples;
     int limit;
     int len;
     int i;
-    float xamp;
     super_tone_tx_step_t *tree;
 
     if (s->level < 0  ||  s->level > 3)
@@ -200,29 +240,11 @@ SPAN_DECLARE(int) super_tone_tx(super_tone_tx_state_t *s, int16_t amp[], int max
             {
                 s->current_position = 0;
             }
-            if (s->tone[0].phase_rate < 0)
-            {
-                for (limit = len + samples;  samples < limit;  samples++)
-                {
-                    /* There must be two, and only two tones */
-                    xamp = dds_modf(&s->phase[0], -s->tone[0].phase_rate, s->tone[0].gain, 0)
-                         *(1.0f + dds_modf(&s->phase[1], s->tone[1].phase_rate, s->tone[1].gain, 0));
-                    amp[samples] = (int16_t) lfastrintf(xamp);
-                }
-            }
-            else
+            for (limit = len + samples;  samples < limit;  samples += len)
             {
-                for (limit = len + samples;  samples < limit;  samples++)
-                {
-                    xamp = 0.0f;
-                    for (i = 0;  i < 4;  i++)
-                    {
-                        if (s->tone[i].phase_rate == 0)
-                            break;
-                        xamp += dds_modf(&s->phase[i], s->tone[i].phase_rate, s->tone[i].gain, 0);
-                    }
-                    amp[samples] = (int16_t) lfastrintf(xamp);
-                }
+                if ((len = limit - samples) > SUPER_TONE_TX_BLOCK_LEN)
+                    len = SUPER_TONE_TX_BLOCK_LEN;
+                tone_block(s, &amp[samples], len);
             }
             if (s->current_position)
                 return samples;
@@ -43,8 +43,13 @@
 #endif
 #include "floating_fudge.h"
 #include <tiffio.h>
+#if defined(HAVE_PTHREAD_H)  &&  defined(HAVE_LIBPTHREAD)
+#include <pthread.h>
+#define T30_ECM_POOL_USE_LOCKING
+#endif
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
 #include "spandsp/bit_operations.h"
 #include "spandsp/queue.h"
@@ -94,6 +99,15 @@
     terminal could keep you retrying all day. Its a backstop protection. */
 #define MAX_RESPONSE_TRIES  6
 
+/*! The spacing of the frames in an ECM partial page buffer for 64 octet frames. Frames
+    being sent have a 4 octet header. */
+#define ECM_SMALL_FRAME_STRIDE  (4 + 64)
+/*! The spacing of the frames in an ECM partial page buffer for 256 octet frames. */
+#define ECM_LARGE_FRAME_STRIDE  (4 + 256)
+/*! The most memory, in bytes, the free ECM partial page buffers may hold. This is
+    room for 7 buffers for 256 octet frames, or 30 for 64 octet frames. */
+#define ECM_POOL_MAX_FREE_BYTES (512*1024)
+
 /* T.30 defines the following call phases:
    Phase A: Call set-up.
        Exchange of CNG, CED and the called terminal identification.
@@ -406,6 +420,162 @@ static void timer_t2_t4_stop(t30_state_t *s);
 /*! Clear a specified bit within a DIS, DTC or DCS frame */
 #define clr_ctrl_bit(s,bit) (s)[3 + ((bit - 1)/8)] &= ~(1 << ((bit - 1)%8))
 
+/* An ECM partial page buffer is big, and only needed while a page is being sent or
+   received in ECM mode. Rather than each context holding one for its whole life, they
+   are taken from a pool shared by all the contexts in the process. A buffer is the
+   same size every time it is used, so buffers handed back are kept on a free list for
+   each size, and reused. The free buffers are capped at ECM_POOL_MAX_FREE_BYTES, and
+   t30_ecm_pool_drain() gives them all back. */
+static struct
+{
+    /*! The free buffers of each size. Each one holds a pointer to the next. */
+    uint8_t *free_list[2];
+    /*! The number of bytes held by the free buffers. */
+    int free_bytes;
+#if defined(T30_ECM_POOL_USE_LOCKING)
+    pthread_mutex_t mutex;
+#endif
+} ecm_pool =
+{
+    {NULL, NULL},
+    0,
+#if defined(T30_ECM_POOL_USE_LOCKING)
+    PTHREAD_MUTEX_INITIALIZER
+#endif
+};
+
+static uint8_t *ecm_pool_get(int stride)
+{
+    uint8_t *buf;
+    int size;
+    span_arena_t *arena;
+
+    size = (stride == ECM_SMALL_FRAME_STRIDE)  ?  0  :  1;
+#if defined(T30_ECM_POOL_USE_LOCKING)
+    pthread_mutex_lock(&ecm_pool.mutex);
+#endif
+    if ((buf = ecm_pool.free_list[size]))
+    {
+        memcpy(&ecm_pool.free_list[size], buf, sizeof(uint8_t *));
+        ecm_pool.free_bytes -= 256*stride;
+    }
+#if defined(T30_ECM_POOL_USE_LOCKING)
+    pthread_mutex_unlock(&ecm_pool.mutex);
+#endif
+    if (buf == NULL)
+    {
+        /* The pool outlives any one call, so its buffers must never come from an
+           arena selected for a call. */
+        arena = span_arena_select(NULL);
+        buf = (uint8_t *) span_alloc(256*stride);
+        span_arena_select(arena);
+    }
+    return buf;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void ecm_pool_put(uint8_t *buf, int stride)
+{
+    int size;
+
+    size = (stride == ECM_SMALL_FRAME_STRIDE)  ?  0  :  1;
+#if defined(T30_ECM_POOL_USE_LOCKING)
+    pthread_mutex_lock(&ecm_pool.mutex);
+#endif
+    if (ecm_pool.free_bytes + 256*stride <= ECM_POOL_MAX_FREE_BYTES)
+    {
+        memcpy(buf, &ecm_pool.free_list[size], sizeof(uint8_t *));
+        ecm_pool.free_list[size] = buf;
+        ecm_pool.free_bytes += 256*stride;
+        buf = NULL;
+    }
+#if defined(T30_ECM_POOL_USE_LOCKING)
+    pthread_mutex_unlock(&ecm_pool.mutex);
+#endif
+    if (buf)
+        span_free(buf);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t30_ecm_pool_drain(void)
+{
+    uint8_t *free_list[2];
+    uint8_t *buf;
+    int bytes;
+    int i;
+
+#if defined(T30_ECM_POOL_USE_LOCKING)
+    pthread_mutex_lock(&ecm_pool.mutex);
+#endif
+    free_list[0] = ecm_pool.free_list[0];
+    free_list[1] = ecm_pool.free_list[1];
+    bytes = ecm_pool.free_bytes;
+    ecm_pool.free_list[0] = NULL;
+    ecm_pool.free_list[1] = NULL;
+    ecm_pool.free_bytes = 0;
+#if defined(T30_ECM_POOL_USE_LOCKING)
+    pthread_mutex_unlock(&ecm_pool.mutex);
+#endif
+    for (i = 0;  i < 2;  i++)
+    {
+        while ((buf = free_list[i]))
+        {
+            memcpy(&free_list[i], buf, sizeof(uint8_t *));
+            span_free(buf);
+        }
+    }
+    return bytes;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int ecm_buffer_acquire(t30_state_t *s, int octets_per_frame)
+{
+    uint8_t *buf;
+    int stride;
+    int i;
+
+    stride = (octets_per_frame <= 64)  ?  ECM_SMALL_FRAME_STRIDE  :  ECM_LARGE_FRAME_STRIDE;
+    if (s->ecm_data  &&  s->ecm_frame_stride >= stride)
+        return 0;
+    if ((buf = ecm_pool_get(stride)) == NULL)
+    {
+        span_log(&s->logging, SPAN_LOG_WARNING, "Cannot allocate an ECM partial page buffer\n");
+        return -1;
+    }
+    if (s->ecm_data)
+    {
+        /* Frames bigger than the negotiated size have turned up, so move what we have
+           so far into a buffer for bigger frames. */
+        for (i = 0;  i < 256;  i++)
+        {
+            if (s->ecm_len[i] > 0)
+                memcpy(&buf[i*stride], &s->ecm_data[i*s->ecm_frame_stride], s->ecm_len[i]);
+        }
+        ecm_pool_put(s->ecm_data, s->ecm_frame_stride);
+    }
+    s->ecm_data = buf;
+    s->ecm_frame_stride = stride;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void ecm_buffer_release(t30_state_t *s)
+{
+    if (s->ecm_data)
+    {
+        ecm_pool_put(s->ecm_data, s->ecm_frame_stride);
+        s->ecm_data = NULL;
+        s->ecm_frame_stride = 0;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ uint8_t *ecm_frame(t30_state_t *s, int frame_no)
+{
+    return &s->ecm_data[frame_no*s->ecm_frame_stride];
+}
+/*- End of function --------------------------------------------------------*/
+
 static int terminate_operation_in_progress(t30_state_t *s)
 {
     /* Make sure any FAX in progress is tidied up. If the tidying up has
@@ -572,91 +742,92 @@ static void report_tx_result(t30_state_t *s, int result)
 
 static void release_resources(t30_state_t *s)
 {
+    ecm_buffer_release(s);
     if (s->tx_info.nsf)
     {
-        free(s->tx_info.nsf);
+        span_free(s->tx_info.nsf);
         s->tx_info.nsf = NULL;
     }
     s->tx_info.nsf_len = 0;
     if (s->tx_info.nsc)
     {
-        free(s->tx_info.nsc);
+        span_free(s->tx_info.nsc);
         s->tx_info.nsc = NULL;
     }
     s->tx_info.nsc_len = 0;
     if (s->tx_info.nss)
     {
-        free(s->tx_info.nss);
+        span_free(s->tx_info.nss);
         s->tx_info.nss = NULL;
     }
     s->tx_info.nss_len = 0;
     if (s->tx_info.tsa)
     {
-        free(s->tx_info.tsa);
+        span_free(s->tx_info.tsa);
         s->tx_info.tsa = NULL;
     }
     if (s->tx_info.ira)
     {
-        free(s->tx_info.ira);
+        span_free(s->tx_info.ira);
         s->tx_info.ira = NULL;
     }
     if (s->tx_info.cia)
     {
-        free(s->tx_info.cia);
+        span_free(s->tx_info.cia);
         s->tx_info.cia = NULL;
     }
     if (s->tx_info.isp)
     {
-        free(s->tx_info.isp);
+        span_free(s->tx_info.isp);
         s->tx_info.isp = NULL;
     }
     if (s->tx_info.csa)
     {
-        free(s->tx_info.csa);
+        span_free(s->tx_info.csa);
         s->tx_info.csa = NULL;
     }
 
     if (s->rx_info.nsf)
     {
-        free(s->rx_info.nsf);
+        span_free(s->rx_info.nsf);
         s->rx_info.nsf = NULL;
     }
     s->rx_info.nsf_len = 0;
     if (s->rx_info.nsc)
     {
-        free(s->rx_info.nsc);
+        span_free(s->rx_info.nsc);
         s->rx_info.nsc = NULL;
     }
     s->rx_info.nsc_len = 0;
     if (s->rx_info.nss)
     {
-        free(s->rx_info.nss);
+        span_free(s->rx_info.nss);
         s->rx_info.nss = NULL;
     }
     s->rx_info.nss_len = 0;
     if (s->rx_info.tsa)
     {
-        free(s->rx_info.tsa);
+        span_free(s->rx_info.tsa);
         s->rx_info.tsa = NULL;
     }
     if (s->rx_info.ira)
     {
-        free(s->rx_info.ira);
+        span_free(s->rx_info.ira);
         s->rx_info.ira = NULL;
     }
     if (s->rx_info.cia)
     {
-        free(s->rx_info.cia);
+        span_free(s->rx_info.cia);
         s->rx_info.cia = NULL;
     }
     if (s->rx_info.isp)
     {
-        free(s->rx_info.isp);
+        span_free(s->rx_info.isp);
         s->rx_info.isp = NULL;
     }
     if (s->rx_info.csa)
     {
-        free(s->rx_info.csa);
+        span_free(s->rx_info.csa);
         s->rx_info.csa = NULL;
     }
 }
@@ -698,6 +869,7 @@ static uint8_t check_next_tx_step(t30_state_t *s)
 
 static int get_partial_ecm_page(t30_state_t *s)
 {
+    uint8_t *frame;
     int i;
     int len;
 
@@ -710,22 +882,25 @@ static int get_partial_ecm_page(t30_state_t *s)
        page signal, which is marked as the final frame. */
     for (i = 3;  i < 32 + 3;  i++)
         s->ecm_frame_map[i] = 0xFF;
+    if (ecm_buffer_acquire(s, s->octets_per_ecm_frame))
+        return -1;
     for (i = 0;  i < 256;  i++)
     {
         s->ecm_len[i] = -1;
-        s->ecm_data[i][0] = ADDRESS_FIELD;
-        s->ecm_data[i][1] = CONTROL_FIELD_NON_FINAL_FRAME;
-        s->ecm_data[i][2] = T4_FCD;
+        frame = ecm_frame(s, i);
+        frame[0] = ADDRESS_FIELD;
+        frame[1] = CONTROL_FIELD_NON_FINAL_FRAME;
+        frame[2] = T4_FCD;
         /* These frames contain a frame sequence number within the partial page (one octet) followed
            by some image data. */
-        s->ecm_data[i][3] = (uint8_t) i;
-        if ((len = t4_tx_get_chunk(&s->t4.tx, &s->ecm_data[i][4], s->octets_per_ecm_frame)) < s->octets_per_ecm_frame)
+        frame[3] = (uint8_t) i;
+        if ((len = t4_tx_get_chunk(&s->t4.tx, &frame[4], s->octets_per_ecm_frame)) < s->octets_per_ecm_frame)
         {
             /* The image is not big enough to fill the entire buffer */
             /* We need to pad to a full frame, as most receivers expect that. */
             if (len > 0)
             {
-                memset(&s->ecm_data[i][4 + len], 0, s->octets_per_ecm_frame - len);
+                memset(&frame[4 + len], 0, s->octets_per_ecm_frame - len);
                 s->ecm_len[i++] = (int16_t) (s->octets_per_ecm_frame + 4);
             }
             s->ecm_frames = i;
@@ -756,7 +931,7 @@ static int send_next_ecm_frame(t30_state_t *s)
         {
             if (s->ecm_len[i] >= 0)
             {
-                send_frame(s, s->ecm_data[i], s->ecm_len[i]);
+                send_frame(s, ecm_frame(s, i), s->ecm_len[i]);
                 s->ecm_current_tx_frame = i + 1;
                 s->ecm_frames_this_tx_burst++;
                 return 0;
@@ -1076,12 +1251,12 @@ static int set_dis_or_dtc(t30_state_t *s)
        We just need to edit the prebuilt message. */
     s->local_dis_dtc_frame[2] = (uint8_t) (T30_DIS | s->dis_received);
     /* If we have a file name to receive into, then we are receive capable */
-    if (s->rx_file[0])
+    if (s->rx_file)
         set_ctrl_bit(s->local_dis_dtc_frame, T30_DIS_BIT_READY_TO_RECEIVE_FAX_DOCUMENT);
     else
         clr_ctrl_bit(s->local_dis_dtc_frame, T30_DIS_BIT_READY_TO_RECEIVE_FAX_DOCUMENT);
     /* If we have a file name to transmit, then we are ready to transmit (polling) */
-    if (s->tx_file[0])
+    if (s->tx_file)
         set_ctrl_bit(s->local_dis_dtc_frame, T30_DIS_BIT_READY_TO_TRANSMIT_FAX_DOCUMENT);
     else
         clr_ctrl_bit(s->local_dis_dtc_frame, T30_DIS_BIT_READY_TO_TRANSMIT_FAX_DOCUMENT);
@@ -1191,7 +1366,7 @@ int t30_build_dis_or_dtc(t30_state_t *s)
     if ((s->supported_t30_features & T30_SUPPORT_IDENTIFICATION))
         set_ctrl_bit(s->local_dis_dtc_frame, T30_DIS_BIT_PASSWORD);
     /* Ready to transmit a data file (polling) */
-    if (s->tx_file[0])
+    if (s->tx_file)
         set_ctrl_bit(s->local_dis_dtc_frame, T30_DIS_BIT_READY_TO_TRANSMIT_DATA_FILE);
     /* No Binary file transfer (BFT) */
     /* No Document transfer mode (DTM) */
@@ -1924,8 +2099,9 @@ static int set_min_scan_time_code(t30_state_t *s)
 static int start_sending_document(t30_state_t *s)
 {
     int min_row_bits;
+    int res;
 
-    if (s->tx_file[0] == '\0')
+    if (s->tx_file == NULL)
     {
         /* There is nothing to send */
         span_log(&s->logging, SPAN_LOG_FLOW, "No document to send\n");
@@ -1961,7 +2137,9 @@ static int start_sending_document(t30_state_t *s)
     s->image_width = t4_tx_get_image_width(&s->t4.tx);
     if (s->error_correcting_mode)
     {
-        if (get_partial_ecm_page(s) == 0)
+        if ((res = get_partial_ecm_page(s)) < 0)
+            return -1;
+        if (res == 0)
             span_log(&s->logging, SPAN_LOG_WARNING, "No image data to send\n");
     }
     return 0;
@@ -1980,7 +2158,7 @@ static int restart_sending_document(t30_state_t *s)
 
 static int start_receiving_document(t30_state_t *s)
 {
-    if (s->rx_file[0] == '\0')
+    if (s->rx_file == NULL)
     {
         /* There is nothing to receive to */
         span_log(&s->logging, SPAN_LOG_FLOW, "No document to receive\n");
@@ -2134,7 +2312,7 @@ static int process_rx_dis_dtc(t30_state_t *s, const uint8_t *msg, int len)
     }
     queue_phase(s, T30_PHASE_B_TX);
     /* Try to send something */
-    if (s->tx_file[0])
+    if (s->tx_file)
     {
         span_log(&s->logging, SPAN_LOG_FLOW, "Trying to send file '%s'\n", s->tx_file);
         if (!test_ctrl_bit(s->far_dis_dtc_frame, T30_DIS_BIT_READY_TO_RECEIVE_FAX_DOCUMENT))
@@ -2160,7 +2338,7 @@ static int process_rx_dis_dtc(t30_state_t *s, const uint8_t *msg, int len)
     }
     span_log(&s->logging, SPAN_LOG_FLOW, "%s nothing to send\n", t30_frametype(msg[2]));
     /* ... then try to receive something */
-    if (s->rx_file[0])
+    if (s->rx_file)
     {
         span_log(&s->logging, SPAN_LOG_FLOW, "Trying to receive file '%s'\n", s->rx_file);
         if (!test_ctrl_bit(s->far_dis_dtc_frame, T30_DIS_BIT_READY_TO_TRANSMIT_FAX_DOCUMENT))
@@ -2234,7 +2412,7 @@ static int process_rx_dcs(t30_state_t *s, const uint8_t *msg, int len)
             memset(dcs_frame + len, 0, T30_MAX_DIS_DTC_DCS_LEN - len);
     }
 
-    s->octets_per_ecm_frame = test_ctrl_bit(dcs_frame, T30_DCS_BIT_64_OCTET_ECM_FRAMES)  ?  256  :  64;
+    s->octets_per_ecm_frame = test_ctrl_bit(dcs_frame, T30_DCS_BIT_64_OCTET_ECM_FRAMES)  ?  64  :  256;
 
     if (test_ctrl_bit(dcs_frame, T30_DCS_BIT_1200_1200))
         s->x_resolution = T4_X_RESOLUTION_1200;
@@ -2326,7 +2504,7 @@ static int process_rx_dcs(t30_state_t *s, const uint8_t *msg, int len)
              "Get document at %dbps, modem %d\n",
              fallback_sequence[s->current_fallback].bit_rate,
              fallback_sequence[s->current_fallback].modem_type);
-    if (s->rx_file[0] == '\0')
+    if (s->rx_file == NULL)
     {
         span_log(&s->logging, SPAN_LOG_FLOW, "No document to receive\n");
         s->current_status = T30_ERR_FILEERROR;
@@ -2521,7 +2699,7 @@ static int process_rx_pps(t30_state_t *s, const uint8_t *msg, int len)
         image_ended = FALSE;
         for (i = 0;  i < s->ecm_frames;  i++)
         {
-            if (t4_rx_put_chunk(&s->t4.rx, s->ecm_data[i], s->ecm_len[i]))
+            if (t4_rx_put_chunk(&s->t4.rx, ecm_frame(s, i), s->ecm_len[i]))
             {
                 /* This is the end of the document */
                 image_ended = TRUE;
@@ -2674,12 +2852,12 @@ static void process_rx_fcd(t30_state_t *s, const uint8_t *msg, int len)
                the frame, and let retries sort things out. */
             span_log(&s->logging, SPAN_LOG_FLOW, "Unexpected %s frame length - %d\n", t30_frametype(msg[0]), len);
         }
-        else
+        else if (ecm_buffer_acquire(s, (len - 4 > s->octets_per_ecm_frame)  ?  (len - 4)  :  s->octets_per_ecm_frame) == 0)
         {
             frame_no = msg[3];
             /* Just store the actual image data, and record its length */
             span_log(&s->logging, SPAN_LOG_FLOW, "Storing ECM frame %d, length %d\n", frame_no, len - 4);
-            memcpy(&s->ecm_data[frame_no][0], &msg[4], len - 4);
+            memcpy(ecm_frame(s, frame_no), &msg[4], len - 4);
             s->ecm_len[frame_no] = (int16_t) (len - 4);
             /* In case we are just after a CTC/CTR exchange, which kicked us back to long training */
             s->short_train = TRUE;
@@ -6250,7 +6428,7 @@ SPAN_DECLARE(t30_state_t *) t30_init(t30_state_t *s,
 {
     if (s == NULL)
     {
-        if ((s = (t30_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (t30_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -6285,6 +6463,17 @@ SPAN_DECLARE(int) t30_release(t30_state_t *s)
     /* Make sure any FAX in progress is tidied up. If the tidying up has
        already happened, repeating it here is harmless. */
     terminate_operation_in_progress(s);
+    ecm_buffer_release(s);
+    if (s->rx_file)
+    {
+        span_free(s->rx_file);
+        s->rx_file = NULL;
+    }
+    if (s->tx_file)
+    {
+        span_free(s->tx_file);
+        s->tx_file = NULL;
+    }
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -6292,7 +6481,7 @@ SPAN_DECLARE(int) t30_release(t30_state_t *s)
 SPAN_DECLARE(int) t30_free(t30_state_t *s)
 {
     t30_release(s);
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
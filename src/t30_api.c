@@ -45,6 +45,7 @@
 #include <tiffio.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
 #include "spandsp/bit_operations.h"
 #include "spandsp/queue.h"
@@ -269,8 +270,8 @@ SPAN_DECLARE(const char *) t30_get_rx_password(t30_state_t *s)
 SPAN_DECLARE(int) t30_set_tx_nsf(t30_state_t *s, const uint8_t *nsf, int len)
 {
     if (s->tx_info.nsf)
-        free(s->tx_info.nsf);
-    if (nsf  &&  len > 0  &&  (s->tx_info.nsf = malloc(len + 3)))
+        span_free(s->tx_info.nsf);
+    if (nsf  &&  len > 0  &&  (s->tx_info.nsf = span_alloc(len + 3)))
     {
         memcpy(s->tx_info.nsf + 3, nsf, len);
         s->tx_info.nsf_len = len;
@@ -303,8 +304,8 @@ SPAN_DECLARE(size_t) t30_get_rx_nsf(t30_state_t *s, const uint8_t *nsf[])
 SPAN_DECLARE(int) t30_set_tx_nsc(t30_state_t *s, const uint8_t *nsc, int len)
 {
     if (s->tx_info.nsc)
-        free(s->tx_info.nsc);
-    if (nsc  &&  len > 0  &&  (s->tx_info.nsc = malloc(len + 3)))
+        span_free(s->tx_info.nsc);
+    if (nsc  &&  len > 0  &&  (s->tx_info.nsc = span_alloc(len + 3)))
     {
         memcpy(s->tx_info.nsc + 3, nsc, len);
         s->tx_info.nsc_len = len;
@@ -337,8 +338,8 @@ SPAN_DECLARE(size_t) t30_get_rx_nsc(t30_state_t *s, const uint8_t *nsc[])
 SPAN_DECLARE(int) t30_set_tx_nss(t30_state_t *s, const uint8_t *nss, int len)
 {
     if (s->tx_info.nss)
-        free(s->tx_info.nss);
-    if (nss  &&  len > 0  &&  (s->tx_info.nss = malloc(len + 3)))
+        span_free(s->tx_info.nss);
+    if (nss  &&  len > 0  &&  (s->tx_info.nss = span_alloc(len + 3)))
     {
         memcpy(s->tx_info.nss + 3, nss, len);
         s->tx_info.nss_len = len;
@@ -371,7 +372,7 @@ SPAN_DECLARE(size_t) t30_get_rx_nss(t30_state_t *s, const uint8_t *nss[])
 SPAN_DECLARE(int) t30_set_tx_tsa(t30_state_t *s, int type, const char *address, int len)
 {
     if (s->tx_info.tsa)
-        free(s->tx_info.tsa);
+        span_free(s->tx_info.tsa);
     if (address == NULL  ||  len == 0)
     {
         s->tx_info.tsa = NULL;
@@ -381,7 +382,7 @@ SPAN_DECLARE(int) t30_set_tx_tsa(t30_state_t *s, int type, const char *address,
     s->tx_info.tsa_type = type;
     if (len < 0)
         len = strlen(address);
-    if ((s->tx_info.tsa = malloc(len)))
+    if ((s->tx_info.tsa = span_alloc(len)))
     {
         memcpy(s->tx_info.tsa, address, len);
         s->tx_info.tsa_len = len;
@@ -413,13 +414,13 @@ SPAN_DECLARE(size_t) t30_get_rx_tsa(t30_state_t *s, int *type, const char *addre
 SPAN_DECLARE(int) t30_set_tx_ira(t30_state_t *s, int type, const char *address, int len)
 {
     if (s->tx_info.ira)
-        free(s->tx_info.ira);
+        span_free(s->tx_info.ira);
     if (address == NULL)
     {
         s->tx_info.ira = NULL;
         return 0;
     }
-    s->tx_info.ira = strdup(address);
+    s->tx_info.ira = span_strdup(address);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -447,13 +448,13 @@ SPAN_DECLARE(size_t) t30_get_rx_ira(t30_state_t *s, int *type, const char *addre
 SPAN_DECLARE(int) t30_set_tx_cia(t30_state_t *s, int type, const char *address, int len)
 {
     if (s->tx_info.cia)
-        free(s->tx_info.cia);
+        span_free(s->tx_info.cia);
     if (address == NULL)
     {
         s->tx_info.cia = NULL;
         return 0;
     }
-    s->tx_info.cia = strdup(address);
+    s->tx_info.cia = span_strdup(address);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -481,13 +482,13 @@ SPAN_DECLARE(size_t) t30_get_rx_cia(t30_state_t *s, int *type, const char *addre
 SPAN_DECLARE(int) t30_set_tx_isp(t30_state_t *s, int type, const char *address, int len)
 {
     if (s->tx_info.isp)
-        free(s->tx_info.isp);
+        span_free(s->tx_info.isp);
     if (address == NULL)
     {
         s->tx_info.isp = NULL;
         return 0;
     }
-    s->tx_info.isp = strdup(address);
+    s->tx_info.isp = span_strdup(address);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -515,13 +516,13 @@ SPAN_DECLARE(size_t) t30_get_rx_isp(t30_state_t *s, int *type, const char *addre
 SPAN_DECLARE(int) t30_set_tx_csa(t30_state_t *s, int type, const char *address, int len)
 {
     if (s->tx_info.csa)
-        free(s->tx_info.csa);
+        span_free(s->tx_info.csa);
     if (address == NULL)
     {
         s->tx_info.csa = NULL;
         return 0;
     }
-    s->tx_info.csa = strdup(address);
+    s->tx_info.csa = span_strdup(address);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -604,18 +605,31 @@ SPAN_DECLARE(const char *) t30_get_rx_model(t30_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
+static char *set_file_name(char *old, const char *file)
+{
+    char *name;
+
+    if (old)
+        span_free(old);
+    if (file == NULL  ||  file[0] == '\0')
+        return NULL;
+    if ((name = (char *) span_alloc(strlen(file) + 1)) == NULL)
+        return NULL;
+    strcpy(name, file);
+    return name;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) t30_set_rx_file(t30_state_t *s, const char *file, int stop_page)
 {
-    strncpy(s->rx_file, file, sizeof(s->rx_file));
-    s->rx_file[sizeof(s->rx_file) - 1] = '\0';
+    s->rx_file = set_file_name(s->rx_file, file);
     s->rx_stop_page = stop_page;
 }
 /*- End of function --------------------------------------------------------*/
 
 SPAN_DECLARE(void) t30_set_tx_file(t30_state_t *s, const char *file, int start_page, int stop_page)
 {
-    strncpy(s->tx_file, file, sizeof(s->tx_file));
-    s->tx_file[sizeof(s->tx_file) - 1] = '\0';
+    s->tx_file = set_file_name(s->tx_file, file);
     s->tx_start_page = start_page;
     s->tx_stop_page = stop_page;
 }
@@ -775,4 +789,51 @@ SPAN_DECLARE(logging_state_t *) t30_get_logging_state(t30_state_t *s)
     return &s->logging;
 }
 /*- End of function --------------------------------------------------------*/
+static int exchanged_info_memory_usage(t30_exchanged_info_t *info)
+{
+    int size;
+
+    size = 0;
+    if (info->nsf)
+        size += info->nsf_len;
+    if (info->nsc)
+        size += info->nsc_len;
+    if (info->nss)
+        size += info->nss_len;
+    if (info->tsa)
+        size += info->tsa_len;
+    if (info->ira)
+        size += info->ira_len;
+    if (info->cia)
+        size += info->cia_len;
+    if (info->isp)
+        size += info->isp_len;
+    if (info->csa)
+        size += info->csa_len;
+    return size;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t30_get_memory_usage(t30_state_t *s)
+{
+    int size;
+
+    size = sizeof(*s);
+    if (s->ecm_data)
+        size += 256*s->ecm_frame_stride;
+    if (s->rx_file)
+        size += strlen(s->rx_file) + 1;
+    if (s->tx_file)
+        size += strlen(s->tx_file) + 1;
+    size += exchanged_info_memory_usage(&s->tx_info);
+    size += exchanged_info_memory_usage(&s->rx_info);
+    /* The T.4 context is part of the T.30 context, so only its buffers are added. They
+       are only held while a document is being sent or received. */
+    if (s->t4.rx.rx)
+        size += t4_rx_get_memory_usage(&s->t4.rx) - sizeof(s->t4.rx);
+    else
+        size += t4_tx_get_memory_usage(&s->t4.tx) - sizeof(s->t4.tx);
+    return size;
+}
+/*- End of function --------------------------------------------------------*/
 /*- End of file ------------------------------------------------------------*/
@@ -51,6 +51,7 @@
 #include <tiffio.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
 #include "spandsp/bit_operations.h"
 #include "spandsp/bitstream.h"
@@ -90,6 +91,7 @@
 
 #include "spandsp/private/logging.h"
 #include "spandsp/private/bitstream.h"
+#include "spandsp/private/queue.h"
 #include "spandsp/private/t38_core.h"
 #include "spandsp/private/silence_gen.h"
 #include "spandsp/private/fsk.h"
@@ -1192,15 +1194,25 @@ static void non_ecm_put_bit(void *user_data, int bit)
 static void non_ecm_put_chunk(void *user_data, const uint8_t buf[], int len)
 {
     t31_state_t *s;
+    const uint8_t *dle;
     int i;
+    int n;
 
     s = (t31_state_t *) user_data;
     /* Ignore any fractional bytes which may have accumulated */
-    for (i = 0;  i < len;  i++)
+    for (i = 0;  i < len;  i += n)
     {
-        if (buf[i] == DLE)
+        /* Copy up to and including the next DLE, or as much as fills the block for the
+           application, in one go. */
+        n = len - i;
+        if (n > 250 - s->at_state.rx_data_bytes)
+            n = (s->at_state.rx_data_bytes < 250)  ?  (250 - s->at_state.rx_data_bytes)  :  1;
+        if ((dle = memchr(&buf[i], DLE, n)))
+            n = dle - &buf[i] + 1;
+        memcpy(&s->at_state.rx_data[s->at_state.rx_data_bytes], &buf[i], n);
+        s->at_state.rx_data_bytes += n;
+        if (dle)
             s->at_state.rx_data[s->at_state.rx_data_bytes++] = DLE;
-        s->at_state.rx_data[s->at_state.rx_data_bytes++] = buf[i];
         if (s->at_state.rx_data_bytes >= 250)
         {
             s->at_state.at_tx_handler(&s->at_state,
@@ -1271,14 +1283,19 @@ static int non_ecm_get_chunk(void *user_data, uint8_t buf[], int len)
 {
     t31_state_t *s;
     int i;
+    int n;
 
     s = (t31_state_t *) user_data;
-    for (i = 0;  i < len;  i++)
+    for (i = 0;  i < len;  i += n)
     {
         if (s->tx.out_bytes != s->tx.in_bytes)
         {
-            /* There is real data available to send */
-            buf[i] = s->tx.data[s->tx.out_bytes++];
+            /* There is real data available to send. Take as much as we can in one go. */
+            n = s->tx.in_bytes - s->tx.out_bytes;
+            if (n > len - i)
+                n = len - i;
+            memcpy(&buf[i], &s->tx.data[s->tx.out_bytes], n);
+            s->tx.out_bytes += n;
             if (s->tx.out_bytes > T31_TX_BUF_LEN - 1)
             {
                 s->tx.out_bytes = T31_TX_BUF_LEN - 1;
@@ -1307,8 +1324,10 @@ static int non_ecm_get_chunk(void *user_data, uint8_t buf[], int len)
                 return i;
             }
             /* Fill with 0xFF bytes at the start of transmission, or 0x00 if we are in
-               the middle of transmission. This follows T.31 and T.30 practice. */
-            buf[i] = (s->tx.data_started)  ?  0x00  :  0xFF;
+               the middle of transmission. This follows T.31 and T.30 practice. Nothing
+               more can arrive during this call, so the rest of the chunk is fill. */
+            n = len - i;
+            memset(&buf[i], (s->tx.data_started)  ?  0x00  :  0xFF, n);
         }
     }
     s->audio.bit_no = 0;
@@ -2545,6 +2564,19 @@ SPAN_DECLARE(logging_state_t *) t31_get_logging_state(t31_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) t31_get_memory_usage(t31_state_t *s)
+{
+    int size;
+
+    /* The AT interpreter context is part of the T.31 context, so only its buffers are
+       added. */
+    size = sizeof(*s) + at_get_memory_usage(&s->at_state) - sizeof(s->at_state);
+    if (s->rx_queue)
+        size += sizeof(*s->rx_queue) + s->rx_queue->len;
+    return size;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(t38_core_state_t *) t31_get_t38_core_state(t31_state_t *s)
 {
     return &s->t38_fe.t38;
@@ -2613,7 +2645,7 @@ SPAN_DECLARE(t31_state_t *) t31_init(t31_state_t *s,
     alloced = FALSE;
     if (s == NULL)
     {
-        if ((s = (t31_state_t *) malloc(sizeof (*s))) == NULL)
+        if ((s = (t31_state_t *) span_alloc(sizeof (*s))) == NULL)
             return NULL;
         alloced = TRUE;
     }
@@ -2670,7 +2702,7 @@ SPAN_DECLARE(t31_state_t *) t31_init(t31_state_t *s,
     if ((s->rx_queue = queue_init(NULL, 4096, QUEUE_WRITE_ATOMIC | QUEUE_READ_ATOMIC)) == NULL)
     {
         if (alloced)
-            free(s);
+            span_free(s);
         return NULL;
     }
     at_init(&s->at_state, at_tx_handler, at_tx_user_data, t31_modem_control_handler, s);
@@ -2698,7 +2730,7 @@ SPAN_DECLARE(int) t31_release(t31_state_t *s)
 SPAN_DECLARE(int) t31_free(t31_state_t *s)
 {
     t31_release(s);
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -47,6 +47,7 @@
 #include <tiffio.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
 #include "spandsp/bit_operations.h"
 #include "spandsp/t38_core.h"
@@ -325,97 +326,98 @@ static __inline__ int classify_seq_no_offset(int expected, int actual)
 }
 /*- End of function --------------------------------------------------------*/
 
-SPAN_DECLARE(int) t38_core_rx_ifp_packet(t38_core_state_t *s, const uint8_t *buf, int len, uint16_t seq_no)
+static int rx_check_seq_no(t38_core_state_t *s, int seq_no, int log_seq_no, int *missing_from)
+{
+    /* Returns -1 if the packet should be dropped, 0 if it is the one expected, or 1 if
+       some packets before it have been lost. For lost packets, missing_from is set to
+       the first missing sequence number, or -1 if the sequence jumped wildly. */
+    *missing_from = 0;
+    if (!s->check_sequence_numbers)
+        return 0;
+    seq_no &= 0xFFFF;
+    if (seq_no == s->rx_expected_seq_no)
+        return 0;
+    /* An expected value of -1 indicates this is the first received packet, and will accept
+       anything for that. We can't assume they will start from zero, even though they should. */
+    if (s->rx_expected_seq_no == -1)
+    {
+        s->rx_expected_seq_no = seq_no;
+        return 0;
+    }
+    /* We have a packet with a serial number that is not in sequence. The cause could be:
+        - 1. a repeat copy of a recent packet. Many T.38 implementations can preduce quite a lot of these.
+        - 2. a late packet, whose point in the sequence we have already passed.
+        - 3. the result of a hop in the sequence numbers cause by something weird from the other
+             end. Stream switching might cause this
+        - 4. missing packets.
+
+        In cases 1 and 2 we need to drop this packet. In case 2 it might make sense to try to do
+        something with it in the terminal case. Currently we don't. For gateway operation it will be
+        too late to do anything useful.
+     */
+    if (((seq_no + 1) & 0xFFFF) == s->rx_expected_seq_no)
+    {
+        /* Assume this is truly a repeat packet, and don't bother checking its contents. */
+        span_log(&s->logging, SPAN_LOG_FLOW, "Rx %5d: Repeat packet number\n", log_seq_no);
+        return -1;
+    }
+    /* Distinguish between a little bit out of sequence, and a huge hop. */
+    switch (classify_seq_no_offset(s->rx_expected_seq_no, seq_no))
+    {
+    case -1:
+        /* This packet is in the near past, so its late. */
+        span_log(&s->logging, SPAN_LOG_FLOW, "Rx %5d: Late packet - expected %d\n", log_seq_no, s->rx_expected_seq_no);
+        return -1;
+    case 1:
+        /* This packet is in the near future, so some packets have been lost */
+        span_log(&s->logging, SPAN_LOG_FLOW, "Rx %5d: Missing from %d\n", log_seq_no, s->rx_expected_seq_no);
+        *missing_from = s->rx_expected_seq_no;
+        s->missing_packets += (seq_no - s->rx_expected_seq_no);
+        break;
+    default:
+        /* The sequence has jumped wildly */
+        span_log(&s->logging, SPAN_LOG_FLOW, "Rx %5d: Sequence restart\n", log_seq_no);
+        *missing_from = -1;
+        s->missing_packets++;
+        break;
+    }
+    s->rx_expected_seq_no = seq_no;
+    return 1;
+}
+/*- End of function --------------------------------------------------------*/
+
+typedef int (rx_field_handler_t)(t38_core_state_t *s, void *user_data, const t38_rx_field_t *field);
+
+static int rx_decode_ifp(t38_core_state_t *s,
+                         const uint8_t *buf,
+                         int len,
+                         int log_seq_no,
+                         rx_field_handler_t *handler,
+                         void *user_data)
 {
     int i;
-    int t30_indicator;
-    int t30_data;
     int ptr;
     int other_half;
     int numocts;
-    int log_seq_no;
-    const uint8_t *msg;
     unsigned int count;
     unsigned int t30_field_type;
     uint8_t type;
     uint8_t data_field_present;
     uint8_t field_data_present;
-    char tag[20];
+    t38_rx_field_t field;
 
-    log_seq_no = (s->check_sequence_numbers)  ?  seq_no  :  s->rx_expected_seq_no;
-
-    if (span_log_test(&s->logging, SPAN_LOG_FLOW))
-    {
-        sprintf(tag, "Rx %5d: IFP", log_seq_no);
-        span_log_buf(&s->logging, SPAN_LOG_FLOW, tag, buf, len);
-    }
-    if (len < 1)
-    {
-        span_log(&s->logging, SPAN_LOG_PROTOCOL_WARNING, "Rx %5d: Bad packet length - %d\n", log_seq_no, len);
-        return -1;
-    }
-    if (s->check_sequence_numbers)
-    {
-        seq_no &= 0xFFFF;
-        if (seq_no != s->rx_expected_seq_no)
-        {
-            /* An expected value of -1 indicates this is the first received packet, and will accept
-               anything for that. We can't assume they will start from zero, even though they should. */
-            if (s->rx_expected_seq_no != -1)
-            {
-                /* We have a packet with a serial number that is not in sequence. The cause could be:
-                    - 1. a repeat copy of a recent packet. Many T.38 implementations can preduce quite a lot of these.
-                    - 2. a late packet, whose point in the sequence we have already passed.
-                    - 3. the result of a hop in the sequence numbers cause by something weird from the other
-                         end. Stream switching might cause this
-                    - 4. missing packets.
-    
-                    In cases 1 and 2 we need to drop this packet. In case 2 it might make sense to try to do
-                    something with it in the terminal case. Currently we don't. For gateway operation it will be
-                    too late to do anything useful.
-                 */
-                if (((seq_no + 1) & 0xFFFF) == s->rx_expected_seq_no)
-                {
-                    /* Assume this is truly a repeat packet, and don't bother checking its contents. */
-                    span_log(&s->logging, SPAN_LOG_FLOW, "Rx %5d: Repeat packet number\n", log_seq_no);
-                    return 0;
-                }
-                /* Distinguish between a little bit out of sequence, and a huge hop. */
-                switch (classify_seq_no_offset(s->rx_expected_seq_no, seq_no))
-                {
-                case -1:
-                    /* This packet is in the near past, so its late. */
-                    span_log(&s->logging, SPAN_LOG_FLOW, "Rx %5d: Late packet - expected %d\n", log_seq_no, s->rx_expected_seq_no);
-                    return 0;
-                case 1:
-                    /* This packet is in the near future, so some packets have been lost */
-                    span_log(&s->logging, SPAN_LOG_FLOW, "Rx %5d: Missing from %d\n", log_seq_no, s->rx_expected_seq_no);
-                    s->rx_missing_handler(s, s->rx_user_data, s->rx_expected_seq_no, seq_no);
-                    s->missing_packets += (seq_no - s->rx_expected_seq_no);
-                    break;
-                default:
-                    /* The sequence has jumped wildly */
-                    span_log(&s->logging, SPAN_LOG_FLOW, "Rx %5d: Sequence restart\n", log_seq_no);
-                    s->rx_missing_handler(s, s->rx_user_data, -1, -1);
-                    s->missing_packets++;
-                    break;
-                }
-            }
-            s->rx_expected_seq_no = seq_no;
-        }
-    }
-    /* The sequence numbering is defined as rolling from 0xFFFF to 0x0000. Some implementations
-       of T.38 roll from 0xFFFF to 0x0001. Isn't standardisation a wonderful thing? The T.38
-       document specifies only a small fraction of what it should, yet then they actually nail
-       something properly, people ignore it. Developers in this industry truly deserves the ****
-       **** **** **** **** **** documents they have to live with. Anyway, when the far end has a
-       broken rollover behaviour we will get a hiccup at the rollover point. Don't worry too
-       much. We will just treat the message in progress as one with some missing data. With any
-       luck a retry will ride over the problem. Rollovers don't occur that often. It takes quite
-       a few FAX pages to reach rollover. */
-    s->rx_expected_seq_no = (s->rx_expected_seq_no + 1) & 0xFFFF;
+    /* Decode the packet, passing each of its fields to the handler in turn. This returns
+       -1 for a bad packet, or -2 if the handler refuses a field. In either case, the
+       fields before the problem have already been handled. */
     data_field_present = (buf[0] >> 7) & 1;
     type = (buf[0] >> 6) & 1;
+    field.type = type;
+    field.indicator = -1;
+    field.data_type = -1;
+    field.field_type = -1;
+    field.field = NULL;
+    field.field_len = 0;
+    field.missing_from = 0;
     ptr = 0;
     switch (type)
     {
@@ -437,10 +439,10 @@ SPAN_DECLARE(int) t38_core_rx_ifp_packet(t38_core_state_t *s, const uint8_t *buf
                 span_log(&s->logging, SPAN_LOG_PROTOCOL_WARNING, "Rx %5d: Invalid length for indicator (A)\n", log_seq_no);
                 return -1;
             }
-            t30_indicator = T38_IND_V8_ANSAM + (((buf[0] << 2) & 0x3C) | ((buf[1] >> 6) & 0x3));
-            if (t30_indicator > T38_IND_V33_14400_TRAINING)
+            field.indicator = T38_IND_V8_ANSAM + (((buf[0] << 2) & 0x3C) | ((buf[1] >> 6) & 0x3));
+            if (field.indicator > T38_IND_V33_14400_TRAINING)
             {
-                span_log(&s->logging, SPAN_LOG_PROTOCOL_WARNING, "Rx %5d: Unknown indicator - %d\n", log_seq_no, t30_indicator);
+                span_log(&s->logging, SPAN_LOG_PROTOCOL_WARNING, "Rx %5d: Unknown indicator - %d\n", log_seq_no, field.indicator);
                 return -1;
             }
         }
@@ -451,13 +453,14 @@ SPAN_DECLARE(int) t38_core_rx_ifp_packet(t38_core_state_t *s, const uint8_t *buf
                 span_log(&s->logging, SPAN_LOG_PROTOCOL_WARNING, "Rx %5d: Invalid length for indicator (B)\n", log_seq_no);
                 return -1;
             }
-            t30_indicator = (buf[0] >> 1) & 0xF;
+            field.indicator = (buf[0] >> 1) & 0xF;
         }
-        span_log(&s->logging, SPAN_LOG_FLOW, "Rx %5d: indicator %s\n", log_seq_no, t38_indicator_to_str(t30_indicator));
-        s->rx_indicator_handler(s, s->rx_user_data, t30_indicator);
+        span_log(&s->logging, SPAN_LOG_FLOW, "Rx %5d: indicator %s\n", log_seq_no, t38_indicator_to_str(field.indicator));
+        if (handler(s, user_data, &field))
+            return -2;
         /* This must come after the indicator handler, so the handler routine sees the existing state of the
            indicator. */
-        s->current_rx_indicator = t30_indicator;
+        s->current_rx_indicator = field.indicator;
         break;
     case T38_TYPE_OF_MSG_T30_DATA:
         if ((buf[0] & 0x20))
@@ -468,20 +471,20 @@ SPAN_DECLARE(int) t38_core_rx_ifp_packet(t38_core_state_t *s, const uint8_t *buf
                 span_log(&s->logging, SPAN_LOG_PROTOCOL_WARNING, "Rx %5d: Invalid length for data (A)\n", log_seq_no);
                 return -1;
             }
-            t30_data = T38_DATA_V8 + (((buf[0] << 2) & 0x3C) | ((buf[1] >> 6) & 0x3));
-            if (t30_data > T38_DATA_V33_14400)
+            field.data_type = T38_DATA_V8 + (((buf[0] << 2) & 0x3C) | ((buf[1] >> 6) & 0x3));
+            if (field.data_type > T38_DATA_V33_14400)
             {
-                span_log(&s->logging, SPAN_LOG_PROTOCOL_WARNING, "Rx %5d: Unknown data type - %d\n", log_seq_no, t30_data);
+                span_log(&s->logging, SPAN_LOG_PROTOCOL_WARNING, "Rx %5d: Unknown data type - %d\n", log_seq_no, field.data_type);
                 return -1;
             }
             ptr = 2;
         }
         else
         {
-            t30_data = (buf[0] >> 1) & 0xF;
-            if (t30_data > T38_DATA_V17_14400)
+            field.data_type = (buf[0] >> 1) & 0xF;
+            if (field.data_type > T38_DATA_V17_14400)
             {
-                span_log(&s->logging, SPAN_LOG_PROTOCOL_WARNING, "Rx %5d: Unknown data type - %d\n", log_seq_no, t30_data);
+                span_log(&s->logging, SPAN_LOG_PROTOCOL_WARNING, "Rx %5d: Unknown data type - %d\n", log_seq_no, field.data_type);
                 return -1;
             }
             ptr = 1;
@@ -575,13 +578,13 @@ SPAN_DECLARE(int) t38_core_rx_ifp_packet(t38_core_state_t *s, const uint8_t *buf
                     return -1;
                 }
                 numocts = ((buf[ptr] << 8) | buf[ptr + 1]) + 1;
-                msg = buf + ptr + 2;
+                field.field = buf + ptr + 2;
                 ptr += numocts + 2;
             }
             else
             {
                 numocts = 0;
-                msg = NULL;
+                field.field = NULL;
             }
             if (ptr > len)
             {
@@ -593,11 +596,14 @@ SPAN_DECLARE(int) t38_core_rx_ifp_packet(t38_core_state_t *s, const uint8_t *buf
                      "Rx %5d: (%d) data %s/%s + %d byte(s)\n",
                      log_seq_no,
                      i,
-                     t38_data_type_to_str(t30_data),
+                     t38_data_type_to_str(field.data_type),
                      t38_field_type_to_str(t30_field_type),
                      numocts);
-            s->rx_data_handler(s, s->rx_user_data, t30_data, t30_field_type, msg, numocts);
-            s->current_rx_data_type = t30_data;
+            field.field_type = t30_field_type;
+            field.field_len = numocts;
+            if (handler(s, user_data, &field))
+                return -2;
+            s->current_rx_data_type = field.data_type;
             s->current_rx_field_type = t30_field_type;
         }
         if (ptr != len)
@@ -614,6 +620,169 @@ SPAN_DECLARE(int) t38_core_rx_ifp_packet(t38_core_state_t *s, const uint8_t *buf
 }
 /*- End of function --------------------------------------------------------*/
 
+static int rx_field_to_handlers(t38_core_state_t *s, void *user_data, const t38_rx_field_t *field)
+{
+    if (field->type == T38_TYPE_OF_MSG_T30_INDICATOR)
+        s->rx_indicator_handler(s, s->rx_user_data, field->indicator);
+    else
+        s->rx_data_handler(s, s->rx_user_data, field->data_type, field->field_type, field->field, field->field_len);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t38_core_rx_ifp_packet(t38_core_state_t *s, const uint8_t *buf, int len, uint16_t seq_no)
+{
+    int log_seq_no;
+    int missing_from;
+    char tag[20];
+
+    log_seq_no = (s->check_sequence_numbers)  ?  seq_no  :  s->rx_expected_seq_no;
+
+    if (span_log_test(&s->logging, SPAN_LOG_FLOW))
+    {
+        sprintf(tag, "Rx %5d: IFP", log_seq_no);
+        span_log_buf(&s->logging, SPAN_LOG_FLOW, tag, buf, len);
+    }
+    if (len < 1)
+    {
+        span_log(&s->logging, SPAN_LOG_PROTOCOL_WARNING, "Rx %5d: Bad packet length - %d\n", log_seq_no, len);
+        return -1;
+    }
+    switch (rx_check_seq_no(s, seq_no, log_seq_no, &missing_from))
+    {
+    case -1:
+        return 0;
+    case 1:
+        if (missing_from < 0)
+            s->rx_missing_handler(s, s->rx_user_data, -1, -1);
+        else
+            s->rx_missing_handler(s, s->rx_user_data, missing_from, seq_no);
+        break;
+    }
+    /* The sequence numbering is defined as rolling from 0xFFFF to 0x0000. Some implementations
+       of T.38 roll from 0xFFFF to 0x0001. Isn't standardisation a wonderful thing? The T.38
+       document specifies only a small fraction of what it should, yet then they actually nail
+       something properly, people ignore it. Developers in this industry truly deserves the ****
+       **** **** **** **** **** documents they have to live with. Anyway, when the far end has a
+       broken rollover behaviour we will get a hiccup at the rollover point. Don't worry too
+       much. We will just treat the message in progress as one with some missing data. With any
+       luck a retry will ride over the problem. Rollovers don't occur that often. It takes quite
+       a few FAX pages to reach rollover. */
+    s->rx_expected_seq_no = (s->rx_expected_seq_no + 1) & 0xFFFF;
+    if (rx_decode_ifp(s, buf, len, log_seq_no, rx_field_to_handlers, NULL))
+        return -1;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+typedef struct
+{
+    t38_rx_field_t *field;
+    int max_fields;
+    int fields;
+    int packet;
+    int seq_no;
+} rx_field_list_t;
+
+static int rx_field_to_list(t38_core_state_t *s, void *user_data, const t38_rx_field_t *field)
+{
+    rx_field_list_t *list;
+    t38_rx_field_t *f;
+
+    list = (rx_field_list_t *) user_data;
+    if (list->fields >= list->max_fields)
+        return -1;
+    f = &list->field[list->fields++];
+    *f = *field;
+    f->packet = list->packet;
+    f->seq_no = list->seq_no;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t38_core_rx_ifp_packets(t38_core_state_t *s,
+                                          const t38_ifp_packet_t pkt[],
+                                          int packets,
+                                          t38_rx_field_t field[],
+                                          int max_fields,
+                                          int *fields)
+{
+    rx_field_list_t list;
+    t38_rx_field_t gap;
+    int i;
+    int status;
+    int log_seq_no;
+    int missing_from;
+    int saved_fields;
+    int saved_expected_seq_no;
+    int saved_missing_packets;
+    int saved_indicator;
+    int saved_data_type;
+    int saved_field_type;
+    char tag[20];
+
+    list.field = field;
+    list.max_fields = max_fields;
+    list.fields = 0;
+    for (i = 0;  i < packets;  i++)
+    {
+        /* If the fields of a packet do not all fit, the context must be left as though
+           the packet had never been seen, so it can be offered again in the next batch. */
+        saved_fields = list.fields;
+        saved_expected_seq_no = s->rx_expected_seq_no;
+        saved_missing_packets = s->missing_packets;
+        saved_indicator = s->current_rx_indicator;
+        saved_data_type = s->current_rx_data_type;
+        saved_field_type = s->current_rx_field_type;
+
+        list.packet = i;
+        list.seq_no = pkt[i].seq_no & 0xFFFF;
+        log_seq_no = (s->check_sequence_numbers)  ?  list.seq_no  :  s->rx_expected_seq_no;
+        if (span_log_test(&s->logging, SPAN_LOG_FLOW))
+        {
+            sprintf(tag, "Rx %5d: IFP", log_seq_no);
+            span_log_buf(&s->logging, SPAN_LOG_FLOW, tag, pkt[i].buf, pkt[i].len);
+        }
+        if (pkt[i].len < 1)
+        {
+            span_log(&s->logging, SPAN_LOG_PROTOCOL_WARNING, "Rx %5d: Bad packet length - %d\n", log_seq_no, pkt[i].len);
+            continue;
+        }
+        status = rx_check_seq_no(s, list.seq_no, log_seq_no, &missing_from);
+        if (status < 0)
+            continue;
+        if (status > 0)
+        {
+            gap.type = T38_RX_FIELD_MISSING;
+            gap.indicator = -1;
+            gap.data_type = -1;
+            gap.field_type = -1;
+            gap.field = NULL;
+            gap.field_len = 0;
+            gap.missing_from = missing_from;
+            if (rx_field_to_list(s, &list, &gap) == 0)
+                status = 0;
+        }
+        if (status == 0)
+        {
+            s->rx_expected_seq_no = (s->rx_expected_seq_no + 1) & 0xFFFF;
+            if (rx_decode_ifp(s, pkt[i].buf, pkt[i].len, log_seq_no, rx_field_to_list, &list) != -2)
+                continue;
+        }
+        /* The field list is full */
+        list.fields = saved_fields;
+        s->rx_expected_seq_no = saved_expected_seq_no;
+        s->missing_packets = saved_missing_packets;
+        s->current_rx_indicator = saved_indicator;
+        s->current_rx_data_type = saved_data_type;
+        s->current_rx_field_type = saved_field_type;
+        break;
+    }
+    *fields = list.fields;
+    return i;
+}
+/*- End of function --------------------------------------------------------*/
+
 static int t38_encode_indicator(t38_core_state_t *s, uint8_t buf[], int indicator)
 {
     int len;
@@ -775,9 +944,60 @@ static int t38_encode_data(t38_core_state_t *s, uint8_t buf[], int data_type, co
 }
 /*- End of function --------------------------------------------------------*/
 
+static int t38_encoded_data_max_len(const t38_data_field_t field[], int fields)
+{
+    int i;
+    int len;
+
+    /* The type of data, plus the field counts, plus the fields themselves */
+    len = 2 + 2*(fields/0x4000 + 2);
+    for (i = 0;  i < fields;  i++)
+        len += 4 + field[i].field_len;
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static uint8_t *tx_packet_space(t38_core_state_t *s, uint8_t buf[], int buf_len, int len)
+{
+    /* Find where a packet of up to len bytes should be built. This is the caller's buffer
+       when batching, or the supplied local buffer when not. */
+    if (s->tx_batch_pkt == NULL)
+        return (len <= buf_len)  ?  buf  :  NULL;
+    if (s->tx_batch_packets >= s->tx_batch_max_packets  ||  s->tx_batch_buf_ptr + len > s->tx_batch_buf_len)
+    {
+        span_log(&s->logging, SPAN_LOG_WARNING, "Tx %5d: Batch full\n", s->tx_seq_no);
+        return NULL;
+    }
+    return s->tx_batch_buf + s->tx_batch_buf_ptr;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void tx_packet(t38_core_state_t *s, const uint8_t buf[], int len, int count)
+{
+    t38_ifp_packet_t *pkt;
+
+    if (s->tx_batch_pkt == NULL)
+    {
+        s->tx_packet_handler(s, s->tx_packet_user_data, buf, len, count);
+    }
+    else
+    {
+        /* The packet was built in place, so it just needs to be listed */
+        pkt = &s->tx_batch_pkt[s->tx_batch_packets++];
+        pkt->buf = buf;
+        pkt->len = len;
+        pkt->seq_no = s->tx_seq_no;
+        pkt->count = count;
+        s->tx_batch_buf_ptr += len;
+    }
+    s->tx_seq_no = (s->tx_seq_no + 1) & 0xFFFF;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(int) t38_core_send_indicator(t38_core_state_t *s, int indicator)
 {
-    uint8_t buf[100];
+    uint8_t local_buf[100];
+    uint8_t *buf;
     int len;
     int delay;
     int transmissions;
@@ -793,14 +1013,15 @@ SPAN_DECLARE(int) t38_core_send_indicator(t38_core_state_t *s, int indicator)
         indicator &= 0xFF;
         if (s->category_control[T38_PACKET_CATEGORY_INDICATOR])
         {
+            if ((buf = tx_packet_space(s, local_buf, sizeof(local_buf), 2)) == NULL)
+                return -1;
             if ((len = t38_encode_indicator(s, buf, indicator)) < 0)
             {
                 span_log(&s->logging, SPAN_LOG_FLOW, "T.38 indicator len is %d\n", len);
                 return len;
             }
             span_log(&s->logging, SPAN_LOG_FLOW, "Tx %5d: indicator %s\n", s->tx_seq_no, t38_indicator_to_str(indicator));
-            s->tx_packet_handler(s, s->tx_packet_user_data, buf, len, transmissions);
-            s->tx_seq_no = (s->tx_seq_no + 1) & 0xFFFF;
+            tx_packet(s, buf, len, transmissions);
             delay = modem_startup_time[indicator].training;
             if (s->allow_for_tep)
                 delay += modem_startup_time[indicator].tep;
@@ -826,39 +1047,61 @@ SPAN_DECLARE(int) t38_core_send_training_delay(t38_core_state_t *s, int indicato
 SPAN_DECLARE(int) t38_core_send_data(t38_core_state_t *s, int data_type, int field_type, const uint8_t field[], int field_len, int category)
 {
     t38_data_field_t field0;
-    uint8_t buf[1000];
-    int len;
 
     field0.field_type = field_type;
     field0.field = field;
     field0.field_len = field_len;
-    if ((len = t38_encode_data(s, buf, data_type, &field0, 1)) < 0)
-    {
-        span_log(&s->logging, SPAN_LOG_FLOW, "T.38 data len is %d\n", len);
-        return len;
-    }
-    s->tx_packet_handler(s, s->tx_packet_user_data, buf, len, s->category_control[category]);
-    s->tx_seq_no = (s->tx_seq_no + 1) & 0xFFFF;
-    return 0;
+    return t38_core_send_data_multi_field(s, data_type, &field0, 1, category);
 }
 /*- End of function --------------------------------------------------------*/
 
 SPAN_DECLARE(int) t38_core_send_data_multi_field(t38_core_state_t *s, int data_type, const t38_data_field_t field[], int fields, int category)
 {
-    uint8_t buf[1000];
+    uint8_t local_buf[1000];
+    uint8_t *buf;
     int len;
 
+    if ((buf = tx_packet_space(s, local_buf, sizeof(local_buf), t38_encoded_data_max_len(field, fields))) == NULL)
+        return -1;
     if ((len = t38_encode_data(s, buf, data_type, field, fields)) < 0)
     {
         span_log(&s->logging, SPAN_LOG_FLOW, "T.38 data len is %d\n", len);
         return len;
     }
-    s->tx_packet_handler(s, s->tx_packet_user_data, buf, len, s->category_control[category]);
-    s->tx_seq_no = (s->tx_seq_no + 1) & 0xFFFF;
+    tx_packet(s, buf, len, s->category_control[category]);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) t38_core_start_tx_batch(t38_core_state_t *s, uint8_t buf[], int len, t38_ifp_packet_t pkt[], int max_packets)
+{
+    if (buf == NULL  ||  pkt == NULL  ||  len < 0  ||  max_packets < 0)
+        return -1;
+    s->tx_batch_buf = buf;
+    s->tx_batch_buf_len = len;
+    s->tx_batch_buf_ptr = 0;
+    s->tx_batch_pkt = pkt;
+    s->tx_batch_max_packets = max_packets;
+    s->tx_batch_packets = 0;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t38_core_end_tx_batch(t38_core_state_t *s)
+{
+    int packets;
+
+    packets = s->tx_batch_packets;
+    s->tx_batch_buf = NULL;
+    s->tx_batch_buf_len = 0;
+    s->tx_batch_buf_ptr = 0;
+    s->tx_batch_pkt = NULL;
+    s->tx_batch_max_packets = 0;
+    s->tx_batch_packets = 0;
+    return packets;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) t38_set_data_rate_management_method(t38_core_state_t *s, int method)
 {
     s->data_rate_management_method = method;
@@ -973,7 +1216,7 @@ SPAN_DECLARE(t38_core_state_t *) t38_core_init(t38_core_state_t *s,
 {
     if (s == NULL)
     {
-        if ((s = (t38_core_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (t38_core_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -1020,7 +1263,7 @@ SPAN_DECLARE(int) t38_core_release(t38_core_state_t *s)
 SPAN_DECLARE(int) t38_core_free(t38_core_state_t *s)
 {
     if (s)
-        free(s);
+        span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -50,6 +50,7 @@
 #include <tiffio.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
 #include "spandsp/queue.h"
 #include "spandsp/dc_restore.h"
@@ -129,6 +130,16 @@
 /*! The number of transmissions of terminating data IFP packets */
 #define DATA_END_TX_COUNT                       3
 
+/*! The level below which the voice phase tone detectors are not run. This is a few dB
+    below the weakest signal any of them will report. */
+#define VOICE_PHASE_MIN_LEVEL_DBM0              -52.0f
+/*! The length of the blocks in which the voice phase audio is screened for FAX signals,
+    before the tone detectors are run (10ms) */
+#define VOICE_PHASE_SCREEN_SAMPLES              80
+/*! The voice phase tone detectors are run while more than 1/VOICE_PHASE_SCREEN_SHARE
+    of each block's energy is at a CNG, CED or V.21 channel 2 frequency. */
+#define VOICE_PHASE_SCREEN_SHARE                2
+
 enum
 {
     DISBIT1 = 0x01,
@@ -146,7 +157,9 @@ enum
     T38_NONE,
     T38_V27TER_RX,
     T38_V29_RX,
-    T38_V17_RX
+    T38_V17_RX,
+    /* The DCS did not name a fast modem we know, so any of them might be used */
+    T38_ANY_RX
 };
 
 enum
@@ -191,43 +204,48 @@ static int process_rx_indicator(t38_core_state_t *t, void *user_data, int indica
 static void hdlc_underflow_handler(void *user_data);
 static void to_t38_buffer_init(t38_gateway_to_t38_state_t *s);
 static void t38_hdlc_rx_put_bit(hdlc_rx_state_t *t, int new_bit);
+static void t38_hdlc_rx_put_bits(hdlc_rx_state_t *t, unsigned int bits, int nbits);
 static void non_ecm_put_bit(void *user_data, int bit);
+static void non_ecm_put_bits(void *user_data, unsigned int bits, int nbits);
 static void non_ecm_remove_fill_and_put_bit(void *user_data, int bit);
+static void non_ecm_remove_fill_and_put_bits(void *user_data, unsigned int bits, int nbits);
 static void non_ecm_push_residue(t38_gateway_state_t *s);
+static void remove_fill_and_put_one_bit(t38_gateway_state_t *t, int bit);
 static void tone_detected(void *user_data, int tone, int level, int delay);
+static int start_modems(t38_gateway_state_t *s);
 
 static void set_rx_handler(t38_gateway_state_t *s, span_rx_handler_t *handler, span_rx_fillin_handler_t *fillin_handler, void *user_data)
 {
-    if (s->audio.modems.rx_handler != span_dummy_rx)
+    if (s->audio.modems->rx_handler != span_dummy_rx)
     {
-        s->audio.modems.rx_handler = handler;
-        s->audio.modems.rx_fillin_handler = fillin_handler;
+        s->audio.modems->rx_handler = handler;
+        s->audio.modems->rx_fillin_handler = fillin_handler;
     }
     /*endif*/
     s->audio.base_rx_handler = handler;
     s->audio.base_rx_fillin_handler = fillin_handler;
-    s->audio.modems.rx_user_data = user_data;
+    s->audio.modems->rx_user_data = user_data;
 }
 /*- End of function --------------------------------------------------------*/
 
 static void set_tx_handler(t38_gateway_state_t *s, span_tx_handler_t *handler, void *user_data)
 {
-    s->audio.modems.tx_handler = handler;
-    s->audio.modems.tx_user_data = user_data;
+    s->audio.modems->tx_handler = handler;
+    s->audio.modems->tx_user_data = user_data;
 }
 /*- End of function --------------------------------------------------------*/
 
 static void set_next_tx_handler(t38_gateway_state_t *s, span_tx_handler_t *handler, void *user_data)
 {
-    s->audio.modems.next_tx_handler = handler;
-    s->audio.modems.next_tx_user_data = user_data;
+    s->audio.modems->next_tx_handler = handler;
+    s->audio.modems->next_tx_user_data = user_data;
 }
 /*- End of function --------------------------------------------------------*/
 
 static void set_rx_active(t38_gateway_state_t *s, int active)
 {
-    s->audio.modems.rx_handler = (active)  ?  s->audio.base_rx_handler  :  span_dummy_rx;
-    s->audio.modems.rx_fillin_handler = (active)  ?  s->audio.base_rx_fillin_handler  :  span_dummy_rx_fillin;
+    s->audio.modems->rx_handler = (active)  ?  s->audio.base_rx_handler  :  span_dummy_rx;
+    s->audio.modems->rx_fillin_handler = (active)  ?  s->audio.base_rx_fillin_handler  :  span_dummy_rx_fillin;
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -237,7 +255,7 @@ static int v17_v21_rx_fillin(void *user_data, int len)
     fax_modems_state_t *s;
 
     t = (t38_gateway_state_t *) user_data;
-    s = &t->audio.modems;
+    s = t->audio.modems;
     v17_rx_fillin(&s->v17_rx, len);
     fsk_rx_fillin(&s->v21_rx, len);
     return 0;
@@ -250,7 +268,7 @@ static int v17_v21_rx(void *user_data, const int16_t amp[], int len)
     fax_modems_state_t *s;
 
     t = (t38_gateway_state_t *) user_data;
-    s = &t->audio.modems;
+    s = t->audio.modems;
     v17_rx(&s->v17_rx, amp, len);
     if (s->rx_trained)
     {
@@ -280,7 +298,7 @@ static int v27ter_v21_rx_fillin(void *user_data, int len)
     fax_modems_state_t *s;
 
     t = (t38_gateway_state_t *) user_data;
-    s = &t->audio.modems;
+    s = t->audio.modems;
     v27ter_rx_fillin(&s->v27ter_rx, len);
     fsk_rx_fillin(&s->v21_rx, len);
     return 0;
@@ -293,7 +311,7 @@ static int v27ter_v21_rx(void *user_data, const int16_t amp[], int len)
     fax_modems_state_t *s;
 
     t = (t38_gateway_state_t *) user_data;
-    s = &t->audio.modems;
+    s = t->audio.modems;
     v27ter_rx(&s->v27ter_rx, amp, len);
     if (s->rx_trained)
     {
@@ -323,7 +341,7 @@ static int v29_v21_rx_fillin(void *user_data, int len)
     fax_modems_state_t *s;
 
     t = (t38_gateway_state_t *) user_data;
-    s = &t->audio.modems;
+    s = t->audio.modems;
     v29_rx_fillin(&s->v29_rx, len);
     fsk_rx_fillin(&s->v21_rx, len);
     return 0;
@@ -336,7 +354,7 @@ static int v29_v21_rx(void *user_data, const int16_t amp[], int len)
     fax_modems_state_t *s;
 
     t = (t38_gateway_state_t *) user_data;
-    s = &t->audio.modems;
+    s = t->audio.modems;
     v29_rx(&s->v29_rx, amp, len);
     if (s->rx_trained)
     {
@@ -360,6 +378,55 @@ static int v29_v21_rx(void *user_data, const int16_t amp[], int len)
 }
 /*- End of function --------------------------------------------------------*/
 
+static int any_v21_rx_fillin(void *user_data, int len)
+{
+    t38_gateway_state_t *t;
+
+    t = (t38_gateway_state_t *) user_data;
+    fax_modems_multi_rx_fillin(t->audio.modems, len);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int any_v21_rx(void *user_data, const int16_t amp[], int len)
+{
+    t38_gateway_state_t *t;
+    fax_modems_state_t *s;
+
+    t = (t38_gateway_state_t *) user_data;
+    s = t->audio.modems;
+    fax_modems_multi_rx(s, amp, len);
+    if (s->rx_trained)
+    {
+        /* One of the fast modems has trained, so we no longer need to run the
+           others, or the slow one, in parallel. */
+        switch (s->multi_rx_trained)
+        {
+        case FAX_MODEMS_MULTI_RX_V17:
+            span_log(&t->logging, SPAN_LOG_FLOW, "Switching from all modems to V.17 (%.2fdBm0)\n", v17_rx_signal_power(&s->v17_rx));
+            set_rx_handler(t, (span_rx_handler_t *) &v17_rx, (span_rx_fillin_handler_t *) &v17_rx_fillin, &s->v17_rx);
+            break;
+        case FAX_MODEMS_MULTI_RX_V27TER:
+            span_log(&t->logging, SPAN_LOG_FLOW, "Switching from all modems to V.27ter (%.2fdBm0)\n", v27ter_rx_signal_power(&s->v27ter_rx));
+            set_rx_handler(t, (span_rx_handler_t *) &v27ter_rx, (span_rx_fillin_handler_t *) &v27ter_rx_fillin, &s->v27ter_rx);
+            break;
+        case FAX_MODEMS_MULTI_RX_V29:
+            span_log(&t->logging, SPAN_LOG_FLOW, "Switching from all modems to V.29 (%.2fdBm0)\n", v29_rx_signal_power(&s->v29_rx));
+            set_rx_handler(t, (span_rx_handler_t *) &v29_rx, (span_rx_fillin_handler_t *) &v29_rx_fillin, &s->v29_rx);
+            break;
+        }
+        /*endswitch*/
+    }
+    else if (s->rx_signal_present)
+    {
+        span_log(&t->logging, SPAN_LOG_FLOW, "Switching from all modems to V.21 (%.2fdBm0)\n", fsk_rx_signal_power(&s->v21_rx));
+        set_rx_handler(t, (span_rx_handler_t *) &fsk_rx, (span_rx_fillin_handler_t *) &fsk_rx_fillin, &s->v21_rx);
+    }
+    /*endif*/
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
 static void tone_detected(void *user_data, int tone, int level, int delay)
 {
     t38_gateway_state_t *s;
@@ -369,6 +436,149 @@ static void tone_detected(void *user_data, int tone, int level, int delay)
 }
 /*- End of function --------------------------------------------------------*/
 
+static void voice_phase_tone_detected(void *user_data, int tone, int level, int delay)
+{
+    t38_gateway_state_t *s;
+
+    s = (t38_gateway_state_t *) user_data;
+    if (tone == MODEM_CONNECT_TONES_NONE)
+        return;
+    /*endif*/
+    span_log(&s->logging, SPAN_LOG_FLOW, "%s detected (%ddBm0) in the voice phase\n", modem_connect_tone_to_str(tone), level);
+    /* This looks like a FAX call, so we need the modems from here on. */
+    s->audio.voice_phase = FALSE;
+    start_modems(s);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void voice_phase_reset_detectors(t38_gateway_state_t *s)
+{
+    modem_connect_tones_rx_init(&s->audio.cng_rx, MODEM_CONNECT_TONES_FAX_CNG, voice_phase_tone_detected, s);
+    modem_connect_tones_rx_init(&s->audio.ced_rx, MODEM_CONNECT_TONES_FAX_CED_OR_PREAMBLE, voice_phase_tone_detected, s);
+}
+/*- End of function --------------------------------------------------------*/
+
+static int voice_phase_screen_block(t38_gateway_state_t *s)
+{
+#if defined(SPANDSP_USE_FIXED_POINT)
+    int64_t power[4];
+    int64_t threshold;
+#else
+    float power[4];
+    float threshold;
+#endif
+    int64_t energy;
+    int i;
+
+    for (i = 0;  i < 4;  i++)
+        power[i] = goertzel_result(&s->audio.screen[i]);
+    /*endfor*/
+    energy = s->audio.screen_energy;
+    s->audio.screen_energy = 0;
+    s->audio.screen_samples = 0;
+    if (energy < (int64_t) s->audio.voice_phase_min_power*VOICE_PHASE_SCREEN_SAMPLES)
+        return FALSE;
+    /*endif*/
+    /* A steady tone puts VOICE_PHASE_SCREEN_SAMPLES times the block's energy into the
+       Goertzel result for its frequency. The V.21 signal hops between its two
+       frequencies, so those results are taken together. */
+#if defined(SPANDSP_USE_FIXED_POINT)
+    threshold = (energy*VOICE_PHASE_SCREEN_SAMPLES/VOICE_PHASE_SCREEN_SHARE) >> 14;
+#else
+    threshold = (float) energy*VOICE_PHASE_SCREEN_SAMPLES/VOICE_PHASE_SCREEN_SHARE;
+#endif
+    return (power[0] > threshold  ||  power[1] > threshold  ||  power[2] + power[3] > threshold);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void voice_phase_rx(t38_gateway_state_t *s, const int16_t amp[], int len)
+{
+#if defined(SPANDSP_USE_FIXED_POINT)
+    int16_t xamp;
+#else
+    float xamp;
+#endif
+    int64_t energy;
+    int i;
+    int j;
+    int n;
+    int passed;
+
+    /* We are in the voice phase, and have no modems yet. Just look for the tones which
+       say this is a FAX call. The full detectors are costly, so the audio is first
+       screened, in 10ms blocks, by Goertzel filters at the CNG, CED and V.21 channel 2
+       frequencies. The detectors only run while most of the energy in each block is at
+       one of those frequencies, which is seldom the case for speech. Audio too quiet
+       for the detectors to find anything, which is most of the time in the gaps in
+       speech, is not even screened. */
+    energy = 0;
+    for (i = 0;  i < len;  i++)
+        energy += amp[i]*amp[i];
+    /*endfor*/
+    if (energy < (int64_t) s->audio.voice_phase_min_power*len)
+    {
+        if (s->audio.screen_passed)
+        {
+            voice_phase_reset_detectors(s);
+            s->audio.screen_passed = FALSE;
+        }
+        /*endif*/
+        for (i = 0;  i < 4;  i++)
+            goertzel_reset(&s->audio.screen[i]);
+        /*endfor*/
+        s->audio.screen_energy = 0;
+        s->audio.screen_samples = 0;
+        return;
+    }
+    /*endif*/
+    for (i = 0;  i < len;  i += n)
+    {
+        n = VOICE_PHASE_SCREEN_SAMPLES - s->audio.screen_samples;
+        if (n > len - i)
+            n = len - i;
+        /*endif*/
+        energy = 0;
+        for (j = i;  j < i + n;  j++)
+        {
+            xamp = goertzel_preadjust_amp(amp[j]);
+            goertzel_samplex(&s->audio.screen[0], xamp);
+            goertzel_samplex(&s->audio.screen[1], xamp);
+            goertzel_samplex(&s->audio.screen[2], xamp);
+            goertzel_samplex(&s->audio.screen[3], xamp);
+            energy += amp[j]*amp[j];
+        }
+        /*endfor*/
+        s->audio.screen_energy += energy;
+        s->audio.screen_samples += n;
+        if (s->audio.screen_passed)
+        {
+            /* Either detector may start the modems, which ends the voice phase. */
+            modem_connect_tones_rx(&s->audio.cng_rx, &amp[i], n);
+            if (s->audio.modems)
+                return;
+            /*endif*/
+            modem_connect_tones_rx(&s->audio.ced_rx, &amp[i], n);
+            if (s->audio.modems)
+                return;
+            /*endif*/
+        }
+        /*endif*/
+        if (s->audio.screen_samples >= VOICE_PHASE_SCREEN_SAMPLES)
+        {
+            passed = voice_phase_screen_block(s);
+            /* When the detectors stop, they are started afresh, so separate bursts of
+               a signal are never joined together into one. */
+            if (s->audio.screen_passed  &&  !passed)
+                voice_phase_reset_detectors(s);
+            /*endif*/
+            s->audio.screen_passed = passed;
+        }
+        /*endif*/
+    }
+    /*endfor*/
+}
+/*- End of function --------------------------------------------------------*/
+
 static void hdlc_underflow_handler(void *user_data)
 {
     t38_gateway_state_t *s;
@@ -393,7 +603,7 @@ static void hdlc_underflow_handler(void *user_data)
         {
             /* The next thing in the queue is an indicator, so we need to stop this modem. */
             span_log(&s->logging, SPAN_LOG_FLOW, "HDLC shutdown\n");
-            hdlc_tx_frame(&s->audio.modems.hdlc_tx, NULL, 0);
+            hdlc_tx_frame(&s->audio.modems->hdlc_tx, NULL, 0);
         }
         else if ((t->buf[t->out].contents & FLAG_DATA))
         {
@@ -403,9 +613,9 @@ static void hdlc_underflow_handler(void *user_data)
                 /* This frame is ready to go, and uses the same modem we are running now. So, send
                    whatever we have. This might or might not be an entire frame. */
                 span_log(&s->logging, SPAN_LOG_FLOW, "HDLC start next frame\n");
-                hdlc_tx_frame(&s->audio.modems.hdlc_tx, t->buf[t->out].buf, t->buf[t->out].len);
+                hdlc_tx_frame(&s->audio.modems->hdlc_tx, t->buf[t->out].buf, t->buf[t->out].len);
                 if ((t->buf[t->out].flags & HDLC_FLAG_CORRUPT_CRC))
-                    hdlc_tx_corrupt_frame(&s->audio.modems.hdlc_tx);
+                    hdlc_tx_corrupt_frame(&s->audio.modems->hdlc_tx);
                 /*endif*/
             }
             /*endif*/
@@ -419,14 +629,15 @@ static void hdlc_underflow_handler(void *user_data)
 static int set_next_tx_type(t38_gateway_state_t *s)
 {
     get_bit_func_t get_bit_func;
+    get_bits_func_t get_bits_func;
     void *get_bit_user_data;
     int indicator;
     int short_train;
     fax_modems_state_t *t;
     t38_gateway_hdlc_state_t *u;
 
-    t = &s->audio.modems;
-    t38_non_ecm_buffer_report_output_status(&s->core.non_ecm_to_modem, &s->logging);
+    t = s->audio.modems;
+    t38_non_ecm_buffer_report_output_status(s->core.non_ecm_to_modem, &s->logging);
     if (t->next_tx_handler)
     {
         /* There is a handler queued, so that is the next one. */
@@ -466,13 +677,15 @@ static int set_next_tx_type(t38_gateway_state_t *s)
         span_log(&s->logging, SPAN_LOG_FLOW, "HDLC mode\n");
         hdlc_tx_init(&t->hdlc_tx, FALSE, 2, TRUE, hdlc_underflow_handler, s);
         get_bit_func = (get_bit_func_t) hdlc_tx_get_bit;
+        get_bits_func = (get_bits_func_t) hdlc_tx_get_bits;
         get_bit_user_data = (void *) &t->hdlc_tx;
     }
     else
     {
         span_log(&s->logging, SPAN_LOG_FLOW, "Non-ECM mode\n");
         get_bit_func = t38_non_ecm_buffer_get_bit;
-        get_bit_user_data = (void *) &s->core.non_ecm_to_modem;
+        get_bits_func = t38_non_ecm_buffer_get_bits;
+        get_bit_user_data = (void *) s->core.non_ecm_to_modem;
     }
     /*endif*/
     switch (indicator)
@@ -507,6 +720,7 @@ static int set_next_tx_type(t38_gateway_state_t *s)
         silence_gen_alter(&t->silence_gen, ms_to_samples(75));
         u->buf[u->in].len = 0;
         fsk_tx_init(&t->v21_tx, &preset_fsk_specs[FSK_V21CH2], (get_bit_func_t) hdlc_tx_get_bit, &t->hdlc_tx);
+        fsk_tx_set_get_bits(&t->v21_tx, (get_bits_func_t) hdlc_tx_get_bits);
         set_tx_handler(s, (span_tx_handler_t *) &silence_gen, &t->silence_gen);
         set_next_tx_handler(s, (span_tx_handler_t *) &fsk_tx, &t->v21_tx);
         set_rx_active(s, TRUE);
@@ -526,6 +740,7 @@ static int set_next_tx_type(t38_gateway_state_t *s)
         silence_gen_alter(&t->silence_gen, ms_to_samples(75));
         v27ter_tx_restart(&t->v27ter_tx, t->tx_bit_rate, t->use_tep);
         v27ter_tx_set_get_bit(&t->v27ter_tx, get_bit_func, get_bit_user_data);
+        v27ter_tx_set_get_bits(&t->v27ter_tx, get_bits_func);
         set_tx_handler(s, (span_tx_handler_t *) &silence_gen, &t->silence_gen);
         set_next_tx_handler(s, (span_tx_handler_t *) &v27ter_tx, &t->v27ter_tx);
         set_rx_active(s, TRUE);
@@ -545,6 +760,7 @@ static int set_next_tx_type(t38_gateway_state_t *s)
         silence_gen_alter(&t->silence_gen, ms_to_samples(75));
         v29_tx_restart(&t->v29_tx, t->tx_bit_rate, t->use_tep);
         v29_tx_set_get_bit(&t->v29_tx, get_bit_func, get_bit_user_data);
+        v29_tx_set_get_bits(&t->v29_tx, get_bits_func);
         set_tx_handler(s, (span_tx_handler_t *) &silence_gen, &t->silence_gen);
         set_next_tx_handler(s, (span_tx_handler_t *) &v29_tx, &t->v29_tx);
         set_rx_active(s, TRUE);
@@ -593,6 +809,7 @@ static int set_next_tx_type(t38_gateway_state_t *s)
         silence_gen_alter(&t->silence_gen, ms_to_samples(75));
         v17_tx_restart(&t->v17_tx, t->tx_bit_rate, t->use_tep, short_train);
         v17_tx_set_get_bit(&t->v17_tx, get_bit_func, get_bit_user_data);
+        v17_tx_set_get_bits(&t->v17_tx, get_bits_func);
         set_tx_handler(s, (span_tx_handler_t *) &silence_gen, &t->silence_gen);
         set_next_tx_handler(s, (span_tx_handler_t *) &v17_tx, &t->v17_tx);
         set_rx_active(s, TRUE);
@@ -645,11 +862,11 @@ static void finalise_hdlc_frame(t38_gateway_state_t *s, int good_fcs)
         if ((hdlc_buf->flags & HDLC_FLAG_PROCEED_WITH_OUTPUT) == 0)
         {
             /* Output of this frame has not yet begun. Throw it all out now. */
-            hdlc_tx_frame(&s->audio.modems.hdlc_tx, hdlc_buf->buf, hdlc_buf->len);
+            hdlc_tx_frame(&s->audio.modems->hdlc_tx, hdlc_buf->buf, hdlc_buf->len);
         }
         /*endif*/
         if ((hdlc_buf->flags & HDLC_FLAG_CORRUPT_CRC))
-            hdlc_tx_corrupt_frame(&s->audio.modems.hdlc_tx);
+            hdlc_tx_corrupt_frame(&s->audio.modems->hdlc_tx);
         /*endif*/
     }
     /*endif*/
@@ -876,7 +1093,21 @@ static void monitor_control_messages(t38_gateway_state_t *s,
                we are to use. If it comes from the T.38 side the contents do not. */
             s->core.fast_bit_rate = modem_codes[i].bit_rate;
             if (from_modem)
-                s->core.fast_rx_modem = modem_codes[i].modem_type;
+            {
+                if (modem_codes[i].bit_rate)
+                {
+                    s->core.fast_rx_modem = modem_codes[i].modem_type;
+                }
+                else
+                {
+                    /* We cannot tell which modem will be used, so we cannot announce it
+                       ahead of its training. All the fast receivers will be tried, and
+                       whichever trains will be announced. */
+                    s->core.fast_rx_modem = T38_ANY_RX;
+                    s->core.timed_mode = TIMED_MODE_IDLE;
+                }
+                /*endif*/
+            }
             /*endif*/
         }
         /*endif*/
@@ -1049,7 +1280,10 @@ static int process_rx_missing(t38_core_state_t *t, void *user_data, int rx_seq_n
     t38_gateway_state_t *s;
     
     s = (t38_gateway_state_t *) user_data;
-    s->core.hdlc_to_modem.buf[s->core.hdlc_to_modem.in].flags |= HDLC_FLAG_MISSING_DATA;
+    /* In the voice phase there is nothing which could be affected by the loss. */
+    if (s->core.hdlc_to_modem.buf)
+        s->core.hdlc_to_modem.buf[s->core.hdlc_to_modem.in].flags |= HDLC_FLAG_MISSING_DATA;
+    /*endif*/
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -1062,13 +1296,30 @@ static int process_rx_indicator(t38_core_state_t *t, void *user_data, int indica
 
     s = (t38_gateway_state_t *) user_data;
 
-    t38_non_ecm_buffer_report_input_status(&s->core.non_ecm_to_modem, &s->logging);
     if (t->current_rx_indicator == indicator)
     {
         /* This is probably due to the far end repeating itself. Ignore it. Its harmless */
         return 0;
     }
     /*endif*/
+    if (indicator != T38_IND_NO_SIGNAL)
+        s->audio.voice_phase = FALSE;
+    /*endif*/
+    if (s->audio.modems == NULL)
+    {
+        if (indicator == T38_IND_NO_SIGNAL)
+        {
+            /* There is nothing to do about this until we know this is a FAX call. */
+            t->current_rx_indicator = indicator;
+            return 0;
+        }
+        /*endif*/
+        if (start_modems(s))
+            return -1;
+        /*endif*/
+    }
+    /*endif*/
+    t38_non_ecm_buffer_report_input_status(s->core.non_ecm_to_modem, &s->logging);
 
     u = &s->core.hdlc_to_modem;
     immediate = (u->in == u->out);
@@ -1089,7 +1340,7 @@ static int process_rx_indicator(t38_core_state_t *t, void *user_data, int indica
         span_log(&s->logging,
                  SPAN_LOG_FLOW,
                  "Changing - (%d) %s -> %s\n",
-                 silence_gen_remainder(&(s->audio.modems.silence_gen)),
+                 silence_gen_remainder(&(s->audio.modems->silence_gen)),
                  t38_indicator_to_str(t->current_rx_indicator),
                  t38_indicator_to_str(indicator));
         switch (s->t38x.current_rx_field_class)
@@ -1098,7 +1349,7 @@ static int process_rx_indicator(t38_core_state_t *t, void *user_data, int indica
             break;
         case T38_FIELD_CLASS_HDLC:
             span_log(&s->logging, SPAN_LOG_FLOW, "HDLC shutdown\n");
-            hdlc_tx_frame(&s->audio.modems.hdlc_tx, NULL, 0);
+            hdlc_tx_frame(&s->audio.modems->hdlc_tx, NULL, 0);
             break;
         case T38_FIELD_CLASS_NON_ECM:
             break;
@@ -1109,7 +1360,7 @@ static int process_rx_indicator(t38_core_state_t *t, void *user_data, int indica
         span_log(&s->logging,
                  SPAN_LOG_FLOW,
                  "Queued change - (%d) %s -> %s\n",
-                 silence_gen_remainder(&(s->audio.modems.silence_gen)),
+                 silence_gen_remainder(&(s->audio.modems->silence_gen)),
                  t38_indicator_to_str(t->current_rx_indicator),
                  t38_indicator_to_str(indicator));
     }
@@ -1130,6 +1381,10 @@ static int process_rx_data(t38_core_state_t *t, void *user_data, int data_type,
 
     s = (t38_gateway_state_t *) user_data;
     xx = &s->t38x;
+    s->audio.voice_phase = FALSE;
+    if (s->audio.modems == NULL  &&  start_modems(s))
+        return -1;
+    /*endif*/
     /* There are a couple of special cases of data type that need their own treatment. */
     switch (data_type)
     {
@@ -1231,9 +1486,9 @@ static int process_rx_data(t38_core_state_t *t, void *user_data, int data_type,
                 {
                     /* Output is not running, so kick it into life. */
                     if ((hdlc_buf->flags & HDLC_FLAG_PROCEED_WITH_OUTPUT) == 0)
-                        hdlc_tx_frame(&s->audio.modems.hdlc_tx, hdlc_buf->buf, hdlc_buf->len + len);
+                        hdlc_tx_frame(&s->audio.modems->hdlc_tx, hdlc_buf->buf, hdlc_buf->len + len);
                     else
-                        hdlc_tx_frame(&s->audio.modems.hdlc_tx, hdlc_buf->buf + hdlc_buf->len, len);
+                        hdlc_tx_frame(&s->audio.modems->hdlc_tx, hdlc_buf->buf + hdlc_buf->len, len);
                     /*endif*/
                 }
                 /*endif*/
@@ -1446,7 +1701,7 @@ static int process_rx_data(t38_core_state_t *t, void *user_data, int data_type,
             {
                 span_log(&s->logging, SPAN_LOG_WARNING, "T38_FIELD_HDLC_SIG_END received at the end of non-ECM data!\n");
                 /* Don't flow control the data any more. Just pump out the remainder as fast as we can. */
-                t38_non_ecm_buffer_push(&s->core.non_ecm_to_modem);
+                t38_non_ecm_buffer_push(s->core.non_ecm_to_modem);
             }
             else
             {
@@ -1468,7 +1723,7 @@ static int process_rx_data(t38_core_state_t *t, void *user_data, int data_type,
         break;
     case T38_FIELD_T4_NON_ECM_DATA:
         if (xx->current_rx_field_class == T38_FIELD_CLASS_NONE)
-            t38_non_ecm_buffer_set_mode(&s->core.non_ecm_to_modem, s->core.image_data_mode, s->core.min_row_bits);
+            t38_non_ecm_buffer_set_mode(s->core.non_ecm_to_modem, s->core.image_data_mode, s->core.min_row_bits);
         xx->current_rx_field_class = T38_FIELD_CLASS_NON_ECM;
         hdlc_buf = &s->core.hdlc_to_modem.buf[s->core.hdlc_to_modem.in];
         if (hdlc_buf->contents != (data_type | FLAG_DATA))
@@ -1478,13 +1733,13 @@ static int process_rx_data(t38_core_state_t *t, void *user_data, int data_type,
         }
         /*endif*/
         if (len > 0)
-            t38_non_ecm_buffer_inject(&s->core.non_ecm_to_modem, buf, len);
+            t38_non_ecm_buffer_inject(s->core.non_ecm_to_modem, buf, len);
         /*endif*/
         xx->corrupt_current_frame[0] = FALSE;
         break;
     case T38_FIELD_T4_NON_ECM_SIG_END:
         if (xx->current_rx_field_class == T38_FIELD_CLASS_NONE)
-            t38_non_ecm_buffer_set_mode(&s->core.non_ecm_to_modem, s->core.image_data_mode, s->core.min_row_bits);
+            t38_non_ecm_buffer_set_mode(s->core.non_ecm_to_modem, s->core.image_data_mode, s->core.min_row_bits);
         hdlc_buf = &s->core.hdlc_to_modem.buf[s->core.hdlc_to_modem.in];
         /* Some T.38 implementations send multiple T38_FIELD_T4_NON_ECM_SIG_END messages, in IFP packets with
            incrementing sequence numbers, which are actually repeats. They get through to this point because
@@ -1504,7 +1759,7 @@ static int process_rx_data(t38_core_state_t *t, void *user_data, int data_type,
                         hdlc_buf = &s->core.hdlc_to_modem.buf[s->core.hdlc_to_modem.in];
                     }
                     /*endif*/
-                    t38_non_ecm_buffer_inject(&s->core.non_ecm_to_modem, buf, len);
+                    t38_non_ecm_buffer_inject(s->core.non_ecm_to_modem, buf, len);
                 }
                 /*endif*/
                 if (hdlc_buf->contents != (data_type | FLAG_DATA))
@@ -1514,7 +1769,7 @@ static int process_rx_data(t38_core_state_t *t, void *user_data, int data_type,
                 }
                 /*endif*/
                 /* Don't flow control the data any more. Just pump out the remainder as fast as we can. */
-                t38_non_ecm_buffer_push(&s->core.non_ecm_to_modem);
+                t38_non_ecm_buffer_push(s->core.non_ecm_to_modem);
             }
             else
             {
@@ -1589,6 +1844,31 @@ static int set_fast_packetisation(t38_gateway_state_t *s)
     int ind;
 
     ind = T38_IND_NO_SIGNAL;
+    if (s->core.fast_rx_active == T38_ANY_RX)
+    {
+        /* Once one of the fast receivers has trained, we know which modem is in use, and
+           stick with it until the next DCS. */
+        switch (s->audio.modems->multi_rx_trained)
+        {
+        case FAX_MODEMS_MULTI_RX_V17:
+            s->core.fast_rx_active = T38_V17_RX;
+            s->core.fast_bit_rate = s->audio.modems->multi_rx_bit_rate[0];
+            break;
+        case FAX_MODEMS_MULTI_RX_V27TER:
+            s->core.fast_rx_active = T38_V27TER_RX;
+            s->core.fast_bit_rate = s->audio.modems->multi_rx_bit_rate[1];
+            break;
+        case FAX_MODEMS_MULTI_RX_V29:
+            s->core.fast_rx_active = T38_V29_RX;
+            s->core.fast_bit_rate = s->audio.modems->multi_rx_bit_rate[2];
+            break;
+        default:
+            return ind;
+        }
+        /*endswitch*/
+        s->core.fast_rx_modem = s->core.fast_rx_active;
+    }
+    /*endif*/
     switch (s->core.fast_rx_active)
     {
     case T38_V17_RX:
@@ -1687,8 +1967,8 @@ static void non_ecm_rx_status(void *user_data, int status)
         break;
     case SIG_STATUS_TRAINING_SUCCEEDED:
         /* The modem is now trained */
-        s->audio.modems.rx_signal_present = TRUE;
-        s->audio.modems.rx_trained = TRUE;
+        s->audio.modems->rx_signal_present = TRUE;
+        s->audio.modems->rx_trained = TRUE;
         s->core.timed_mode = TIMED_MODE_IDLE;
         s->core.samples_to_timeout = 0;
         s->core.short_train = TRUE;
@@ -1733,6 +2013,8 @@ static void to_t38_buffer_init(t38_gateway_to_t38_state_t *s)
     s->data_ptr = 0;
     s->bit_stream = 0xFFFF;
     s->bit_no = 0;
+    s->raw_bit_stream = 0;
+    s->raw_bit_no = 0;
 
     s->in_bits = 0;
     s->out_octets = 0;
@@ -1744,6 +2026,10 @@ static void non_ecm_push_residue(t38_gateway_state_t *t)
     t38_gateway_to_t38_state_t *s;
 
     s = &t->core.to_t38;
+    /* Clear any bits still waiting to be checked for fill */
+    while (s->raw_bit_no > 0)
+        remove_fill_and_put_one_bit(t, (s->raw_bit_stream >> --s->raw_bit_no) & 1);
+    /*endwhile*/
     if (s->bit_no)
     {
         /* There is a fractional octet in progress. We might as well send every last bit we can. */
@@ -1803,22 +2089,35 @@ static void non_ecm_put_bit(void *user_data, int bit)
 }
 /*- End of function --------------------------------------------------------*/
 
-static void non_ecm_remove_fill_and_put_bit(void *user_data, int bit)
+static void non_ecm_put_bits(void *user_data, unsigned int bits, int nbits)
 {
     t38_gateway_state_t *t;
     t38_gateway_to_t38_state_t *s;
-    
-    if (bit < 0)
-    {
-        non_ecm_rx_status(user_data, bit);
-        return;
-    }
-    /*endif*/
+
     t = (t38_gateway_state_t *) user_data;
     s = &t->core.to_t38;
 
+    s->in_bits += nbits;
+    s->bit_stream = (s->bit_stream << nbits) | bits;
+    s->bit_no += nbits;
+    while (s->bit_no >= 8)
+    {
+        s->bit_no -= 8;
+        s->data[s->data_ptr++] = (uint8_t) (s->bit_stream >> s->bit_no);
+        if (s->data_ptr >= s->octets_per_data_packet)
+            non_ecm_push(t);
+        /*endif*/
+    }
+    /*endwhile*/
+}
+/*- End of function --------------------------------------------------------*/
+
+static void remove_fill_and_put_one_bit(t38_gateway_state_t *t, int bit)
+{
+    t38_gateway_to_t38_state_t *s;
+
+    s = &t->core.to_t38;
     s->bits_absorbed++;
-    bit &= 1;
     /* Drop any extra zero bits when we already have enough for an EOL symbol. */
     /* The snag here is that if we just look for 11 bits, a line ending with
        a code that has trailing zero bits will cause problems. The longest run of
@@ -1851,6 +2150,79 @@ static void non_ecm_remove_fill_and_put_bit(void *user_data, int bit)
 }
 /*- End of function --------------------------------------------------------*/
 
+static void remove_fill_and_put_octet(t38_gateway_state_t *t, int octet)
+{
+    t38_gateway_to_t38_state_t *s;
+    int i;
+
+    s = &t->core.to_t38;
+    /* A bit is only dropped when it is a zero following 14 zeros. If the zeros at the end
+       of the stream so far, and the leading zeros of this octet, cannot make a run that
+       long, the whole octet passes through as it is. A one bit is never dropped, and
+       there are never more than 7 zeros after the first one in an octet. Or'ing with
+       0x4000 limits the trailing zero count to 14, and avoids a zero stream looking like
+       it has -1 trailing zeros. */
+    if (bottom_bit(s->bit_stream | 0x4000) + (7 - top_bit(octet)) <= 14)
+    {
+        s->bits_absorbed += 8;
+        s->bit_stream = (s->bit_stream << 8) | octet;
+        s->data[s->data_ptr++] = (uint8_t) (s->bit_stream >> s->bit_no);
+        if (s->data_ptr >= s->octets_per_data_packet)
+            non_ecm_push(t);
+        /*endif*/
+        return;
+    }
+    /*endif*/
+    for (i = 7;  i >= 0;  i--)
+        remove_fill_and_put_one_bit(t, (octet >> i) & 1);
+    /*endfor*/
+}
+/*- End of function --------------------------------------------------------*/
+
+static void non_ecm_remove_fill_and_put_bit(void *user_data, int bit)
+{
+    t38_gateway_state_t *t;
+    t38_gateway_to_t38_state_t *s;
+    
+    if (bit < 0)
+    {
+        non_ecm_rx_status(user_data, bit);
+        return;
+    }
+    /*endif*/
+    t = (t38_gateway_state_t *) user_data;
+    s = &t->core.to_t38;
+
+    /* Gather whole octets, so most of them can be checked for fill in one go */
+    s->raw_bit_stream = (s->raw_bit_stream << 1) | (bit & 1);
+    if (++s->raw_bit_no >= 8)
+    {
+        remove_fill_and_put_octet(t, s->raw_bit_stream & 0xFF);
+        s->raw_bit_no = 0;
+    }
+    /*endif*/
+}
+/*- End of function --------------------------------------------------------*/
+
+static void non_ecm_remove_fill_and_put_bits(void *user_data, unsigned int bits, int nbits)
+{
+    t38_gateway_state_t *t;
+    t38_gateway_to_t38_state_t *s;
+
+    t = (t38_gateway_state_t *) user_data;
+    s = &t->core.to_t38;
+
+    s->raw_bit_stream = (s->raw_bit_stream << nbits) | bits;
+    s->raw_bit_no += nbits;
+    while (s->raw_bit_no >= 8)
+    {
+        s->raw_bit_no -= 8;
+        remove_fill_and_put_octet(t, (s->raw_bit_stream >> s->raw_bit_no) & 0xFF);
+    }
+    /*endwhile*/
+}
+/*- End of function --------------------------------------------------------*/
+
 static void hdlc_rx_status(hdlc_rx_state_t *t, int status)
 {
     t38_gateway_state_t *s;
@@ -1867,8 +2239,8 @@ static void hdlc_rx_status(hdlc_rx_state_t *t, int status)
         break;
     case SIG_STATUS_TRAINING_SUCCEEDED:
         /* The modem is now trained. */
-        s->audio.modems.rx_signal_present = TRUE;
-        s->audio.modems.rx_trained = TRUE;
+        s->audio.modems->rx_signal_present = TRUE;
+        s->audio.modems->rx_trained = TRUE;
         s->core.short_train = TRUE;
         /* Behave like HDLC preamble has been announced. */
         t->framing_ok_announced = TRUE;
@@ -2016,7 +2388,7 @@ static void rx_flag_or_abort(hdlc_rx_state_t *t)
                 if (s->t38x.current_tx_data_type == T38_DATA_V21)
                 {
                     t38_core_send_indicator(&s->t38x.t38, set_slow_packetisation(s));
-                    s->audio.modems.rx_signal_present = TRUE;
+                    s->audio.modems->rx_signal_present = TRUE;
                 }
                 /*endif*/
                 if (s->t38x.in_progress_rx_indicator == T38_IND_CNG)
@@ -2105,9 +2477,20 @@ static void t38_hdlc_rx_put_bit(hdlc_rx_state_t *t, int new_bit)
 }
 /*- End of function --------------------------------------------------------*/
 
+static void t38_hdlc_rx_put_bits(hdlc_rx_state_t *t, unsigned int bits, int nbits)
+{
+    int i;
+
+    for (i = nbits - 1;  i >= 0;  i--)
+        t38_hdlc_rx_put_bit(t, (bits >> i) & 1);
+    /*endfor*/
+}
+/*- End of function --------------------------------------------------------*/
+
 static int restart_rx_modem(t38_gateway_state_t *s)
 {
     put_bit_func_t put_bit_func;
+    put_bits_func_t put_bits_func;
     void *put_bit_user_data;
 
     if (s->core.to_t38.in_bits  ||  s->core.to_t38.out_octets)
@@ -2128,54 +2511,81 @@ static int restart_rx_modem(t38_gateway_state_t *s)
              s->core.short_train,
              s->core.ecm_mode);
 
-    hdlc_rx_init(&(s->audio.modems.hdlc_rx), FALSE, TRUE, HDLC_FRAMING_OK_THRESHOLD, NULL, s);
-    s->audio.modems.rx_signal_present = FALSE;
-    s->audio.modems.rx_trained = FALSE;
+    hdlc_rx_init(&(s->audio.modems->hdlc_rx), FALSE, TRUE, HDLC_FRAMING_OK_THRESHOLD, NULL, s);
+    s->audio.modems->rx_signal_present = FALSE;
+    s->audio.modems->rx_trained = FALSE;
     /* Default to the transmit data being V.21, unless a faster modem pops up trained. */
     s->t38x.current_tx_data_type = T38_DATA_V21;
-    fsk_rx_init(&(s->audio.modems.v21_rx), &preset_fsk_specs[FSK_V21CH2], FSK_FRAME_MODE_SYNC, (put_bit_func_t) t38_hdlc_rx_put_bit, &(s->audio.modems.hdlc_rx));
+    fsk_rx_init(&(s->audio.modems->v21_rx), &preset_fsk_specs[FSK_V21CH2], FSK_FRAME_MODE_SYNC, (put_bit_func_t) t38_hdlc_rx_put_bit, &(s->audio.modems->hdlc_rx));
+    fsk_rx_set_put_bits(&(s->audio.modems->v21_rx), (put_bits_func_t) t38_hdlc_rx_put_bits);
 #if 0
-    fsk_rx_signal_cutoff(&(s->audio.modems.v21_rx), -45.5f);
+    fsk_rx_signal_cutoff(&(s->audio.modems->v21_rx), -45.5f);
 #endif
     if (s->core.image_data_mode  &&  s->core.ecm_mode)
     {
         put_bit_func = (put_bit_func_t) t38_hdlc_rx_put_bit;
-        put_bit_user_data = (void *) &(s->audio.modems.hdlc_rx);
+        put_bits_func = (put_bits_func_t) t38_hdlc_rx_put_bits;
+        put_bit_user_data = (void *) &(s->audio.modems->hdlc_rx);
     }
     else
     {
         if (s->core.image_data_mode  &&  s->core.to_t38.fill_bit_removal)
+        {
             put_bit_func = non_ecm_remove_fill_and_put_bit;
+            put_bits_func = non_ecm_remove_fill_and_put_bits;
+        }
         else
+        {
             put_bit_func = non_ecm_put_bit;
+            put_bits_func = non_ecm_put_bits;
+        }
         /*endif*/
         put_bit_user_data = (void *) s;
     }
     /*endif*/
     to_t38_buffer_init(&s->core.to_t38);
     s->core.to_t38.octets_per_data_packet = 1;
+    /* The fast receivers report their status through put_bit, unless a previous run of
+       them all in parallel left its status handlers in place. */
+    v17_rx_set_modem_status_handler(&s->audio.modems->v17_rx, NULL, NULL);
+    v27ter_rx_set_modem_status_handler(&s->audio.modems->v27ter_rx, NULL, NULL);
+    v29_rx_set_modem_status_handler(&s->audio.modems->v29_rx, NULL, NULL);
     switch (s->core.fast_rx_modem)
     {
     case T38_V17_RX:
-        v17_rx_restart(&s->audio.modems.v17_rx, s->core.fast_bit_rate, s->core.short_train);
-        v17_rx_set_put_bit(&s->audio.modems.v17_rx, put_bit_func, put_bit_user_data);
+        v17_rx_restart(&s->audio.modems->v17_rx, s->core.fast_bit_rate, s->core.short_train);
+        v17_rx_set_put_bit(&s->audio.modems->v17_rx, put_bit_func, put_bit_user_data);
+        v17_rx_set_put_bits(&s->audio.modems->v17_rx, put_bits_func);
         set_rx_handler(s, &v17_v21_rx, &v17_v21_rx_fillin, s);
         s->core.fast_rx_active = T38_V17_RX;
         break;
     case T38_V27TER_RX:
-        v27ter_rx_restart(&s->audio.modems.v27ter_rx, s->core.fast_bit_rate, FALSE);
-        v27ter_rx_set_put_bit(&s->audio.modems.v27ter_rx, put_bit_func, put_bit_user_data);
+        v27ter_rx_restart(&s->audio.modems->v27ter_rx, s->core.fast_bit_rate, FALSE);
+        v27ter_rx_set_put_bit(&s->audio.modems->v27ter_rx, put_bit_func, put_bit_user_data);
+        v27ter_rx_set_put_bits(&s->audio.modems->v27ter_rx, put_bits_func);
         set_rx_handler(s, &v27ter_v21_rx, &v27ter_v21_rx_fillin, s);
         s->core.fast_rx_active = T38_V27TER_RX;
         break;
     case T38_V29_RX:
-        v29_rx_restart(&s->audio.modems.v29_rx, s->core.fast_bit_rate, FALSE);
-        v29_rx_set_put_bit(&s->audio.modems.v29_rx, put_bit_func, put_bit_user_data);
+        v29_rx_restart(&s->audio.modems->v29_rx, s->core.fast_bit_rate, FALSE);
+        v29_rx_set_put_bit(&s->audio.modems->v29_rx, put_bit_func, put_bit_user_data);
+        v29_rx_set_put_bits(&s->audio.modems->v29_rx, put_bits_func);
         set_rx_handler(s, &v29_v21_rx, &v29_v21_rx_fillin, s);
         s->core.fast_rx_active = T38_V29_RX;
         break;
+    case T38_ANY_RX:
+        v17_rx_set_put_bit(&s->audio.modems->v17_rx, put_bit_func, put_bit_user_data);
+        v17_rx_set_put_bits(&s->audio.modems->v17_rx, put_bits_func);
+        v27ter_rx_set_put_bit(&s->audio.modems->v27ter_rx, put_bit_func, put_bit_user_data);
+        v27ter_rx_set_put_bits(&s->audio.modems->v27ter_rx, put_bits_func);
+        v29_rx_set_put_bit(&s->audio.modems->v29_rx, put_bit_func, put_bit_user_data);
+        v29_rx_set_put_bits(&s->audio.modems->v29_rx, put_bits_func);
+        fax_modems_start_multi_rx_modem(s->audio.modems, 14400, 4800, 9600, s->core.short_train);
+        set_rx_handler(s, &any_v21_rx, &any_v21_rx_fillin, s);
+        s->core.fast_rx_active = T38_ANY_RX;
+        break;
     default:
-        set_rx_handler(s, (span_rx_handler_t *) &fsk_rx, (span_rx_fillin_handler_t *) &fsk_rx_fillin, &(s->audio.modems.v21_rx));
+        set_rx_handler(s, (span_rx_handler_t *) &fsk_rx, (span_rx_fillin_handler_t *) &fsk_rx_fillin, &(s->audio.modems->v21_rx));
         s->core.fast_rx_active = T38_NONE;
         break;
     }
@@ -2226,16 +2636,23 @@ SPAN_DECLARE_NONSTD(int) t38_gateway_rx(t38_gateway_state_t *s, int16_t amp[], i
 {
     int i;
 
+    if (s->audio.modems == NULL)
+    {
+        update_rx_timing(s, len);
+        voice_phase_rx(s, amp, len);
+        return 0;
+    }
+    /*endif*/
 #if defined(LOG_FAX_AUDIO)
-    if (s->audio.modems.audio_rx_log >= 0)
-        write(s->audio.modems.audio_rx_log, amp, len*sizeof(int16_t));
+    if (s->audio.modems->audio_rx_log >= 0)
+        write(s->audio.modems->audio_rx_log, amp, len*sizeof(int16_t));
     /*endif*/
 #endif
     update_rx_timing(s, len);
     for (i = 0;  i < len;  i++)
-        amp[i] = dc_restore(&(s->audio.modems.dc_restore), amp[i]);
+        amp[i] = dc_restore(&(s->audio.modems->dc_restore), amp[i]);
     /*endfor*/
-    s->audio.modems.rx_handler(s->audio.modems.rx_user_data, amp, len);
+    s->audio.modems->rx_handler(s->audio.modems->rx_user_data, amp, len);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -2247,8 +2664,14 @@ SPAN_DECLARE_NONSTD(int) t38_gateway_rx_fillin(t38_gateway_state_t *s, int len)
        things that way. If there is a receive modem running, try to sustain its
        operation, without causing a phase hop, or letting its adaptive functions
        diverge. */
+    if (s->audio.modems == NULL)
+    {
+        update_rx_timing(s, len);
+        return 0;
+    }
+    /*endif*/
 #if defined(LOG_FAX_AUDIO)
-    if (s->audio.modems.audio_rx_log >= 0)
+    if (s->audio.modems->audio_rx_log >= 0)
     {
         int i;
 #if defined(_MSC_VER)
@@ -2258,12 +2681,12 @@ SPAN_DECLARE_NONSTD(int) t38_gateway_rx_fillin(t38_gateway_state_t *s, int len)
 #endif
 
         vec_zeroi16(amp, len);
-        write(s->modems.audio_rx_log, amp, len*sizeof(int16_t));
+        write(s->audio.modems->audio_rx_log, amp, len*sizeof(int16_t));
     }
 #endif
     update_rx_timing(s, len);
     /* TODO: handle the modems properly */
-    s->audio.modems.rx_fillin_handler(s->audio.modems.rx_user_data, len);
+    s->audio.modems->rx_fillin_handler(s->audio.modems->rx_user_data, len);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -2276,15 +2699,25 @@ SPAN_DECLARE_NONSTD(int) t38_gateway_tx(t38_gateway_state_t *s, int16_t amp[], i
     
     required_len = max_len;
 #endif
-    if ((len = s->audio.modems.tx_handler(s->audio.modems.tx_user_data, amp, max_len)) < max_len)
+    if (s->audio.modems == NULL)
+    {
+        /* We are in the voice phase, and have no modems yet, so there is nothing to send. */
+        if (!s->audio.transmit_on_idle)
+            return 0;
+        /*endif*/
+        memset(amp, 0, max_len*sizeof(int16_t));
+        return max_len;
+    }
+    /*endif*/
+    if ((len = s->audio.modems->tx_handler(s->audio.modems->tx_user_data, amp, max_len)) < max_len)
     {
         if (set_next_tx_type(s))
         {
             /* Give the new handler a chance to file the remaining buffer space */
-            len += s->audio.modems.tx_handler(s->audio.modems.tx_user_data, amp + len, max_len - len);
+            len += s->audio.modems->tx_handler(s->audio.modems->tx_user_data, amp + len, max_len - len);
             if (len < max_len)
             {
-                silence_gen_set(&(s->audio.modems.silence_gen), 0);
+                silence_gen_set(&(s->audio.modems->silence_gen), 0);
                 set_next_tx_type(s);
             }
             /*endif*/
@@ -2292,7 +2725,7 @@ SPAN_DECLARE_NONSTD(int) t38_gateway_tx(t38_gateway_state_t *s, int16_t amp[], i
         /*endif*/
     }
     /*endif*/
-    if (s->audio.modems.transmit_on_idle)
+    if (s->audio.modems->transmit_on_idle)
     {
         /* Pad to the requested length with silence */
         memset(amp + len, 0, (max_len - len)*sizeof(int16_t));
@@ -2300,12 +2733,12 @@ SPAN_DECLARE_NONSTD(int) t38_gateway_tx(t38_gateway_state_t *s, int16_t amp[], i
     }
     /*endif*/
 #if defined(LOG_FAX_AUDIO)
-    if (s->audio.modems.audio_tx_log >= 0)
+    if (s->audio.modems->audio_tx_log >= 0)
     {
         if (len < required_len)
             memset(amp + len, 0, (required_len - len)*sizeof(int16_t));
         /*endif*/
-        write(s->audio.modems.audio_tx_log, amp, required_len*sizeof(int16_t));
+        write(s->audio.modems->audio_tx_log, amp, required_len*sizeof(int16_t));
     }
     /*endif*/
 #endif
@@ -2334,6 +2767,24 @@ SPAN_DECLARE(logging_state_t *) t38_gateway_get_logging_state(t38_gateway_state_
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) t38_gateway_get_memory_usage(t38_gateway_state_t *s)
+{
+    int size;
+
+    size = sizeof(*s);
+    if (s->audio.modems)
+        size += sizeof(*s->audio.modems);
+    /*endif*/
+    if (s->core.hdlc_to_modem.buf)
+        size += T38_TX_HDLC_BUFS*sizeof(t38_gateway_hdlc_buf_t);
+    /*endif*/
+    if (s->core.non_ecm_to_modem)
+        size += sizeof(*s->core.non_ecm_to_modem);
+    /*endif*/
+    return size;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) t38_gateway_set_ecm_capability(t38_gateway_state_t *s, int ecm_allowed)
 {
     s->core.ecm_allowed = ecm_allowed;
@@ -2342,7 +2793,10 @@ SPAN_DECLARE(void) t38_gateway_set_ecm_capability(t38_gateway_state_t *s, int ec
 
 SPAN_DECLARE(void) t38_gateway_set_transmit_on_idle(t38_gateway_state_t *s, int transmit_on_idle)
 {
-    s->audio.modems.transmit_on_idle = transmit_on_idle;
+    s->audio.transmit_on_idle = transmit_on_idle;
+    if (s->audio.modems)
+        s->audio.modems->transmit_on_idle = transmit_on_idle;
+    /*endif*/
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -2372,7 +2826,10 @@ SPAN_DECLARE(void) t38_gateway_set_nsx_suppression(t38_gateway_state_t *s,
 
 SPAN_DECLARE(void) t38_gateway_set_tep_mode(t38_gateway_state_t *s, int use_tep)
 {
-    s->audio.modems.use_tep = use_tep;
+    s->audio.use_tep = use_tep;
+    if (s->audio.modems)
+        s->audio.modems->use_tep = use_tep;
+    /*endif*/
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -2393,8 +2850,8 @@ SPAN_DECLARE(void) t38_gateway_set_real_time_frame_handler(t38_gateway_state_t *
 
 static int t38_gateway_audio_init(t38_gateway_state_t *s)
 {
-    fax_modems_init(&s->audio.modems,
-                    FALSE,
+    fax_modems_init(s->audio.modems,
+                    s->audio.use_tep,
                     NULL,
                     hdlc_underflow_handler,
                     non_ecm_put_bit,
@@ -2403,16 +2860,130 @@ static int t38_gateway_audio_init(t38_gateway_state_t *s)
                     s);
     /* We need to use progressive HDLC transmit, and a special HDLC receiver, which is different
        from the other uses of FAX modems. */
-    hdlc_tx_init(&s->audio.modems.hdlc_tx, FALSE, 2, TRUE, hdlc_underflow_handler, s);
-    fsk_rx_set_put_bit(&s->audio.modems.v21_rx, (put_bit_func_t) t38_hdlc_rx_put_bit, &s->audio.modems.hdlc_rx);
+    hdlc_tx_init(&s->audio.modems->hdlc_tx, FALSE, 2, TRUE, hdlc_underflow_handler, s);
+    fsk_rx_set_put_bit(&s->audio.modems->v21_rx, (put_bit_func_t) t38_hdlc_rx_put_bit, &s->audio.modems->hdlc_rx);
+    fsk_rx_set_put_bits(&s->audio.modems->v21_rx, (put_bits_func_t) t38_hdlc_rx_put_bits);
     /* TODO: Don't use the very low cutoff levels we would like to. We get some quirks if we do.
        We need to sort this out. */
-    fsk_rx_signal_cutoff(&s->audio.modems.v21_rx, -30.0f);
-    v29_rx_signal_cutoff(&s->audio.modems.v29_rx, -28.5f);
+    fsk_rx_signal_cutoff(&s->audio.modems->v21_rx, -30.0f);
+    v29_rx_signal_cutoff(&s->audio.modems->v29_rx, -28.5f);
+    s->audio.modems->transmit_on_idle = s->audio.transmit_on_idle;
+#if defined(LOG_FAX_AUDIO)
+    {
+        char buf[100 + 1];
+        struct tm *tm;
+        time_t now;
+
+        time(&now);
+        tm = localtime(&now);
+        sprintf(buf,
+                "/tmp/t38-rx-audio-%p-%02d%02d%02d%02d%02d%02d",
+                s,
+                tm->tm_year%100,
+                tm->tm_mon + 1,
+                tm->tm_mday,
+                tm->tm_hour,
+                tm->tm_min,
+                tm->tm_sec);
+        s->audio.modems->audio_rx_log = open(buf, O_CREAT | O_TRUNC | O_WRONLY, 0666);
+        sprintf(buf,
+                "/tmp/t38-tx-audio-%p-%02d%02d%02d%02d%02d%02d",
+                s,
+                tm->tm_year%100,
+                tm->tm_mon + 1,
+                tm->tm_mday,
+                tm->tm_hour,
+                tm->tm_min,
+                tm->tm_sec);
+        s->audio.modems->audio_tx_log = open(buf, O_CREAT | O_TRUNC | O_WRONLY, 0666);
+    }
+#endif
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void stop_modems(t38_gateway_state_t *s)
+{
+    if (s->audio.modems)
+    {
+#if defined(LOG_FAX_AUDIO)
+        if (s->audio.modems->audio_rx_log >= 0)
+            close(s->audio.modems->audio_rx_log);
+        /*endif*/
+        if (s->audio.modems->audio_tx_log >= 0)
+            close(s->audio.modems->audio_tx_log);
+        /*endif*/
+#endif
+        span_free(s->audio.modems);
+        s->audio.modems = NULL;
+    }
+    /*endif*/
+    if (s->core.hdlc_to_modem.buf)
+    {
+        span_free(s->core.hdlc_to_modem.buf);
+        s->core.hdlc_to_modem.buf = NULL;
+    }
+    /*endif*/
+    if (s->core.non_ecm_to_modem)
+    {
+        t38_non_ecm_buffer_free(s->core.non_ecm_to_modem);
+        s->core.non_ecm_to_modem = NULL;
+    }
+    /*endif*/
+}
+/*- End of function --------------------------------------------------------*/
+
+static int start_modems(t38_gateway_state_t *s)
+{
+    if (s->audio.modems)
+        return 0;
+    /*endif*/
+    /* The modems, and the buffers which feed them, are only needed for FAX. */
+    s->audio.modems = (fax_modems_state_t *) span_alloc(sizeof(*s->audio.modems));
+    s->core.hdlc_to_modem.buf = (t38_gateway_hdlc_buf_t *) span_alloc(T38_TX_HDLC_BUFS*sizeof(t38_gateway_hdlc_buf_t));
+    s->core.non_ecm_to_modem = t38_non_ecm_buffer_init(NULL, FALSE, 0);
+    if (s->audio.modems == NULL  ||  s->core.hdlc_to_modem.buf == NULL  ||  s->core.non_ecm_to_modem == NULL)
+    {
+        span_log(&s->logging, SPAN_LOG_WARNING, "Cannot allocate the FAX modems\n");
+        stop_modems(s);
+        return -1;
+    }
+    /*endif*/
+    span_log(&s->logging, SPAN_LOG_FLOW, "Starting the FAX modems\n");
+    memset(s->core.hdlc_to_modem.buf, 0, T38_TX_HDLC_BUFS*sizeof(t38_gateway_hdlc_buf_t));
+    s->core.hdlc_to_modem.in = 0;
+    s->core.hdlc_to_modem.out = 0;
+    t38_gateway_audio_init(s);
+    set_rx_active(s, TRUE);
+    restart_rx_modem(s);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t38_gateway_set_lazy_modems(t38_gateway_state_t *s, int lazy)
+{
+    if (lazy)
+    {
+        /* Until there is some sign of FAX, we can drop the modems we already have. */
+        if (s->audio.voice_phase)
+            stop_modems(s);
+        /*endif*/
+        return 0;
+    }
+    /*endif*/
+    if (s->audio.modems == NULL  &&  start_modems(s))
+        return -1;
+    /*endif*/
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) t38_gateway_get_modems_active(t38_gateway_state_t *s)
+{
+    return (s->audio.modems != NULL);
+}
+/*- End of function --------------------------------------------------------*/
+
 static int t38_gateway_t38_init(t38_gateway_state_t *t,
                                 t38_tx_packet_handler_t *tx_packet_handler,
                                 void *tx_packet_user_data)
@@ -2440,77 +3011,71 @@ SPAN_DECLARE(t38_gateway_state_t *) t38_gateway_init(t38_gateway_state_t *s,
                                                      t38_tx_packet_handler_t *tx_packet_handler,
                                                      void *tx_packet_user_data)
 {
+    goertzel_descriptor_t desc;
+    int alloced;
+
     if (tx_packet_handler == NULL)
         return NULL;
     /*endif*/
+    alloced = FALSE;
     if (s == NULL)
     {
-        if ((s = (t38_gateway_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (t38_gateway_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
         /*endif*/
+        alloced = TRUE;
     }
     /*endif*/
     memset(s, 0, sizeof(*s));
     span_log_init(&s->logging, SPAN_LOG_NONE, NULL);
     span_log_set_protocol(&s->logging, "T.38G");
 
-    t38_gateway_audio_init(s);
     t38_gateway_t38_init(s, tx_packet_handler, tx_packet_user_data);
-    
-    set_rx_active(s, TRUE);
+    voice_phase_reset_detectors(s);
+    make_goertzel_descriptor(&desc, 1100.0f, VOICE_PHASE_SCREEN_SAMPLES);
+    goertzel_init(&s->audio.screen[0], &desc);
+    make_goertzel_descriptor(&desc, 2100.0f, VOICE_PHASE_SCREEN_SAMPLES);
+    goertzel_init(&s->audio.screen[1], &desc);
+    make_goertzel_descriptor(&desc, 1650.0f, VOICE_PHASE_SCREEN_SAMPLES);
+    goertzel_init(&s->audio.screen[2], &desc);
+    make_goertzel_descriptor(&desc, 1850.0f, VOICE_PHASE_SCREEN_SAMPLES);
+    goertzel_init(&s->audio.screen[3], &desc);
+    s->audio.voice_phase_min_power = power_meter_level_dbm0(VOICE_PHASE_MIN_LEVEL_DBM0);
+
     t38_gateway_set_supported_modems(s, T30_SUPPORT_V27TER | T30_SUPPORT_V29 | T30_SUPPORT_V17);
     t38_gateway_set_nsx_suppression(s, (const uint8_t *) "\x00\x00\x00", 3, (const uint8_t *) "\x00\x00\x00", 3);
 
     s->core.to_t38.octets_per_data_packet = 1;
     s->core.ecm_allowed = TRUE;
     //s->core.ms_per_tx_chunk = DEFAULT_MS_PER_TX_CHUNK;
-    t38_non_ecm_buffer_init(&s->core.non_ecm_to_modem, FALSE, 0);
-    restart_rx_modem(s);
     s->core.timed_mode = TIMED_MODE_STARTUP;
     s->core.samples_to_timeout = 1;
-#if defined(LOG_FAX_AUDIO)
+    /* The modems are started right away, unless lazy mode is selected before any audio
+       or T.38 packets are processed. */
+    s->audio.voice_phase = TRUE;
+    if (start_modems(s))
     {
-        char buf[100 + 1];
-        struct tm *tm;
-        time_t now;
-
-        time(&now);
-        tm = localtime(&now);
-        sprintf(buf,
-                "/tmp/t38-rx-audio-%p-%02d%02d%02d%02d%02d%02d",
-                s,
-                tm->tm_year%100,
-                tm->tm_mon + 1,
-                tm->tm_mday,
-                tm->tm_hour,
-                tm->tm_min,
-                tm->tm_sec);
-        s->audio.modems.audio_rx_log = open(buf, O_CREAT | O_TRUNC | O_WRONLY, 0666);
-        sprintf(buf,
-                "/tmp/t38-tx-audio-%p-%02d%02d%02d%02d%02d%02d",
-                s,
-                tm->tm_year%100,
-                tm->tm_mon + 1,
-                tm->tm_mday,
-                tm->tm_hour,
-                tm->tm_min,
-                tm->tm_sec);
-        s->audio.modems.audio_tx_log = open(buf, O_CREAT | O_TRUNC | O_WRONLY, 0666);
+        if (alloced)
+            span_free(s);
+        /*endif*/
+        return NULL;
     }
-#endif
+    /*endif*/
     return s;
 }
 /*- End of function --------------------------------------------------------*/
 
 SPAN_DECLARE(int) t38_gateway_release(t38_gateway_state_t *s)
 {
+    stop_modems(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
 
 SPAN_DECLARE(int) t38_gateway_free(t38_gateway_state_t *s)
 {
-    free(s);
+    stop_modems(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -0,0 +1,500 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * t38_gateway_group.c - A driver for a group of T.38 gateway sessions,
+ *                       processed together each audio tick.
+ *
+ * Written by Steve Underwood <steveu@coppice.org>
+ *
+ * Copyright (C) 2010 Steve Underwood
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+#if defined(__linux__)  &&  !defined(_GNU_SOURCE)
+/* For the CPU affinity controls */
+#define _GNU_SOURCE
+#endif
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#if defined(HAVE_TGMATH_H)
+#include <tgmath.h>
+#endif
+#if defined(HAVE_MATH_H)
+#include <math.h>
+#endif
+#include "floating_fudge.h"
+#include <tiffio.h>
+#if defined(__linux__)  &&  defined(HAVE_PTHREAD_H)  &&  defined(HAVE_LIBPTHREAD)
+#include <pthread.h>
+#include <sched.h>
+#define T38_GATEWAY_GROUP_USE_AFFINITY
+#endif
+
+#include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
+#include "spandsp/logging.h"
+#include "spandsp/queue.h"
+#include "spandsp/dc_restore.h"
+#include "spandsp/bit_operations.h"
+#include "spandsp/power_meter.h"
+#include "spandsp/complex.h"
+#include "spandsp/tone_detect.h"
+#include "spandsp/tone_generate.h"
+#include "spandsp/async.h"
+#include "spandsp/crc.h"
+#include "spandsp/hdlc.h"
+#include "spandsp/silence_gen.h"
+#include "spandsp/fsk.h"
+#include "spandsp/v29tx.h"
+#include "spandsp/v29rx.h"
+#include "spandsp/v27ter_tx.h"
+#include "spandsp/v27ter_rx.h"
+#include "spandsp/v17tx.h"
+#include "spandsp/v17rx.h"
+#include "spandsp/super_tone_rx.h"
+#include "spandsp/modem_connect_tones.h"
+#include "spandsp/t4_rx.h"
+#include "spandsp/t4_tx.h"
+#if defined(SPANDSP_SUPPORT_T85)
+#include "spandsp/t81_t82_arith_coding.h"
+#include "spandsp/t85.h"
+#endif
+#include "spandsp/t4_t6_decode.h"
+#include "spandsp/t4_t6_encode.h"
+#include "spandsp/t30_fcf.h"
+#include "spandsp/t35.h"
+#include "spandsp/t30.h"
+#include "spandsp/t30_logging.h"
+#include "spandsp/fax_modems.h"
+#include "spandsp/t38_core.h"
+#include "spandsp/t38_non_ecm_buffer.h"
+#include "spandsp/t38_gateway.h"
+#include "spandsp/t38_gateway_group.h"
+
+#include "spandsp/private/logging.h"
+#include "spandsp/private/silence_gen.h"
+#include "spandsp/private/fsk.h"
+#include "spandsp/private/v17tx.h"
+#include "spandsp/private/v17rx.h"
+#include "spandsp/private/v27ter_tx.h"
+#include "spandsp/private/v27ter_rx.h"
+#include "spandsp/private/v29tx.h"
+#include "spandsp/private/v29rx.h"
+#include "spandsp/private/modem_connect_tones.h"
+#include "spandsp/private/hdlc.h"
+#include "spandsp/private/fax_modems.h"
+#if defined(SPANDSP_SUPPORT_T85)
+#include "spandsp/private/t81_t82_arith_coding.h"
+#include "spandsp/private/t85.h"
+#endif
+#include "spandsp/private/t4_t6_decode.h"
+#include "spandsp/private/t4_t6_encode.h"
+#include "spandsp/private/t4_rx.h"
+#include "spandsp/private/t4_tx.h"
+#include "spandsp/private/t30.h"
+#include "spandsp/private/t38_core.h"
+#include "spandsp/private/t38_non_ecm_buffer.h"
+#include "spandsp/private/t38_gateway.h"
+#include "spandsp/private/t38_gateway_group.h"
+
+/*! The space allowed for waiting T.38 packets, per session slot, in octets. A tick
+    rarely produces more than one or two packets per session. */
+#define TX_BUF_OCTETS_PER_SESSION       256
+/*! The number of waiting T.38 packets allowed, per session slot */
+#define TX_PACKETS_PER_SESSION          4
+/*! The least space allowed for waiting T.38 packets, in octets. This must be enough for
+    the largest IFP packet. */
+#define TX_BUF_MIN_OCTETS               2048
+/*! The least number of waiting T.38 packets allowed */
+#define TX_MIN_PACKETS                  16
+
+static int tx_packet_handler(t38_core_state_t *t, void *user_data, const uint8_t buf[], int len, int count)
+{
+    t38_gateway_group_session_t *session;
+    t38_gateway_group_state_t *s;
+    t38_gateway_group_packet_t *pkt;
+
+    session = (t38_gateway_group_session_t *) user_data;
+    s = session->group;
+    if (len > s->tx_buf_size)
+    {
+        span_log(&s->logging, SPAN_LOG_WARNING, "Session %d T.38 packet too long - %d\n", session->session, len);
+        return -1;
+    }
+    /*endif*/
+    /* If the queue is full, hand over what is waiting now, rather than lose anything. */
+    if (s->tx_queue_len >= s->tx_queue_size  ||  s->tx_buf_used + len > s->tx_buf_size)
+        t38_gateway_group_flush(s);
+    /*endif*/
+    memcpy(&s->tx_buf[s->tx_buf_used], buf, len);
+    pkt = &s->tx_queue[s->tx_queue_len];
+    pkt->session = session->session;
+    pkt->buf = &s->tx_buf[s->tx_buf_used];
+    pkt->len = len;
+    pkt->count = count;
+    s->tx_queue_dest[s->tx_queue_len] = session->dest;
+    if (s->dest_count[session->dest]++ == 0)
+        s->dest_list[s->dest_list_len++] = session->dest;
+    /*endif*/
+    s->tx_queue_len++;
+    s->tx_buf_used += len;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t38_gateway_group_flush(t38_gateway_group_state_t *s)
+{
+    int i;
+    int dest;
+    int next;
+    int start;
+    int packets;
+
+    if ((packets = s->tx_queue_len) == 0)
+        return 0;
+    /*endif*/
+    /* Sort the packets by destination, with a counting sort, which keeps the packets for
+       each destination in order. dest_count becomes the place for the next packet of each
+       destination. */
+    next = 0;
+    for (i = 0;  i < s->dest_list_len;  i++)
+    {
+        dest = s->dest_list[i];
+        start = next;
+        next += s->dest_count[dest];
+        s->dest_count[dest] = start;
+    }
+    /*endfor*/
+    for (i = 0;  i < packets;  i++)
+        s->tx_sorted[s->dest_count[s->tx_queue_dest[i]]++] = s->tx_queue[i];
+    /*endfor*/
+    /* Each dest_count is now the end of its destination's packets, which start where the
+       previous destination's end. */
+    start = 0;
+    for (i = 0;  i < s->dest_list_len;  i++)
+    {
+        dest = s->dest_list[i];
+        next = s->dest_count[dest];
+        s->dest_count[dest] = 0;
+        s->tx_handler(s->tx_user_data, dest, &s->tx_sorted[start], next - start);
+        start = next;
+    }
+    /*endfor*/
+    s->dest_list_len = 0;
+    s->tx_queue_len = 0;
+    s->tx_buf_used = 0;
+    return packets;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t38_gateway_group_tick(t38_gateway_group_state_t *s, int16_t rx_amp[], int16_t tx_amp[], int len)
+{
+    t38_gateway_group_session_t *session;
+    int16_t *amp;
+    int processed;
+    int i;
+    int n;
+
+    processed = 0;
+    for (i = 0;  i < s->max_sessions  &&  processed < s->active_sessions;  i++)
+    {
+        amp = &tx_amp[i*len];
+        session = &s->sessions[i];
+        if (session->dest < 0)
+        {
+            memset(amp, 0, len*sizeof(int16_t));
+            continue;
+        }
+        /*endif*/
+        /* Do the receive and transmit work for a session together, while its state is
+           in the cache. */
+        if (rx_amp)
+            t38_gateway_rx(&session->gateway, &rx_amp[i*len], len);
+        else
+            t38_gateway_rx_fillin(&session->gateway, len);
+        /*endif*/
+        if ((n = t38_gateway_tx(&session->gateway, amp, len)) < len)
+            memset(&amp[n], 0, (len - n)*sizeof(int16_t));
+        /*endif*/
+        processed++;
+    }
+    /*endfor*/
+    if (i < s->max_sessions)
+        memset(&tx_amp[i*len], 0, (s->max_sessions - i)*len*sizeof(int16_t));
+    /*endif*/
+    t38_gateway_group_flush(s);
+    return processed;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t38_gateway_group_rx_ifp_packet(t38_gateway_group_state_t *s, int session, const uint8_t buf[], int len, uint16_t seq_no)
+{
+    if (session < 0  ||  session >= s->max_sessions  ||  s->sessions[session].dest < 0)
+        return -1;
+    /*endif*/
+    return t38_core_rx_ifp_packet(&s->sessions[session].gateway.t38x.t38, buf, len, seq_no);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t38_gateway_group_add_session(t38_gateway_group_state_t *s, int dest)
+{
+    t38_gateway_group_session_t *session;
+
+    if (dest < 0  ||  dest >= s->max_destinations  ||  s->free_count <= 0)
+        return -1;
+    /*endif*/
+    session = &s->sessions[s->free_slots[s->free_count - 1]];
+    if (t38_gateway_init(&session->gateway, tx_packet_handler, session) == NULL)
+        return -1;
+    /*endif*/
+    s->free_count--;
+    session->dest = dest;
+    s->active_sessions++;
+    return session->session;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t38_gateway_group_remove_session(t38_gateway_group_state_t *s, int session)
+{
+    if (session < 0  ||  session >= s->max_sessions  ||  s->sessions[session].dest < 0)
+        return -1;
+    /*endif*/
+    /* Don't leave any of the session's packets in the queue */
+    t38_gateway_group_flush(s);
+    t38_gateway_release(&s->sessions[session].gateway);
+    s->sessions[session].dest = -1;
+    s->free_slots[s->free_count++] = session;
+    s->active_sessions--;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t38_gateway_group_set_destination(t38_gateway_group_state_t *s, int session, int dest)
+{
+    if (session < 0  ||  session >= s->max_sessions  ||  s->sessions[session].dest < 0)
+        return -1;
+    /*endif*/
+    if (dest < 0  ||  dest >= s->max_destinations)
+        return -1;
+    /*endif*/
+    /* Packets already waiting still go to the old destination */
+    s->sessions[session].dest = dest;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(t38_gateway_state_t *) t38_gateway_group_get_gateway(t38_gateway_group_state_t *s, int session)
+{
+    if (session < 0  ||  session >= s->max_sessions  ||  s->sessions[session].dest < 0)
+        return NULL;
+    /*endif*/
+    return &s->sessions[session].gateway;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t38_gateway_group_get_sessions(t38_gateway_group_state_t *s)
+{
+    return s->active_sessions;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t38_gateway_group_bind_to_cpu(t38_gateway_group_state_t *s, int cpu)
+{
+#if defined(T38_GATEWAY_GROUP_USE_AFFINITY)
+    cpu_set_t cpus;
+
+    if (cpu < 0  ||  cpu >= CPU_SETSIZE)
+        return -1;
+    /*endif*/
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus))
+    {
+        span_log(&s->logging, SPAN_LOG_WARNING, "Cannot bind to CPU %d\n", cpu);
+        return -1;
+    }
+    /*endif*/
+    s->cpu = cpu;
+    return 0;
+#else
+    return -1;
+#endif
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(logging_state_t *) t38_gateway_group_get_logging_state(t38_gateway_group_state_t *s)
+{
+    return &s->logging;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void free_buffers(t38_gateway_group_state_t *s)
+{
+    if (s->sessions)
+        span_free(s->sessions);
+    /*endif*/
+    if (s->free_slots)
+        span_free(s->free_slots);
+    /*endif*/
+    if (s->tx_buf)
+        span_free(s->tx_buf);
+    /*endif*/
+    if (s->tx_queue)
+        span_free(s->tx_queue);
+    /*endif*/
+    if (s->tx_queue_dest)
+        span_free(s->tx_queue_dest);
+    /*endif*/
+    if (s->tx_sorted)
+        span_free(s->tx_sorted);
+    /*endif*/
+    if (s->dest_count)
+        span_free(s->dest_count);
+    /*endif*/
+    if (s->dest_list)
+        span_free(s->dest_list);
+    /*endif*/
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(t38_gateway_group_state_t *) t38_gateway_group_init(t38_gateway_group_state_t *s,
+                                                                 int max_sessions,
+                                                                 int max_destinations,
+                                                                 t38_gateway_group_tx_handler_t *tx_handler,
+                                                                 void *user_data)
+{
+    int alloced;
+    int i;
+
+    if (max_sessions <= 0  ||  max_destinations <= 0  ||  tx_handler == NULL)
+        return NULL;
+    /*endif*/
+    alloced = FALSE;
+    if (s == NULL)
+    {
+        if ((s = (t38_gateway_group_state_t *) span_alloc(sizeof(*s))) == NULL)
+            return NULL;
+        /*endif*/
+        alloced = TRUE;
+    }
+    /*endif*/
+    memset(s, 0, sizeof(*s));
+    span_log_init(&s->logging, SPAN_LOG_NONE, NULL);
+    span_log_set_protocol(&s->logging, "T.38GG");
+
+    s->max_sessions = max_sessions;
+    s->max_destinations = max_destinations;
+    s->tx_handler = tx_handler;
+    s->tx_user_data = user_data;
+    s->cpu = -1;
+
+    s->tx_buf_size = max_sessions*TX_BUF_OCTETS_PER_SESSION;
+    if (s->tx_buf_size < TX_BUF_MIN_OCTETS)
+        s->tx_buf_size = TX_BUF_MIN_OCTETS;
+    /*endif*/
+    s->tx_queue_size = max_sessions*TX_PACKETS_PER_SESSION;
+    if (s->tx_queue_size < TX_MIN_PACKETS)
+        s->tx_queue_size = TX_MIN_PACKETS;
+    /*endif*/
+    s->sessions = (t38_gateway_group_session_t *) span_alloc(max_sessions*sizeof(t38_gateway_group_session_t));
+    s->free_slots = (int *) span_alloc(max_sessions*sizeof(int));
+    s->tx_buf = (uint8_t *) span_alloc(s->tx_buf_size);
+    s->tx_queue = (t38_gateway_group_packet_t *) span_alloc(s->tx_queue_size*sizeof(t38_gateway_group_packet_t));
+    s->tx_queue_dest = (int *) span_alloc(s->tx_queue_size*sizeof(int));
+    s->tx_sorted = (t38_gateway_group_packet_t *) span_alloc(s->tx_queue_size*sizeof(t38_gateway_group_packet_t));
+    s->dest_count = (int *) span_alloc(max_destinations*sizeof(int));
+    s->dest_list = (int *) span_alloc(max_destinations*sizeof(int));
+    if (s->sessions == NULL
+        ||
+        s->free_slots == NULL
+        ||
+        s->tx_buf == NULL
+        ||
+        s->tx_queue == NULL
+        ||
+        s->tx_queue_dest == NULL
+        ||
+        s->tx_sorted == NULL
+        ||
+        s->dest_count == NULL
+        ||
+        s->dest_list == NULL)
+    {
+        free_buffers(s);
+        if (alloced)
+            span_free(s);
+        /*endif*/
+        return NULL;
+    }
+    /*endif*/
+    memset(s->dest_count, 0, max_destinations*sizeof(int));
+    /* Hand out the slots from the lowest up, so a lightly loaded group is processed from
+       one end of the session array. */
+    for (i = 0;  i < max_sessions;  i++)
+    {
+        s->sessions[i].group = s;
+        s->sessions[i].session = i;
+        s->sessions[i].dest = -1;
+        s->free_slots[i] = max_sessions - 1 - i;
+    }
+    /*endfor*/
+    s->free_count = max_sessions;
+    return s;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t38_gateway_group_release(t38_gateway_group_state_t *s)
+{
+    int i;
+
+    if (s->sessions)
+    {
+        for (i = 0;  i < s->max_sessions;  i++)
+        {
+            if (s->sessions[i].dest >= 0)
+            {
+                t38_gateway_release(&s->sessions[i].gateway);
+                s->sessions[i].dest = -1;
+            }
+            /*endif*/
+        }
+        /*endfor*/
+    }
+    /*endif*/
+    free_buffers(s);
+    memset(s, 0, sizeof(*s));
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t38_gateway_group_free(t38_gateway_group_state_t *s)
+{
+    t38_gateway_group_release(s);
+    span_free(s);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
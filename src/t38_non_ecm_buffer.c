@@ -46,6 +46,7 @@
 #include <assert.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
 #include "spandsp/queue.h"
 #include "spandsp/dc_restore.h"
@@ -79,9 +80,64 @@ static void restart_buffer(t38_non_ecm_buffer_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
+static __inline__ int low_nibble_zero_in_word(uint32_t w)
+{
+    /* Check if any of the 4 octets in the word has its low 4 bits all zero. With the top
+       4 bits of each octet cleared, a borrow can only cross into an octet when the octet
+       below it was zero, so this is exact for the word as a whole. */
+    w &= 0x0F0F0F0FU;
+    return ((w - 0x01010101U) & ~w & 0x80808080U) != 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void copy_in(t38_non_ecm_buffer_state_t *s, const uint8_t *buf, int len)
+{
+    int n;
+
+    /* Copy into the buffer, in at most two pieces as the buffer wraps */
+    n = T38_NON_ECM_TX_BUF_LEN - s->in_ptr;
+    if (n > len)
+        n = len;
+    memcpy(&s->data[s->in_ptr], buf, n);
+    if (n < len)
+        memcpy(s->data, &buf[n], len - n);
+    s->in_ptr = (s->in_ptr + len) & (T38_NON_ECM_TX_BUF_LEN - 1);
+    s->in_octets += len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ int get_octet(t38_non_ecm_buffer_state_t *s)
+{
+    int octet;
+
+    if (s->out_ptr != s->latest_eol_ptr)
+    {
+        octet = s->data[s->out_ptr];
+        s->out_ptr = (s->out_ptr + 1) & (T38_NON_ECM_TX_BUF_LEN - 1);
+    }
+    else
+    {
+        if (s->data_finished)
+        {
+            /* The queue is empty, and we have received the end of data signal. This must
+               really be the end to transmission. */
+            restart_buffer(s);
+            return SIG_STATUS_END_OF_DATA;
+        }
+        /* The queue is blocked, but this does not appear to be the end of the data. Idle with
+           fill octets, which should be safe at this point. */
+        octet = s->flow_control_fill_octet;
+        s->flow_control_fill_octets++;
+    }
+    s->out_octets++;
+    return octet;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE_NONSTD(int) t38_non_ecm_buffer_get_bit(void *user_data)
 {
     t38_non_ecm_buffer_state_t *s;
+    int octet;
     int bit;
 
     s = (t38_non_ecm_buffer_state_t *) user_data;
@@ -89,10 +145,70 @@ SPAN_DECLARE_NONSTD(int) t38_non_ecm_buffer_get_bit(void *user_data)
     if (s->bit_no <= 0)
     {
         /* We need another byte */
+        if ((octet = get_octet(s)) < 0)
+            return SIG_STATUS_END_OF_DATA;
+        s->octet = octet;
+        s->bit_no = 8;
+    }
+    s->bit_no--;
+    bit = (s->octet >> 7) & 1;
+    s->octet <<= 1;
+    return bit;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE_NONSTD(int) t38_non_ecm_buffer_get_bits(void *user_data, unsigned int *bits)
+{
+    t38_non_ecm_buffer_state_t *s;
+    int octet;
+    int n;
+
+    s = (t38_non_ecm_buffer_state_t *) user_data;
+
+    if (s->bit_no > 0)
+    {
+        /* Finish off an octet which t38_non_ecm_buffer_get_bit() started */
+        n = s->bit_no;
+        *bits = (s->octet & 0xFF) >> (8 - n);
+        s->bit_no = 0;
+        return n;
+    }
+    if ((octet = get_octet(s)) < 0)
+        return SIG_STATUS_END_OF_DATA;
+    *bits = octet;
+    /* Only take a second octet if it is real data. Fill is added an octet at a time,
+       so there is as little fill as possible queued in the modem. */
+    if (s->out_ptr == s->latest_eol_ptr)
+        return 8;
+    *bits = (*bits << 8) | get_octet(s);
+    return 16;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t38_non_ecm_buffer_get_chunk(void *user_data, uint8_t buf[], int max_len)
+{
+    t38_non_ecm_buffer_state_t *s;
+    int len;
+    int end;
+    int n;
+
+    s = (t38_non_ecm_buffer_state_t *) user_data;
+
+    /* Any part octet left by t38_non_ecm_buffer_get_bit() is dropped */
+    s->bit_no = 0;
+    len = 0;
+    while (len < max_len)
+    {
         if (s->out_ptr != s->latest_eol_ptr)
         {
-            s->octet = s->data[s->out_ptr];
-            s->out_ptr = (s->out_ptr + 1) & (T38_NON_ECM_TX_BUF_LEN - 1);
+            /* Take everything up to the latest EOL, or the end of the buffer if the
+               data wraps, in one go. */
+            end = (s->latest_eol_ptr > s->out_ptr)  ?  s->latest_eol_ptr  :  T38_NON_ECM_TX_BUF_LEN;
+            n = end - s->out_ptr;
+            if (n > max_len - len)
+                n = max_len - len;
+            memcpy(&buf[len], &s->data[s->out_ptr], n);
+            s->out_ptr = (s->out_ptr + n) & (T38_NON_ECM_TX_BUF_LEN - 1);
         }
         else
         {
@@ -101,20 +217,18 @@ SPAN_DECLARE_NONSTD(int) t38_non_ecm_buffer_get_bit(void *user_data)
                 /* The queue is empty, and we have received the end of data signal. This must
                    really be the end to transmission. */
                 restart_buffer(s);
-                return SIG_STATUS_END_OF_DATA;
+                break;
             }
-            /* The queue is blocked, but this does not appear to be the end of the data. Idle with
-               fill octets, which should be safe at this point. */
-            s->octet = s->flow_control_fill_octet;
-            s->flow_control_fill_octets++;
+            /* The queue is blocked, and nothing more can arrive during this call, so the
+               rest of the chunk is fill. */
+            n = max_len - len;
+            memset(&buf[len], s->flow_control_fill_octet, n);
+            s->flow_control_fill_octets += n;
         }
-        s->out_octets++;
-        s->bit_no = 8;
+        len += n;
+        s->out_octets += n;
     }
-    s->bit_no--;
-    bit = (s->octet >> 7) & 1;
-    s->octet <<= 1;
-    return bit;
+    return len;
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -129,6 +243,7 @@ SPAN_DECLARE(void) t38_non_ecm_buffer_push(t38_non_ecm_buffer_state_t *s)
 
 SPAN_DECLARE(void) t38_non_ecm_buffer_inject(t38_non_ecm_buffer_state_t *s, const uint8_t *buf, int len)
 {
+    uint32_t word;
     int i;
     int upper;
     int lower;
@@ -188,14 +303,13 @@ SPAN_DECLARE(void) t38_non_ecm_buffer_inject(t38_non_ecm_buffer_state_t *s, cons
         }
         /* Fall through */
     case TCF_AT_ALL_ZEROS:
-        for (  ;  i < len;  i++)
+        if (i < len)
         {
-            s->data[s->in_ptr] = buf[i];
-            s->latest_eol_ptr = s->in_ptr;
             /* TODO: We can't buffer overflow, since we wrap around. However, the tail could
                      overwrite itself if things fall badly behind. */
-            s->in_ptr = (s->in_ptr + 1) & (T38_NON_ECM_TX_BUF_LEN - 1);
-            s->in_octets++;
+            copy_in(s, &buf[i], len - i);
+            /* Hold back the last octet, as the octet by octet version always did */
+            s->latest_eol_ptr = (s->in_ptr - 1) & (T38_NON_ECM_TX_BUF_LEN - 1);
         }
         break;
     case IMAGE_WAITING_FOR_FIRST_EOL:
@@ -252,6 +366,30 @@ SPAN_DECLARE(void) t38_non_ecm_buffer_inject(t38_non_ecm_buffer_state_t *s, cons
            safely stuff anything in the bit stream. */
         for (  ;  i < len;  i++)
         {
+            /* An EOL can only end in an octet which follows one with at least 4 trailing
+               zeros. Check 4 octets at a time, and if none of the octets before them has
+               its low 4 bits clear, copy them straight in. Most image data goes this way. */
+            while (i > 0  &&  i + 4 <= len)
+            {
+                memcpy(&word, &buf[i - 1], sizeof(word));
+                if (low_nibble_zero_in_word(word))
+                    break;
+                if (s->in_ptr <= T38_NON_ECM_TX_BUF_LEN - 4)
+                {
+                    memcpy(&s->data[s->in_ptr], &buf[i], 4);
+                    s->in_ptr = (s->in_ptr + 4) & (T38_NON_ECM_TX_BUF_LEN - 1);
+                    s->in_octets += 4;
+                }
+                else
+                {
+                    copy_in(s, &buf[i], 4);
+                }
+                s->row_bits += 32;
+                s->bit_stream = (buf[i + 2] << 8) | buf[i + 3];
+                i += 4;
+            }
+            if (i >= len)
+                break;
             if (buf[i])
             {
                 /* There might be an EOL here. Look for at least 11 zeros, followed by a one, split
@@ -351,7 +489,7 @@ SPAN_DECLARE(t38_non_ecm_buffer_state_t *) t38_non_ecm_buffer_init(t38_non_ecm_b
 {
     if (s == NULL)
     {
-        if ((s = (t38_non_ecm_buffer_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (t38_non_ecm_buffer_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -371,7 +509,7 @@ SPAN_DECLARE(int) t38_non_ecm_buffer_release(t38_non_ecm_buffer_state_t *s)
 SPAN_DECLARE(int) t38_non_ecm_buffer_free(t38_non_ecm_buffer_state_t *s)
 {
     if (s)
-        free(s);
+        span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
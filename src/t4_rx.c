@@ -79,6 +79,7 @@
 #include <tiffio.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
 #include "spandsp/bit_operations.h"
 #include "spandsp/async.h"
@@ -286,7 +287,7 @@ static int close_tiff_output_file(t4_state_t *s)
            put in it. */
         if (s->current_page == 0)
             remove(t->file);
-        free((char *) t->file);
+        span_free((char *) t->file);
         t->file = NULL;
     }
     return 0;
@@ -398,23 +399,23 @@ static int free_buffers(t4_state_t *s)
 {
     if (s->image_buffer)
     {
-        free(s->image_buffer);
+        span_free(s->image_buffer);
         s->image_buffer = NULL;
         s->image_buffer_size = 0;
     }
     if (s->cur_runs)
     {
-        free(s->cur_runs);
+        span_free(s->cur_runs);
         s->cur_runs = NULL;
     }
     if (s->ref_runs)
     {
-        free(s->ref_runs);
+        span_free(s->ref_runs);
         s->ref_runs = NULL;
     }
     if (s->row_buf)
     {
-        free(s->row_buf);
+        span_free(s->row_buf);
         s->row_buf = NULL;
     }
     return 0;
@@ -475,7 +476,7 @@ static int put_decoded_row(t4_state_t *s)
     /* Make sure there is enough room for another row */
     if (s->image_size + s->bytes_per_row >= s->image_buffer_size)
     {
-        if ((t = realloc(s->image_buffer, s->image_buffer_size + 100*s->bytes_per_row)) == NULL)
+        if ((t = span_realloc(s->image_buffer, s->image_buffer_size + 100*s->bytes_per_row)) == NULL)
             return -1;
         s->image_buffer_size += 100*s->bytes_per_row;
         s->image_buffer = t;
@@ -978,6 +979,13 @@ SPAN_DECLARE(int) t4_rx_put_bit(t4_state_t *s, int bit)
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) t4_rx_put_bits(t4_state_t *s, unsigned int bits, int nbits)
+{
+    /* The decoder wants the earliest bit in the least significant position */
+    return rx_put_bits(s, bit_reverse16((uint16_t) (bits << (16 - nbits))), nbits);
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(int) t4_rx_put_byte(t4_state_t *s, uint8_t byte)
 {
     return rx_put_bits(s, byte & 0xFF, 8);
@@ -1011,7 +1019,7 @@ SPAN_DECLARE(t4_state_t *) t4_rx_init(t4_state_t *s, const char *file, int outpu
 {
     if (s == NULL)
     {
-        if ((s = (t4_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (t4_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -1025,7 +1033,7 @@ SPAN_DECLARE(t4_state_t *) t4_rx_init(t4_state_t *s, const char *file, int outpu
         return NULL;
 
     /* Save the file name for logging reports. */
-    s->tiff.file = strdup(file);
+    s->tiff.file = span_strdup(file);
     /* Only provide for one form of coding throughout the file, even though the
        coding on the wire could change between pages. */
     switch (output_encoding)
@@ -1078,16 +1086,17 @@ SPAN_DECLARE(int) t4_rx_start_page(t4_state_t *s)
     /* Calculate the scanline/tile width. */
     bytes_per_row = (s->image_width + 7)/8;
     run_space = (s->image_width + 4)*sizeof(uint32_t);
-    if (bytes_per_row != s->bytes_per_row)
+    if (bytes_per_row != s->bytes_per_row  ||  run_space != s->run_space)
     {
         /* Allocate the space required for decoding the new row length. */
         s->bytes_per_row = bytes_per_row;
-        if ((bufptr = (uint32_t *) realloc(s->cur_runs, run_space)) == NULL)
+        if ((bufptr = (uint32_t *) span_realloc(s->cur_runs, run_space)) == NULL)
             return -1;
         s->cur_runs = bufptr;
-        if ((bufptr = (uint32_t *) realloc(s->ref_runs, run_space)) == NULL)
+        if ((bufptr = (uint32_t *) span_realloc(s->ref_runs, run_space)) == NULL)
             return -1;
         s->ref_runs = bufptr;
+        s->run_space = run_space;
     }
     memset(s->cur_runs, 0, run_space);
     memset(s->ref_runs, 0, run_space);
@@ -1153,7 +1162,7 @@ SPAN_DECLARE(int) t4_rx_free(t4_state_t *s)
     int ret;
 
     ret = t4_rx_release(s);
-    free(s);
+    span_free(s);
     return ret;
 }
 /*- End of function --------------------------------------------------------*/
@@ -1227,6 +1236,25 @@ SPAN_DECLARE(void) t4_rx_get_transfer_statistics(t4_state_t *s, t4_stats_t *t)
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) t4_rx_get_memory_usage(t4_state_t *s)
+{
+    int size;
+
+    size = sizeof(*s);
+    if (s->image_buffer)
+        size += s->image_buffer_size;
+    if (s->cur_runs)
+        size += s->run_space;
+    if (s->ref_runs)
+        size += s->run_space;
+    if (s->row_buf)
+        size += s->bytes_per_row;
+    if (s->tiff.file)
+        size += strlen(s->tiff.file) + 1;
+    return size;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(const char *) t4_encoding_to_str(int encoding)
 {
     switch (encoding)
@@ -76,6 +76,7 @@
 #include <tiffio.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
 #include "spandsp/bit_operations.h"
 #include "spandsp/async.h"
@@ -704,7 +705,7 @@ static int close_tiff_input_file(t4_state_t *s)
     TIFFClose(s->tiff.tiff_file);
     s->tiff.tiff_file = NULL;
     if (s->tiff.file)
-        free((char *) s->tiff.file);
+        span_free((char *) s->tiff.file);
     s->tiff.file = NULL;
     return 0;
 }
@@ -724,23 +725,23 @@ static int free_buffers(t4_state_t *s)
 {
     if (s->image_buffer)
     {
-        free(s->image_buffer);
+        span_free(s->image_buffer);
         s->image_buffer = NULL;
         s->image_buffer_size = 0;
     }
     if (s->cur_runs)
     {
-        free(s->cur_runs);
+        span_free(s->cur_runs);
         s->cur_runs = NULL;
     }
     if (s->ref_runs)
     {
-        free(s->ref_runs);
+        span_free(s->ref_runs);
         s->ref_runs = NULL;
     }
     if (s->row_buf)
     {
-        free(s->row_buf);
+        span_free(s->row_buf);
         s->row_buf = NULL;
     }
     return 0;
@@ -865,7 +866,7 @@ static __inline__ int put_encoded_bits(t4_state_t *s, uint32_t bits, int length)
     s->row_bits += length;
     if ((s->image_size + (s->tx_bits + 7)/8) >= s->image_buffer_size)
     {
-        if ((t = realloc(s->image_buffer, s->image_buffer_size + 100*s->bytes_per_row)) == NULL)
+        if ((t = span_realloc(s->image_buffer, s->image_buffer_size + 100*s->bytes_per_row)) == NULL)
             return -1;
         s->image_buffer = t;
         s->image_buffer_size += 100*s->bytes_per_row;
@@ -1224,7 +1225,7 @@ SPAN_DECLARE(t4_state_t *) t4_tx_init(t4_state_t *s, const char *file, int start
 
     if (s == NULL)
     {
-        if ((s = (t4_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (t4_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -1236,7 +1237,7 @@ SPAN_DECLARE(t4_state_t *) t4_tx_init(t4_state_t *s, const char *file, int start
 
     if (open_tiff_input_file(s, file) < 0)
         return NULL;
-    s->tiff.file = strdup(file);
+    s->tiff.file = span_strdup(file);
     s->current_page =
     s->tiff.start_page = (start_page >= 0)  ?  start_page  :  0;
     s->tiff.stop_page = (stop_page >= 0)  ?  stop_page : INT_MAX;
@@ -1254,20 +1255,21 @@ SPAN_DECLARE(t4_state_t *) t4_tx_init(t4_state_t *s, const char *file, int start
     s->tiff.pages_in_file = -1;
 
     run_space = (s->image_width + 4)*sizeof(uint32_t);
-    if ((s->cur_runs = (uint32_t *) malloc(run_space)) == NULL)
+    if ((s->cur_runs = (uint32_t *) span_alloc(run_space)) == NULL)
         return NULL;
-    if ((s->ref_runs = (uint32_t *) malloc(run_space)) == NULL)
+    if ((s->ref_runs = (uint32_t *) span_alloc(run_space)) == NULL)
     {
         free_buffers(s);
         close_tiff_input_file(s);
         return NULL;
     }
-    if ((s->row_buf = malloc(s->bytes_per_row)) == NULL)
+    if ((s->row_buf = span_alloc(s->bytes_per_row)) == NULL)
     {
         free_buffers(s);
         close_tiff_input_file(s);
         return NULL;
     }
+    s->run_space = run_space;
     s->ref_runs[0] =
     s->ref_runs[1] =
     s->ref_runs[2] =
@@ -1314,15 +1316,16 @@ SPAN_DECLARE(int) t4_tx_start_page(t4_state_t *s)
     {
         s->bytes_per_row = (s->image_width + 7)/8;
 
-        if ((bufptr = (uint32_t *) realloc(s->cur_runs, run_space)) == NULL)
+        if ((bufptr = (uint32_t *) span_realloc(s->cur_runs, run_space)) == NULL)
             return -1;
         s->cur_runs = bufptr;
-        if ((bufptr = (uint32_t *) realloc(s->ref_runs, run_space)) == NULL)
+        if ((bufptr = (uint32_t *) span_realloc(s->ref_runs, run_space)) == NULL)
             return -1;
         s->ref_runs = bufptr;
-        if ((bufptr8 = realloc(s->row_buf, s->bytes_per_row)) == NULL)
+        if ((bufptr8 = span_realloc(s->row_buf, s->bytes_per_row)) == NULL)
             return -1;
         s->row_buf = bufptr8;
+        s->run_space = run_space;
     }
     s->ref_runs[0] =
     s->ref_runs[1] =
@@ -1435,6 +1438,32 @@ SPAN_DECLARE(int) t4_tx_get_bit(t4_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) t4_tx_get_bits(t4_state_t *s, unsigned int *bits)
+{
+    int n;
+
+    if (s->t4_t6_tx.bit_ptr >= s->image_size)
+        return SIG_STATUS_END_OF_DATA;
+    if (s->t4_t6_tx.bit_pos != 7)
+    {
+        /* Finish off a partly sent byte */
+        n = s->t4_t6_tx.bit_pos + 1;
+        *bits = bit_reverse8(s->image_buffer[s->t4_t6_tx.bit_ptr++]) & ((1 << n) - 1);
+        s->t4_t6_tx.bit_pos = 7;
+        return n;
+    }
+    if (s->t4_t6_tx.bit_ptr + 1 < s->image_size)
+    {
+        *bits = ((unsigned int) bit_reverse8(s->image_buffer[s->t4_t6_tx.bit_ptr]) << 8)
+              | bit_reverse8(s->image_buffer[s->t4_t6_tx.bit_ptr + 1]);
+        s->t4_t6_tx.bit_ptr += 2;
+        return 16;
+    }
+    *bits = bit_reverse8(s->image_buffer[s->t4_t6_tx.bit_ptr++]);
+    return 8;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(int) t4_tx_get_byte(t4_state_t *s)
 {
     if (s->t4_t6_tx.bit_ptr >= s->image_size)
@@ -1482,7 +1511,7 @@ SPAN_DECLARE(int) t4_tx_free(t4_state_t *s)
     int ret;
 
     ret = t4_tx_release(s);
-    free(s);
+    span_free(s);
     return ret;
 }
 /*- End of function --------------------------------------------------------*/
@@ -1570,4 +1599,23 @@ SPAN_DECLARE(void) t4_tx_get_transfer_statistics(t4_state_t *s, t4_stats_t *t)
     t->line_image_size = s->line_image_size/8;
 }
 /*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t4_tx_get_memory_usage(t4_state_t *s)
+{
+    int size;
+
+    size = sizeof(*s);
+    if (s->image_buffer)
+        size += s->image_buffer_size;
+    if (s->cur_runs)
+        size += s->run_space;
+    if (s->ref_runs)
+        size += s->run_space;
+    if (s->row_buf)
+        size += s->bytes_per_row;
+    if (s->tiff.file)
+        size += strlen(s->tiff.file) + 1;
+    return size;
+}
+/*- End of function --------------------------------------------------------*/
 /*- End of file ------------------------------------------------------------*/
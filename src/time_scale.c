@@ -43,8 +43,12 @@
 #include <math.h>
 #endif
 #include "floating_fudge.h"
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+#include "mmx_sse_decs.h"
+#endif
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/fast_convert.h"
 #include "spandsp/time_scale.h"
 #include "spandsp/saturated.h"
@@ -56,7 +60,116 @@
     OverLap and Add (PICOLA) method, developed by Morita Naotaka.
  */
 
-static __inline__ int amdf_pitch(int min_pitch, int max_pitch, int16_t amp[], int len)
+/* Once the pitch is known, each search looks closely within this fraction of the
+   last pitch, either side of it. */
+#define PITCH_TRACK_SHIFT           3
+/* The lag step for the coarse search of the whole pitch range, which catches the
+   pitch moving away from the last one. */
+#define PITCH_COARSE_STEP           4
+
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+static __inline__ int amdf_pitch(int min_pitch, int max_pitch, int step, int16_t amp[], int len, int *best_acc)
+{
+    __m128i zero;
+    __m128i x;
+    __m128i y;
+    __m128i d;
+    __m128i sum;
+    int32_t part[4];
+    int i;
+    int j;
+    int acc;
+    int min_acc;
+    int pitch;
+
+    /* |x - y| is found as max(x, y) - min(x, y), which fits in an unsigned 16 bit
+       lane. It is widened to 32 bits before it is summed. The sums are exact, so
+       the same pitch is chosen as by the simple code. */
+    zero = _mm_setzero_si128();
+    pitch = min_pitch;
+    min_acc = INT_MAX;
+    for (i = max_pitch;  i <= min_pitch;  i += step)
+    {
+        sum = _mm_setzero_si128();
+        for (j = 0;  j + 8 <= len;  j += 8)
+        {
+            x = _mm_loadu_si128((const __m128i *) &amp[i + j]);
+            y = _mm_loadu_si128((const __m128i *) &amp[j]);
+            d = _mm_sub_epi16(_mm_max_epi16(x, y), _mm_min_epi16(x, y));
+            sum = _mm_add_epi32(sum, _mm_unpacklo_epi16(d, zero));
+            sum = _mm_add_epi32(sum, _mm_unpackhi_epi16(d, zero));
+        }
+        /*endfor*/
+        _mm_storeu_si128((__m128i *) part, sum);
+        acc = part[0] + part[1] + part[2] + part[3];
+        for (  ;  j < len;  j++)
+            acc += abs(amp[i + j] - amp[j]);
+        /*endfor*/
+        if (acc < min_acc)
+        {
+            min_acc = acc;
+            pitch = i;
+        }
+        /*endif*/
+    }
+    /*endfor*/
+    *best_acc = min_acc;
+    return pitch;
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ void overlap_add(int16_t amp1[], int16_t amp2[], int len)
+{
+    __m128i index;
+    __m128i four;
+    __m128 step;
+    __m128 one;
+    __m128 weight;
+    __m128i x1;
+    __m128i x2;
+    __m128i sign1;
+    __m128i sign2;
+    __m128i lo;
+    __m128i hi;
+    float fstep;
+    float fweight;
+    int i;
+
+    /* The weight for each sample is calculated from its position, rather than by
+       repeated addition, so the vector and scalar parts give exactly the same
+       answers. */
+    fstep = 1.0f/len;
+    step = _mm_set1_ps(fstep);
+    one = _mm_set1_ps(1.0f);
+    index = _mm_set_epi32(3, 2, 1, 0);
+    four = _mm_set1_epi32(4);
+    for (i = 0;  i + 8 <= len;  i += 8)
+    {
+        x1 = _mm_loadu_si128((const __m128i *) &amp1[i]);
+        x2 = _mm_loadu_si128((const __m128i *) &amp2[i]);
+        sign1 = _mm_srai_epi16(x1, 15);
+        sign2 = _mm_srai_epi16(x2, 15);
+        weight = _mm_mul_ps(_mm_cvtepi32_ps(index), step);
+        index = _mm_add_epi32(index, four);
+        lo = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(x1, sign1)), _mm_sub_ps(one, weight)),
+                                         _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(x2, sign2)), weight)));
+        weight = _mm_mul_ps(_mm_cvtepi32_ps(index), step);
+        index = _mm_add_epi32(index, four);
+        hi = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(x1, sign1)), _mm_sub_ps(one, weight)),
+                                         _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(x2, sign2)), weight)));
+        _mm_storeu_si128((__m128i *) &amp2[i], _mm_packs_epi32(lo, hi));
+    }
+    /*endfor*/
+    for (  ;  i < len;  i++)
+    {
+        fweight = (float) i*fstep;
+        amp2[i] = (int16_t) ((float) amp1[i]*(1.0f - fweight) + (float) amp2[i]*fweight);
+    }
+    /*endfor*/
+}
+/*- End of function --------------------------------------------------------*/
+#else
+static __inline__ int amdf_pitch(int min_pitch, int max_pitch, int step, int16_t amp[], int len, int *best_acc)
 {
     int i;
     int j;
@@ -66,7 +179,7 @@ static __inline__ int amdf_pitch(int min_pitch, int max_pitch, int16_t amp[], in
 
     pitch = min_pitch;
     min_acc = INT_MAX;
-    for (i = max_pitch;  i <= min_pitch;  i++)
+    for (i = max_pitch;  i <= min_pitch;  i += step)
     {
         acc = 0;
         for (j = 0;  j < len;  j++)
@@ -77,6 +190,7 @@ static __inline__ int amdf_pitch(int min_pitch, int max_pitch, int16_t amp[], in
             pitch = i;
         }
     }
+    *best_acc = min_acc;
     return pitch;
 }
 /*- End of function --------------------------------------------------------*/
@@ -88,15 +202,66 @@ static __inline__ void overlap_add(int16_t amp1[], int16_t amp2[], int len)
     float step;
     
     step = 1.0f/len;
-    weight = 0.0f;
     for (i = 0;  i < len;  i++)
     {
+        /* The weight is calculated from the position, rather than by repeated
+           addition, to match the SSE2 code exactly. */
         /* TODO: saturate */
+        weight = (float) i*step;
         amp2[i] = (int16_t) ((float) amp1[i]*(1.0f - weight) + (float) amp2[i]*weight);
-        weight += step;
     }
 }
 /*- End of function --------------------------------------------------------*/
+#endif
+
+static int find_pitch(time_scale_state_t *s)
+{
+    int lo;
+    int hi;
+    int pitch;
+    int acc;
+    int coarse_pitch;
+    int coarse_acc;
+
+    if (s->pitch == 0)
+    {
+        s->pitch = amdf_pitch(s->min_pitch, s->max_pitch, 1, s->buf, s->min_pitch, &acc);
+        return s->pitch;
+    }
+    /*endif*/
+    /* Pitch usually changes slowly, so look closely around the last pitch. Look
+       coarsely over the whole range, and if that finds a better match somewhere
+       else, look closely around that instead. */
+    lo = s->pitch - (s->pitch >> PITCH_TRACK_SHIFT);
+    if (lo < s->max_pitch)
+        lo = s->max_pitch;
+    /*endif*/
+    hi = s->pitch + (s->pitch >> PITCH_TRACK_SHIFT);
+    if (hi > s->min_pitch)
+        hi = s->min_pitch;
+    /*endif*/
+    pitch = amdf_pitch(hi, lo, 1, s->buf, s->min_pitch, &acc);
+    coarse_pitch = amdf_pitch(s->min_pitch, s->max_pitch, PITCH_COARSE_STEP, s->buf, s->min_pitch, &coarse_acc);
+    if (coarse_acc < acc)
+    {
+        lo = coarse_pitch - (PITCH_COARSE_STEP - 1);
+        if (lo < s->max_pitch)
+            lo = s->max_pitch;
+        /*endif*/
+        hi = coarse_pitch + (PITCH_COARSE_STEP - 1);
+        if (hi > s->min_pitch)
+            hi = s->min_pitch;
+        /*endif*/
+        coarse_pitch = amdf_pitch(hi, lo, 1, s->buf, s->min_pitch, &coarse_acc);
+        if (coarse_acc < acc)
+            pitch = coarse_pitch;
+        /*endif*/
+    }
+    /*endif*/
+    s->pitch = pitch;
+    return pitch;
+}
+/*- End of function --------------------------------------------------------*/
 
 SPAN_DECLARE(int) time_scale_rate(time_scale_state_t *s, float playout_rate)
 {
@@ -132,7 +297,7 @@ SPAN_DECLARE(time_scale_state_t *) time_scale_init(time_scale_state_t *s, int sa
     alloced = FALSE;
     if (s == NULL)
     {
-        if ((s = (time_scale_state_t *) malloc(sizeof (*s))) == NULL)
+        if ((s = (time_scale_state_t *) span_alloc(sizeof (*s))) == NULL)
             return  NULL;
         /*endif*/
         alloced = TRUE;
@@ -145,13 +310,14 @@ SPAN_DECLARE(time_scale_state_t *) time_scale_init(time_scale_state_t *s, int sa
     if (time_scale_rate(s, playout_rate))
     {
         if (alloced)
-            free(s);
+            span_free(s);
         return NULL;
     }
     /*endif*/
     s->rate_nudge = 0.0f;
     s->fill = 0;
     s->lcp = 0;
+    s->pitch = 0;
     return s;
 }
 /*- End of function --------------------------------------------------------*/
@@ -164,7 +330,7 @@ SPAN_DECLARE(int) time_scale_release(time_scale_state_t *s)
 
 SPAN_DECLARE(int) time_scale_free(time_scale_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -233,7 +399,7 @@ SPAN_DECLARE(int) time_scale(time_scale_state_t *s, int16_t out[], int16_t in[],
         }
         else
         {
-            pitch = amdf_pitch(s->min_pitch, s->max_pitch, s->buf, s->min_pitch);
+            pitch = find_pitch(s);
             lcpf = (double) pitch*s->rcomp;
             /* Nudge around to compensate for fractional samples */
             s->lcp = (int) lcpf;
@@ -277,6 +443,36 @@ SPAN_DECLARE(int) time_scale(time_scale_state_t *s, int16_t out[], int16_t in[],
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) time_scale_batch(time_scale_state_t *s[],
+                                   int16_t *out[],
+                                   int16_t *in[],
+                                   int len,
+                                   int out_len[],
+                                   int channels)
+{
+    int k;
+
+    for (k = 0;  k < channels;  k++)
+        out_len[k] = time_scale(s[k], out[k], in[k], len);
+    /*endfor*/
+    return channels;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) time_scale_flush(time_scale_state_t *s, int16_t out[])
+{
+    int out_len;
+
+    /* Everything in the buffer is output which is still to be delivered, whatever
+       stage the overlap and add cycle has reached. */
+    out_len = s->fill;
+    memcpy(out, s->buf, sizeof(int16_t)*out_len);
+    s->fill = 0;
+    s->lcp = 0;
+    return out_len;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(int) time_scale_max_output_len(time_scale_state_t *s, int input_len)
 {
     return (int) (input_len*s->playout_rate + s->min_pitch + 1);
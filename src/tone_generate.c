@@ -43,7 +43,10 @@
 #endif
 #include "floating_fudge.h"
 
+#include "mmx_sse_decs.h"
+
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/fast_convert.h"
 #include "spandsp/dc_restore.h"
 #include "spandsp/complex.h"
@@ -57,6 +60,9 @@
 #define M_PI 3.14159265358979323846264338327
 #endif
 
+/*! The number of samples of tone generated in one pass */
+#define TONE_GEN_BLOCK_LEN  64
+
 SPAN_DECLARE(tone_gen_descriptor_t *) tone_gen_descriptor_init(tone_gen_descriptor_t *s,
                                                                int f1,
                                                                int l1,
@@ -70,7 +76,7 @@ SPAN_DECLARE(tone_gen_descriptor_t *) tone_gen_descriptor_init(tone_gen_descript
 {
     if (s == NULL)
     {
-        if ((s = (tone_gen_descriptor_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (tone_gen_descriptor_t *) span_alloc(sizeof(*s))) == NULL)
         {
             return NULL;
         }
@@ -115,21 +121,149 @@ SPAN_DECLARE(tone_gen_descriptor_t *) tone_gen_descriptor_init(tone_gen_descript
 
 SPAN_DECLARE(void) tone_gen_descriptor_free(tone_gen_descriptor_t *s)
 {
-    free(s);
+    span_free(s);
 }
 /*- End of function --------------------------------------------------------*/
 
-SPAN_DECLARE_NONSTD(int) tone_gen(tone_gen_state_t *s, int16_t amp[], int max_samples)
+#if !defined(SPANDSP_USE_FIXED_POINT)
+static __inline__ void float_to_int16_block(int16_t amp[], const float x[], int len)
 {
-    int samples;
-    int limit;
+    int j;
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+    __m128i a;
+    __m128i b;
+#endif
+
+    j = 0;
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+    for (  ;  j <= len - 8;  j += 8)
+    {
+#if defined(__x86_64__)
+        /* lfastrintf() truncates on x86_64, and rounds on i386 */
+        a = _mm_cvttps_epi32(_mm_loadu_ps(&x[j]));
+        b = _mm_cvttps_epi32(_mm_loadu_ps(&x[j + 4]));
+#else
+        a = _mm_cvtps_epi32(_mm_loadu_ps(&x[j]));
+        b = _mm_cvtps_epi32(_mm_loadu_ps(&x[j + 4]));
+#endif
+        /* Wrap, rather than saturate, so we match the scalar conversion exactly */
+        a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+        b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+        _mm_storeu_si128((__m128i *) &amp[j], _mm_packs_epi32(a, b));
+    }
+#endif
+    for (  ;  j < len;  j++)
+        amp[j] = (int16_t) lfastrintf(x[j]);
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+static void tone_block(tone_gen_state_t *s, int16_t amp[], int len)
+{
+    int i;
+    int j;
+#if defined(SPANDSP_USE_FIXED_POINT)
+    int16_t xamp[TONE_GEN_BLOCK_LEN];
+    int16_t tone[TONE_GEN_BLOCK_LEN];
+#else
+    float xamp[TONE_GEN_BLOCK_LEN];
+    float tone[TONE_GEN_BLOCK_LEN];
+#endif
+
+    /* Each tone is generated for the whole block, and then the tones are combined.
+       This gives exactly the same result as combining them sample by sample. */
+    if (s->tone[0].phase_rate < 0)
+    {
+        /* Modulated tone */
+        /* There must be two, and only two, tones */
+#if defined(SPANDSP_USE_FIXED_POINT)
+        dds_mod_block(&s->phase[0], -s->tone[0].phase_rate, s->tone[0].gain, 0, xamp, len);
+        dds_mod_block(&s->phase[1], s->tone[1].phase_rate, s->tone[1].gain, 0, tone, len);
+        for (j = 0;  j < len;  j++)
+            amp[j] = ((int32_t) xamp[j]*(32767 + (int32_t) tone[j])) >> 15;
+#else
+        dds_modf_block(&s->phase[0], -s->tone[0].phase_rate, s->tone[0].gain, 0, xamp, len);
+        dds_modf_block(&s->phase[1], s->tone[1].phase_rate, s->tone[1].gain, 0, tone, len);
+        j = 0;
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+        for (  ;  j <= len - 4;  j += 4)
+            _mm_storeu_ps(&xamp[j], _mm_mul_ps(_mm_loadu_ps(&xamp[j]), _mm_add_ps(_mm_set1_ps(1.0f), _mm_loadu_ps(&tone[j]))));
+#endif
+        for (  ;  j < len;  j++)
+            xamp[j] = xamp[j]*(1.0f + tone[j]);
+        float_to_int16_block(amp, xamp, len);
+#endif
+        return;
+    }
+    if (s->tone[0].phase_rate == 0)
+    {
+        memset(amp, 0, sizeof(int16_t)*len);
+        return;
+    }
 #if defined(SPANDSP_USE_FIXED_POINT)
-    int16_t xamp;
+    dds_mod_block(&s->phase[0], s->tone[0].phase_rate, s->tone[0].gain, 0, xamp, len);
 #else
-    float xamp;
+    dds_modf_block(&s->phase[0], s->tone[0].phase_rate, s->tone[0].gain, 0, xamp, len);
+#endif
+    for (i = 1;  i < 4;  i++)
+    {
+        if (s->tone[i].phase_rate == 0)
+            break;
+        j = 0;
+#if defined(SPANDSP_USE_FIXED_POINT)
+        dds_mod_block(&s->phase[i], s->tone[i].phase_rate, s->tone[i].gain, 0, tone, len);
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+        for (  ;  j <= len - 8;  j += 8)
+            _mm_storeu_si128((__m128i *) &xamp[j], _mm_add_epi16(_mm_loadu_si128((__m128i *) &xamp[j]), _mm_loadu_si128((__m128i *) &tone[j])));
 #endif
+#else
+        dds_modf_block(&s->phase[i], s->tone[i].phase_rate, s->tone[i].gain, 0, tone, len);
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+        for (  ;  j <= len - 4;  j += 4)
+            _mm_storeu_ps(&xamp[j], _mm_add_ps(_mm_loadu_ps(&xamp[j]), _mm_loadu_ps(&tone[j])));
+#endif
+#endif
+        for (  ;  j < len;  j++)
+            xamp[j] += tone[j];
+    }
+    /* Saturation of the answer is the right thing at this point.
+       However, we are normally generating well controlled tones,
+       that cannot clip. So, the overhead of doing saturation is
+       a waste of valuable time. */
+#if defined(SPANDSP_USE_FIXED_POINT)
+    memcpy(amp, xamp, sizeof(int16_t)*len);
+#else
+    float_to_int16_block(amp, xamp, len);
+#endif
+}
+/*- End of function --------------------------------------------------------*/
+
+static void tone_skip(tone_gen_state_t *s, int len)
+{
     int i;
 
+    /* Advance the oscillators as though len samples had been generated */
+    if (s->tone[0].phase_rate < 0)
+    {
+        s->phase[0] += (uint32_t) -s->tone[0].phase_rate*len;
+        s->phase[1] += (uint32_t) s->tone[1].phase_rate*len;
+        return;
+    }
+    for (i = 0;  i < 4;  i++)
+    {
+        if (s->tone[i].phase_rate == 0)
+            break;
+        s->phase[i] += (uint32_t) s->tone[i].phase_rate*len;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static int tone_gen_run(tone_gen_state_t *s, int16_t amp[], int max_samples)
+{
+    int samples;
+    int limit;
+    int len;
+
     if (s->current_section < 0)
         return  0;
 
@@ -140,7 +274,14 @@ SPAN_DECLARE_NONSTD(int) tone_gen(tone_gen_state_t *s, int16_t amp[], int max_sa
             limit = max_samples;
         
         s->current_position += (limit - samples);
-        if (s->current_section & 1)
+        if (amp == NULL)
+        {
+            /* Just keep track of where we are in the cadence */
+            if ((s->current_section & 1) == 0)
+                tone_skip(s, limit - samples);
+            samples = limit;
+        }
+        else if (s->current_section & 1)
         {
             /* A silent section */
             for (  ;  samples < limit;  samples++)
@@ -148,52 +289,11 @@ SPAN_DECLARE_NONSTD(int) tone_gen(tone_gen_state_t *s, int16_t amp[], int max_sa
         }
         else
         {
-            if (s->tone[0].phase_rate < 0)
-            {
-                /* Modulated tone */
-                for (  ;  samples < limit;  samples++)
-                {
-                    /* There must be two, and only two, tones */
-#if defined(SPANDSP_USE_FIXED_POINT)
-                    xamp = ((int32_t) dds_mod(&s->phase[0], -s->tone[0].phase_rate, s->tone[0].gain, 0)
-                            *(32767 + (int32_t) dds_mod(&s->phase[1], s->tone[1].phase_rate, s->tone[1].gain, 0))) >> 15;
-                    amp[samples] = xamp;
-#else
-                    xamp = dds_modf(&s->phase[0], -s->tone[0].phase_rate, s->tone[0].gain, 0)
-                         *(1.0f + dds_modf(&s->phase[1], s->tone[1].phase_rate, s->tone[1].gain, 0));
-                    amp[samples] = (int16_t) lfastrintf(xamp);
-#endif
-                }
-            }
-            else
+            for (  ;  samples < limit;  samples += len)
             {
-                for (  ;  samples < limit;  samples++)
-                {
-#if defined(SPANDSP_USE_FIXED_POINT)
-                    xamp = 0;
-#else
-                    xamp = 0.0f;
-#endif
-                    for (i = 0;  i < 4;  i++)
-                    {
-                        if (s->tone[i].phase_rate == 0)
-                            break;
-#if defined(SPANDSP_USE_FIXED_POINT)
-                        xamp += dds_mod(&s->phase[i], s->tone[i].phase_rate, s->tone[i].gain, 0);
-#else
-                        xamp += dds_modf(&s->phase[i], s->tone[i].phase_rate, s->tone[i].gain, 0);
-#endif
-                    }
-                    /* Saturation of the answer is the right thing at this point.
-                       However, we are normally generating well controlled tones,
-                       that cannot clip. So, the overhead of doing saturation is
-                       a waste of valuable time. */
-#if defined(SPANDSP_USE_FIXED_POINT)
-                    amp[samples] = xamp;
-#else
-                    amp[samples] = (int16_t) lfastrintf(xamp);
-#endif
-                }
+                if ((len = limit - samples) > TONE_GEN_BLOCK_LEN)
+                    len = TONE_GEN_BLOCK_LEN;
+                tone_block(s, &amp[samples], len);
             }
         }
         if (s->current_position >= s->duration[s->current_section])
@@ -215,13 +315,19 @@ SPAN_DECLARE_NONSTD(int) tone_gen(tone_gen_state_t *s, int16_t amp[], int max_sa
 }
 /*- End of function --------------------------------------------------------*/
 
-SPAN_DECLARE(tone_gen_state_t *) tone_gen_init(tone_gen_state_t *s, tone_gen_descriptor_t *t)
+SPAN_DECLARE_NONSTD(int) tone_gen(tone_gen_state_t *s, int16_t amp[], int max_samples)
+{
+    return tone_gen_run(s, amp, max_samples);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(tone_gen_state_t *) tone_gen_init(tone_gen_state_t *s, const tone_gen_descriptor_t *t)
 {
     int i;
 
     if (s == NULL)
     {
-        if ((s = (tone_gen_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (tone_gen_state_t *) span_alloc(sizeof(*s))) == NULL)
         {
             return NULL;
         }
@@ -253,7 +359,105 @@ SPAN_DECLARE(int) tone_gen_release(tone_gen_state_t *s)
 SPAN_DECLARE(int) tone_gen_free(tone_gen_state_t *s)
 {
     if (s)
-        free(s);
+        span_free(s);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) tone_gen_shared_tick(tone_gen_shared_t *s)
+{
+    int len;
+
+    if (s->subscribers <= 0)
+    {
+        /* Nobody is listening, so just keep the cadence running */
+        s->len = tone_gen_run(&s->gen, NULL, s->frame_len);
+        return s->len;
+    }
+    len = tone_gen_run(&s->gen, s->frame, s->frame_len);
+    /* Once a non-repeating tone has finished, the rest of the frame is silence */
+    if (len < s->frame_len)
+        memset(&s->frame[len], 0, sizeof(int16_t)*(s->frame_len - len));
+    s->len = len;
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(const int16_t *) tone_gen_shared_frame(tone_gen_shared_t *s, int *len)
+{
+    if (len)
+        *len = s->len;
+    return s->frame;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) tone_gen_shared_subscribe(tone_gen_shared_t *s)
+{
+    if (s->subscribers++ == 0)
+    {
+        /* The frame was not rendered while nobody was listening, so it holds stale
+           samples, even if the tone has since finished. Blank it, so a new subscriber
+           hears silence until the next tick. */
+        memset(s->frame, 0, sizeof(int16_t)*s->frame_len);
+        s->len = 0;
+    }
+    return s->subscribers;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) tone_gen_shared_unsubscribe(tone_gen_shared_t *s)
+{
+    if (s->subscribers > 0)
+        s->subscribers--;
+    return s->subscribers;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(tone_gen_shared_t *) tone_gen_shared_init(tone_gen_shared_t *s, const tone_gen_descriptor_t *t, int frame_len)
+{
+    int16_t *frame;
+
+    if (frame_len <= 0)
+        return NULL;
+    if ((frame = (int16_t *) span_alloc(sizeof(int16_t)*frame_len)) == NULL)
+        return NULL;
+    if (s == NULL)
+    {
+        if ((s = (tone_gen_shared_t *) span_alloc(sizeof(*s))) == NULL)
+        {
+            span_free(frame);
+            return NULL;
+        }
+    }
+    memset(s, 0, sizeof(*s));
+    tone_gen_init(&s->gen, t);
+    memset(frame, 0, sizeof(int16_t)*frame_len);
+    s->frame = frame;
+    s->frame_len = frame_len;
+    s->len = 0;
+    s->subscribers = 0;
+    return s;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) tone_gen_shared_release(tone_gen_shared_t *s)
+{
+    if (s->frame)
+    {
+        span_free(s->frame);
+        s->frame = NULL;
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) tone_gen_shared_free(tone_gen_shared_t *s)
+{
+    if (s)
+    {
+        tone_gen_shared_release(s);
+        span_free(s);
+    }
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
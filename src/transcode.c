@@ -0,0 +1,956 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * transcode.c - Offline transcoding of recorded audio between the
+ *               speech codecs, using a pool of worker threads.
+ *
+ * Written by Steve Underwood <steveu@coppice.org>
+ *
+ * Copyright (C) 2010 Steve Underwood
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#if defined(HAVE_PTHREAD_H)  &&  defined(HAVE_LIBPTHREAD)
+#include <pthread.h>
+#define TRANSCODE_USE_THREADS
+#endif
+
+#include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
+#include "spandsp/bit_operations.h"
+#include "spandsp/bitstream.h"
+#include "spandsp/g711.h"
+#include "spandsp/g722.h"
+#include "spandsp/g726.h"
+#include "spandsp/gsm0610.h"
+#include "spandsp/ima_adpcm.h"
+#include "spandsp/oki_adpcm.h"
+#include "spandsp/lpc10.h"
+#include "spandsp/transcode.h"
+
+#include "spandsp/private/bitstream.h"
+#include "spandsp/private/g711.h"
+#include "spandsp/private/g722.h"
+#include "spandsp/private/g726.h"
+#include "spandsp/private/gsm0610.h"
+#include "spandsp/private/ima_adpcm.h"
+#include "spandsp/private/oki_adpcm.h"
+#include "spandsp/private/lpc10.h"
+#include "spandsp/private/transcode.h"
+
+/* The number of samples of linear audio handled in each block. The input is
+   decoded in blocks of about this size, which are then encoded straight to
+   the output buffer. */
+#define TRANSCODE_BLOCK_SAMPLES     16384
+/* Jobs which can be split are split into segments of about this many samples */
+#define TRANSCODE_SEGMENT_SAMPLES   (60*SAMPLE_RATE)
+/* The number of samples in a GSM 06.10 frame */
+#define GSM0610_FRAME_SAMPLES       160
+/* The largest IMA ADPCM chunk we accept, in samples */
+#define TRANSCODE_MAX_CHUNK_SIZE    4096
+
+typedef struct
+{
+    /*! The job the segment belongs to */
+    transcode_job_t *job;
+    /*! The start of the segment in the input data */
+    int in_start;
+    /*! The end of the segment in the input data */
+    int in_end;
+    /*! The start of the segment's output in the output buffer */
+    int out_start;
+    /*! TRUE if the segment is the whole of the job */
+    int whole;
+} transcode_segment_t;
+
+/* The codec contexts and audio buffer used by one worker */
+typedef struct
+{
+    /*! The pool the worker belongs to */
+    transcode_pool_t *pool;
+    union
+    {
+        g711_state_t g711;
+        g722_decode_state_t g722;
+        g726_state_t g726;
+        gsm0610_state_t gsm0610;
+        ima_adpcm_state_t ima_adpcm;
+        oki_adpcm_state_t oki_adpcm;
+        lpc10_decode_state_t lpc10;
+    } dec;
+    union
+    {
+        g711_state_t g711;
+        g722_encode_state_t g722;
+        g726_state_t g726;
+        gsm0610_state_t gsm0610;
+        ima_adpcm_state_t ima_adpcm;
+        oki_adpcm_state_t oki_adpcm;
+        lpc10_encode_state_t lpc10;
+    } enc;
+    int16_t amp[2*TRANSCODE_BLOCK_SAMPLES];
+} transcode_worker_t;
+
+struct transcode_pool_s
+{
+    /*! The number of worker threads */
+    int threads;
+    /*! The number of worker contexts */
+    int workers;
+    /*! The worker contexts, one for each thread, or a single one used by the
+        calling thread when there are no worker threads */
+    transcode_worker_t **worker;
+    /*! The segments of work for the current run */
+    transcode_segment_t *segments;
+    /*! The number of segments there is space for */
+    int nsegments_max;
+    /*! The number of segments in the current run */
+    int nsegments;
+    /*! The next segment to be handed to a worker */
+    int next_segment;
+    /*! The number of segments not yet completed */
+    int segments_pending;
+#if defined(TRANSCODE_USE_THREADS)
+    pthread_t *thread;
+    pthread_mutex_t mutex;
+    /*! Signalled when new work is available, or the workers should stop */
+    pthread_cond_t work_available;
+    /*! Signalled when the last segment of a run is completed */
+    pthread_cond_t work_done;
+    /*! TRUE when the workers should stop */
+    int stopping;
+#endif
+};
+
+static int format_ok(const transcode_format_t *f)
+{
+    switch (f->format)
+    {
+    case TRANSCODE_FORMAT_LINEAR:
+    case TRANSCODE_FORMAT_ALAW:
+    case TRANSCODE_FORMAT_ULAW:
+    case TRANSCODE_FORMAT_LPC10:
+        return TRUE;
+    case TRANSCODE_FORMAT_G722:
+        if (f->bit_rate != 64000  &&  f->bit_rate != 56000  &&  f->bit_rate != 48000)
+            return FALSE;
+        return ((f->variant & ~G722_PACKED) == 0);
+    case TRANSCODE_FORMAT_G726:
+        if (f->bit_rate != 16000  &&  f->bit_rate != 24000  &&  f->bit_rate != 32000  &&  f->bit_rate != 40000)
+            return FALSE;
+        return (f->variant >= G726_PACKING_NONE  &&  f->variant <= G726_PACKING_RIGHT);
+    case TRANSCODE_FORMAT_GSM0610:
+        return (f->variant >= GSM0610_PACKING_NONE  &&  f->variant <= GSM0610_PACKING_VOIP);
+    case TRANSCODE_FORMAT_IMA_ADPCM:
+        if (f->chunk_size < 0  ||  f->chunk_size > TRANSCODE_MAX_CHUNK_SIZE)
+            return FALSE;
+        /* VDVI is variable length, so a stream of it cannot be divided up */
+        if (f->variant == IMA_ADPCM_IMA4)
+            return (f->chunk_size == 0  ||  (f->chunk_size & 1));
+        if (f->variant == IMA_ADPCM_DVI4)
+            return ((f->chunk_size & 1) == 0);
+        return FALSE;
+    case TRANSCODE_FORMAT_OKI_ADPCM:
+        return (f->bit_rate == 32000  ||  f->bit_rate == 24000);
+    }
+    /*endswitch*/
+    return FALSE;
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Find the size of the units in which the input must be decoded, and the most
+   samples a unit can decode to. */
+static int in_unit(const transcode_format_t *f, int *samples)
+{
+    switch (f->format)
+    {
+    case TRANSCODE_FORMAT_LINEAR:
+        *samples = 1;
+        return sizeof(int16_t);
+    case TRANSCODE_FORMAT_ALAW:
+    case TRANSCODE_FORMAT_ULAW:
+        *samples = 1;
+        return 1;
+    case TRANSCODE_FORMAT_GSM0610:
+        *samples = (f->variant == GSM0610_PACKING_WAV49)  ?  2*GSM0610_FRAME_SAMPLES  :  GSM0610_FRAME_SAMPLES;
+        if (f->variant == GSM0610_PACKING_WAV49)
+            return 65;
+        return (f->variant == GSM0610_PACKING_VOIP)  ?  33  :  76;
+    case TRANSCODE_FORMAT_LPC10:
+        *samples = LPC10_SAMPLES_PER_FRAME;
+        return 7;
+    case TRANSCODE_FORMAT_IMA_ADPCM:
+        if (f->chunk_size)
+        {
+            *samples = f->chunk_size;
+            return 4 + ((f->variant == IMA_ADPCM_IMA4)  ?  (f->chunk_size - 1)/2  :  f->chunk_size/2);
+        }
+        /*endif*/
+        break;
+    }
+    /*endswitch*/
+    /* The remaining codecs may be decoded a byte at a time. None produces more than
+       4 samples from a byte. */
+    *samples = 4;
+    return 1;
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Find the number of samples an encoder must be given at once, and the most bytes
+   that can produce. */
+static int out_unit(const transcode_format_t *f, int *bytes)
+{
+    switch (f->format)
+    {
+    case TRANSCODE_FORMAT_LINEAR:
+        *bytes = sizeof(int16_t);
+        return 1;
+    case TRANSCODE_FORMAT_GSM0610:
+        if (f->variant == GSM0610_PACKING_WAV49)
+        {
+            *bytes = 65;
+            return 2*GSM0610_FRAME_SAMPLES;
+        }
+        /*endif*/
+        *bytes = (f->variant == GSM0610_PACKING_VOIP)  ?  33  :  76;
+        return GSM0610_FRAME_SAMPLES;
+    case TRANSCODE_FORMAT_LPC10:
+        *bytes = 7;
+        return LPC10_SAMPLES_PER_FRAME;
+    case TRANSCODE_FORMAT_IMA_ADPCM:
+        if (f->chunk_size)
+        {
+            *bytes = 4 + ((f->variant == IMA_ADPCM_IMA4)  ?  (f->chunk_size - 1)/2  :  f->chunk_size/2);
+            return f->chunk_size;
+        }
+        /*endif*/
+        break;
+    }
+    /*endswitch*/
+    /* The remaining codecs may be fed a sample at a time, and none produces more than
+       a byte from a sample. */
+    *bytes = 1;
+    return 1;
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Only G.722 to G.722 is converted at the full 16000 samples/second */
+static int wideband(const transcode_format_t *in_format, const transcode_format_t *out_format)
+{
+    return (in_format->format == TRANSCODE_FORMAT_G722  &&  out_format->format == TRANSCODE_FORMAT_G722);
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Jobs which may be split into segments are those where the input can be decoded
+   from the start of any unit, and the output encoded from any sample, with exactly
+   the same results as converting the job in one piece. */
+static int splittable(const transcode_job_t *s)
+{
+    switch (s->in_format.format)
+    {
+    case TRANSCODE_FORMAT_LINEAR:
+    case TRANSCODE_FORMAT_ALAW:
+    case TRANSCODE_FORMAT_ULAW:
+        break;
+    case TRANSCODE_FORMAT_IMA_ADPCM:
+        if (s->in_format.chunk_size == 0)
+            return FALSE;
+        /*endif*/
+        break;
+    default:
+        return FALSE;
+    }
+    /*endswitch*/
+    switch (s->out_format.format)
+    {
+    case TRANSCODE_FORMAT_LINEAR:
+    case TRANSCODE_FORMAT_ALAW:
+    case TRANSCODE_FORMAT_ULAW:
+        return TRUE;
+    }
+    /*endswitch*/
+    return FALSE;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void decoder_init(transcode_worker_t *w, const transcode_format_t *f, int wide)
+{
+    switch (f->format)
+    {
+    case TRANSCODE_FORMAT_ALAW:
+        g711_init(&w->dec.g711, G711_ALAW);
+        break;
+    case TRANSCODE_FORMAT_ULAW:
+        g711_init(&w->dec.g711, G711_ULAW);
+        break;
+    case TRANSCODE_FORMAT_G722:
+        g722_decode_init(&w->dec.g722, f->bit_rate, f->variant | ((wide)  ?  0  :  G722_SAMPLE_RATE_8000));
+        break;
+    case TRANSCODE_FORMAT_G726:
+        g726_init(&w->dec.g726, f->bit_rate, G726_ENCODING_LINEAR, f->variant);
+        break;
+    case TRANSCODE_FORMAT_GSM0610:
+        gsm0610_init(&w->dec.gsm0610, f->variant);
+        break;
+    case TRANSCODE_FORMAT_IMA_ADPCM:
+        /* A chunk size of zero makes the codec expect a header at the start of each
+           call, so chunked data is decoded one chunk per call. */
+        ima_adpcm_init(&w->dec.ima_adpcm, f->variant, (f->chunk_size)  ?  0  :  1);
+        break;
+    case TRANSCODE_FORMAT_OKI_ADPCM:
+        oki_adpcm_init(&w->dec.oki_adpcm, f->bit_rate);
+        break;
+    case TRANSCODE_FORMAT_LPC10:
+        lpc10_decode_init(&w->dec.lpc10, TRUE);
+        break;
+    }
+    /*endswitch*/
+}
+/*- End of function --------------------------------------------------------*/
+
+static void encoder_init(transcode_worker_t *w, const transcode_format_t *f, int wide)
+{
+    switch (f->format)
+    {
+    case TRANSCODE_FORMAT_ALAW:
+        g711_init(&w->enc.g711, G711_ALAW);
+        break;
+    case TRANSCODE_FORMAT_ULAW:
+        g711_init(&w->enc.g711, G711_ULAW);
+        break;
+    case TRANSCODE_FORMAT_G722:
+        g722_encode_init(&w->enc.g722, f->bit_rate, f->variant | ((wide)  ?  0  :  G722_SAMPLE_RATE_8000));
+        break;
+    case TRANSCODE_FORMAT_G726:
+        g726_init(&w->enc.g726, f->bit_rate, G726_ENCODING_LINEAR, f->variant);
+        break;
+    case TRANSCODE_FORMAT_GSM0610:
+        gsm0610_init(&w->enc.gsm0610, f->variant);
+        break;
+    case TRANSCODE_FORMAT_IMA_ADPCM:
+        ima_adpcm_init(&w->enc.ima_adpcm, f->variant, (f->chunk_size)  ?  0  :  1);
+        break;
+    case TRANSCODE_FORMAT_OKI_ADPCM:
+        oki_adpcm_init(&w->enc.oki_adpcm, f->bit_rate);
+        break;
+    case TRANSCODE_FORMAT_LPC10:
+        lpc10_encode_init(&w->enc.lpc10, TRUE);
+        break;
+    }
+    /*endswitch*/
+}
+/*- End of function --------------------------------------------------------*/
+
+static int decode_block(transcode_worker_t *w, const transcode_format_t *f, int16_t amp[], const uint8_t data[], int len)
+{
+    int i;
+    int step;
+    int samples;
+
+    switch (f->format)
+    {
+    case TRANSCODE_FORMAT_LINEAR:
+        memcpy(amp, data, len);
+        return len/sizeof(int16_t);
+    case TRANSCODE_FORMAT_ALAW:
+    case TRANSCODE_FORMAT_ULAW:
+        return g711_decode(&w->dec.g711, amp, data, len);
+    case TRANSCODE_FORMAT_G722:
+        return g722_decode(&w->dec.g722, amp, data, len);
+    case TRANSCODE_FORMAT_G726:
+        return g726_decode(&w->dec.g726, amp, data, len);
+    case TRANSCODE_FORMAT_GSM0610:
+        return gsm0610_decode(&w->dec.gsm0610, amp, data, len);
+    case TRANSCODE_FORMAT_IMA_ADPCM:
+        if (f->chunk_size == 0)
+            return ima_adpcm_decode(&w->dec.ima_adpcm, amp, data, len);
+        /*endif*/
+        step = in_unit(f, &samples);
+        samples = 0;
+        for (i = 0;  i < len;  i += step)
+            samples += ima_adpcm_decode(&w->dec.ima_adpcm, &amp[samples], &data[i], step);
+        /*endfor*/
+        return samples;
+    case TRANSCODE_FORMAT_OKI_ADPCM:
+        return oki_adpcm_decode(&w->dec.oki_adpcm, amp, data, len);
+    case TRANSCODE_FORMAT_LPC10:
+        return lpc10_decode(&w->dec.lpc10, amp, data, len);
+    }
+    /*endswitch*/
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int encode_block(transcode_worker_t *w, const transcode_format_t *f, uint8_t data[], const int16_t amp[], int len)
+{
+    int i;
+    int bytes;
+
+    switch (f->format)
+    {
+    case TRANSCODE_FORMAT_LINEAR:
+        memcpy(data, amp, len*sizeof(int16_t));
+        return len*sizeof(int16_t);
+    case TRANSCODE_FORMAT_ALAW:
+    case TRANSCODE_FORMAT_ULAW:
+        return g711_encode(&w->enc.g711, data, amp, len);
+    case TRANSCODE_FORMAT_G722:
+        return g722_encode(&w->enc.g722, data, amp, len);
+    case TRANSCODE_FORMAT_G726:
+        return g726_encode(&w->enc.g726, data, amp, len);
+    case TRANSCODE_FORMAT_GSM0610:
+        return gsm0610_encode(&w->enc.gsm0610, data, amp, len);
+    case TRANSCODE_FORMAT_IMA_ADPCM:
+        if (f->chunk_size == 0)
+            return ima_adpcm_encode(&w->enc.ima_adpcm, data, amp, len);
+        /*endif*/
+        bytes = 0;
+        for (i = 0;  i < len;  i += f->chunk_size)
+            bytes += ima_adpcm_encode(&w->enc.ima_adpcm, &data[bytes], &amp[i], f->chunk_size);
+        /*endfor*/
+        return bytes;
+    case TRANSCODE_FORMAT_OKI_ADPCM:
+        return oki_adpcm_encode(&w->enc.oki_adpcm, data, amp, len);
+    case TRANSCODE_FORMAT_LPC10:
+        return lpc10_encode(&w->enc.lpc10, data, amp, len);
+    }
+    /*endswitch*/
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Convert the whole units of input between in_start and in_end, to the output
+   buffer. */
+static int convert(transcode_worker_t *w,
+                   const transcode_job_t *s,
+                   int in_start,
+                   int in_end,
+                   uint8_t out[],
+                   int out_max,
+                   int *out_len,
+                   int *duration)
+{
+    int in_bytes;
+    int in_samples;
+    int out_bytes;
+    int out_samples;
+    int block;
+    int len;
+    int samples;
+    int held;
+    int wide;
+    int i;
+
+    wide = wideband(&s->in_format, &s->out_format);
+    decoder_init(w, &s->in_format, wide);
+    encoder_init(w, &s->out_format, wide);
+    in_bytes = in_unit(&s->in_format, &in_samples);
+    out_samples = out_unit(&s->out_format, &out_bytes);
+    block = (TRANSCODE_BLOCK_SAMPLES/in_samples)*in_bytes;
+
+    *out_len = 0;
+    *duration = 0;
+    held = 0;
+    for (i = in_start;  i < in_end;  i += len)
+    {
+        len = (in_end - i < block)  ?  (in_end - i)  :  block;
+        samples = decode_block(w, &s->in_format, &w->amp[held], &s->in[i], len);
+        *duration += samples;
+        held += samples;
+        /* Only whole units can be encoded, until the end of the input */
+        samples = held - held%out_samples;
+        if (samples > 0)
+        {
+            if (*out_len + (samples/out_samples)*out_bytes > out_max)
+                return TRANSCODE_ERROR_OUTPUT_FULL;
+            /*endif*/
+            *out_len += encode_block(w, &s->out_format, &out[*out_len], w->amp, samples);
+            held -= samples;
+            if (held > 0)
+                memmove(w->amp, &w->amp[samples], held*sizeof(int16_t));
+            /*endif*/
+        }
+        /*endif*/
+    }
+    /*endfor*/
+    if (held > 0)
+    {
+        /* Pad the final part unit with silence */
+        memset(&w->amp[held], 0, (out_samples - held)*sizeof(int16_t));
+        if (*out_len + out_bytes > out_max)
+            return TRANSCODE_ERROR_OUTPUT_FULL;
+        /*endif*/
+        *out_len += encode_block(w, &s->out_format, &out[*out_len], w->amp, out_samples);
+    }
+    /*endif*/
+    if (wide)
+        *duration /= 2;
+    /*endif*/
+    return TRANSCODE_OK;
+}
+/*- End of function --------------------------------------------------------*/
+
+static transcode_worker_t *worker_alloc(void)
+{
+    return (transcode_worker_t *) span_alloc(sizeof(transcode_worker_t));
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) transcode_max_output_len(const transcode_format_t *in_format,
+                                           int in_len,
+                                           const transcode_format_t *out_format)
+{
+    int in_bytes;
+    int in_samples;
+    int out_bytes;
+    int out_samples;
+    int64_t samples;
+    int64_t len;
+
+    if (!format_ok(in_format)  ||  !format_ok(out_format)  ||  in_len < 0)
+        return -1;
+    /*endif*/
+    in_bytes = in_unit(in_format, &in_samples);
+    out_samples = out_unit(out_format, &out_bytes);
+    samples = (int64_t) (in_len/in_bytes)*in_samples;
+    len = (samples + out_samples - 1)/out_samples*out_bytes;
+    if (len > INT32_MAX)
+        return -1;
+    /*endif*/
+    return (int) len;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(transcode_job_t *) transcode_job_init(transcode_job_t *s,
+                                                  const transcode_format_t *in_format,
+                                                  const uint8_t in[],
+                                                  int in_len,
+                                                  const transcode_format_t *out_format,
+                                                  uint8_t out[],
+                                                  int out_max)
+{
+    if (!format_ok(in_format)  ||  !format_ok(out_format)  ||  in_len < 0  ||  out_max < 0)
+        return NULL;
+    /*endif*/
+    if (s == NULL)
+    {
+        if ((s = (transcode_job_t *) span_alloc(sizeof(*s))) == NULL)
+            return NULL;
+    }
+    /*endif*/
+    memset(s, 0, sizeof(*s));
+    s->in_format = *in_format;
+    s->out_format = *out_format;
+    s->in = in;
+    s->in_len = in_len;
+    s->out = out;
+    s->out_max = out_max;
+    s->status = TRANSCODE_PENDING;
+    return s;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) transcode_job_release(transcode_job_t *s)
+{
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) transcode_job_free(transcode_job_t *s)
+{
+    span_free(s);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) transcode_job_run(transcode_job_t *s)
+{
+    transcode_worker_t *w;
+    int in_bytes;
+    int in_samples;
+
+    if ((w = worker_alloc()) == NULL)
+        return s->status = TRANSCODE_ERROR_RESOURCES;
+    /*endif*/
+    /* Any part unit at the end of the input is ignored */
+    in_bytes = in_unit(&s->in_format, &in_samples);
+    s->status = convert(w, s, 0, s->in_len - s->in_len%in_bytes, s->out, s->out_max, &s->out_len, &s->duration);
+    span_free(w);
+    return s->status;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) transcode_job_get_status(transcode_job_t *s)
+{
+    return s->status;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) transcode_job_get_output_len(transcode_job_t *s)
+{
+    return s->out_len;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) transcode_job_get_duration(transcode_job_t *s)
+{
+    return s->duration;
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Divide a set of jobs into segments of work for the pool. Jobs which cannot be
+   split become a single segment, and are placed first, as they are the ones most
+   likely to hold up the end of a run. Returns the number of segments. */
+static int make_segments(transcode_pool_t *s, transcode_job_t *jobs[], int njobs)
+{
+    transcode_job_t *job;
+    transcode_segment_t *seg;
+    int in_bytes;
+    int in_samples;
+    int out_bytes;
+    int units;
+    int step;
+    int n;
+    int i;
+    int j;
+    int pass;
+
+    /* Count the segments */
+    n = 0;
+    for (i = 0;  i < njobs;  i++)
+    {
+        job = jobs[i];
+        in_bytes = in_unit(&job->in_format, &in_samples);
+        if (splittable(job))
+        {
+            step = TRANSCODE_SEGMENT_SAMPLES/in_samples + 1;
+            units = job->in_len/in_bytes;
+            n += (units + step - 1)/step;
+        }
+        else
+        {
+            n++;
+        }
+        /*endif*/
+    }
+    /*endfor*/
+    if (n > s->nsegments_max)
+    {
+        if ((seg = (transcode_segment_t *) span_realloc(s->segments, n*sizeof(*seg))) == NULL)
+            return -1;
+        /*endif*/
+        s->segments = seg;
+        s->nsegments_max = n;
+    }
+    /*endif*/
+
+    n = 0;
+    for (pass = 0;  pass < 2;  pass++)
+    {
+        for (i = 0;  i < njobs;  i++)
+        {
+            job = jobs[i];
+            if (splittable(job) != pass)
+                continue;
+            /*endif*/
+            job->out_len = 0;
+            job->duration = 0;
+            job->segments_pending = 0;
+            job->status = TRANSCODE_PENDING;
+            in_bytes = in_unit(&job->in_format, &in_samples);
+            units = job->in_len/in_bytes;
+            if (!pass)
+            {
+                seg = &s->segments[n++];
+                seg->job = job;
+                seg->in_start = 0;
+                seg->in_end = units*in_bytes;
+                seg->out_start = 0;
+                seg->whole = TRUE;
+                job->segments_pending = 1;
+                continue;
+            }
+            /*endif*/
+            /* The output of a split job is a fixed number of bytes per input unit */
+            out_unit(&job->out_format, &out_bytes);
+            if ((int64_t) units*in_samples*out_bytes > job->out_max)
+            {
+                job->status = TRANSCODE_ERROR_OUTPUT_FULL;
+                continue;
+            }
+            /*endif*/
+            job->out_len = units*in_samples*out_bytes;
+            job->duration = units*in_samples;
+            if (units == 0)
+            {
+                job->status = TRANSCODE_OK;
+                continue;
+            }
+            /*endif*/
+            step = TRANSCODE_SEGMENT_SAMPLES/in_samples + 1;
+            for (j = 0;  j < units;  j += step)
+            {
+                seg = &s->segments[n++];
+                seg->job = job;
+                seg->in_start = j*in_bytes;
+                seg->in_end = ((j + step < units)  ?  (j + step)  :  units)*in_bytes;
+                seg->out_start = j*in_samples*out_bytes;
+                seg->whole = FALSE;
+                job->segments_pending++;
+            }
+            /*endfor*/
+        }
+        /*endfor*/
+    }
+    /*endfor*/
+    return n;
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Run one segment of work. Where threads are in use this is called without
+   the pool's mutex held, so the job's status is left for segment_done(). */
+static int run_segment(transcode_worker_t *w, transcode_segment_t *seg)
+{
+    transcode_job_t *job;
+    int out_len;
+    int duration;
+
+    job = seg->job;
+    if (seg->whole)
+        return convert(w, job, seg->in_start, seg->in_end, job->out, job->out_max, &job->out_len, &job->duration);
+    /*endif*/
+    return convert(w,
+                   job,
+                   seg->in_start,
+                   seg->in_end,
+                   &job->out[seg->out_start],
+                   job->out_max - seg->out_start,
+                   &out_len,
+                   &duration);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void segment_done(transcode_segment_t *seg, int status)
+{
+    transcode_job_t *job;
+
+    job = seg->job;
+    if (status != TRANSCODE_OK  &&  job->status == TRANSCODE_PENDING)
+        job->status = status;
+    /*endif*/
+    if (--job->segments_pending == 0  &&  job->status == TRANSCODE_PENDING)
+        job->status = TRANSCODE_OK;
+    /*endif*/
+}
+/*- End of function --------------------------------------------------------*/
+
+#if defined(TRANSCODE_USE_THREADS)
+static void *worker_thread(void *user_data)
+{
+    transcode_worker_t *w;
+    transcode_pool_t *s;
+    transcode_segment_t *seg;
+    int status;
+
+    w = (transcode_worker_t *) user_data;
+    s = w->pool;
+    pthread_mutex_lock(&s->mutex);
+    for (;;)
+    {
+        while (!s->stopping  &&  s->next_segment >= s->nsegments)
+            pthread_cond_wait(&s->work_available, &s->mutex);
+        /*endwhile*/
+        if (s->stopping)
+            break;
+        /*endif*/
+        seg = &s->segments[s->next_segment++];
+        pthread_mutex_unlock(&s->mutex);
+        status = run_segment(w, seg);
+        pthread_mutex_lock(&s->mutex);
+        segment_done(seg, status);
+        if (--s->segments_pending == 0)
+            pthread_cond_signal(&s->work_done);
+        /*endif*/
+    }
+    /*endfor*/
+    pthread_mutex_unlock(&s->mutex);
+    return NULL;
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+SPAN_DECLARE(int) transcode_pool_run(transcode_pool_t *s, transcode_job_t *jobs[], int njobs)
+{
+    int n;
+    int i;
+    int ok;
+
+    if ((n = make_segments(s, jobs, njobs)) < 0)
+    {
+        for (i = 0;  i < njobs;  i++)
+            jobs[i]->status = TRANSCODE_ERROR_RESOURCES;
+        /*endfor*/
+        return 0;
+    }
+    /*endif*/
+#if defined(TRANSCODE_USE_THREADS)
+    if (s->threads > 0)
+    {
+        pthread_mutex_lock(&s->mutex);
+        s->nsegments = n;
+        s->next_segment = 0;
+        s->segments_pending = n;
+        pthread_cond_broadcast(&s->work_available);
+        while (s->segments_pending > 0)
+            pthread_cond_wait(&s->work_done, &s->mutex);
+        /*endwhile*/
+        s->nsegments = 0;
+        s->next_segment = 0;
+        pthread_mutex_unlock(&s->mutex);
+    }
+    else
+#endif
+    {
+        for (i = 0;  i < n;  i++)
+            segment_done(&s->segments[i], run_segment(s->worker[0], &s->segments[i]));
+        /*endfor*/
+    }
+    /*endif*/
+    ok = 0;
+    for (i = 0;  i < njobs;  i++)
+    {
+        if (jobs[i]->status == TRANSCODE_OK)
+            ok++;
+        /*endif*/
+    }
+    /*endfor*/
+    return ok;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(transcode_pool_t *) transcode_pool_init(int threads)
+{
+    transcode_pool_t *s;
+    int workers;
+    int i;
+
+#if !defined(TRANSCODE_USE_THREADS)
+    threads = 0;
+#endif
+    if (threads < 0)
+        return NULL;
+    /*endif*/
+    if ((s = (transcode_pool_t *) span_alloc(sizeof(*s))) == NULL)
+        return NULL;
+    /*endif*/
+    memset(s, 0, sizeof(*s));
+#if defined(TRANSCODE_USE_THREADS)
+    pthread_mutex_init(&s->mutex, NULL);
+    pthread_cond_init(&s->work_available, NULL);
+    pthread_cond_init(&s->work_done, NULL);
+#endif
+    workers = (threads > 0)  ?  threads  :  1;
+    if ((s->worker = (transcode_worker_t **) span_alloc(workers*sizeof(transcode_worker_t *))) == NULL)
+    {
+        transcode_pool_free(s);
+        return NULL;
+    }
+    /*endif*/
+    for (i = 0;  i < workers;  i++)
+    {
+        if ((s->worker[i] = worker_alloc()) == NULL)
+        {
+            transcode_pool_free(s);
+            return NULL;
+        }
+        /*endif*/
+        s->worker[i]->pool = s;
+        s->workers++;
+    }
+    /*endfor*/
+#if defined(TRANSCODE_USE_THREADS)
+    if (threads > 0)
+    {
+        if ((s->thread = (pthread_t *) span_alloc(threads*sizeof(pthread_t))) == NULL)
+        {
+            transcode_pool_free(s);
+            return NULL;
+        }
+        /*endif*/
+        for (i = 0;  i < threads;  i++)
+        {
+            if (pthread_create(&s->thread[i], NULL, worker_thread, s->worker[i]))
+                break;
+            /*endif*/
+            s->threads++;
+        }
+        /*endfor*/
+        if (s->threads < threads)
+        {
+            transcode_pool_free(s);
+            return NULL;
+        }
+        /*endif*/
+    }
+    /*endif*/
+#endif
+    return s;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) transcode_pool_free(transcode_pool_t *s)
+{
+    int i;
+
+#if defined(TRANSCODE_USE_THREADS)
+    pthread_mutex_lock(&s->mutex);
+    s->stopping = TRUE;
+    pthread_cond_broadcast(&s->work_available);
+    pthread_mutex_unlock(&s->mutex);
+    for (i = 0;  i < s->threads;  i++)
+        pthread_join(s->thread[i], NULL);
+    /*endfor*/
+    if (s->thread)
+        span_free(s->thread);
+    /*endif*/
+    pthread_cond_destroy(&s->work_done);
+    pthread_cond_destroy(&s->work_available);
+    pthread_mutex_destroy(&s->mutex);
+#endif
+    for (i = 0;  i < s->workers;  i++)
+        span_free(s->worker[i]);
+    /*endfor*/
+    if (s->worker)
+        span_free(s->worker);
+    /*endif*/
+    if (s->segments)
+        span_free(s->segments);
+    /*endif*/
+    span_free(s);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
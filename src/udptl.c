@@ -0,0 +1,704 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * udptl.c - An implementation of the UDPTL protocol defined in T.38,
+ *           less the packet exchange part
+ *
+ * Written by Steve Underwood <steveu@coppice.org>
+ *
+ * Copyright (C) 2009 Steve Underwood
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <memory.h>
+
+#include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
+#include "spandsp/logging.h"
+#include "spandsp/t38_core.h"
+#include "spandsp/udptl.h"
+
+#include "spandsp/private/logging.h"
+#include "spandsp/private/udptl.h"
+
+#define UDPTL_BUF_MASK  (UDPTL_BUF_LEN - 1)
+
+static __inline__ int seq_no_offset(int seq_no, int ref)
+{
+    /* The signed distance from ref to seq_no, allowing for the sequence numbers rolling
+       over from 0xFFFF to 0x0000. */
+    return ((seq_no - ref + 0x8000) & 0xFFFF) - 0x8000;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int decode_length(const uint8_t buf[], int limit, int *len, int *pvalue)
+{
+    /* The packets we handle are far too short to need the fragmented form of length,
+       so that is treated as a fault. */
+    if (*len >= limit)
+        return -1;
+    if ((buf[*len] & 0x80) == 0)
+    {
+        *pvalue = buf[(*len)++];
+        return 0;
+    }
+    if ((buf[*len] & 0x40)  ||  *len >= limit - 1)
+        return -1;
+    *pvalue = ((buf[*len] & 0x3F) << 8) | buf[*len + 1];
+    *len += 2;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int decode_open_type(const uint8_t buf[], int limit, int *len, const uint8_t **p_object, int *p_num_octets)
+{
+    int octet_cnt;
+
+    if (decode_length(buf, limit, len, &octet_cnt))
+        return -1;
+    /* Make sure the buffer contains at least the number of octets stated */
+    if (*len + octet_cnt > limit)
+        return -1;
+    *p_object = &buf[*len];
+    *p_num_octets = octet_cnt;
+    *len += octet_cnt;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ int open_type_len(int num_octets)
+{
+    /* The encoded length of an open type, which is never long enough to need fragmenting */
+    if (num_octets == 0)
+        return 2;
+    return ((num_octets < 0x80)  ?  1  :  2) + num_octets;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int encode_open_type(uint8_t buf[], int len, const uint8_t data[], int num_octets)
+{
+    /* If open type is of zero length, add a single zero byte (10.1) */
+    if (num_octets == 0)
+    {
+        buf[len++] = 1;
+        buf[len++] = 0;
+        return len;
+    }
+    if (num_octets < 0x80)
+    {
+        /* 1 octet */
+        buf[len++] = (uint8_t) num_octets;
+    }
+    else
+    {
+        /* 2 octets */
+        /* Set the first bit of the first octet */
+        buf[len++] = (uint8_t) (((0x8000 | num_octets) >> 8) & 0xFF);
+        buf[len++] = (uint8_t) (num_octets & 0xFF);
+    }
+    memcpy(&buf[len], data, num_octets);
+    return len + num_octets;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void xor_octets(uint8_t dst[], const uint8_t src[], int len)
+{
+    uint64_t a;
+    uint64_t b;
+    int i;
+
+    /* Work a word at a time, as far as possible. memcpy() keeps this safe for any
+       alignment, and compiles to plain loads and stores. */
+    for (i = 0;  i <= len - 8;  i += 8)
+    {
+        memcpy(&a, &dst[i], 8);
+        memcpy(&b, &src[i], 8);
+        a ^= b;
+        memcpy(&dst[i], &a, 8);
+    }
+    for (  ;  i < len;  i++)
+        dst[i] ^= src[i];
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ void clear_rx_slot(udptl_fec_rx_buffer_t *slot)
+{
+    slot->buf_len = -1;
+    slot->fec_len[0] = 0;
+    slot->fec_span = 0;
+    slot->fec_entries = 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void deliver(udptl_state_t *s, const uint8_t msg[], int len, int seq_no)
+{
+    if (s->rx_packet_handler(s->user_data, msg, len, seq_no & 0xFFFF) < 0)
+        span_log(&s->logging, SPAN_LOG_PROTOCOL_WARNING, "Rx %5d: Bad IFP\n", seq_no & 0xFFFF);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void fec_repair(udptl_state_t *s, int x, int span, int entries, int repaired[])
+{
+    udptl_fec_rx_buffer_t *rx;
+    int which;
+    int limit;
+    int first;
+    int len;
+    int k;
+    int l;
+    int m;
+
+    /* See if we can reconstruct anything which is missing, using the FEC entries of
+       this and the recent packets whose groups lie within the history ring. */
+    /* TODO: this does not comprehensively hunt back and repair everything that is possible */
+    for (l = x;  l != ((x - (UDPTL_BUF_LEN - span*entries)) & UDPTL_BUF_MASK);  l = (l - 1) & UDPTL_BUF_MASK)
+    {
+        rx = &s->rx[l];
+        if (rx->fec_len[0] <= 0)
+            continue;
+        for (m = 0;  m < rx->fec_entries;  m++)
+        {
+            /* The group for this entry is every fec_entries'th packet, for fec_span packets,
+               up to the one before limit. It can be repaired if exactly one is missing. */
+            limit = (l + m) & UDPTL_BUF_MASK;
+            first = (limit - rx->fec_span*rx->fec_entries) & UDPTL_BUF_MASK;
+            which = -1;
+            for (k = first;  k != limit;  k = (k + rx->fec_entries) & UDPTL_BUF_MASK)
+            {
+                if (s->rx[k].buf_len <= 0)
+                {
+                    if (which != -1)
+                    {
+                        which = -2;
+                        break;
+                    }
+                    which = k;
+                }
+            }
+            if (which < 0)
+                continue;
+            /* Repairable */
+            memcpy(s->rx[which].buf, rx->fec[m], rx->fec_len[m]);
+            for (k = first;  k != limit;  k = (k + rx->fec_entries) & UDPTL_BUF_MASK)
+            {
+                if (k == which)
+                    continue;
+                len = (s->rx[k].buf_len < rx->fec_len[m])  ?  s->rx[k].buf_len  :  rx->fec_len[m];
+                xor_octets(s->rx[which].buf, s->rx[k].buf, len);
+            }
+            s->rx[which].buf_len = rx->fec_len[m];
+            repaired[which] = TRUE;
+        }
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) udptl_rx_packet(udptl_state_t *s, const uint8_t buf[], int len)
+{
+    int i;
+    int x;
+    int ptr;
+    int count;
+    int total_count;
+    int seq_no;
+    int ahead;
+    int span;
+    int entries;
+    int fec_usable;
+    int msg_len;
+    const uint8_t *msg;
+    const uint8_t *bufs[UDPTL_BUF_LEN];
+    int lengths[UDPTL_BUF_LEN];
+    const uint8_t *data;
+    int data_len;
+    int repaired[UDPTL_BUF_LEN];
+    int seq;
+
+    /* Decode seq_number */
+    if (len < 2)
+    {
+        span_log(&s->logging, SPAN_LOG_PROTOCOL_WARNING, "Rx: Bad packet length - %d\n", len);
+        return -1;
+    }
+    seq_no = (buf[0] << 8) | buf[1];
+    ptr = 2;
+    /* Break out the primary packet */
+    if (decode_open_type(buf, len, &ptr, &msg, &msg_len) != 0)
+    {
+        span_log(&s->logging, SPAN_LOG_PROTOCOL_WARNING, "Rx %5d: Bad primary packet\n", seq_no);
+        return -1;
+    }
+    /* Our buffers cannot tolerate overlength packets */
+    if (msg_len > UDPTL_MAX_DATAGRAM)
+    {
+        span_log(&s->logging, SPAN_LOG_PROTOCOL_WARNING, "Rx %5d: Primary packet too long - %d\n", seq_no, msg_len);
+        return -1;
+    }
+
+    /* Check the error recovery information is sound, before anything is changed */
+    if (ptr + 1 > len)
+        return -1;
+    span = 0;
+    entries = 0;
+    fec_usable = FALSE;
+    total_count = 0;
+    if ((buf[ptr++] & 0x80) == 0)
+    {
+        /* Secondary packet mode for error recovery */
+        /* We might have the packet we want, but we need to check through
+           the redundant stuff, and verify the integrity of the UDPTL.
+           This greatly reduces our chances of accepting garbage. The number
+           of entries will only ever be small, so the fragmented form of the
+           count is not allowed for. */
+        if (decode_length(buf, len, &ptr, &count))
+            return -1;
+        for (i = 0;  i < count;  i++)
+        {
+            if (decode_open_type(buf, len, &ptr, &data, &data_len) != 0)
+            {
+                span_log(&s->logging, SPAN_LOG_PROTOCOL_WARNING, "Rx %5d: Bad secondary packet\n", seq_no);
+                return -1;
+            }
+            /* Only the most recent packets can be of any use */
+            if (i < UDPTL_BUF_LEN  &&  data_len <= UDPTL_MAX_DATAGRAM)
+            {
+                bufs[i] = data;
+                lengths[i] = data_len;
+                total_count = i + 1;
+            }
+        }
+    }
+    else
+    {
+        /* FEC mode for error recovery */
+        /* The span is defined as an unconstrained integer, but will never be more
+           than a small value. The number of entries is defined as a length, but will
+           only ever be a small value. Treat them as such. */
+        if (ptr + 3 > len  ||  buf[ptr] != 1)
+            return -1;
+        span = buf[ptr + 1];
+        entries = buf[ptr + 2];
+        ptr += 3;
+        if (entries > UDPTL_MAX_FEC_ENTRIES)
+        {
+            span_log(&s->logging, SPAN_LOG_PROTOCOL_WARNING, "Rx %5d: Too many FEC entries - %d\n", seq_no, entries);
+            return -1;
+        }
+        for (i = 0;  i < entries;  i++)
+        {
+            if (decode_open_type(buf, len, &ptr, &bufs[i], &lengths[i]) != 0  ||  lengths[i] > UDPTL_MAX_DATAGRAM)
+            {
+                span_log(&s->logging, SPAN_LOG_PROTOCOL_WARNING, "Rx %5d: Bad FEC entry\n", seq_no);
+                return -1;
+            }
+        }
+        /* Groups reaching back further than our history are no use to us */
+        fec_usable = (entries > 0  &&  span*entries < UDPTL_BUF_LEN);
+    }
+    /* We should now be exactly at the end of the packet. If not, this is a fault. */
+    if (ptr != len)
+    {
+        span_log(&s->logging, SPAN_LOG_PROTOCOL_WARNING, "Rx %5d: Bad packet length - %d %d\n", seq_no, ptr, len);
+        return -1;
+    }
+
+    if (s->rx_seq_no < 0)
+        s->rx_seq_no = seq_no;
+    /* How far this packet is beyond the one we expected. This is negative for a late or
+       repeated packet. */
+    ahead = seq_no_offset(seq_no, s->rx_seq_no);
+    if (ahead <= -UDPTL_BUF_LEN)
+    {
+        /* This is too old to be of any use, even to help with FEC */
+        span_log(&s->logging, SPAN_LOG_FLOW, "Rx %5d: Very late packet\n", seq_no);
+        return 0;
+    }
+    /* Mark the slots of any packets we have skipped over as missing. Only the most recent
+       ones have slots. */
+    for (i = (ahead > UDPTL_BUF_LEN)  ?  (ahead - UDPTL_BUF_LEN)  :  0;  i < ahead;  i++)
+        clear_rx_slot(&s->rx[(s->rx_seq_no + i) & UDPTL_BUF_MASK]);
+    /* Save the new packet. Pure redundancy mode won't use this, but some systems will switch
+       into FEC mode after sending some redundant packets. */
+    x = seq_no & UDPTL_BUF_MASK;
+    memcpy(s->rx[x].buf, msg, msg_len);
+    s->rx[x].buf_len = msg_len;
+    s->rx[x].fec_len[0] = 0;
+    s->rx[x].fec_span = 0;
+    s->rx[x].fec_entries = 0;
+
+    if (fec_usable)
+    {
+        s->rx[x].fec_span = span;
+        s->rx[x].fec_entries = entries;
+        for (i = 0;  i < entries;  i++)
+        {
+            memcpy(s->rx[x].fec[i], bufs[i], lengths[i]);
+            s->rx[x].fec_len[i] = lengths[i];
+        }
+        /* A late packet's view of the history ring is out of date, so it is only stored. */
+        if (ahead >= 0)
+        {
+            memset(repaired, 0, sizeof(repaired));
+            repaired[x] = TRUE;
+            fec_repair(s, x, span, entries, repaired);
+            /* Now play any new packets forwards in time */
+            for (i = 1;  i < UDPTL_BUF_LEN;  i++)
+            {
+                seq = seq_no - UDPTL_BUF_LEN + i;
+                if (repaired[seq & UDPTL_BUF_MASK])
+                {
+                    span_log(&s->logging, SPAN_LOG_FLOW, "Rx %5d: FEC repaired, len %d\n", seq & 0xFFFF, s->rx[seq & UDPTL_BUF_MASK].buf_len);
+                    deliver(s, s->rx[seq & UDPTL_BUF_MASK].buf, s->rx[seq & UDPTL_BUF_MASK].buf_len, seq);
+                }
+            }
+        }
+    }
+    else if (ahead > 0)
+    {
+        /* We received a later packet than we expected, so we need to check if we can fill
+           in the gap from the secondary packets. Step through in reverse order, so we go
+           oldest to newest. */
+        for (i = (total_count < ahead)  ?  total_count  :  ahead;  i > 0;  i--)
+        {
+            seq = seq_no - i;
+            span_log(&s->logging, SPAN_LOG_FLOW, "Rx %5d: Secondary, len %d\n", seq & 0xFFFF, lengths[i - 1]);
+            /* Save the new packet. Redundancy mode won't use this, but some systems will switch into
+               FEC mode after sending some redundant packets, and this may then be important. */
+            x = seq & UDPTL_BUF_MASK;
+            memcpy(s->rx[x].buf, bufs[i - 1], lengths[i - 1]);
+            s->rx[x].buf_len = lengths[i - 1];
+            deliver(s, bufs[i - 1], lengths[i - 1], seq);
+        }
+    }
+    /* If packets are received out of sequence, we may have already processed this packet from the error
+       recovery information in a packet already received. */
+    if (ahead >= 0)
+    {
+        /* Decode the primary packet */
+        deliver(s, msg, msg_len, seq_no);
+        s->rx_seq_no = (seq_no + 1) & 0xFFFF;
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) udptl_build_packet(udptl_state_t *s, uint8_t buf[], const uint8_t msg[], int msg_len)
+{
+    uint8_t fec[UDPTL_MAX_DATAGRAM];
+    int i;
+    int j;
+    int seq;
+    int entry;
+    int entries;
+    int span;
+    int m;
+    int len;
+    int limit;
+    int high_tide;
+    int total;
+    int slot_len;
+
+    /* UDPTL cannot cope with zero length messages, and our buffering for redundancy limits their
+       maximum length. */
+    if (msg_len < 1  ||  msg_len > UDPTL_MAX_DATAGRAM)
+        return -1;
+    seq = s->tx_seq_no & 0xFFFF;
+
+    /* Map the sequence number to an entry in the circular buffer */
+    entry = seq & UDPTL_BUF_MASK;
+
+    /* We save the message in a circular buffer, for generating FEC or
+       redundancy sets later on. */
+    s->tx[entry].buf_len = msg_len;
+    memcpy(s->tx[entry].buf, msg, msg_len);
+
+    /* Build the UDPTL packet */
+    len = 0;
+    /* Encode the sequence number */
+    buf[len++] = (uint8_t) ((seq >> 8) & 0xFF);
+    buf[len++] = (uint8_t) (seq & 0xFF);
+
+    /* Encode the primary packet */
+    len = encode_open_type(buf, len, msg, msg_len);
+
+    /* Encode the appropriate type of error recovery information */
+    switch (s->error_correction_scheme)
+    {
+    case UDPTL_ERROR_CORRECTION_NONE:
+        /* Encode the error recovery type */
+        buf[len++] = 0x00;
+        /* The number of entries will always be zero, so it is pointless allowing
+           for the fragmented case here. */
+        buf[len++] = 0x00;
+        break;
+    case UDPTL_ERROR_CORRECTION_REDUNDANCY:
+        /* Encode the error recovery type */
+        buf[len++] = 0x00;
+        entries = s->error_correction_entries;
+        if (entries > s->tx_history)
+            entries = s->tx_history;
+        if (entries > UDPTL_MAX_REDUNDANCY_DEPTH)
+            entries = UDPTL_MAX_REDUNDANCY_DEPTH;
+        /* Send as many of the requested redundant packets as the far end will accept */
+        total = len + 1;
+        for (i = 0;  i < entries;  i++)
+        {
+            slot_len = open_type_len(s->tx[(entry - i - 1) & UDPTL_BUF_MASK].buf_len);
+            if (total + slot_len > s->far_max_datagram_size)
+                break;
+            total += slot_len;
+        }
+        entries = i;
+        /* The number of entries will always be small, so it is pointless allowing
+           for the fragmented case here. */
+        buf[len++] = (uint8_t) entries;
+        /* Encode the elements */
+        for (i = 0;  i < entries;  i++)
+        {
+            j = (entry - i - 1) & UDPTL_BUF_MASK;
+            len = encode_open_type(buf, len, s->tx[j].buf, s->tx[j].buf_len);
+        }
+        break;
+    case UDPTL_ERROR_CORRECTION_FEC:
+        entries = s->error_correction_entries;
+        if (entries > UDPTL_MAX_FEC_ENTRIES)
+            entries = UDPTL_MAX_FEC_ENTRIES;
+        span = s->error_correction_span;
+        /* The groups must lie within our history */
+        if (entries > 0  &&  span*entries >= UDPTL_BUF_LEN)
+            span = (UDPTL_BUF_LEN - 1)/entries;
+        if (span <= 0)
+            entries = 0;
+        if (s->tx_history < span*entries)
+        {
+            /* In the initial stages, wind up the FEC smoothly */
+            entries = s->tx_history/span;
+            if (s->tx_history < span)
+                span = 0;
+        }
+        /* Encode the error recovery type */
+        buf[len++] = 0x80;
+        /* Span is defined as an inconstrained integer, which it dumb. It will only
+           ever be a small value. Treat it as such. */
+        buf[len++] = 1;
+        buf[len++] = (uint8_t) span;
+        /* The number of entries is defined as a length, but will only ever be a small
+           value. Treat it as such. */
+        buf[len++] = (uint8_t) entries;
+        for (m = 0;  m < entries;  m++)
+        {
+            /* Make an XOR'ed entry the maximum length */
+            limit = (entry + m) & UDPTL_BUF_MASK;
+            high_tide = 0;
+            for (i = (limit - span*entries) & UDPTL_BUF_MASK;  i != limit;  i = (i + entries) & UDPTL_BUF_MASK)
+            {
+                if (high_tide < s->tx[i].buf_len)
+                {
+                    memset(fec + high_tide, 0, s->tx[i].buf_len - high_tide);
+                    high_tide = s->tx[i].buf_len;
+                }
+            }
+            for (i = (limit - span*entries) & UDPTL_BUF_MASK;  i != limit;  i = (i + entries) & UDPTL_BUF_MASK)
+            {
+                if (s->tx[i].buf_len > 0)
+                    xor_octets(fec, s->tx[i].buf, s->tx[i].buf_len);
+            }
+            len = encode_open_type(buf, len, fec, high_tide);
+        }
+        break;
+    }
+
+    s->tx_seq_no = (s->tx_seq_no + 1) & 0xFFFF;
+    if (s->tx_history < UDPTL_BUF_LEN)
+        s->tx_history++;
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) udptl_t38_tx_packet_handler(t38_core_state_t *t, void *user_data, const uint8_t buf[], int len, int count)
+{
+    udptl_state_t *s;
+    uint8_t pkt[UDPTL_MAX_PACKET_LEN];
+    int pkt_len;
+    int depth;
+    int entries;
+    int i;
+
+    s = (udptl_state_t *) user_data;
+    if (s->tx_packet_handler == NULL)
+        return -1;
+    /* The low byte of the count is the number of times to send the packet. The second byte,
+       if set, is the redundancy depth for the packet's category. */
+    depth = (count >> 8) & 0xFF;
+    entries = s->error_correction_entries;
+    if (depth  &&  s->error_correction_scheme == UDPTL_ERROR_CORRECTION_REDUNDANCY)
+        s->error_correction_entries = depth;
+    pkt_len = udptl_build_packet(s, pkt, buf, len);
+    s->error_correction_entries = entries;
+    if (pkt_len < 0)
+        return -1;
+    for (i = 0;  i < (count & 0xFF);  i++)
+        s->tx_packet_handler(s->tx_user_data, pkt, pkt_len);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) udptl_t38_rx_packet_handler(void *user_data, const uint8_t msg[], int len, int seq_no)
+{
+    return t38_core_rx_ifp_packet((t38_core_state_t *) user_data, msg, len, (uint16_t) seq_no);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) udptl_set_error_correction(udptl_state_t *s, int ec_scheme, int span, int entries)
+{
+    switch (ec_scheme)
+    {
+    case UDPTL_ERROR_CORRECTION_FEC:
+    case UDPTL_ERROR_CORRECTION_REDUNDANCY:
+    case UDPTL_ERROR_CORRECTION_NONE:
+        s->error_correction_scheme = ec_scheme;
+        break;
+    case -1:
+        /* Just don't change the scheme */
+        break;
+    default:
+        return -1;
+    }
+    if (span >= 0)
+        s->error_correction_span = span;
+    if (entries >= 0)
+        s->error_correction_entries = entries;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) udptl_get_error_correction(udptl_state_t *s, int *ec_scheme, int *span, int *entries)
+{
+    if (ec_scheme)
+        *ec_scheme = s->error_correction_scheme;
+    if (span)
+        *span = s->error_correction_span;
+    if (entries)
+        *entries = s->error_correction_entries;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) udptl_set_local_max_datagram(udptl_state_t *s, int max_datagram)
+{
+    s->local_max_datagram_size = max_datagram;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) udptl_get_local_max_datagram(udptl_state_t *s)
+{
+    return s->local_max_datagram_size;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) udptl_set_far_max_datagram(udptl_state_t *s, int max_datagram)
+{
+    s->far_max_datagram_size = max_datagram;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) udptl_get_far_max_datagram(udptl_state_t *s)
+{
+    return s->far_max_datagram_size;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void) udptl_set_tx_packet_handler(udptl_state_t *s, udptl_tx_packet_handler_t *tx_packet_handler, void *user_data)
+{
+    s->tx_packet_handler = tx_packet_handler;
+    s->tx_user_data = user_data;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(logging_state_t *) udptl_get_logging_state(udptl_state_t *s)
+{
+    return &s->logging;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(udptl_state_t *) udptl_init(udptl_state_t *s,
+                                         int ec_scheme,
+                                         int span,
+                                         int entries,
+                                         udptl_rx_packet_handler_t *rx_packet_handler,
+                                         void *user_data)
+{
+    int i;
+
+    if (rx_packet_handler == NULL)
+        return NULL;
+
+    if (s == NULL)
+    {
+        if ((s = (udptl_state_t *) span_alloc(sizeof(*s))) == NULL)
+            return NULL;
+    }
+    memset(s, 0, sizeof(*s));
+    span_log_init(&s->logging, SPAN_LOG_NONE, NULL);
+    span_log_set_protocol(&s->logging, "UDPTL");
+
+    s->error_correction_scheme = ec_scheme;
+    s->error_correction_span = span;
+    s->error_correction_entries = entries;
+
+    s->far_max_datagram_size = UDPTL_MAX_PACKET_LEN;
+    s->local_max_datagram_size = UDPTL_MAX_PACKET_LEN;
+
+    for (i = 0;  i < UDPTL_BUF_LEN;  i++)
+    {
+        clear_rx_slot(&s->rx[i]);
+        s->tx[i].buf_len = -1;
+    }
+    s->rx_seq_no = -1;
+
+    s->rx_packet_handler = rx_packet_handler;
+    s->user_data = user_data;
+    return s;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) udptl_release(udptl_state_t *s)
+{
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) udptl_free(udptl_state_t *s)
+{
+    if (s)
+        span_free(s);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
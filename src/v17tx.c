@@ -42,6 +42,7 @@
 #include "floating_fudge.h"
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/fast_convert.h"
 #include "spandsp/logging.h"
 #include "spandsp/complex.h"
@@ -96,6 +97,9 @@
 /*! The 16 bit pattern used in the bridge section of the training sequence */
 #define V17_BRIDGE_WORD             0x8880
 
+/*! The number of samples of carrier generated in one pass */
+#define V17_TX_CARRIER_BLOCK_LEN  32
+
 static __inline__ int scramble(v17_tx_state_t *s, int in_bit)
 {
     int out_bit;
@@ -221,6 +225,22 @@ static int fake_get_bit(void *user_data)
 }
 /*- End of function --------------------------------------------------------*/
 
+static __inline__ int get_data_bit(v17_tx_state_t *s)
+{
+    int n;
+
+    if (s->get_bits == NULL  ||  s->current_get_bit != s->get_bit)
+        return s->current_get_bit(s->get_bit_user_data);
+    if (s->bit_chunk_len <= 0)
+    {
+        if ((n = s->get_bits(s->get_bit_user_data, &s->bit_chunk)) <= 0)
+            return (n < 0)  ?  n  :  SIG_STATUS_END_OF_DATA;
+        s->bit_chunk_len = n;
+    }
+    return (s->bit_chunk >> --s->bit_chunk_len) & 1;
+}
+/*- End of function --------------------------------------------------------*/
+
 #if defined(SPANDSP_USE_FIXED_POINT)
 static __inline__ complexi16_t getbaud(v17_tx_state_t *s)
 #else
@@ -268,7 +288,7 @@ static __inline__ complexf_t getbaud(v17_tx_state_t *s)
     bits = 0;
     for (i = 0;  i < s->bits_per_symbol;  i++)
     {
-        if ((bit = s->current_get_bit(s->get_bit_user_data)) == SIG_STATUS_END_OF_DATA)
+        if ((bit = get_data_bit(s)) == SIG_STATUS_END_OF_DATA)
         {
             /* End of real data. Switch to the fake get_bit routine, until we
                have shut down completely. */
@@ -289,18 +309,26 @@ SPAN_DECLARE_NONSTD(int) v17_tx(v17_tx_state_t *s, int16_t amp[], int len)
 #if defined(SPANDSP_USE_FIXED_POINT)
     complexi_t x;
     complexi_t z;
+    complexi_t carrier[V17_TX_CARRIER_BLOCK_LEN];
 #else
     complexf_t x;
     complexf_t z;
+    complexf_t carrier[V17_TX_CARRIER_BLOCK_LEN];
 #endif
     int i;
     int sample;
+    int carrier_start;
+    int carrier_end;
+    uint32_t carrier_phase_end;
 
     if (s->training_step >= V17_TRAINING_SHUTDOWN_END)
     {
         /* Once we have sent the shutdown sequence, we stop sending completely. */
         return 0;
     }
+    carrier_start = 0;
+    carrier_end = 0;
+    carrier_phase_end = s->carrier_phase;
     for (sample = 0;  sample < len;  sample++)
     {
         if ((s->baud_phase += 3) >= 10)
@@ -311,6 +339,20 @@ SPAN_DECLARE_NONSTD(int) v17_tx(v17_tx_state_t *s, int16_t amp[], int len)
             if (++s->rrc_filter_step >= V17_TX_FILTER_STEPS)
                 s->rrc_filter_step = 0;
         }
+        if (sample >= carrier_end  ||  s->carrier_phase != carrier_phase_end)
+        {
+            /* Generate the carrier a block at a time. Anything which resets the carrier
+               phase, such as a restart of the modem from a callback, forces a new block. */
+            carrier_start = sample;
+            if ((carrier_end = sample + V17_TX_CARRIER_BLOCK_LEN) > len)
+                carrier_end = len;
+#if defined(SPANDSP_USE_FIXED_POINT)
+            dds_complexi_block(&s->carrier_phase, s->carrier_phase_rate, carrier, carrier_end - carrier_start);
+#else
+            dds_complexf_block(&s->carrier_phase, s->carrier_phase_rate, carrier, carrier_end - carrier_start);
+#endif
+            carrier_phase_end = s->carrier_phase;
+        }
         /* Root raised cosine pulse shaping at baseband */
 #if defined(SPANDSP_USE_FIXED_POINT)
         x = complex_seti(0, 0);
@@ -322,7 +364,7 @@ SPAN_DECLARE_NONSTD(int) v17_tx(v17_tx_state_t *s, int16_t amp[], int len)
         /* Now create and modulate the carrier */
         x.re >>= 4;
         x.im >>= 4;
-        z = dds_complexi(&(s->carrier_phase), s->carrier_phase_rate);
+        z = carrier[sample - carrier_start];
         /* Don't bother saturating. We should never clip. */
         i = (x.re*z.re - x.im*z.im) >> 15;
         amp[sample] = (int16_t) ((i*s->gain) >> 15);
@@ -334,7 +376,7 @@ SPAN_DECLARE_NONSTD(int) v17_tx(v17_tx_state_t *s, int16_t amp[], int len)
             x.im += tx_pulseshaper[TX_PULSESHAPER_COEFF_SETS - 1 - s->baud_phase][i]*s->rrc_filter[i + s->rrc_filter_step].im;
         }
         /* Now create and modulate the carrier */
-        z = dds_complexf(&(s->carrier_phase), s->carrier_phase_rate);
+        z = carrier[sample - carrier_start];
         /* Don't bother saturating. We should never clip. */
         amp[sample] = (int16_t) lfastrintf((x.re*z.re - x.im*z.im)*s->gain);
 #endif
@@ -357,6 +399,8 @@ SPAN_DECLARE(void) v17_tx_power(v17_tx_state_t *s, float power)
 
 SPAN_DECLARE(void) v17_tx_set_get_bit(v17_tx_state_t *s, get_bit_func_t get_bit, void *user_data)
 {
+    s->get_bits = NULL;
+    s->bit_chunk_len = 0;
     if (s->get_bit == s->current_get_bit)
         s->current_get_bit = get_bit;
     s->get_bit = get_bit;
@@ -364,6 +408,13 @@ SPAN_DECLARE(void) v17_tx_set_get_bit(v17_tx_state_t *s, get_bit_func_t get_bit,
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(void) v17_tx_set_get_bits(v17_tx_state_t *s, get_bits_func_t get_bits)
+{
+    s->get_bits = get_bits;
+    s->bit_chunk_len = 0;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) v17_tx_set_modem_status_handler(v17_tx_state_t *s, modem_tx_status_func_t handler, void *user_data)
 {
     s->status_handler = handler;
@@ -424,6 +475,7 @@ SPAN_DECLARE(int) v17_tx_restart(v17_tx_state_t *s, int bit_rate, int tep, int s
     s->baud_phase = 0;
     s->constellation_state = 0;
     s->current_get_bit = fake_get_bit;
+    s->bit_chunk_len = 0;
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -444,7 +496,7 @@ SPAN_DECLARE(v17_tx_state_t *) v17_tx_init(v17_tx_state_t *s, int bit_rate, int
     }
     if (s == NULL)
     {
-        if ((s = (v17_tx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (v17_tx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -468,7 +520,7 @@ SPAN_DECLARE(int) v17_tx_release(v17_tx_state_t *s)
 
 SPAN_DECLARE(int) v17_tx_free(v17_tx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -49,6 +49,7 @@
 #include <math.h>
 #endif
 #include "floating_fudge.h"
+#include "mmx_sse_decs.h"
 
 #include "spandsp/telephony.h"
 #include "spandsp/logging.h"
@@ -83,6 +84,8 @@
 #define EQUALIZER_DELTA         0.25f
 /*! The number of phase shifted coefficient set for the pulse shaping/bandpass filter */
 #define PULSESHAPER_COEFF_SETS  12
+/*! The number of samples for which the power measuring filter is run in one pass */
+#define V22BIS_RX_BLOCK_LEN     40
 
 /*
 The basic method used by the V.22bis receiver is:
@@ -158,8 +161,19 @@ SPAN_DECLARE(void) v22bis_rx_signal_cutoff(v22bis_state_t *s, float cutoff)
 }
 /*- End of function --------------------------------------------------------*/
 
+static __inline__ void flush_bit_chunk(v22bis_state_t *s)
+{
+    if (s->rx.bit_chunk_len)
+    {
+        s->put_bits(s->put_bit_user_data, s->rx.bit_chunk & ((1 << s->rx.bit_chunk_len) - 1), s->rx.bit_chunk_len);
+        s->rx.bit_chunk_len = 0;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
 void v22bis_report_status_change(v22bis_state_t *s, int status)
 {
+    flush_bit_chunk(s);
     if (s->status_handler)
         s->status_handler(s->status_user_data, status);
     else if (s->put_bit)
@@ -292,7 +306,16 @@ static __inline__ void put_bit(v22bis_state_t *s, int bit)
 
     /* Descramble the bit */
     out_bit = descramble(s, bit);
-    s->put_bit(s->put_bit_user_data, out_bit);
+    if (s->put_bits)
+    {
+        s->rx.bit_chunk = (s->rx.bit_chunk << 1) | out_bit;
+        if (++s->rx.bit_chunk_len >= 16)
+            flush_bit_chunk(s);
+    }
+    else
+    {
+        s->put_bit(s->put_bit_user_data, out_bit);
+    }
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -691,121 +714,209 @@ static void process_half_baud(v22bis_state_t *s, const complexf_t *sample)
 }
 /*- End of function --------------------------------------------------------*/
 
-SPAN_DECLARE_NONSTD(int) v22bis_rx(v22bis_state_t *s, const int16_t amp[], int len)
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+static void pulseshaper_block(float z[], const float x[], const float coeffs[], int len)
 {
     int i;
+    int j;
+    __m128 n0;
+    __m128 n1;
+    __m128 n2;
+    __m128 n3;
+
+    /* Each lane of the SSE registers works on a different output sample, so each
+       output is a plain sequential sum of products, just as in the non-SSE code. */
+    for (i = 0;  i + 8 <= len;  i += 8)
+    {
+        n0 = _mm_setzero_ps();
+        n1 = _mm_setzero_ps();
+        for (j = 0;  j < V22BIS_RX_FILTER_STEPS;  j++)
+        {
+            n2 = _mm_set1_ps(coeffs[j]);
+            n3 = _mm_mul_ps(_mm_loadu_ps(x + i + j), n2);
+            n0 = _mm_add_ps(n0, n3);
+            n3 = _mm_mul_ps(_mm_loadu_ps(x + i + j + 4), n2);
+            n1 = _mm_add_ps(n1, n3);
+        }
+        _mm_storeu_ps(z + i, n0);
+        _mm_storeu_ps(z + i + 4, n1);
+    }
+    for (  ;  i + 4 <= len;  i += 4)
+    {
+        n0 = _mm_setzero_ps();
+        for (j = 0;  j < V22BIS_RX_FILTER_STEPS;  j++)
+        {
+            n3 = _mm_mul_ps(_mm_loadu_ps(x + i + j), _mm_set1_ps(coeffs[j]));
+            n0 = _mm_add_ps(n0, n3);
+        }
+        _mm_storeu_ps(z + i, n0);
+    }
+    /* Now deal with the last 1 to 3 elements, which don't fill an SSE2 register */
+    for (  ;  i < len;  i++)
+    {
+        z[i] = 0.0f;
+        for (j = 0;  j < V22BIS_RX_FILTER_STEPS;  j++)
+            z[i] += x[i + j]*coeffs[j];
+    }
+}
+#else
+static void pulseshaper_block(float z[], const float x[], const float coeffs[], int len)
+{
+    int i;
+    int j;
+
+    for (i = 0;  i < len;  i++)
+    {
+        z[i] = 0.0f;
+        for (j = 0;  j < V22BIS_RX_FILTER_STEPS;  j++)
+            z[i] += x[i + j]*coeffs[j];
+    }
+}
+#endif
+/*- End of function --------------------------------------------------------*/
+
+static void process_sample(v22bis_state_t *s, const float window[], float ii)
+{
     int step;
     complexf_t z;
     complexf_t zz;
     int32_t power;
     complexf_t sample;
-    float ii;
     float qq;
 
-    for (i = 0;  i < len;  i++)
+    power = power_meter_update(&(s->rx.rx_power), (int16_t) ii);
+    if (s->rx.signal_present)
+    {
+        /* Look for power below the carrier off point */
+        if (power < s->rx.carrier_off_power)
+        {
+            v22bis_restart(s, s->bit_rate);
+            v22bis_report_status_change(s, SIG_STATUS_CARRIER_DOWN);
+            return;
+        }
+    }
+    else
+    {
+        /* Look for power exceeding the carrier on point */
+        if (power < s->rx.carrier_on_power)
+            return;
+        s->rx.signal_present = TRUE;
+        v22bis_report_status_change(s, SIG_STATUS_CARRIER_UP);
+    }
+    if (s->rx.training == V22BIS_RX_TRAINING_STAGE_PARKED)
     {
+        /* Only spend effort processing this data if the modem is not
+           parked, after a training failure. */
+        return;
+    }
+    if (s->rx.training == V22BIS_RX_TRAINING_STAGE_SYMBOL_ACQUISITION)
+    {
+        /* Only AGC during the initial symbol acquisition, and then lock the gain. */
+        s->rx.agc_scaling = 0.18f*3.60f/sqrtf(power);
+    }
+    /* Put things into the equalization buffer at T/2 rate. The Gardner algorithm
+       will fiddle the step to align this with the symbols. */
+    if ((s->rx.eq_put_step -= PULSESHAPER_COEFF_SETS) > 0)
+    {
+        /* The carrier is only needed at the T/2 points, so just step its phase. */
+        dds_advancef(&s->rx.carrier_phase, s->rx.carrier_phase_rate);
+        return;
+    }
+    z = dds_complexf(&s->rx.carrier_phase, s->rx.carrier_phase_rate);
+    /* Pulse shape while still at the carrier frequency, using a quadrature
+       pair of filters. This results in a properly bandpass filtered complex
+       signal, which can be brought directly to bandband by complex mixing.
+       No further filtering, to remove mixer harmonics, is needed. */
+    step = -s->rx.eq_put_step;
+    if (step > PULSESHAPER_COEFF_SETS - 1)
+        step = PULSESHAPER_COEFF_SETS - 1;
+    s->rx.eq_put_step += PULSESHAPER_COEFF_SETS*40/(3*2);
+    if (s->calling_party)
+    {
+        ii = vec_dot_prodf(window, rx_pulseshaper_2400_re[step], V22BIS_RX_FILTER_STEPS);
+        qq = vec_dot_prodf(window, rx_pulseshaper_2400_im[step], V22BIS_RX_FILTER_STEPS);
+    }
+    else
+    {
+        ii = vec_dot_prodf(window, rx_pulseshaper_1200_re[step], V22BIS_RX_FILTER_STEPS);
+        qq = vec_dot_prodf(window, rx_pulseshaper_1200_im[step], V22BIS_RX_FILTER_STEPS);
+    }
+    sample.re = ii*s->rx.agc_scaling;
+    sample.im = qq*s->rx.agc_scaling;
+    /* Shift to baseband - since this is done in a full complex form, the
+       result is clean, and requires no further filtering apart from the
+       equalizer. */
+    zz.re = sample.re*z.re - sample.im*z.im;
+    zz.im = -sample.re*z.im - sample.im*z.re;
+    process_half_baud(s, &zz);
+    return;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE_NONSTD(int) v22bis_rx(v22bis_state_t *s, const int16_t amp[], int len)
+{
+    int i;
+    int j;
+    int chunk;
+    const float *power_coeffs;
+    float buf[V22BIS_RX_FILTER_STEPS + V22BIS_RX_BLOCK_LEN];
+    float power_ii[V22BIS_RX_BLOCK_LEN];
+
+    /* Calculate the I filter, with an arbitrary phase step, just so we can calculate
+       the signal power of the required carrier, with any guard tone or spillback of our
+       own transmitted signal suppressed. */
+    power_coeffs = (s->calling_party)  ?  rx_pulseshaper_2400_re[6]  :  rx_pulseshaper_1200_re[6];
+    for (i = 0;  i < len;  i += chunk)
+    {
+        if ((chunk = len - i) > V22BIS_RX_BLOCK_LEN)
+            chunk = V22BIS_RX_BLOCK_LEN;
+        /* Put the block of samples after the pulse-shaping filter's history, so the
+           filter's window for every sample in the block is a contiguous stretch
+           of the buffer. */
+        vec_copyf(buf, s->rx.rrc_filter, V22BIS_RX_FILTER_STEPS);
+        for (j = 0;  j < chunk;  j++)
+            buf[V22BIS_RX_FILTER_STEPS + j] = amp[i + j];
+
+        /* The power filter is needed for every sample, so run it over the whole block in
+           one go. */
+        pulseshaper_block(power_ii, &buf[1], power_coeffs, chunk);
+
         /* Complex bandpass filter the signal, using a pair of FIRs, and RRC coeffs shifted
            to centre at 1200Hz or 2400Hz. The filters support 12 fractional phase shifts, to 
            permit signal extraction very close to the middle of a symbol. */
-        s->rx.rrc_filter[s->rx.rrc_filter_step] = amp[i];
-        if (++s->rx.rrc_filter_step >= V22BIS_RX_FILTER_STEPS)
-            s->rx.rrc_filter_step = 0;
-
-        /* Calculate the I filter, with an arbitrary phase step, just so we can calculate
-           the signal power of the required carrier, with any guard tone or spillback of our
-           own transmitted signal suppressed. */
-        if (s->calling_party)
-        {
-#if defined(SPANDSP_USE_FIXED_POINT)
-            ii = vec_circular_dot_prodi16(s->rx.rrc_filter, rx_pulseshaper_2400_re[6], V22BIS_RX_FILTER_STEPS, s->rx.rrc_filter_step);
-#else
-            ii = vec_circular_dot_prodf(s->rx.rrc_filter, rx_pulseshaper_2400_re[6], V22BIS_RX_FILTER_STEPS, s->rx.rrc_filter_step);
-#endif
-        }
-        else
-        {
-#if defined(SPANDSP_USE_FIXED_POINT)
-            ii = vec_circular_dot_prodi16(s->rx.rrc_filter, rx_pulseshaper_1200_re[6], V22BIS_RX_FILTER_STEPS, s->rx.rrc_filter_step);
-#else
-            ii = vec_circular_dot_prodf(s->rx.rrc_filter, rx_pulseshaper_1200_re[6], V22BIS_RX_FILTER_STEPS, s->rx.rrc_filter_step);
-#endif
-        }
-        power = power_meter_update(&(s->rx.rx_power), (int16_t) ii);
-        if (s->rx.signal_present)
+        /* Anything which restarts the receiver, including the application acting on a
+           callback, clears the filter history. Mark the history while the block is being
+           worked through, so a restart can be spotted. */
+        s->rx.rrc_filter_step = -1;
+        for (j = 0;  j < chunk;  j++)
         {
-            /* Look for power below the carrier off point */
-            if (power < s->rx.carrier_off_power)
+            process_sample(s, &buf[j + 1], power_ii[j]);
+            if (s->rx.rrc_filter_step >= 0)
             {
-                v22bis_restart(s, s->bit_rate);
-                v22bis_report_status_change(s, SIG_STATUS_CARRIER_DOWN);
-                continue;
+                /* The receiver has been restarted. Continue from the next sample
+                   with the cleared history. */
+                chunk = j + 1;
+                break;
             }
         }
-        else
-        {
-            /* Look for power exceeding the carrier on point */
-            if (power < s->rx.carrier_on_power)
-                continue;
-            s->rx.signal_present = TRUE;
-            v22bis_report_status_change(s, SIG_STATUS_CARRIER_UP);
-        }
-        if (s->rx.training != V22BIS_RX_TRAINING_STAGE_PARKED)
+        if (s->rx.rrc_filter_step < 0)
         {
-            /* Only spend effort processing this data if the modem is not
-               parked, after a training failure. */
-            z = dds_complexf(&s->rx.carrier_phase, s->rx.carrier_phase_rate);
-            if (s->rx.training == V22BIS_RX_TRAINING_STAGE_SYMBOL_ACQUISITION)
-            {
-                /* Only AGC during the initial symbol acquisition, and then lock the gain. */
-                s->rx.agc_scaling = 0.18f*3.60f/sqrtf(power);
-            }
-            /* Put things into the equalization buffer at T/2 rate. The Gardner algorithm
-               will fiddle the step to align this with the symbols. */
-            if ((s->rx.eq_put_step -= PULSESHAPER_COEFF_SETS) <= 0)
-            {
-                /* Pulse shape while still at the carrier frequency, using a quadrature
-                   pair of filters. This results in a properly bandpass filtered complex
-                   signal, which can be brought directly to bandband by complex mixing.
-                   No further filtering, to remove mixer harmonics, is needed. */
-                step = -s->rx.eq_put_step;
-                if (step > PULSESHAPER_COEFF_SETS - 1)
-                    step = PULSESHAPER_COEFF_SETS - 1;
-                s->rx.eq_put_step += PULSESHAPER_COEFF_SETS*40/(3*2);
-                if (s->calling_party)
-                {
-#if defined(SPANDSP_USE_FIXED_POINT)
-                    ii = vec_circular_dot_prodi16(s->rx.rrc_filter, rx_pulseshaper_2400_re[step], V22BIS_RX_FILTER_STEPS, s->rx.rrc_filter_step);
-                    qq = vec_circular_dot_prodi16(s->rx.rrc_filter, rx_pulseshaper_2400_im[step], V22BIS_RX_FILTER_STEPS, s->rx.rrc_filter_step);
-#else
-                    ii = vec_circular_dot_prodf(s->rx.rrc_filter, rx_pulseshaper_2400_re[step], V22BIS_RX_FILTER_STEPS, s->rx.rrc_filter_step);
-                    qq = vec_circular_dot_prodf(s->rx.rrc_filter, rx_pulseshaper_2400_im[step], V22BIS_RX_FILTER_STEPS, s->rx.rrc_filter_step);
-#endif
-                }
-                else
-                {
-#if defined(SPANDSP_USE_FIXED_POINT)
-                    ii = vec_circular_dot_prodi16(s->rx.rrc_filter, rx_pulseshaper_1200_re[step], V22BIS_RX_FILTER_STEPS, s->rx.rrc_filter_step);
-                    qq = vec_circular_dot_prodi16(s->rx.rrc_filter, rx_pulseshaper_1200_im[step], V22BIS_RX_FILTER_STEPS, s->rx.rrc_filter_step);
-#else
-                    ii = vec_circular_dot_prodf(s->rx.rrc_filter, rx_pulseshaper_1200_re[step], V22BIS_RX_FILTER_STEPS, s->rx.rrc_filter_step);
-                    qq = vec_circular_dot_prodf(s->rx.rrc_filter, rx_pulseshaper_1200_im[step], V22BIS_RX_FILTER_STEPS, s->rx.rrc_filter_step);
-#endif
-                }
-                sample.re = ii*s->rx.agc_scaling;
-                sample.im = qq*s->rx.agc_scaling;
-                /* Shift to baseband - since this is done in a full complex form, the
-                   result is clean, and requires no further filtering apart from the
-                   equalizer. */
-                zz.re = sample.re*z.re - sample.im*z.im;
-                zz.im = -sample.re*z.im - sample.im*z.re;
-                process_half_baud(s, &zz);
-            }
+            vec_copyf(s->rx.rrc_filter, &buf[chunk], V22BIS_RX_FILTER_STEPS);
+            s->rx.rrc_filter_step = 0;
         }
     }
+    flush_bit_chunk(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(void) v22bis_set_put_bits(v22bis_state_t *s, put_bits_func_t put_bits)
+{
+    flush_bit_chunk(s);
+    s->put_bits = put_bits;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE_NONSTD(int) v22bis_rx_fillin(v22bis_state_t *s, int len)
 {
     int i;
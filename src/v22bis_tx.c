@@ -45,6 +45,7 @@
 #include "floating_fudge.h"
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/fast_convert.h"
 #include "spandsp/logging.h"
 #include "spandsp/complex.h"
@@ -241,6 +242,9 @@ Both ends should accept unscrambled binary 1 or binary 0 as the preamble.
 
 #define ms_to_symbols(t)    (((t)*600)/1000)
 
+/*! The number of samples of carrier generated in one pass */
+#define V22BIS_TX_CARRIER_BLOCK_LEN  32
+
 static const int phase_steps[4] =
 {
     1, 0, 2, 3
@@ -272,6 +276,22 @@ static int fake_get_bit(void *user_data)
 }
 /*- End of function --------------------------------------------------------*/
 
+static __inline__ int get_data_bit(v22bis_state_t *s)
+{
+    int n;
+
+    if (s->get_bits == NULL  ||  s->tx.current_get_bit != s->get_bit)
+        return s->tx.current_get_bit(s->get_bit_user_data);
+    if (s->tx.bit_chunk_len <= 0)
+    {
+        if ((n = s->get_bits(s->get_bit_user_data, &s->tx.bit_chunk)) <= 0)
+            return (n < 0)  ?  n  :  SIG_STATUS_END_OF_DATA;
+        s->tx.bit_chunk_len = n;
+    }
+    return (s->tx.bit_chunk >> --s->tx.bit_chunk_len) & 1;
+}
+/*- End of function --------------------------------------------------------*/
+
 static __inline__ int scramble(v22bis_state_t *s, int bit)
 {
     int out_bit;
@@ -296,7 +316,7 @@ static __inline__ int get_scrambled_bit(v22bis_state_t *s)
 {
     int bit;
 
-    if ((bit = s->tx.current_get_bit(s->get_bit_user_data)) == SIG_STATUS_END_OF_DATA)
+    if ((bit = get_data_bit(s)) == SIG_STATUS_END_OF_DATA)
     {
         /* Fill out this symbol with ones, and prepare to send
            the rest of the shutdown sequence. */
@@ -452,12 +472,19 @@ SPAN_DECLARE_NONSTD(int) v22bis_tx(v22bis_state_t *s, int16_t amp[], int len)
 {
     complexf_t x;
     complexf_t z;
+    complexf_t carrier[V22BIS_TX_CARRIER_BLOCK_LEN];
     int i;
     int sample;
+    int carrier_start;
+    int carrier_end;
+    uint32_t carrier_phase_end;
     float famp;
 
     if (s->tx.shutdown > 10)
         return 0;
+    carrier_start = 0;
+    carrier_end = 0;
+    carrier_phase_end = s->tx.carrier_phase;
     for (sample = 0;  sample < len;  sample++)
     {
         if ((s->tx.baud_phase += 3) >= 40)
@@ -468,6 +495,16 @@ SPAN_DECLARE_NONSTD(int) v22bis_tx(v22bis_state_t *s, int16_t amp[], int len)
             if (++s->tx.rrc_filter_step >= V22BIS_TX_FILTER_STEPS)
                 s->tx.rrc_filter_step = 0;
         }
+        if (sample >= carrier_end  ||  s->tx.carrier_phase != carrier_phase_end)
+        {
+            /* Generate the carrier a block at a time. Anything which resets the carrier
+               phase, such as a restart of the modem from a callback, forces a new block. */
+            carrier_start = sample;
+            if ((carrier_end = sample + V22BIS_TX_CARRIER_BLOCK_LEN) > len)
+                carrier_end = len;
+            dds_complexf_block(&s->tx.carrier_phase, s->tx.carrier_phase_rate, carrier, carrier_end - carrier_start);
+            carrier_phase_end = s->tx.carrier_phase;
+        }
         /* Root raised cosine pulse shaping at baseband */
         x = complex_setf(0.0f, 0.0f);
         for (i = 0;  i < V22BIS_TX_FILTER_STEPS;  i++)
@@ -476,7 +513,7 @@ SPAN_DECLARE_NONSTD(int) v22bis_tx(v22bis_state_t *s, int16_t amp[], int len)
             x.im += tx_pulseshaper[39 - s->tx.baud_phase][i]*s->tx.rrc_filter[i + s->tx.rrc_filter_step].im;
         }
         /* Now create and modulate the carrier */
-        z = dds_complexf(&(s->tx.carrier_phase), s->tx.carrier_phase_rate);
+        z = carrier[sample - carrier_start];
         famp = (x.re*z.re - x.im*z.im)*s->tx.gain;
         if (s->tx.guard_phase_rate  &&  (s->tx.rrc_filter[s->tx.rrc_filter_step].re != 0.0f  ||  s->tx.rrc_filter[s->tx.rrc_filter_step].im != 0.0f))
         {
@@ -534,19 +571,32 @@ static int v22bis_tx_restart(v22bis_state_t *s)
     s->tx.constellation_state = 0;
     s->tx.current_get_bit = fake_get_bit;
     s->tx.shutdown = 0;
+    s->tx.bit_chunk_len = 0;
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
 
 SPAN_DECLARE(void) v22bis_set_get_bit(v22bis_state_t *s, get_bit_func_t get_bit, void *user_data)
 {
+    s->get_bits = NULL;
+    s->tx.bit_chunk_len = 0;
     s->get_bit = get_bit;
     s->get_bit_user_data = user_data;
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(void) v22bis_set_get_bits(v22bis_state_t *s, get_bits_func_t get_bits)
+{
+    s->get_bits = get_bits;
+    s->tx.bit_chunk_len = 0;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) v22bis_set_put_bit(v22bis_state_t *s, put_bit_func_t put_bit, void *user_data)
 {
+    /* Any bits waiting for a put_bits function were passed on at the end of the last
+       call to v22bis_rx(), so there is nothing to flush here. */
+    s->put_bits = NULL;
     s->put_bit = put_bit;
     s->put_bit_user_data = user_data;
 }
@@ -650,7 +700,7 @@ SPAN_DECLARE(v22bis_state_t *) v22bis_init(v22bis_state_t *s,
     }
     if (s == NULL)
     {
-        if ((s = (v22bis_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (v22bis_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -698,7 +748,7 @@ SPAN_DECLARE(int) v22bis_release(v22bis_state_t *s)
 
 SPAN_DECLARE(int) v22bis_free(v22bis_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
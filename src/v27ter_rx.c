@@ -43,6 +43,7 @@
 #include "floating_fudge.h"
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
 #include "spandsp/complex.h"
 #include "spandsp/vector_float.h"
@@ -163,8 +164,19 @@ SPAN_DECLARE(void) v27ter_rx_signal_cutoff(v27ter_rx_state_t *s, float cutoff)
 }
 /*- End of function --------------------------------------------------------*/
 
+static __inline__ void flush_bit_chunk(v27ter_rx_state_t *s)
+{
+    if (s->bit_chunk_len)
+    {
+        s->put_bits(s->put_bit_user_data, s->bit_chunk & ((1 << s->bit_chunk_len) - 1), s->bit_chunk_len);
+        s->bit_chunk_len = 0;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
 static void report_status_change(v27ter_rx_state_t *s, int status)
 {
+    flush_bit_chunk(s);
     if (s->status_handler)
         s->status_handler(s->status_user_data, status);
     else if (s->put_bit)
@@ -413,7 +425,16 @@ static __inline__ void put_bit(v27ter_rx_state_t *s, int bit)
        go to the application. */
     if (s->training_stage == TRAINING_STAGE_NORMAL_OPERATION)
     {
-        s->put_bit(s->put_bit_user_data, out_bit);
+        if (s->put_bits)
+        {
+            s->bit_chunk = (s->bit_chunk << 1) | out_bit;
+            if (++s->bit_chunk_len >= 16)
+                flush_bit_chunk(s);
+        }
+        else
+        {
+            s->put_bit(s->put_bit_user_data, out_bit);
+        }
     }
     else
     {
@@ -973,6 +994,7 @@ SPAN_DECLARE_NONSTD(int) v27ter_rx(v27ter_rx_state_t *s, const int16_t amp[], in
 #endif
         }
     }
+    flush_bit_chunk(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -1014,11 +1036,20 @@ SPAN_DECLARE_NONSTD(int) v27ter_rx_fillin(v27ter_rx_state_t *s, int len)
 
 SPAN_DECLARE(void) v27ter_rx_set_put_bit(v27ter_rx_state_t *s, put_bit_func_t put_bit, void *user_data)
 {
+    flush_bit_chunk(s);
+    s->put_bits = NULL;
     s->put_bit = put_bit;
     s->put_bit_user_data = user_data;
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(void) v27ter_rx_set_put_bits(v27ter_rx_state_t *s, put_bits_func_t put_bits)
+{
+    flush_bit_chunk(s);
+    s->put_bits = put_bits;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) v27ter_rx_set_modem_status_handler(v27ter_rx_state_t *s, modem_tx_status_func_t handler, void *user_data)
 {
     s->status_handler = handler;
@@ -1111,7 +1142,7 @@ SPAN_DECLARE(v27ter_rx_state_t *) v27ter_rx_init(v27ter_rx_state_t *s, int bit_r
     }
     if (s == NULL)
     {
-        if ((s = (v27ter_rx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (v27ter_rx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -1134,7 +1165,7 @@ SPAN_DECLARE(int) v27ter_rx_release(v27ter_rx_state_t *s)
 
 SPAN_DECLARE(int) v27ter_rx_free(v27ter_rx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
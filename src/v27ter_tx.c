@@ -42,6 +42,7 @@
 #include "floating_fudge.h"
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/fast_convert.h"
 #include "spandsp/logging.h"
 #include "spandsp/complex.h"
@@ -87,12 +88,31 @@
 /*! The end of the shutdown sequence, in symbols */
 #define V27TER_TRAINING_SHUTDOWN_END    (V27TER_TRAINING_END + 32)
 
+/*! The number of samples of carrier generated in one pass */
+#define V27TER_TX_CARRIER_BLOCK_LEN  32
+
 static int fake_get_bit(void *user_data)
 {
     return 1;
 }
 /*- End of function --------------------------------------------------------*/
 
+static __inline__ int get_data_bit(v27ter_tx_state_t *s)
+{
+    int n;
+
+    if (s->get_bits == NULL  ||  s->current_get_bit != s->get_bit)
+        return s->current_get_bit(s->get_bit_user_data);
+    if (s->bit_chunk_len <= 0)
+    {
+        if ((n = s->get_bits(s->get_bit_user_data, &s->bit_chunk)) <= 0)
+            return (n < 0)  ?  n  :  SIG_STATUS_END_OF_DATA;
+        s->bit_chunk_len = n;
+    }
+    return (s->bit_chunk >> --s->bit_chunk_len) & 1;
+}
+/*- End of function --------------------------------------------------------*/
+
 static __inline__ int scramble(v27ter_tx_state_t *s, int in_bit)
 {
     int out_bit;
@@ -120,7 +140,7 @@ static __inline__ int get_scrambled_bit(v27ter_tx_state_t *s)
 {
     int bit;
     
-    if ((bit = s->current_get_bit(s->get_bit_user_data)) == SIG_STATUS_END_OF_DATA)
+    if ((bit = get_data_bit(s)) == SIG_STATUS_END_OF_DATA)
     {
         /* End of real data. Switch to the fake get_bit routine, until we
            have shut down completely. */
@@ -249,18 +269,26 @@ SPAN_DECLARE_NONSTD(int) v27ter_tx(v27ter_tx_state_t *s, int16_t amp[], int len)
 #if defined(SPANDSP_USE_FIXED_POINT)
     complexi_t x;
     complexi_t z;
+    complexi_t carrier[V27TER_TX_CARRIER_BLOCK_LEN];
 #else
     complexf_t x;
     complexf_t z;
+    complexf_t carrier[V27TER_TX_CARRIER_BLOCK_LEN];
 #endif
     int i;
     int sample;
+    int carrier_start;
+    int carrier_end;
+    uint32_t carrier_phase_end;
 
     if (s->training_step >= V27TER_TRAINING_SHUTDOWN_END)
     {
         /* Once we have sent the shutdown symbols, we stop sending completely. */
         return 0;
     }
+    carrier_start = 0;
+    carrier_end = 0;
+    carrier_phase_end = s->carrier_phase;
     /* The symbol rates for the two bit rates are different. This makes it difficult to
        merge both generation procedures into a single efficient loop. We do not bother
        trying. We use two independent loops, filter coefficients, etc. */
@@ -276,6 +304,20 @@ SPAN_DECLARE_NONSTD(int) v27ter_tx(v27ter_tx_state_t *s, int16_t amp[], int len)
                 if (++s->rrc_filter_step >= V27TER_TX_FILTER_STEPS)
                     s->rrc_filter_step = 0;
             }
+            if (sample >= carrier_end  ||  s->carrier_phase != carrier_phase_end)
+            {
+                /* Generate the carrier a block at a time. Anything which resets the carrier
+                   phase, such as a restart of the modem from a callback, forces a new block. */
+                carrier_start = sample;
+                if ((carrier_end = sample + V27TER_TX_CARRIER_BLOCK_LEN) > len)
+                    carrier_end = len;
+#if defined(SPANDSP_USE_FIXED_POINT)
+                dds_complexi_block(&s->carrier_phase, s->carrier_phase_rate, carrier, carrier_end - carrier_start);
+#else
+                dds_complexf_block(&s->carrier_phase, s->carrier_phase_rate, carrier, carrier_end - carrier_start);
+#endif
+                carrier_phase_end = s->carrier_phase;
+            }
             /* Root raised cosine pulse shaping at baseband */
 #if defined(SPANDSP_USE_FIXED_POINT)
             x = complex_seti(0, 0);
@@ -287,7 +329,7 @@ SPAN_DECLARE_NONSTD(int) v27ter_tx(v27ter_tx_state_t *s, int16_t amp[], int len)
             /* Now create and modulate the carrier */
             x.re >>= 14;
             x.im >>= 14;
-            z = dds_complexi(&(s->carrier_phase), s->carrier_phase_rate);
+            z = carrier[sample - carrier_start];
             /* Don't bother saturating. We should never clip. */
             i = (x.re*z.re - x.im*z.im) >> 15;
             amp[sample] = (int16_t) ((i*s->gain_4800) >> 15);
@@ -299,7 +341,7 @@ SPAN_DECLARE_NONSTD(int) v27ter_tx(v27ter_tx_state_t *s, int16_t amp[], int len)
                 x.im += tx_pulseshaper_4800[TX_PULSESHAPER_4800_COEFF_SETS - 1 - s->baud_phase][i]*s->rrc_filter[i + s->rrc_filter_step].im;
             }
             /* Now create and modulate the carrier */
-            z = dds_complexf(&(s->carrier_phase), s->carrier_phase_rate);
+            z = carrier[sample - carrier_start];
             /* Don't bother saturating. We should never clip. */
             amp[sample] = (int16_t) lfastrintf((x.re*z.re - x.im*z.im)*s->gain_4800);
 #endif
@@ -317,6 +359,20 @@ SPAN_DECLARE_NONSTD(int) v27ter_tx(v27ter_tx_state_t *s, int16_t amp[], int len)
                 if (++s->rrc_filter_step >= V27TER_TX_FILTER_STEPS)
                     s->rrc_filter_step = 0;
             }
+            if (sample >= carrier_end  ||  s->carrier_phase != carrier_phase_end)
+            {
+                /* Generate the carrier a block at a time. Anything which resets the carrier
+                   phase, such as a restart of the modem from a callback, forces a new block. */
+                carrier_start = sample;
+                if ((carrier_end = sample + V27TER_TX_CARRIER_BLOCK_LEN) > len)
+                    carrier_end = len;
+#if defined(SPANDSP_USE_FIXED_POINT)
+                dds_complexi_block(&s->carrier_phase, s->carrier_phase_rate, carrier, carrier_end - carrier_start);
+#else
+                dds_complexf_block(&s->carrier_phase, s->carrier_phase_rate, carrier, carrier_end - carrier_start);
+#endif
+                carrier_phase_end = s->carrier_phase;
+            }
             /* Root raised cosine pulse shaping at baseband */
 #if defined(SPANDSP_USE_FIXED_POINT)
             x = complex_seti(0, 0);
@@ -328,7 +384,7 @@ SPAN_DECLARE_NONSTD(int) v27ter_tx(v27ter_tx_state_t *s, int16_t amp[], int len)
             /* Now create and modulate the carrier */
             x.re >>= 14;
             x.im >>= 14;
-            z = dds_complexi(&(s->carrier_phase), s->carrier_phase_rate);
+            z = carrier[sample - carrier_start];
             /* Don't bother saturating. We should never clip. */
             i = (x.re*z.re - x.im*z.im) >> 15;
             amp[sample] = (int16_t) ((i*s->gain_2400) >> 15);
@@ -340,7 +396,7 @@ SPAN_DECLARE_NONSTD(int) v27ter_tx(v27ter_tx_state_t *s, int16_t amp[], int len)
                 x.im += tx_pulseshaper_2400[TX_PULSESHAPER_2400_COEFF_SETS - 1 - s->baud_phase][i]*s->rrc_filter[i + s->rrc_filter_step].im;
             }
             /* Now create and modulate the carrier */
-            z = dds_complexf(&(s->carrier_phase), s->carrier_phase_rate);
+            z = carrier[sample - carrier_start];
             /* Don't bother saturating. We should never clip. */
             amp[sample] = (int16_t) lfastrintf((x.re*z.re - x.im*z.im)*s->gain_2400);
 #endif
@@ -367,6 +423,8 @@ SPAN_DECLARE(void) v27ter_tx_power(v27ter_tx_state_t *s, float power)
 
 SPAN_DECLARE(void) v27ter_tx_set_get_bit(v27ter_tx_state_t *s, get_bit_func_t get_bit, void *user_data)
 {
+    s->get_bits = NULL;
+    s->bit_chunk_len = 0;
     if (s->get_bit == s->current_get_bit)
         s->current_get_bit = get_bit;
     s->get_bit = get_bit;
@@ -374,6 +432,13 @@ SPAN_DECLARE(void) v27ter_tx_set_get_bit(v27ter_tx_state_t *s, get_bit_func_t ge
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(void) v27ter_tx_set_get_bits(v27ter_tx_state_t *s, get_bits_func_t get_bits)
+{
+    s->get_bits = get_bits;
+    s->bit_chunk_len = 0;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) v27ter_tx_set_modem_status_handler(v27ter_tx_state_t *s, modem_tx_status_func_t handler, void *user_data)
 {
     s->status_handler = handler;
@@ -406,6 +471,7 @@ SPAN_DECLARE(int) v27ter_tx_restart(v27ter_tx_state_t *s, int bit_rate, int tep)
     s->baud_phase = 0;
     s->constellation_state = 0;
     s->current_get_bit = fake_get_bit;
+    s->bit_chunk_len = 0;
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -422,7 +488,7 @@ SPAN_DECLARE(v27ter_tx_state_t *) v27ter_tx_init(v27ter_tx_state_t *s, int bit_r
     }
     if (s == NULL)
     {
-        if ((s = (v27ter_tx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (v27ter_tx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -445,7 +511,7 @@ SPAN_DECLARE(int) v27ter_tx_release(v27ter_tx_state_t *s)
 
 SPAN_DECLARE(int) v27ter_tx_free(v27ter_tx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
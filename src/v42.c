@@ -38,6 +38,7 @@
 #include <errno.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
 #include "spandsp/async.h"
 #include "spandsp/hdlc.h"
@@ -191,7 +192,7 @@ static int lapm_ack_packet(lapm_state_t *s, int num)
                      (f->frame[1] >> 1),
                      (s->txqueue)  ?  (s->txqueue->frame[1] >> 1)  :  -1);
             s->last_frame_peer_acknowledged = num;
-            free(f);
+            span_free(f);
             /* Reset retransmission count if we actually acked something */
             s->retransmissions = 0;
             return 1;
@@ -411,7 +412,7 @@ SPAN_DECLARE(int) lapm_tx_iframe(lapm_state_t *s, const void *buf, int len, int
 {
     lapm_frame_queue_t *f;
 
-    if ((f = malloc(sizeof(*f) + len + 4)) == NULL)
+    if ((f = span_alloc(sizeof(*f) + len + 4)) == NULL)
     {
         span_log(&s->logging, SPAN_LOG_FLOW, "Out of memory\n");
         return -1;
@@ -700,7 +701,7 @@ fprintf(stderr, "Deleting T403 e %d\n", s->t403_timer);
     {
         p = f;
         f = f->next;
-        free(p);
+        span_free(p);
     }
     /*endfor*/
     s->txqueue = NULL;
@@ -1387,7 +1388,7 @@ SPAN_DECLARE(v42_state_t *) v42_init(v42_state_t *s, int calling_party, int dete
     alloced = FALSE;
     if (s == NULL)
     {
-        if ((s = (v42_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (v42_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
         alloced = TRUE;
     }
@@ -1404,7 +1405,7 @@ SPAN_DECLARE(v42_state_t *) v42_init(v42_state_t *s, int calling_party, int dete
     if ((s->lapm.tx_queue = queue_init(NULL, 16384, 0)) == NULL)
     {
         if (alloced)
-            free(s);
+            span_free(s);
         return NULL;
     }
     /*endif*/
@@ -1423,7 +1424,7 @@ SPAN_DECLARE(int) v42_release(v42_state_t *s)
 
 SPAN_DECLARE(int) v42_free(v42_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
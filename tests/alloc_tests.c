@@ -0,0 +1,393 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * alloc_tests.c - Tests for the replaceable allocator, and memory arenas.
+ *
+ * Written by Steve Underwood <steveu@coppice.org>
+ *
+ * Copyright (C) 2010 Steve Underwood
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+/*! \page alloc_tests_page Allocator and arena tests
+\section alloc_tests_page_sec_1 What does it do?
+An arena is checked for alignment, growing and giving back the most recent allocation,
+running out of space, and being reset. A counting allocator is then installed, and FAX,
+T.38 gateway and line echo canceller contexts are created and freed, to check every
+allocation the library makes passes through it, and is freed. The same contexts are
+then created from an arena, and checked to make no use of the allocator. Arena memory
+is freed and resized with another arena, or none, selected. Finally, the time to set up
+and tear down a call's contexts is measured, from the heap and from an arena.
+*/
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+//#if defined(WITH_SPANDSP_INTERNALS)
+#define SPANDSP_EXPOSE_INTERNAL_STRUCTURES
+//#endif
+
+#include "spandsp.h"
+
+#define ARENA_SIZE          (1024*1024)
+#define BENCHMARK_CALLS     20000
+
+static int allocs;
+static int frees;
+
+static uint8_t arena_buf[ARENA_SIZE];
+
+static double wall_clock(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec/1000000.0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void *counting_alloc(size_t size)
+{
+    allocs++;
+    return malloc(size);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void *counting_realloc(void *ptr, size_t size)
+{
+    if (ptr == NULL)
+        allocs++;
+    return realloc(ptr, size);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void counting_free(void *ptr)
+{
+    if (ptr)
+        frees++;
+    free(ptr);
+}
+/*- End of function --------------------------------------------------------*/
+
+static int in_arena(const uint8_t *p)
+{
+    return (p >= arena_buf  &&  p < arena_buf + ARENA_SIZE);
+}
+/*- End of function --------------------------------------------------------*/
+
+static int tx_packet_handler(t38_core_state_t *s, void *user_data, const uint8_t *buf, int len, int count)
+{
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int make_call(fax_state_t **fax, t38_gateway_state_t **t38, echo_can_state_t **ec)
+{
+    if ((*fax = fax_init(NULL, TRUE)) == NULL)
+        return -1;
+    if ((*t38 = t38_gateway_init(NULL, tx_packet_handler, NULL)) == NULL)
+        return -1;
+    if ((*ec = echo_can_init(256, ECHO_CAN_USE_ADAPTION)) == NULL)
+        return -1;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void end_call(fax_state_t *fax, t38_gateway_state_t *t38, echo_can_state_t *ec)
+{
+    fax_free(fax);
+    t38_gateway_free(t38);
+    echo_can_free(ec);
+}
+/*- End of function --------------------------------------------------------*/
+
+static int test_arena(void)
+{
+    span_arena_t *arena;
+    uint8_t *a;
+    uint8_t *b;
+    uint8_t *c;
+    size_t used;
+    int i;
+
+    printf("Testing an arena\n");
+    if ((arena = span_arena_init(NULL, arena_buf + 3, 4096)) == NULL)
+    {
+        printf("Cannot create arena\n");
+        return -1;
+    }
+    span_arena_select(arena);
+    a = span_alloc(10);
+    b = span_alloc(100);
+    if (a == NULL  ||  b == NULL  ||  ((uintptr_t) a & 15)  ||  ((uintptr_t) b & 15))
+    {
+        printf("Bad arena allocation %p %p\n", a, b);
+        return -1;
+    }
+    /* The most recent allocation grows where it is, and can be given back. */
+    memset(b, 0x55, 100);
+    used = span_arena_get_used(arena);
+    if ((c = span_realloc(b, 200)) != b)
+    {
+        printf("Most recent allocation moved when grown\n");
+        return -1;
+    }
+    span_free(c);
+    if (span_arena_get_used(arena) >= used)
+    {
+        printf("Most recent allocation not given back\n");
+        return -1;
+    }
+    /* An older allocation moves when grown, keeping its contents. */
+    memset(a, 0xAA, 10);
+    b = span_alloc(100);
+    if ((c = span_realloc(a, 50)) == a  ||  c == NULL)
+    {
+        printf("Older allocation not moved when grown\n");
+        return -1;
+    }
+    for (i = 0;  i < 10;  i++)
+    {
+        if (c[i] != 0xAA)
+        {
+            printf("Contents lost when grown\n");
+            return -1;
+        }
+    }
+    /* Running out of space fails cleanly. */
+    if (span_alloc(8192))
+    {
+        printf("Allocation larger than the arena succeeded\n");
+        return -1;
+    }
+    span_arena_reset(arena);
+    if (span_arena_get_used(arena) != 0  ||  span_arena_get_peak(arena) == 0)
+    {
+        printf("Reset failed\n");
+        return -1;
+    }
+    if (span_alloc(4000) == NULL)
+    {
+        printf("Arena not reusable after reset\n");
+        return -1;
+    }
+    span_arena_select(NULL);
+    span_arena_free(arena);
+    printf("Test passed\n");
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int test_custom_allocator(void)
+{
+    fax_state_t *fax;
+    t38_gateway_state_t *t38;
+    echo_can_state_t *ec;
+
+    printf("Testing a custom allocator\n");
+    span_set_allocator(counting_alloc, counting_realloc, counting_free);
+    allocs = 0;
+    frees = 0;
+    if (make_call(&fax, &t38, &ec))
+    {
+        printf("Cannot create call contexts\n");
+        return -1;
+    }
+    end_call(fax, t38, ec);
+    printf("%d allocations, %d frees\n", allocs, frees);
+    if (allocs == 0  ||  allocs != frees)
+    {
+        printf("Allocations and frees do not balance\n");
+        return -1;
+    }
+    printf("Test passed\n");
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int test_call_arena(void)
+{
+    span_arena_t arena;
+    fax_state_t *fax;
+    t38_gateway_state_t *t38;
+    echo_can_state_t *ec;
+    int16_t amp[160];
+    int i;
+
+    printf("Testing call contexts from an arena\n");
+    span_set_allocator(counting_alloc, counting_realloc, counting_free);
+    span_arena_init(&arena, arena_buf, ARENA_SIZE);
+    allocs = 0;
+    span_arena_select(&arena);
+    if (make_call(&fax, &t38, &ec))
+    {
+        printf("Cannot create call contexts\n");
+        return -1;
+    }
+    memset(amp, 0, sizeof(amp));
+    for (i = 0;  i < 100;  i++)
+    {
+        fax_rx(fax, amp, 160);
+        fax_tx(fax, amp, 160);
+        t38_gateway_rx(t38, amp, 160);
+        t38_gateway_tx(t38, amp, 160);
+    }
+    printf("A call's contexts use %d bytes of arena\n", (int) span_arena_get_used(&arena));
+    if (allocs)
+    {
+        printf("%d allocations did not come from the arena\n", allocs);
+        return -1;
+    }
+    /* The echo canceller's FIR history is allocated by an inline in a public header,
+       so check it really came from the arena, and not straight from the heap. */
+    if (!in_arena((const uint8_t *) ec->fir_state.history)
+        ||
+        !in_arena((const uint8_t *) ec->fir_taps32)
+        ||
+        !in_arena((const uint8_t *) ec->fir_taps16[0]))
+    {
+        printf("Echo canceller memory did not come from the arena\n");
+        return -1;
+    }
+    end_call(fax, t38, ec);
+    span_arena_reset(&arena);
+    span_arena_select(NULL);
+    span_arena_release(&arena);
+    span_set_allocator(NULL, NULL, NULL);
+    printf("Test passed\n");
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int test_free_anywhere(void)
+{
+    span_arena_t arena;
+    span_arena_t other;
+    dtmf_rx_state_t *dtmf;
+    uint8_t *a;
+    uint8_t *b;
+    size_t used;
+
+    printf("Testing freeing arena memory with a different arena, or none, selected\n");
+    span_set_allocator(counting_alloc, counting_realloc, counting_free);
+    span_arena_init(&arena, arena_buf, ARENA_SIZE/2);
+    span_arena_init(&other, arena_buf + ARENA_SIZE/2, ARENA_SIZE/2);
+    span_arena_select(&arena);
+    dtmf = dtmf_rx_init(NULL, NULL, NULL);
+    used = span_arena_get_used(&arena);
+    span_arena_select(NULL);
+    frees = 0;
+    /* The context is the most recent allocation, so it is given back to its arena,
+       and never reaches the allocator. */
+    dtmf_rx_free(dtmf);
+    if (frees  ||  span_arena_get_used(&arena) >= used)
+    {
+        printf("Arena memory not returned to its arena\n");
+        return -1;
+    }
+    span_arena_select(&arena);
+    a = span_alloc(100);
+    memset(a, 0x55, 100);
+    span_arena_select(&other);
+    if ((b = span_realloc(a, 200)) != a  ||  span_arena_get_used(&other) != 0)
+    {
+        printf("Arena memory resized outside its arena\n");
+        return -1;
+    }
+    span_free(b);
+    /* Heap memory is freed to the allocator, with an arena selected. */
+    span_arena_select(NULL);
+    a = span_alloc(100);
+    span_arena_select(&arena);
+    frees = 0;
+    span_free(a);
+    span_arena_select(NULL);
+    if (frees != 1)
+    {
+        printf("Heap memory not freed to the allocator\n");
+        return -1;
+    }
+    span_set_allocator(NULL, NULL, NULL);
+    printf("Test passed\n");
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int benchmark(void)
+{
+    span_arena_t arena;
+    fax_state_t *fax;
+    t38_gateway_state_t *t38;
+    echo_can_state_t *ec;
+    double start;
+    double heap_time;
+    double arena_time;
+    int i;
+
+    start = wall_clock();
+    for (i = 0;  i < BENCHMARK_CALLS;  i++)
+    {
+        if (make_call(&fax, &t38, &ec))
+            return -1;
+        end_call(fax, t38, ec);
+    }
+    heap_time = wall_clock() - start;
+
+    span_arena_init(&arena, arena_buf, ARENA_SIZE);
+    span_arena_select(&arena);
+    start = wall_clock();
+    for (i = 0;  i < BENCHMARK_CALLS;  i++)
+    {
+        if (make_call(&fax, &t38, &ec))
+            return -1;
+        span_arena_reset(&arena);
+    }
+    arena_time = wall_clock() - start;
+    span_arena_select(NULL);
+    span_arena_release(&arena);
+    printf("Call set up and tear down: heap %.2fus, arena %.2fus\n",
+           heap_time*1000000.0/BENCHMARK_CALLS,
+           arena_time*1000000.0/BENCHMARK_CALLS);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    if (test_arena())
+        exit(2);
+    if (test_custom_allocator())
+        exit(2);
+    if (test_call_arena())
+        exit(2);
+    if (test_free_anywhere())
+        exit(2);
+    if (benchmark())
+        exit(2);
+    printf("Tests passed.\n");
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
@@ -130,6 +130,8 @@ static void test_put_async_byte(void *user_data, int byte)
 int main(int argc, char *argv[])
 {
     int bit;
+    int bits;
+    unsigned int chunk;
 
     printf("Test with async 8N1\n");
     async_tx_init(&tx_async, 8, ASYNC_PARITY_NONE, 1, FALSE, test_get_async_byte, NULL);
@@ -241,6 +243,34 @@ int main(int argc, char *argv[])
         exit(2);
     }
 
+    printf("Test with async 7O2, a character at a time\n");
+    async_tx_init(&tx_async, 7, ASYNC_PARITY_ODD, 2, FALSE, test_get_async_byte, NULL);
+    async_rx_init(&rx_async, 7, ASYNC_PARITY_ODD, 2, FALSE, test_put_async_byte, NULL);
+    tx_async_chars = 0;
+    rx_async_chars = 0;
+    rx_async_char_mask = 0x7F;
+    /* Start part way through a character, to check the hand over from bit at a time working */
+    for (bits = 0;  bits < 3;  bits++)
+    {
+        bit = async_tx_get_bit(&tx_async);
+        async_rx_put_bit(&rx_async, bit);
+    }
+    while (rx_async_chars < 1000)
+    {
+        bits = async_tx_get_bits(&tx_async, &chunk);
+        async_rx_put_bits(&rx_async, chunk, bits);
+    }
+    printf("Chars=%d/%d, PE=%d, FE=%d\n", tx_async_chars, rx_async_chars, rx_async.parity_errors, rx_async.framing_errors);
+    if (tx_async_chars != rx_async_chars
+        ||
+        rx_async.parity_errors
+        ||
+        rx_async.framing_errors)
+    {
+        printf("Test failed.\n");
+        exit(2);
+    }
+
     printf("Tests passed.\n");
     return  0;
 }
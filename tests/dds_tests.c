@@ -51,6 +51,93 @@
 
 #define SAMPLES_PER_CHUNK           8000
 
+static int test_block_generation(void)
+{
+    int i;
+    int j;
+    int len;
+    int32_t phase_rate;
+    int32_t phase_offset;
+    int16_t scale;
+    uint32_t phase1;
+    uint32_t phase2;
+    int16_t amp1[50];
+    int16_t amp2[50];
+    float ampf1[50];
+    float ampf2[50];
+    complexi_t campi1[50];
+    complexi_t campi2[50];
+    complexf_t campf1[50];
+    complexf_t campf2[50];
+
+    printf("Block generation tests.\n");
+    phase1 =
+    phase2 = 0x12345678;
+    for (i = 0;  i < 10000;  i++)
+    {
+        /* Every block function must give the same samples, and leave the same phase,
+           as the single sample function it matches. */
+        len = i%50;
+        phase_rate = (rand() << 16) ^ rand();
+        phase_offset = (rand() << 16) ^ rand();
+        scale = (int16_t) rand();
+        switch (i%6)
+        {
+        case 0:
+            for (j = 0;  j < len;  j++)
+                amp1[j] = dds(&phase1, phase_rate);
+            dds_block(&phase2, phase_rate, amp2, len);
+            break;
+        case 1:
+            for (j = 0;  j < len;  j++)
+                amp1[j] = dds_mod(&phase1, phase_rate, scale, phase_offset);
+            dds_mod_block(&phase2, phase_rate, scale, phase_offset, amp2, len);
+            break;
+        case 2:
+            for (j = 0;  j < len;  j++)
+                campi1[j] = dds_complexi(&phase1, phase_rate);
+            dds_complexi_block(&phase2, phase_rate, campi2, len);
+            break;
+        case 3:
+            for (j = 0;  j < len;  j++)
+                ampf1[j] = ddsf(&phase1, phase_rate);
+            ddsf_block(&phase2, phase_rate, ampf2, len);
+            break;
+        case 4:
+            for (j = 0;  j < len;  j++)
+                ampf1[j] = dds_modf(&phase1, phase_rate, 1234.5f, phase_offset);
+            dds_modf_block(&phase2, phase_rate, 1234.5f, phase_offset, ampf2, len);
+            break;
+        case 5:
+            for (j = 0;  j < len;  j++)
+                campf1[j] = dds_complexf(&phase1, phase_rate);
+            dds_complexf_block(&phase2, phase_rate, campf2, len);
+            break;
+        }
+        if (phase1 != phase2)
+        {
+            printf("Phase mismatch after block %d\n", i);
+            return -1;
+        }
+        for (j = 0;  j < len;  j++)
+        {
+            if ((i%6 <= 1  &&  amp1[j] != amp2[j])
+                ||
+                (i%6 == 2  &&  (campi1[j].re != campi2[j].re  ||  campi1[j].im != campi2[j].im))
+                ||
+                ((i%6 == 3  ||  i%6 == 4)  &&  ampf1[j] != ampf2[j])
+                ||
+                (i%6 == 5  &&  (campf1[j].re != campf2[j].re  ||  campf1[j].im != campf2[j].im)))
+            {
+                printf("Sample mismatch at %d in block %d\n", j, i);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
 int main(int argc, char *argv[])
 {
     int i;
@@ -65,6 +152,12 @@ int main(int argc, char *argv[])
     power_meter_t meter_q;
     int scale;
 
+    if (test_block_generation())
+    {
+        printf("Test failed.\n");
+        exit(2);
+    }
+
     power_meter_init(&meter, 10);
 
     printf("Non-complex DDS tests.\n");
@@ -0,0 +1,332 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * fax_modems_tests.c - Tests for the set of modems needed for FAX.
+ *
+ * Written by Steve Underwood <steveu@coppice.org>
+ *
+ * Copyright (C) 2008 Steve Underwood
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+/*! \page fax_modems_tests_page FAX modems tests
+\section fax_modems_tests_page_sec_1 What does it do?
+V.17, V.29 and V.27ter signals, each after a period of silence, are fed to the
+receive front end which runs all the fast receivers in parallel. The right receiver
+must be the one which trains, its training must be reported just once, and it must
+then deliver the data. The same signals are then sent to a T.38 gateway, after a DCS
+which does not say which fast modem will be used. The gateway must announce the
+modem which actually turns up, and relay its data.
+*/
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+//#if defined(WITH_SPANDSP_INTERNALS)
+#define SPANDSP_EXPOSE_INTERNAL_STRUCTURES
+//#endif
+
+#include "spandsp.h"
+
+#define BLOCK_LEN           160
+
+enum
+{
+    TEST_V17,
+    TEST_V29,
+    TEST_V27TER
+};
+
+static const struct
+{
+    const char *name;
+    int bit_rate;
+    int winner;
+    int indicator;
+    int data_type;
+} tests[] =
+{
+    {"V.17",    14400, FAX_MODEMS_MULTI_RX_V17,    T38_IND_V17_14400_LONG_TRAINING, T38_DATA_V17_14400},
+    {"V.29",     9600, FAX_MODEMS_MULTI_RX_V29,    T38_IND_V29_9600_TRAINING,       T38_DATA_V29_9600},
+    {"V.27ter",  4800, FAX_MODEMS_MULTI_RX_V27TER, T38_IND_V27TER_4800_TRAINING,    T38_DATA_V27TER_4800}
+};
+
+static v17_tx_state_t v17_tx_state;
+static v29_tx_state_t v29_tx_state;
+static v27ter_tx_state_t v27ter_tx_state;
+
+static int training_in_progress;
+static int training_succeeded;
+static int status_out_of_order;
+static int zeros;
+static int ones;
+
+static int last_indicator;
+static int last_data_type;
+static int data_octets;
+
+static int fake_get_bit(void *user_data)
+{
+    /* TCF is all zeros */
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void start_tx(int which)
+{
+    switch (which)
+    {
+    case TEST_V17:
+        v17_tx_init(&v17_tx_state, tests[which].bit_rate, FALSE, fake_get_bit, NULL);
+        break;
+    case TEST_V29:
+        v29_tx_init(&v29_tx_state, tests[which].bit_rate, FALSE, fake_get_bit, NULL);
+        break;
+    case TEST_V27TER:
+        v27ter_tx_init(&v27ter_tx_state, tests[which].bit_rate, FALSE, fake_get_bit, NULL);
+        break;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static void fast_tx(int which, int16_t amp[], int len)
+{
+    switch (which)
+    {
+    case TEST_V17:
+        v17_tx(&v17_tx_state, amp, len);
+        break;
+    case TEST_V29:
+        v29_tx(&v29_tx_state, amp, len);
+        break;
+    case TEST_V27TER:
+        v27ter_tx(&v27ter_tx_state, amp, len);
+        break;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static void non_ecm_put_bit(void *user_data, int bit)
+{
+    if (bit < 0)
+    {
+        switch (bit)
+        {
+        case SIG_STATUS_TRAINING_IN_PROGRESS:
+            if (training_in_progress  ||  training_succeeded)
+                status_out_of_order = TRUE;
+            training_in_progress++;
+            break;
+        case SIG_STATUS_TRAINING_SUCCEEDED:
+            if (!training_in_progress  ||  training_succeeded)
+                status_out_of_order = TRUE;
+            training_succeeded++;
+            break;
+        case SIG_STATUS_TRAINING_FAILED:
+            status_out_of_order = TRUE;
+            break;
+        }
+        return;
+    }
+    if (training_succeeded)
+    {
+        if (bit)
+            ones++;
+        else
+            zeros++;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static int multi_rx_tests(void)
+{
+    fax_modems_state_t *s;
+    int16_t amp[BLOCK_LEN];
+    int which;
+    int i;
+
+    for (which = 0;  which < 3;  which++)
+    {
+        printf("Testing %s through the parallel receivers\n", tests[which].name);
+        s = fax_modems_init(NULL, FALSE, NULL, NULL, non_ecm_put_bit, NULL, NULL, NULL);
+        fax_modems_start_multi_rx_modem(s, 14400, 4800, 9600, FALSE);
+        s->rx_handler = (span_rx_handler_t *) &fax_modems_multi_rx;
+        s->rx_fillin_handler = (span_rx_fillin_handler_t *) &fax_modems_multi_rx_fillin;
+        s->rx_user_data = s;
+        training_in_progress = 0;
+        training_succeeded = 0;
+        status_out_of_order = FALSE;
+        zeros = 0;
+        ones = 0;
+        memset(amp, 0, sizeof(amp));
+        for (i = 0;  i < 50;  i++)
+            s->rx_handler(s->rx_user_data, amp, BLOCK_LEN);
+        start_tx(which);
+        for (i = 0;  i < 100;  i++)
+        {
+            fast_tx(which, amp, BLOCK_LEN);
+            s->rx_handler(s->rx_user_data, amp, BLOCK_LEN);
+        }
+        printf("Trained %d, receiver 0x%x, %d zeros, %d ones\n", training_succeeded, s->multi_rx_trained, zeros, ones);
+        if (s->multi_rx_trained != tests[which].winner)
+        {
+            printf("Test failed: the wrong receiver trained\n");
+            return -1;
+        }
+        if (training_in_progress != 1  ||  training_succeeded != 1  ||  status_out_of_order)
+        {
+            printf("Test failed: training not reported just once\n");
+            return -1;
+        }
+        if (s->rx_handler == (span_rx_handler_t *) &fax_modems_multi_rx)
+        {
+            printf("Test failed: the receive path was not handed to the receiver\n");
+            return -1;
+        }
+        if (zeros < tests[which].bit_rate/2  ||  ones > zeros/100)
+        {
+            printf("Test failed: the data was not received\n");
+            return -1;
+        }
+        fax_modems_free(s);
+    }
+    printf("Test passed\n");
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int rx_indicator_handler(t38_core_state_t *s, void *user_data, int indicator)
+{
+    if (indicator != T38_IND_NO_SIGNAL)
+        last_indicator = indicator;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int rx_data_handler(t38_core_state_t *s, void *user_data, int data_type, int field_type, const uint8_t *buf, int len)
+{
+    if (field_type == T38_FIELD_T4_NON_ECM_DATA  ||  field_type == T38_FIELD_T4_NON_ECM_SIG_END)
+    {
+        last_data_type = data_type;
+        data_octets += len;
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int rx_missing_handler(t38_core_state_t *s, void *user_data, int rx_seq_no, int expected_seq_no)
+{
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int tx_packet_handler(t38_core_state_t *s, void *user_data, const uint8_t *buf, int len, int count)
+{
+    static int seq_no = 0;
+
+    t38_core_rx_ifp_packet((t38_core_state_t *) user_data, buf, len, seq_no++ & 0xFFFF);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int gateway_tests(void)
+{
+    /* A DCS which selects a modem the gateway does not know */
+    static const uint8_t dcs[] = {0xFF, 0x13, T30_DCS | 1, 0x00, 0x10, 0x00};
+    t38_gateway_state_t *t38;
+    t38_core_state_t *far_end;
+    hdlc_tx_state_t hdlc_tx;
+    fsk_tx_state_t v21_tx;
+    int16_t amp[BLOCK_LEN];
+    int16_t out[BLOCK_LEN];
+    int which;
+    int len;
+    int i;
+
+    for (which = 0;  which < 3;  which++)
+    {
+        printf("Testing %s through a T.38 gateway, after a DCS naming an unknown modem\n", tests[which].name);
+        far_end = t38_core_init(NULL, rx_indicator_handler, rx_data_handler, rx_missing_handler, NULL, tx_packet_handler, NULL);
+        t38 = t38_gateway_init(NULL, tx_packet_handler, far_end);
+        last_indicator = -1;
+        last_data_type = -1;
+        data_octets = 0;
+
+        hdlc_tx_init(&hdlc_tx, FALSE, 2, FALSE, NULL, NULL);
+        fsk_tx_init(&v21_tx, &preset_fsk_specs[FSK_V21CH2], (get_bit_func_t) hdlc_tx_get_bit, &hdlc_tx);
+        hdlc_tx_flags(&hdlc_tx, 32);
+        hdlc_tx_frame(&hdlc_tx, dcs, sizeof(dcs));
+        /* The preamble and the frame take about 1.1s */
+        for (i = 0;  i < 70;  i++)
+        {
+            len = fsk_tx(&v21_tx, amp, BLOCK_LEN);
+            if (len < BLOCK_LEN)
+                memset(amp + len, 0, sizeof(int16_t)*(BLOCK_LEN - len));
+            t38_gateway_rx(t38, amp, BLOCK_LEN);
+            t38_gateway_tx(t38, out, BLOCK_LEN);
+        }
+        /* Let the V.21 carrier fall, and leave the usual gap before TCF */
+        memset(amp, 0, sizeof(amp));
+        for (i = 0;  i < 10;  i++)
+        {
+            t38_gateway_rx(t38, amp, BLOCK_LEN);
+            t38_gateway_tx(t38, out, BLOCK_LEN);
+        }
+        start_tx(which);
+        for (i = 0;  i < 100;  i++)
+        {
+            fast_tx(which, amp, BLOCK_LEN);
+            t38_gateway_rx(t38, amp, BLOCK_LEN);
+            t38_gateway_tx(t38, out, BLOCK_LEN);
+        }
+        printf("Indicator %s, data type %d, %d octets\n", t38_indicator_to_str(last_indicator), last_data_type, data_octets);
+        if (last_indicator != tests[which].indicator)
+        {
+            printf("Test failed: the wrong modem was announced\n");
+            return -1;
+        }
+        if (last_data_type != tests[which].data_type  ||  data_octets < tests[which].bit_rate/16)
+        {
+            printf("Test failed: the data was not relayed\n");
+            return -1;
+        }
+        t38_gateway_free(t38);
+        t38_core_free(far_end);
+    }
+    printf("Test passed\n");
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    if (multi_rx_tests())
+        exit(2);
+    if (gateway_tests())
+        exit(2);
+    printf("Tests passed.\n");
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
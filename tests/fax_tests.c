@@ -98,6 +98,7 @@ static int phase_d_handler(t30_state_t *s, void *user_data, int result)
     log_transfer_statistics(s, tag);
     log_tx_parameters(s, tag);
     log_rx_parameters(s, tag);
+    printf("%c: T.30 context is using %d bytes\n", i, t30_get_memory_usage(s));
 
     if (use_receiver_not_ready)
         t30_set_receiver_not_ready(s, 3);
@@ -520,6 +521,8 @@ int main(int argc, char *argv[])
         mc = &machines[j];
         fax_release(mc->fax);
     }
+    /* Give back the ECM buffers the calls left for reuse, so memory checkers see no leaks. */
+    printf("%d bytes of ECM buffers freed\n", t30_ecm_pool_drain());
     if (log_audio)
     {
         if (sf_close(wave_handle))
@@ -67,6 +67,9 @@ both_ways_line_model_state_t *model;
 int rx_bits = 0;
 int cutoff_test_carrier = FALSE;
 
+int block_test_bits[2];
+uint32_t block_test_crc[2];
+
 static void rx_status(void *user_data, int status)
 {
     printf("FSK rx status is %s (%d)\n", signal_status_to_str(status), status);
@@ -160,6 +163,84 @@ static void reporter(void *user_data, int reason, bert_results_t *results)
 }
 /*- End of function --------------------------------------------------------*/
 
+static int block_test_get_bit(void *user_data)
+{
+    return (rand() >> 7) & 1;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void block_test_put_bit(void *user_data, int bit)
+{
+    int which;
+    uint8_t octet;
+
+    which = (int) (intptr_t) user_data;
+    octet = (uint8_t) bit;
+    block_test_crc[which] = crc_itu32_calc(&octet, 1, block_test_crc[which]);
+    if (bit >= 0)
+        block_test_bits[which]++;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int test_rx_block_processing(int modem_under_test)
+{
+    static int16_t amp[10*SAMPLE_RATE];
+    fsk_tx_state_t *tx;
+    fsk_rx_state_t *rx;
+    awgn_state_t noise_source;
+    uint64_t start;
+    uint64_t end;
+    int len;
+    int i;
+    int j;
+    int chunk;
+
+    /* The receiver correlates whole blocks of samples at a time, but the bits it
+       produces must not depend on how the audio is chopped up by the caller.
+       Feed the same noisy signal sample by sample, and in blocks, and compare. */
+    printf("Test receiver block processing\n");
+    srand(1234);
+    tx = fsk_tx_init(NULL, &preset_fsk_specs[modem_under_test], block_test_get_bit, NULL);
+    len = fsk_tx(tx, amp, 10*SAMPLE_RATE);
+    fsk_tx_free(tx);
+    awgn_init_dbm0(&noise_source, 1234567, -30.0f);
+    for (i = 0;  i < len;  i++)
+    {
+        /* Chop some gaps into the signal, to exercise carrier up and down */
+        if ((i % 20000) > 17000)
+            amp[i] = 0;
+        amp[i] = saturate(amp[i] + awgn(&noise_source));
+    }
+    for (j = 0;  j < 2;  j++)
+    {
+        block_test_bits[j] = 0;
+        block_test_crc[j] = 0xFFFFFFFF;
+        rx = fsk_rx_init(NULL, &preset_fsk_specs[modem_under_test], FSK_FRAME_MODE_SYNC, block_test_put_bit, (void *) (intptr_t) j);
+        start = rdtscll();
+        for (i = 0;  i < len;  i += chunk)
+        {
+            chunk = (j == 0)  ?  1  :  BLOCK_LEN;
+            if (chunk > len - i)
+                chunk = len - i;
+            fsk_rx(rx, &amp[i], chunk);
+        }
+        end = rdtscll();
+        fsk_rx_free(rx);
+        printf("%s blocks: %d bits, %" PRIu64 " ticks per sample\n", (j == 0)  ?  "1 sample"  :  "160 sample", block_test_bits[j], (end - start)/len);
+    }
+    if (block_test_bits[0] == 0
+        ||
+        block_test_bits[0] != block_test_bits[1]
+        ||
+        block_test_crc[0] != block_test_crc[1])
+    {
+        printf("Block and sample by sample processing give different results.\n");
+        return -1;
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
 int main(int argc, char *argv[])
 {
     fsk_tx_state_t *caller_tx;
@@ -361,7 +442,13 @@ int main(int argc, char *argv[])
             printf("Tests failed.\n");
             exit(2);
         }
-                
+
+        if (test_rx_block_processing(modem_under_test_1))
+        {
+            printf("Tests failed.\n");
+            exit(2);
+        }
+
         printf("Test with BERT\n");
         test_bps = preset_fsk_specs[modem_under_test_1].baud_rate;
         if (modem_under_test_1 >= 0)
@@ -27,7 +27,9 @@
 
 /*! \page g722_tests_page G.722 tests
 \section g722_tests_page_sec_1 What does it do?
-This modules implements two sets of tests:
+This modules implements three sets of tests:
+    - A check that the multi-channel batch calls, and the QMFs, give exactly the same results
+      as handling each channel separately. This needs no test data, and is always run.
     - The tests defined in the G.722 specification, using the test data files supplied
       with the specification.
     - A generally audio quality test, consisting of compressing and decompressing a speeech
@@ -81,6 +83,8 @@ and the resulting audio stored in post_g722.wav.
 
 #define MAX_TEST_VECTOR_LEN 40000
 
+#define BATCH_CHANNELS      12
+
 #define TESTDATA_DIR        "../test-data/itu/g722/"
 
 #define EIGHTK_IN_FILE_NAME "../test-data/local/short_nb_voice.wav"
@@ -347,6 +351,95 @@ static void itu_compliance_tests(void)
 }
 /*- End of function --------------------------------------------------------*/
 
+static void batch_tests(void)
+{
+    g722_encode_state_t *enc[BATCH_CHANNELS];
+    g722_decode_state_t *dec[BATCH_CHANNELS];
+    g722_encode_state_t *enc_batch[BATCH_CHANNELS];
+    g722_decode_state_t *dec_batch[BATCH_CHANNELS];
+    int16_t amp[BATCH_CHANNELS][BLOCK_LEN];
+    uint8_t g722_data[BATCH_CHANNELS][BLOCK_LEN];
+    uint8_t g722_data_batch[BATCH_CHANNELS][BLOCK_LEN];
+    int16_t out[BATCH_CHANNELS][2*BLOCK_LEN];
+    int16_t out_batch[BATCH_CHANNELS][2*BLOCK_LEN];
+    const int16_t *amp_ptrs[BATCH_CHANNELS];
+    uint8_t *data_ptrs[BATCH_CHANNELS];
+    const uint8_t *const_data_ptrs[BATCH_CHANNELS];
+    int16_t *out_ptrs[BATCH_CHANNELS];
+    int bytes[BATCH_CHANNELS];
+    int bytes_batch[BATCH_CHANNELS];
+    int samples;
+    int rate;
+    int options;
+    int block;
+    int i;
+    int k;
+
+    /* The batch functions must give exactly the same results as handling the
+       channels one by one, with a mixture of bit rates and options. */
+    printf("Testing batch encoding and decoding\n");
+    for (k = 0;  k < BATCH_CHANNELS;  k++)
+    {
+        rate = (k%3 == 0)  ?  64000  :  (k%3 == 1)  ?  56000  :  48000;
+        options = (k >> 1) & (G722_SAMPLE_RATE_8000 | G722_PACKED);
+        enc[k] = g722_encode_init(NULL, rate, options);
+        enc_batch[k] = g722_encode_init(NULL, rate, options);
+        dec[k] = g722_decode_init(NULL, rate, options);
+        dec_batch[k] = g722_decode_init(NULL, rate, options);
+        amp_ptrs[k] = amp[k];
+        data_ptrs[k] = g722_data_batch[k];
+        const_data_ptrs[k] = g722_data_batch[k];
+        out_ptrs[k] = out_batch[k];
+    }
+    for (block = 0;  block < 200;  block++)
+    {
+        for (k = 0;  k < BATCH_CHANNELS;  k++)
+        {
+            for (i = 0;  i < BLOCK_LEN;  i++)
+                amp[k][i] = (int16_t) ((rand() & 0x3FFF) - 0x2000);
+            bytes[k] = g722_encode(enc[k], g722_data[k], amp[k], BLOCK_LEN);
+        }
+        g722_encode_batch(enc_batch, data_ptrs, amp_ptrs, BLOCK_LEN, bytes_batch, BATCH_CHANNELS);
+        for (k = 0;  k < BATCH_CHANNELS;  k++)
+        {
+            if (bytes[k] != bytes_batch[k]  ||  memcmp(g722_data[k], g722_data_batch[k], bytes[k]))
+            {
+                printf("Batch encode mismatch - channel %d, block %d\n", k, block);
+                printf("Test failed\n");
+                exit(2);
+            }
+        }
+        /* Decode the same number of bytes for every channel */
+        for (k = 0;  k < BATCH_CHANNELS;  k++)
+        {
+            for (i = 0;  i < BLOCK_LEN/2;  i++)
+                g722_data[k][i] =
+                g722_data_batch[k][i] = (uint8_t) rand();
+            bytes[k] = g722_decode(dec[k], out[k], g722_data[k], BLOCK_LEN/2);
+        }
+        g722_decode_batch(dec_batch, out_ptrs, const_data_ptrs, BLOCK_LEN/2, bytes_batch, BATCH_CHANNELS);
+        for (k = 0;  k < BATCH_CHANNELS;  k++)
+        {
+            samples = bytes[k];
+            if (samples != bytes_batch[k]  ||  memcmp(out[k], out_batch[k], samples*sizeof(int16_t)))
+            {
+                printf("Batch decode mismatch - channel %d, block %d\n", k, block);
+                printf("Test failed\n");
+                exit(2);
+            }
+        }
+    }
+    for (k = 0;  k < BATCH_CHANNELS;  k++)
+    {
+        g722_encode_free(enc[k]);
+        g722_encode_free(enc_batch[k]);
+        g722_decode_free(dec[k]);
+        g722_decode_free(dec_batch[k]);
+    }
+    printf("Test passed\n");
+}
+/*- End of function --------------------------------------------------------*/
+
 int main(int argc, char *argv[])
 {
     g722_encode_state_t enc_state;
@@ -442,6 +535,9 @@ int main(int argc, char *argv[])
         }
     }
 
+    /* The batch tests need no test vectors, so they always run, before anything which
+       might stop for the lack of them. */
+    batch_tests();
     if (itutests)
     {
         itu_compliance_tests();
@@ -27,7 +27,9 @@
 
 /*! \page g726_tests_page G.726 tests
 \section g726_tests_page_sec_1 What does it do?
-Two sets of tests are performed:
+Three sets of tests are performed:
+    - A check that the multi-channel batch calls give exactly the same results as
+      handling each channel separately. This needs no test data, and is always run.
     - The tests defined in the G.726 specification, using the test data files supplied with
       the specification.
     - A generally audio quality test, consisting of compressing and decompressing a speeech
@@ -82,6 +84,7 @@ decompressed, and the resulting audio stored in post_g726.wav.
 
 #define BLOCK_LEN           320
 #define MAX_TEST_VECTOR_LEN 40000
+#define BATCH_CHANNELS      14
 
 #define TESTDATA_DIR    "../test-data/itu/g726/"
 
@@ -1215,6 +1218,103 @@ static void itu_compliance_tests(void)
 }
 /*- End of function --------------------------------------------------------*/
 
+static void batch_tests(void)
+{
+    g726_state_t *enc[BATCH_CHANNELS];
+    g726_state_t *dec[BATCH_CHANNELS];
+    g726_state_t *enc_batch[BATCH_CHANNELS];
+    g726_state_t *dec_batch[BATCH_CHANNELS];
+    int16_t amp[BATCH_CHANNELS][BLOCK_LEN];
+    uint8_t g726_data[BATCH_CHANNELS][BLOCK_LEN];
+    uint8_t g726_data_batch[BATCH_CHANNELS][BLOCK_LEN];
+    int16_t out[BATCH_CHANNELS][4*BLOCK_LEN];
+    int16_t out_batch[BATCH_CHANNELS][4*BLOCK_LEN];
+    const int16_t *amp_ptrs[BATCH_CHANNELS];
+    uint8_t *data_ptrs[BATCH_CHANNELS];
+    const uint8_t *const_data_ptrs[BATCH_CHANNELS];
+    int16_t *out_ptrs[BATCH_CHANNELS];
+    int bytes[BATCH_CHANNELS];
+    int bytes_batch[BATCH_CHANNELS];
+    int samples;
+    int rate;
+    int coding;
+    int packing;
+    int block;
+    int len;
+    int i;
+    int k;
+
+    /* The batch functions must give exactly the same results as handling the
+       channels one by one, with a mixture of bit rates, codings and packings. */
+    printf("Testing batch encoding and decoding\n");
+    for (k = 0;  k < BATCH_CHANNELS;  k++)
+    {
+        rate = (k < 6)  ?  32000  :  16000 + 8000*(k & 3);
+        coding = k%3;
+        packing = (k/3)%3;
+        enc[k] = g726_init(NULL, rate, coding, packing);
+        enc_batch[k] = g726_init(NULL, rate, coding, packing);
+        dec[k] = g726_init(NULL, rate, coding, packing);
+        dec_batch[k] = g726_init(NULL, rate, coding, packing);
+        amp_ptrs[k] = amp[k];
+        data_ptrs[k] = g726_data_batch[k];
+        const_data_ptrs[k] = g726_data_batch[k];
+        out_ptrs[k] = out_batch[k];
+    }
+    for (block = 0;  block < 200;  block++)
+    {
+        len = rand()%BLOCK_LEN;
+        for (k = 0;  k < BATCH_CHANNELS;  k++)
+        {
+            for (i = 0;  i < len;  i++)
+                amp[k][i] = (int16_t) rand();
+            bytes[k] = g726_encode(enc[k], g726_data[k], amp[k], len);
+        }
+        g726_encode_batch(enc_batch, data_ptrs, amp_ptrs, len, bytes_batch, BATCH_CHANNELS);
+        for (k = 0;  k < BATCH_CHANNELS;  k++)
+        {
+            if (bytes[k] != bytes_batch[k]  ||  memcmp(g726_data[k], g726_data_batch[k], bytes[k]))
+            {
+                printf("Batch encode mismatch - channel %d, block %d\n", k, block);
+                printf("Test failed\n");
+                exit(2);
+            }
+        }
+        /* Decode the same number of bytes for every channel. With different packings
+           this does not give the same number of samples for every channel. */
+        len = rand()%BLOCK_LEN;
+        for (k = 0;  k < BATCH_CHANNELS;  k++)
+        {
+            for (i = 0;  i < len;  i++)
+                g726_data[k][i] =
+                g726_data_batch[k][i] = (uint8_t) rand();
+            bytes[k] = g726_decode(dec[k], out[k], g726_data[k], len);
+        }
+        g726_decode_batch(dec_batch, out_ptrs, const_data_ptrs, len, bytes_batch, BATCH_CHANNELS);
+        for (k = 0;  k < BATCH_CHANNELS;  k++)
+        {
+            samples = bytes[k];
+            if (dec[k]->ext_coding == G726_ENCODING_LINEAR)
+                samples *= sizeof(int16_t);
+            if (bytes[k] != bytes_batch[k]  ||  memcmp(out[k], out_batch[k], samples))
+            {
+                printf("Batch decode mismatch - channel %d, block %d\n", k, block);
+                printf("Test failed\n");
+                exit(2);
+            }
+        }
+    }
+    for (k = 0;  k < BATCH_CHANNELS;  k++)
+    {
+        g726_free(enc[k]);
+        g726_free(enc_batch[k]);
+        g726_free(dec[k]);
+        g726_free(dec_batch[k]);
+    }
+    printf("Test passed\n");
+}
+/*- End of function --------------------------------------------------------*/
+
 int main(int argc, char *argv[])
 {
     g726_state_t enc_state;
@@ -1258,6 +1358,9 @@ int main(int argc, char *argv[])
         }
     }
 
+    /* The batch tests need no test vectors, so they always run, before anything which
+       might stop for the lack of them. */
+    batch_tests();
     if (itutests)
     {
         itu_compliance_tests();
@@ -121,6 +121,7 @@ will be compressed to GSM 06.10 data, decompressed, and the resulting audio stor
 #include <unistd.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
 #include <sndfile.h>
 
 //#if defined(WITH_SPANDSP_INTERNALS)
@@ -139,6 +140,11 @@ will be compressed to GSM 06.10 data, decompressed, and the resulting audio stor
 
 #define HIST_LEN        1000
 
+#define SPEED_TEST_FRAMES   50000
+
+#define BATCH_CHANNELS      6
+#define BATCH_FRAMES        8
+
 uint8_t law_in_vector[1000000];
 int16_t in_vector[1000000];
 uint16_t code_vector_buf[1000000];
@@ -514,6 +520,145 @@ static int perform_pack_unpack_test(void)
 }
 /*- End of function --------------------------------------------------------*/
 
+static int perform_batch_test(void)
+{
+    gsm0610_state_t *enc[BATCH_CHANNELS];
+    gsm0610_state_t *dec[BATCH_CHANNELS];
+    gsm0610_state_t *enc_batch[BATCH_CHANNELS];
+    gsm0610_state_t *dec_batch[BATCH_CHANNELS];
+    int16_t amp[BATCH_CHANNELS][BATCH_FRAMES*BLOCK_LEN];
+    uint8_t gsm0610_data[BATCH_CHANNELS][BATCH_FRAMES*76];
+    uint8_t gsm0610_data_batch[BATCH_CHANNELS][BATCH_FRAMES*76];
+    int16_t out[BATCH_CHANNELS][BATCH_FRAMES*BLOCK_LEN];
+    int16_t out_batch[BATCH_CHANNELS][BATCH_FRAMES*BLOCK_LEN];
+    const int16_t *amp_ptrs[BATCH_CHANNELS];
+    uint8_t *data_ptrs[BATCH_CHANNELS];
+    const uint8_t *const_data_ptrs[BATCH_CHANNELS];
+    int16_t *out_ptrs[BATCH_CHANNELS];
+    int bytes[BATCH_CHANNELS];
+    int bytes_batch[BATCH_CHANNELS];
+    int samples[BATCH_CHANNELS];
+    int samples_batch[BATCH_CHANNELS];
+    int packing;
+    int block;
+    int i;
+    int k;
+
+    /* The batch functions must give exactly the same results as handling the
+       channels one by one. A batch decode is given the same number of bytes for
+       every channel, so each pass uses a single packing for all the channels. */
+    printf("Performing batch tests (not part of the ETSI conformance tests).\n");
+    for (packing = GSM0610_PACKING_NONE;  packing <= GSM0610_PACKING_VOIP;  packing++)
+    {
+        for (k = 0;  k < BATCH_CHANNELS;  k++)
+        {
+            enc[k] = gsm0610_init(NULL, packing);
+            enc_batch[k] = gsm0610_init(NULL, packing);
+            dec[k] = gsm0610_init(NULL, packing);
+            dec_batch[k] = gsm0610_init(NULL, packing);
+            amp_ptrs[k] = amp[k];
+            data_ptrs[k] = gsm0610_data_batch[k];
+            const_data_ptrs[k] = gsm0610_data_batch[k];
+            out_ptrs[k] = out_batch[k];
+        }
+        for (block = 0;  block < 20;  block++)
+        {
+            for (k = 0;  k < BATCH_CHANNELS;  k++)
+            {
+                for (i = 0;  i < BATCH_FRAMES*BLOCK_LEN;  i++)
+                    amp[k][i] = (int16_t) ((rand() & 0x1FFF) - 0x1000);
+                bytes[k] = gsm0610_encode(enc[k], gsm0610_data[k], amp[k], BATCH_FRAMES*BLOCK_LEN);
+                samples[k] = gsm0610_decode(dec[k], out[k], gsm0610_data[k], bytes[k]);
+            }
+            gsm0610_encode_batch(enc_batch, data_ptrs, amp_ptrs, BATCH_FRAMES*BLOCK_LEN, bytes_batch, BATCH_CHANNELS);
+            for (k = 0;  k < BATCH_CHANNELS;  k++)
+            {
+                if (bytes[k] != bytes_batch[k]  ||  memcmp(gsm0610_data[k], gsm0610_data_batch[k], bytes[k]))
+                {
+                    printf("Test failed: batch encode mismatch - packing %d, channel %d, block %d\n", packing, k, block);
+                    exit(2);
+                }
+            }
+            gsm0610_decode_batch(dec_batch, out_ptrs, const_data_ptrs, bytes[0], samples_batch, BATCH_CHANNELS);
+            for (k = 0;  k < BATCH_CHANNELS;  k++)
+            {
+                if (samples[k] != samples_batch[k]  ||  memcmp(out[k], out_batch[k], samples[k]*sizeof(int16_t)))
+                {
+                    printf("Test failed: batch decode mismatch - packing %d, channel %d, block %d\n", packing, k, block);
+                    exit(2);
+                }
+            }
+        }
+        for (k = 0;  k < BATCH_CHANNELS;  k++)
+        {
+            gsm0610_free(enc[k]);
+            gsm0610_free(enc_batch[k]);
+            gsm0610_free(dec[k]);
+            gsm0610_free(dec_batch[k]);
+        }
+    }
+    printf("Test passed\n");
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void perform_speed_test(void)
+{
+    static int16_t amp[SPEED_TEST_FRAMES*BLOCK_LEN];
+    static uint8_t gsm0610_data[SPEED_TEST_FRAMES*33];
+    gsm0610_state_t *gsm0610_enc_state;
+    gsm0610_state_t *gsm0610_dec_state;
+    awgn_state_t noise_source;
+    clock_t start;
+    clock_t end;
+    double y1;
+    double y2;
+    double x;
+    int bytes;
+    int i;
+    int j;
+
+    printf("Performing speed tests (not part of the ETSI conformance tests).\n");
+    /* Something a bit like speech - noise through a wandering resonance, with a
+       wandering level */
+    awgn_init_dbm0(&noise_source, 1234567, -20.0f);
+    y1 = 0.0;
+    y2 = 0.0;
+    for (i = 0;  i < SPEED_TEST_FRAMES*BLOCK_LEN;  i++)
+    {
+        j = i/(25*BLOCK_LEN);
+        x = awgn(&noise_source)*(0.05 + (j%5)*0.1) + (1.0 + 0.8*(j%3 - 1)*0.5)*y1 - 0.85*y2;
+        y2 = y1;
+        y1 = x;
+        amp[i] = saturate(x);
+    }
+    if ((gsm0610_enc_state = gsm0610_init(NULL, GSM0610_PACKING_VOIP)) == NULL)
+    {
+        fprintf(stderr, "    Cannot create encoder\n");
+        exit(2);
+    }
+    if ((gsm0610_dec_state = gsm0610_init(NULL, GSM0610_PACKING_VOIP)) == NULL)
+    {
+        fprintf(stderr, "    Cannot create decoder\n");
+        exit(2);
+    }
+    start = clock();
+    bytes = gsm0610_encode(gsm0610_enc_state, gsm0610_data, amp, SPEED_TEST_FRAMES*BLOCK_LEN);
+    end = clock();
+    printf("Encoded %d frames at %.0f frames/second\n",
+           SPEED_TEST_FRAMES,
+           SPEED_TEST_FRAMES/((double) (end - start)/CLOCKS_PER_SEC + 1.0e-9));
+    start = clock();
+    gsm0610_decode(gsm0610_dec_state, amp, gsm0610_data, bytes);
+    end = clock();
+    printf("Decoded %d frames at %.0f frames/second\n",
+           SPEED_TEST_FRAMES,
+           SPEED_TEST_FRAMES/((double) (end - start)/CLOCKS_PER_SEC + 1.0e-9));
+    gsm0610_free(gsm0610_enc_state);
+    gsm0610_free(gsm0610_dec_state);
+}
+/*- End of function --------------------------------------------------------*/
+
 static void etsi_compliance_tests(void)
 {
     perform_linear_test(TRUE, 1, "Seq01");
@@ -533,6 +678,7 @@ static void etsi_compliance_tests(void)
     perform_law_test(FALSE, 'u', "Seq05");
     /* This is not actually an ETSI test */
     perform_pack_unpack_test();
+    perform_batch_test();
 
     printf("Tests passed.\n");
 }
@@ -552,11 +698,13 @@ int main(int argc, char *argv[])
     gsm0610_state_t *gsm0610_dec_state;
     int opt;
     int etsitests;
+    int speedtests;
     int packing;
 
     etsitests = TRUE;
+    speedtests = FALSE;
     packing = GSM0610_PACKING_NONE;
-    while ((opt = getopt(argc, argv, "lp:")) != -1)
+    while ((opt = getopt(argc, argv, "lp:s")) != -1)
     {
         switch (opt)
         {
@@ -566,13 +714,20 @@ int main(int argc, char *argv[])
         case 'p':
             packing = atoi(optarg);
             break;
+        case 's':
+            speedtests = TRUE;
+            break;
         default:
             //usage();
             exit(2);
         }
     }
 
-    if (etsitests)
+    if (speedtests)
+    {
+        perform_speed_test();
+    }
+    else if (etsitests)
     {
         etsi_compliance_tests();
     }
@@ -31,6 +31,8 @@
 \section lpc10_tests_page_sec_2 How is it used?
 To perform a general audio quality test, lpc10 should be run. The file ../test-data/local/short_nb_voice.wav
 will be compressed to LPC10 data, decompressed, and the resulting audio stored in post_lpc10.wav.
+Before that, the batch encode and decode calls are checked against the per-channel calls,
+using synthetic signals.
 */
 
 #if defined(HAVE_CONFIG_H)
@@ -44,6 +46,7 @@ will be compressed to LPC10 data, decompressed, and the resulting audio stored i
 #include <string.h>
 #include <assert.h>
 #include <ctype.h>
+#include <time.h>
 #include <sndfile.h>
 
 //#if defined(WITH_SPANDSP_INTERNALS)
@@ -63,6 +66,160 @@ will be compressed to LPC10 data, decompressed, and the resulting audio stored i
 #define DECOMPRESS_FILE_NAME    "lpc10_in.lpc10"
 #define OUT_FILE_NAME           "post_lpc10.wav"
 
+#define SPEED_TEST_FRAMES       20000
+
+#define BATCH_CHANNELS          4
+#define BATCH_FRAMES            5
+
+static void perform_speed_test(void)
+{
+    static int16_t amp[SPEED_TEST_FRAMES*BLOCK_LEN];
+    static uint8_t lpc10_data[SPEED_TEST_FRAMES*7];
+    lpc10_encode_state_t *lpc10_enc_state;
+    lpc10_decode_state_t *lpc10_dec_state;
+    awgn_state_t noise_source;
+    clock_t start;
+    clock_t end;
+    double y1;
+    double y2;
+    double x;
+    int bytes;
+    int i;
+    int j;
+
+    printf("Performing speed tests\n");
+    /* Something a bit like speech - noise through a wandering resonance, with a
+       wandering level */
+    awgn_init_dbm0(&noise_source, 1234567, -20.0f);
+    y1 = 0.0;
+    y2 = 0.0;
+    for (i = 0;  i < SPEED_TEST_FRAMES*BLOCK_LEN;  i++)
+    {
+        j = i/(25*BLOCK_LEN);
+        x = awgn(&noise_source)*(0.05 + (j%5)*0.1) + (1.0 + 0.8*(j%3 - 1)*0.5)*y1 - 0.85*y2;
+        y2 = y1;
+        y1 = x;
+        amp[i] = saturate(x);
+    }
+    if ((lpc10_enc_state = lpc10_encode_init(NULL, TRUE)) == NULL)
+    {
+        fprintf(stderr, "    Cannot create encoder\n");
+        exit(2);
+    }
+    if ((lpc10_dec_state = lpc10_decode_init(NULL, TRUE)) == NULL)
+    {
+        fprintf(stderr, "    Cannot create decoder\n");
+        exit(2);
+    }
+    start = clock();
+    bytes = lpc10_encode(lpc10_enc_state, lpc10_data, amp, SPEED_TEST_FRAMES*BLOCK_LEN);
+    end = clock();
+    printf("Encoded %d frames at %.0f frames/second\n",
+           SPEED_TEST_FRAMES,
+           SPEED_TEST_FRAMES/((double) (end - start)/CLOCKS_PER_SEC + 1.0e-9));
+    start = clock();
+    lpc10_decode(lpc10_dec_state, amp, lpc10_data, bytes);
+    end = clock();
+    printf("Decoded %d frames at %.0f frames/second\n",
+           SPEED_TEST_FRAMES,
+           SPEED_TEST_FRAMES/((double) (end - start)/CLOCKS_PER_SEC + 1.0e-9));
+    lpc10_encode_free(lpc10_enc_state);
+    lpc10_decode_free(lpc10_dec_state);
+}
+/*- End of function --------------------------------------------------------*/
+
+static int perform_batch_test(void)
+{
+    lpc10_encode_state_t *enc[BATCH_CHANNELS];
+    lpc10_encode_state_t *enc_batch[BATCH_CHANNELS];
+    lpc10_decode_state_t *dec[BATCH_CHANNELS];
+    lpc10_decode_state_t *dec_batch[BATCH_CHANNELS];
+    int16_t amp[BATCH_CHANNELS][BATCH_FRAMES*BLOCK_LEN];
+    uint8_t lpc10_data[BATCH_CHANNELS][BATCH_FRAMES*7];
+    uint8_t lpc10_data_batch[BATCH_CHANNELS][BATCH_FRAMES*7];
+    int16_t out[BATCH_CHANNELS][BATCH_FRAMES*BLOCK_LEN];
+    int16_t out_batch[BATCH_CHANNELS][BATCH_FRAMES*BLOCK_LEN];
+    const int16_t *amp_ptrs[BATCH_CHANNELS];
+    uint8_t *data_ptrs[BATCH_CHANNELS];
+    const uint8_t *const_data_ptrs[BATCH_CHANNELS];
+    int16_t *out_ptrs[BATCH_CHANNELS];
+    int bytes[BATCH_CHANNELS];
+    int bytes_batch[BATCH_CHANNELS];
+    int samples[BATCH_CHANNELS];
+    int samples_batch[BATCH_CHANNELS];
+    awgn_state_t noise_source[BATCH_CHANNELS];
+    double y1[BATCH_CHANNELS];
+    double y2[BATCH_CHANNELS];
+    double x;
+    int block;
+    int i;
+    int j;
+    int k;
+
+    /* The batch functions must give exactly the same results as handling the channels
+       one by one. Each channel gets its own speech-like signal, so a mix up between
+       channels, or between calls, would show. */
+    printf("Performing batch tests\n");
+    for (k = 0;  k < BATCH_CHANNELS;  k++)
+    {
+        enc[k] = lpc10_encode_init(NULL, TRUE);
+        enc_batch[k] = lpc10_encode_init(NULL, TRUE);
+        dec[k] = lpc10_decode_init(NULL, TRUE);
+        dec_batch[k] = lpc10_decode_init(NULL, TRUE);
+        amp_ptrs[k] = amp[k];
+        data_ptrs[k] = lpc10_data_batch[k];
+        const_data_ptrs[k] = lpc10_data_batch[k];
+        out_ptrs[k] = out_batch[k];
+        awgn_init_dbm0(&noise_source[k], 1234567 + k, -20.0f);
+        y1[k] = 0.0;
+        y2[k] = 0.0;
+    }
+    for (block = 0;  block < 20;  block++)
+    {
+        for (k = 0;  k < BATCH_CHANNELS;  k++)
+        {
+            j = block + k;
+            for (i = 0;  i < BATCH_FRAMES*BLOCK_LEN;  i++)
+            {
+                x = awgn(&noise_source[k])*(0.05 + (j%5)*0.1) + (1.0 + 0.8*(j%3 - 1)*0.5)*y1[k] - 0.85*y2[k];
+                y2[k] = y1[k];
+                y1[k] = x;
+                amp[k][i] = saturate(x);
+            }
+            bytes[k] = lpc10_encode(enc[k], lpc10_data[k], amp[k], BATCH_FRAMES*BLOCK_LEN);
+            samples[k] = lpc10_decode(dec[k], out[k], lpc10_data[k], bytes[k]);
+        }
+        lpc10_encode_batch(enc_batch, data_ptrs, amp_ptrs, BATCH_FRAMES*BLOCK_LEN, bytes_batch, BATCH_CHANNELS);
+        for (k = 0;  k < BATCH_CHANNELS;  k++)
+        {
+            if (bytes[k] != bytes_batch[k]  ||  memcmp(lpc10_data[k], lpc10_data_batch[k], bytes[k]))
+            {
+                printf("Test failed: batch encode mismatch - channel %d, block %d\n", k, block);
+                exit(2);
+            }
+        }
+        lpc10_decode_batch(dec_batch, out_ptrs, const_data_ptrs, bytes[0], samples_batch, BATCH_CHANNELS);
+        for (k = 0;  k < BATCH_CHANNELS;  k++)
+        {
+            if (samples[k] != samples_batch[k]  ||  memcmp(out[k], out_batch[k], samples[k]*sizeof(int16_t)))
+            {
+                printf("Test failed: batch decode mismatch - channel %d, block %d\n", k, block);
+                exit(2);
+            }
+        }
+    }
+    for (k = 0;  k < BATCH_CHANNELS;  k++)
+    {
+        lpc10_encode_free(enc[k]);
+        lpc10_encode_free(enc_batch[k]);
+        lpc10_decode_free(dec[k]);
+        lpc10_decode_free(dec_batch[k]);
+    }
+    printf("Test passed\n");
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
 int main(int argc, char *argv[])
 {
     SNDFILE *inhandle;
@@ -99,7 +256,7 @@ int main(int argc, char *argv[])
     decompress = FALSE;
     log_error = TRUE;
     in_file_name = IN_FILE_NAME;
-    while ((opt = getopt(argc, argv, "cdi:l")) != -1)
+    while ((opt = getopt(argc, argv, "cdi:ls")) != -1)
     {
         switch (opt)
         {
@@ -115,11 +272,16 @@ int main(int argc, char *argv[])
         case 'l':
             log_error = FALSE;
             break;
+        case 's':
+            perform_speed_test();
+            exit(0);
         default:
             //usage();
             exit(2);
         }
     }
+    /* This needs no test data, so it is always run. */
+    perform_batch_test();
 
     compress_file = -1;
     decompress_file = -1;
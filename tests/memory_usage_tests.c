@@ -0,0 +1,220 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * memory_usage_tests.c - Report the memory used by the larger contexts, in
+ *                        typical configurations.
+ *
+ * Written by Steve Underwood <steveu@coppice.org>
+ *
+ * Copyright (C) 2010 Steve Underwood
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+/*! \page memory_usage_tests_page Memory usage tests
+\section memory_usage_tests_page_sec_1 What does it do?
+FAX, T.38 gateway, T.31 and V.42bis contexts, and a T.4 transmit context if the ITU
+test document is available, are set up in typical configurations, and a table of the
+memory each one is using is printed. Each context is created from its own memory
+arena, and the figure reported by its memory usage function is checked against the
+memory actually taken from the arena. This catches buffers which a memory usage
+function fails to count.
+*/
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+//#if defined(WITH_SPANDSP_INTERNALS)
+#define SPANDSP_EXPOSE_INTERNAL_STRUCTURES
+//#endif
+
+#include "spandsp.h"
+
+#define IN_FILE_NAME        "../test-data/itu/fax/itutests.tif"
+
+#define ARENA_SIZE          (1024*1024)
+
+/* Each allocation from an arena may carry up to this much overhead, for its header
+   and for alignment. */
+#define ARENA_OVERHEAD      32
+/* The most separate allocations any of the contexts tested here makes. */
+#define MAX_ALLOCATIONS     8
+
+static uint8_t arena_buf[ARENA_SIZE];
+static span_arena_t arena;
+static int failures = 0;
+
+static int tx_packet_handler(t38_core_state_t *s, void *user_data, const uint8_t *buf, int len, int count)
+{
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int at_tx_handler(at_state_t *s, void *user_data, const uint8_t *buf, size_t len)
+{
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int modem_call_control(t31_state_t *s, void *user_data, int op, const char *num)
+{
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void v42bis_frame_handler(void *user_data, const uint8_t *buf, int len)
+{
+}
+/*- End of function --------------------------------------------------------*/
+
+static void v42bis_data_handler(void *user_data, const uint8_t *buf, int len)
+{
+}
+/*- End of function --------------------------------------------------------*/
+
+static void start_entry(void)
+{
+    span_arena_init(&arena, arena_buf, ARENA_SIZE);
+    span_arena_select(&arena);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void end_entry(const char *name, int reported, int freed)
+{
+    int used;
+
+    span_arena_select(NULL);
+    used = (int) span_arena_get_used(&arena);
+    printf("%-44s %9d %9d\n", name, reported, used);
+    /* Memory freed while the context was being set up stays taken from the arena, so
+       then only an upper bound can be checked. */
+    if (reported > used  ||  (!freed  &&  used - reported > ARENA_OVERHEAD*MAX_ALLOCATIONS))
+    {
+        printf("    Reported usage does not match the memory allocated\n");
+        failures++;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static void fax_entries(void)
+{
+    fax_state_t *fax;
+
+    start_entry();
+    fax = fax_init(NULL, TRUE);
+    end_entry("FAX, calling, idle", fax_get_memory_usage(fax), FALSE);
+
+    start_entry();
+    fax = fax_init(NULL, FALSE);
+    t30_set_tx_ident(fax_get_t30_state(fax), "+1 555 0123");
+    t30_set_tx_nsf(fax_get_t30_state(fax), (const uint8_t *) "\x50\x00\x00Spandsp NSF", 14);
+    t30_set_rx_file(fax_get_t30_state(fax), "memory_usage_tests.tif", -1);
+    end_entry("FAX, answering, with NSF and receive file", fax_get_memory_usage(fax), FALSE);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void t4_entries(void)
+{
+    t4_state_t *t4;
+
+    start_entry();
+    if ((t4 = t4_tx_init(NULL, IN_FILE_NAME, -1, -1)) == NULL)
+    {
+        span_arena_select(NULL);
+        printf("%-44s %9s %9s\n", "T.4 transmit, first page", "-", "-");
+        return;
+    }
+    t4_tx_start_page(t4);
+    while (t4_tx_get_bit(t4) != SIG_STATUS_END_OF_DATA)
+        ;
+    end_entry("T.4 transmit, first page", t4_tx_get_memory_usage(t4), FALSE);
+    /* The TIFF file must still be closed. */
+    t4_tx_free(t4);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void t38_gateway_entries(void)
+{
+    t38_gateway_state_t *t38;
+
+    start_entry();
+    t38 = t38_gateway_init(NULL, tx_packet_handler, NULL);
+    end_entry("T.38 gateway, modems always running", t38_gateway_get_memory_usage(t38), FALSE);
+
+    start_entry();
+    t38 = t38_gateway_init(NULL, tx_packet_handler, NULL);
+    t38_gateway_set_lazy_modems(t38, TRUE);
+    /* The modems are started by t38_gateway_init(), and freed again here. */
+    end_entry("T.38 gateway, lazy modems, voice phase", t38_gateway_get_memory_usage(t38), TRUE);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void t31_entries(void)
+{
+    t31_state_t *t31;
+    static const char *cmd = "AT+VSID=\"+1 555 0123\"\r";
+
+    start_entry();
+    t31 = t31_init(NULL, at_tx_handler, NULL, modem_call_control, NULL, NULL, NULL);
+    end_entry("T.31, idle", t31_get_memory_usage(t31), FALSE);
+
+    start_entry();
+    t31 = t31_init(NULL, at_tx_handler, NULL, modem_call_control, NULL, tx_packet_handler, NULL);
+    t31_at_rx(t31, cmd, strlen(cmd));
+    at_set_call_info(&t31->at_state, "NMBR", "5550123");
+    end_entry("T.31, T.38 mode, with caller ID", t31_get_memory_usage(t31), FALSE);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void v42bis_entries(void)
+{
+    v42bis_state_t *v42bis;
+
+    start_entry();
+    v42bis = v42bis_init(NULL, 3, 512, 6, v42bis_frame_handler, NULL, 512, v42bis_data_handler, NULL, 512);
+    end_entry("V.42bis, 512 codewords", v42bis_get_memory_usage(v42bis), FALSE);
+
+    start_entry();
+    v42bis = v42bis_init(NULL, 3, 4096, 250, v42bis_frame_handler, NULL, 512, v42bis_data_handler, NULL, 512);
+    end_entry("V.42bis, 4096 codewords", v42bis_get_memory_usage(v42bis), FALSE);
+}
+/*- End of function --------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    printf("%-44s %9s %9s\n", "Context", "Reported", "Allocated");
+    fax_entries();
+    t4_entries();
+    t38_gateway_entries();
+    t31_entries();
+    v42bis_entries();
+    if (failures)
+    {
+        printf("Tests failed.\n");
+        exit(2);
+    }
+    printf("Tests passed.\n");
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
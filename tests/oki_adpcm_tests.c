@@ -62,6 +62,188 @@ compression may be tested.
 
 #define HIST_LEN        1000
 
+#define BATCH_CHANNELS      6
+#define BATCH_BLOCKS        50
+
+#define SPEED_TEST_SAMPLES  800000
+#define SPEED_TEST_CHANNELS 4
+
+static void make_speech_like_signal(int16_t amp[], int len, int seed)
+{
+    awgn_state_t noise_source;
+    double y1;
+    double y2;
+    double x;
+    int i;
+    int j;
+
+    /* Something a bit like speech - noise through a wandering resonance, with a
+       wandering level */
+    awgn_init_dbm0(&noise_source, seed, -20.0f);
+    y1 = 0.0;
+    y2 = 0.0;
+    for (i = 0;  i < len;  i++)
+    {
+        j = i/4000;
+        x = awgn(&noise_source)*(0.05 + (j%5)*0.1) + (1.0 + 0.8*(j%3 - 1)*0.5)*y1 - 0.85*y2;
+        y2 = y1;
+        y1 = x;
+        amp[i] = saturate(x);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static int perform_batch_test(void)
+{
+    static int16_t amp[BATCH_CHANNELS][BATCH_BLOCKS*161];
+    static const int bit_rates[2] = {32000, 24000};
+    oki_adpcm_state_t *enc[BATCH_CHANNELS];
+    oki_adpcm_state_t *dec[BATCH_CHANNELS];
+    oki_adpcm_state_t *enc_batch[BATCH_CHANNELS];
+    oki_adpcm_state_t *dec_batch[BATCH_CHANNELS];
+    uint8_t oki_data[BATCH_CHANNELS][161];
+    uint8_t oki_data_batch[BATCH_CHANNELS][161];
+    int16_t out[BATCH_CHANNELS][4*161];
+    int16_t out_batch[BATCH_CHANNELS][4*161];
+    const int16_t *amp_ptrs[BATCH_CHANNELS];
+    uint8_t *data_ptrs[BATCH_CHANNELS];
+    const uint8_t *const_data_ptrs[BATCH_CHANNELS];
+    int16_t *out_ptrs[BATCH_CHANNELS];
+    int bytes[BATCH_CHANNELS];
+    int bytes_batch[BATCH_CHANNELS];
+    int samples[BATCH_CHANNELS];
+    int samples_batch[BATCH_CHANNELS];
+    int rate;
+    int block;
+    int len;
+    int n;
+    int k;
+
+    /* The batch functions must give exactly the same results as handling the
+       channels one by one. The block length wanders between odd and even values,
+       so channels are often left part way through a byte. */
+    printf("Performing batch tests\n");
+    for (k = 0;  k < BATCH_CHANNELS;  k++)
+        make_speech_like_signal(amp[k], BATCH_BLOCKS*161, 1234567 + k);
+    for (rate = 0;  rate < 2;  rate++)
+    {
+        for (k = 0;  k < BATCH_CHANNELS;  k++)
+        {
+            enc[k] = oki_adpcm_init(NULL, bit_rates[rate]);
+            enc_batch[k] = oki_adpcm_init(NULL, bit_rates[rate]);
+            dec[k] = oki_adpcm_init(NULL, bit_rates[rate]);
+            dec_batch[k] = oki_adpcm_init(NULL, bit_rates[rate]);
+            data_ptrs[k] = oki_data_batch[k];
+            const_data_ptrs[k] = oki_data_batch[k];
+            out_ptrs[k] = out_batch[k];
+        }
+        for (block = 0;  block < BATCH_BLOCKS;  block++)
+        {
+            len = 159 + block%3;
+            for (k = 0;  k < BATCH_CHANNELS;  k++)
+            {
+                amp_ptrs[k] = &amp[k][block*161];
+                bytes[k] = oki_adpcm_encode(enc[k], oki_data[k], amp_ptrs[k], len);
+            }
+            oki_adpcm_encode_batch(enc_batch, data_ptrs, amp_ptrs, len, bytes_batch, BATCH_CHANNELS);
+            for (k = 0;  k < BATCH_CHANNELS;  k++)
+            {
+                if (bytes[k] != bytes_batch[k]  ||  memcmp(oki_data[k], oki_data_batch[k], bytes[k]))
+                {
+                    printf("Test failed: batch encode mismatch - %d bps, channel %d, block %d\n", bit_rates[rate], k, block);
+                    exit(2);
+                }
+            }
+            /* A batch decode is given the same number of bytes for every channel */
+            n = bytes[0];
+            for (k = 1;  k < BATCH_CHANNELS;  k++)
+            {
+                if (bytes[k] < n)
+                    n = bytes[k];
+            }
+            for (k = 0;  k < BATCH_CHANNELS;  k++)
+                samples[k] = oki_adpcm_decode(dec[k], out[k], oki_data[k], n);
+            oki_adpcm_decode_batch(dec_batch, out_ptrs, const_data_ptrs, n, samples_batch, BATCH_CHANNELS);
+            for (k = 0;  k < BATCH_CHANNELS;  k++)
+            {
+                if (samples[k] != samples_batch[k]  ||  memcmp(out[k], out_batch[k], samples[k]*sizeof(int16_t)))
+                {
+                    printf("Test failed: batch decode mismatch - %d bps, channel %d, block %d\n", bit_rates[rate], k, block);
+                    exit(2);
+                }
+            }
+        }
+        for (k = 0;  k < BATCH_CHANNELS;  k++)
+        {
+            oki_adpcm_free(enc[k]);
+            oki_adpcm_free(enc_batch[k]);
+            oki_adpcm_free(dec[k]);
+            oki_adpcm_free(dec_batch[k]);
+        }
+    }
+    printf("Test passed\n");
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void perform_speed_test(int bit_rate)
+{
+    static int16_t amp[SPEED_TEST_CHANNELS][SPEED_TEST_SAMPLES + 16];
+    static uint8_t oki_data[SPEED_TEST_CHANNELS][SPEED_TEST_SAMPLES];
+    oki_adpcm_state_t *enc[SPEED_TEST_CHANNELS];
+    oki_adpcm_state_t *dec[SPEED_TEST_CHANNELS];
+    int16_t *amp_ptrs[SPEED_TEST_CHANNELS];
+    uint8_t *data_ptrs[SPEED_TEST_CHANNELS];
+    int bytes[SPEED_TEST_CHANNELS];
+    int samples[SPEED_TEST_CHANNELS];
+    clock_t start;
+    clock_t end;
+    int k;
+
+    printf("Performing speed tests\n");
+    for (k = 0;  k < SPEED_TEST_CHANNELS;  k++)
+    {
+        make_speech_like_signal(amp[k], SPEED_TEST_SAMPLES, 1234567 + k);
+        enc[k] = oki_adpcm_init(NULL, bit_rate);
+        dec[k] = oki_adpcm_init(NULL, bit_rate);
+        amp_ptrs[k] = amp[k];
+        data_ptrs[k] = oki_data[k];
+    }
+    start = clock();
+    bytes[0] = oki_adpcm_encode(enc[0], oki_data[0], amp[0], SPEED_TEST_SAMPLES);
+    end = clock();
+    printf("Encoded 1 channel at %.0f samples/second\n",
+           SPEED_TEST_SAMPLES/((double) (end - start)/CLOCKS_PER_SEC + 1.0e-9));
+    start = clock();
+    oki_adpcm_decode(dec[0], amp[0], oki_data[0], bytes[0]);
+    end = clock();
+    printf("Decoded 1 channel at %.0f samples/second\n",
+           SPEED_TEST_SAMPLES/((double) (end - start)/CLOCKS_PER_SEC + 1.0e-9));
+    for (k = 0;  k < SPEED_TEST_CHANNELS;  k++)
+    {
+        oki_adpcm_init(enc[k], bit_rate);
+        oki_adpcm_init(dec[k], bit_rate);
+    }
+    start = clock();
+    oki_adpcm_encode_batch(enc, data_ptrs, (const int16_t **) amp_ptrs, SPEED_TEST_SAMPLES, bytes, SPEED_TEST_CHANNELS);
+    end = clock();
+    printf("Batch encoded %d channels at %.0f samples/second\n",
+           SPEED_TEST_CHANNELS,
+           SPEED_TEST_CHANNELS*SPEED_TEST_SAMPLES/((double) (end - start)/CLOCKS_PER_SEC + 1.0e-9));
+    start = clock();
+    oki_adpcm_decode_batch(dec, amp_ptrs, (const uint8_t **) data_ptrs, bytes[0], samples, SPEED_TEST_CHANNELS);
+    end = clock();
+    printf("Batch decoded %d channels at %.0f samples/second\n",
+           SPEED_TEST_CHANNELS,
+           SPEED_TEST_CHANNELS*SPEED_TEST_SAMPLES/((double) (end - start)/CLOCKS_PER_SEC + 1.0e-9));
+    for (k = 0;  k < SPEED_TEST_CHANNELS;  k++)
+    {
+        oki_adpcm_free(enc[k]);
+        oki_adpcm_free(dec[k]);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
 int main(int argc, char *argv[])
 {
     int i;
@@ -94,13 +276,15 @@ int main(int argc, char *argv[])
     const char *encoded_file_name;
     const char *in_file_name;
     int log_encoded_data;
+    int speed_test;
     int opt;
 
     bit_rate = 32000;
     encoded_file_name = NULL;
     in_file_name = IN_FILE_NAME;
     log_encoded_data = FALSE;
-    while ((opt = getopt(argc, argv, "2d:i:l")) != -1)
+    speed_test = FALSE;
+    while ((opt = getopt(argc, argv, "2d:i:ls")) != -1)
     {
         switch (opt)
         {
@@ -116,6 +300,9 @@ int main(int argc, char *argv[])
         case 'l':
             log_encoded_data = TRUE;
             break;
+        case 's':
+            speed_test = TRUE;
+            break;
         default:
             //usage();
             exit(2);
@@ -123,6 +310,12 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (speed_test)
+    {
+        perform_speed_test(bit_rate);
+        exit(0);
+    }
+
     encoded_fd = -1;
     inhandle = NULL;
     oki_enc_state = NULL;
@@ -296,6 +489,8 @@ int main(int argc, char *argv[])
         exit(2);
     }
 
+    perform_batch_test();
+
     printf("Tests passed.\n");
     return 0;
 }
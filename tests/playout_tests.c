@@ -40,10 +40,12 @@ how well the playout module copes.
 
 #include "spandsp.h"
 #include "spandsp/private/time_scale.h"
+#include "spandsp/private/playout.h"
 #include "spandsp-sim.h"
 
 #define INPUT_FILE_NAME     "playout_in.wav"
 #define OUTPUT_FILE_NAME    "playout_out.wav"
+#define OUTPUT_AUDIO_FILE_NAME  "playout_audio_out.wav"
 
 #define BLOCK_LEN           160
 
@@ -326,12 +328,130 @@ static void static_buffer_tests(void)
 }
 /*- End of function --------------------------------------------------------*/
 
+static void adaptive_audio_tests(void)
+{
+    playout_audio_state_t *s;
+    int16_t amp[BLOCK_LEN];
+    int16_t out[BLOCK_LEN];
+    int16_t buf[2*BLOCK_LEN];
+    timestamp_t time_stamp;
+    timestamp_t next_actual_receive;
+    timestamp_t next_scheduled_receive;
+    timestamp_t length;
+    int near_far_time_offset;
+    int start;
+    int rng;
+    int i;
+    int j;
+    int inframes;
+    int outframes;
+    int blocks;
+    double total_length;
+    SNDFILE *inhandle;
+    SNDFILE *outhandle;
+
+    if ((inhandle = sf_open_telephony_read(INPUT_FILE_NAME, 1)) == NULL)
+    {
+        fprintf(stderr, "    Failed to open audio file '%s'\n", INPUT_FILE_NAME);
+        exit(2);
+    }
+    if ((outhandle = sf_open_telephony_write(OUTPUT_AUDIO_FILE_NAME, 2)) == NULL)
+    {
+        fprintf(stderr, "    Failed to create audio file '%s'\n", OUTPUT_AUDIO_FILE_NAME);
+        exit(2);
+    }
+
+    near_far_time_offset = 54321;
+    time_stamp = 12345;
+    next_actual_receive = time_stamp + near_far_time_offset;
+    next_scheduled_receive = next_actual_receive;
+    total_length = 0.0;
+    blocks = 0;
+
+    if ((s = playout_audio_init(NULL, SAMPLE_RATE, 0, 15*BLOCK_LEN)) == NULL)
+    {
+        fprintf(stderr, "    Failed to create the adaptive play-out context\n");
+        exit(2);
+    }
+    start = next_actual_receive;
+    for (i = start;  ;  i++)
+    {
+        if (i >= next_actual_receive)
+        {
+            if ((inframes = sf_readf_short(inhandle, amp, BLOCK_LEN)) < BLOCK_LEN)
+                break;
+            /* Lose about 1 frame in 100 */
+            if ((rand() % 100) != 0)
+                playout_audio_put(s, amp, inframes, time_stamp, next_actual_receive);
+            /* Vary the jitter, so the buffer must both grow and shrink */
+            rng = rand() & 0xFF;
+            if (i < start + 100000)
+                rng = (rng*rng) >> 7;
+            else if (i < start + 200000)
+                rng = (rng*rng) >> 6;
+            else
+                rng = (rng*rng) >> 8;
+            time_stamp += BLOCK_LEN;
+            next_actual_receive = time_stamp + near_far_time_offset + rng;
+        }
+        if (i >= next_scheduled_receive)
+        {
+            playout_audio_get(s, out, BLOCK_LEN, next_scheduled_receive);
+            length = playout_audio_current_length(s, next_scheduled_receive);
+            total_length += length;
+            blocks++;
+            for (j = 0;  j < BLOCK_LEN;  j++)
+            {
+                buf[2*j] = out[j];
+                buf[2*j + 1] = 10*length;
+            }
+            outframes = sf_writef_short(outhandle, buf, BLOCK_LEN);
+            if (outframes != BLOCK_LEN)
+            {
+                fprintf(stderr, "    Error writing out sound\n");
+                exit(2);
+            }
+            next_scheduled_receive += BLOCK_LEN;
+        }
+    }
+    if (sf_close(inhandle) != 0)
+    {
+        fprintf(stderr, "    Cannot close audio file '%s'\n", INPUT_FILE_NAME);
+        exit(2);
+    }
+    if (sf_close(outhandle) != 0)
+    {
+        fprintf(stderr, "    Cannot close audio file '%s'\n", OUTPUT_AUDIO_FILE_NAME);
+        exit(2);
+    }
+
+    printf("Frames in %d, late %d, samples concealed %d, inserted %d\n",
+           s->frames_in,
+           s->frames_late,
+           s->samples_concealed,
+           s->samples_inserted);
+    printf("Average buffer length %.1fms, final target %.1fms\n",
+           total_length*1000.0/(blocks*SAMPLE_RATE),
+           playout_audio_target_length(s)*1000.0/SAMPLE_RATE);
+    if (s->frames_late*100 > 5*s->frames_in)
+    {
+        printf("Too many frames arrived too late\n");
+        exit(2);
+    }
+    playout_audio_free(s);
+}
+/*- End of function --------------------------------------------------------*/
+
 int main(int argc, char *argv[])
 {
     printf("Dynamic buffering tests\n");
     dynamic_buffer_tests();
     printf("Static buffering tests\n");
     static_buffer_tests();
+    printf("Adaptive audio buffering tests\n");
+    adaptive_audio_tests();
+    printf("Tests passed.\n");
+    return 0;
 }
 /*- End of function --------------------------------------------------------*/
 /*- End of file ------------------------------------------------------------*/
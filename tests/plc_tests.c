@@ -37,7 +37,8 @@ dropped, to simulate packet loss. The rate of loss is also specified on the
 command line. The PLC module is then used to reconstruct an acceptable
 approximation to the original signal. The resulting audio is written to a new
 audio file, called post_plc.wav. This file contains 8000 sample/second
-16 bits/sample linear audio.
+16 bits/sample linear audio. The batch calls are then checked against the per-channel
+calls, and the pitch tracking is checked on signals whose pitch jumps.
 */
 
 #if defined(HAVE_CONFIG_H)
@@ -48,6 +49,7 @@ audio file, called post_plc.wav. This file contains 8000 sample/second
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
+#include <math.h>
 
 #include <sndfile.h>
 
@@ -57,6 +59,118 @@ audio file, called post_plc.wav. This file contains 8000 sample/second
 #define INPUT_FILE_NAME     "../test-data/local/short_nb_voice.wav"
 #define OUTPUT_FILE_NAME    "post_plc.wav"
 
+#define BATCH_CHANNELS      5
+
+static int perform_batch_test(int block_len, int loss_rate)
+{
+    plc_state_t *plc[BATCH_CHANNELS];
+    plc_state_t *plc_batch[BATCH_CHANNELS];
+    int16_t amp[BATCH_CHANNELS][1024];
+    int16_t amp_batch[BATCH_CHANNELS][1024];
+    int16_t *amp_ptrs[BATCH_CHANNELS];
+    uint32_t phase_acc[BATCH_CHANNELS];
+    int32_t phase_rate[BATCH_CHANNELS];
+    int block_no;
+    int dropit;
+    int i;
+    int k;
+
+    /* The batch calls must give exactly the same results as handling the channels
+       one by one. Whole blocks are lost on all the channels at once, as happens
+       when a congested link drops a burst of packets. */
+    printf("Performing batch tests\n");
+    for (k = 0;  k < BATCH_CHANNELS;  k++)
+    {
+        plc[k] = plc_init(NULL);
+        plc_batch[k] = plc_init(NULL);
+        amp_ptrs[k] = amp_batch[k];
+        phase_acc[k] = 0;
+        phase_rate[k] = dds_phase_ratef(150.0f + 70.0f*k);
+    }
+    for (block_no = 0;  block_no < 1000;  block_no++)
+    {
+        for (k = 0;  k < BATCH_CHANNELS;  k++)
+        {
+            for (i = 0;  i < block_len;  i++)
+                amp[k][i] = (int16_t) dds_modf(&phase_acc[k], phase_rate[k], 10000.0, 0);
+            memcpy(amp_batch[k], amp[k], sizeof(int16_t)*block_len);
+        }
+        dropit = rand()/(RAND_MAX/100);
+        for (k = 0;  k < BATCH_CHANNELS;  k++)
+        {
+            if (dropit > loss_rate)
+                plc_rx(plc[k], amp[k], block_len);
+            else
+                plc_fillin(plc[k], amp[k], block_len);
+        }
+        if (dropit > loss_rate)
+            plc_rx_batch(plc_batch, amp_ptrs, block_len, BATCH_CHANNELS);
+        else
+            plc_fillin_batch(plc_batch, amp_ptrs, block_len, BATCH_CHANNELS);
+        for (k = 0;  k < BATCH_CHANNELS;  k++)
+        {
+            if (memcmp(amp[k], amp_batch[k], sizeof(int16_t)*block_len))
+            {
+                printf("Test failed: batch mismatch - channel %d, block %d\n", k, block_no);
+                exit(2);
+            }
+        }
+    }
+    for (k = 0;  k < BATCH_CHANNELS;  k++)
+    {
+        plc_free(plc[k]);
+        plc_free(plc_batch[k]);
+    }
+    printf("Test passed\n");
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int perform_pitch_test(void)
+{
+    static const int periods[] = {61, 97, 67, 113, 0};
+    plc_state_t *plc;
+    int16_t amp[160];
+    int16_t cycle[PLC_PITCH_MIN];
+    int block_no;
+    int period;
+    int i;
+    int k;
+    int n;
+
+    /* The pitch is tracked as good blocks arrive. When it jumps to a new value, the
+       coarse sweep must find it within a few blocks. */
+    printf("Performing pitch tracking tests\n");
+    plc = plc_init(NULL);
+    n = 0;
+    for (k = 0;  (period = periods[k]);  k++)
+    {
+        /* A few harmonics of a fundamental with a whole number of samples per cycle */
+        for (i = 0;  i < period;  i++)
+        {
+            cycle[i] = (int16_t) (4000.0*sin(2.0*3.14159265*i/period)
+                                + 3000.0*sin(4.0*3.14159265*i/period + 1.0)
+                                + 2000.0*sin(6.0*3.14159265*i/period + 2.0));
+        }
+        for (block_no = 0;  block_no < 20;  block_no++)
+        {
+            for (i = 0;  i < 160;  i++)
+                amp[i] = cycle[n++%period];
+            plc_rx(plc, amp, 160);
+            if (block_no >= 10  &&  plc->pitch != period)
+            {
+                printf("Test failed: pitch %d, expected %d, after %d blocks\n", plc->pitch, period, block_no + 1);
+                exit(2);
+            }
+        }
+        printf("Pitch %d tracked\n", period);
+    }
+    plc_free(plc);
+    printf("Test passed\n");
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
 int main(int argc, char *argv[])
 {
     SNDFILE *inhandle;
@@ -176,6 +290,8 @@ int main(int argc, char *argv[])
         fprintf(stderr, "    Cannot close audio file '%s'\n", OUTPUT_FILE_NAME);
         exit(2);
     }
+    perform_batch_test(block_len, loss_rate);
+    perform_pitch_test();
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -49,6 +49,7 @@ These tests exercise the T.38 core ASN.1 processing code.
 
 #define MAX_FIELDS      42
 #define MAX_FIELD_LEN   8192
+#define MAX_BATCH_PACKETS   64
 
 int t38_version;
 int succeeded = TRUE;
@@ -66,6 +67,9 @@ int skip;
 uint8_t field_body[MAX_FIELDS][MAX_FIELD_LEN];
 int field_len[MAX_FIELDS];
 
+t38_rx_field_t recorded_field[MAX_BATCH_PACKETS*3];
+int recorded_fields;
+
 static int rx_missing_handler(t38_core_state_t *s, void *user_data, int rx_seq_no, int expected_seq_no)
 {
     missing_packets++;
@@ -232,6 +236,186 @@ static int encode_decode_tests(t38_core_state_t *a, t38_core_state_t *b)
 }
 /*- End of function --------------------------------------------------------*/
 
+static int record_missing_handler(t38_core_state_t *s, void *user_data, int rx_seq_no, int expected_seq_no)
+{
+    t38_rx_field_t *f;
+
+    f = &recorded_field[recorded_fields++];
+    f->type = T38_RX_FIELD_MISSING;
+    f->missing_from = rx_seq_no;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int record_indicator_handler(t38_core_state_t *s, void *user_data, int indicator)
+{
+    t38_rx_field_t *f;
+
+    f = &recorded_field[recorded_fields++];
+    f->type = T38_TYPE_OF_MSG_T30_INDICATOR;
+    f->indicator = indicator;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int record_data_handler(t38_core_state_t *s, void *user_data, int data_type, int field_type, const uint8_t *buf, int len)
+{
+    t38_rx_field_t *f;
+
+    f = &recorded_field[recorded_fields++];
+    f->type = T38_TYPE_OF_MSG_T30_DATA;
+    f->data_type = data_type;
+    f->field_type = field_type;
+    f->field = buf;
+    f->field_len = len;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int batch_tests(void)
+{
+    t38_core_state_t t38_core_tx;
+    t38_core_state_t t38_core_rx;
+    t38_core_state_t t38_core_ref;
+    t38_data_field_t field[3];
+    t38_ifp_packet_t pkt[MAX_BATCH_PACKETS];
+    t38_ifp_packet_t rx_pkt[MAX_BATCH_PACKETS];
+    t38_rx_field_t rx_field[MAX_BATCH_PACKETS*3];
+    uint8_t buf[MAX_BATCH_PACKETS*12];
+    int packets;
+    int rx_packets;
+    int fields;
+    int total_fields;
+    int taken;
+    int i;
+    int j;
+
+    printf("Batched transmit and receive tests\n");
+    t38_core_init(&t38_core_tx, rx_indicator_handler, rx_data_handler, rx_missing_handler, NULL, tx_packet_handler, NULL);
+    t38_core_init(&t38_core_rx, rx_indicator_handler, rx_data_handler, rx_missing_handler, NULL, tx_packet_handler, NULL);
+    t38_core_init(&t38_core_ref, record_indicator_handler, record_data_handler, record_missing_handler, NULL, tx_packet_handler, NULL);
+    t38_set_t38_version(&t38_core_tx, 1);
+    t38_set_t38_version(&t38_core_rx, 1);
+    t38_set_t38_version(&t38_core_ref, 1);
+    t38_set_redundancy_control(&t38_core_tx, T38_PACKET_CATEGORY_INDICATOR, 3);
+
+    /* Build a batch of packets into our own buffer, until it fills */
+    t38_core_start_tx_batch(&t38_core_tx, buf, sizeof(buf), pkt, MAX_BATCH_PACKETS);
+    for (i = 0;  ;  i++)
+    {
+        if ((i & 7) == 0)
+        {
+            if (t38_core_send_indicator(&t38_core_tx, (i & 8)  ?  T38_IND_V29_9600_TRAINING  :  T38_IND_V29_7200_TRAINING) < 0)
+                break;
+            continue;
+        }
+        for (j = 0;  j < (i % 3) + 1;  j++)
+        {
+            field[j].field_type = (j == 0)  ?  T38_FIELD_T4_NON_ECM_DATA  :  T38_FIELD_T4_NON_ECM_SIG_END;
+            field[j].field = field_body[j];
+            field[j].field_len = (i + j) & 7;
+        }
+        if (t38_core_send_data_multi_field(&t38_core_tx, T38_DATA_V29_9600, field, (i % 3) + 1, T38_PACKET_CATEGORY_IMAGE_DATA) < 0)
+            break;
+    }
+    packets = t38_core_end_tx_batch(&t38_core_tx);
+    printf("%d packets built in a %d byte buffer\n", packets, (int) sizeof(buf));
+    if (packets < MAX_BATCH_PACKETS/2)
+        return -1;
+    for (i = 0;  i < packets;  i++)
+    {
+        if (pkt[i].seq_no != i
+            ||
+            pkt[i].buf < buf
+            ||
+            pkt[i].buf + pkt[i].len > buf + sizeof(buf)
+            ||
+            pkt[i].count != ((pkt[i].buf[0] & 0x40)  ?  1  :  3))
+        {
+            printf("Bad packet %d\n", i);
+            return -1;
+        }
+    }
+
+    /* Receive them with a repeat, a late packet, and a gap, through the batched and
+       the callback interfaces, and check they agree. */
+    rx_packets = 0;
+    for (i = 0;  i < packets;  i++)
+    {
+        if (i == 20)
+            continue;
+        rx_pkt[rx_packets++] = pkt[i];
+        if (i == 10)
+            rx_pkt[rx_packets++] = pkt[i];
+        if (i == 30)
+            rx_pkt[rx_packets++] = pkt[i - 5];
+    }
+    recorded_fields = 0;
+    for (i = 0;  i < rx_packets;  i++)
+        t38_core_rx_ifp_packet(&t38_core_ref, rx_pkt[i].buf, rx_pkt[i].len, (uint16_t) rx_pkt[i].seq_no);
+    /* Use a short field list, so the batch is taken in several parts */
+    total_fields = 0;
+    for (i = 0;  i < rx_packets;  i += taken)
+    {
+        taken = t38_core_rx_ifp_packets(&t38_core_rx, &rx_pkt[i], rx_packets - i, &rx_field[total_fields], 7, &fields);
+        if (taken <= 0)
+        {
+            printf("Batch receive stalled\n");
+            return -1;
+        }
+        for (j = 0;  j < fields;  j++)
+            rx_field[total_fields + j].packet += i;
+        total_fields += fields;
+    }
+    printf("%d packets gave %d fields\n", rx_packets, total_fields);
+    if (total_fields != recorded_fields)
+        return -1;
+    for (i = 0;  i < total_fields;  i++)
+    {
+        if (rx_field[i].type != recorded_field[i].type
+            ||
+            rx_field[i].seq_no != rx_pkt[rx_field[i].packet].seq_no)
+        {
+            printf("Field %d does not match\n", i);
+            return -1;
+        }
+        switch (rx_field[i].type)
+        {
+        case T38_RX_FIELD_MISSING:
+            if (rx_field[i].missing_from != recorded_field[i].missing_from)
+                return -1;
+            break;
+        case T38_TYPE_OF_MSG_T30_INDICATOR:
+            if (rx_field[i].indicator != recorded_field[i].indicator)
+                return -1;
+            break;
+        default:
+            if (rx_field[i].data_type != recorded_field[i].data_type
+                ||
+                rx_field[i].field_type != recorded_field[i].field_type
+                ||
+                rx_field[i].field != recorded_field[i].field
+                ||
+                rx_field[i].field_len != recorded_field[i].field_len)
+            {
+                return -1;
+            }
+            break;
+        }
+    }
+    if (t38_core_rx.missing_packets != t38_core_ref.missing_packets
+        ||
+        t38_core_rx.rx_expected_seq_no != t38_core_ref.rx_expected_seq_no
+        ||
+        t38_core_rx.current_rx_data_type != t38_core_ref.current_rx_data_type)
+    {
+        printf("Context states do not match\n");
+        return -1;
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
 static int attack_tests(t38_core_state_t *s)
 {
     return 0;
@@ -289,6 +473,11 @@ int main(int argc, char *argv[])
             exit(2);
         }
     }
+    if (batch_tests())
+    {
+        printf("Batch tests failed\n");
+        exit(2);
+    }
     if (!succeeded)
     {
         printf("Tests failed\n");
@@ -43,7 +43,6 @@
 #include <unistd.h>
 #endif
 
-#include "udptl.h"
 #include "spandsp.h"
 
 #include "fax_utils.h"
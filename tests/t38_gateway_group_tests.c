@@ -0,0 +1,450 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * t38_gateway_group_tests.c - Tests for the T.38 gateway session group driver.
+ *
+ * Written by Steve Underwood <steveu@coppice.org>
+ *
+ * Copyright (C) 2010 Steve Underwood
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+/*! \page t38_gateway_group_tests_page T.38 gateway session group tests
+\section t38_gateway_group_tests_page_sec_1 What does it do?
+Two session groups are connected back to back through T.38, session to session, with
+the sessions spread over a few destinations. The V.21 HDLC preamble is fed to one
+session of one group, and it is checked that only that session, and its partner in the
+other group, start their modems. It is also checked that the packets handed over for a
+destination all belong to it, that there is at most one handover per destination per
+tick, and that session slots are reused properly.
+
+The number of session ticks per second is then measured, for sessions receiving a
+V.21 HDLC signal, first with each session driven separately and sending each T.38
+packet as it is produced, and then with the sessions in one group. Finally one group,
+pinned to its own core, is run on each core at once.
+*/
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+//#if defined(WITH_SPANDSP_INTERNALS)
+#define SPANDSP_EXPOSE_INTERNAL_STRUCTURES
+//#endif
+
+#include "spandsp.h"
+
+#define SAMPLES_PER_TICK        160
+#define TEST_SESSIONS           8
+#define TEST_DESTINATIONS       3
+#define TEST_SESSION            5
+#define BENCHMARK_SESSIONS      64
+#define BENCHMARK_DESTINATIONS  4
+#define BENCHMARK_TICKS         500
+#define SIGNAL_TICKS            150
+#define MAX_THREADS             16
+
+typedef struct
+{
+    t38_gateway_group_state_t *group;
+    t38_gateway_group_state_t *far_group;
+    int seq_no[TEST_SESSIONS];
+    int handovers[TEST_DESTINATIONS];
+    int bad;
+} test_side_t;
+
+static test_side_t side[2];
+
+/* A few seconds of V.21 HDLC, rendered once and replayed by the benchmarks */
+static int16_t v21_signal[SIGNAL_TICKS*SAMPLES_PER_TICK];
+
+static int handler_calls;
+static int packets_sent;
+
+static double wall_clock(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec/1000000.0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int group_tx_handler(void *user_data, int dest, const t38_gateway_group_packet_t pkt[], int packets)
+{
+    test_side_t *s;
+    int session;
+    int i;
+
+    s = (test_side_t *) user_data;
+    s->handovers[dest]++;
+    if (packets <= 0)
+        s->bad++;
+    for (i = 0;  i < packets;  i++)
+    {
+        /* Session n was added with destination n%TEST_DESTINATIONS, and talks to session n
+           of the far group. */
+        session = pkt[i].session;
+        if (session%TEST_DESTINATIONS != dest)
+        {
+            s->bad++;
+            continue;
+        }
+        t38_gateway_group_rx_ifp_packet(s->far_group, session, pkt[i].buf, pkt[i].len, s->seq_no[session]);
+        s->seq_no[session] = (s->seq_no[session] + 1) & 0xFFFF;
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void hdlc_underflow_handler(void *user_data)
+{
+    static const uint8_t frame[] =
+    {
+        0xFF, 0x13, 0x80, 0x00, 0xEE, 0xF8, 0x80, 0x80, 0x91, 0x80, 0x80, 0x80, 0x18, 0x78, 0x57, 0x10
+    };
+
+    hdlc_tx_frame((hdlc_tx_state_t *) user_data, frame, sizeof(frame));
+}
+/*- End of function --------------------------------------------------------*/
+
+static void make_v21_signal(void)
+{
+    hdlc_tx_state_t hdlc;
+    fsk_tx_state_t fsk;
+
+    hdlc_tx_init(&hdlc, FALSE, 2, FALSE, hdlc_underflow_handler, &hdlc);
+    hdlc_tx_flags(&hdlc, 40);
+    fsk_tx_init(&fsk, &preset_fsk_specs[FSK_V21CH2], (get_bit_func_t) hdlc_tx_get_bit, &hdlc);
+    fsk_tx(&fsk, v21_signal, SIGNAL_TICKS*SAMPLES_PER_TICK);
+}
+/*- End of function --------------------------------------------------------*/
+
+static int back_to_back_tests(void)
+{
+    int16_t rx_amp[TEST_SESSIONS*SAMPLES_PER_TICK];
+    int16_t tx_amp[TEST_SESSIONS*SAMPLES_PER_TICK];
+    t38_gateway_state_t *gw;
+    int handovers[2][TEST_DESTINATIONS];
+    int ticks;
+    int i;
+    int j;
+    int k;
+    int n;
+
+    printf("Back to back session group tests\n");
+    memset(side, 0, sizeof(side));
+    for (j = 0;  j < 2;  j++)
+    {
+        if ((side[j].group = t38_gateway_group_init(NULL, TEST_SESSIONS, TEST_DESTINATIONS, group_tx_handler, &side[j])) == NULL)
+        {
+            printf("Cannot create session group\n");
+            return -1;
+        }
+    }
+    side[0].far_group = side[1].group;
+    side[1].far_group = side[0].group;
+    for (j = 0;  j < 2;  j++)
+    {
+        for (i = 0;  i < TEST_SESSIONS;  i++)
+        {
+            if (t38_gateway_group_add_session(side[j].group, i%TEST_DESTINATIONS) != i)
+            {
+                printf("Session %d not added in order\n", i);
+                return -1;
+            }
+            gw = t38_gateway_group_get_gateway(side[j].group, i);
+            t38_gateway_set_lazy_modems(gw, TRUE);
+        }
+        if (t38_gateway_group_add_session(side[j].group, 0) >= 0)
+        {
+            printf("Session added to a full group\n");
+            return -1;
+        }
+    }
+
+    /* Quiet noise for everyone, except the V.21 preamble and frames to one session of the first group */
+    ticks = 0;
+    for (n = 0;  n < SIGNAL_TICKS;  n++)
+    {
+        for (j = 0;  j < 2;  j++)
+        {
+            for (i = 0;  i < TEST_SESSIONS*SAMPLES_PER_TICK;  i++)
+                rx_amp[i] = (rand() & 0x3F) - 0x20;
+            if (j == 0)
+                memcpy(&rx_amp[TEST_SESSION*SAMPLES_PER_TICK], &v21_signal[n*SAMPLES_PER_TICK], SAMPLES_PER_TICK*sizeof(int16_t));
+            memcpy(handovers[j], side[j].handovers, sizeof(handovers[j]));
+            if (t38_gateway_group_tick(side[j].group, rx_amp, tx_amp, SAMPLES_PER_TICK) != TEST_SESSIONS)
+            {
+                printf("Not all sessions processed\n");
+                return -1;
+            }
+            for (k = 0;  k < TEST_DESTINATIONS;  k++)
+            {
+                if (side[j].handovers[k] - handovers[j][k] > 1)
+                {
+                    printf("More than one handover for a destination in a tick\n");
+                    return -1;
+                }
+            }
+        }
+        ticks++;
+    }
+    for (j = 0;  j < 2;  j++)
+    {
+        for (i = 0;  i < TEST_SESSIONS;  i++)
+        {
+            gw = t38_gateway_group_get_gateway(side[j].group, i);
+            if (t38_gateway_get_modems_active(gw) != (i == TEST_SESSION))
+            {
+                printf("Group %d session %d modems %s\n", j, i, (i == TEST_SESSION)  ?  "not started"  :  "started");
+                return -1;
+            }
+        }
+        printf("Group %d: %d ticks, handovers per destination %d %d %d, bad packets %d\n",
+               j,
+               ticks,
+               side[j].handovers[0],
+               side[j].handovers[1],
+               side[j].handovers[2],
+               side[j].bad);
+        if (side[j].bad)
+            return -1;
+    }
+    if (side[0].handovers[TEST_SESSION%TEST_DESTINATIONS] == 0  ||  side[1].handovers[TEST_SESSION%TEST_DESTINATIONS] == 0)
+    {
+        printf("No T.38 packets exchanged\n");
+        return -1;
+    }
+
+    /* Free a slot, and check it is reused, and silent while it is free */
+    if (t38_gateway_group_remove_session(side[0].group, 2)
+        ||
+        t38_gateway_group_remove_session(side[0].group, 2) == 0
+        ||
+        t38_gateway_group_get_gateway(side[0].group, 2)
+        ||
+        t38_gateway_group_get_sessions(side[0].group) != TEST_SESSIONS - 1)
+    {
+        printf("Session removal failed\n");
+        return -1;
+    }
+    for (i = 0;  i < TEST_SESSIONS*SAMPLES_PER_TICK;  i++)
+        tx_amp[i] = 0x1234;
+    if (t38_gateway_group_tick(side[0].group, NULL, tx_amp, SAMPLES_PER_TICK) != TEST_SESSIONS - 1)
+    {
+        printf("Wrong number of sessions processed\n");
+        return -1;
+    }
+    for (i = 2*SAMPLES_PER_TICK;  i < 3*SAMPLES_PER_TICK;  i++)
+    {
+        if (tx_amp[i])
+        {
+            printf("Free slot not silent\n");
+            return -1;
+        }
+    }
+    if (t38_gateway_group_add_session(side[0].group, 1) != 2
+        ||
+        t38_gateway_group_set_destination(side[0].group, 2, TEST_DESTINATIONS) == 0
+        ||
+        t38_gateway_group_set_destination(side[0].group, 2, 2))
+    {
+        printf("Session slot not reused\n");
+        return -1;
+    }
+    t38_gateway_group_free(side[0].group);
+    t38_gateway_group_free(side[1].group);
+    printf("Back to back session group tests OK\n");
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int single_tx_handler(t38_core_state_t *s, void *user_data, const uint8_t *buf, int len, int count)
+{
+    handler_calls++;
+    packets_sent++;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int bench_tx_handler(void *user_data, int dest, const t38_gateway_group_packet_t pkt[], int packets)
+{
+    handler_calls++;
+    packets_sent += packets;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void fill_rx_block(int16_t rx_amp[], int sessions, int tick)
+{
+    int i;
+
+    /* Stagger the sessions through the signal, so they are not all in step */
+    for (i = 0;  i < sessions;  i++)
+        memcpy(&rx_amp[i*SAMPLES_PER_TICK], &v21_signal[((tick + i*7)%SIGNAL_TICKS)*SAMPLES_PER_TICK], SAMPLES_PER_TICK*sizeof(int16_t));
+}
+/*- End of function --------------------------------------------------------*/
+
+static double separate_sessions_benchmark(void)
+{
+    static int16_t rx_amp[BENCHMARK_SESSIONS*SAMPLES_PER_TICK];
+    static int16_t tx_amp[BENCHMARK_SESSIONS*SAMPLES_PER_TICK];
+    t38_gateway_state_t *gw[BENCHMARK_SESSIONS];
+    double start;
+    double duration;
+    int i;
+    int n;
+
+    for (i = 0;  i < BENCHMARK_SESSIONS;  i++)
+        gw[i] = t38_gateway_init(NULL, single_tx_handler, NULL);
+    handler_calls = 0;
+    packets_sent = 0;
+    start = wall_clock();
+    for (n = 0;  n < BENCHMARK_TICKS;  n++)
+    {
+        fill_rx_block(rx_amp, BENCHMARK_SESSIONS, n);
+        for (i = 0;  i < BENCHMARK_SESSIONS;  i++)
+        {
+            t38_gateway_rx(gw[i], &rx_amp[i*SAMPLES_PER_TICK], SAMPLES_PER_TICK);
+            t38_gateway_tx(gw[i], &tx_amp[i*SAMPLES_PER_TICK], SAMPLES_PER_TICK);
+        }
+    }
+    duration = wall_clock() - start;
+    for (i = 0;  i < BENCHMARK_SESSIONS;  i++)
+        t38_gateway_free(gw[i]);
+    printf("Separate sessions: %d sessions, %.0f session ticks/s, %d packets, %d handler calls\n",
+           BENCHMARK_SESSIONS,
+           BENCHMARK_SESSIONS*BENCHMARK_TICKS/duration,
+           packets_sent,
+           handler_calls);
+    return BENCHMARK_SESSIONS*BENCHMARK_TICKS/duration;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void *group_benchmark_thread(void *user_data)
+{
+    static int16_t rx_amp[MAX_THREADS][BENCHMARK_SESSIONS*SAMPLES_PER_TICK];
+    static int16_t tx_amp[MAX_THREADS][BENCHMARK_SESSIONS*SAMPLES_PER_TICK];
+    t38_gateway_group_state_t *group;
+    intptr_t cpu;
+    int n;
+
+    cpu = (intptr_t) user_data;
+    /* Bind before the sessions are added, so their memory is local to the core */
+    group = t38_gateway_group_init(NULL, BENCHMARK_SESSIONS, BENCHMARK_DESTINATIONS, bench_tx_handler, NULL);
+    if (cpu >= 0)
+        t38_gateway_group_bind_to_cpu(group, cpu);
+    for (n = 0;  n < BENCHMARK_SESSIONS;  n++)
+        t38_gateway_group_add_session(group, n%BENCHMARK_DESTINATIONS);
+    for (n = 0;  n < BENCHMARK_TICKS;  n++)
+    {
+        fill_rx_block(rx_amp[cpu & (MAX_THREADS - 1)], BENCHMARK_SESSIONS, n);
+        t38_gateway_group_tick(group, rx_amp[cpu & (MAX_THREADS - 1)], tx_amp[cpu & (MAX_THREADS - 1)], SAMPLES_PER_TICK);
+    }
+    t38_gateway_group_free(group);
+    return NULL;
+}
+/*- End of function --------------------------------------------------------*/
+
+static double group_benchmark(void)
+{
+    double start;
+    double duration;
+
+    handler_calls = 0;
+    packets_sent = 0;
+    start = wall_clock();
+    group_benchmark_thread((void *) (intptr_t) -1);
+    duration = wall_clock() - start;
+    printf("One group: %d sessions, %.0f session ticks/s, %d packets, %d handler calls\n",
+           BENCHMARK_SESSIONS,
+           BENCHMARK_SESSIONS*BENCHMARK_TICKS/duration,
+           packets_sent,
+           handler_calls);
+    return BENCHMARK_SESSIONS*BENCHMARK_TICKS/duration;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void multi_core_benchmark(int cores)
+{
+    pthread_t thread[MAX_THREADS];
+    double start;
+    double duration;
+    intptr_t i;
+
+    if (cores > MAX_THREADS)
+        cores = MAX_THREADS;
+    start = wall_clock();
+    for (i = 0;  i < cores;  i++)
+        pthread_create(&thread[i], NULL, group_benchmark_thread, (void *) i);
+    for (i = 0;  i < cores;  i++)
+        pthread_join(thread[i], NULL);
+    duration = wall_clock() - start;
+    printf("%d groups, one per core: %d sessions, %.0f session ticks/s\n",
+           cores,
+           cores*BENCHMARK_SESSIONS,
+           cores*BENCHMARK_SESSIONS*BENCHMARK_TICKS/duration);
+}
+/*- End of function --------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    int cores;
+    int opt;
+    int benchmark;
+
+    benchmark = TRUE;
+    while ((opt = getopt(argc, argv, "q")) != -1)
+    {
+        switch (opt)
+        {
+        case 'q':
+            benchmark = FALSE;
+            break;
+        default:
+            //usage();
+            exit(2);
+        }
+    }
+    make_v21_signal();
+    if (back_to_back_tests())
+    {
+        printf("Tests failed\n");
+        exit(2);
+    }
+    if (benchmark)
+    {
+        separate_sessions_benchmark();
+        group_benchmark();
+        cores = sysconf(_SC_NPROCESSORS_ONLN);
+        multi_core_benchmark((cores > 0)  ?  cores  :  1);
+    }
+    printf("Tests passed\n");
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
@@ -243,6 +243,7 @@ int main(int argc, char *argv[])
     double rx_when;
     int supported_modems;
     int fill_removal;
+    int lazy_modems;
     int use_gui;
     int opt;
     int drop_frame;
@@ -262,6 +263,7 @@ int main(int argc, char *argv[])
     g1050_model_no = 0;
     g1050_speed_pattern_no = 1;
     fill_removal = FALSE;
+    lazy_modems = FALSE;
     use_gui = FALSE;
     use_tep = FALSE;
     feedback_audio = FALSE;
@@ -269,7 +271,7 @@ int main(int argc, char *argv[])
     supported_modems = T30_SUPPORT_V27TER | T30_SUPPORT_V29 | T30_SUPPORT_V17;
     drop_frame = 0;
     drop_frame_rate = 0;
-    while ((opt = getopt(argc, argv, "D:efFgi:Ilm:M:s:tv:")) != -1)
+    while ((opt = getopt(argc, argv, "D:efFgi:IlLm:M:s:tv:")) != -1)
     {
         switch (opt)
         {
@@ -303,6 +305,9 @@ int main(int argc, char *argv[])
         case 'l':
             log_audio = TRUE;
             break;
+        case 'L':
+            lazy_modems = TRUE;
+            break;
         case 'm':
             supported_modems = atoi(optarg);
             break;
@@ -397,6 +402,7 @@ int main(int argc, char *argv[])
     t38_gateway_set_supported_modems(t38, supported_modems);
     //t38_gateway_set_nsx_suppression(t38, NULL, 0, NULL, 0);
     t38_gateway_set_fill_bit_removal(t38, fill_removal);
+    t38_gateway_set_lazy_modems(t38, lazy_modems);
     t38_gateway_set_real_time_frame_handler(t38, real_time_frame_handler, NULL);
     t38_set_t38_version(t38_core, t38_version);
     t38_gateway_set_ecm_capability(t38, use_ecm);
@@ -421,6 +427,7 @@ int main(int argc, char *argv[])
     t38_gateway_set_supported_modems(t38, supported_modems);
     //t38_gateway_set_nsx_suppression(t38, FALSE);
     t38_gateway_set_fill_bit_removal(t38, fill_removal);
+    t38_gateway_set_lazy_modems(t38, lazy_modems);
     t38_set_t38_version(t38_core, t38_version);
     t38_gateway_set_ecm_capability(t38, use_ecm);
 
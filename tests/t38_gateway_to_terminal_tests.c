@@ -255,7 +255,7 @@ static int decode_test(const char *decode_test_file)
     span_log_set_level(logging, SPAN_LOG_DEBUG | SPAN_LOG_SHOW_TAG | SPAN_LOG_SHOW_SAMPLE_TIME);
     span_log_set_tag(logging, "T.38-A");
 
-    logging = &t38_state_a->audio.modems.v17_rx.logging;
+    logging = &t38_state_a->audio.modems->v17_rx.logging;
     span_log_set_level(logging, SPAN_LOG_DEBUG | SPAN_LOG_SHOW_TAG | SPAN_LOG_SHOW_SAMPLE_TIME);
     span_log_set_tag(logging, "V.17-A");
 
@@ -305,7 +305,7 @@ static int decode_test(const char *decode_test_file)
         t38_core = t38_gateway_get_t38_core_state(t38_state_a);
         logging = t38_core_get_logging_state(t38_core);
         span_log_bump_samples(logging, t30_len_a);
-        logging = &t38_state_a->audio.modems.v17_rx.logging;
+        logging = &t38_state_a->audio.modems->v17_rx.logging;
         span_log_bump_samples(logging, t30_len_a);
 
         logging = t38_terminal_get_logging_state(t38_state_b);
@@ -540,7 +540,7 @@ int main(int argc, char *argv[])
     span_log_set_level(logging, SPAN_LOG_DEBUG | SPAN_LOG_SHOW_TAG | SPAN_LOG_SHOW_SAMPLE_TIME);
     span_log_set_tag(logging, "T.38-A");
 
-    logging = &t38_state_a->audio.modems.v17_rx.logging;
+    logging = &t38_state_a->audio.modems->v17_rx.logging;
     span_log_set_level(logging, SPAN_LOG_DEBUG | SPAN_LOG_SHOW_TAG | SPAN_LOG_SHOW_SAMPLE_TIME);
     span_log_set_tag(logging, "V.17-A");
 
@@ -594,7 +594,7 @@ int main(int argc, char *argv[])
         t38_core = t38_gateway_get_t38_core_state(t38_state_a);
         logging = t38_core_get_logging_state(t38_core);
         span_log_bump_samples(logging, SAMPLES_PER_CHUNK);
-        logging = &t38_state_a->audio.modems.v17_rx.logging;
+        logging = &t38_state_a->audio.modems->v17_rx.logging;
         span_log_bump_samples(logging, SAMPLES_PER_CHUNK);
 
         logging = t38_terminal_get_logging_state(t38_state_b);
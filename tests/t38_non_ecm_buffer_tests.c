@@ -41,6 +41,7 @@ module, used for T.38 gateways.
 #include <string.h>
 #include <assert.h>
 #include <errno.h>
+#include <time.h>
 
 //#if defined(WITH_SPANDSP_INTERNALS)
 #define SPANDSP_EXPOSE_INTERNAL_STRUCTURES
@@ -74,6 +75,12 @@ static const uint8_t spreader[] =
 
 static int bit_no;
 
+#define CHUNK_TEST_OCTETS   8000
+
+static uint8_t image[CHUNK_TEST_OCTETS];
+static uint8_t bit_out[2*CHUNK_TEST_OCTETS];
+static uint8_t chunk_out[2*CHUNK_TEST_OCTETS];
+
 static int xxx(t38_non_ecm_buffer_state_t *s, logging_state_t *l, int log_bits, int n, int expected)
 {
     int i;
@@ -130,6 +137,192 @@ static int xxx(t38_non_ecm_buffer_state_t *s, logging_state_t *l, int log_bits,
 }
 /*- End of function --------------------------------------------------------*/
 
+static int make_image(void)
+{
+    int len;
+    int row;
+    int i;
+
+    /* Rows of random data, each followed by an EOL, with an RTC at the end */
+    len = 0;
+    while (len < CHUNK_TEST_OCTETS - 100)
+    {
+        row = 1 + rand()%60;
+        for (i = 0;  i < row;  i++)
+            image[len++] = (uint8_t) rand();
+        image[len++] = 0x00;
+        image[len++] = 0x01;
+    }
+    for (i = 0;  i < 3;  i++)
+    {
+        image[len++] = 0x00;
+        image[len++] = 0x10;
+        image[len++] = 0x01;
+    }
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int drain_by_bits(t38_non_ecm_buffer_state_t *s, uint8_t out[])
+{
+    int len;
+    int bit;
+    int octet;
+    int i;
+
+    for (len = 0;  len < 2*CHUNK_TEST_OCTETS;  len++)
+    {
+        octet = 0;
+        for (i = 0;  i < 8;  i++)
+        {
+            if ((bit = t38_non_ecm_buffer_get_bit((void *) s)) < 0)
+                return len;
+            octet = (octet << 1) | bit;
+        }
+        out[len] = (uint8_t) octet;
+    }
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int drain_by_chunks(t38_non_ecm_buffer_state_t *s, uint8_t out[], int max_chunk)
+{
+    int len;
+    int chunk;
+    int n;
+
+    for (len = 0;  len < 2*CHUNK_TEST_OCTETS;  len += n)
+    {
+        chunk = 1 + rand()%max_chunk;
+        if (chunk > 2*CHUNK_TEST_OCTETS - len)
+            chunk = 2*CHUNK_TEST_OCTETS - len;
+        if ((n = t38_non_ecm_buffer_get_chunk((void *) s, &out[len], chunk)) < chunk)
+            return len + n;
+    }
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void chunk_tests(void)
+{
+    t38_non_ecm_buffer_state_t bit_buffer;
+    t38_non_ecm_buffer_state_t chunk_buffer;
+    clock_t start;
+    int image_len;
+    int bit_len;
+    int chunk_len;
+    int block;
+    int i;
+    int j;
+    int n;
+
+    printf("8 - Chunks match bits\n");
+    for (j = 0;  j < 20;  j++)
+    {
+        image_len = make_image();
+        t38_non_ecm_buffer_init(&bit_buffer, TRUE, (j & 1)  ?  400  :  0);
+        t38_non_ecm_buffer_init(&chunk_buffer, TRUE, (j & 1)  ?  400  :  0);
+        /* Some fill from the empty buffers first */
+        drain_by_bits(&bit_buffer, bit_out);
+        t38_non_ecm_buffer_get_chunk((void *) &chunk_buffer, chunk_out, 7);
+        for (i = 0;  i < image_len;  i++)
+            t38_non_ecm_buffer_inject(&bit_buffer, &image[i], 1);
+        for (i = 0;  i < image_len;  i += n)
+        {
+            n = 1 + rand()%300;
+            if (n > image_len - i)
+                n = image_len - i;
+            t38_non_ecm_buffer_inject(&chunk_buffer, &image[i], n);
+        }
+        t38_non_ecm_buffer_push(&bit_buffer);
+        t38_non_ecm_buffer_push(&chunk_buffer);
+        bit_len = drain_by_bits(&bit_buffer, bit_out);
+        chunk_len = drain_by_chunks(&chunk_buffer, chunk_out, 200);
+        if (bit_len != chunk_len  ||  memcmp(bit_out, chunk_out, bit_len))
+        {
+            printf("Tests failed - %d octets by bits, %d octets by chunks\n", bit_len, chunk_len);
+            exit(2);
+        }
+    }
+    printf("    Chunks match bits OK\n");
+
+    printf("9 - Bits and chunks speed\n");
+    image_len = make_image();
+    for (block = 0;  block < 2;  block++)
+    {
+        start = clock();
+        for (j = 0;  j < 1000;  j++)
+        {
+            t38_non_ecm_buffer_init(&bit_buffer, TRUE, 400);
+            t38_non_ecm_buffer_inject(&bit_buffer, image, image_len);
+            t38_non_ecm_buffer_push(&bit_buffer);
+            if (block)
+                drain_by_chunks(&bit_buffer, bit_out, 200);
+            else
+                drain_by_bits(&bit_buffer, bit_out);
+        }
+        printf("    %s: %.1fns per octet\n",
+               (block)  ?  "Chunks"  :  "Bits",
+               1.0e9*(clock() - start)/CLOCKS_PER_SEC/(1000.0*image_len));
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static void wrap_tests(void)
+{
+    t38_non_ecm_buffer_state_t ref_buffer;
+    t38_non_ecm_buffer_state_t block_buffer;
+    uint8_t row[64];
+    int block;
+    int ref_len;
+    int block_len;
+    int total;
+    int i;
+    int j;
+    int k;
+
+    printf("10 - Ring buffer wrapping with block injection\n");
+    /* Rows whose octets never allow an EOL take the word at a time path. Blocks of
+       every size from 1 to 9 octets give every alignment of that path against the
+       end of the ring, so the ring must wrap correctly in each case. */
+    for (block = 1;  block <= 9;  block++)
+    {
+        t38_non_ecm_buffer_init(&ref_buffer, TRUE, 0);
+        t38_non_ecm_buffer_init(&block_buffer, TRUE, 0);
+        for (total = 0;  total < 3*T38_NON_ECM_TX_BUF_LEN;  total += sizeof(row))
+        {
+            for (i = 0;  i < sizeof(row) - 2;  i++)
+                row[i] = (uint8_t) (rand() | 0x01);
+            row[i++] = 0x00;
+            row[i++] = 0x01;
+            for (i = 0;  i < sizeof(row);  i += k)
+            {
+                k = block;
+                if (k > sizeof(row) - i)
+                    k = sizeof(row) - i;
+                for (j = 0;  j < k;  j++)
+                    t38_non_ecm_buffer_inject(&ref_buffer, &row[i + j], 1);
+                t38_non_ecm_buffer_inject(&block_buffer, &row[i], k);
+                if (block_buffer.in_ptr >= T38_NON_ECM_TX_BUF_LEN)
+                {
+                    printf("Tests failed - input pointer %d is outside the buffer\n", block_buffer.in_ptr);
+                    exit(2);
+                }
+                /* Drain as much as was put in, so the buffer wraps without overflowing */
+                ref_len = t38_non_ecm_buffer_get_chunk((void *) &ref_buffer, bit_out, k);
+                block_len = t38_non_ecm_buffer_get_chunk((void *) &block_buffer, chunk_out, k);
+                if (ref_len != block_len  ||  memcmp(bit_out, chunk_out, ref_len))
+                {
+                    printf("Tests failed - output differs with %d octet blocks\n", block);
+                    exit(2);
+                }
+            }
+        }
+    }
+    printf("    Ring buffer wrapping OK\n");
+}
+/*- End of function --------------------------------------------------------*/
+
 int main(int argc, char *argv[])
 {
     t38_non_ecm_buffer_state_t buffer;
@@ -698,6 +891,9 @@ int main(int argc, char *argv[])
     t38_non_ecm_buffer_report_input_status(&buffer, &logging);
     t38_non_ecm_buffer_report_output_status(&buffer, &logging);
 
+    chunk_tests();
+    wrap_tests();
+
     printf("Tests passed\n");
     return  0;
 }
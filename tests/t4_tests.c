@@ -28,7 +28,9 @@
 /*! \page t4_tests_page T.4 tests
 \section t4_tests_page_sec_1 What does it do
 These tests exercise the image compression and decompression methods defined
-in ITU specifications T.4 and T.6.
+in ITU specifications T.4 and T.6. They also check that the receiver resizes
+its run buffers when a page is a few pixels wider than the last, but still
+needs the same number of bytes per row.
 */
 
 #if defined(HAVE_CONFIG_H)
@@ -275,6 +277,32 @@ static int detect_page_end(int bit, int page_ended)
 }
 /*- End of function --------------------------------------------------------*/
 
+static void rx_width_change_tests(void)
+{
+    /* 1724 and 1728 pixels both need 216 bytes per row, but 1728 pixels need more
+       run space. */
+    if (t4_rx_init(&receive_state, OUT_FILE_NAME, T4_COMPRESSION_ITU_T4_2D) == NULL)
+    {
+        printf("Failed to init T.4 rx\n");
+        exit(2);
+    }
+    t4_rx_set_rx_encoding(&receive_state, T4_COMPRESSION_ITU_T4_2D);
+    t4_rx_set_image_width(&receive_state, XSIZE - 4);
+    t4_rx_start_page(&receive_state);
+    t4_rx_end_page(&receive_state);
+    t4_rx_set_image_width(&receive_state, XSIZE);
+    t4_rx_start_page(&receive_state);
+    if (receive_state.run_space < (XSIZE + 4)*(int) sizeof(uint32_t))
+    {
+        printf("Test failed: %d bytes of run space for a %d pixel row\n", receive_state.run_space, XSIZE);
+        exit(2);
+    }
+    t4_rx_end_page(&receive_state);
+    t4_rx_release(&receive_state);
+    printf("Width change tests passed\n");
+}
+/*- End of function --------------------------------------------------------*/
+
 int main(int argc, char *argv[])
 {
     static const int compression_sequence[] =
@@ -402,6 +430,9 @@ int main(int argc, char *argv[])
     memset(&send_state, 0, sizeof(send_state));
     memset(&receive_state, 0, sizeof(receive_state));
 
+    rx_width_change_tests();
+    memset(&receive_state, 0, sizeof(receive_state));
+
     end_of_page = FALSE;
     if (decode_file_name)
     {
@@ -42,6 +42,7 @@ This file also contains 8000 sample/second 16 bits/sample linear audio.
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
+#include <inttypes.h>
 #include <sndfile.h>
 
 #include "spandsp.h"
@@ -53,6 +54,123 @@ This file also contains 8000 sample/second 16 bits/sample linear audio.
 #define IN_FILE_NAME    "../test-data/local/short_nb_voice.wav"
 #define OUT_FILE_NAME   "time_scale_result.wav"
 
+#define MAX_TEST_SAMPLES    (30*TIME_SCALE_MAX_SAMPLE_RATE)
+#define BATCH_CHANNELS      3
+
+static int16_t test_amp[MAX_TEST_SAMPLES];
+
+static int read_test_file(const char *name, int *sample_rate)
+{
+    SNDFILE *handle;
+    SF_INFO info;
+    int len;
+
+    memset(&info, 0, sizeof(info));
+    if ((handle = sf_open(name, SFM_READ, &info)) == NULL)
+    {
+        printf("    Cannot open audio file '%s'\n", name);
+        exit(2);
+    }
+    if (info.channels != 1)
+    {
+        printf("    Unexpected number of channels in audio file '%s'\n", name);
+        exit(2);
+    }
+    *sample_rate = info.samplerate;
+    len = sf_readf_short(handle, test_amp, MAX_TEST_SAMPLES);
+    if (sf_close(handle) != 0)
+    {
+        printf("    Cannot close audio file '%s'\n", name);
+        exit(2);
+    }
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void perform_speed_test(const char *name)
+{
+    static const float rates[4] = {0.8f, 0.9f, 1.1f, 1.25f};
+    time_scale_state_t state;
+    int16_t out[5*(TIME_SCALE_MAX_SAMPLE_RATE/50 + TIME_SCALE_MAX_SAMPLE_RATE/TIME_SCALE_MIN_PITCH)];
+    uint64_t start;
+    uint64_t end;
+    int sample_rate;
+    int block_len;
+    int frames;
+    int len;
+    int i;
+    int j;
+
+    len = read_test_file(name, &sample_rate);
+    /* Time the scaling of 20ms blocks, as used for jitter buffer playout */
+    block_len = sample_rate/50;
+    frames = len/block_len;
+    printf("Performing speed tests, at %d samples/second\n", sample_rate);
+    for (j = 0;  j < 4;  j++)
+    {
+        time_scale_init(&state, sample_rate, rates[j]);
+        start = rdtscll();
+        for (i = 0;  i < frames;  i++)
+            time_scale(&state, out, &test_amp[i*block_len], block_len);
+        end = rdtscll();
+        printf("Rate %.2f: %" PRIu64 " ticks per 20ms frame\n", rates[j], (end - start)/frames);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static int perform_batch_test(const char *name)
+{
+    time_scale_state_t *state[BATCH_CHANNELS];
+    time_scale_state_t *state_batch[BATCH_CHANNELS];
+    int16_t out[BATCH_CHANNELS][5*(BLOCK_LEN + TIME_SCALE_MAX_SAMPLE_RATE/TIME_SCALE_MIN_PITCH)];
+    int16_t out_batch[BATCH_CHANNELS][5*(BLOCK_LEN + TIME_SCALE_MAX_SAMPLE_RATE/TIME_SCALE_MIN_PITCH)];
+    int16_t *in_ptrs[BATCH_CHANNELS];
+    int16_t *out_ptrs[BATCH_CHANNELS];
+    int out_len[BATCH_CHANNELS];
+    int out_len_batch[BATCH_CHANNELS];
+    int sample_rate;
+    int len;
+    int i;
+    int k;
+
+    /* The batch call must give exactly the same results as handling the channels
+       one by one. Each channel plays the file at a different rate, starting at a
+       different point. */
+    printf("Performing batch tests\n");
+    len = read_test_file(name, &sample_rate);
+    for (k = 0;  k < BATCH_CHANNELS;  k++)
+    {
+        state[k] = time_scale_init(NULL, sample_rate, 0.7f + 0.3f*k);
+        state_batch[k] = time_scale_init(NULL, sample_rate, 0.7f + 0.3f*k);
+        out_ptrs[k] = out_batch[k];
+    }
+    for (i = 0;  i + (BATCH_CHANNELS + 1)*BLOCK_LEN <= len;  i += BLOCK_LEN)
+    {
+        for (k = 0;  k < BATCH_CHANNELS;  k++)
+        {
+            in_ptrs[k] = &test_amp[i + k*BLOCK_LEN];
+            out_len[k] = time_scale(state[k], out[k], in_ptrs[k], BLOCK_LEN);
+        }
+        time_scale_batch(state_batch, out_ptrs, in_ptrs, BLOCK_LEN, out_len_batch, BATCH_CHANNELS);
+        for (k = 0;  k < BATCH_CHANNELS;  k++)
+        {
+            if (out_len[k] != out_len_batch[k]  ||  memcmp(out[k], out_batch[k], sizeof(int16_t)*out_len[k]))
+            {
+                printf("Test failed: batch mismatch - channel %d, sample %d\n", k, i);
+                exit(2);
+            }
+        }
+    }
+    for (k = 0;  k < BATCH_CHANNELS;  k++)
+    {
+        time_scale_free(state[k]);
+        time_scale_free(state_batch[k]);
+    }
+    printf("Test passed\n");
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
 int main(int argc, char *argv[])
 {
     SNDFILE *inhandle;
@@ -70,15 +188,20 @@ int main(int argc, char *argv[])
     float sample_rate;
     const char *in_file_name;
     int sweep_rate;
+    int speed_test;
     int opt;
 
     rate = 1.8f;
     sweep_rate = FALSE;
+    speed_test = FALSE;
     in_file_name = IN_FILE_NAME;
-    while ((opt = getopt(argc, argv, "i:r:s")) != -1)
+    while ((opt = getopt(argc, argv, "bi:r:s")) != -1)
     {
         switch (opt)
         {
+        case 'b':
+            speed_test = TRUE;
+            break;
         case 'i':
             in_file_name = optarg;
             break;
@@ -94,6 +217,11 @@ int main(int argc, char *argv[])
             break;
         }
     }
+    if (speed_test)
+    {
+        perform_speed_test(in_file_name);
+        exit(0);
+    }
     if ((inhandle = sf_open(in_file_name, SFM_READ, &info)) == NULL)
     {
         printf("    Cannot open audio file '%s'\n", in_file_name);
@@ -161,6 +289,7 @@ int main(int argc, char *argv[])
         printf("    Cannot close audio file '%s'\n", OUT_FILE_NAME);
         exit(2);
     }
+    perform_batch_test(in_file_name);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
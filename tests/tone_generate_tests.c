@@ -47,6 +47,149 @@
 
 #define OUTPUT_FILE_NAME    "tone_generate.wav"
 
+#define SHARED_CHANNELS     3
+#define SHARED_FRAME_LEN    160
+
+static int test_shared_tone(const tone_gen_descriptor_t *tone_desc, int frames, int step, int listen, int rejoin)
+{
+    tone_gen_state_t tone_state[SHARED_CHANNELS];
+    tone_gen_shared_t *shared;
+    const int16_t *frame;
+    int16_t amp[SHARED_FRAME_LEN];
+    int16_t heard[SHARED_CHANNELS][SHARED_FRAME_LEN];
+    int subscribed[SHARED_CHANNELS];
+    int i;
+    int j;
+    int k;
+    int len;
+    int shared_len;
+
+    /* Each channel runs its own private generator alongside the shared source, as it
+       would without one. Whenever a channel is subscribed, the samples it takes from
+       the shared frame must match its own render. Channels drop out and come back, so
+       some ticks have nobody listening. */
+    for (k = 0;  k < SHARED_CHANNELS;  k++)
+    {
+        tone_gen_init(&tone_state[k], tone_desc);
+        subscribed[k] = FALSE;
+    }
+    if ((shared = tone_gen_shared_init(NULL, tone_desc, SHARED_FRAME_LEN)) == NULL)
+    {
+        printf("    Cannot create shared tone source\n");
+        return -1;
+    }
+    for (i = 0;  i < frames;  i++)
+    {
+        for (k = 0;  k < SHARED_CHANNELS;  k++)
+        {
+            /* Channel k listens for a while from frame step*k, then drops out until
+               the rejoin frame, and listens from then on. */
+            if (!subscribed[k]  &&  (i == step*k  ||  i == rejoin))
+            {
+                subscribed[k] = TRUE;
+                if (tone_gen_shared_subscribe(shared) == 1  &&  i > 0)
+                {
+                    /* Nothing was rendered while nobody listened, so the frame must
+                       be silent until the next tick. */
+                    frame = tone_gen_shared_frame(shared, &shared_len);
+                    for (j = 0;  j < SHARED_FRAME_LEN;  j++)
+                    {
+                        if (shared_len != 0  ||  frame[j] != 0)
+                        {
+                            printf("    Stale samples after resubscribing at frame %d\n", i);
+                            return -1;
+                        }
+                    }
+                }
+            }
+            else if (subscribed[k]  &&  i == step*k + listen)
+            {
+                subscribed[k] = FALSE;
+                tone_gen_shared_unsubscribe(shared);
+            }
+        }
+        len = tone_gen_shared_tick(shared);
+        for (k = 0;  k < SHARED_CHANNELS;  k++)
+        {
+            shared_len = tone_gen(&tone_state[k], amp, SHARED_FRAME_LEN);
+            if (shared_len != len)
+            {
+                printf("    Bad length at frame %d - %d %d\n", i, len, shared_len);
+                return -1;
+            }
+            if (!subscribed[k])
+                continue;
+            if (shared_len < SHARED_FRAME_LEN)
+                memset(&amp[shared_len], 0, sizeof(int16_t)*(SHARED_FRAME_LEN - shared_len));
+            frame = tone_gen_shared_frame(shared, &shared_len);
+            memcpy(heard[k], frame, sizeof(int16_t)*SHARED_FRAME_LEN);
+            if (shared_len != len  ||  memcmp(heard[k], amp, sizeof(int16_t)*SHARED_FRAME_LEN))
+            {
+                for (j = 0;  j < SHARED_FRAME_LEN  &&  heard[k][j] == amp[j];  j++)
+                    ;
+                printf("    Mismatch for channel %d at frame %d, sample %d - %d %d\n", k, i, j, heard[k][j], amp[j]);
+                return -1;
+            }
+        }
+    }
+    tone_gen_shared_free(shared);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int test_shared_source(void)
+{
+    tone_gen_descriptor_t tone_desc;
+    tone_gen_shared_t *shared;
+
+    /* A shared source must give each subscriber exactly what a private generator
+       would, including after a period with nobody listening. */
+    printf("Shared tone source tests.\n");
+    if ((shared = tone_gen_shared_init(NULL, NULL, 0)) != NULL)
+    {
+        printf("    Shared tone source created with no frame\n");
+        return -1;
+    }
+    tone_gen_descriptor_init(&tone_desc,
+                             425,
+                             -10,
+                             0,
+                             0,
+                             330,
+                             170,
+                             230,
+                             270,
+                             TRUE);
+    shared = tone_gen_shared_init(NULL, &tone_desc, SHARED_FRAME_LEN);
+    tone_gen_shared_subscribe(shared);
+    if (tone_gen_shared_subscribe(shared) != 2  ||  tone_gen_shared_unsubscribe(shared) != 1)
+    {
+        printf("    Bad subscriber count\n");
+        return -1;
+    }
+    tone_gen_shared_free(shared);
+    /* A repeating cadence. The last frame before everyone drops out holds tone. */
+    if (test_shared_tone(&tone_desc, 1000, 100, 210, 700))
+        return -1;
+    /* A tone pair which ends part way through a frame, and is followed by silence.
+       Everyone drops out just after it ends. */
+    tone_gen_descriptor_init(&tone_desc,
+                             350,
+                             -10,
+                             440,
+                             -15,
+                             1010,
+                             0,
+                             0,
+                             0,
+                             FALSE);
+    if (test_shared_tone(&tone_desc, 100, 0, 51, 55))
+        return -1;
+    printf("    OK\n");
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
 int main(int argc, char *argv[])
 {
     tone_gen_descriptor_t tone_desc;
@@ -57,6 +200,12 @@ int main(int argc, char *argv[])
     SNDFILE *outhandle;
     int outframes;
 
+    if (test_shared_source())
+    {
+        printf("Test failed.\n");
+        exit(2);
+    }
+
     if ((outhandle = sf_open_telephony_write(OUTPUT_FILE_NAME, 1)) == NULL)
     {
         fprintf(stderr, "    Cannot open audio file '%s'\n", OUTPUT_FILE_NAME);
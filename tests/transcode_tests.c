@@ -0,0 +1,466 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * transcode_tests.c - Test the offline transcoding module, and measure its
+ *                     throughput.
+ *
+ * Written by Steve Underwood <steveu@coppice.org>
+ *
+ * Copyright (C) 2010 Steve Underwood
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+/*! \page transcode_tests_page Offline transcoding tests
+\section transcode_tests_page_sec_1 What does it do?
+An archive of recordings is synthesised, and converted to the input format. It is then
+transcoded to the output format twice - once a job at a time in the calling thread,
+and once using a pool of worker threads. The two sets of output must be identical.
+The throughput of both, in hours of audio converted per second, is reported.
+
+By default every combination of formats is checked, with a small archive. A single
+combination may be selected with the -i and -o options, and the size of the archive
+and the number of threads set with the -f, -l and -t options, to measure throughput.
+Raw files of 16 bit linear audio may be given on the command line, to be used in place
+of the synthesised recordings.
+
+\section transcode_tests_page_sec_2 How is it used?
+*/
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/time.h>
+
+//#if defined(WITH_SPANDSP_INTERNALS)
+#define SPANDSP_EXPOSE_INTERNAL_STRUCTURES
+//#endif
+
+#include "spandsp.h"
+
+/* Long enough for jobs which can be split to be split */
+#define MATRIX_TEST_SECONDS     75
+
+typedef struct
+{
+    const char *name;
+    transcode_format_t format;
+} format_desc_t;
+
+static const format_desc_t formats[] =
+{
+    {"linear",      {TRANSCODE_FORMAT_LINEAR, 0, 0, 0}},
+    {"alaw",        {TRANSCODE_FORMAT_ALAW, 0, 0, 0}},
+    {"ulaw",        {TRANSCODE_FORMAT_ULAW, 0, 0, 0}},
+    {"g722",        {TRANSCODE_FORMAT_G722, 64000, 0, 0}},
+    {"g722-48",     {TRANSCODE_FORMAT_G722, 48000, G722_PACKED, 0}},
+    {"g726",        {TRANSCODE_FORMAT_G726, 32000, G726_PACKING_NONE, 0}},
+    {"g726-16",     {TRANSCODE_FORMAT_G726, 16000, G726_PACKING_LEFT, 0}},
+    {"gsm",         {TRANSCODE_FORMAT_GSM0610, 0, GSM0610_PACKING_VOIP, 0}},
+    {"gsm-wav49",   {TRANSCODE_FORMAT_GSM0610, 0, GSM0610_PACKING_WAV49, 0}},
+    {"ima",         {TRANSCODE_FORMAT_IMA_ADPCM, 0, IMA_ADPCM_DVI4, 0}},
+    {"ima-wav",     {TRANSCODE_FORMAT_IMA_ADPCM, 0, IMA_ADPCM_IMA4, 505}},
+    {"oki",         {TRANSCODE_FORMAT_OKI_ADPCM, 32000, 0, 0}},
+    {"oki-24",      {TRANSCODE_FORMAT_OKI_ADPCM, 24000, 0, 0}},
+    {"lpc10",       {TRANSCODE_FORMAT_LPC10, 0, 0, 0}},
+    {NULL,          {0, 0, 0, 0}}
+};
+
+static const transcode_format_t linear_format = {TRANSCODE_FORMAT_LINEAR, 0, 0, 0};
+
+typedef struct
+{
+    uint8_t *data;
+    int len;
+} recording_t;
+
+static double wall_clock(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec/1000000.0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static const format_desc_t *find_format(const char *name)
+{
+    int i;
+
+    for (i = 0;  formats[i].name;  i++)
+    {
+        if (strcmp(formats[i].name, name) == 0)
+            return &formats[i];
+    }
+    return NULL;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void synthesise(int16_t amp[], int len, int seed)
+{
+    awgn_state_t noise_source;
+    double y1;
+    double y2;
+    double x;
+    int i;
+    int j;
+
+    /* Something a bit like speech - noise through a wandering resonance, with a
+       wandering level */
+    awgn_init_dbm0(&noise_source, 1234567 + seed, -20.0f);
+    y1 = 0.0;
+    y2 = 0.0;
+    for (i = 0;  i < len;  i++)
+    {
+        j = i/4000 + seed;
+        x = awgn(&noise_source)*(0.05 + (j%5)*0.1) + (1.0 + 0.8*(j%3 - 1)*0.5)*y1 - 0.85*y2;
+        y2 = y1;
+        y1 = x;
+        amp[i] = saturate(x);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static int load_file(recording_t *rec, const char *name)
+{
+    FILE *f;
+    long len;
+
+    if ((f = fopen(name, "rb")) == NULL)
+        return -1;
+    fseek(f, 0, SEEK_END);
+    len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    len &= ~1L;
+    rec->data = (uint8_t *) malloc(len + 1);
+    rec->len = fread(rec->data, 1, len, f);
+    fclose(f);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Convert a set of linear recordings to the input format under test */
+static recording_t *make_archive(recording_t linear[], int nfiles, const transcode_format_t *in_format)
+{
+    recording_t *archive;
+    transcode_job_t *job;
+    int len;
+    int i;
+
+    archive = (recording_t *) malloc(nfiles*sizeof(recording_t));
+    for (i = 0;  i < nfiles;  i++)
+    {
+        len = transcode_max_output_len(&linear_format, linear[i].len, in_format);
+        archive[i].data = (uint8_t *) malloc(len + 1);
+        job = transcode_job_init(NULL, &linear_format, linear[i].data, linear[i].len, in_format, archive[i].data, len);
+        if (job == NULL  ||  transcode_job_run(job) != TRANSCODE_OK)
+        {
+            fprintf(stderr, "    Cannot create the input data\n");
+            exit(2);
+        }
+        archive[i].len = transcode_job_get_output_len(job);
+        transcode_job_free(job);
+    }
+    return archive;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void free_archive(recording_t archive[], int nfiles)
+{
+    int i;
+
+    for (i = 0;  i < nfiles;  i++)
+        free(archive[i].data);
+    free(archive);
+}
+/*- End of function --------------------------------------------------------*/
+
+static int test_pair(transcode_pool_t *pool,
+                     recording_t linear[],
+                     int nfiles,
+                     const format_desc_t *in,
+                     const format_desc_t *out,
+                     int verbose)
+{
+    recording_t *archive;
+    transcode_job_t **serial_jobs;
+    transcode_job_t **pool_jobs;
+    uint8_t **serial_out;
+    uint8_t **pool_out;
+    double start;
+    double serial_time;
+    double pool_time;
+    double hours;
+    int len;
+    int ok;
+    int i;
+
+    archive = make_archive(linear, nfiles, &in->format);
+    serial_jobs = (transcode_job_t **) malloc(nfiles*sizeof(transcode_job_t *));
+    pool_jobs = (transcode_job_t **) malloc(nfiles*sizeof(transcode_job_t *));
+    serial_out = (uint8_t **) malloc(nfiles*sizeof(uint8_t *));
+    pool_out = (uint8_t **) malloc(nfiles*sizeof(uint8_t *));
+    for (i = 0;  i < nfiles;  i++)
+    {
+        len = transcode_max_output_len(&in->format, archive[i].len, &out->format);
+        serial_out[i] = (uint8_t *) malloc(len + 1);
+        pool_out[i] = (uint8_t *) malloc(len + 1);
+        serial_jobs[i] = transcode_job_init(NULL, &in->format, archive[i].data, archive[i].len, &out->format, serial_out[i], len);
+        pool_jobs[i] = transcode_job_init(NULL, &in->format, archive[i].data, archive[i].len, &out->format, pool_out[i], len);
+    }
+
+    start = wall_clock();
+    for (i = 0;  i < nfiles;  i++)
+    {
+        if (transcode_job_run(serial_jobs[i]) != TRANSCODE_OK)
+        {
+            printf("    %s to %s: job %d failed (%d)\n", in->name, out->name, i, transcode_job_get_status(serial_jobs[i]));
+            return -1;
+        }
+    }
+    serial_time = wall_clock() - start;
+
+    start = wall_clock();
+    if ((ok = transcode_pool_run(pool, pool_jobs, nfiles)) != nfiles)
+    {
+        printf("    %s to %s: only %d of %d pooled jobs succeeded\n", in->name, out->name, ok, nfiles);
+        return -1;
+    }
+    pool_time = wall_clock() - start;
+
+    hours = 0.0;
+    for (i = 0;  i < nfiles;  i++)
+    {
+        if (transcode_job_get_output_len(pool_jobs[i]) != transcode_job_get_output_len(serial_jobs[i])
+            ||
+            transcode_job_get_duration(pool_jobs[i]) != transcode_job_get_duration(serial_jobs[i])
+            ||
+            memcmp(pool_out[i], serial_out[i], transcode_job_get_output_len(serial_jobs[i])))
+        {
+            printf("    %s to %s: pooled output for job %d differs\n", in->name, out->name, i);
+            return -1;
+        }
+        hours += transcode_job_get_duration(serial_jobs[i])/(3600.0*SAMPLE_RATE);
+    }
+    if (verbose)
+    {
+        printf("    %s to %s: %.2f hours of audio\n", in->name, out->name, hours);
+        printf("        serial %.3fs, %.1f hours/s\n", serial_time, hours/serial_time);
+        printf("        pooled %.3fs, %.1f hours/s\n", pool_time, hours/pool_time);
+    }
+    else
+    {
+        printf("    %-10s to %-10s OK\n", in->name, out->name);
+    }
+
+    for (i = 0;  i < nfiles;  i++)
+    {
+        transcode_job_free(serial_jobs[i]);
+        transcode_job_free(pool_jobs[i]);
+        free(serial_out[i]);
+        free(pool_out[i]);
+    }
+    free(serial_jobs);
+    free(pool_jobs);
+    free(serial_out);
+    free(pool_out);
+    free_archive(archive, nfiles);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int test_errors(void)
+{
+    static const transcode_format_t bad_g726 = {TRANSCODE_FORMAT_G726, 8000, 0, 0};
+    static const transcode_format_t bad_ima = {TRANSCODE_FORMAT_IMA_ADPCM, 0, IMA_ADPCM_IMA4, 256};
+    static const transcode_format_t gsm = {TRANSCODE_FORMAT_GSM0610, 0, GSM0610_PACKING_VOIP, 0};
+    int16_t amp[1000];
+    uint8_t out[1000];
+    transcode_job_t job;
+
+    printf("Checking error handling\n");
+    memset(amp, 0, sizeof(amp));
+    if (transcode_job_init(&job, &linear_format, (uint8_t *) amp, sizeof(amp), &bad_g726, out, sizeof(out)))
+    {
+        printf("    Bad G.726 rate accepted\n");
+        return -1;
+    }
+    if (transcode_job_init(&job, &linear_format, (uint8_t *) amp, sizeof(amp), &bad_ima, out, sizeof(out)))
+    {
+        printf("    Bad IMA ADPCM chunk size accepted\n");
+        return -1;
+    }
+    /* 1000 samples need 7 GSM frames, but there is room for only 3 */
+    transcode_job_init(&job, &linear_format, (uint8_t *) amp, sizeof(amp), &gsm, out, 100);
+    if (transcode_job_run(&job) != TRANSCODE_ERROR_OUTPUT_FULL)
+    {
+        printf("    Output overflow not detected\n");
+        return -1;
+    }
+    transcode_job_init(&job, &linear_format, (uint8_t *) amp, sizeof(amp), &gsm, out, sizeof(out));
+    if (transcode_job_run(&job) != TRANSCODE_OK
+        ||
+        transcode_job_get_output_len(&job) != 7*33
+        ||
+        transcode_job_get_duration(&job) != 1000)
+    {
+        printf("    Bad GSM 06.10 output\n");
+        return -1;
+    }
+    printf("    OK\n");
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    transcode_pool_t *pool;
+    recording_t *linear;
+    const format_desc_t *in;
+    const format_desc_t *out;
+    int16_t *amp;
+    int threads;
+    int nfiles;
+    int seconds;
+    int opt;
+    int i;
+    int j;
+
+    in = NULL;
+    out = NULL;
+    threads = 4;
+    nfiles = 0;
+    seconds = 0;
+    while ((opt = getopt(argc, argv, "f:i:l:o:t:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'f':
+            nfiles = atoi(optarg);
+            break;
+        case 'i':
+            if ((in = find_format(optarg)) == NULL)
+            {
+                fprintf(stderr, "Unknown format '%s'\n", optarg);
+                exit(2);
+            }
+            break;
+        case 'l':
+            seconds = atoi(optarg);
+            break;
+        case 'o':
+            if ((out = find_format(optarg)) == NULL)
+            {
+                fprintf(stderr, "Unknown format '%s'\n", optarg);
+                exit(2);
+            }
+            break;
+        case 't':
+            threads = atoi(optarg);
+            break;
+        default:
+            //usage();
+            exit(2);
+        }
+    }
+    argc -= optind;
+    argv += optind;
+
+    if (test_errors())
+    {
+        printf("Tests failed\n");
+        exit(2);
+    }
+
+    if (argc > 0)
+    {
+        /* Use the files given on the command line as the archive */
+        nfiles = argc;
+        linear = (recording_t *) malloc(nfiles*sizeof(recording_t));
+        for (i = 0;  i < nfiles;  i++)
+        {
+            if (load_file(&linear[i], argv[i]))
+            {
+                fprintf(stderr, "    Cannot open audio file '%s'\n", argv[i]);
+                exit(2);
+            }
+        }
+    }
+    else
+    {
+        if (nfiles <= 0)
+            nfiles = (in  &&  out)  ?  20  :  2;
+        if (seconds <= 0)
+            seconds = (in  &&  out)  ?  120  :  MATRIX_TEST_SECONDS;
+        linear = (recording_t *) malloc(nfiles*sizeof(recording_t));
+        for (i = 0;  i < nfiles;  i++)
+        {
+            /* Vary the lengths, so the jobs do not all finish together */
+            j = seconds*SAMPLE_RATE + i*1237;
+            amp = (int16_t *) malloc(j*sizeof(int16_t));
+            synthesise(amp, j, i);
+            linear[i].data = (uint8_t *) amp;
+            linear[i].len = j*sizeof(int16_t);
+        }
+    }
+
+    if ((pool = transcode_pool_init(threads)) == NULL)
+    {
+        fprintf(stderr, "    Cannot create the worker pool\n");
+        exit(2);
+    }
+    if (in  &&  out)
+    {
+        printf("Transcoding %d files with %d threads\n", nfiles, threads);
+        if (test_pair(pool, linear, nfiles, in, out, TRUE))
+        {
+            printf("Tests failed\n");
+            exit(2);
+        }
+    }
+    else
+    {
+        printf("Checking pooled transcoding against serial transcoding\n");
+        for (i = 0;  formats[i].name;  i++)
+        {
+            if (in  &&  in != &formats[i])
+                continue;
+            for (j = 0;  formats[j].name;  j++)
+            {
+                if (out  &&  out != &formats[j])
+                    continue;
+                if (test_pair(pool, linear, nfiles, &formats[i], &formats[j], FALSE))
+                {
+                    printf("Tests failed\n");
+                    exit(2);
+                }
+            }
+        }
+    }
+    transcode_pool_free(pool);
+    free_archive(linear, nfiles);
+    printf("Tests passed\n");
+    return  0;
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
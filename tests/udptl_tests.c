@@ -0,0 +1,372 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * udptl_tests.c - Tests for the UDPTL packet handling.
+ *
+ * Written by Steve Underwood <steveu@coppice.org>
+ *
+ * Copyright (C) 2009 Steve Underwood
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+/*! \page udptl_tests_page UDPTL tests
+\section udptl_tests_page_sec_1 What does it do?
+A stream of IFP packets is passed through a pair of UDPTL contexts, with packets lost
+between them, for each error recovery scheme. The packets which arrive, directly or
+through error recovery, are checked against those sent. The sequence numbers are made
+to roll over during the stream. A pair of T.38 core contexts are then connected through
+UDPTL, to check the two work together. Finally, the number of packets per second which
+can be built and taken apart is measured, for each error recovery scheme.
+*/
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+//#if defined(WITH_SPANDSP_INTERNALS)
+#define SPANDSP_EXPOSE_INTERNAL_STRUCTURES
+//#endif
+
+#include "spandsp.h"
+
+#define TEST_PACKETS        5000
+#define BENCHMARK_PACKETS   1000000
+
+static uint8_t sent[TEST_PACKETS][UDPTL_MAX_DATAGRAM];
+static int sent_len[TEST_PACKETS];
+static int first_seq_no;
+
+static int rx_count[TEST_PACKETS];
+static int rx_bad;
+static int rx_total;
+
+static int t38_rx_indicators;
+static int t38_rx_data;
+static udptl_state_t *far_udptl;
+static int t38_sent;
+
+static double wall_clock(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec/1000000.0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int rx_packet_handler(void *user_data, const uint8_t msg[], int len, int seq_no)
+{
+    int i;
+    int j;
+
+    rx_total++;
+    i = (seq_no - first_seq_no) & 0xFFFF;
+    if (i >= TEST_PACKETS)
+    {
+        rx_bad++;
+        return 0;
+    }
+    /* A packet repaired by FEC takes the length of the longest packet in its group, so
+       any extra octets should be zero. */
+    if (len < sent_len[i]  ||  memcmp(msg, sent[i], sent_len[i]))
+    {
+        rx_bad++;
+        return 0;
+    }
+    for (j = sent_len[i];  j < len;  j++)
+    {
+        if (msg[j])
+        {
+            rx_bad++;
+            return 0;
+        }
+    }
+    rx_count[i]++;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int lost(int i, int loss_pattern)
+{
+    switch (loss_pattern)
+    {
+    case 1:
+        /* Isolated losses */
+        return (i%10 == 7);
+    case 2:
+        /* Bursts of 3 */
+        return (i%20 >= 11  &&  i%20 <= 13);
+    }
+    return FALSE;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int recovery_tests(int ec_scheme, int span, int entries, int loss_pattern, int far_max_datagram)
+{
+    udptl_state_t *tx;
+    udptl_state_t *rx;
+    uint8_t buf[UDPTL_MAX_PACKET_LEN];
+    int len;
+    int max_len;
+    int i;
+    int j;
+    int missed;
+    int dupes;
+
+    printf("Scheme %d, span %d, entries %d, loss pattern %d, far max datagram %d\n", ec_scheme, span, entries, loss_pattern, far_max_datagram);
+    if ((tx = udptl_init(NULL, ec_scheme, span, entries, rx_packet_handler, NULL)) == NULL)
+        return -1;
+    if ((rx = udptl_init(NULL, ec_scheme, span, entries, rx_packet_handler, NULL)) == NULL)
+        return -1;
+    if (far_max_datagram > 0)
+        udptl_set_far_max_datagram(tx, far_max_datagram);
+    /* Start just short of the roll over of the sequence numbers */
+    first_seq_no = 0xFFFF - 100;
+    tx->tx_seq_no = first_seq_no;
+    memset(rx_count, 0, sizeof(rx_count));
+    rx_bad = 0;
+    rx_total = 0;
+    max_len = 0;
+    for (i = 0;  i < TEST_PACKETS;  i++)
+    {
+        sent_len[i] = 1 + rand()%((i & 1)  ?  20  :  150);
+        for (j = 0;  j < sent_len[i];  j++)
+            sent[i][j] = (uint8_t) rand();
+        if ((len = udptl_build_packet(tx, buf, sent[i], sent_len[i])) < 0)
+        {
+            printf("Build failed\n");
+            return -1;
+        }
+        if (len > max_len)
+            max_len = len;
+        if (!lost(i, loss_pattern))
+        {
+            if (udptl_rx_packet(rx, buf, len) < 0)
+            {
+                printf("Rx failed\n");
+                return -1;
+            }
+            /* Repeat some packets */
+            if (i%31 == 0)
+                udptl_rx_packet(rx, buf, len);
+        }
+    }
+    missed = 0;
+    dupes = 0;
+    /* The last packet may have been lost, with nothing after it to recover it. */
+    for (i = 0;  i < TEST_PACKETS - 1;  i++)
+    {
+        if (rx_count[i] == 0)
+            missed++;
+        else if (rx_count[i] > 1)
+            dupes++;
+    }
+    printf("%d packets, %d received, %d missed, %d repeated, %d bad, longest UDPTL packet %d\n",
+           TEST_PACKETS,
+           rx_total,
+           missed,
+           dupes,
+           rx_bad,
+           max_len);
+    udptl_free(tx);
+    udptl_free(rx);
+    if (rx_bad  ||  dupes)
+        return -1;
+    if (far_max_datagram > 0  &&  max_len > far_max_datagram)
+        return -1;
+    return missed;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int t38_rx_indicator_handler(t38_core_state_t *s, void *user_data, int indicator)
+{
+    t38_rx_indicators++;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int t38_rx_data_handler(t38_core_state_t *s, void *user_data, int data_type, int field_type, const uint8_t *buf, int len)
+{
+    t38_rx_data++;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int t38_rx_missing_handler(t38_core_state_t *s, void *user_data, int rx_seq_no, int expected_seq_no)
+{
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int udptl_tx_handler(void *user_data, const uint8_t buf[], int len)
+{
+    /* Lose 2 packets in every 5 */
+    ++t38_sent;
+    if (t38_sent%5 != 2  &&  t38_sent%5 != 3)
+        udptl_rx_packet(far_udptl, buf, len);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int t38_core_tests(void)
+{
+    t38_core_state_t *t38_a;
+    t38_core_state_t *t38_b;
+    udptl_state_t *udptl_a;
+    udptl_state_t *udptl_b;
+    uint8_t data[100];
+    int i;
+
+    printf("T.38 core through UDPTL tests\n");
+    udptl_a = udptl_init(NULL, UDPTL_ERROR_CORRECTION_REDUNDANCY, 0, 1, udptl_t38_rx_packet_handler, NULL);
+    udptl_b = udptl_init(NULL, UDPTL_ERROR_CORRECTION_REDUNDANCY, 0, 1, udptl_t38_rx_packet_handler, NULL);
+    t38_a = t38_core_init(NULL, t38_rx_indicator_handler, t38_rx_data_handler, t38_rx_missing_handler, NULL, udptl_t38_tx_packet_handler, udptl_a);
+    t38_b = t38_core_init(NULL, t38_rx_indicator_handler, t38_rx_data_handler, t38_rx_missing_handler, NULL, udptl_t38_tx_packet_handler, udptl_b);
+    if (udptl_a == NULL  ||  udptl_b == NULL  ||  t38_a == NULL  ||  t38_b == NULL)
+        return -1;
+    /* Each UDPTL context passes its received IFP packets to the T.38 core at its end */
+    udptl_b->user_data = t38_b;
+    udptl_a->user_data = t38_a;
+    udptl_set_tx_packet_handler(udptl_a, udptl_tx_handler, NULL);
+    far_udptl = udptl_b;
+    /* A redundancy depth of 2 for indicators and image data overrides the depth of 1 for the UDPTL context,
+       so pairs of lost packets can be recovered. */
+    t38_set_redundancy_control(t38_a, T38_PACKET_CATEGORY_INDICATOR, 0x201);
+    t38_set_redundancy_control(t38_a, T38_PACKET_CATEGORY_IMAGE_DATA, 0x201);
+
+    t38_rx_indicators = 0;
+    t38_rx_data = 0;
+    t38_sent = 0;
+    memset(data, 0x55, sizeof(data));
+    for (i = 0;  i < 1000;  i++)
+    {
+        if ((i & 0xFF) == 0)
+            t38_core_send_indicator(t38_a, (i & 0x100)  ?  T38_IND_V29_9600_TRAINING  :  T38_IND_NO_SIGNAL);
+        else
+            t38_core_send_data(t38_a, T38_DATA_V29_9600, T38_FIELD_T4_NON_ECM_DATA, data, 1 + i%sizeof(data), T38_PACKET_CATEGORY_IMAGE_DATA);
+    }
+    printf("%d packets sent, %d indicators and %d data packets received, %d missing\n",
+           t38_sent,
+           t38_rx_indicators,
+           t38_rx_data,
+           t38_b->missing_packets);
+    if (t38_rx_indicators != 4  ||  t38_rx_data != 996  ||  t38_b->missing_packets != 0)
+        return -1;
+    t38_core_free(t38_a);
+    t38_core_free(t38_b);
+    udptl_free(udptl_a);
+    udptl_free(udptl_b);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int null_rx_packet_handler(void *user_data, const uint8_t msg[], int len, int seq_no)
+{
+    rx_total++;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void benchmark(int ec_scheme, int span, int entries, const char *name)
+{
+    udptl_state_t *tx;
+    udptl_state_t *rx;
+    uint8_t buf[UDPTL_MAX_PACKET_LEN];
+    uint8_t msg[UDPTL_MAX_DATAGRAM];
+    int len;
+    int msg_len;
+    int i;
+    double start;
+    double build_time;
+    double total_time;
+
+    memset(msg, 0x5A, sizeof(msg));
+    /* Typical non-ECM image data packets, for 9600bps in 30ms chunks */
+    msg_len = 40;
+
+    tx = udptl_init(NULL, ec_scheme, span, entries, null_rx_packet_handler, NULL);
+    start = wall_clock();
+    for (i = 0;  i < BENCHMARK_PACKETS;  i++)
+        udptl_build_packet(tx, buf, msg, msg_len);
+    build_time = wall_clock() - start;
+    udptl_free(tx);
+
+    tx = udptl_init(NULL, ec_scheme, span, entries, null_rx_packet_handler, NULL);
+    rx = udptl_init(NULL, ec_scheme, span, entries, null_rx_packet_handler, NULL);
+    rx_total = 0;
+    start = wall_clock();
+    for (i = 0;  i < BENCHMARK_PACKETS;  i++)
+    {
+        len = udptl_build_packet(tx, buf, msg, msg_len);
+        udptl_rx_packet(rx, buf, len);
+    }
+    total_time = wall_clock() - start;
+    udptl_free(tx);
+    udptl_free(rx);
+    printf("%-22s build %9.0f packets/s, receive %9.0f packets/s\n",
+           name,
+           BENCHMARK_PACKETS/build_time,
+           BENCHMARK_PACKETS/(total_time - build_time));
+}
+/*- End of function --------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    /* Redundancy should recover bursts up to the depth */
+    if (recovery_tests(UDPTL_ERROR_CORRECTION_NONE, 0, 0, 0, 0) != 0)
+        goto failed;
+    if (recovery_tests(UDPTL_ERROR_CORRECTION_NONE, 0, 0, 1, 0) != TEST_PACKETS/10)
+        goto failed;
+    if (recovery_tests(UDPTL_ERROR_CORRECTION_REDUNDANCY, 0, 1, 1, 0) != 0)
+        goto failed;
+    if (recovery_tests(UDPTL_ERROR_CORRECTION_REDUNDANCY, 0, 3, 2, 0) != 0)
+        goto failed;
+    if (recovery_tests(UDPTL_ERROR_CORRECTION_REDUNDANCY, 0, 2, 2, 0) <= 0)
+        goto failed;
+    /* Trimming the redundancy to fit the far end's limit should cost some recovery */
+    if (recovery_tests(UDPTL_ERROR_CORRECTION_REDUNDANCY, 0, 3, 2, 200) < 0)
+        goto failed;
+    /* FEC should recover isolated losses */
+    if (recovery_tests(UDPTL_ERROR_CORRECTION_FEC, 3, 1, 1, 0) != 0)
+        goto failed;
+    if (recovery_tests(UDPTL_ERROR_CORRECTION_FEC, 3, 3, 1, 0) != 0)
+        goto failed;
+    if (recovery_tests(UDPTL_ERROR_CORRECTION_FEC, 3, 3, 2, 0) < 0)
+        goto failed;
+    if (t38_core_tests())
+        goto failed;
+
+    printf("Benchmarks\n");
+    benchmark(UDPTL_ERROR_CORRECTION_NONE, 0, 0, "No error recovery");
+    benchmark(UDPTL_ERROR_CORRECTION_REDUNDANCY, 0, 3, "Redundancy, depth 3");
+    benchmark(UDPTL_ERROR_CORRECTION_FEC, 3, 3, "FEC, span 3, entries 3");
+    printf("Tests passed.\n");
+    return 0;
+
+failed:
+    printf("Tests failed.\n");
+    return 2;
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
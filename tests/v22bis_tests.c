@@ -80,6 +80,8 @@ typedef struct
 #endif
     float smooth_power;
     int symbol_no;
+    uint64_t rx_ticks;
+    uint64_t rx_samples;
 } endpoint_t;
 
 endpoint_t endpoint[2];
@@ -97,6 +99,8 @@ static void reporter(void *user_data, int reason, bert_results_t *results)
                 results->total_bits,
                 results->bad_bits,
                 results->resyncs);
+        if (s->rx_samples)
+            fprintf(stderr, "V.22bis rx %p receive cost %" PRIu64 " ticks/sample\n", user_data, s->rx_ticks/s->rx_samples);
         memcpy(&s->latest_results, results, sizeof(s->latest_results));
         break;
     default:
@@ -225,6 +229,7 @@ int main(int argc, char *argv[])
     int channel_codec;
     int rbs_pattern;
     int opt;
+    uint64_t start;
     
     channel_codec = MUNGE_CODEC_NONE;
     rbs_pattern = 0;
@@ -389,7 +394,10 @@ int main(int argc, char *argv[])
         for (i = 0;  i < 2;  i++)
         {
             span_log_bump_samples(&endpoint[i].v22bis->logging, samples);
+            start = rdtscll();
             v22bis_rx(endpoint[i ^ 1].v22bis, model_amp[i], samples);
+            endpoint[i ^ 1].rx_ticks += rdtscll() - start;
+            endpoint[i ^ 1].rx_samples += samples;
             for (j = 0;  j < samples;  j++)
                 out_amp[2*j + i] = model_amp[i][j];
             for (  ;  j < BLOCK_LEN;  j++)